@@ -13,7 +13,7 @@ def divide (x y: Float): Except String Float :=
   else
     pure (x / y)
 
-#eval divide 5 2  -- Except.ok 2.500000
+#eval divide 5 2  -- Except.ok 2.5
 #eval divide 5 0  -- Except.error "can't divide by zero"
 
 /-!
@@ -59,7 +59,7 @@ def square (x : Float) : Except String Float :=
   else
     pure (x * x)
 
-#eval divide 6 2 >>= square  -- Except.ok 9.000000
+#eval divide 6 2 >>= square  -- Except.ok 9.0
 #eval divide 6 0 >>= square  -- Except.error "can't divide by zero"
 #eval divide 100 1 >>= square  -- Except.error "it's absolutely huge"
 
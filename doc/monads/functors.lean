@@ -45,7 +45,7 @@ Let's look at some more examples:
 
 -- List Nat → List Float
 #eval [1,2,3,4,5].map (fun s => (s.toFloat) ^ 3.0)
--- [1.000000, 8.000000, 27.000000, 64.000000, 125.000000]
+-- [1.0, 8.0, 27.0, 64.0, 125.0]
 
 --- List String → List String
 #eval ["chris", "david", "mark"].map (fun s => s.capitalize)
@@ -162,11 +162,11 @@ and now bringing it all together you can use the simple function `squareFeetToMe
 -/
 #eval mySpace.map squareFeetToMeters
 /-
-{ totalSize := 167.225472,
+{ totalSize := 167.22547225959815,
   numBedrooms := 4,
-  masterBedroomSize := 46.451520,
-  livingRoomSize := 83.612736,
-  kitchenSize := 37.161216 }
+  masterBedroomSize := 46.4515200721106,
+  livingRoomSize := 83.61273612979907,
+  kitchenSize := 37.16121605768848 }
   -/
 /-!
 
@@ -125,7 +125,7 @@ def divide (x : Float ) (y : Float): ExceptT String Id Float :=
   else
     pure (x / y)
 
-#eval divide 6 3 -- Except.ok 2.000000
+#eval divide 6 3 -- Except.ok 2.0
 #eval divide 1 0 -- Except.error "can't divide by zero"
 /-!
 
@@ -140,7 +140,7 @@ def divideCounter (x : Float) (y : Float) : StateT Nat (ExceptT String Id) Float
   modify fun s => s + 1
   divide x y
 
-#eval divideCounter 6 3 |>.run 0    -- Except.ok (2.000000, 1)
+#eval divideCounter 6 3 |>.run 0    -- Except.ok (2.0, 1)
 #eval divideCounter 1 0 |>.run 0    -- Except.error "can't divide by zero"
 
 /-!
@@ -155,7 +155,7 @@ You can see this more clearly with the following test:
 def liftTest (x : Except String Float) :
   StateT Nat (Except String) Float := x
 
-#eval liftTest (divide 5 1) |>.run 3 -- Except.ok (5.000000, 3)
+#eval liftTest (divide 5 1) |>.run 3 -- Except.ok (5.0, 3)
 
 /-!
 
@@ -211,7 +211,7 @@ def liftTest2 (x : Except String Float) :
   ReaderT String (StateT Nat (Except String)) Float := x
 
 #eval liftTest2 (divide 5 1) |>.run "" |>.run 3
--- Except.ok (5.000000, 3)
+-- Except.ok (5.0, 3)
 
 /-!
 
@@ -267,7 +267,7 @@ def main3 : IO Unit := do
   catch e =>
     IO.println e
 
-#eval main3 -- (2.500000, 1)
+#eval main3 -- (2.5, 1)
 /-!
 
 It turns out that the `IO` monad you see in your `main` function is based on the `EStateM.Result` type
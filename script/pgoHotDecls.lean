@@ -0,0 +1,31 @@
+import Lean.Compiler.NameMangling
+
+/-!
+
+Usage:
+```sh
+llvm-profdata show --topn=100 default.profdata | lean --run ./script/pgoHotDecls.lean
+```
+
+Maps the hottest functions of a clang profile, as listed by `llvm-profdata show --topn`, back to the
+Lean declarations they were generated from. Lines that do not name a Lean function, such as those of
+the C++ runtime, are printed unchanged. See `doc/dev/pgo.md`.
+-/
+
+open Lean
+
+def main : IO Unit := do
+  let stdin ← IO.getStdin
+  repeat
+    let line ← stdin.getLine
+    if line.isEmpty then
+      break
+    let line := line.trimRight
+    -- `  <symbol>, max count = <count>`
+    match line.trimLeft.splitOn ", max count = " with
+    | [sym, count] =>
+      -- boxed versions and other auxiliary functions demangle to their own declaration names
+      match Name.demangle? sym with
+      | some n => IO.println s!"{count}\t{n}"
+      | none   => IO.println s!"{count}\t{sym}"
+    | _ => IO.println line
@@ -541,12 +541,23 @@ Regular priority tasks are placed in a thread pool and worked on according to th
 -- see `LEAN_MAX_PRIO`
 def Priority.max : Priority := 8
 /--
-Any priority higher than `Task.Priority.max` will result in the task being scheduled
-immediately on a dedicated thread. This is particularly useful for long-running and/or
-I/O-bound tasks since Lean will by default allocate no more non-dedicated workers
+Any priority higher than `Task.Priority.max`, except for `Task.Priority.interactive`, will result in
+the task being scheduled immediately on a dedicated thread. This is particularly useful for
+long-running and/or I/O-bound tasks since Lean will by default allocate no more non-dedicated workers
 than the number of cores to reduce context switches.
 -/
 def Priority.dedicated : Priority := 9
+/--
+Latency class for short tasks that a user is waiting for, such as requests of the language server.
+When it is ready to run, an interactive task is scheduled in front of all queued tasks if a worker
+is idle, and on a dedicated thread otherwise, so it does not wait for running tasks to finish.
+
+A task waiting for another task, either as its dependent or by blocking on it, donates its priority
+to it and to the tasks it is transitively waiting for, up to `Task.Priority.max`. Thus the tasks an
+interactive task depends on are boosted to `Task.Priority.max`.
+-/
+-- see `LEAN_INTERACTIVE_PRIO`
+def Priority.interactive : Priority := 10
 
 set_option linter.unusedVariables.funArgs false in
 /--
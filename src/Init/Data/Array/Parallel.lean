@@ -0,0 +1,127 @@
+/-
+Copyright (c) 2024 Lean FRO, LLC. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+-/
+prelude
+import Init.Data.Array.QSort
+import Init.System.IO
+
+/-!
+Data-parallel operations on arrays. The array is split into chunks of `grain` consecutive elements,
+and each chunk is processed by a separate task. The tasks traverse their index range of the source
+array directly, so the source array is not copied; it is marked as shared between threads once,
+when it is captured by the first task. Arrays with at most `grain` elements are processed
+sequentially.
+-/
+
+namespace Array
+
+/-- The number of chunks of at most `grain` elements covering `size` elements. -/
+@[inline] private def numChunks (size grain : Nat) : Nat :=
+  (size + grain - 1) / grain
+
+/-- Spawns a task computing `f lo hi` for each chunk `[lo, hi)` of `[0, size)`. -/
+@[inline] private def spawnChunks (size grain : Nat) (prio : Task.Priority) (f : Nat → Nat → β) :
+    Array (Task β) :=
+  (Array.range (numChunks size grain)).map fun i =>
+    Task.spawn (prio := prio) fun _ => f (i * grain) (min ((i + 1) * grain) size)
+
+/--
+`as.parMap f` computes `as.map f`, applying `f` in parallel on chunks of `grain` elements.
+-/
+@[inline] def parMap (f : α → β) (as : Array α) (grain := 1024) (prio := Task.Priority.default) :
+    Array β :=
+  let grain := max grain 1
+  if as.size ≤ grain then
+    as.map f
+  else
+    let chunks := spawnChunks as.size grain prio fun lo hi =>
+      as.foldl (start := lo) (stop := hi) (init := mkEmpty (hi - lo)) fun bs a => bs.push (f a)
+    chunks.foldl (init := mkEmpty as.size) fun bs t => bs ++ t.get
+
+/--
+`as.parFoldl f combine init` folds `f` over `as` in parallel: each chunk of `grain` elements is
+folded starting from `init`, and the results are combined from left to right with `combine`,
+starting from `init`.
+
+The result is the same as `as.foldl f init` if `init` is a neutral element of `combine` and
+`combine b (xs.foldl f init) = xs.foldl f b` for all `b` and `xs`, e.g., for `f := (· + ·)` and
+`combine := (· + ·)` on natural numbers with `init := 0`.
+-/
+@[inline] def parFoldl (f : β → α → β) (combine : β → β → β) (init : β) (as : Array α)
+    (grain := 1024) (prio := Task.Priority.default) : β :=
+  let grain := max grain 1
+  if as.size ≤ grain then
+    as.foldl f init
+  else
+    let chunks := spawnChunks as.size grain prio fun lo hi =>
+      as.foldl (start := lo) (stop := hi) (init := init) f
+    chunks.foldl (init := init) fun b t => combine b t.get
+
+/--
+`as.parForM f` runs `f` on every element of `as`, in parallel on chunks of `grain` elements. Within a
+chunk, the elements are processed in order. If `f` throws, the remaining elements of its chunk are
+skipped, and the first error in the order of the chunks is rethrown after all chunks are done.
+-/
+def parForM (as : Array α) (f : α → IO Unit) (grain := 1024) (prio := Task.Priority.default) :
+    IO Unit := do
+  let grain := max grain 1
+  if as.size ≤ grain then
+    as.forM f
+  else
+    let chunks ← (Array.range (numChunks as.size grain)).mapM fun i =>
+      IO.asTask (prio := prio) do
+        as.forM (start := i * grain) (stop := min ((i + 1) * grain) as.size) f
+    let mut err? : Option IO.Error := none
+    for t in chunks do
+      if let .error e := (← IO.wait t) then
+        err? := err? <|> some e
+    if let some e := err? then
+      throw e
+
+/--
+Merges the arrays `xs` and `ys`, which are sorted with respect to `lt`. Elements of `xs` come first
+among equivalent elements.
+-/
+def mergeSorted (xs ys : Array α) (lt : α → α → Bool) : Array α := Id.run do
+  let mut out : Array α := mkEmpty (xs.size + ys.size)
+  let mut i := 0
+  let mut j := 0
+  for _ in [0:xs.size + ys.size] do
+    if h₁ : i < xs.size then
+      if h₂ : j < ys.size then
+        if lt ys[j] xs[i] then
+          out := out.push ys[j]
+          j := j + 1
+        else
+          out := out.push xs[i]
+          i := i + 1
+      else
+        out := out.push xs[i]
+        i := i + 1
+    else if h₂ : j < ys.size then
+      out := out.push ys[j]
+      j := j + 1
+  return out
+
+/--
+Sorts `as` with respect to `lt` in parallel: the chunks of `grain` elements are sorted with `qsort` in
+separate tasks, and the sorted chunks are then merged pairwise with `mergeSorted`, where the merges
+of each round run in parallel as well.
+-/
+def parQsort (as : Array α) (lt : α → α → Bool) (grain := 4096) (prio := Task.Priority.default) :
+    Array α := Id.run do
+  let grain := max grain 1
+  if as.size ≤ grain then
+    return as.qsort lt
+  -- each task copies its chunk, as `qsort` sorts in place
+  let mut tasks := spawnChunks as.size grain prio fun lo hi => (as.extract lo hi).qsort lt
+  while tasks.size > 1 do
+    tasks := (Array.range ((tasks.size + 1) / 2)).map fun i =>
+      match tasks[2 * i]?, tasks[2 * i + 1]? with
+      | some t₁, some t₂ => t₁.bind (prio := prio) fun xs => t₂.map (prio := prio) fun ys => mergeSorted xs ys lt
+      | some t, none     => t
+      | none, _          => .pure #[]
+  return tasks[0]?.map Task.get |>.getD #[]
+
+end Array
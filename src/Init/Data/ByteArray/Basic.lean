@@ -96,6 +96,22 @@ protected def append (a : ByteArray) (b : ByteArray) : ByteArray :=
 
 instance : Append ByteArray := ⟨ByteArray.append⟩
 
+@[extern "lean_byte_array_beq"]
+protected def beq (a b : @& ByteArray) : Bool :=
+  a.data == b.data
+
+instance : BEq ByteArray := ⟨ByteArray.beq⟩
+
+/-- Bytewise exclusive or. The result has the size of the shorter array. -/
+@[extern "lean_byte_array_xor"]
+def xor (a : ByteArray) (b : @& ByteArray) : ByteArray :=
+  ⟨a.data.zipWith b.data (· ^^^ ·)⟩
+
+/-- Sets all bytes of `a` to `b`. -/
+@[extern "lean_byte_array_fill"]
+def fill (a : ByteArray) (b : UInt8) : ByteArray :=
+  ⟨mkArray a.size b⟩
+
 def toList (bs : ByteArray) : List UInt8 :=
   let rec loop (i : Nat) (r : List UInt8) :=
     if i < bs.size then
@@ -116,6 +132,28 @@ def toList (bs : ByteArray) : List UInt8 :=
     decreasing_by decreasing_trivial_pre_omega
   loop start
 
+/-- Returns the index of the first occurrence of `b` at or after `start`. -/
+@[extern "lean_byte_array_find"]
+def find? (a : @& ByteArray) (b : UInt8) (start : @& Nat := 0) : Option Nat :=
+  a.findIdx? (· == b) start
+
+/--
+Returns a mask in which bit `j` is set if the byte at index `i + j` is `b`, for all `j < 16`. Bytes past
+the end of `a` do not match. The native implementation compares all 16 bytes with a single SIMD
+instruction where available, which makes it suitable for probing groups of control bytes in hash tables.
+-/
+@[extern "lean_byte_array_match16"]
+def match16 (a : @& ByteArray) (i : USize) (b : UInt8) : UInt16 :=
+  go 0 0
+where
+  go (j : Nat) (mask : UInt16) : UInt16 :=
+    if j < 16 then
+      let k := i.toNat + j
+      go (j + 1) (if k < a.size && a.get! k == b then mask ||| (1 <<< j.toUInt16) else mask)
+    else
+      mask
+  termination_by 16 - j
+
 /--
   We claim this unsafe implementation is correct because an array cannot have more than `usizeSz` elements in our runtime.
   This is similar to the `Array` version.
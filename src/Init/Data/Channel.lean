@@ -4,61 +4,43 @@ Released under Apache 2.0 license as described in the file LICENSE.
 Authors: Gabriel Ebner
 -/
 prelude
-import Init.Data.Queue
 import Init.System.Promise
-import Init.System.Mutex
 
 namespace IO
 
-/--
-Internal state of an `Channel`.
-
-We maintain the invariant that at all times either `consumers` or `values` is empty.
--/
-structure Channel.State (α : Type) where
-  values : Std.Queue α := ∅
-  consumers : Std.Queue (Promise (Option α)) := ∅
-  closed := false
-  deriving Inhabited
+private opaque ChannelImpl : NonemptyType.{0}
 
 /--
 FIFO channel with unbounded buffer, where `recv?` returns a `Task`.
 
 A channel can be closed.  Once it is closed, all `send`s are ignored, and
 `recv?` returns `none` once the queue is empty.
+
+Channels are implemented in the runtime by a lock-free ring buffer, so that `send` and `recv?` only
+take a lock when more values are buffered than fit into the ring or when a receiver has to wait.
+Values are marked as shared between threads when they are sent.
 -/
-def Channel (α : Type) : Type := Mutex (Channel.State α)
+def Channel (α : Type) : Type := ChannelImpl.type
 
-instance : Nonempty (Channel α) :=
-  inferInstanceAs (Nonempty (Mutex _))
+instance : Nonempty (Channel α) := ChannelImpl.property
 
 /-- Creates a new `Channel`. -/
-def Channel.new : BaseIO (Channel α) :=
-  Mutex.new {}
+@[extern "lean_io_channel_new"]
+opaque Channel.new : BaseIO (Channel α)
 
 /--
 Sends a message on an `Channel`.
 
 This function does not block.
 -/
-def Channel.send (ch : Channel α) (v : α) : BaseIO Unit :=
-  ch.atomically do
-    let st ← get
-    if st.closed then return
-    if let some (consumer, consumers) := st.consumers.dequeue? then
-      consumer.resolve (some v)
-      set { st with consumers }
-    else
-      set { st with values := st.values.enqueue v }
+@[extern "lean_io_channel_send"]
+opaque Channel.send (ch : @& Channel α) (v : α) : BaseIO Unit
 
 /--
 Closes an `Channel`.
 -/
-def Channel.close (ch : Channel α) : BaseIO Unit :=
-  ch.atomically do
-    let st ← get
-    for consumer in st.consumers.toArray do consumer.resolve none
-    set { st with closed := true, consumers := ∅ }
+@[extern "lean_io_channel_close"]
+opaque Channel.close (ch : @& Channel α) : BaseIO Unit
 
 /--
 Receives a message, without blocking.
@@ -67,18 +49,8 @@ Every message is only received once.
 
 Returns `none` if the channel is closed and the queue is empty.
 -/
-def Channel.recv? (ch : Channel α) : BaseIO (Task (Option α)) :=
-  ch.atomically do
-    let st ← get
-    if let some (a, values) := st.values.dequeue? then
-      set { st with values }
-      return .pure a
-    else if !st.closed then
-      let promise ← Promise.new
-      set { st with consumers := st.consumers.enqueue promise }
-      return promise.result
-    else
-      return .pure none
+@[extern "lean_io_channel_recv"]
+opaque Channel.recv? (ch : @& Channel α) : BaseIO (Task (Option α))
 
 /--
 `ch.forAsync f` calls `f` for every messages received on `ch`.
@@ -96,9 +68,8 @@ Receives all currently queued messages from the channel.
 
 Those messages are dequeued and will not be returned by `recv?`.
 -/
-def Channel.recvAllCurrent (ch : Channel α) : BaseIO (Array α) :=
-  ch.atomically do
-    modifyGet fun st => (st.values.toArray, { st with values := ∅ })
+@[extern "lean_io_channel_recv_all_current"]
+opaque Channel.recvAllCurrent (ch : @& Channel α) : BaseIO (Array α)
 
 /-- Type tag for synchronous (blocking) operations on a `Channel`. -/
 def Channel.Sync := Channel
@@ -71,6 +71,11 @@ instance : BEq Float := ⟨Float.beq⟩
 instance floatDecLt (a b : Float) : Decidable (a < b) := Float.decLt a b
 instance floatDecLe (a b : Float) : Decidable (a ≤ b) := Float.decLe a b
 
+/--
+Renders the shortest decimal that reads back as the same float, in scientific notation if its
+exponent is very small or large: `1.0`, `0.1`, `1e100`. Non-finite values are rendered as `NaN`,
+`inf` and `-inf`.
+-/
 @[extern "lean_float_to_string"] opaque Float.toString : Float → String
 /-- If the given float is non-negative, truncates the value to the nearest non-negative integer.
 If negative or NaN, returns `0`.
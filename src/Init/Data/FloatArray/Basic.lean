@@ -6,6 +6,7 @@ Author: Leonardo de Moura
 prelude
 import Init.Data.Array.Basic
 import Init.Data.Float
+import Init.Data.OfScientific
 import Init.Data.Option.Basic
 universe u
 
@@ -162,6 +163,64 @@ def foldlM {β : Type v} {m : Type v → Type w} [Monad m] (f : β → Float →
 def foldl {β : Type v} (f : β → Float → β) (init : β) (as : FloatArray) (start := 0) (stop := as.size) : β :=
   Id.run <| as.foldlM f init start stop
 
+/-!
+Bulk arithmetic. The native implementations update the first argument in place when it is not
+shared. Elementwise operations on two arrays produce an array of the size of the shorter one.
+-/
+
+/-- Elementwise addition. -/
+@[extern "lean_float_array_add"]
+def add (a : FloatArray) (b : @& FloatArray) : FloatArray :=
+  ⟨a.data.zipWith b.data (· + ·)⟩
+
+/-- Elementwise subtraction. -/
+@[extern "lean_float_array_sub"]
+def sub (a : FloatArray) (b : @& FloatArray) : FloatArray :=
+  ⟨a.data.zipWith b.data (· - ·)⟩
+
+/-- Elementwise multiplication. -/
+@[extern "lean_float_array_mul"]
+def mul (a : FloatArray) (b : @& FloatArray) : FloatArray :=
+  ⟨a.data.zipWith b.data (· * ·)⟩
+
+/-- Elementwise division. -/
+@[extern "lean_float_array_div"]
+def div (a : FloatArray) (b : @& FloatArray) : FloatArray :=
+  ⟨a.data.zipWith b.data (· / ·)⟩
+
+/-- Multiplies every element by `c`. -/
+@[extern "lean_float_array_scale"]
+def scale (a : FloatArray) (c : Float) : FloatArray :=
+  ⟨a.data.map (· * c)⟩
+
+/-- Adds `c` to every element. -/
+@[extern "lean_float_array_shift"]
+def shift (a : FloatArray) (c : Float) : FloatArray :=
+  ⟨a.data.map (· + c)⟩
+
+/--
+Sum of the elements. The native implementation adds the elements in a different order than the
+reference implementation, so rounding may differ.
+-/
+@[extern "lean_float_array_sum"]
+def sum (a : @& FloatArray) : Float :=
+  a.foldl (· + ·) 0
+
+/-- Dot product. See `sum` about the order of the additions. -/
+@[extern "lean_float_array_dot"]
+def dot (a b : @& FloatArray) : Float :=
+  (a.mul b).sum
+
+/-- Smallest element, or infinity if `a` is empty. -/
+@[extern "lean_float_array_minimum"]
+def minimum (a : @& FloatArray) : Float :=
+  a.foldl (fun r x => if x < r then x else r) (1 / 0)
+
+/-- Largest element, or minus infinity if `a` is empty. -/
+@[extern "lean_float_array_maximum"]
+def maximum (a : @& FloatArray) : Float :=
+  a.foldl (fun r x => if x > r then x else r) (-1 / 0)
+
 end FloatArray
 
 def List.toFloatArray (ds : List Float) : FloatArray :=
@@ -117,6 +117,21 @@ private structure SpaceResult where
     let r₂ := r₂ (w - r₁.space);
     { r₂ with space := r₁.space + r₂.space }
 
+/--
+Measures the text at `it` up to its first line break. Scans at most `fuel` characters so that the
+lookahead of a group is bounded by the width even for huge texts, as anything wider is not
+distinguished by `merge`.
+-/
+private def spaceOfText (flatten : Bool) (it : String.Iterator) : Nat → Nat → SpaceResult
+  | 0,        n => { space := n }
+  | fuel + 1, n =>
+    if it.atEnd then
+      { space := n }
+    else if it.curr == '\n' then
+      { foundLine := true, foundFlattenedHardLine := flatten, space := n }
+    else
+      spaceOfText flatten it.next fuel (n + 1)
+
 private def spaceUptoLine : Format → Bool → Int → Nat → SpaceResult
   | nil,          _,       _, _ => {}
   | line,         flatten, _, _ => if flatten then { space := 1 } else { foundLine := true }
@@ -126,10 +141,7 @@ private def spaceUptoLine : Format → Bool → Int → Nat → SpaceResult
       { space := (m - w).toNat }
     else
       { foundLine := true }
-  | text s,       flatten, _, _ =>
-    let p := s.posOf '\n'
-    let off := s.offsetOfPos p
-    { foundLine := p != s.endPos, foundFlattenedHardLine := flatten && p != s.endPos, space := off }
+  | text s,       flatten, _, w => spaceOfText flatten s.iter (w + 1) 0
   | append f₁ f₂, flatten, m, w => merge w (spaceUptoLine f₁ flatten m w) (spaceUptoLine f₂ flatten m)
   | nest n f,     flatten, m, w => spaceUptoLine f flatten (m - n) w
   | group f _,    _,       m, w => spaceUptoLine f true m w
@@ -153,6 +165,15 @@ private partial def spaceUptoLine' : List WorkGroup → Nat → Nat → SpaceRes
       (spaceUptoLine i.f g.flatten (w + col - i.indent) w)
       (spaceUptoLine' ({ g with items := is }::gs) col)
 
+/--
+The items for the lines `ls` of a text following its first line break, separated by hard line
+breaks. Only the last one closes the tags of `i`.
+-/
+private def textLineItems (i : WorkItem) : List String → List WorkItem
+  | []      => []
+  | [l]     => [{ i with f := text l }]
+  | l :: ls => { i with f := text l, activeTags := 0 } :: { i with f := text "\n", activeTags := 0 } :: textLineItems i ls
+
 /-- A monad in which we can pretty-print `Format` objects. -/
 class MonadPrettyFormat (m : Type → Type) where
   pushOutput (s : String)    : m Unit
@@ -196,7 +217,8 @@ private partial def be (w : Nat) [Monad m] [MonadPrettyFormat m] : List WorkGrou
       else
         pushOutput (s.extract {} p)
         pushNewline i.indent.toNat
-        let is := { i with f := text (s.extract (s.next p) s.endPos) }::is
+        -- split off the remaining lines at once instead of copying the rest of `s` at every line break
+        let is := textLineItems i ((s.extract (s.next p) s.endPos).splitOn "\n") ++ is
         -- after a hard line break, re-evaluate whether to flatten the remaining group
         pushGroup g.flb is gs w >>= be w
     | line =>
@@ -313,6 +335,46 @@ def pretty (f : Format) (width : Nat := defWidth) (indent : Nat := 0) (column :=
   let act : StateM State Unit := prettyM f width indent
   State.out <| act (State.mk "" column) |>.snd
 
+/-- State for formatting a pretty string of bounded length, see `prettyTruncated`. -/
+private structure BoundedState where
+  out       : String := ""
+  column    : Nat    := 0
+  /-- Number of characters that may still be output. -/
+  remaining : Nat
+
+/--
+Appends `s` to the output and moves to column `column?`, or to the end of `s` if it is `none`. If
+the output would exceed its budget, appends only a prefix of `s` and fails.
+-/
+private def BoundedState.push (s : String) (column? : Option Nat) : EStateM Unit BoundedState Unit := do
+  let (out, column, remaining) ← modifyGet fun st => ((st.out, st.column, st.remaining), { st with out := "" })
+  let n := s.length
+  let column := column?.getD (column + n)
+  if n ≤ remaining then
+    set ({ out := out ++ s, column, remaining := remaining - n } : BoundedState)
+  else
+    set ({ out := out ++ s.take remaining, column, remaining := 0 } : BoundedState)
+    throw ()
+
+instance : MonadPrettyFormat (EStateM Unit BoundedState) where
+  pushOutput s       := BoundedState.push s none
+  pushNewline indent := BoundedState.push ("\n".pushn ' ' indent) (some indent)
+  currColumn         := return (← get).column
+  startTag _         := return ()
+  endTags _          := return ()
+
+/--
+Renders a `Format` to a string like `pretty`, but stops once the output reaches `maxLength`
+characters and appends `ellipsis` in that case. Rendering stops early, so this is cheap even for
+huge formats.
+-/
+def prettyTruncated (f : Format) (maxLength : Nat) (ellipsis := "⋯") (width : Nat := defWidth)
+    (indent : Nat := 0) (column := 0) : String :=
+  let act : EStateM Unit BoundedState Unit := prettyM f width indent
+  match act.run { column, remaining := maxLength } with
+  | .ok _ st    => st.out
+  | .error _ st => st.out ++ ellipsis
+
 end Format
 
 /-- Class for converting a given type α to a `Format` object for pretty-printing.
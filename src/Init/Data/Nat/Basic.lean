@@ -801,6 +801,21 @@ protected theorem two_pow_pos (w : Nat) : 0 < 2^w := Nat.pos_pow_of_pos _ (by de
 instance {n m : Nat} [NeZero n] : NeZero (n^m) :=
   ⟨Nat.ne_zero_iff_zero_lt.mpr (Nat.pos_pow_of_pos m (pos_of_neZero _))⟩
 
+/--
+`a * b + c`. The runtime computes it without allocating an intermediate number for `a * b`.
+-/
+@[extern "lean_nat_mul_add"]
+protected def mulAdd (a b c : @& Nat) : Nat :=
+  a * b + c
+
+/--
+`b ^ e % m`. The runtime reduces modulo `m` after each multiplication, so `b ^ e` is never
+computed when `m ≠ 0`.
+-/
+@[extern "lean_nat_pow_mod"]
+protected def powMod (b e m : @& Nat) : Nat :=
+  b ^ e % m
+
 /-! # min/max -/
 
 /--
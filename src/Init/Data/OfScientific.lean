@@ -25,7 +25,12 @@ def Float.ofBinaryScientific (m : Nat) (e : Int) : Float :=
   let e := e + s
   m.toFloat.scaleB e
 
-protected opaque Float.ofScientific (m : Nat) (s : Bool) (e : Nat) : Float :=
+/--
+Computes `m * 10^e` if `s` is `false` and `m * 10^-e` otherwise, correctly rounded to the nearest
+`Float`. The native implementation uses the Eisel-Lemire algorithm for mantissas below `2^63`.
+-/
+@[extern "lean_float_of_scientific"]
+protected opaque Float.ofScientific (m : @& Nat) (s : Bool) (e : @& Nat) : Float :=
   if s then
     let s := 64 - m.log2 -- ensure we have 64 bits of mantissa left after division
     let m := (m <<< (3 * e + s)) / 5^e
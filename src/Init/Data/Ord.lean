@@ -173,6 +173,24 @@ instance : Ord USize where
 instance : Ord Char where
   compare x y := compareOfLessAndEq x y
 
+/-- Lexicographic comparison of byte arrays. -/
+@[extern "lean_byte_array_compare"]
+protected def ByteArray.compare (a b : @& ByteArray) : Ordering :=
+  let rec loop (i : Nat) : Ordering :=
+    if h₁ : i < a.size then
+      if h₂ : i < b.size then
+        match compare (a.get ⟨i, h₁⟩) (b.get ⟨i, h₂⟩) with
+        | .eq => loop (i+1)
+        | o   => o
+      else
+        .gt
+    else if i < b.size then .lt else .eq
+    termination_by a.size - i
+    decreasing_by decreasing_trivial_pre_omega
+  loop 0
+
+instance : Ord ByteArray := ⟨ByteArray.compare⟩
+
 instance [Ord α] : Ord (Option α) where
   compare
   | none,   none   => .eq
@@ -69,6 +69,15 @@ Example: `"abc".append "def" = "abcdef"`
 def append : String → (@& String) → String
   | ⟨a⟩, ⟨b⟩ => ⟨a ++ b⟩
 
+/--
+Returns `s` unchanged, but ensures that `n` more bytes can be appended to it without reallocating.
+
+The internal implementation will reuse the buffer of `s` if it is not shared and already large enough.
+-/
+@[extern "lean_string_reserve"]
+def reserve (s : String) (_n : @& Nat) : String :=
+  s
+
 /--
 Converts a string to a list of characters.
 
@@ -524,13 +533,29 @@ def str : String → Char → String := push
 @[inline] def isEmpty (s : String) : Bool :=
   s.endPos == 0
 
-@[inline] def join (l : List String) : String :=
+/--
+Concatenates a list of strings.
+
+The internal implementation computes the size of the result first and allocates it only once.
+
+Example: `String.join ["ab", "c", "de"] = "abcde"`
+-/
+@[extern "lean_string_join"]
+def join (l : @& List String) : String :=
   l.foldl (fun r s => r ++ s) ""
 
 @[inline] def singleton (c : Char) : String :=
   "".push c
 
-def intercalate (s : String) : List String → String
+/--
+Concatenates a list of strings, inserting `s` between any two consecutive elements.
+
+The internal implementation computes the size of the result first and allocates it only once.
+
+Example: `", ".intercalate ["a", "b", "c"] = "a, b, c"`
+-/
+@[extern "lean_string_intercalate"]
+def intercalate (s : @& String) : (@& List String) → String
   | []      => ""
   | a :: as => go a s as
 where go (acc : String) (s : String) : List String → String
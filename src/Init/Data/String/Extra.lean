@@ -76,9 +76,12 @@ where
   termination_by a.size - i
   decreasing_by exact Nat.sub_lt_sub_left ‹_› (Nat.lt_add_of_pos_right c.utf8Size_pos)
 
-/-- Converts a [UTF-8](https://en.wikipedia.org/wiki/UTF-8) encoded `ByteArray` string to `String`. -/
+/--
+Converts a [UTF-8](https://en.wikipedia.org/wiki/UTF-8) encoded `ByteArray` string to `String`.
+If `a` is not shared and has room for the terminating null byte, its buffer is reused.
+-/
 @[extern "lean_string_from_utf8_unchecked"]
-def fromUTF8 (a : @& ByteArray) (h : validateUTF8 a) : String :=
+def fromUTF8 (a : ByteArray) (h : validateUTF8 a) : String :=
   loop 0 ""
 where
   loop (i : Nat) (acc : String) : String :=
@@ -122,9 +125,12 @@ def utf8EncodeChar (c : Char) : List UInt8 :=
   cases Decidable.em (c.val ≤ 0x7ff) <;> simp [*]
   cases Decidable.em (c.val ≤ 0xffff) <;> simp [*]
 
-/-- Converts the given `String` to a [UTF-8](https://en.wikipedia.org/wiki/UTF-8) encoded byte array. -/
+/--
+Converts the given `String` to a [UTF-8](https://en.wikipedia.org/wiki/UTF-8) encoded byte array.
+If `a` is not shared, its buffer is reused.
+-/
 @[extern "lean_string_to_utf8"]
-def toUTF8 (a : @& String) : ByteArray :=
+def toUTF8 (a : String) : ByteArray :=
   ⟨⟨a.data.flatMap utf8EncodeChar⟩⟩
 
 @[simp] theorem size_toUTF8 (s : String) : s.toUTF8.size = s.utf8ByteSize := by
@@ -237,4 +243,41 @@ where
       have k := Nat.gt_of_not_le <| mt decide_eq_true h
       exact Nat.sub_lt_sub_left k (String.lt_next _ _)
 
+
+/--
+A buffer for building a string by repeated appends. Appending to a builder that is not shared
+updates its buffer in place with amortized growth, and `reserve` allocates room for upcoming appends up front.
+-/
+structure Builder where
+  /-- The string built so far. -/
+  toString : String
+  deriving Inhabited
+
+namespace Builder
+
+def empty : Builder := ⟨""⟩
+
+instance : EmptyCollection Builder := ⟨empty⟩
+
+/-- Creates an empty builder that can hold `n` bytes without reallocating. -/
+def mkWithCapacity (n : Nat) : Builder := ⟨"".reserve n⟩
+
+/-- Ensures that `n` more bytes can be appended to `b` without reallocating. -/
+@[inline] def reserve (b : Builder) (n : Nat) : Builder := ⟨b.toString.reserve n⟩
+
+@[inline] def append (b : Builder) (s : String) : Builder := ⟨b.toString ++ s⟩
+
+@[inline] def push (b : Builder) (c : Char) : Builder := ⟨b.toString.push c⟩
+
+/-- Appends all strings of `ss`, reserving room for all of them first. -/
+def appendList (b : Builder) (ss : List String) : Builder :=
+  let n := ss.foldl (fun n s => n + s.utf8ByteSize) 0
+  ⟨ss.foldl (· ++ ·) (b.toString.reserve n)⟩
+
+instance : Append Builder := ⟨fun b₁ b₂ => b₁.append b₂.toString⟩
+
+instance : ToString Builder := ⟨Builder.toString⟩
+
+end Builder
+
 end String
@@ -0,0 +1,331 @@
+/-
+Copyright (c) 2024 Lean FRO, LLC. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+-/
+prelude
+import Init.Data.Array.Basic
+import Init.Data.UInt.Basic
+import Init.Data.Option.Basic
+universe u
+
+/-!
+Arrays of unboxed `UInt32` and `UInt64` values. Like `ByteArray` and `FloatArray`, they are scalar
+arrays in the runtime, so reading and writing elements compiles to plain loads and stores without
+boxing or reference counting.
+-/
+
+structure UInt32Array where
+  data : Array UInt32
+
+attribute [extern "lean_uint32_array_mk"] UInt32Array.mk
+attribute [extern "lean_uint32_array_data"] UInt32Array.data
+
+namespace UInt32Array
+@[extern "lean_mk_empty_uint32_array"]
+def mkEmpty (c : @& Nat) : UInt32Array :=
+  { data := #[] }
+
+def empty : UInt32Array :=
+  mkEmpty 0
+
+instance : Inhabited UInt32Array where
+  default := empty
+
+instance : EmptyCollection UInt32Array where
+  emptyCollection := UInt32Array.empty
+
+@[extern "lean_uint32_array_push"]
+def push : UInt32Array → UInt32 → UInt32Array
+  | ⟨ds⟩, b => ⟨ds.push b⟩
+
+@[extern "lean_uint32_array_size"]
+def size : (@& UInt32Array) → Nat
+  | ⟨ds⟩ => ds.size
+
+@[extern "lean_sarray_size", simp]
+def usize (a : @& UInt32Array) : USize :=
+  a.size.toUSize
+
+@[extern "lean_uint32_array_uget"]
+def uget : (a : @& UInt32Array) → (i : USize) → i.toNat < a.size → UInt32
+  | ⟨ds⟩, i, h => ds[i]
+
+@[extern "lean_uint32_array_fget"]
+def get : (ds : @& UInt32Array) → (@& Fin ds.size) → UInt32
+  | ⟨ds⟩, i => ds.get i
+
+@[extern "lean_uint32_array_get"]
+def get! : (@& UInt32Array) → (@& Nat) → UInt32
+  | ⟨ds⟩, i => ds.get! i
+
+def get? (ds : UInt32Array) (i : Nat) : Option UInt32 :=
+  if h : i < ds.size then
+    ds.get ⟨i, h⟩
+  else
+    none
+
+instance : GetElem UInt32Array Nat UInt32 fun xs i => i < xs.size where
+  getElem xs i h := xs.get ⟨i, h⟩
+
+instance : GetElem UInt32Array USize UInt32 fun xs i => i.val < xs.size where
+  getElem xs i h := xs.uget i h
+
+@[extern "lean_uint32_array_uset"]
+def uset : (a : UInt32Array) → (i : USize) → UInt32 → i.toNat < a.size → UInt32Array
+  | ⟨ds⟩, i, v, h => ⟨ds.uset i v h⟩
+
+@[extern "lean_uint32_array_fset"]
+def set : (ds : UInt32Array) → (@& Fin ds.size) → UInt32 → UInt32Array
+  | ⟨ds⟩, i, d => ⟨ds.set i d⟩
+
+@[extern "lean_uint32_array_set"]
+def set! : UInt32Array → (@& Nat) → UInt32 → UInt32Array
+  | ⟨ds⟩, i, d => ⟨ds.set! i d⟩
+
+def isEmpty (s : UInt32Array) : Bool :=
+  s.size == 0
+
+partial def toList (ds : UInt32Array) : List UInt32 :=
+  let rec loop (i r) :=
+    if h : i < ds.size then
+      loop (i+1) (ds.get ⟨i, h⟩ :: r)
+    else
+      r.reverse
+  loop 0 []
+
+/-- See comment at `FloatArray.forInUnsafe` -/
+@[inline] unsafe def forInUnsafe {β : Type v} {m : Type v → Type w} [Monad m] (as : UInt32Array) (b : β) (f : UInt32 → β → m (ForInStep β)) : m β :=
+  let sz := as.usize
+  let rec @[specialize] loop (i : USize) (b : β) : m β := do
+    if i < sz then
+      let a := as.uget i lcProof
+      match (← f a b) with
+      | ForInStep.done  b => pure b
+      | ForInStep.yield b => loop (i+1) b
+    else
+      pure b
+  loop 0 b
+
+/-- Reference implementation for `forIn` -/
+@[implemented_by UInt32Array.forInUnsafe]
+protected def forIn {β : Type v} {m : Type v → Type w} [Monad m] (as : UInt32Array) (b : β) (f : UInt32 → β → m (ForInStep β)) : m β :=
+  let rec loop (i : Nat) (h : i ≤ as.size) (b : β) : m β := do
+    match i, h with
+    | 0,   _ => pure b
+    | i+1, h =>
+      have h' : i < as.size            := Nat.lt_of_lt_of_le (Nat.lt_succ_self i) h
+      have : as.size - 1 < as.size     := Nat.sub_lt (Nat.zero_lt_of_lt h') (by decide)
+      have : as.size - 1 - i < as.size := Nat.lt_of_le_of_lt (Nat.sub_le (as.size - 1) i) this
+      match (← f (as.get ⟨as.size - 1 - i, this⟩) b) with
+      | ForInStep.done b  => pure b
+      | ForInStep.yield b => loop i (Nat.le_of_lt h') b
+  loop as.size (Nat.le_refl _) b
+
+instance : ForIn m UInt32Array UInt32 where
+  forIn := UInt32Array.forIn
+
+/-- See comment at `FloatArray.forInUnsafe` -/
+@[inline]
+unsafe def foldlMUnsafe {β : Type v} {m : Type v → Type w} [Monad m] (f : β → UInt32 → m β) (init : β) (as : UInt32Array) (start := 0) (stop := as.size) : m β :=
+  let rec @[specialize] fold (i : USize) (stop : USize) (b : β) : m β := do
+    if i == stop then
+      pure b
+    else
+      fold (i+1) stop (← f b (as.uget i lcProof))
+  if start < stop then
+    if stop ≤ as.size then
+      fold (USize.ofNat start) (USize.ofNat stop) init
+    else
+      pure init
+  else
+    pure init
+
+/-- Reference implementation for `foldlM` -/
+@[implemented_by foldlMUnsafe]
+def foldlM {β : Type v} {m : Type v → Type w} [Monad m] (f : β → UInt32 → m β) (init : β) (as : UInt32Array) (start := 0) (stop := as.size) : m β :=
+  let fold (stop : Nat) (h : stop ≤ as.size) :=
+    let rec loop (i : Nat) (j : Nat) (b : β) : m β := do
+      if hlt : j < stop then
+        match i with
+        | 0    => pure b
+        | i'+1 =>
+          loop i' (j+1) (← f b (as.get ⟨j, Nat.lt_of_lt_of_le hlt h⟩))
+      else
+        pure b
+    loop (stop - start) start init
+  if h : stop ≤ as.size then
+    fold stop h
+  else
+    fold as.size (Nat.le_refl _)
+
+@[inline]
+def foldl {β : Type v} (f : β → UInt32 → β) (init : β) (as : UInt32Array) (start := 0) (stop := as.size) : β :=
+  Id.run <| as.foldlM f init start stop
+
+end UInt32Array
+
+def List.toUInt32Array (ds : List UInt32) : UInt32Array :=
+  let rec loop
+    | [],    r => r
+    | b::ds, r => loop ds (r.push b)
+  loop ds UInt32Array.empty
+
+instance : ToString UInt32Array := ⟨fun ds => ds.toList.toString⟩
+
+structure UInt64Array where
+  data : Array UInt64
+
+attribute [extern "lean_uint64_array_mk"] UInt64Array.mk
+attribute [extern "lean_uint64_array_data"] UInt64Array.data
+
+namespace UInt64Array
+@[extern "lean_mk_empty_uint64_array"]
+def mkEmpty (c : @& Nat) : UInt64Array :=
+  { data := #[] }
+
+def empty : UInt64Array :=
+  mkEmpty 0
+
+instance : Inhabited UInt64Array where
+  default := empty
+
+instance : EmptyCollection UInt64Array where
+  emptyCollection := UInt64Array.empty
+
+@[extern "lean_uint64_array_push"]
+def push : UInt64Array → UInt64 → UInt64Array
+  | ⟨ds⟩, b => ⟨ds.push b⟩
+
+@[extern "lean_uint64_array_size"]
+def size : (@& UInt64Array) → Nat
+  | ⟨ds⟩ => ds.size
+
+@[extern "lean_sarray_size", simp]
+def usize (a : @& UInt64Array) : USize :=
+  a.size.toUSize
+
+@[extern "lean_uint64_array_uget"]
+def uget : (a : @& UInt64Array) → (i : USize) → i.toNat < a.size → UInt64
+  | ⟨ds⟩, i, h => ds[i]
+
+@[extern "lean_uint64_array_fget"]
+def get : (ds : @& UInt64Array) → (@& Fin ds.size) → UInt64
+  | ⟨ds⟩, i => ds.get i
+
+@[extern "lean_uint64_array_get"]
+def get! : (@& UInt64Array) → (@& Nat) → UInt64
+  | ⟨ds⟩, i => ds.get! i
+
+def get? (ds : UInt64Array) (i : Nat) : Option UInt64 :=
+  if h : i < ds.size then
+    ds.get ⟨i, h⟩
+  else
+    none
+
+instance : GetElem UInt64Array Nat UInt64 fun xs i => i < xs.size where
+  getElem xs i h := xs.get ⟨i, h⟩
+
+instance : GetElem UInt64Array USize UInt64 fun xs i => i.val < xs.size where
+  getElem xs i h := xs.uget i h
+
+@[extern "lean_uint64_array_uset"]
+def uset : (a : UInt64Array) → (i : USize) → UInt64 → i.toNat < a.size → UInt64Array
+  | ⟨ds⟩, i, v, h => ⟨ds.uset i v h⟩
+
+@[extern "lean_uint64_array_fset"]
+def set : (ds : UInt64Array) → (@& Fin ds.size) → UInt64 → UInt64Array
+  | ⟨ds⟩, i, d => ⟨ds.set i d⟩
+
+@[extern "lean_uint64_array_set"]
+def set! : UInt64Array → (@& Nat) → UInt64 → UInt64Array
+  | ⟨ds⟩, i, d => ⟨ds.set! i d⟩
+
+def isEmpty (s : UInt64Array) : Bool :=
+  s.size == 0
+
+partial def toList (ds : UInt64Array) : List UInt64 :=
+  let rec loop (i r) :=
+    if h : i < ds.size then
+      loop (i+1) (ds.get ⟨i, h⟩ :: r)
+    else
+      r.reverse
+  loop 0 []
+
+/-- See comment at `FloatArray.forInUnsafe` -/
+@[inline] unsafe def forInUnsafe {β : Type v} {m : Type v → Type w} [Monad m] (as : UInt64Array) (b : β) (f : UInt64 → β → m (ForInStep β)) : m β :=
+  let sz := as.usize
+  let rec @[specialize] loop (i : USize) (b : β) : m β := do
+    if i < sz then
+      let a := as.uget i lcProof
+      match (← f a b) with
+      | ForInStep.done  b => pure b
+      | ForInStep.yield b => loop (i+1) b
+    else
+      pure b
+  loop 0 b
+
+/-- Reference implementation for `forIn` -/
+@[implemented_by UInt64Array.forInUnsafe]
+protected def forIn {β : Type v} {m : Type v → Type w} [Monad m] (as : UInt64Array) (b : β) (f : UInt64 → β → m (ForInStep β)) : m β :=
+  let rec loop (i : Nat) (h : i ≤ as.size) (b : β) : m β := do
+    match i, h with
+    | 0,   _ => pure b
+    | i+1, h =>
+      have h' : i < as.size            := Nat.lt_of_lt_of_le (Nat.lt_succ_self i) h
+      have : as.size - 1 < as.size     := Nat.sub_lt (Nat.zero_lt_of_lt h') (by decide)
+      have : as.size - 1 - i < as.size := Nat.lt_of_le_of_lt (Nat.sub_le (as.size - 1) i) this
+      match (← f (as.get ⟨as.size - 1 - i, this⟩) b) with
+      | ForInStep.done b  => pure b
+      | ForInStep.yield b => loop i (Nat.le_of_lt h') b
+  loop as.size (Nat.le_refl _) b
+
+instance : ForIn m UInt64Array UInt64 where
+  forIn := UInt64Array.forIn
+
+/-- See comment at `FloatArray.forInUnsafe` -/
+@[inline]
+unsafe def foldlMUnsafe {β : Type v} {m : Type v → Type w} [Monad m] (f : β → UInt64 → m β) (init : β) (as : UInt64Array) (start := 0) (stop := as.size) : m β :=
+  let rec @[specialize] fold (i : USize) (stop : USize) (b : β) : m β := do
+    if i == stop then
+      pure b
+    else
+      fold (i+1) stop (← f b (as.uget i lcProof))
+  if start < stop then
+    if stop ≤ as.size then
+      fold (USize.ofNat start) (USize.ofNat stop) init
+    else
+      pure init
+  else
+    pure init
+
+/-- Reference implementation for `foldlM` -/
+@[implemented_by foldlMUnsafe]
+def foldlM {β : Type v} {m : Type v → Type w} [Monad m] (f : β → UInt64 → m β) (init : β) (as : UInt64Array) (start := 0) (stop := as.size) : m β :=
+  let fold (stop : Nat) (h : stop ≤ as.size) :=
+    let rec loop (i : Nat) (j : Nat) (b : β) : m β := do
+      if hlt : j < stop then
+        match i with
+        | 0    => pure b
+        | i'+1 =>
+          loop i' (j+1) (← f b (as.get ⟨j, Nat.lt_of_lt_of_le hlt h⟩))
+      else
+        pure b
+    loop (stop - start) start init
+  if h : stop ≤ as.size then
+    fold stop h
+  else
+    fold as.size (Nat.le_refl _)
+
+@[inline]
+def foldl {β : Type v} (f : β → UInt64 → β) (init : β) (as : UInt64Array) (start := 0) (stop := as.size) : β :=
+  Id.run <| as.foldlM f init start stop
+
+end UInt64Array
+
+def List.toUInt64Array (ds : List UInt64) : UInt64Array :=
+  let rec loop
+    | [],    r => r
+    | b::ds, r => loop ds (r.push b)
+  loop ds UInt64Array.empty
+
+instance : ToString UInt64Array := ⟨fun ds => ds.toList.toString⟩
@@ -261,8 +261,30 @@ namespace NameGenerator
 @[inline] def next (g : NameGenerator) : NameGenerator :=
   { g with idx := g.idx + 1 }
 
+/--
+Number of indices reserved for each generator created by `mkChild` without extending the prefix. A
+generator is assumed to produce fewer names than this. As `childIdxRange ^ 2 = 2 ^ 62`, all indices
+are scalars on 64-bit platforms.
+-/
+def childIdxRange : Nat := 2147483648
+
+/--
+Returns a child generator together with the updated parent. The names produced by the child are
+distinct from those of the parent and of any other child.
+
+A generator whose index is below `childIdxRange`, such as the one of a command, hands out flat
+children under the same prefix: the child allocated at index `i` owns the indices
+`[i * childIdxRange, (i + 1) * childIdxRange)`, which lie above the indices of the parent. Thus the
+names of generators used by parallel tasks stay `_uniq.<idx>`, which keeps creating, hashing and
+comparing `FVarId`s and `MVarId`s cheap. Generators owning such a range in turn create children
+under the prefix `<prefix>.<idx>`, whose indices start at `1` again, so that indices never exceed
+`childIdxRange ^ 2`.
+-/
 @[inline] def mkChild (g : NameGenerator) : NameGenerator × NameGenerator :=
-  ({ namePrefix := Name.mkNum g.namePrefix g.idx, idx := 1 },
+  (if 0 < g.idx && g.idx < childIdxRange then
+     { g with idx := g.idx * childIdxRange }
+   else
+     { namePrefix := Name.mkNum g.namePrefix g.idx, idx := 1 },
    { g with idx := g.idx + 1 })
 
 end NameGenerator
@@ -110,3 +110,22 @@ Remark: it optimizes the number of RC operations, and the strategy for caching r
 -/
 @[extern "lean_sharecommon_quick"]
 def ShareCommon.shareCommon' (a : @& α) : α := a
+
+/--
+Parallel version of `ShareCommon.shareCommon'` for very large values. It produces a value with the
+same sharing, but values with many subobjects are split into parts that are processed by
+different threads.
+-/
+@[extern "lean_sharecommon_parallel"]
+def ShareCommon.shareCommonParallel (a : @& α) : α := a
+
+/--
+Similar to `ShareCommon.shareCommon'`, but uses a process-wide hash-consing table shared by all
+threads instead of a local one. Thus, structurally equal values shared by independent calls
+(e.g., in different elaboration tasks) become pointer equal.
+
+The table only keeps the values that are still referenced elsewhere alive,
+see `Lean.ShareCommon.pruneGlobal`.
+-/
+@[extern "lean_sharecommon_global"]
+def ShareCommon.shareCommonGlobal (a : @& α) : α := a
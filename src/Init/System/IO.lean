@@ -93,6 +93,39 @@ set_option compiler.extract_closed false in
 @[extern "lean_io_timeit"] opaque timeit (msg : @& String) (fn : IO α) : IO α
 @[extern "lean_io_allocprof"] opaque allocprof (msg : @& String) (fn : IO α) : IO α
 
+/--
+Sets the average number of small-object allocations between two samples of the heap profiler.
+A rate of `0` (the default unless `LEAN_HEAP_PROFILE_RATE` is set) disables sampling.
+-/
+@[extern "lean_io_set_heap_profile_rate"] opaque setHeapProfileRate (rate : USize) : BaseIO Unit
+/-- Returns a human-readable summary of the live objects sampled by the heap profiler, by kind and size class. -/
+@[extern "lean_io_heap_profile_summary"] opaque heapProfileSummary : BaseIO String
+/-- Writes the live objects sampled by the heap profiler to `fname` in the legacy `pprof` heap profile format. -/
+@[extern "lean_io_heap_profile_dump"] opaque heapProfileDump (fname : @& FilePath) : IO Unit
+
+/-- A call stack of a thread recorded by the sampling profiler (see `IO.startSampling`). -/
+structure IO.ProfileSample where
+  /--
+  Native frames, outermost first: demangled C++ symbols, mangled C symbols of compiled Lean
+  functions (see `Lean.Name.demangle?`), or addresses of code without symbol information.
+  -/
+  native      : Array String
+  /-- Functions executed by the IR interpreter on this thread, outermost first. -/
+  interpreted : Array Name
+  /-- Time at which the sample was taken, in the clock of `IO.monoNanosNow`. -/
+  time        : UInt64
+  /-- Index of the sampled thread. The thread that started sampling has index `0`. -/
+  thread      : UInt32
+
+/--
+Starts the sampling profiler, which records the call stack of the running thread every
+`intervalUs` microseconds of CPU time, up to the resolution of the operating system's timer.
+Throws an error if the profiler is already running or not supported on this platform.
+-/
+@[extern "lean_io_start_sampling"] opaque IO.startSampling (intervalUs : UInt32) : IO Unit
+/-- Stops the sampling profiler and returns the samples recorded since `IO.startSampling`. -/
+@[extern "lean_io_stop_sampling"] opaque IO.stopSampling : IO (Array IO.ProfileSample)
+
 /-- Programs can execute IO actions during initialization that occurs before
    the `main` function is executed. The attribute `[init <action>]` specifies
    which IO action is executed to set the value of an opaque constant.
@@ -249,6 +282,67 @@ instance : ToString TaskState := ⟨TaskState.toString⟩
 @[inline] def hasFinished (task : Task α) : BaseIO Bool := do
   return (← getTaskState task) matches .finished
 
+/--
+Histogram of the task manager's telemetry. `buckets[i]` counts the values in `[2^(i-1), 2^i)` for
+`i > 0`, `buckets[0]` counts zeros, and the last bucket also counts all larger values.
+-/
+structure TaskManagerStats.Histogram where
+  count   : Nat
+  /-- Sum of all values. -/
+  total   : Nat
+  buckets : Array Nat
+  deriving Inhabited, Repr
+
+/-- Telemetry of the runtime's task manager, see `IO.getTaskManagerStats`. -/
+structure TaskManagerStats where
+  /-- Number of worker threads for tasks of priority at most `Task.Priority.max`. -/
+  workers          : Nat
+  /-- Number of workers currently waiting for tasks to run. -/
+  idleWorkers      : Nat
+  /-- Number of running tasks of priority `Task.Priority.dedicated`, which have their own threads. -/
+  dedicatedWorkers : Nat
+  /-- Number of tasks waiting for a worker. -/
+  queued           : Nat
+  /-- Number of threads blocked in `Task.get`, `IO.wait`, or `IO.waitAny`. -/
+  waiting          : Nat
+  /--
+  Time in microseconds between queuing a task, i.e. when it is spawned or its dependencies are
+  finished, and running it, by priority. The last entry is for dedicated and interactive tasks.
+  -/
+  queueLatency     : Array TaskManagerStats.Histogram
+  /-- Run time of tasks in microseconds. -/
+  runTime          : TaskManagerStats.Histogram
+  /-- Number of dependent tasks (e.g. of `Task.map` and `Task.bind`) released by each finished task. -/
+  dependents       : TaskManagerStats.Histogram
+  deriving Inhabited, Repr
+
+/--
+Returns the current state of the task manager and statistics about all tasks run so far. All
+numbers are zero if there is no task manager, i.e. if tasks are run synchronously.
+-/
+@[extern "lean_io_get_task_manager_stats"] opaque getTaskManagerStats : BaseIO TaskManagerStats
+
+/--
+A task run recorded between `IO.startTaskTracing` and `IO.stopTaskTracing`. `Task.bind` tasks are
+run twice: first their function, then once the task returned by it has finished.
+-/
+structure TaskEvent where
+  /-- Index of the thread that ran the task, in order of the threads' first recorded task. -/
+  thread   : Nat
+  /-- Priority of the task, with `Task.Priority.max + 1` for dedicated and interactive tasks. -/
+  prio     : Nat
+  /-- Time the task was queued, in the clock of `IO.monoNanosNow`. -/
+  enqueued : UInt64
+  /-- Time the task started running. -/
+  start    : UInt64
+  /-- Time the task finished running. -/
+  stop     : UInt64
+
+/-- Starts recording the tasks run by the task manager. -/
+@[extern "lean_io_start_task_tracing"] opaque startTaskTracing : BaseIO Unit
+/-- Stops recording the tasks run by the task manager and returns the recorded ones. -/
+@[extern "lean_io_stop_task_tracing"] opaque stopTaskTracing : BaseIO (Array TaskEvent)
+
 /-- Wait for the task to finish, then return its result. -/
 @[extern "lean_io_wait"] opaque wait (t : Task α) : BaseIO α :=
   return t.get
@@ -268,6 +362,26 @@ from a snapshot.
 -/
 @[extern "lean_io_add_heartbeats"] opaque addHeartbeats (count : UInt64) : BaseIO Unit
 
+/--
+Total size in bytes of the objects allocated by the current task and by the tasks spawned while it
+was running, which share its memory account with their own descendants. This counts all
+allocations, not the memory that is still in use. Allocations of the other tasks sharing the
+account are only included up to their last call of `IO.checkCanceled`. Returns `0` outside of
+tasks, or if the runtime was built without its small object allocator.
+-/
+@[extern "lean_io_get_task_allocated_bytes"] opaque getTaskAllocatedBytes : BaseIO Nat
+
+/--
+Sets a soft limit on the bytes allocated per memory account (see `IO.getTaskAllocatedBytes`), `0`
+to disable it. A task whose account exceeds the limit is canceled as if by `IO.cancel` when it next
+calls `IO.checkCanceled` or the runtime checks its memory use, so it must react to cancellation to
+be stopped.
+-/
+@[extern "lean_io_set_task_memory_limit"] opaque setTaskMemoryLimit (bytes : UInt64) : BaseIO Unit
+
+/-- Resident set size of the process in bytes, or `0` if it cannot be determined. -/
+@[extern "lean_io_get_resident_memory"] opaque getResidentMemory : BaseIO Nat
+
 /--
 The mode of a file handle (i.e., a set of `open` flags and an `fdopen` mode).
 
@@ -332,6 +446,13 @@ inductive FS.Mode where
 
 opaque FS.Handle : Type := Unit
 
+/--
+A read-only view of the contents of a file, which is mapped into memory instead of being read in full.
+Pages of the file are only loaded when accessed, making this suitable for random access to large files.
+The file must not be modified while it is mapped.
+-/
+opaque FS.MappedFile : Type := Unit
+
 /--
   A pure-Lean abstraction of POSIX streams. We use `Stream`s for the standard streams stdin/stdout/stderr so we can
   capture output of `#eval` commands into memory. -/
@@ -423,6 +544,12 @@ If the returned array is empty, an end-of-file marker has been reached.
 Note that EOF does not actually close a handle, so further reads may block and return more data.
 -/
 @[extern "lean_io_prim_handle_read"] opaque read (h : @& Handle) (bytes : USize) : IO ByteArray
+/--
+Like `read`, but returns the bytes in `buf`, discarding its previous contents. If `buf` is not shared
+and large enough, its storage is reused instead of allocating a new array.
+-/
+@[extern "lean_io_prim_handle_read_into"]
+opaque readInto (h : @& Handle) (buf : ByteArray) (bytes : USize) : IO ByteArray
 @[extern "lean_io_prim_handle_write"] opaque write (h : @& Handle) (buffer : @& ByteArray) : IO Unit
 
 /--
@@ -435,6 +562,22 @@ Note that EOF does not actually close a handle, so further reads may block and r
 
 end Handle
 
+namespace MappedFile
+/-- Maps the file at `fn`. The mapping is released when the `MappedFile` is no longer referenced. -/
+@[extern "lean_io_mapped_file_mk"] opaque mk (fn : @& FilePath) : IO MappedFile
+/-- The size of the file in bytes. -/
+@[extern "lean_io_mapped_file_size"] opaque size (f : @& MappedFile) : Nat
+/-- The byte at offset `i`, or `0` if `i` is out of bounds. -/
+@[extern "lean_io_mapped_file_get"] opaque get (f : @& MappedFile) (i : @& Nat) : UInt8
+/-- The little-endian 32-bit number at offset `i`, or `0` if it is not entirely in bounds. -/
+@[extern "lean_io_mapped_file_get_uint32_le"] opaque getUInt32LE (f : @& MappedFile) (i : @& Nat) : UInt32
+/-- Copies the bytes from offset `start` up to (excluding) `stop` into a new array, clamped to the file size. -/
+@[extern "lean_io_mapped_file_extract"] opaque extract (f : @& MappedFile) (start stop : @& Nat) : ByteArray
+
+def toByteArray (f : MappedFile) : ByteArray :=
+  f.extract 0 f.size
+end MappedFile
+
 /--
 Resolves a pathname to an absolute pathname with no '.', '..', or symbolic links.
 
@@ -535,6 +678,43 @@ def writeFile (fname : FilePath) (content : String) : IO Unit := do
 def Stream.putStrLn (strm : FS.Stream) (s : String) : IO Unit :=
   strm.putStr (s.push '\n')
 
+/-- State for rendering a `Format` to a stream, see `Stream.putFormat`. -/
+private structure FormatStreamState where
+  buffer : String := ""
+  column : Nat    := 0
+
+private abbrev FormatStreamM := ReaderT FS.Stream (StateT FormatStreamState IO)
+
+/-- Number of bytes of output that `Stream.putFormat` buffers before writing them to the stream. -/
+private def formatChunkSize : Nat := 65536
+
+/-- Appends `s` to the buffer and moves to column `column?`, or to the end of `s` if it is `none`. -/
+private def FormatStreamM.push (s : String) (column? : Option Nat) : FormatStreamM Unit := do
+  let (buffer, column) ← modifyGet fun st => ((st.buffer, st.column), { st with buffer := "" })
+  let buffer := buffer ++ s
+  let column := column?.getD (column + s.length)
+  if buffer.utf8ByteSize ≥ formatChunkSize then
+    (← read).putStr buffer
+    set ({ column } : FormatStreamState)
+  else
+    set ({ buffer, column } : FormatStreamState)
+
+instance : Std.Format.MonadPrettyFormat FormatStreamM where
+  pushOutput s       := FormatStreamM.push s none
+  pushNewline indent := FormatStreamM.push ("\n".pushn ' ' indent) (some indent)
+  currColumn         := return (← get).column
+  startTag _         := return ()
+  endTags _          := return ()
+
+/--
+Renders `f` like `Std.Format.pretty` and writes the output to `strm` in chunks as it is produced,
+without materializing the whole output.
+-/
+def Stream.putFormat (strm : FS.Stream) (f : Std.Format) (width := Std.Format.defWidth)
+    (indent := 0) : IO Unit := do
+  let ((), st) ← (Std.Format.prettyM f width indent : FormatStreamM Unit).run strm |>.run {}
+  strm.putStr st.buffer
+
 structure DirEntry where
   root     : FilePath
   fileName : String
@@ -575,6 +755,14 @@ open IO
 @[extern "lean_io_read_dir"]
 opaque readDir : @& FilePath → IO (Array IO.FS.DirEntry)
 
+/--
+Like `readDir`, but also returns the type of each entry without following symbolic links. On most
+file systems, the type is part of the directory listing, so this is much cheaper than calling
+`metadata` on each entry.
+-/
+@[extern "lean_io_read_dir_with_file_types"]
+opaque readDirWithFileTypes : @& FilePath → IO (Array (IO.FS.DirEntry × IO.FS.FileType))
+
 @[extern "lean_io_metadata"]
 opaque metadata : @& FilePath → IO IO.FS.Metadata
 
@@ -595,20 +783,18 @@ where
   go p := do
     if !(← enter p) then
       return ()
-    for d in (← p.readDir) do
+    for (d, type) in (← p.readDirWithFileTypes) do
       modify (·.push d.path)
-      match (← d.path.metadata.toBaseIO) with
-      | .ok { type := .symlink, .. } =>
+      match type with
+      | .dir => go d.path
+      -- only the targets of symbolic links need a separate `stat` call
+      | .symlink =>
         let p' ← FS.realPath d.path
         if (← p'.isDir) then
           -- do not call `enter` on a non-directory symlink
           if (← enter p) then
             go p'
-      | .ok { type := .dir, .. } => go d.path
-      | .ok _ => pure ()
-      -- entry vanished, ignore
-      | .error (.noFileOrDirectory ..) => pure ()
-      | .error e => throw e
+      | _ => pure ()
 
 end System.FilePath
 
@@ -634,6 +820,13 @@ def readFile (fname : FilePath) : IO String := do
   | some s => return s
   | none => throw <| .userError s!"Tried to read file '{fname}' containing non UTF-8 data."
 
+/--
+Returns `hash (← readBinFile fname)` or, if `text`, `hash (← readFile fname).crlfToLf`, without
+copying the file into a Lean object: regular files are memory-mapped where possible.
+-/
+@[extern "lean_io_hash_file"]
+opaque hashFile (fname : @& FilePath) (text := false) : IO UInt64
+
 end FS
 
 def withStdin [Monad m] [MonadFinally m] [MonadLiftT BaseIO m] (h : FS.Stream) (x : m α) : m α := do
@@ -743,6 +936,15 @@ structure SpawnArgs extends StdioConfig where
   cwd : Option FilePath := none
   /-- Add or remove environment variables for the process. -/
   env : Array (String × Option String) := #[]
+  /-- Use this handle as the process' stdin instead of the inherited one, e.g. the piped stdout of another child.
+    Only used if `stdin` is `Stdio.inherit`. -/
+  stdinFrom? : Option FS.Handle := none
+  /-- Use this handle as the process' stdout instead of the inherited one, e.g. a file or the piped stdin of
+    another child. Only used if `stdout` is `Stdio.inherit`. -/
+  stdoutTo? : Option FS.Handle := none
+  /-- Use this handle as the process' stderr instead of the inherited one. Only used if `stderr` is
+    `Stdio.inherit`. -/
+  stderrTo? : Option FS.Handle := none
   /-- Start process in new session and process group using `setsid`. Currently a no-op on non-POSIX platforms. -/
   setsid : Bool := false
 
@@ -783,16 +985,23 @@ structure Output where
   stdout   : String
   stderr   : String
 
+/--
+Read from the piped `stdout` and `stderr` of a child process at the same time until both are closed, and return
+their contents. Unlike reading them one after the other, this cannot block on a full pipe, and it needs no task
+per handle. If `maxBytes?` is `some n`, at most `n` bytes of each stream are kept and the rest is discarded.
+Data already buffered in the handles by earlier reads is not included.
+-/
+@[extern "lean_io_process_collect_output"]
+opaque collectOutput (stdout stderr : @& FS.Handle) (maxBytes? : @& Option Nat := none) : IO (String × String)
+
 /--
 Run process to completion and capture output.
 The process does not inherit the standard input of the caller.
 -/
 def output (args : SpawnArgs) : IO Output := do
   let child ← spawn { args with stdout := .piped, stderr := .piped, stdin := .null }
-  let stdout ← IO.asTask child.stdout.readToEnd Task.Priority.dedicated
-  let stderr ← child.stderr.readToEnd
+  let (stdout, stderr) ← collectOutput child.stdout child.stderr
   let exitCode ← child.wait
-  let stdout ← IO.ofExcept stdout.get
   pure { exitCode := exitCode, stdout := stdout, stderr := stderr }
 
 /-- Run process to completion and return stdout on success. -/
@@ -857,9 +1066,14 @@ namespace CancelToken
 def new : BaseIO CancelToken :=
   CancelToken.mk <$> IO.mkRef false
 
+/-- Makes threads running native code inspect their cancellation tokens and scopes again. -/
+@[extern "lean_io_request_attention"]
+private opaque requestAttention : BaseIO Unit
+
 /-- Activates a cancellation token. Idempotent. -/
-def set (tk : CancelToken) : BaseIO Unit :=
+def set (tk : CancelToken) : BaseIO Unit := do
   tk.ref.set true
+  requestAttention
 
 /-- Checks whether the cancellation token has been activated. -/
 def isSet (tk : CancelToken) : BaseIO Bool :=
@@ -871,6 +1085,60 @@ private def isSetExport := @isSet
 
 end CancelToken
 
+private opaque CancelScopeImpl : NonemptyType.{0}
+
+/--
+Scope for structured cancellation of tasks. Tasks spawned while `CancelScope.run s act` is running,
+and transitively the tasks spawned by them, belong to `s`. Canceling `s` cancels all of them:
+`IO.checkCanceled` returns `true` in these tasks, and the kernel and `Lean.Core.checkSystem` throw
+an interrupt exception in them. A scope created while running in another scope is canceled
+together with it.
+
+Unlike `IO.cancel`, canceling a scope also reaches tasks that are not dependents of a canceled task.
+-/
+def CancelScope : Type := CancelScopeImpl.type
+
+instance : Nonempty CancelScope := CancelScopeImpl.property
+
+namespace CancelScope
+
+/-- Creates a new cancellation scope, nested in the scope of the current task or thread, if any. -/
+@[extern "lean_io_cancel_scope_new"]
+opaque new : BaseIO CancelScope
+
+/-- Cancels the scope and all scopes nested in it. Idempotent. -/
+@[extern "lean_io_cancel_scope_cancel"]
+opaque cancel (s : @& CancelScope) : BaseIO Unit
+
+/-- Checks whether the scope or one of its enclosing scopes has been canceled. -/
+@[extern "lean_io_cancel_scope_is_canceled"]
+opaque isCanceled (s : @& CancelScope) : BaseIO Bool
+
+/-- Runs `act` in the scope `s`, so that the tasks spawned by `act` belong to `s`. -/
+@[extern "lean_io_cancel_scope_run"]
+opaque run (s : @& CancelScope) (act : BaseIO α) : BaseIO α
+
+end CancelScope
+
+/--
+Checks whether the cancellation scope of the current task or thread has been canceled. Unlike
+`IO.checkCanceled`, this ignores `IO.cancel` on the current task.
+-/
+@[extern "lean_io_check_cancel_scope"]
+opaque checkCancelScope : BaseIO Bool
+
+/--
+Runs `act` in a new cancellation scope, which is passed to `act`. The scope is canceled when `act`
+returns or throws, so tasks spawned by `act` that are still running are asked to stop.
+-/
+def withCancelScope (act : CancelScope → IO α) : IO α := do
+  let s ← CancelScope.new
+  let r ← s.run (act s).toBaseIO
+  s.cancel
+  match r with
+  | .ok a    => pure a
+  | .error e => throw e
+
 namespace FS
 namespace Stream
 
@@ -883,6 +1151,19 @@ def ofHandle (h : Handle) : Stream where
   putStr  := Handle.putStr h
   isTty   := Handle.isTty h
 
+/--
+Like `ofHandle`, but `read` reuses the array returned by the previous call if it has not been
+retained by the caller, avoiding an allocation per call when streaming a file in chunks.
+-/
+def ofHandleReusing (h : Handle) : BaseIO Stream := do
+  let last ← IO.mkRef ByteArray.empty
+  return { ofHandle h with
+    read := fun n => do
+      -- take the array out of the reference so that it is not shared unless the caller retained it
+      let buf ← h.readInto (← last.swap .empty) n
+      last.set buf
+      return buf }
+
 structure Buffer where
   data : ByteArray := ByteArray.empty
   pos  : Nat := 0
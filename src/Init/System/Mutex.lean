@@ -33,6 +33,13 @@ Reentrant locking is undefined behavior (inherited from the C++ implementation).
 @[extern "lean_io_basemutex_lock"]
 opaque BaseMutex.lock (mutex : @& BaseMutex) : BaseIO Unit
 
+/--
+Locks a `BaseMutex` if no other thread has locked it, without waiting.
+Returns `true` if the mutex was locked.
+-/
+@[extern "lean_io_basemutex_try_lock"]
+opaque BaseMutex.tryLock (mutex : @& BaseMutex) : BaseIO Bool
+
 /--
 Unlocks a `BaseMutex`.
 
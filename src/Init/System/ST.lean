@@ -94,6 +94,22 @@ def Ref.modifyGet {σ α β : Type} (r : Ref σ α) (f : α → β × α) : ST 
   Ref.set r a
   pure b
 
+/--
+Atomically replaces the value `a` of `r` with the second component of `f a`, and returns the first one.
+Unlike `Ref.modifyGet`, other threads can still read `r` while `f` is running. In exchange, `f` may be
+called several times when other threads write to `r` concurrently, and the value is never updated in place.
+-/
+@[extern "lean_st_ref_modify_get_atomic"]
+def Ref.modifyGetAtomic {σ α β : Type} (r : @& Ref σ α) (f : α → β × α) : ST σ β := do
+  let v ← Ref.get r
+  let (b, a) := f v
+  Ref.set r a
+  pure b
+
+/-- Atomically replaces the value `a` of `r` with `f a`, see `Ref.modifyGetAtomic`. -/
+@[inline] def Ref.modifyAtomic {σ α : Type} (r : Ref σ α) (f : α → α) : ST σ Unit :=
+  Ref.modifyGetAtomic r fun a => ((), f a)
+
 end Prim
 
 section
@@ -107,6 +123,8 @@ variable {σ : Type} {m : Type → Type} [Monad m] [MonadLiftT (ST σ) m]
 @[inline] def Ref.ptrEq {α : Type} (r1 r2 : Ref σ α) : m Bool := liftM <| Prim.Ref.ptrEq r1 r2
 @[inline] def Ref.modify {α : Type} (r : Ref σ α) (f : α → α) : m Unit := liftM <| Prim.Ref.modify r f
 @[inline] def Ref.modifyGet {α : Type} {β : Type} (r : Ref σ α) (f : α → β × α) : m β := liftM <| Prim.Ref.modifyGet r f
+@[inline] def Ref.modifyAtomic {α : Type} (r : Ref σ α) (f : α → α) : m Unit := liftM <| Prim.Ref.modifyAtomic r f
+@[inline] def Ref.modifyGetAtomic {α : Type} {β : Type} (r : Ref σ α) (f : α → β × α) : m β := liftM <| Prim.Ref.modifyGetAtomic r f
 
 def Ref.toMonadStateOf (r : Ref σ α) : MonadStateOf α m where
   get := r.get
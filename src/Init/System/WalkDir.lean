@@ -0,0 +1,54 @@
+/-
+Copyright (c) 2024 Lean FRO, LLC. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+-/
+prelude
+import Init.System.IO
+import Init.Data.Channel
+
+namespace System.FilePath
+open IO
+
+/--
+Sends all filesystem entries that `walkDir p enter` returns on `ch`, listing different directories
+in parallel tasks. The entries of each directory are sent after the directory itself, but entries
+of different directories may be interleaved arbitrarily, and `enter` may be called concurrently.
+Closes `ch` once the traversal is complete. The returned task fails with the first error
+encountered, after all other directories have been traversed.
+-/
+partial def walkDirAsync (p : FilePath) (ch : IO.Channel FilePath)
+    (enter : FilePath → IO Bool := fun _ => pure true) (prio := Task.Priority.default) :
+    BaseIO (Task (Except IO.Error Unit)) := do
+  let t ← spawn p
+  BaseIO.mapTask (t := t) (prio := prio) (sync := true) fun r => do
+    ch.close
+    return r
+where
+  spawn (p : FilePath) : BaseIO (Task (Except IO.Error Unit)) := do
+    BaseIO.bindTask (← BaseIO.asTask (go p) prio) pure (sync := true)
+  go (p : FilePath) : BaseIO (Task (Except IO.Error Unit)) := do
+    match (← (visit p).toBaseIO) with
+    | .error e => return .pure (.error e)
+    | .ok subdirs =>
+      let tasks ← subdirs.mapM spawn
+      BaseIO.mapTasks (sync := true) (tasks := tasks.toList) fun rs =>
+        return rs.foldlM (fun _ r => r) ()
+  /-- Sends the entries of `p` on `ch` and returns the subdirectories to visit. -/
+  visit (p : FilePath) : IO (Array FilePath) := do
+    if !(← enter p) then
+      return #[]
+    let mut subdirs := #[]
+    for (d, type) in (← p.readDirWithFileTypes) do
+      ch.send d.path
+      match type with
+      | .dir => subdirs := subdirs.push d.path
+      -- only the targets of symbolic links need a separate `stat` call
+      | .symlink =>
+        -- like `walkDir`, continue with the resolved path
+        let p' ← FS.realPath d.path
+        if (← p'.isDir) then
+          subdirs := subdirs.push p'
+      | _ => pure ()
+    return subdirs
+
+end System.FilePath
@@ -97,3 +97,18 @@ def Runtime.markMultiThreaded (a : α) : α := a
   mark it now or it would be unnecessarily marked multi-threaded in between. -/
 @[extern "lean_runtime_mark_persistent"]
 def Runtime.markPersistent (a : α) : α := a
+
+/--
+  Evaluates `f ()` while allocating small objects of the current thread in a
+  region, which is released at once when `f` returns; the objects reachable from
+  the result are copied out of it first. Freeing objects of the region is
+  cheaper, but their memory is not reused before the region ends.
+
+  This is an experimental feature: objects allocated by `f` must not escape
+  other than through the result, e.g. by storing them in global `IO.Ref`s or
+  caches. Escaping to other threads or persistent objects is detected and aborts
+  the process. In particular, `f` must not spawn tasks or force thunks that
+  refer to objects allocated by `f`, as their closures and values are marked as
+  multi-threaded. -/
+@[extern "lean_runtime_with_region"]
+def Runtime.withRegion (f : Unit → α) : α := f ()
@@ -26,14 +26,52 @@ def Environment.addAndCompile (env : Environment) (opts : Options) (decl : Decla
   let env ← addDecl env opts decl cancelTk?
   compileDecl env opts decl
 
+private def fmtKernelTime (secs : Float) : String :=
+  s!"{(secs * 1000).toUInt64}ms"
+
+/--
+Reports the kernel profiling data collected by the last `addDecl`, see `Kernel.Diagnostics.phases`.
+With `profiler` (`lean --profile`) it is printed like the other profiling times, and with
+`trace.profiler` it is added to the current `Kernel` trace node.
+-/
+private def reportKernelProfile : CoreM Unit := do
+  let opts ← getOptions
+  let threshold := profiler.threshold.getSecs opts
+  let diag := Kernel.getDiagnostics (← getEnv)
+  let mut lines := #[]
+  for (phase, s) in diag.phases.toList.toArray.qsort (fun a b => a.2.time > b.2.time) do
+    if s.time >= threshold then
+      lines := lines.push s!"kernel {phase} took {fmtKernelTime s.time} \
+        ({s.calls} calls, {s.hits} cache hits)"
+  let unfolds := diag.unfoldTime.toList.toArray.qsort (fun a b => a.2 > b.2)
+  for (c, t) in unfolds[:10] do
+    if t >= threshold then
+      lines := lines.push s!"kernel unfolding {c} took {fmtKernelTime t}"
+  if profiler.get opts then
+    for line in lines do
+      IO.println line
+  if trace.profiler.get opts then
+    for line in lines do
+      addTrace `Kernel line
+
 def addDecl (decl : Declaration) : CoreM Unit := do
-  profileitM Exception "type checking" (← getOptions) do
+  profileitM Exception "type checking" (← getOptions) (decl := decl.getNames.headD .anonymous) do
     withTraceNode `Kernel (fun _ => return m!"typechecking declaration") do
       if !(← MonadLog.hasErrors) && decl.hasSorry then
         logWarning "declaration uses 'sorry'"
+      let profile := profiler.get (← getOptions) || trace.profiler.get (← getOptions)
+      if profile then
+        modifyEnv (Kernel.enableProfile · true)
       match (← getEnv).addDecl (← getOptions) decl (← read).cancelTk? with
-      | .ok    env => setEnv env
-      | .error ex  => throwKernelException ex
+      | .ok    env =>
+        setEnv env
+        if profile then
+          reportKernelProfile
+          modifyEnv (Kernel.enableProfile · false)
+      | .error ex  =>
+        if profile then
+          modifyEnv (Kernel.enableProfile · false)
+        throwKernelException ex
 
 def addAndCompile (decl : Declaration) : CoreM Unit := do
   addDecl decl
@@ -8,6 +8,7 @@ import Lean.Compiler.IR.Basic
 import Lean.Compiler.IR.Format
 import Lean.Compiler.IR.CompilerM
 import Lean.Compiler.IR.PushProj
+import Lean.Compiler.IR.FlattenParams
 import Lean.Compiler.IR.ElimDeadVars
 import Lean.Compiler.IR.SimpCase
 import Lean.Compiler.IR.ResetReuse
@@ -19,6 +20,7 @@ import Lean.Compiler.IR.RC
 import Lean.Compiler.IR.ExpandResetReuse
 import Lean.Compiler.IR.UnboxResult
 import Lean.Compiler.IR.ElimDeadBranches
+import Lean.Compiler.IR.ElimBoundsChecks
 import Lean.Compiler.IR.EmitC
 import Lean.Compiler.IR.CtorLayout
 import Lean.Compiler.IR.Sorry
@@ -30,6 +32,22 @@ register_builtin_option compiler.reuse : Bool := {
   descr    := "heuristically insert reset/reuse instruction pairs"
 }
 
+register_builtin_option compiler.elim_bounds_checks : Bool := {
+  defValue := true
+  descr    := "remove array bounds checks implied by an enclosing comparison of the index with the array size"
+}
+
+register_builtin_option compiler.reuse_slots : Bool := {
+  defValue := false
+  descr    := "also reuse memory cells for constructors with a different number of fields \
+    that are allocated in the same small object slot"
+}
+
+register_builtin_option compiler.flatten_params : Bool := {
+  defValue := true
+  descr    := "pass the scalar fields of structure parameters in registers when the structure does not escape"
+}
+
 private def compileAux (decls : Array Decl) : CompilerM Unit := do
   logDecls `init decls
   checkDecls decls
@@ -37,9 +55,17 @@ private def compileAux (decls : Array Decl) : CompilerM Unit := do
   logDecls `elim_dead_branches decls
   decls := decls.map Decl.pushProj
   logDecls `push_proj decls
+  if compiler.flatten_params.get (← read) then
+    decls := flattenParams decls
+    logDecls `flatten_params decls
   if compiler.reuse.get (← read) then
-    decls := decls.map Decl.insertResetReuse
+    let slotReuse := compiler.reuse_slots.get (← read)
+    decls := decls.map (·.insertResetReuse slotReuse)
     logDecls `reset_reuse decls
+    logMessageIf `reuse_stats (Format.joinSep (decls.map Decl.reuseStats).toList Format.line)
+  if compiler.elim_bounds_checks.get (← read) then
+    decls := decls.map Decl.elimBoundsChecks
+    logDecls `elim_bounds_checks decls
   decls := decls.map Decl.elimDead
   logDecls `elim_dead decls
   decls := decls.map Decl.simpCase
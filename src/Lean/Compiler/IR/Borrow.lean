@@ -309,8 +309,72 @@ def infer (env : Environment) (decls : Array Decl) : ParamMap :=
 
 end Borrow
 
+register_builtin_option compiler.borrow_exported : Bool := {
+  defValue := false
+  descr    := "infer borrowed parameters for the body of `@[export]` functions, \
+    which is moved to an auxiliary function called by an owned wrapper with the exported signature"
+}
+
+/-!
+Borrow inference is not performed for `@[export]` functions, whose signatures are used by C/C++ code
+(see `InitParamMap.initBorrowIfNotExported`). With `compiler.borrow_exported`, the body of such a
+function `f` is moved to the auxiliary function `f._borrowed`, on which borrow inference is performed,
+and `f` becomes an owned wrapper calling it. Calls to `f` from Lean code, also in downstream modules
+where `f._borrowed` is found in the IR of the imported module, are redirected to `f._borrowed`.
+-/
+namespace BorrowedVersion
+
+def mkBorrowedName (f : FunId) : FunId :=
+  Name.mkStr f "_borrowed"
+
+def isCandidate (env : Environment) : Decl → Bool
+  | .fdecl (f := f) (xs := xs) .. => isExport env f && xs.any (·.ty.isObj)
+  | _                             => false
+
+/-- The owned wrapper of the exported function `f`, which calls `f._borrowed`. -/
+def mkWrapper : Decl → Decl
+  | .fdecl f xs ty _ info =>
+    let r : VarId := { idx := xs.foldl (fun m p => max m p.x.idx) 0 + 1 }
+    .fdecl f xs ty (.vdecl r ty (.fap (mkBorrowedName f) (xs.map (.var ·.x))) (.ret (.var r))) info
+  | other => other
+
+partial def redirect (hasBorrowed : FunId → Bool) : FnBody → FnBody
+  | .vdecl x t (.fap g ys) b =>
+    let g := if hasBorrowed g then mkBorrowedName g else g
+    .vdecl x t (.fap g ys) (redirect hasBorrowed b)
+  | .jdecl j ys v b => .jdecl j ys (redirect hasBorrowed v) (redirect hasBorrowed b)
+  | .case tid x xType alts => .case tid x xType <| alts.map (·.modifyBody (redirect hasBorrowed))
+  | b =>
+    if b.isTerminal then b
+    else
+      let (instr, b) := b.split
+      instr.setBody (redirect hasBorrowed b)
+
+/--
+Redirects the calls to `@[export]` functions that have a borrowed version to it. If `split` is `true`,
+the borrowed versions of the exported functions in `decls` are created.
+-/
+def mkBorrowedVersions (env : Environment) (decls : Array Decl) (split : Bool) : Array Decl := Id.run do
+  let exported := if split then decls.filter (isCandidate env) else #[]
+  let names : NameSet := exported.foldl (·.insert ·.name) {}
+  let hasBorrowed (g : FunId) := names.contains g || (findEnvDecl env (mkBorrowedName g)).isSome
+  let mut result := #[]
+  for decl in decls do
+    let decl := match decl with
+      | .fdecl (body := b) .. => decl.updateBody! (redirect hasBorrowed b)
+      | other                 => other
+    if names.contains decl.name then
+      let .fdecl f xs ty b info := decl | unreachable!
+      result := result.push (.fdecl (mkBorrowedName f) xs ty b info) |>.push (mkWrapper decl)
+    else
+      result := result.push decl
+  return result
+
+end BorrowedVersion
+
 def inferBorrow (decls : Array Decl) : CompilerM (Array Decl) := do
   let env ← getEnv
+  let decls := BorrowedVersion.mkBorrowedVersions env decls (compiler.borrow_exported.get (← read))
   let paramMap := Borrow.infer env decls
   pure (Borrow.applyParamMap decls paramMap)
 
@@ -0,0 +1,99 @@
+/-
+Copyright (c) 2024 Lean FRO, LLC. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+-/
+prelude
+import Lean.Compiler.IR.Basic
+import Lean.Compiler.IR.NormIds
+
+/-!
+Removes array bounds checks that are implied by an enclosing `case`.
+
+In the branch of `let c := Nat.decLt i n; case c of ...` in which `c` is `true`, where
+`n := Array.size a`, the index `i` is in bounds of `a` and of the arrays obtained from `a` by
+`Array.set!`, `Array.set` and `Array.uset`, which have the same size. There, `Array.get! a i` and
+`Array.set! a i v` are replaced by `Array.get a i` and `Array.set a i v`, which do not check the index
+(the runtime representation of `Fin n` is the one of `Nat`). The same holds in the `false` branch of
+`Nat.decLe n i`.
+
+Repeated `Array.size` calls on arrays of the same size are replaced by the first one in scope.
+-/
+
+namespace Lean.IR.ElimBoundsChecks
+
+structure Context where
+  /-- Maps array variables to the first array in scope with the same size. -/
+  roots    : Std.HashMap VarId VarId := {}
+  /-- Maps the root of an array, see `roots`, to the variable holding its size. -/
+  sizes    : Std.HashMap VarId VarId := {}
+  /-- Maps variables holding the size of an array to the root of the array. -/
+  sizeOf   : Std.HashMap VarId VarId := {}
+  /--
+  Maps a variable `c := Nat.decLt i n` or `c := Nat.decLe n i`, where `n` is the size of the array with
+  root `a`, to `(v, i, a)` where `v` is the value of `c` for which `i` is in bounds.
+  -/
+  guards   : Std.HashMap VarId (Bool × VarId × VarId) := {}
+  /-- Pairs `(i, a)` s.t. the index `i` is known to be in bounds of the array with root `a`. -/
+  inBounds : Std.HashSet (VarId × VarId) := {}
+
+def Context.root (ctx : Context) (a : VarId) : VarId :=
+  ctx.roots.getD a a
+
+def Context.isInBounds (ctx : Context) (i a : Arg) : Bool :=
+  match i, a with
+  | .var i, .var a => ctx.inBounds.contains (i, ctx.root a)
+  | _,      _      => false
+
+/-- Records that the array `x` has the same size as the array `a`. -/
+def Context.sameSize (ctx : Context) (x a : VarId) : Context :=
+  { ctx with roots := ctx.roots.insert x (ctx.root a) }
+
+def Context.addGuard (ctx : Context) (c : VarId) (v : Bool) (i n : VarId) : Context :=
+  match ctx.sizeOf[n]? with
+  | some a => { ctx with guards := ctx.guards.insert c (v, i, a) }
+  | none   => ctx
+
+/-- Returns the context of the alternative `alt` of a `case` on `c`. -/
+def Context.enterAlt (ctx : Context) (c : VarId) (alts : Array Alt) (alt : Alt) : Context :=
+  match ctx.guards[c]? with
+  | some (v, i, a) =>
+    let cidx := if v then 1 else 0
+    let taken := match alt with
+      | .ctor info _ => info.cidx == cidx
+      | .default _   => !alts.any fun | .ctor info _ => info.cidx == cidx | .default _ => false
+    if taken then { ctx with inBounds := ctx.inBounds.insert (i, a) } else ctx
+  | none => ctx
+
+partial def visit (ctx : Context) : FnBody → FnBody
+  | .vdecl x t e b =>
+    match e with
+    | .fap ``Array.size #[_, .var a] =>
+      let a := ctx.root a
+      match ctx.sizes[a]? with
+      | some n => visit ctx (b.replaceVar x n)
+      | none   => .vdecl x t e <| visit { ctx with sizes := ctx.sizes.insert a x, sizeOf := ctx.sizeOf.insert x a } b
+    | .fap ``Nat.decLt #[.var i, .var n] => .vdecl x t e <| visit (ctx.addGuard x true i n) b
+    | .fap ``Nat.decLe #[.var n, .var i] => .vdecl x t e <| visit (ctx.addGuard x false i n) b
+    | .fap ``Array.get! #[α, _, a, i] =>
+      let e := if ctx.isInBounds i a then .fap ``Array.get #[α, a, i] else e
+      .vdecl x t e <| visit ctx b
+    | .fap ``Array.set! #[α, .var a, i, v] =>
+      let e := if ctx.isInBounds i (.var a) then .fap ``Array.set #[α, .var a, i, v] else e
+      .vdecl x t e <| visit (ctx.sameSize x a) b
+    | .fap ``Array.set #[_, .var a, _, _] | .fap ``Array.uset #[_, .var a, _, _, _] =>
+      .vdecl x t e <| visit (ctx.sameSize x a) b
+    | _ => .vdecl x t e <| visit ctx b
+  | .jdecl j ys v b => .jdecl j ys (visit ctx v) (visit ctx b)
+  | .case tid c ty alts =>
+    .case tid c ty <| alts.map fun alt => alt.modifyBody (visit (ctx.enterAlt c alts alt))
+  | b => if b.isTerminal then b else b.setBody (visit ctx b.body)
+
+end ElimBoundsChecks
+
+/-- Removes redundant array bounds checks and `Array.size` calls, see `ElimBoundsChecks`. -/
+def Decl.elimBoundsChecks (d : Decl) : Decl :=
+  match d with
+  | .fdecl (body := b) .. => d.updateBody! (ElimBoundsChecks.visit {} b)
+  | other => other
+
+end Lean.IR
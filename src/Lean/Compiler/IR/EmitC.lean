@@ -13,6 +13,8 @@ import Lean.Compiler.IR.EmitUtil
 import Lean.Compiler.IR.NormIds
 import Lean.Compiler.IR.SimpCase
 import Lean.Compiler.IR.Boxing
+import Lean.Compiler.IR.StackAlloc
+import Lean.Util.SCC
 
 namespace Lean.IR.EmitC
 open ExplicitBoxing (requiresBoxedVersion mkBoxedName isBoxedName)
@@ -25,8 +27,18 @@ structure Context where
   jpMap      : JPParamsMap := {}
   mainFn     : FunId := default
   mainParams : Array Param := #[]
-
-abbrev M := ReaderT Context (EStateM String String)
+  /-- C expressions of the closed terms emitted as static data, see `collectStaticClosedTerms`. -/
+  staticClosedTerms : NameMap String := {}
+  /-- Groups of mutually tail-recursive functions emitted as a single C function, see `collectMutualGroups`. -/
+  mutualGroups : NameMap (Array Decl) := {}
+  /-- Labels and parameters of the functions that can be reached by `goto` from the current C function. -/
+  tailCallTargets : NameMap (String × Array Param) := {}
+  /-- Constructor objects of the current function allocated on the stack, see `FnBody.stackCtors`. -/
+  stackCtors : Std.HashMap VarId CtorInfo := {}
+  /-- Functions that check for low stack space on entry, see `collectStackCheckedFns`. -/
+  stackCheckedFns : NameSet := {}
+
+abbrev M := ReaderT Context (EStateM String String.Builder)
 
 def getEnv : M Environment := Context.env <$> read
 def getModName : M Name := Context.modName <$> read
@@ -37,7 +49,7 @@ def getDecl (n : Name) : M Decl := do
   | none   => throw s!"unknown declaration '{n}'"
 
 @[inline] def emit {α : Type} [ToString α] (a : α) : M Unit :=
-  modify fun out => out ++ toString a
+  modify fun out => out.append (toString a)
 
 @[inline] def emitLn {α : Type} [ToString α] (a : α) : M Unit := do
   emit a; emit "\n"
@@ -91,6 +103,19 @@ def toCInitName (n : Name) : M String := do
 def emitCInitName (n : Name) : M Unit :=
   toCInitName n >>= emit
 
+/--
+Closed terms of object type can be initialized on first access instead of at module initialization,
+when the C code is compiled with `LEAN_LAZY_CLOSED_TERMS`. Other constants, in particular those with
+`[init]` declarations, are always initialized eagerly.
+-/
+def isLazyClosedTerm (decl : Decl) : M Bool := do
+  let env ← getEnv
+  return decl.params.isEmpty && decl.resultType.isObj && isClosedTermName env decl.name &&
+    !hasInitAttr env decl.name && !(← read).staticClosedTerms.contains decl.name
+
+def isStaticClosedTerm (n : Name) : M Bool :=
+  return (← read).staticClosedTerms.contains n
+
 def emitFnDeclAux (decl : Decl) (cppBaseName : String) (isExternal : Bool) : M Unit := do
   let ps := decl.params
   let env ← getEnv
@@ -101,6 +126,10 @@ def emitFnDeclAux (decl : Decl) (cppBaseName : String) (isExternal : Bool) : M U
   else
     if !isExternal then emit "LEAN_EXPORT "
   emit (toCType decl.resultType ++ " " ++ cppBaseName)
+  if ps.isEmpty && (← isLazyClosedTerm decl) then
+    -- `LEAN_CLOSED_TERM` refers to the initializer before its definition
+    emitLn ";"
+    emit ("static " ++ toCType decl.resultType ++ " _init_" ++ cppBaseName ++ "()")
   unless ps.isEmpty do
     emit "("
     -- We omit irrelevant parameters for extern constants
@@ -115,6 +144,9 @@ def emitFnDeclAux (decl : Decl) (cppBaseName : String) (isExternal : Bool) : M U
   emitLn ";"
 
 def emitFnDecl (decl : Decl) (isExternal : Bool) : M Unit := do
+  -- defined together with their static data by `emitStaticClosedTerms`
+  if ← isStaticClosedTerm decl.name then
+    return
   let cppBaseName ← toCName decl.name
   emitFnDeclAux decl cppBaseName isExternal
 
@@ -222,10 +254,12 @@ def emitFileHeader : M Unit := do
     "#if defined(__clang__)",
     "#pragma clang diagnostic ignored \"-Wunused-parameter\"",
     "#pragma clang diagnostic ignored \"-Wunused-label\"",
+    "#pragma clang diagnostic ignored \"-Wunused-variable\"",
     "#elif defined(__GNUC__) && !defined(__CLANG__)",
     "#pragma GCC diagnostic ignored \"-Wunused-parameter\"",
     "#pragma GCC diagnostic ignored \"-Wunused-label\"",
     "#pragma GCC diagnostic ignored \"-Wunused-but-set-variable\"",
+    "#pragma GCC diagnostic ignored \"-Wunused-variable\"",
     "#endif",
     "#ifdef __cplusplus",
     "extern \"C\" {",
@@ -248,16 +282,40 @@ def getJPParams (j : JoinPointId) : M (Array Param) := do
   | some ps => pure ps
   | none    => throw "unknown join point"
 
+def emitCtorScalarSize (usize : Nat) (ssize : Nat) : M Unit := do
+  if usize == 0 then emit ssize
+  else if ssize == 0 then emit "sizeof(size_t)*"; emit usize
+  else emit "sizeof(size_t)*"; emit usize; emit " + "; emit ssize
+
+def emitCtorByteSize (c : CtorInfo) : M Unit := do
+  emit "sizeof(lean_ctor_object) + sizeof(void*)*"; emit c.size; emit " + "; emitCtorScalarSize c.usize c.ssize
+
 def declareVar (x : VarId) (t : IRType) : M Unit := do
   emit (toCType t); emit " "; emit x; emit "; "
+  if let some c := (← read).stackCtors[x]? then
+    -- 8-byte aligned storage for the object
+    emit "uint64_t "; emit x; emit "_stack[("; emitCtorByteSize c; emit " + 7) / 8]; "
 
 def declareParams (ps : Array Param) : M Unit :=
   ps.forM fun p => declareVar p.x p.ty
 
+/--
+Returns the label and parameters of the function called by `b` if `b` is a tail call that can be
+emitted as a `goto`, see `emitTailCall`.
+-/
+def tailCallTarget? (b : FnBody) : M (Option (String × Array Param)) := do
+  let .vdecl x _ (.fap f _) (.ret (.var y)) := b | return none
+  unless x == y do return none
+  let ctx ← read
+  if let some target := ctx.tailCallTargets.find? f then
+    return some target
+  if f == ctx.mainFn then
+    return some ("_start", ctx.mainParams)
+  return none
+
 partial def declareVars : FnBody → Bool → M Bool
   | e@(FnBody.vdecl x t _ b), d => do
-    let ctx ← read
-    if isTailCallTo ctx.mainFn e then
+    if (← tailCallTarget? e).isSome then
       pure d
     else
       declareVar x t; declareVars b true
@@ -285,6 +343,11 @@ def emitInc (x : VarId) (n : Nat) (checkRef : Bool) : M Unit := do
   emitLn ");"
 
 def emitDec (x : VarId) (n : Nat) (checkRef : Bool) : M Unit := do
+  if let some c := (← read).stackCtors[x]? then
+    -- only the fields of an object on the stack are released
+    c.size.forM fun i => do
+      emit "lean_dec(lean_ctor_get("; emit x; emit ", "; emit i; emitLn "));"
+    return
   emit (if checkRef then "lean_dec" else "lean_dec_ref");
   emit "("; emit x;
   if n != 1 then emit ", "; emit n
@@ -336,11 +399,6 @@ def emitArgs (ys : Array Arg) : M Unit :=
     if i > 0 then emit ", "
     emitArg ys[i]!
 
-def emitCtorScalarSize (usize : Nat) (ssize : Nat) : M Unit := do
-  if usize == 0 then emit ssize
-  else if ssize == 0 then emit "sizeof(size_t)*"; emit usize
-  else emit "sizeof(size_t)*"; emit usize; emit " + "; emit ssize
-
 def emitAllocCtor (c : CtorInfo) : M Unit := do
   emit "lean_alloc_ctor("; emit c.cidx; emit ", "; emit c.size; emit ", "
   emitCtorScalarSize c.usize c.ssize; emitLn ");"
@@ -350,6 +408,12 @@ def emitCtorSetArgs (z : VarId) (ys : Array Arg) : M Unit :=
     emit "lean_ctor_set("; emit z; emit ", "; emit i; emit ", "; emitArg ys[i]!; emitLn ");"
 
 def emitCtor (z : VarId) (c : CtorInfo) (ys : Array Arg) : M Unit := do
+  if (← read).stackCtors.contains z then
+    emit "lean_set_non_heap_header((lean_object*)"; emit z; emit "_stack, sizeof("; emit z; emit "_stack), "
+    emit c.cidx; emit ", "; emit c.size; emitLn ");"
+    emitLhs z; emit "(lean_object*)"; emit z; emitLn "_stack;"
+    emitCtorSetArgs z ys
+    return
   emitLhs z;
   if c.size == 0 && c.usize == 0 && c.ssize == 0 then do
     emit "lean_box("; emit c.cidx; emitLn ");"
@@ -371,7 +435,9 @@ def emitReuse (z : VarId) (x : VarId) (c : CtorInfo) (updtHeader : Bool) (ys : A
   emit " "; emitLhs z; emitAllocCtor c;
   emitLn "} else {";
   emit " "; emitLhs z; emit x; emitLn ";";
-  if updtHeader then emit " lean_ctor_set_tag("; emit z; emit ", "; emit c.cidx; emitLn ");"
+  if updtHeader then
+    emit " lean_ctor_set_layout("; emit z; emit ", "; emit c.cidx; emit ", "; emit c.size; emit ", "
+    emitCtorScalarSize c.usize c.ssize; emitLn ");"
   emitLn "}";
   emitCtorSetArgs z ys
 
@@ -423,6 +489,9 @@ def emitFullApp (z : VarId) (f : FunId) (ys : Array Arg) : M Unit := do
   match decl with
   | Decl.extern _ ps _ extData => emitExternCall f ps extData ys
   | _ =>
+    if ← isLazyClosedTerm decl then
+      emit "LEAN_CLOSED_TERM("; emitCName f; emit ", "; emitCInitName f; emitLn ");"
+      return
     emitCName f
     if ys.size > 0 then emit "("; emitArgs ys; emit ")"
     emitLn ";"
@@ -548,11 +617,9 @@ def overwriteParam (ps : Array Param) (ys : Array Arg) : Bool :=
     let p := ps[i]!
     (i+1, n).anyI fun j => paramEqArg p ys[j]!
 
-def emitTailCall (v : Expr) : M Unit :=
+def emitTailCall (ps : Array Param) (label : String) (v : Expr) : M Unit :=
   match v with
   | Expr.fap _ ys => do
-    let ctx ← read
-    let ps := ctx.mainParams
     unless ps.size == ys.size do throw "invalid tail call"
     if overwriteParam ps ys then
       emitLn "{"
@@ -571,7 +638,7 @@ def emitTailCall (v : Expr) : M Unit :=
         let p := ps[i]!
         let y := ys[i]!
         unless paramEqArg p y do emit p.x; emit " = "; emitArg y; emitLn ";"
-    emitLn "goto _start;"
+    emit "goto "; emit label; emitLn ";"
   | _ => throw "bug at emitTailCall"
 
 mutual
@@ -598,9 +665,8 @@ partial def emitBlock (b : FnBody) : M Unit := do
   match b with
   | FnBody.jdecl _ _  _ b      => emitBlock b
   | d@(FnBody.vdecl x t v b)   =>
-    let ctx ← read
-    if isTailCallTo ctx.mainFn d then
-      emitTailCall v
+    if let some (label, ps) ← tailCallTarget? d then
+      emitTailCall ps label v
     else
       emitVDecl x t v
       emitBlock b
@@ -635,14 +701,158 @@ partial def emitFnBody (b : FnBody) : M Unit := do
 
 end
 
+/--
+Finds the strongly connected components of the tail call graph of the functions of the module. Each
+component with more than one function is emitted as a single C function in which the tail calls
+between its members are `goto`s, see `emitMutualFn`, so that mutual tail recursion runs in constant
+stack space. The functions of a component must have the same C result type.
+-/
+def collectMutualGroups : M (NameMap (Array Decl)) := do
+  let decls := (getDecls (← getEnv)).reverse.toArray.filter fun
+    | d@(.fdecl (xs := xs) ..) => xs.size > 0 && !isBoxedName d.name
+    | _                        => false
+  let byName : NameMap Decl := decls.foldl (fun m d => m.insert d.name d) {}
+  let sccs := SCC.scc (decls.toList.map (·.name)) fun f =>
+    match byName.find? f with
+    | some (.fdecl (body := b) ..) => (collectTailCallees b).toList.filter byName.contains
+    | _                            => []
+  let mut groups : NameMap (Array Decl) := {}
+  for scc in sccs do
+    unless scc.length > 1 do continue
+    let members := decls.filter (scc.contains ·.name)
+    unless members.all (toCType ·.resultType == toCType members[0]!.resultType) do continue
+    for d in members do
+      groups := groups.insert d.name members
+  return groups
+
+def toCMutualName (group : Array Decl) : M String :=
+  return (← toCName group[0]!.name) ++ "__mutual"
+
+/--
+Emits the merged C function of a group of mutually tail-recursive functions. It takes the index of the
+function to run followed by the parameters of all functions of the group, whose variables and join points
+are renamed apart.
+-/
+def emitMutualFn (group : Array Decl) : M Unit := do
+  let (group, _) := group.foldl (init := (#[], 1)) fun (ds, n) d =>
+    let (d, n) := (NormalizeIds.normDecl d {}).run n
+    (ds.push d, n)
+  let mut targets : NameMap (String × Array Param) := {}
+  for h : i in [:group.size] do
+    targets := targets.insert group[i].name (s!"_start_{i}", group[i].params)
+  emit "static "; emit (toCType group[0]!.resultType); emit " "; emit (← toCMutualName group)
+  emit "(unsigned _fn"
+  for d in group do
+    for p in d.params do
+      emit ", "; emit (toCType p.ty); emit " "; emit p.x
+  emitLn ") {"
+  emitLn "switch (_fn) {"
+  for i in [1:group.size] do
+    emitLn s!"case {i}: goto _start_{i};"
+  emitLn "}"
+  for h : i in [:group.size] do
+    let d := group[i]
+    let .fdecl (f := f) (xs := xs) (body := b) .. := d | throw "invalid mutual group"
+    emitLn s!"_start_{i}:"
+    let (_, jpMap) := mkVarJPMaps d
+    withReader (fun ctx => { ctx with jpMap, mainFn := f, mainParams := xs, tailCallTargets := targets,
+                                      stackCtors := b.stackCtors })
+      (emitFnBody b)
+  emitLn "}"
+
+/--
+Emits the body of the function `f` of `group`, which calls the merged function of the group with the
+parameters `xs` of `f` and zeros for the parameters of the other functions.
+-/
+def emitMutualEntry (group : Array Decl) (f : FunId) (xs : Array Param) : M Unit := do
+  let some idx := group.findIdx? (·.name == f) | throw "invalid mutual group"
+  emit "return "; emit (← toCMutualName group); emit "("; emit idx
+  for d in group do
+    if d.name == f then
+      xs.forM fun x => do emit ", "; emit x.x
+    else
+      d.params.forM fun _ => emit ", 0"
+  emitLn ");"
+
+def emitMutualFns : M Unit := do
+  let groups := (← read).mutualGroups
+  let leaders := groups.fold (init := #[]) fun acc f group =>
+    if group[0]!.name == f then acc.push group else acc
+  for group in leaders do
+    emitMutualFn group
+
+/--
+Finds the functions that may recurse through non-tail calls, i.e. those in a strongly connected
+component of the call graph that contain a non-tail call to a function of the same component. On
+entry, they continue on a new stack segment when the stack is low, see `emitStackCheck`.
+-/
+def collectStackCheckedFns : M NameSet := do
+  let decls := (getDecls (← getEnv)).toArray.filter fun
+    | d@(.fdecl (xs := xs) ..) => xs.size > 0 && !isBoxedName d.name
+    | _                        => false
+  let byName : NameMap Decl := decls.foldl (fun m d => m.insert d.name d) {}
+  let sccs := SCC.scc (decls.toList.map (·.name)) fun f =>
+    match byName.find? f with
+    | some (.fdecl (body := b) ..) => (collectCallees b).toList.filter byName.contains
+    | _                            => []
+  let mut fns : NameSet := {}
+  for scc in sccs do
+    for f in scc do
+      if let some (.fdecl (body := b) ..) := byName.find? f then
+        if hasNonTailCall scc.contains b then
+          fns := fns.insert f
+  return fns
+
+def toCStackArgsName (f : FunId) : M String :=
+  return (← toCName f) ++ "___stack_args"
+
+/--
+Emits the argument structure and the trampoline through which `emitStackCheck` calls `f` on a new
+stack segment.
+-/
+def emitStackTrampoline (f : FunId) (xs : Array Param) (t : IRType) : M Unit := do
+  let argsName ← toCStackArgsName f
+  emit "struct "; emit argsName; emitLn " {"
+  for x in xs do
+    emit (toCType x.ty); emit " "; emit x.x; emitLn ";"
+  emit (toCType t); emitLn " _r;"
+  emitLn "};"
+  emit "static void "; emit argsName; emitLn "_run(void* _p) {"
+  emit "struct "; emit argsName; emit "* _a = (struct "; emit argsName; emitLn "*)_p;"
+  emit "_a->_r = "; emit (← toCName f); emit "("
+  xs.size.forM fun i => do
+    if i > 0 then emit ", "
+    emit "_a->"; emit xs[i]!.x
+  emitLn ");"
+  emitLn "}"
+
+/--
+Emits the check at the entry of `f` that continues the call on a new stack segment if the stack is
+low, so that deep non-tail recursion does not overflow the stack of the thread.
+-/
+def emitStackCheck (f : FunId) (xs : Array Param) : M Unit := do
+  let argsName ← toCStackArgsName f
+  emitLn "if (LEAN_UNLIKELY(lean_stack_is_low())) {"
+  emit "struct "; emit argsName; emit " _a = {"
+  xs.size.forM fun i => do
+    if i > 0 then emit ", "
+    emit xs[i]!.x
+  emitLn "};"
+  emit "lean_run_on_stack_segment("; emit argsName; emitLn "_run, &_a);"
+  emitLn "return _a._r;"
+  emitLn "}"
+
 def emitDeclAux (d : Decl) : M Unit := do
   let env ← getEnv
   let (_, jpMap) := mkVarJPMaps d
   withReader (fun ctx => { ctx with jpMap := jpMap }) do
-  unless hasInitAttr env d.name do
+  unless hasInitAttr env d.name || (← isStaticClosedTerm d.name) do
     match d with
     | .fdecl (f := f) (xs := xs) (type := t) (body := b) .. =>
       let baseName ← toCName f;
+      let stackChecked := (← read).stackCheckedFns.contains f
+      if stackChecked then
+        emitStackTrampoline f xs t
       if xs.size == 0 then
         emit "static "
       else
@@ -666,8 +876,13 @@ def emitDeclAux (d : Decl) : M Unit := do
         xs.size.forM fun i => do
           let x := xs[i]!
           emit "lean_object* "; emit x.x; emit " = _args["; emit i; emitLn "];"
-      emitLn "_start:";
-      withReader (fun ctx => { ctx with mainFn := f, mainParams := xs }) (emitFnBody b);
+      if stackChecked then
+        emitStackCheck f xs
+      if let some group := (← read).mutualGroups.find? f then
+        emitMutualEntry group f xs
+      else
+        emitLn "_start:"
+        withReader (fun ctx => { ctx with mainFn := f, mainParams := xs, stackCtors := b.stackCtors }) (emitFnBody b)
       emitLn "}"
     | _ => pure ()
 
@@ -678,10 +893,169 @@ def emitDecl (d : Decl) : M Unit := do
   catch err =>
     throw s!"{err}\ncompiling:\n{d}"
 
+/-- Number of declarations whose C code is generated by a single task in `emitFns`. -/
+def emitFnsChunkSize : Nat := 64
+
+/--
+Emit the code of all declarations of the module. The code of a declaration only depends on the context, so
+chunks of declarations are emitted by parallel tasks and concatenated in order, keeping the output deterministic.
+-/
 def emitFns : M Unit := do
-  let env ← getEnv;
-  let decls := getDecls env;
-  decls.reverse.forM emitDecl
+  let ctx ← read
+  let decls := (getDecls ctx.env).reverse.toArray
+  let numChunks := (decls.size + emitFnsChunkSize - 1) / emitFnsChunkSize
+  let tasks := (List.range numChunks).map fun i => Task.spawn fun _ =>
+    let chunk := decls.extract (i * emitFnsChunkSize) ((i + 1) * emitFnsChunkSize)
+    match (chunk.forM emitDecl ctx).run {} with
+    | EStateM.Result.ok    _   out => Except.ok out.toString
+    | EStateM.Result.error err _   => Except.error err
+  let outs ← tasks.mapM fun t =>
+    match t.get with
+    | .ok out    => pure out
+    | .error err => throw err
+  modify (·.appendList outs)
+
+/--
+Value of a closed term that is emitted as static C data with the header of a persistent object, instead
+of being computed and marked persistent at module initialization.
+-/
+inductive StaticValue where
+  /-- A scalar, only used for arguments of `box`. -/
+  | scalar (n : Nat)
+  | box    (n : Nat)
+  | str    (s : String)
+  | name   (n : Name)
+  | ctor   (cidx : Nat) (args : Array StaticValue)
+  /-- Another closed term of the module that is emitted as static data. -/
+  | ref    (c : Name)
+  deriving Inhabited
+
+/-- Maximum value of a boxed scalar in static data, small enough for 32-bit platforms. -/
+def staticBoxMax : Nat := 2^31
+
+/--
+Returns the value of the closed term with body `b` if it is made of string literals, `Name` literals,
+constructors without scalar fields, boxed small scalars and other closed terms in `statics`.
+-/
+partial def staticValue? (statics : NameMap StaticValue) (b : FnBody) : Option StaticValue :=
+  go {} b
+where
+  resolve : StaticValue → StaticValue
+    | .ref c => (statics.find? c).map resolve |>.getD (.ref c)
+    | v      => v
+  str? (v : StaticValue) : Option String :=
+    match resolve v with
+    | .str s => some s
+    | _      => none
+  name? (v : StaticValue) : Option Name :=
+    match resolve v with
+    | .name n => some n
+    | .box 0  => some .anonymous
+    | _       => none
+  arg (vars : Std.HashMap Nat StaticValue) : Arg → Option StaticValue
+    | .var x      => vars[x.idx]?
+    | .irrelevant => some (.box 0)
+  value (vars : Std.HashMap Nat StaticValue) (ty : IRType) : Expr → Option StaticValue
+    | .lit (.str s) => some (.str s)
+    | .lit (.num n) =>
+      if !ty.isObj then some (.scalar n)
+      else if n < staticBoxMax then some (.box n)
+      else none
+    | .box xty x =>
+      match xty, vars[x.idx]? with
+      | .uint8, some (.scalar n) | .uint16, some (.scalar n) => some (.box n)
+      | _, _ => none
+    | .fap c ys => do
+      if ys.isEmpty then
+        guard (statics.contains c)
+        return .ref c
+      let args ← ys.mapM (arg vars)
+      if c == ``Lean.Name.mkStr || c == `Lean.Name.str._override then
+        let #[p, s] := args | none
+        return .name (.str (← name? p) (← str? s))
+      if c == ``Lean.Name.mkNum || c == `Lean.Name.num._override then
+        let #[p, .box k] := args.map resolve | none
+        return .name (.num (← name? p) k)
+      -- `Lean.Name.mkStr1` to `Lean.Name.mkStr8`
+      let .str ``Lean.Name fn := c | none
+      guard (fn.length == 6 && fn.startsWith "mkStr")
+      let ss ← args.mapM str?
+      return .name (ss.foldl Name.mkStr .anonymous)
+    | .ctor info ys => do
+      guard (info.usize == 0 && info.ssize == 0)
+      if ys.isEmpty then
+        return .box info.cidx
+      let args ← ys.mapM (arg vars)
+      guard (args.all fun | .scalar _ => false | _ => true)
+      return .ctor info.cidx args
+    | _ => none
+  go (vars : Std.HashMap Nat StaticValue) : FnBody → Option StaticValue
+    | .vdecl x ty e b => do go (vars.insert x.idx (← value vars ty e)) b
+    | .ret (.var x)   => vars[x.idx]?
+    | _               => none
+
+/-- The C symbol of the static data of the closed term `n`. -/
+def toCStaticName (n : Name) : M String :=
+  return (← toCName n) ++ "_static"
+
+def staticBoxExpr (n : Nat) : String :=
+  s!"((lean_object*)(size_t){2*n+1})"
+
+/--
+Finds the closed terms of the module that can be emitted as static data, and returns their values and
+the C expressions of their addresses.
+-/
+def collectStaticClosedTerms : M (Array (Name × StaticValue) × NameMap String) := do
+  let env ← getEnv
+  let mut values := #[]
+  let mut statics : NameMap StaticValue := {}
+  let mut exprs : NameMap String := {}
+  for d in (getDecls env).reverse do
+    let .fdecl (f := f) (xs := xs) (type := t) (body := b) .. := d | continue
+    unless xs.isEmpty && t.isObj && isClosedTermName env f && !hasInitAttr env f do continue
+    let some v := staticValue? statics b | continue
+    let expr ← match v with
+      | .box n | .scalar n => pure (staticBoxExpr n)
+      | .ref c             => pure exprs.find! c
+      | _                  => pure s!"((lean_object*)&{← toCStaticName f})"
+    values := values.push (f, v)
+    statics := statics.insert f v
+    exprs := exprs.insert f expr
+  return (values, exprs)
+
+/-- Emits the static data of `v` as the C variable `sym`, returning the C expression of its address. -/
+partial def emitStaticValue (sym : String) (v : StaticValue) : StateT Nat M String := do
+  match v with
+  | .box n | .scalar n => return staticBoxExpr n
+  | .ref c => return (← read).staticClosedTerms.find! c
+  | .str s =>
+    let sz := s.utf8ByteSize + 1
+    emitLn s!"static struct \{ lean_object m_header; size_t m_size; size_t m_capacity; size_t m_length; char m_data[{sz}]; } {sym} = \{\{0, 1, 0, LeanString}, {sz}, {sz}, {s.length}, {quoteString s}};"
+    return s!"((lean_object*)&{sym})"
+  | .ctor cidx args =>
+    let args ← args.mapM child
+    emitLn s!"static struct \{ lean_object m_header; lean_object* m_objs[{args.size}]; } {sym} = \{\{0, sizeof(lean_ctor_object) + {args.size}*sizeof(void*), {args.size}, {cidx}}, \{{", ".intercalate args.toList}}};"
+    return s!"((lean_object*)&{sym})"
+  | .name .anonymous => return staticBoxExpr 0
+  | .name n@(.str p str) => emitName n (← child (.name p)) (← child (.str str)) 1
+  | .name n@(.num p k) => emitName n (← child (.name p)) (staticBoxExpr k) 2
+where
+  child (v : StaticValue) : StateT Nat M String := do
+    let i ← modifyGet fun i => (i, i + 1)
+    emitStaticValue s!"{sym}_{i}" v
+  /-- A `Name` constructor stores its hash after the object fields. -/
+  emitName (n : Name) (pre field : String) (cidx : Nat) : StateT Nat M String := do
+    emitLn s!"static struct \{ lean_object m_header; lean_object* m_objs[2]; uint64_t m_hash; } {sym} = \{\{0, sizeof(lean_ctor_object) + 2*sizeof(void*) + 8, 2, {cidx}}, \{{pre}, {field}}, {n.hash}ULL};"
+    return s!"((lean_object*)&{sym})"
+
+/--
+Emits the closed terms found by `collectStaticClosedTerms` after the other declarations, defining their
+variables with their initial values so that they are not computed by the module initialization function.
+-/
+def emitStaticClosedTerms (values : Array (Name × StaticValue)) : M Unit := do
+  for (f, v) in values do
+    let expr ← (emitStaticValue (← toCStaticName f) v).run' 0
+    emitLn s!"static lean_object* {← toCName f} = {expr};"
 
 def emitMarkPersistent (d : Decl) (n : Name) : M Unit := do
   if d.resultType.isObj then
@@ -717,7 +1091,15 @@ def emitDeclInit (d : Decl) : M Unit := do
       if getBuiltinInitFnNameFor? env d.name |>.isSome then
         emit "}"
     | _ =>
+      if ← isStaticClosedTerm n then
+        return
+      let lazy ← isLazyClosedTerm d
+      if lazy then
+        emitLn ""
+        emitLn "#ifndef LEAN_LAZY_CLOSED_TERMS"
       emitCName n; emit " = "; emitCInitName n; emitLn "();"; emitMarkPersistent d n
+      if lazy then
+        emitLn "#endif"
 
 def emitInitFn : M Unit := do
   let env ← getEnv
@@ -739,19 +1121,25 @@ def emitInitFn : M Unit := do
   emitLns ["return lean_io_result_mk_ok(lean_box(0));", "}"]
 
 def main : M Unit := do
-  emitFileHeader
-  emitFnDecls
-  emitFns
-  emitInitFn
-  emitMainFnIfNeeded
-  emitFileFooter
+  let (staticValues, staticClosedTerms) ← collectStaticClosedTerms
+  let mutualGroups ← collectMutualGroups
+  let stackCheckedFns ← collectStackCheckedFns
+  withReader ({ · with staticClosedTerms, mutualGroups, stackCheckedFns }) do
+    emitFileHeader
+    emitFnDecls
+    emitStaticClosedTerms staticValues
+    emitMutualFns
+    emitFns
+    emitInitFn
+    emitMainFnIfNeeded
+    emitFileFooter
 
 end EmitC
 
 @[export lean_ir_emit_c]
 def emitC (env : Environment) (modName : Name) : Except String String :=
-  match (EmitC.main { env := env, modName := modName }).run "" with
-  | EStateM.Result.ok    _   s => Except.ok s
+  match (EmitC.main { env := env, modName := modName }).run {} with
+  | EStateM.Result.ok    _   s => Except.ok s.toString
   | EStateM.Result.error err _ => Except.error err
 
 end Lean.IR
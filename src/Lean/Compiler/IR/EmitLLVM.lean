@@ -312,6 +312,16 @@ def callLeanCtorSetTag (builder : LLVM.Builder llvmctx)
   let fnty ← LLVM.functionType retty argtys
   let _ ← LLVM.buildCall2 builder fnty fn  #[closure, i] retName
 
+def callLeanCtorSetLayout (builder : LLVM.Builder llvmctx)
+    (o tag numObjs scalarSize : LLVM.Value llvmctx) (retName : String := "") : M llvmctx Unit := do
+  let fnName :=  "lean_ctor_set_layout"
+  let retty ← LLVM.voidType llvmctx
+  let argtys := #[ ← LLVM.voidPtrType llvmctx, ← LLVM.i8Type llvmctx, ← LLVM.unsignedType llvmctx,
+    ← LLVM.unsignedType llvmctx]
+  let fn ← getOrCreateFunctionPrototype (← getLLVMModule) retty fnName argtys
+  let fnty ← LLVM.functionType retty argtys
+  let _ ← LLVM.buildCall2 builder fnty fn  #[o, tag, numObjs, scalarSize] retName
+
 def toLLVMType (t : IRType) : M llvmctx (LLVM.LLVMType llvmctx) := do
   match t with
   | IRType.float      => LLVM.doubleTypeInContext llvmctx
@@ -951,7 +961,10 @@ def emitReuse (builder : LLVM.Builder llvmctx)
        emitLhsSlotStore builder z xv
        if updtHeader then
           let zv ← emitLhsVal builder z
-          callLeanCtorSetTag builder zv (← constInt8 c.cidx)
+          -- assumes 8-byte pointers like `emitAllocCtor`
+          let scalarSize := 8 * c.usize + c.ssize
+          callLeanCtorSetLayout builder zv (← constInt8 c.cidx) (← constIntUnsigned c.size)
+            (← constIntUnsigned scalarSize)
        return ShouldForwardControlFlow.yes
    )
   emitCtorSetArgs builder z ys
@@ -1575,6 +1588,23 @@ def main : M llvmctx Unit := do
   emitFns (← getLLVMModule) builder
   emitInitFn (← getLLVMModule) builder
   emitMainFnIfNeeded (← getLLVMModule) builder
+
+/--
+Emit only the definitions of `decls`, declaring everything they use as external.
+Unlike `main`, no module initializer is emitted.
+-/
+def mainDecls (decls : Array Decl) : M llvmctx Unit := do
+  let env ← getEnv
+  let declNames : NameSet := decls.foldl (fun s d => s.insert d.name) {}
+  let usedDecls : NameSet := decls.foldl (fun s d => collectUsedDecls env d s) {}
+  for n in usedDecls.toList do
+    unless declNames.contains n do
+      let decl ← getDecl n
+      match getExternNameFor env `c decl.name with
+      | some cName => emitExternDeclAux decl cName
+      | none       => emitFnDecl decl (isExternal := true)
+  let builder ← LLVM.createBuilderInContext llvmctx
+  decls.forM (emitDecl (← getLLVMModule) builder)
 end EmitLLVM
 
 def getLeanHBcPath : IO System.FilePath := do
@@ -1594,6 +1624,37 @@ partial def getModuleFunctions (mod : LLVM.Module llvmctx) : IO (Array (LLVM.Val
     else go (← LLVM.getNextFunction v) (acc.push v)
   go (← LLVM.getFirstFunction mod) #[]
 
+/--
+Link the runtime bitcode into `mod`, giving all runtime definitions internal linkage, and verify the result.
+-/
+def linkRuntime (llvmctx : LLVM.Context) (mod : LLVM.Module llvmctx) : IO Unit := do
+  let membuf ← LLVM.createMemoryBufferWithContentsOfFile (← getLeanHBcPath).toString
+  let modruntime ← LLVM.parseBitcode llvmctx membuf
+  /- It is important that we extract the names here because
+     pointers into modruntime get invalidated by linkModules -/
+  let runtimeGlobals ← (← getModuleGlobals modruntime).mapM (·.getName)
+  let filter func := do
+    -- | Do not insert internal linkage for
+    -- intrinsics such as `@llvm.umul.with.overflow.i64` which clang generates, and also
+    -- for declarations such as `lean_inc_ref_cold` which are externally defined.
+    if (← LLVM.isDeclaration func) then
+      return none
+    else
+      return some (← func.getName)
+  let runtimeFunctions ← (← getModuleFunctions modruntime).filterMapM filter
+  LLVM.linkModules (dest := mod) (src := modruntime)
+  -- Mark every global and function as having internal linkage.
+  for name in runtimeGlobals do
+    let some global ← LLVM.getNamedGlobal mod name
+       | throw <| IO.Error.userError s!"ERROR: linked module must have global from runtime module: '{name}'"
+    LLVM.setLinkage global LLVM.Linkage.internal
+  for name in runtimeFunctions do
+    let some fn ← LLVM.getNamedFunction mod name
+       | throw <| IO.Error.userError s!"ERROR: linked module must have function from runtime module: '{name}'"
+    LLVM.setLinkage fn LLVM.Linkage.internal
+  if let some err ← LLVM.verifyModule mod then
+    throw <| .userError err
+
 /--
 `emitLLVM` is the entrypoint for the lean shell to code generate LLVM.
 -/
@@ -1607,33 +1668,34 @@ def emitLLVM (env : Environment) (modName : Name) (filepath : String) : IO Unit
   let out? ← ((EmitLLVM.main (llvmctx := llvmctx)).run initState).run emitLLVMCtx
   match out? with
   | .ok _ => do
-         let membuf ← LLVM.createMemoryBufferWithContentsOfFile (← getLeanHBcPath).toString
-         let modruntime ← LLVM.parseBitcode llvmctx membuf
-         /- It is important that we extract the names here because
-            pointers into modruntime get invalidated by linkModules -/
-         let runtimeGlobals ← (← getModuleGlobals modruntime).mapM (·.getName)
-         let filter func := do
-           -- | Do not insert internal linkage for
-           -- intrinsics such as `@llvm.umul.with.overflow.i64` which clang generates, and also
-           -- for declarations such as `lean_inc_ref_cold` which are externally defined.
-           if (← LLVM.isDeclaration func) then
-             return none
-           else
-             return some (← func.getName)
-         let runtimeFunctions ← (← getModuleFunctions modruntime).filterMapM filter
-         LLVM.linkModules (dest := emitLLVMCtx.llvmmodule) (src := modruntime)
-         -- Mark every global and function as having internal linkage.
-         for name in runtimeGlobals do
-           let some global ← LLVM.getNamedGlobal emitLLVMCtx.llvmmodule name
-              | throw <| IO.Error.userError s!"ERROR: linked module must have global from runtime module: '{name}'"
-           LLVM.setLinkage global LLVM.Linkage.internal
-         for name in runtimeFunctions do
-           let some fn ← LLVM.getNamedFunction emitLLVMCtx.llvmmodule name
-              | throw <| IO.Error.userError s!"ERROR: linked module must have function from runtime module: '{name}'"
-           LLVM.setLinkage fn LLVM.Linkage.internal
-         if let some err ← LLVM.verifyModule emitLLVMCtx.llvmmodule then
-           throw <| .userError err
+         linkRuntime llvmctx emitLLVMCtx.llvmmodule
          LLVM.writeBitcodeToFile emitLLVMCtx.llvmmodule filepath
          LLVM.disposeModule emitLLVMCtx.llvmmodule
   | .error err => throw (IO.Error.userError err)
+
+/--
+`emitLLVMDecls` writes LLVM bitcode for just the given declarations to a fresh temporary file and
+returns its path. Everything the declarations use is declared as external, to be resolved against the
+code already loaded into the process. It is the entrypoint for the interpreter's JIT tier.
+-/
+@[export lean_ir_emit_llvm_decls]
+def emitLLVMDecls (env : Environment) (declNames : Array Name) : IO String := do
+  let decls ← declNames.mapM fun n => do
+    let some d := findEnvDecl env n
+      | throw <| IO.Error.userError s!"unknown declaration '{n}'"
+    pure d
+  LLVM.llvmInitializeTargetInfo
+  let llvmctx ← LLVM.createContext
+  let module ← LLVM.createModule llvmctx "_jit"
+  let emitLLVMCtx : EmitLLVM.Context llvmctx := {env := env, modName := `_jit, llvmmodule := module}
+  let initState := { var2val := default, jp2bb := default : EmitLLVM.State llvmctx}
+  let out? ← ((EmitLLVM.mainDecls (llvmctx := llvmctx) decls).run initState).run emitLLVMCtx
+  match out? with
+  | .ok _ => do
+         linkRuntime llvmctx module
+         let (_, path) ← IO.FS.createTempFile
+         LLVM.writeBitcodeToFile module path.toString
+         LLVM.disposeModule module
+         return path.toString
+  | .error err => throw (IO.Error.userError err)
 end Lean.IR
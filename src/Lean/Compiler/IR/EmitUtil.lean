@@ -16,6 +16,31 @@ def isTailCallTo (g : Name) (b : FnBody) : Bool :=
   | FnBody.vdecl x _ (Expr.fap f _) (FnBody.ret (Arg.var y)) => x == y && f == g
   | _  => false
 
+/-- Return the functions `g` s.t. `b` contains a tail call to `g`, see `isTailCallTo`. -/
+partial def collectTailCallees (b : FnBody) (s : NameSet := {}) : NameSet :=
+  match b with
+  | .vdecl x _ (.fap f _) (.ret (.var y)) => if x == y then s.insert f else s
+  | .jdecl _ _ v b   => collectTailCallees b (collectTailCallees v s)
+  | .case _ _ _ alts => alts.foldl (fun s alt => collectTailCallees alt.body s) s
+  | e                => if e.isTerminal then s else collectTailCallees e.body s
+
+/-- Return the functions `g` s.t. `b` contains a call `g ys`. -/
+partial def collectCallees (b : FnBody) (s : NameSet := {}) : NameSet :=
+  match b with
+  | .vdecl _ _ (.fap f _) b => collectCallees b (s.insert f)
+  | .jdecl _ _ v b   => collectCallees b (collectCallees v s)
+  | .case _ _ _ alts => alts.foldl (fun s alt => collectCallees alt.body s) s
+  | e                => if e.isTerminal then s else collectCallees e.body s
+
+/-- Return true iff `b` contains a call `g ys` with `p g` that is not a tail call, see `isTailCallTo`. -/
+partial def hasNonTailCall (p : FunId → Bool) (b : FnBody) : Bool :=
+  match b with
+  | .vdecl x _ (.fap f _) (.ret (.var y)) => x != y && p f
+  | .vdecl _ _ (.fap f _) b => p f || hasNonTailCall p b
+  | .jdecl _ _ v b   => hasNonTailCall p v || hasNonTailCall p b
+  | .case _ _ _ alts => alts.any (hasNonTailCall p ·.body)
+  | e                => !e.isTerminal && hasNonTailCall p e.body
+
 def usesModuleFrom (env : Environment) (modulePrefix : Name) : Bool :=
   env.allImportedModuleNames.toList.any fun modName => modulePrefix.isPrefixOf modName
 
@@ -247,9 +247,19 @@ partial def expand (mainFn : FnBody → Array FnBody → M FnBody)
   let b := FnBody.vdecl c IRType.uint8 (Expr.isShared y) (mkIf c bSlow bFast)
   return reshape bs b
 
+/--
+Return true iff all `reuse x ctor ...` instructions in `b` are for constructors with `n` object fields.
+Otherwise, the object header must be updated, which is done by `reuse` but not by `setTag`.
+-/
+partial def reusesSameSize (x : VarId) (n : Nat) : FnBody → Bool
+  | .vdecl _ _ (.reuse y c _ _) b => (x != y || c.size == n) && reusesSameSize x n b
+  | .jdecl _ _ v b   => reusesSameSize x n v && reusesSameSize x n b
+  | .case _ _ _ alts => alts.all fun alt => reusesSameSize x n alt.body
+  | e => e.isTerminal || reusesSameSize x n e.body
+
 partial def searchAndExpand : FnBody → Array FnBody → M FnBody
   | d@(FnBody.vdecl x _ (Expr.reset n y) b), bs =>
-    if consumed x b then do
+    if consumed x b && reusesSameSize x n b then do
       expand searchAndExpand bs x n y b
     else
       searchAndExpand b (push bs d)
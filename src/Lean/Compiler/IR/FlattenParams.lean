@@ -0,0 +1,211 @@
+/-
+Copyright (c) 2024 Lean FRO, LLC. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+-/
+prelude
+import Lean.Data.NameMap
+import Lean.Compiler.IR.Basic
+import Lean.Compiler.IR.FreeVars
+import Lean.Compiler.IR.NormIds
+
+/-!
+Pass scalar fields of structure parameters in registers.
+
+If a function only reads scalar fields of a parameter `x` (using `sproj`), and reads each of them
+on every path, we create a worker `f._flat` taking these fields instead of `x`, and turn `f` into a
+wrapper that reads the fields and calls the worker. Calls to `f` in the same batch call the worker
+directly; when the argument was built by a `ctor` instruction in scope, the values stored by its
+`sset` instructions are passed instead, and the now unused constructor application is removed.
+For example, in a loop `loop (acc : Vec2) (i : Nat)` over `structure Vec2 where (x y : Float)`,
+this removes the allocation of the accumulator at each iteration.
+
+Reading all fields before the call is safe because the callee reads them on every path anyway.
+-/
+
+namespace Lean.IR.FlattenParams
+
+/-- A scalar field read by `sproj n offset x`. -/
+structure Field where
+  n      : Nat
+  offset : Nat
+  ty     : IRType
+
+def Field.isReadBy (f : Field) (n offset : Nat) : Bool :=
+  f.n == n && f.offset == offset
+
+structure FlatInfo where
+  worker : FunId
+  /-- The fields passed to the worker instead of each parameter, `none` if it is passed as is. -/
+  fields : Array (Option (Array Field))
+
+/-- Remove the `sproj _ _ x` instructions from `b`, leaving the variables they define dangling. -/
+partial def eraseSProjs (x : VarId) : FnBody → FnBody
+  | .vdecl y ty (.sproj n o x') b =>
+    if x == x' then eraseSProjs x b else .vdecl y ty (.sproj n o x') (eraseSProjs x b)
+  | .jdecl j ys v b => .jdecl j ys (eraseSProjs x v) (eraseSProjs x b)
+  | .case tid y yType alts => .case tid y yType (alts.map (·.modifyBody (eraseSProjs x)))
+  | b => if b.isTerminal then b else b.setBody (eraseSProjs x b.body)
+
+partial def collectFields (x : VarId) (b : FnBody) (fs : Array Field) : Array Field :=
+  match b with
+  | .vdecl _ ty (.sproj n o x') b =>
+    let fs := if x == x' && !fs.any (·.isReadBy n o) then fs.push { n := n, offset := o, ty := ty } else fs
+    collectFields x b fs
+  | .jdecl _ _ v b => collectFields x b (collectFields x v fs)
+  | .case _ _ _ alts => alts.foldl (fun fs alt => collectFields x alt.body fs) fs
+  | b => if b.isTerminal then fs else collectFields x b.body fs
+
+/-- Return `true` if `f` is read from `x` on every path of `b`. -/
+partial def readsOnAllPaths (x : VarId) (f : Field) : FnBody → Bool
+  | .vdecl _ _ (.sproj n o x') b => (x == x' && f.isReadBy n o) || readsOnAllPaths x f b
+  | .case _ _ _ alts => alts.all fun alt => readsOnAllPaths x f alt.body
+  | .unreachable     => true
+  | .ret _           => false
+  | .jmp _ _         => false
+  | b                => readsOnAllPaths x f b.body
+
+/-- Return the fields to pass instead of `x`, if `body` only reads scalar fields of `x`. -/
+def getParamFields? (body : FnBody) (p : Param) : Option (Array Field) := do
+  guard p.ty.isObj
+  guard !(eraseSProjs p.x body).hasFreeVar p.x
+  let fs := collectFields p.x body #[]
+  guard !fs.isEmpty
+  guard (fs.all fun f => readsOnAllPaths p.x f body)
+  return fs
+
+def getFlatInfo? (d : Decl) : Option FlatInfo :=
+  match d with
+  | .fdecl f xs _ b _ =>
+    let fields := xs.map (getParamFields? b)
+    if fields.any Option.isSome then some { worker := f ++ `_flat, fields } else none
+  | _ => none
+
+/-- Replace the variables defined by `sproj _ _ x` with the corresponding worker parameters. -/
+partial def replaceFields (x : VarId) (fs : Array Field) (ys : Array VarId) : FnBody → FnBody
+  | .vdecl z ty (.sproj n o x') b =>
+    let b := replaceFields x fs ys b
+    if x == x' then
+      match fs.findIdx? (·.isReadBy n o) with
+      | some i => b.replaceVar z ys[i]!
+      | none   => .vdecl z ty (.sproj n o x') b
+    else
+      .vdecl z ty (.sproj n o x') b
+  | .jdecl j zs v b => .jdecl j zs (replaceFields x fs ys v) (replaceFields x fs ys b)
+  | .case tid z zType alts => .case tid z zType (alts.map (·.modifyBody (replaceFields x fs ys)))
+  | b => if b.isTerminal then b else b.setBody (replaceFields x fs ys b.body)
+
+/-- Scalar values stored in constructor objects in scope: `(x, n, offset, y)` for `sset x[n, offset] := y`. -/
+abbrev Known := Array (VarId × Nat × Nat × VarId)
+
+structure State where
+  nextIdx   : Index
+  /-- Constructor objects whose fields were forwarded to a worker. -/
+  forwarded : Array VarId := #[]
+
+abbrev M := ReaderT (NameMap FlatInfo) (StateM State)
+
+def mkFresh : M VarId :=
+  modifyGet fun s => ({ idx := s.nextIdx }, { s with nextIdx := s.nextIdx + 1 })
+
+/-- Compute the worker arguments for `ys`. The `sproj` instructions they need are added to `pre`. -/
+def mkWorkerArgs (known : Known) (info : FlatInfo) (ys : Array Arg) : M (Option (Array FnBody × Array Arg)) := do
+  let mut pre  : Array FnBody := #[]
+  let mut args : Array Arg    := #[]
+  for y in ys, fs? in info.fields do
+    match fs?, y with
+    | none, _ => args := args.push y
+    | some _, .irrelevant => return none
+    | some fs, .var y =>
+      let mut forwarded := false
+      for f in fs do
+        if let some (_, _, _, v) := known.find? fun (x, n, o, _) => x == y && f.isReadBy n o then
+          args := args.push (.var v)
+          forwarded := true
+        else
+          let v ← mkFresh
+          pre  := pre.push (.vdecl v f.ty (.sproj f.n f.offset y) .nil)
+          args := args.push (.var v)
+      if forwarded then
+        modify fun s => { s with forwarded := s.forwarded.push y }
+  return some (pre, args)
+
+partial def visitFnBody (known : Known) : FnBody → M FnBody
+  | .vdecl z ty (.fap g ys) b => do
+    let b ← visitFnBody known b
+    let some info := (← read).find? g | return .vdecl z ty (.fap g ys) b
+    let some (pre, args) ← mkWorkerArgs known info ys | return .vdecl z ty (.fap g ys) b
+    return reshape pre (.vdecl z ty (.fap info.worker args) b)
+  | .sset x i o y ty b => do
+    return .sset x i o y ty (← visitFnBody (known.push (x, i, o, y)) b)
+  | .jdecl j xs v b => do
+    return .jdecl j xs (← visitFnBody known v) (← visitFnBody known b)
+  | .case tid x xType alts => do
+    return .case tid x xType (← alts.mapM (·.mmodifyBody (visitFnBody known)))
+  | b => do
+    if b.isTerminal then return b
+    return b.setBody (← visitFnBody known b.body)
+
+/-- Remove the constructor application defining `x`, and the `sset` instructions on it. -/
+partial def eraseCtor (x : VarId) : FnBody → FnBody
+  | .vdecl y ty e b =>
+    match e with
+    | .ctor .. => if x == y then eraseCtor x b else .vdecl y ty e (eraseCtor x b)
+    | _        => .vdecl y ty e (eraseCtor x b)
+  | .sset y i o z ty b => if x == y then eraseCtor x b else .sset y i o z ty (eraseCtor x b)
+  | .jdecl j ys v b => .jdecl j ys (eraseCtor x v) (eraseCtor x b)
+  | .case tid y yType alts => .case tid y yType (alts.map (·.modifyBody (eraseCtor x)))
+  | b => if b.isTerminal then b else b.setBody (eraseCtor x b.body)
+
+/-- Redirect calls in `b` to workers, and remove the constructor objects that are no longer needed. -/
+def visitBody (b : FnBody) : M FnBody := do
+  modify fun s => { s with forwarded := #[] }
+  let mut b ← visitFnBody #[] b
+  for x in (← get).forwarded do
+    let b' := eraseCtor x b
+    unless b'.hasFreeVar x do
+      b := b'
+  return b
+
+def mkWorker (info : FlatInfo) (xs : Array Param) (type : IRType) (b : FnBody) (declInfo : DeclInfo) : M Decl := do
+  let mut ps : Array Param := #[]
+  let mut b  := b
+  for x in xs, fs? in info.fields do
+    match fs? with
+    | none => ps := ps.push x
+    | some fs =>
+      let ys ← fs.mapM fun _ => mkFresh
+      ps := ps ++ (ys.zipWith fs fun y f => ({ x := y, borrow := false, ty := f.ty } : Param))
+      b  := replaceFields x.x fs ys b
+  return .fdecl info.worker ps type (← visitBody b) declInfo
+
+def mkWrapper (f : FunId) (info : FlatInfo) (xs : Array Param) (type : IRType) (declInfo : DeclInfo) : M Decl := do
+  let some (pre, args) ← mkWorkerArgs #[] info (xs.map fun p => Arg.var p.x) | unreachable!
+  let r ← mkFresh
+  return .fdecl f xs type (reshape pre (.vdecl r type (.fap info.worker args) (.ret (.var r)))) declInfo
+
+end FlattenParams
+
+open FlattenParams in
+/-- Pass the scalar fields of structure parameters in registers when the structure does not escape. -/
+def flattenParams (decls : Array Decl) : Array Decl := Id.run do
+  let infos := decls.foldl (init := ({} : NameMap FlatInfo)) fun infos d =>
+    match getFlatInfo? d with
+    | some info => infos.insert d.name info
+    | none      => infos
+  if infos.isEmpty then return decls
+  let mut result : Array Decl := #[]
+  for d in decls do
+    match d with
+    | .fdecl f xs type b declInfo =>
+      let s : State := { nextIdx := d.maxIndex + 1 }
+      if let some info := infos.find? f then
+        let act : M (Decl × Decl) := do return (← mkWrapper f info xs type declInfo, ← mkWorker info xs type b declInfo)
+        let ((wrapper, worker), _) := act.run infos |>.run s
+        result := result.push wrapper |>.push worker.normalizeIds
+      else
+        let (b, _) := (visitBody b).run infos |>.run s
+        result := result.push (d.updateBody! b)
+    | _ => result := result.push d
+  return result
+
+end Lean.IR
@@ -29,26 +29,43 @@ Here are the main differences:
   does not occur in a function body. See example at `livevars.lean`.
 -/
 
-private def mayReuse (c₁ c₂ : CtorInfo) (relaxedReuse : Bool) : Bool :=
-  c₁.size == c₂.size && c₁.usize == c₂.usize && c₁.ssize == c₂.ssize &&
-  /- The following condition is a heuristic.
-     If `relaxedReuse := false`, then we don't want to reuse cells from
-     different constructors even when they are compatible
-     because it produces counterintuitive behavior. -/
-  (relaxedReuse || c₁.name.getPrefix == c₂.name.getPrefix)
+/--
+The size of the small object allocated for a constructor object on a platform with `ptrSize`-byte
+pointers, see `lean_alloc_ctor_memory`.
+-/
+private def slotSize (c : CtorInfo) (ptrSize : Nat) : Nat :=
+  let sz := 8 + ptrSize * (c.size + c.usize) + c.ssize
+  (sz + 7) / 8 * 8
+
+/--
+Return true if the memory cells of `c₁` and `c₂` are allocated in the same small object slot on both
+32-bit and 64-bit platforms, but they have a different number of object fields. Reusing the cell then
+requires updating the number of fields in the object header, see `lean_ctor_set_layout`.
+-/
+private def sameSlot (c₁ c₂ : CtorInfo) : Bool :=
+  c₁.size != c₂.size && slotSize c₁ 8 == slotSize c₂ 8 && slotSize c₁ 4 == slotSize c₂ 4
+
+private def mayReuse (c₁ c₂ : CtorInfo) (relaxedReuse slotReuse : Bool) : Bool :=
+  (c₁.size == c₂.size && c₁.usize == c₂.usize && c₁.ssize == c₂.ssize &&
+   /- The following condition is a heuristic.
+      If `relaxedReuse := false`, then we don't want to reuse cells from
+      different constructors even when they are compatible
+      because it produces counterintuitive behavior. -/
+   (relaxedReuse || c₁.name.getPrefix == c₂.name.getPrefix)) ||
+  (slotReuse && sameSlot c₁ c₂)
 
 /--
 Replace `ctor` applications with `reuse` applications if compatible.
 `w` contains the "memory cell" being reused.
 -/
-private partial def S (w : VarId) (c : CtorInfo) (relaxedReuse : Bool) (b : FnBody) : FnBody :=
+private partial def S (w : VarId) (c : CtorInfo) (relaxedReuse slotReuse : Bool) (b : FnBody) : FnBody :=
   go b
 where
   go : FnBody → FnBody
   | .vdecl x t v@(.ctor c' ys) b   =>
-    if mayReuse c c' relaxedReuse then
-      let updtCidx := c.cidx != c'.cidx
-      .vdecl x t (.reuse w c' updtCidx ys) b
+    if mayReuse c c' relaxedReuse slotReuse then
+      let updtHeader := c.cidx != c'.cidx || c.size != c'.size
+      .vdecl x t (.reuse w c' updtHeader ys) b
     else
       .vdecl x t v (go b)
   | .jdecl j ys v b   =>
@@ -93,6 +110,11 @@ structure Context where
   we first try `relaxedReuse := false`, and then `relaxedReuse := true`.
   -/
   relaxedReuse : Bool := false
+  /--
+  If `slotReuse := true`, then also allow memory cells to be reused for constructors with a different
+  number of fields that are allocated in the same small object slot, see `sameSlot`.
+  -/
+  slotReuse : Bool := false
 
 /-- We use `Context` to track join points in scope. -/
 abbrev M := ReaderT Context (StateT Index Id)
@@ -107,7 +129,8 @@ to replace a `ctor` with `reuse` in `b`.
 -/
 private def tryS (x : VarId) (c : CtorInfo) (b : FnBody) : M FnBody := do
   let w ← mkFresh
-  let b' := S w c (← read).relaxedReuse b
+  let ctx ← read
+  let b' := S w c ctx.relaxedReuse ctx.slotReuse b
   if b == b' then
     return b
   else
@@ -219,17 +242,17 @@ end ResetReuse
 open ResetReuse
 
 
-def Decl.insertResetReuseCore (d : Decl) (relaxedReuse : Bool) : Decl :=
+def Decl.insertResetReuseCore (d : Decl) (relaxedReuse : Bool) (slotReuse := false) : Decl :=
   match d with
   | .fdecl (body := b) .. =>
     let nextIndex := d.maxIndex + 1
     -- First time we execute `insertResetReuseCore`, `relaxedReuse := false`.
     let alreadyFound : PHashSet VarId := if relaxedReuse then (collectResets b *> get).run' {} else {}
-    let bNew := R b { relaxedReuse, alreadyFound } |>.run' nextIndex
+    let bNew := R b { relaxedReuse, slotReuse, alreadyFound } |>.run' nextIndex
     d.updateBody! bNew
   | other => other
 
-def Decl.insertResetReuse (d : Decl) : Decl :=
+def Decl.insertResetReuse (d : Decl) (slotReuse := false) : Decl :=
   /-
   We execute the reset/reuse algorithm twice. The first time, we only reuse memory cells
   between identical constructor memory cells. That is, we do not reuse a `PSigma.mk` memory cell
@@ -240,7 +263,41 @@ def Decl.insertResetReuse (d : Decl) : Decl :=
 
   The second pass addresses issue #4089.
   -/
-  d.insertResetReuseCore (relaxedReuse := false)
-  |>.insertResetReuseCore (relaxedReuse := true)
+  let d := d.insertResetReuseCore (relaxedReuse := false)
+    |>.insertResetReuseCore (relaxedReuse := true)
+  /-
+  With `slotReuse`, a last pass reuses the remaining cells for constructors of the same small
+  object size, e.g., when a tree node is transformed into a node of a different shape.
+  -/
+  if slotReuse then d.insertResetReuseCore (relaxedReuse := true) (slotReuse := true) else d
+
+namespace ResetReuse
+
+/-- Returns the number of `reuse` instructions and of heap-allocated constructor objects in `b`. -/
+partial def countReuses : FnBody → Nat × Nat
+  | .vdecl _ _ v b =>
+    let (r, n) := countReuses b
+    match v with
+    | .reuse ..  => (r + 1, n + 1)
+    | .ctor c _  => if c.isRef then (r, n + 1) else (r, n)
+    | _          => (r, n)
+  | .jdecl _ _ v b =>
+    let (r₁, n₁) := countReuses v
+    let (r₂, n₂) := countReuses b
+    (r₁ + r₂, n₁ + n₂)
+  | .case _ _ _ alts => alts.foldl (init := (0, 0)) fun (r, n) alt =>
+    let (r', n') := countReuses alt.body
+    (r + r', n + n')
+  | b => if b.isTerminal then (0, 0) else countReuses b.body
+
+end ResetReuse
+
+/-- Reports the number of constructor objects of `d` that may reuse memory. -/
+def Decl.reuseStats (d : Decl) : Format :=
+  match d with
+  | .fdecl (f := f) (body := b) .. =>
+    let (r, n) := ResetReuse.countReuses b
+    f!"{f}: {r}/{n} constructor objects may reuse memory"
+  | .extern .. => .nil
 
 end Lean.IR
@@ -0,0 +1,78 @@
+/-
+Copyright (c) 2024 Lean FRO, LLC. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+-/
+prelude
+import Lean.Compiler.IR.Basic
+
+/-!
+Escape analysis for constructor objects, used by the C backend to allocate them on the stack.
+
+A constructor object `x` does not escape the function if it is only projected, matched on, has its
+scalar fields written and is released by a single `dec x`. In particular, it is not stored in another
+object, returned, passed to a function or a join point, and its reference counter is never incremented.
+Objects on the stack have reference counter `0`, which the runtime treats as persistent, so passing them
+even to borrowed parameters is not allowed: the callee could increment the counter and retain them.
+The `dec x` releasing such an object only releases its fields.
+
+This analysis runs on the final IR, after reference counting instructions have been inserted.
+-/
+
+namespace Lean.IR.StackAlloc
+
+/-- Maximum number of object and `usize` fields of a constructor object allocated on the stack. -/
+def maxFields : Nat := 16
+
+structure State where
+  ctors   : Std.HashMap VarId CtorInfo := {}
+  escaped : Std.HashSet VarId := {}
+
+abbrev M := StateM State
+
+def escape (x : VarId) : M Unit :=
+  modify fun s => { s with escaped := s.escaped.insert x }
+
+def escapeArg : Arg → M Unit
+  | .var x      => escape x
+  | .irrelevant => pure ()
+
+def escapeArgs (ys : Array Arg) : M Unit :=
+  ys.forM escapeArg
+
+def visitExpr (x : VarId) : Expr → M Unit
+  | .ctor c ys => do
+    escapeArgs ys
+    if c.isRef && c.size + c.usize ≤ maxFields then
+      modify fun s => { s with ctors := s.ctors.insert x c }
+  | .reset _ y | .box _ y | .unbox y | .isShared y => escape y
+  | .reuse y _ _ ys => do escape y; escapeArgs ys
+  | .fap _ ys | .pap _ ys => escapeArgs ys
+  | .ap y ys => do escape y; escapeArgs ys
+  | .proj .. | .uproj .. | .sproj .. | .lit _ => pure ()
+
+partial def visitFnBody : FnBody → M Unit
+  | .vdecl x _ e b        => do visitExpr x e; visitFnBody b
+  | .jdecl _ _ v b        => do visitFnBody v; visitFnBody b
+  | .set x _ y b          => do escape x; escapeArg y; visitFnBody b
+  | .setTag x _ b         => do escape x; visitFnBody b
+  | .inc x _ _ _ b        => do escape x; visitFnBody b
+  | .dec x n _ _ b        => do
+    unless n == 1 do escape x
+    visitFnBody b
+  | .del x b              => do escape x; visitFnBody b
+  | .uset _ _ _ b         => visitFnBody b
+  | .sset _ _ _ _ _ b     => visitFnBody b
+  | .mdata _ b            => visitFnBody b
+  | .case _ _ _ alts      => alts.forM (visitFnBody ·.body)
+  | .jmp _ ys             => escapeArgs ys
+  | .ret y                => escapeArg y
+  | .unreachable          => pure ()
+
+end StackAlloc
+
+/-- Returns the constructor objects of `b` that can be allocated on the stack, see `StackAlloc`. -/
+def FnBody.stackCtors (b : FnBody) : Std.HashMap VarId CtorInfo :=
+  let s := (StackAlloc.visitFnBody b).run {} |>.2
+  s.ctors.filter fun x _ => !s.escaped.contains x
+
+end Lean.IR
@@ -13,6 +13,7 @@ import Lean.Compiler.LCNF.CSE
 import Lean.Compiler.LCNF.DependsOn
 import Lean.Compiler.LCNF.ElimDead
 import Lean.Compiler.LCNF.FixedParams
+import Lean.Compiler.LCNF.Fusion
 import Lean.Compiler.LCNF.InferType
 import Lean.Compiler.LCNF.JoinPoints
 import Lean.Compiler.LCNF.LCtx
@@ -31,6 +31,10 @@ structure ConfigOptions where
   Perform type compatibility checking after each compiler pass.
   -/
   checkTypes : Bool := false
+  /--
+  Fuse pipelines of collection combinators such as `(xs.map f).foldl g init` using the `[fusion]` rules.
+  -/
+  fusion : Bool := true
   deriving Inhabited
 
 register_builtin_option compiler.small : Nat := {
@@ -57,11 +61,18 @@ register_builtin_option compiler.checkTypes : Bool := {
   descr    := "(compiler) perform type compatibility checking after each compiler pass. Note this is not a complete check, and it is used only for debugging purposes. It fails in code that makes heavy use of dependent types."
 }
 
+register_builtin_option compiler.fusion : Bool := {
+  defValue := true
+  group    := "compiler"
+  descr    := "(compiler) fuse pipelines of collection combinators such as `(xs.map f).foldl g init` into a single traversal using the `[fusion]` rules."
+}
+
 def toConfigOptions (opts : Options) : ConfigOptions := {
   smallThreshold := compiler.small.get opts
   maxRecInline   := compiler.maxRecInline.get opts
   maxRecInlineIfReduce := compiler.maxRecInlineIfReduce.get opts
   checkTypes := compiler.checkTypes.get opts
+  fusion := compiler.fusion.get opts
 }
 
 end Lean.Compiler.LCNF
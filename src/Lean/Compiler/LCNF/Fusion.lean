@@ -0,0 +1,155 @@
+/-
+Copyright (c) 2024 Lean FRO, LLC. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+-/
+prelude
+import Init.Data.List.Lemmas
+import Lean.ScopedEnvExtension
+import Lean.Meta.Transform
+import Lean.Meta.Instances
+
+/-!
+# Fusion of collection combinators
+
+A pipeline such as `(xs.map f).foldl g init` allocates an intermediate list for `xs.map f` that is
+consumed right away. Fusion rules are equations tagged with `[fusion]` whose left-hand side is an
+application of a combinator (e.g., `List.foldl`) to the result of another one (e.g., `List.map`), and
+whose right-hand side traverses the collection only once:
+```
+theorem foldl_map (f : β₁ → β₂) (g : α → β₂ → α) (l : List β₁) (init : α) :
+    (l.map f).foldl g init = l.foldl (fun x y => g x (f y)) init
+```
+`toDecl` rewrites with these rules before the code is put into LCNF, where the types needed to match
+and instantiate them are still available. The result of a rewrite is rewritten again, so a whole
+pipeline is fused into a single traversal as long as there is a rule for each pair of adjacent
+combinators. A `let`-bound intermediate result is fused as well if it is used exactly once and not
+inside a lambda, where inlining it could evaluate it more than once.
+
+Rules must be equations between terms that evaluate equally, and the right-hand side must contain
+fewer combinator applications than the left-hand side. Otherwise, rewriting may not terminate.
+-/
+
+namespace Lean.Compiler.LCNF
+namespace Fusion
+
+structure Entry where
+  /-- The combinator at the head of the left-hand side, e.g., `List.foldl`. -/
+  outerDeclName : Name
+  /-- The combinator producing the intermediate result, e.g., `List.map`. -/
+  innerDeclName : Name
+  thmName       : Name
+  deriving Inhabited
+
+structure State where
+  /-- Rules indexed by `Entry.outerDeclName`. -/
+  rules      : NameMap (Array Entry) := {}
+  /-- The `Entry.innerDeclName`s of all rules. -/
+  innerNames : NameSet := {}
+  deriving Inhabited
+
+def State.addEntry (s : State) (e : Entry) : State :=
+  { rules := s.rules.insert e.outerDeclName ((s.rules.findD e.outerDeclName #[]).push e)
+    innerNames := s.innerNames.insert e.innerDeclName }
+
+/-- Rules for the combinators in `Init`, which cannot use the `[fusion]` attribute. -/
+def builtinEntries : List Entry := [
+  { outerDeclName := ``List.foldl,     innerDeclName := ``List.map,       thmName := ``List.foldl_map },
+  { outerDeclName := ``List.foldr,     innerDeclName := ``List.map,       thmName := ``List.foldr_map },
+  { outerDeclName := ``List.map,       innerDeclName := ``List.map,       thmName := ``List.map_map },
+  { outerDeclName := ``List.filter,    innerDeclName := ``List.filter,    thmName := ``List.filter_filter },
+  { outerDeclName := ``List.filterMap, innerDeclName := ``List.map,       thmName := ``List.filterMap_map },
+  { outerDeclName := ``List.map,       innerDeclName := ``List.filterMap, thmName := ``List.map_filterMap },
+  { outerDeclName := ``List.filter,    innerDeclName := ``List.filterMap, thmName := ``List.filter_filterMap },
+  { outerDeclName := ``List.filterMap, innerDeclName := ``List.filterMap, thmName := ``List.filterMap_filterMap }
+]
+
+builtin_initialize ext : SimpleScopedEnvExtension Entry State ←
+  registerSimpleScopedEnvExtension {
+    initial  := builtinEntries.foldl State.addEntry {}
+    addEntry := State.addEntry
+  }
+
+private def isFusionRule? (declName : Name) : MetaM (Option Entry) := do
+  let info ← getConstInfo declName
+  Meta.forallTelescopeReducing info.type fun _ type => do
+    let some (_, lhs, _) := type.eq? | return none
+    let .const outerDeclName _ := lhs.getAppFn | return none
+    for arg in lhs.getAppArgs do
+      let .const innerDeclName _ := arg.getAppFn | continue
+      -- skip types, instances and numerals
+      if (← Meta.isType arg) || (← Meta.isInstance innerDeclName) || arg.isAppOf ``OfNat.ofNat then
+        continue
+      return some { outerDeclName, innerDeclName, thmName := declName }
+    return none
+
+def add (declName : Name) (kind : AttributeKind) : MetaM Unit := do
+  if let some entry ← isFusionRule? declName then
+    ext.add entry kind
+  else
+    throwError "invalid 'fusion' theorem, the left-hand side must be an application of a constant to an application of a constant (e.g., `(l.map f).foldl g init = ...`)"
+
+builtin_initialize
+  registerBuiltinAttribute {
+    name  := `fusion
+    descr := "fusion rule for collection combinators used by the compiler"
+    add   := fun declName stx attrKind => do
+      Attribute.Builtin.ensureNoArgs stx
+      Meta.MetaM.run' <| add declName attrKind
+  }
+
+/-- Rewrites `e` with the rule `thmName`. -/
+private def rewrite? (e : Expr) (thmName : Name) : MetaM (Option Expr) := do
+  let info ← getConstInfo thmName
+  let us ← info.levelParams.mapM fun _ => Meta.mkFreshLevelMVar
+  let (_, _, type) ← Meta.forallMetaTelescopeReducing (info.type.instantiateLevelParams info.levelParams us)
+  let some (_, lhs, rhs) := type.eq? | return none
+  unless (← Meta.withReducible <| Meta.isDefEq lhs e) do return none
+  let rhs ← instantiateMVars rhs
+  if rhs.hasMVar then return none
+  return some rhs
+
+private def fuseApp? (s : State) (e : Expr) : MetaM (Option Expr) := do
+  let .const declName _ := e.getAppFn | return none
+  let some entries := s.rules.find? declName | return none
+  let args := e.getAppArgs
+  for entry in entries do
+    if args.any (·.isAppOf entry.innerDeclName) then
+      if let some e' ← rewrite? e entry.thmName then
+        return some e'
+  return none
+
+/--
+Returns `true` if the loose bound variable `0` occurs exactly once in `e` and not inside a lambda.
+-/
+private def usedOnceOutsideLambda (e : Expr) : Bool :=
+  go e 0 == some 1
+where
+  /-- The number of occurrences of `i` in `e`, or `none` if one of them is inside a lambda. -/
+  go (e : Expr) (i : Nat) : Option Nat :=
+    if !e.hasLooseBVar i then
+      some 0
+    else match e with
+      | .bvar ..         => some 1
+      | .app f a         => do return (← go f i) + (← go a i)
+      | .letE _ _ v b _  => do return (← go v i) + (← go b (i+1))
+      | .mdata _ b       => go b i
+      | .proj _ _ b      => go b i
+      | .forallE ..      => some 0
+      | _                => none
+
+/--
+Rewrites `e` with the `[fusion]` rules.
+-/
+def fuse (e : Expr) : MetaM Expr := do
+  let s := ext.getState (← getEnv)
+  Meta.transform e fun e => do
+    if let some e' ← fuseApp? s e then
+      return .visit e'
+    if let .letE _ _ v b _ := e then
+      if let .const declName _ := v.getAppFn then
+        if s.innerNames.contains declName && usedOnceOutsideLambda b then
+          return .visit (b.instantiate1 v)
+    return .continue
+
+end Fusion
+end Lean.Compiler.LCNF
@@ -48,17 +48,24 @@ compiler passes in order to ease debugging.
 The trace can be viewed with `set_option trace.Compiler.step true`.
 -/
 def checkpoint (stepName : Name) (decls : Array Decl) : CompilerM Unit := do
+  let clsName := `Compiler ++ stepName
+  let tracing ← Lean.isTracingEnabledFor clsName
+  let check := compiler.check.get (← getOptions)
   for decl in decls do
     trace[Compiler.stat] "{decl.name} : {decl.size}"
-    withOptions (fun opts => opts.setBool `pp.motives.pi false) do
-      let clsName := `Compiler ++ stepName
-      if (← Lean.isTracingEnabledFor clsName) then
-        Lean.addTrace clsName m!"size: {decl.size}\n{← ppDecl' decl}"
-      if compiler.check.get (← getOptions) then
-        decl.check
-  if compiler.check.get (← getOptions) then
+    if tracing || check then
+      withOptions (fun opts => opts.setBool `pp.motives.pi false) do
+        if tracing then
+          Lean.addTrace clsName m!"size: {decl.size}\n{← ppDecl' decl}"
+        if check then
+          decl.check
+  if check then
     checkDeadLocalDecls decls
 
+/-- Total size of `decls`, reported for each pass by `trace.Compiler` and `trace.profiler`. -/
+def totalSize (decls : Array Decl) : Nat :=
+  decls.foldl (· + ·.size) 0
+
 namespace PassManager
 
 def run (declNames : Array Name) : CompilerM (Array Decl) := withAtLeastMaxRecDepth 8192 do
@@ -73,8 +80,15 @@ def run (declNames : Array Name) : CompilerM (Array Decl) := withAtLeastMaxRecDe
   let mut decls ← declNames.mapM toDecl
   decls := markRecDecls decls
   let manager ← getPassManager
+  -- sizes are only computed if the trace node of the pass may be displayed
+  let reportSizes := (← Lean.isTracingEnabledFor `Compiler) || trace.profiler.get (← getOptions)
   for pass in manager.passes do
-    decls ← withTraceNode `Compiler (fun _ => return m!"new compiler phase: {pass.phase}, pass: {pass.name}") do
+    let sizeBefore := if reportSizes then totalSize decls else 0
+    decls ← withTraceNode `Compiler (fun r => do
+        let sizes := match r with
+          | .ok decls => if reportSizes then m!", size: {sizeBefore} → {totalSize decls}" else m!""
+          | .error _  => m!""
+        return m!"new compiler phase: {pass.phase}, pass: {pass.name}{sizes}") do
       withPhase pass.phase <| pass.run decls
     withPhase pass.phaseOut <| checkpoint pass.name decls
   if (← Lean.isTracingEnabledFor `Compiler.result) then
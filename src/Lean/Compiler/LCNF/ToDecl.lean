@@ -8,6 +8,7 @@ import Lean.Meta.Transform
 import Lean.Meta.Match.MatcherInfo
 import Lean.Compiler.ImplementedByAttr
 import Lean.Compiler.LCNF.ToLCNF
+import Lean.Compiler.LCNF.Fusion
 
 namespace Lean.Compiler.LCNF
 /--
@@ -91,16 +92,19 @@ The steps for this are roughly:
 - eta-expanding the declaration value.
 - if the declaration has an unsafe-rec version, use it.
 - expand declarations tagged with the `[macro_inline]` attribute
+- fuse collection combinators with the `[fusion]` rules
 - turn the resulting term into LCNF declaration
 -/
 def toDecl (declName : Name) : CompilerM Decl := do
   let declName := if let some name := isUnsafeRecName? declName then name else declName
   let some info ← getDeclInfo? declName | throwError "declaration `{declName}` not found"
   let some value := info.value? | throwError "declaration `{declName}` does not have a value"
+  let fusion := (← getConfig).fusion
   let (type, value) ← Meta.MetaM.run' do
     let type  ← toLCNFType info.type
     let value ← Meta.lambdaTelescope value fun xs body => do Meta.mkLambdaFVars xs (← Meta.etaExpand body)
     let value ← replaceUnsafeRecNames value
+    let value ← if fusion then Fusion.fuse value else pure value
     let value ← macroInline value
     /- Recall that some declarations tagged with `macro_inline` contain matchers. -/
     let value ← inlineMatchers value
@@ -60,6 +60,72 @@ private def Name.mangleAux : Name → String
 def Name.mangle (n : Name) (pre : String := "l_") : String :=
   pre ++ Name.mangleAux n
 
+private def hexDigit? (c : Char) : Option Nat :=
+  if c.isDigit then some (c.toNat - '0'.toNat)
+  else if 'a' ≤ c && c ≤ 'f' then some (c.toNat - 'a'.toNat + 10)
+  else none
+
+private def parseHex : Nat → List Char → Nat → Option (Nat × List Char)
+  | 0,   cs,      v => some (v, cs)
+  | n+1, c :: cs, v => do parseHex n cs (v * 16 + (← hexDigit? c))
+  | _+1, [],      _ => none
+
+/--
+Decodes an escape sequence produced by `String.mangle` after its leading `_`. Characters that are
+not escaped by `String.mangle` are rejected, so that, e.g., `Foo_x41` is read as `Foo.x41` instead
+of `FooA`.
+-/
+private def demangleEscape? : List Char → Option (Char × List Char)
+  | 'x' :: cs => go 2 cs
+  | 'u' :: cs => go 4 cs
+  | 'U' :: cs => go 8 cs
+  | _         => none
+where
+  go (n : Nat) (cs : List Char) : Option (Char × List Char) := do
+    let (v, cs) ← parseHex n cs 0
+    let c := Char.ofNat v
+    guard !(c.isAlpha || c.isDigit || c == '_')
+    return (c, cs)
+
+private def pushComponent (n : Name) (cur : String) : Name :=
+  if cur.isEmpty then n else .str n cur
+
+private partial def demangleAux (n : Name) (cur : String) : List Char → Name
+  | [] => pushComponent n cur
+  | '_' :: cs =>
+    let (us, rest) := cs.span (· == '_')
+    match demangleEscape? rest with
+    | some (c, rest) =>
+      -- the last underscore of the run starts the escape sequence
+      let (n, cur) := underscores us.length n cur
+      demangleAux n (cur.push c) rest
+    | none =>
+      let (n, cur) := underscores (us.length + 1) n cur
+      match rest.span Char.isDigit, cur.isEmpty with
+      | (ds@(_ :: _), '_' :: rest'), true => demangleAux (.num n (String.mk ds).toNat!) "" rest'
+      | _, _ => demangleAux n cur rest
+  | c :: cs => demangleAux n (cur.push c) cs
+where
+  /--
+  Splits a run of `k` underscores into a separator, if `k` is odd, followed by escaped underscores.
+  Putting the separator first is right for the common compiler-generated components such as
+  `_lambda_1`, `_boxed`, and `_private`.
+  -/
+  underscores (k : Nat) (n : Name) (cur : String) : Name × String :=
+    let lit := "".pushn '_' (k / 2)
+    if k % 2 == 0 then (n, cur ++ lit) else (pushComponent n cur, lit)
+
+/--
+Inverse of `Name.mangle` for symbols with the default prefix `l_`, used to map native symbols back
+to declarations. As the mangling is not injective, the result is only a best guess for names with
+components that contain underscores or consist of digits.
+-/
+def Name.demangle? (s : String) : Option Name := do
+  guard (s.startsWith "l_")
+  let n := demangleAux .anonymous "" (s.drop 2).toList
+  guard !n.isAnonymous
+  return n
+
 @[export lean_mk_module_initialization_function_name]
 def mkModuleInitializationFunctionName (moduleName : Name) : String :=
   "initialize_" ++ moduleName.mangle ""
@@ -85,6 +85,10 @@ structure SpecInfo where
 
 structure SpecState where
   specInfo : SMap Name SpecInfo := {}
+  /--
+  Specializations indexed by the callee applied to its closed fixed arguments (see `specialize.cpp`).
+  The entries are persistent, so a downstream module reuses the specializations of its imports
+  instead of generating and compiling them again. -/
   cache    : SMap Expr Name := {}
   deriving Inhabited
 
@@ -289,6 +289,8 @@ level of elaboration. In particular, we want to skip producing further increment
 the exception has been thrown.
  -/
 @[inline] def checkInterrupted : CoreM Unit := do
+  if (← IO.checkCancelScope) then
+    throw <| .internal interruptExceptionId
   if let some tk := (← read).cancelTk? then
     if (← tk.isSet) then
       throw <| .internal interruptExceptionId
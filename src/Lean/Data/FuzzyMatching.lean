@@ -11,6 +11,7 @@ https://clang.llvm.org/extra//doxygen/FuzzyMatch_8cpp_source.html
 prelude
 import Init.Data.Range
 import Init.Data.OfScientific
+import Init.Data.UInt.Basic
 
 namespace Lean
 namespace FuzzyMatching
@@ -248,6 +249,33 @@ def fuzzyMatchScore? (pattern word : String) : Option Float := Id.run do
 def fuzzyMatchScoreWithThreshold? (pattern word : String) (threshold := 0.1) : Option Float :=
   fuzzyMatchScore? pattern word |>.filter (· > threshold)
 
+/--
+Bitmask of the characters of `s`, ignoring case: bit `i` is set for the letters `a`-`z` (`i < 26`)
+and digits `0`-`9` (`26 ≤ i < 36`), and bit `36 + c % 28` for any other character `c`.
+
+A pattern can only fuzzy match a word if it is a subsequence of the word ignoring case, so its mask
+must be contained in the mask of the word, see `maskMayMatch`. Masks of candidate words can be
+computed once to reject most of them with a single comparison.
+-/
+def charMask (s : String) : UInt64 :=
+  s.foldl (init := 0) fun mask c =>
+    let c := c.toLower
+    let bit :=
+      if 'a' ≤ c && c ≤ 'z' then
+        c.toNat - 'a'.toNat
+      else if '0' ≤ c && c ≤ '9' then
+        26 + (c.toNat - '0'.toNat)
+      else
+        36 + c.toNat % 28
+    mask ||| ((1 : UInt64) <<< bit.toUInt64)
+
+/--
+Returns `false` if a pattern with `charMask` equal to `patternMask` cannot fuzzy match a word with
+`charMask` equal to `wordMask`.
+-/
+@[inline] def maskMayMatch (patternMask wordMask : UInt64) : Bool :=
+  patternMask &&& wordMask == patternMask
+
 /-- Match the given pattern with the given word using a fuzzy matching
 algorithm. Return `false` if no match was found or the found match received a
 score below the given threshold. -/
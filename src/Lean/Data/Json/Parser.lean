@@ -41,7 +41,31 @@ def escapedChar : Parser Char := do
     return Char.ofNat $ 4096*u1 + 256*u2 + 16*u3 + u4
   | _ => fail "illegal \\u escape"
 
+/--
+Returns the first position at or after `pos` in `s` of a `"`, `\` or control character, or the
+position after the last one if there is none. The characters in between can be copied verbatim from a
+string literal. The native implementation scans several bytes at once.
+-/
+@[extern "lean_json_scan_string"]
+def scanPlain (s : @& String) (pos : @& String.Pos) : String.Pos :=
+  if h : pos < s.endPos then
+    let c := s.get pos
+    if c == '"' || c == '\\' || c.val < 0x20 then
+      pos
+    else
+      have := Nat.sub_lt_sub_left h (String.lt_next s pos)
+      scanPlain s (s.next pos)
+  else
+    pos
+termination_by s.endPos.1 - pos.1
+
+/-- Appends the characters up to the next `"`, `\` or control character to `acc` in one step. -/
+@[inline] def plainChars (acc : String) : Parser String := fun it =>
+  let stop := scanPlain it.s it.i
+  .success ⟨it.s, stop⟩ (if stop == it.i then acc else acc ++ it.s.extract it.i stop)
+
 partial def strCore (acc : String) : Parser String := do
+  let acc ← plainChars acc
   let c ← peek!
   if c == '"' then
     skip
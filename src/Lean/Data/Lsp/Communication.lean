@@ -10,6 +10,32 @@ import Lean.Data.JsonRpc
 
 /-! Reading/writing LSP messages from/to IO handles. -/
 
+namespace Lean.Lsp
+
+open JsonRpc
+
+/--
+Name of a nonstandard LSP header field by which a file worker tells the watchdog how to relay a
+message without parsing it: `notification <method>` or `response <id as JSON>`.
+-/
+def relayHeaderField := "Lean-Relay"
+
+/-- An LSP message read by `IO.FS.Stream.readLspRelayedMessage`. -/
+inductive RelayedMessage where
+  /-- A notification with the given method and unparsed JSON body. -/
+  | notification (method : String) (body : String)
+  /-- A response or response error with the given ID and unparsed JSON body. -/
+  | response (id : RequestID) (body : String)
+  /-- A message without relay information. -/
+  | message (msg : Message)
+
+/-- Parses the body of a relayed message, if necessary. -/
+def RelayedMessage.toMessage : RelayedMessage → Except String Message
+  | .notification _ body | .response _ body => do fromJson? (← Json.parse body)
+  | .message msg => return msg
+
+end Lean.Lsp
+
 namespace IO.FS.Stream
 
 open Lean
@@ -55,15 +81,17 @@ section
         else
           throw $ userError s!"Invalid header field: {repr l}"
 
-  /-- Returns the Content-Length. -/
-  private def readLspHeader (h : FS.Stream) : IO Nat := do
-    let fields ← readHeaderFields h
+  private def getContentLength (fields : List (String × String)) : IO Nat := do
     match fields.lookup "Content-Length" with
     | some length => match length.toNat? with
       | some n => pure n
       | none   => throw $ userError s!"Content-Length header field value '{length}' is not a Nat"
     | none => throw $ userError s!"No Content-Length field in header: {fields}"
 
+  /-- Returns the Content-Length. -/
+  private def readLspHeader (h : FS.Stream) : IO Nat := do
+    getContentLength (← readHeaderFields h)
+
   def readLspMessage (h : FS.Stream) : IO Message := do
     try
       let nBytes ← readLspHeader h
@@ -71,6 +99,36 @@ section
     catch e =>
       throw $ userError s!"Cannot read LSP message: {e}"
 
+  /--
+  Reads an LSP message, leaving its body unparsed if the header contains relay information, see
+  `Lean.Lsp.relayHeaderField`.
+  -/
+  def readLspRelayedMessage (h : FS.Stream) : IO Lsp.RelayedMessage := do
+    try
+      let fields ← readHeaderFields h
+      let nBytes ← getContentLength fields
+      let some relay := fields.lookup Lsp.relayHeaderField
+        | return .message (← h.readMessage nBytes)
+      let readBody : IO String := do
+        let some body := String.fromUTF8? (← h.read (USize.ofNat nBytes))
+          | throw $ userError "invalid UTF-8"
+        return body
+      -- split only at the first space as string request IDs may contain spaces
+      let kind := relay.takeWhile (· != ' ')
+      let arg := relay.drop (kind.length + 1)
+      match kind with
+      | "notification" =>
+        if arg.isEmpty || arg.contains ' ' then
+          throw $ userError s!"Invalid header field value: {relay}"
+        return .notification arg (← readBody)
+      | "response" =>
+        let .ok (id : RequestID) := Json.parse arg >>= fromJson?
+          | throw $ userError s!"Invalid request ID in header field: {relay}"
+        return .response id (← readBody)
+      | _ => throw $ userError s!"Invalid header field value: {relay}"
+    catch e =>
+      throw $ userError s!"Cannot read LSP message: {e}"
+
   def readLspRequestAs (h : FS.Stream) (expectedMethod : String) (α) [FromJson α] : IO (Request α) := do
     try
       let nBytes ← readLspHeader h
@@ -96,14 +154,28 @@ end
 section
   variable [ToJson α]
 
-  def writeLspMessage (h : FS.Stream) (msg : Message) : IO Unit := do
+  /--
+  Writes an LSP message. With `relay := true`, the header contains the information the watchdog needs
+  to relay the message verbatim, see `Lean.Lsp.relayHeaderField`.
+  -/
+  def writeLspMessage (h : FS.Stream) (msg : Message) (relay := false) : IO Unit := do
+    let relayField := if !relay then "" else match msg with
+      | .notification method _ => s!"{Lsp.relayHeaderField}: notification {method}\r\n"
+      | .response id _ | .responseError id .. =>
+        s!"{Lsp.relayHeaderField}: response {(toJson id).compress}\r\n"
+      | .request .. => ""
     -- inlined implementation instead of using jsonrpc's writeMessage
     -- to maintain the atomicity of putStr
     let j := (toJson msg).compress
-    let header := s!"Content-Length: {toString j.utf8ByteSize}\r\n\r\n"
+    let header := s!"Content-Length: {toString j.utf8ByteSize}\r\n{relayField}\r\n"
     h.putStr (header ++ j)
     h.flush
 
+  /-- Writes an LSP message with an already serialized JSON body. -/
+  def writeLspRawMessage (h : FS.Stream) (body : String) : IO Unit := do
+    h.putStr (s!"Content-Length: {toString body.utf8ByteSize}\r\n\r\n" ++ body)
+    h.flush
+
   def writeLspRequest (h : FS.Stream) (r : Request α) : IO Unit :=
     h.writeLspMessage r
 
@@ -139,6 +139,39 @@ partial def insertAux [BEq α] [Hashable α] : Node α β → USize → USize 
 def insert {_ : BEq α} {_ : Hashable α} : PersistentHashMap α β → α → β → PersistentHashMap α β
   | { root }, k, v => { root := insertAux root (hash k |>.toUSize) 1 k v }
 
+private theorem size_modify {ks : Array α} {vs : Array β} (h : ks.size = vs.size) (i : Nat) (f : β → β)
+                            : ks.size = (vs.modify i f).size := by
+  rw [h]; unfold Array.modify Array.modifyM
+  split
+  · exact (Array.size_set ..).symm
+  · rfl
+
+@[specialize] partial def upsertAux [BEq α] [Hashable α] (f : Option β → β) : Node α β → USize → USize → α → Node α β
+  | n@(Node.collision keys vals heq), h, depth, k =>
+    match keys.indexOf? k with
+    | some idx => Node.collision keys (vals.modify idx fun v => f (some v)) (size_modify heq idx _)
+    | none     => insertAux n h depth k (f none)
+  | Node.entries entries, h, depth, k =>
+    let j     := (mod2Shift h shift).toNat
+    -- `Array.modify` takes the entry out of the array, so the value is not shared with it
+    Node.entries $ entries.modify j fun entry =>
+      match entry with
+      | Entry.null        => Entry.entry k (f none)
+      | Entry.ref node    => Entry.ref $ upsertAux f node (div2Shift h shift) (depth+1) k
+      | Entry.entry k' v' =>
+        if k == k' then Entry.entry k' (f (some v'))
+        else Entry.ref $ mkCollisionNode k' v' k (f none)
+
+/--
+Associates `k` with `f (m.find? k)`. If `k` is already in the map, its key is kept.
+
+Unlike `m.insert k (f (m.find? k))`, the old value is not referenced by the map anymore when it is
+passed to `f`. If `m` is not shared, `f` can thus update the value in place, e.g., when the values
+are themselves arrays or maps that are built up by a sequence of insertions.
+-/
+@[inline] def upsert {_ : BEq α} {_ : Hashable α} : PersistentHashMap α β → α → (Option β → β) → PersistentHashMap α β
+  | { root }, k, f => { root := upsertAux f root (hash k |>.toUSize) 1 k }
+
 partial def findAtAux [BEq α] (keys : Array α) (vals : Array β) (heq : keys.size = vals.size) (i : Nat) (k : α) : Option β :=
   if h : i < keys.size then
     let k' := keys[i]
@@ -21,6 +21,11 @@ search trees like `RBTree`.
 Moreover, many nodes have degree 1, which justifies the special case `Node1`
 constructor.
 
+On the other hand, a few nodes such as the root of the token table have a very large degree and are
+visited for every token. Once a node reaches `denseDegree` children, it is turned into a `dense`
+node that stores a child for every byte, using `leaf none` for missing ones, so that a lookup is a
+single array access, like a transition in a DFA over the UTF-8 bytes of the input.
+
 The code would be a bit less repetitive if we used something like the following
 ```
 mutual
@@ -41,10 +46,15 @@ inductive Trie (α : Type) where
   | leaf : Option α → Trie α
   | node1 : Option α → UInt8 → Trie α → Trie α
   | node : Option α → ByteArray → Array (Trie α) → Trie α
+  /-- A node with a child for each of the 256 byte values. -/
+  | dense : Option α → Array (Trie α) → Trie α
 
 namespace Trie
 variable {α : Type}
 
+/-- Degree at which a `node` is turned into a `dense` node. -/
+def denseDegree : Nat := 16
+
 /-- The empty `Trie` -/
 def empty : Trie α := leaf none
 
@@ -87,11 +97,21 @@ partial def upsert (t : Trie α) (s : String) (f : Option α → α) : Trie α :
         match cs.findIdx? (· == c) with
           | none   =>
             let t := insertEmpty (i + 1)
-            node v (cs.push c) (ts.push t)
+            if cs.size + 1 < denseDegree then
+              node v (cs.push c) (ts.push t)
+            else
+              let ds := (mkArray 256 empty).set! c.toNat t
+              dense v <| (cs.toList.zip ts.toList).foldl (init := ds) fun ds (c, t) => ds.set! c.toNat t
           | some idx =>
             node v cs (ts.modify idx (loop (i + 1)))
       else
         node (f v) cs ts
+    | i, dense v ts =>
+      if h : i < s.utf8ByteSize then
+        let c := s.getUtf8Byte i h
+        dense v (ts.modify c.toNat (loop (i + 1)))
+      else
+        dense (f v) ts
   loop 0 t
 
 /-- Inserts a value at a the given key `s`, overriding an existing value if present. -/
@@ -122,6 +142,12 @@ partial def find? (t : Trie α) (s : String) : Option α :=
         | some idx => loop (i + 1) (ts.get! idx)
       else
         val
+    | i, dense val ts =>
+      if h : i < s.utf8ByteSize then
+        let c := s.getUtf8Byte i h
+        loop (i + 1) (ts.get! c.toNat)
+      else
+        val
   loop 0 t
 
 /-- Returns an `Array` of all values in the trie, in no particular order. -/
@@ -139,6 +165,10 @@ partial def values (t : Trie α) : Array α := go t |>.run #[] |>.2
         if let some a := a? then
           modify (·.push a)
         ts.forM fun t' => go t'
+      | dense a? ts => do
+        if let some a := a? then
+          modify (·.push a)
+        ts.forM fun t' => go t'
 
 /-- Returns all values whose key have the given string `pre` as a prefix, in no particular order. -/
 partial def findPrefix (t : Trie α) (pre : String) : Array α := go t 0
@@ -156,6 +186,7 @@ partial def findPrefix (t : Trie α) (pre : String) : Array α := go t 0
           match cs.findIdx? (· == c) with
           | none   => .empty
           | some idx => go (ts.get! idx) (i + 1)
+        | dense _val ts => go (ts.get! c.toNat) (i + 1)
       else
         t.values
 
@@ -183,6 +214,13 @@ partial def matchPrefix (s : String) (t : Trie α) (i : String.Pos) : Option α
         | some idx => loop (ts.get! idx) (i + 1) res
       else
         res
+    | dense v ts, i, res =>
+      let res := if v.isSome then v else res
+      if h : i < s.utf8ByteSize then
+        let c := s.getUtf8Byte i h
+        loop (ts.get! c.toNat) (i + 1) res
+      else
+        res
   loop t i.byteIdx none
 
 private partial def toStringAux {α : Type} : Trie α → List Format
@@ -193,6 +231,11 @@ private partial def toStringAux {α : Type} : Trie α → List Format
     List.flatten $ List.zipWith (fun c t =>
       [ format (repr c), (Format.group $ Format.nest 4 $ flip Format.joinSep Format.line $ toStringAux t) ]
     ) cs.toList ts.toList
+  | dense _ ts =>
+    List.flatten $ (List.range 256).filterMap fun c =>
+      match ts.get! c with
+      | leaf none => none
+      | t => some [ format (repr c.toUInt8), (Format.group $ Format.nest 4 $ flip Format.joinSep Format.line $ toStringAux t) ]
 
 instance {α : Type} : ToString (Trie α) :=
   ⟨fun t => (flip Format.joinSep Format.line $ toStringAux t).pretty⟩
@@ -53,3 +53,4 @@ import Lean.Elab.CheckTactic
 import Lean.Elab.MatchExpr
 import Lean.Elab.Tactic.Doc
 import Lean.Elab.Time
+import Lean.Elab.Speculative
@@ -302,25 +302,47 @@ instance : MonadLog CommandElabM where
     let msg := { msg with data := MessageData.withNamingContext { currNamespace := currNamespace, openDecls := openDecls } msg.data }
     modify fun s => { s with messages := s.messages.add msg }
 
+register_builtin_option linter.parallel : Bool := {
+  defValue := false
+  descr    := "run the linters of a command in parallel tasks; their messages are still reported in the order in which the linters were registered"
+}
+
+private def runLinter (linter : Linter) (stx : Syntax) : CommandElabM Unit :=
+  withTraceNode `Elab.lint (fun _ => return m!"running linter: {linter.name}")
+      (tag := linter.name.toString) do
+    let savedState ← get
+    try
+      linter.run stx
+    catch ex =>
+      match ex with
+      | Exception.error ref msg =>
+        logException (.error ref m!"linter {linter.name} failed: {msg}")
+      | Exception.internal _ _ =>
+        logException ex
+    finally
+      modify fun s => { savedState with messages := s.messages }
+
 def runLinters (stx : Syntax) : CommandElabM Unit := do
   profileitM Exception "linting" (← getOptions) do
     withTraceNode `Elab.lint (fun _ => return m!"running linters") do
       let linters ← lintersRef.get
       unless linters.isEmpty do
-        for linter in linters do
-          withTraceNode `Elab.lint (fun _ => return m!"running linter: {linter.name}")
-              (tag := linter.name.toString) do
-            let savedState ← get
-            try
-              linter.run stx
-            catch ex =>
-              match ex with
-              | Exception.error ref msg =>
-                logException (.error ref m!"linter {linter.name} failed: {msg}")
-              | Exception.internal _ _ =>
-                logException ex
-            finally
-              modify fun s => { savedState with messages := s.messages }
+        if linter.parallel.get (← getOptions) && linters.size > 1 then
+          -- Linters only communicate with the rest of the command through their messages and
+          -- traces, so each one can run on its own copy of the state, starting with empty ones.
+          let ctx ← read
+          let s := { (← get) with messages := {}, traceState := {} }
+          let tasks ← linters.mapM fun linter =>
+            EIO.asTask ((runLinter linter stx).run ctx |>.run s)
+          for task in tasks do
+            match (← IO.wait task) with
+            | .ok (_, s') => modify fun s => { s with
+                messages := s.messages ++ s'.messages
+                traceState.traces := s.traceState.traces ++ s'.traceState.traces }
+            | .error ex   => logException ex
+        else
+          for linter in linters do
+            runLinter linter stx
 
 protected def getCurrMacroScope : CommandElabM Nat  := do pure (← read).currMacroScope
 protected def getMainModule     : CommandElabM Name := do pure (← getEnv).mainModule
@@ -506,11 +528,25 @@ builtin_initialize
   registerTraceClass `Elab.info
   registerTraceClass `Elab.snapshotTree
 
+/--
+Returns the name of the declaration introduced by `stx` as written, if it is a declaration command
+with a `declId`. Used to attribute profiling data to declarations.
+-/
+private def getProfiledDeclName? (stx : Syntax) : Option Name := do
+  guard <| stx.isOfKind ``Lean.Parser.Command.declaration
+  let declId ← stx[1].getArgs.findSome? fun arg =>
+    if arg.isOfKind ``Lean.Parser.Command.declId then some arg
+    else if arg[0].isOfKind ``Lean.Parser.Command.declId then some arg[0]
+    else none
+  return declId[0].getId
+
 /--
 `elabCommand` wrapper that should be used for the initial invocation, not for recursive calls after
 macro expansion etc.
 -/
-def elabCommandTopLevel (stx : Syntax) : CommandElabM Unit := withRef stx do profileitM Exception "elaboration" (← getOptions) do
+def elabCommandTopLevel (stx : Syntax) : CommandElabM Unit := withRef stx do
+  let decl := (getProfiledDeclName? stx).map ((← getCurrNamespace) ++ ·) |>.getD .anonymous
+  profileitM Exception "elaboration" (← getOptions) (decl := decl) do
   withReader ({ · with suppressElabErrors :=
     stx.hasMissing && !showPartialSyntaxErrors.get (← getOptions) }) do
   let initMsgs ← modifyGet fun st => (st.messages, { st with messages := {} })
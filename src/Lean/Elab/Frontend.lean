@@ -112,7 +112,7 @@ where
         |>.getAll.map (·.diagnostics.msgLog)
         |>.foldl (· ++ ·) {}
       let trees := toSnapshotTree initialSnap
-        |>.getAll.map (·.infoTree?) |>.filterMap id |>.toPArray'
+        |>.getAll.map (·.getInfoTree?) |>.filterMap id |>.toPArray'
       return {
         commandState := { snap.data.finishedSnap.get.cmdState with messages, infoState.trees := trees }
         parserState := snap.data.parserState
@@ -131,6 +131,12 @@ def process (input : String) (env : Environment) (opts : Options) (fileName : Op
   let s ← IO.processCommands inputCtx { : Parser.ModuleParserState } (Command.mkState env {} opts)
   pure (s.commandState.env, s.commandState.messages)
 
+/-- Option for writing the .ilean file in the JSON format. -/
+register_builtin_option ilean.json : Bool := {
+  defValue := false
+  descr    := "write the .ilean file in the JSON format instead of the binary format"
+}
+
 @[export lean_run_frontend]
 def runFrontend
     (input : String)
@@ -140,30 +146,66 @@ def runFrontend
     (trustLevel : UInt32 := 0)
     (ileanFileName? : Option String := none)
     (jsonOutput : Bool := false)
+    (importedEnv? : Option Environment := none)
     : IO (Environment × Bool) := do
   let startTime := (← IO.monoNanosNow).toFloat / 1000000000
+  let sampleInterval := trace.profiler.output.sampleInterval.get opts
+  let sampling := sampleInterval > 0 && (trace.profiler.output.get? opts).isSome
+  if sampling then
+    IO.startSampling sampleInterval.toUInt32
+  let tracingTasks := trace.profiler.output.tasks.get opts && (trace.profiler.output.get? opts).isSome
+  if tracingTasks then
+    IO.startTaskTracing
+  let tracingRegions := profiler.counters.get opts && (trace.profiler.output.get? opts).isSome
+  if tracingRegions then
+    startProfileTracing
   let inputCtx := Parser.mkInputContext input fileName
   let opts := Language.Lean.internal.cmdlineSnapshots.set opts true
   let ctx := { inputCtx with }
+  -- Collect the references for the .ilean file command by command so that info trees do not have to
+  -- be kept until the end of the file. The references of separate commands can simply be merged as
+  -- their ranges are disjoint.
+  let refsRef ← IO.mkRef (Std.HashMap.empty : Lsp.ModuleRefs)
+  let onInfoTree? : Option (InfoTree → BaseIO Unit) := ileanFileName?.map fun _ tree => do
+    let refs ← Lean.Server.findModuleRefs inputCtx.fileMap #[tree] (localVars := false)
+      |>.toLspModuleRefs
+    refsRef.modify (·.append refs)
   let processor := Language.Lean.process
-  let snap ← processor (fun _ => pure <| .ok { mainModuleName, opts, trustLevel }) none ctx
+  let snap ← processor (fun _ => pure <| .ok {
+    mainModuleName, opts, trustLevel, importedEnv?, onInfoTree?
+  }) none ctx
   let snaps := Language.toSnapshotTree snap
   snaps.runAndReport opts jsonOutput
 
   if let some ileanFileName := ileanFileName? then
+    -- info trees not passed to `onInfoTree?`, such as that of the header
     let trees := snaps.getAll.flatMap (match ·.infoTree? with | some t => #[t] | _ => #[])
     let references := Lean.Server.findModuleRefs inputCtx.fileMap trees (localVars := false)
-    let ilean := { module := mainModuleName, references := ← references.toLspModuleRefs : Lean.Server.Ilean }
-    IO.FS.writeFile ileanFileName $ Json.compress $ toJson ilean
+    let references := (← references.toLspModuleRefs).append (← refsRef.get)
+    let contents := if ilean.json.get opts then
+      (Json.compress <| toJson { module := mainModuleName, references : Lean.Server.Ilean }).toUTF8
+    else
+      Lean.Server.BinaryIlean.encode mainModuleName references
+    -- replace the file atomically, as the server may have mapped the old one into memory
+    let tmpFileName := ileanFileName ++ ".tmp"
+    IO.FS.writeBinFile tmpFileName contents
+    IO.FS.rename tmpFileName ileanFileName
 
   -- TODO: remove default when reworking cmdline interface in Lean; currently the only case
   -- where we use the environment despite errors in the file is `--stats`
   let some cmdState := Language.Lean.waitForFinalCmdState? snap
-    | return (← mkEmptyEnvironment, false)
+    | if sampling then discard <| IO.stopSampling
+      return (← mkEmptyEnvironment, false)
 
   if let some out := trace.profiler.output.get? opts then
     let traceState := cmdState.traceState
-    let profile ← Firefox.Profile.export mainModuleName.toString startTime traceState opts
+    let mut profile ← Firefox.Profile.export mainModuleName.toString startTime traceState opts
+    if sampling then
+      profile := profile.addSamples (← IO.stopSampling) (sampleInterval.toFloat / 1000)
+    if tracingTasks then
+      profile := profile.addTaskMarkers (← IO.stopTaskTracing)
+    if tracingRegions then
+      profile := profile.addRegionMarkers (← stopProfileTracing)
     IO.FS.writeFile ⟨out⟩ <| Json.compress <| toJson profile
 
   let hasErrors := snaps.getAll.any (·.diagnostics.msgLog.hasErrors)
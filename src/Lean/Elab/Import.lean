@@ -35,6 +35,15 @@ def parseImports (input : String) (fileName : Option String := none) : IO (Array
   let (header, parserState, messages) ← Parser.parseHeader inputCtx
   pure (headerToImports header, inputCtx.fileMap.toPosition parserState.pos, messages)
 
+/--
+Imports the modules imported by the header of `input`, for reuse by `runFrontend` on files with the same
+imports. Used by the fork server in `util/shell.cpp`.
+-/
+@[export lean_import_header]
+def importHeader (input : String) (fileName : String) (opts : Options) (trustLevel : UInt32) : IO Environment := do
+  let (imports, _, _) ← parseImports input fileName
+  importModules (leakEnv := true) imports opts trustLevel
+
 @[export lean_print_imports]
 def printImports (input : String) (fileName : Option String) : IO Unit := do
   let (deps, _, _) ← parseImports input fileName
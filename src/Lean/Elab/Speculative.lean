@@ -0,0 +1,102 @@
+/-
+Copyright (c) 2024 Lean FRO, LLC. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+-/
+prelude
+import Lean.Elab.Command
+import Lean.DeclarationRange
+import Lean.DocString.Extension
+
+/-!
+# Speculative elaboration of commands
+
+With `Elab.speculativeCommands` set to `n > 0`, the cmdline driver elaborates up to `n` theorems
+following a theorem in parallel with it, all against the command state before the first one (see
+`Lean.Language.Lean.process.parseCmd`). The results are then committed in order. The speculative result of a
+command is only committed if the commands committed before it could not have influenced it; otherwise
+the command is elaborated again.
+
+We only speculate on `theorem` and `example` commands without attributes, and commit a speculative
+result only if
+* both the commands committed since the common state and the speculative command itself only added
+  constants, declaration ranges, doc strings and namespaces to the environment and did not change the
+  scopes;
+* the speculative command did not log errors, which may be due to a missing constant;
+* its syntax does not mention a constant added by the committed commands (by the last component of its
+  name) and does not contain a search tactic such as `exact?`, which may find one.
+-/
+
+namespace Lean.Elab.Command.Speculative
+
+register_builtin_option Elab.speculativeCommands : Nat := {
+  defValue := 0
+  descr    := "(cmdline) number of theorems following a theorem to elaborate speculatively in parallel \
+    with it, then commit in order or elaborate again if they may have depended on it (0 = disabled)"
+}
+
+/-- Returns `true` for a `theorem` or `example` command without attributes. -/
+def isCandidate (stx : Syntax) : Bool :=
+  stx.isOfKind ``Parser.Command.declaration &&
+  (stx[1].isOfKind ``Parser.Command.theorem || stx[1].isOfKind ``Parser.Command.example) &&
+  stx[0][1].isNone
+
+/--
+Returns `true` if the environment extensions that `env` modified compared to `base` are only those
+updated when adding a plain theorem: added constants, declaration ranges, doc strings and namespaces.
+-/
+def onlyAddsDecls (base env : Environment) : Bool :=
+  let env := addedConstantsExt.setState env (addedConstantsExt.getState base)
+  let env := declRangeExt.toEnvExtension.setState env (declRangeExt.toEnvExtension.getState base)
+  let env := docStringExt.toEnvExtension.setState env (docStringExt.toEnvExtension.getState base)
+  let env := namespacesExt.toEnvExtension.setState env (namespacesExt.toEnvExtension.getState base)
+  base.extensionsPtrEq env
+
+/-- Returns `true` if `s` only added declarations to `base`, see `onlyAddsDecls`. -/
+def isPlainStep (base s : State) : Bool :=
+  onlyAddsDecls base.env s.env && s.maxRecDepth == base.maxRecDepth &&
+  unsafe ptrEq base.scopes s.scopes
+
+/--
+Returns `true` if `stx` may observe one of the constants `cs`: if it mentions the last component of
+its name in an identifier, or if it contains a token ending in `?` such as `exact?`.
+-/
+partial def mayObserve (cs : Array ConstantInfo) (stx : Syntax) : Bool :=
+  let lasts : NameSet := cs.foldl (init := {}) fun s c =>
+    match c.name with
+    | .str _ l => s.insert (.mkSimple l)
+    | _        => s
+  go lasts stx
+where
+  go (lasts : NameSet) : Syntax → Bool
+    | .ident _ _ n _ => n.eraseMacroScopes.components.any lasts.contains
+    | .atom _ v      => v.length > 1 && v.endsWith "?"
+    | .node _ _ args => args.any (go lasts)
+    | .missing       => false
+
+/--
+Combines the state `committed`, reached from `base` by elaborating commands normally, with the state
+`spec` reached from `base` by elaborating `stx` speculatively. Returns `none` if the speculative result
+cannot be committed, in which case `stx` must be elaborated again.
+-/
+def commit? (base committed spec : State) (stx : Syntax) : Option State := do
+  guard <| isPlainStep base committed && isPlainStep base spec
+  guard !spec.messages.hasErrors
+  let committedNew := committed.env.constantsSince base.env
+  let specNew := spec.env.constantsSince base.env
+  guard <| !specNew.any (committed.env.contains ·.name)
+  guard !(mayObserve committedNew stx)
+  let mut env := committed.env.addCheckedConstants specNew
+  for c in specNew do
+    if let some ranges := declRangeExt.find? spec.env c.name then
+      env := declRangeExt.insert env c.name ranges
+    if let some doc := docStringExt.find? spec.env c.name then
+      env := docStringExt.insert env c.name doc
+  let newTraces := spec.traceState.traces.toArray.extract base.traceState.traces.size spec.traceState.traces.size
+  return { spec with
+    env
+    nextMacroScope := max committed.nextMacroScope spec.nextMacroScope
+    ngen := { spec.ngen with idx := max committed.ngen.idx spec.ngen.idx }
+    traceState.traces := newTraces.foldl (·.push ·) committed.traceState.traces
+  }
+
+end Lean.Elab.Command.Speculative
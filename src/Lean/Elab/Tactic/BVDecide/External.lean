@@ -10,7 +10,8 @@ import Std.Internal.Parsec
 
 /-!
 This module implements the logic to call CaDiCal (or CLI interface compatible SAT solvers) and
-extract an LRAT UNSAT proof or a model from its output.
+extract an LRAT UNSAT proof or a model from its output, as well as to run CaDiCaL in-process when it
+is linked into Lean.
 -/
 
 namespace Lean.Elab.Tactic.BVDecide
@@ -135,6 +136,55 @@ where
         throw <| .internal Core.interruptExceptionId
     x
 
+def throwTimeoutError : CoreM α := do
+  let mut err := "The SAT solver timed out while solving the problem.\n"
+  err := err ++ "Consider increasing the timeout with `set_option sat.timeout <sec>`.\n"
+  err := err ++ "If solving your problem relies inherently on using associativity or commutativity, consider enabling the `bv.ac_nf` option."
+  throwError err
+
+/--
+The result of running CaDiCaL in-process, see `cadicalSolve`.
+-/
+inductive InProcessResult where
+  | unsat
+  /--
+  The model, as the literal of each variable in DIMACS numbering.
+  -/
+  | sat (model : Array Int)
+  | timeout
+  | interrupted
+
+/-- Whether Lean was built with `-DLINK_CADICAL=ON`, i.e. whether `cadicalSolve` is available. -/
+@[extern "lean_cadical_available"]
+opaque cadicalAvailable : Unit → Bool
+
+/--
+Run the CaDiCaL library linked into Lean on the CNF `clauses`, given as its literals in DIMACS
+numbering with each clause terminated by `0`, with the same configuration as `satQuery`. The LRAT
+proof is written to `proofPath`. The search is stopped after `timeoutMs` milliseconds or when
+`cancelTk?` is set.
+
+Returns `none` if Lean was built without `-DLINK_CADICAL=ON`.
+-/
+@[extern "lean_cadical_solve"]
+opaque cadicalSolve (clauses : @& Array Int) (proofPath : @& String) (binaryProofs : Bool)
+    (timeoutMs : UInt64) (cancelTk? : @& Option IO.CancelToken) : IO (Option InProcessResult)
+
+/--
+Like `satQuery` but with CaDiCaL running in-process, which avoids spawning the solver, serializing
+the problem and parsing the model. Returns `none` if CaDiCaL is not linked into Lean.
+-/
+def satQueryInProcess (clauses : Array Int) (proofOutput : System.FilePath) (timeout : Nat)
+    (binaryProofs : Bool) : CoreM (Option SolverResult) := do
+  let cancelTk? := (← read).cancelTk?
+  let some res ← cadicalSolve clauses proofOutput.toString binaryProofs (timeout * 1000).toUInt64 cancelTk?
+    | return none
+  match res with
+  | .unsat => return some .unsat
+  | .sat model => return some <| .sat <| model.map fun lit => (lit > 0, lit.natAbs)
+  | .timeout => throwTimeoutError
+  | .interrupted => throw <| .internal Core.interruptExceptionId
+
 /--
 Call the SAT solver in `solverPath` with `problemPath` as CNF input and ask it to output an LRAT
 UNSAT proof (binary or non-binary depending on `binaryProofs`) into `proofOutput`. To avoid runaway
@@ -168,11 +218,7 @@ def satQuery (solverPath : System.FilePath) (problemPath : System.FilePath) (pro
   -- We implement timeouting ourselves because cadicals -t option is not available on Windows.
   let out? ← runInterruptible timeout { cmd, args, stdin := .piped, stdout := .piped, stderr := .null }
   match out? with
-  | .timeout =>
-    let mut err := "The SAT solver timed out while solving the problem.\n"
-    err := err ++ "Consider increasing the timeout with `set_option sat.timeout <sec>`.\n"
-    err := err ++ "If solving your problem relies inherently on using associativity or commutativity, consider enabling the `bv.ac_nf` option."
-    throwError err
+  | .timeout => throwTimeoutError
   | .success { exitCode := exitCode, stdout := stdout, stderr := stderr} =>
     if exitCode == 255 then
       throwError s!"Failed to execute external prover:\n{stderr}"
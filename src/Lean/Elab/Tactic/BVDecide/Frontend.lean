@@ -8,6 +8,7 @@ import Lean.Elab.Tactic.BVDecide.Frontend.Attr
 import Lean.Elab.Tactic.BVDecide.Frontend.BVCheck
 import Lean.Elab.Tactic.BVDecide.Frontend.BVDecide
 import Lean.Elab.Tactic.BVDecide.Frontend.BVTrace
+import Lean.Elab.Tactic.BVDecide.Frontend.CNF
 import Lean.Elab.Tactic.BVDecide.Frontend.LRAT
 import Lean.Elab.Tactic.BVDecide.Frontend.Normalize
 
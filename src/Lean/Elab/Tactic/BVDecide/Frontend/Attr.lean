@@ -25,7 +25,8 @@ register_builtin_option sat.solver : String := {
   descr :=
     "Name of the SAT solver used by Lean.Elab.Tactic.BVDecide tactics.\n
      1. If this is set to something besides the empty string they will use that binary.\n
-     2. If this is set to the empty string they will check if there is a cadical binary next to the\
+     2. If this is set to the empty string they will use the CaDiCaL library linked into Lean if it\
+        was built with it. Otherwise they will check if there is a cadical binary next to the\
         executing program. Usually that program is going to be `lean` itself and we do ship a\
         `cadical` next to it.\n
      3. If that does not succeed try to call `cadical` from PATH. The empty string default indicates\
@@ -47,6 +48,12 @@ register_builtin_option sat.binaryProofs : Bool := {
   descr := "Whether to use the binary LRAT proof format. Currently set to false and ignored on Windows due to a bug in CaDiCal."
 }
 
+register_builtin_option sat.reuseCertificates : Bool := {
+  defValue := true
+  descr := "Whether to reuse the LRAT certificate of an identical bitblasting problem solved earlier \
+    in the same process, e.g. before re-elaborating a file in the language server."
+}
+
 register_builtin_option debug.bv.graphviz : Bool := {
   defValue := false
   descr := "Output the AIG of bv_decide as graphviz into a file called aig.gv in the working directory of the Lean process."
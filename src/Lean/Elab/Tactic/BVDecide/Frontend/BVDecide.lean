@@ -11,6 +11,7 @@ import Std.Tactic.BVDecide.Syntax
 import Lean.Elab.Tactic.BVDecide.Frontend.BVDecide.SatAtBVLogical
 import Lean.Elab.Tactic.BVDecide.Frontend.Normalize
 import Lean.Elab.Tactic.BVDecide.Frontend.LRAT
+import Lean.Elab.Tactic.BVDecide.Frontend.CNF
 
 /-!
 This module provides the implementation of the `bv_decide` frontend itself.
@@ -186,6 +187,12 @@ def lratBitblaster (goal : MVarId) (cfg : TacticContext) (reflectionResult : Ref
     (atomsAssignment : Std.HashMap Nat (Nat × Expr)) :
     MetaM (Except CounterExample UnsatProver.Result) := do
   let bvExpr := reflectionResult.bvExpr
+  let problem := toExpr bvExpr
+  if cfg.reuseCertificates && !cfg.graphviz then
+    if let some cert ← LratCert.find? problem then
+      trace[Meta.Tactic.sat] "Reusing the proof of an identical problem."
+      let proof ← cert.toReflectionProof cfg bvExpr ``verifyBVExpr ``unsat_of_verifyBVExpr_eq_true
+      return .ok ⟨proof, cert⟩
   let entry ←
     withTraceNode `bv (fun _ => return "Bitblasting BVLogicalExpr to AIG") do
       -- lazyPure to prevent compiler lifting
@@ -201,17 +208,19 @@ def lratBitblaster (goal : MVarId) (cfg : TacticContext) (reflectionResult : Ref
       -- lazyPure to prevent compiler lifting
       IO.lazyPure (fun _ =>
         let (entry, map) := entry.relabelNat'
-        let cnf := AIG.toCNF entry
+        let cnf := toCNFParallel entry
         (cnf, map)
       )
 
   let res ←
     withTraceNode `sat (fun _ => return "Obtaining external proof certificate") do
-      runExternal cnf cfg.solver cfg.lratPath cfg.trimProofs cfg.timeout cfg.binaryProofs
+      runExternal cnf cfg.solver cfg.inProcess cfg.lratPath cfg.trimProofs cfg.timeout cfg.binaryProofs
 
   match res with
   | .ok cert =>
     trace[Meta.Tactic.sat] "SAT solver found a proof."
+    if cfg.reuseCertificates then
+      LratCert.cache problem cert
     let proof ← cert.toReflectionProof cfg bvExpr ``verifyBVExpr ``unsat_of_verifyBVExpr_eq_true
     return .ok ⟨proof, cert⟩
   | .error assignment =>
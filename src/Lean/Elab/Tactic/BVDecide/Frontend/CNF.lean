@@ -0,0 +1,72 @@
+/-
+Copyright (c) 2024 Lean FRO, LLC. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+-/
+prelude
+import Std.Sat.AIG.CNF
+
+/-!
+This module contains a parallel implementation of `Std.Sat.AIG.toCNF` for the part of `bv_decide`
+that prepares the SAT problem. It produces exactly the same CNF as `AIG.toCNF`: the reflection proof
+computes that CNF again and the LRAT proof of the SAT solver refers to its clauses by position.
+
+The nodes are first ordered sequentially as `AIG.toCNF.go` visits them, after which the clauses of
+chunks of nodes are generated in parallel. The ordering pass is iterative, so unlike `AIG.toCNF` it
+does not recurse as deep as the AIG.
+-/
+
+namespace Lean.Elab.Tactic.BVDecide
+namespace Frontend
+
+open Std.Sat
+
+/--
+The nodes reachable from `root` in the order in which `AIG.toCNF.go` emits their clauses, i.e., in
+depth-first post-order with left children first.
+-/
+def cnfOrder (aig : AIG Nat) (root : Nat) : Array Nat := Id.run do
+  let mut marks := mkArray aig.decls.size false
+  let mut order := #[]
+  -- a node is pushed with `false`, and again with `true` once its children have been pushed
+  let mut stack := #[(root, false)]
+  while !stack.isEmpty do
+    let (idx, expanded) := stack.back!
+    stack := stack.pop
+    if marks[idx]! then
+      continue
+    if !expanded then
+      if let .gate l r .. := aig.decls[idx]! then
+        stack := stack.push (idx, true) |>.push (r, false) |>.push (l, false)
+        continue
+    marks := marks.set! idx true
+    order := order.push idx
+  return order
+
+/--
+The clauses of `AIG.toCNF` for the node `idx`, prepended to `acc`.
+-/
+@[inline]
+def nodeToCNF (aig : AIG Nat) (idx : Nat) (acc : CNF Nat) : CNF Nat :=
+  match aig.decls[idx]! with
+  | .const b => AIG.Decl.constToCNF idx b ++ acc
+  | .atom a => AIG.Decl.atomToCNF idx (aig.decls.size + a) ++ acc
+  | .gate l r linv rinv => AIG.Decl.gateToCNF idx l r linv rinv ++ acc
+
+/--
+Computes `AIG.toCNF entry`, generating the clauses of `chunkSize` nodes per task.
+-/
+def toCNFParallel (entry : AIG.Entrypoint Nat) (chunkSize : Nat := 65536) : CNF Nat :=
+  let aig := entry.aig
+  let order := cnfOrder aig entry.ref.gate
+  let chunkSize := max chunkSize 1
+  let numChunks := (order.size + chunkSize - 1) / chunkSize
+  -- `AIG.toCNF.go` prepends the clauses of each node, so the clauses of later nodes come first
+  let chunks := (List.range numChunks).map fun i =>
+    Task.spawn fun _ =>
+      order.foldl (start := i * chunkSize) (stop := min ((i + 1) * chunkSize) order.size)
+        (init := []) fun acc idx => nodeToCNF aig idx acc
+  let clauses := chunks.foldl (init := []) fun acc chunk => chunk.get ++ acc
+  [(entry.ref.gate, true)] :: clauses
+
+end Frontend
+end Lean.Elab.Tactic.BVDecide
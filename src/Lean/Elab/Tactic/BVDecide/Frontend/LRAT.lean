@@ -29,11 +29,17 @@ structure TacticContext where
   certDef : Name
   reflectionDef : Name
   solver : System.FilePath
+  /--
+  Whether to first try the CaDiCaL library linked into Lean, which is the case unless `sat.solver`
+  selects a solver binary.
+  -/
+  inProcess : Bool
   lratPath : System.FilePath
   graphviz : Bool
   timeout : Nat
   trimProofs : Bool
   binaryProofs : Bool
+  reuseCertificates : Bool
 
 def TacticContext.new (lratPath : System.FilePath) : Lean.Elab.TermElabM TacticContext := do
   let exprDef ← Lean.Elab.Term.mkAuxName `_expr_def
@@ -41,10 +47,12 @@ def TacticContext.new (lratPath : System.FilePath) : Lean.Elab.TermElabM TacticC
   let reflectionDef ← Lean.Elab.Term.mkAuxName `_reflection_def
   let opts ← getOptions
   let solver ← determineSolver
+  let inProcess := sat.solver.get opts == ""
   trace[Meta.Tactic.sat] m!"Using SAT solver at '{solver}'"
   let timeout := sat.timeout.get opts
   let graphviz := debug.bv.graphviz.get opts
   let trimProofs := sat.trimProofs.get opts
+  let reuseCertificates := sat.reuseCertificates.get opts
   let binaryProofs :=
     -- Account for: https://github.com/arminbiere/cadical/issues/112
     if System.Platform.isWindows then
@@ -56,11 +64,13 @@ def TacticContext.new (lratPath : System.FilePath) : Lean.Elab.TermElabM TacticC
     certDef,
     reflectionDef,
     solver,
+    inProcess,
     lratPath,
     graphviz,
     timeout,
     trimProofs,
-    binaryProofs
+    binaryProofs,
+    reuseCertificates
   }
 where
   determineSolver : Lean.Elab.TermElabM System.FilePath := do
@@ -78,6 +88,27 @@ where
 /-- An LRAT proof read from a file. This will get parsed using ofReduceBool. -/
 abbrev LratCert := String
 
+/--
+The maximum number of entries of `lratCertCache`. The cache is cleared when it is exceeded.
+-/
+def lratCertCacheSize : Nat := 256
+
+/--
+The certificates of the problems proven unsatisfiable in this process, keyed by the reflected
+problem, see `sat.reuseCertificates`. The reflection proof bitblasts the problem again and checks
+the certificate against the resulting CNF, so a certificate can only be reused for the exact same
+problem.
+-/
+builtin_initialize lratCertCache : IO.Ref (Std.HashMap Expr LratCert) ← IO.mkRef {}
+
+def LratCert.find? (problem : Expr) : BaseIO (Option LratCert) :=
+  return (← lratCertCache.get)[problem]?
+
+def LratCert.cache (problem : Expr) (cert : LratCert) : BaseIO Unit :=
+  lratCertCache.modify fun cache =>
+    let cache := if cache.size ≥ lratCertCacheSize then {} else cache
+    cache.insert problem cert
+
 instance : ToExpr LRAT.IntAction where
   toExpr action :=
     let beta := mkApp (mkConst ``Array [.zero]) (mkConst ``Int)
@@ -134,30 +165,51 @@ def LratCert.ofFile (lratPath : System.FilePath) (trimProofs : Bool) : CoreM Lra
   return newProof
 
 /--
-Run an external SAT solver on the `CNF` to obtain an LRAT proof.
+The literals of `cnf` in DIMACS numbering (see `CNF.dimacs`), each clause terminated by `0`.
+-/
+def dimacsLiterals (cnf : CNF Nat) : Array Int :=
+  cnf.foldl (init := #[]) fun lits clause =>
+    let lits := clause.foldl (init := lits) fun lits (id, pol) =>
+      lits.push (if pol then (id + 1 : Int) else -(id + 1 : Int))
+    lits.push 0
+
+/--
+Run a SAT solver on the `CNF` to obtain an LRAT proof. With `inProcess`, the CaDiCaL library linked
+into Lean is used if available; otherwise the external `solver` is run.
 
 This will obtain an `LratCert` if the formula is UNSAT and throw errors otherwise.
 -/
-def runExternal (cnf : CNF Nat) (solver : System.FilePath) (lratPath : System.FilePath)
-    (trimProofs : Bool) (timeout : Nat) (binaryProofs : Bool) :
+def runExternal (cnf : CNF Nat) (solver : System.FilePath) (inProcess : Bool)
+    (lratPath : System.FilePath) (trimProofs : Bool) (timeout : Nat) (binaryProofs : Bool) :
     CoreM (Except (Array (Bool × Nat)) LratCert) := do
-  IO.FS.withTempFile fun cnfHandle cnfPath => do
-    withTraceNode `sat (fun _ => return "Serializing SAT problem to DIMACS file") do
-      -- lazyPure to prevent compiler lifting
-      cnfHandle.putStr  (← IO.lazyPure (fun _ => cnf.dimacs))
-      cnfHandle.flush
+  let res? ←
+    -- do not build the literals if they cannot be used
+    if inProcess && External.cadicalAvailable () then
+      withTraceNode `sat (fun _ => return "Running SAT solver in-process") do
+        -- lazyPure to prevent compiler lifting
+        let clauses ← IO.lazyPure (fun _ => dimacsLiterals cnf)
+        External.satQueryInProcess clauses lratPath timeout binaryProofs
+    else
+      pure none
+  let res ← match res? with
+    | some res => pure res
+    | none =>
+      IO.FS.withTempFile fun cnfHandle cnfPath => do
+        withTraceNode `sat (fun _ => return "Serializing SAT problem to DIMACS file") do
+          -- lazyPure to prevent compiler lifting
+          cnfHandle.putStr  (← IO.lazyPure (fun _ => cnf.dimacs))
+          cnfHandle.flush
 
-    let res ←
-      withTraceNode `sat (fun _ => return "Running SAT solver") do
-        External.satQuery solver cnfPath lratPath timeout binaryProofs
-    if let .sat assignment := res then
-      return .error assignment
+        withTraceNode `sat (fun _ => return "Running SAT solver") do
+          External.satQuery solver cnfPath lratPath timeout binaryProofs
+  if let .sat assignment := res then
+    return .error assignment
 
-    let lratProof ←
-      withTraceNode `sat (fun _ => return "Obtaining LRAT certificate") do
-        LratCert.ofFile lratPath trimProofs
+  let lratProof ←
+    withTraceNode `sat (fun _ => return "Obtaining LRAT certificate") do
+      LratCert.ofFile lratPath trimProofs
 
-    return .ok lratProof
+  return .ok lratProof
 
 /--
 Add an auxiliary declaration. Only used to create constants that appear in our reflection proof.
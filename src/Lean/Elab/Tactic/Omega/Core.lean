@@ -478,8 +478,11 @@ def fourierMotzkinData (p : Problem) : Array FourierMotzkinData := Id.run do
   let mut data : Array FourierMotzkinData :=
     (List.range p.numVars).foldl (fun a i => a.push { var := i}) #[]
   for (_, f@⟨xs, s, _⟩) in p.constraints do
+    -- Walk the coefficients alongside `i` rather than using `Coeffs.get`, which is linear in `i`.
+    let mut rest := xs.toList
     for i in [0:n] do
-      let x := Coeffs.get xs i
+      let x := rest.headD 0
+      rest := rest.tail
       data := data.modify i fun d =>
         if x = 0 then
           { d with irrelevant := f :: d.irrelevant }
@@ -35,7 +35,7 @@ abbrev ConstMap := SMap Name ConstantInfo
 structure Import where
   module      : Name
   runtimeOnly : Bool := false
-  deriving Repr, Inhabited
+  deriving Repr, Inhabited, BEq
 
 instance : Coe Name Import := ⟨({module := ·})⟩
 
@@ -50,6 +50,12 @@ def CompactedRegion := USize
 @[extern "lean_compacted_region_is_memory_mapped"]
 opaque CompactedRegion.isMemoryMapped : CompactedRegion → Bool
 
+/--
+  Return `true` if the ranges of other regions that objects in the region refer to are mapped. This is
+  always the case unless the .olean file was written with `LEAN_OLEAN_SHARE_IMPORTS` set. -/
+@[extern "lean_compacted_region_external_ranges_mapped"]
+opaque CompactedRegion.externalRangesMapped : CompactedRegion → BaseIO Bool
+
 /-- Free a compacted region and its contents. No live references to the contents may exist at the time of invocation. -/
 @[extern "lean_compacted_region_free"]
 unsafe opaque CompactedRegion.free : CompactedRegion → IO Unit
@@ -72,6 +78,14 @@ structure ModuleData where
   constNames      : Array Name
   constants       : Array ConstantInfo
   /--
+  Perfect hash table mapping names to their position in `constNames`, see `mkConstIndex`. It is used by
+  `ModuleData.findConst?` to look up single constants without inserting all constants of the module into
+  a map. `constSeeds` contains the displacement of each bucket, and `constIndex` the position of the name
+  stored in each slot, or `noConstIdx` if the slot is empty.
+  -/
+  constSeeds      : Array UInt32
+  constIndex      : Array UInt32
+  /--
   Extra entries for the `const2ModIdx` map in the `Environment` object.
   The code generator creates auxiliary declarations that are not in the
   mapping `constants`, but we want to know in which module they were generated.
@@ -104,6 +118,11 @@ structure EnvironmentHeader where
   moduleNames  : Array Name   := #[]
   /-- Module data for all imported modules. -/
   moduleData   : Array ModuleData := #[]
+  /--
+  `lazyConstants = true` if imported constants have not been inserted into `Environment.constants`,
+  but are looked up in `moduleData` on demand (see `importModules`).
+  -/
+  lazyConstants : Bool        := false
   deriving Nonempty
 
 /--
@@ -138,6 +157,10 @@ structure Environment where
   /--
   Mapping from constant name to `ConstantInfo`. It contains all constants (definitions, theorems, axioms, etc)
   that have been already type checked by the kernel.
+
+  Remark: if the environment was imported with `lazyConstants := true`, this mapping contains only the
+  constants declared in the current module. Use `Environment.find?` and `Environment.contains` to also
+  find imported constants.
   -/
   constants    : ConstMap
   /--
@@ -154,6 +177,80 @@ structure Environment where
   header       : EnvironmentHeader := {}
   deriving Nonempty
 
+/-- The value of empty slots in `ModuleData.constIndex`. -/
+def noConstIdx : UInt32 := 0xffffffff
+
+/-- Scrambles the bits of a name hash, see `constBucket` and `constSlot`. -/
+@[inline] private def mixConstHash (h : UInt64) : UInt64 :=
+  let h := (h ^^^ (h >>> 30)) * 0xbf58476d1ce4e5b9
+  let h := (h ^^^ (h >>> 27)) * 0x94d049bb133111eb
+  h ^^^ (h >>> 31)
+
+@[inline] private def constBucket (h : UInt64) (numBuckets : Nat) : Nat :=
+  (mixConstHash h % numBuckets.toUInt64).toNat
+
+@[inline] private def constSlot (h : UInt64) (seed : UInt32) (numSlots : Nat) : Nat :=
+  (mixConstHash (h + seed.toUInt64 * 0x9e3779b97f4a7c15) % numSlots.toUInt64).toNat
+
+/--
+Computes `(constSeeds, constIndex)` of `ModuleData` for `constNames` by hash-and-displace: the names are
+distributed into buckets of about four names, and for each bucket, starting with the largest ones, we search
+for a seed that places all names of the bucket into free slots of the table. Both arrays are empty if no seed
+is found for some bucket, which can only happen if two names have the same hash. `ModuleData.findConst?` then
+falls back to a linear search.
+-/
+def mkConstIndex (constNames : Array Name) : Array UInt32 × Array UInt32 := Id.run do
+  let numBuckets := (constNames.size + 3) / 4
+  let numSlots := constNames.size + constNames.size / 4 + 1
+  let hashes := constNames.map hash
+  let mut buckets : Array (Array UInt32) := mkArray numBuckets #[]
+  for h : i in [0:hashes.size] do
+    buckets := buckets.modify (constBucket (hashes[i]'h.upper) numBuckets) (·.push i.toUInt32)
+  let order := (Array.range numBuckets).qsort fun b₁ b₂ => buckets[b₁]!.size > buckets[b₂]!.size
+  let mut seeds := mkArray numBuckets (0 : UInt32)
+  let mut index := mkArray numSlots noConstIdx
+  for b in order do
+    let bucket := buckets[b]!
+    if bucket.isEmpty then
+      break
+    let mut placed := false
+    for seed in [0:maxSeed] do
+      if let some slots := trySeed hashes index bucket seed.toUInt32 then
+        for i in bucket, slot in slots do
+          index := index.set! slot i
+        seeds := seeds.set! b seed.toUInt32
+        placed := true
+        break
+    unless placed do
+      return (#[], #[])
+  return (seeds, index)
+where
+  maxSeed : Nat := 65536
+  /-- The slots of the names in `bucket` for `seed`, if they are free and pairwise distinct. -/
+  trySeed (hashes : Array UInt64) (index bucket : Array UInt32) (seed : UInt32) : Option (Array Nat) := do
+    let mut slots := #[]
+    for i in bucket do
+      let slot := constSlot hashes[i.toNat]! seed index.size
+      if index[slot]! != noConstIdx || slots.contains slot then
+        failure
+      slots := slots.push slot
+    return slots
+
+/--
+Return the constant named `n` declared in `mod`. It uses the perfect hash table `constIndex`, so only
+the name in a single slot is compared with `n`.
+-/
+def ModuleData.findConst? (mod : ModuleData) (n : Name) : Option ConstantInfo := do
+  if mod.constSeeds.isEmpty then
+    let j ← mod.constNames.indexOf? n
+    return ← mod.constants[j.val]?
+  let h := hash n
+  let seed := mod.constSeeds[constBucket h mod.constSeeds.size]!
+  let j := mod.constIndex[constSlot h seed mod.constIndex.size]!.toNat
+  let m ← mod.constNames[j]?
+  guard (m == n)
+  mod.constants[j]?
+
 namespace Environment
 
 private def addAux (env : Environment) (cinfo : ConstantInfo) : Environment :=
@@ -170,13 +267,21 @@ def addExtraName (env : Environment) (name : Name) : Environment :=
   else
     { env with extraConstNames := env.extraConstNames.insert name }
 
+/-- Look up an imported constant in its module, for environments imported with `lazyConstants := true`. -/
+private def findImported? (env : Environment) (n : Name) : Option ConstantInfo := do
+  let modIdx ← env.const2ModIdx[n]?
+  let mod ← env.header.moduleData[modIdx.toNat]?
+  mod.findConst? n
+
 @[export lean_environment_find]
 def find? (env : Environment) (n : Name) : Option ConstantInfo :=
   /- It is safe to use `find'` because we never overwrite imported declarations. -/
-  env.constants.find?' n
+  match env.constants.find?' n with
+  | some cinfo => some cinfo
+  | none       => if env.header.lazyConstants then env.findImported? n else none
 
 def contains (env : Environment) (n : Name) : Bool :=
-  env.constants.contains n
+  env.constants.contains n || (env.header.lazyConstants && (env.findImported? n).isSome)
 
 def imports (env : Environment) : Array Import :=
   env.header.imports
@@ -192,6 +297,18 @@ def setMainModule (env : Environment) (m : Name) : Environment :=
 def mainModule (env : Environment) : Name :=
   env.header.mainModule
 
+/--
+Object identifying the imported modules. The kernel uses its address to decide whether
+cached results for imported constants can be reused in `env`.
+-/
+@[export lean_environment_imports_id]
+private def importsId (env : Environment) : Array ModuleData :=
+  env.header.moduleData
+
+@[export lean_environment_is_imported_const]
+private def isImportedConst (env : Environment) (n : Name) : Bool :=
+  env.const2ModIdx.contains n
+
 @[export lean_environment_mark_quot_init]
 private def markQuotInit (env : Environment) : Environment :=
   { env with header := { env.header with quotInit := true } }
@@ -428,6 +545,18 @@ def mkEmptyEnvironment (trustLevel : UInt32 := 0) : IO Environment := do
 structure PersistentEnvExtensionState (α : Type) (σ : Type) where
   importedEntries : Array (Array α)  -- entries per imported module
   state : σ
+  /--
+  For extensions imported lazily, the state computed from `importedEntries` on first access. While
+  it is set, it takes precedence over `state`, which is still the initial state. It is reset by the
+  first modification of the state.
+  -/
+  lazyState? : Option (Thunk σ) := none
+
+/-- The current state, forcing the lazily imported state if necessary. -/
+@[inline] def PersistentEnvExtensionState.current (s : PersistentEnvExtensionState α σ) : σ :=
+  match s.lazyState? with
+  | some t => t.get
+  | none   => s.state
 
 structure ImportM.Context where
   env  : Environment
@@ -484,6 +613,8 @@ structure PersistentEnvExtension (α : Type) (β : Type) (σ : Type) where
   toEnvExtension  : EnvExtension (PersistentEnvExtensionState α σ)
   name            : Name
   addImportedFn   : Array (Array α) → ImportM σ
+  /-- If set, used instead of `addImportedFn` to compute the imported state on its first access. -/
+  lazyAddImportedFn? : Option (Array (Array α) → σ)
   addEntryFn      : σ → β → σ
   exportEntriesFn : σ → Array α
   statsFn         : σ → Format
@@ -496,6 +627,7 @@ instance {α β σ} [Inhabited σ] : Inhabited (PersistentEnvExtension α β σ)
      toEnvExtension := default,
      name := default,
      addImportedFn := fun _ => default,
+     lazyAddImportedFn? := none,
      addEntryFn := fun s _ => s,
      exportEntriesFn := fun _ => #[],
      statsFn := fun _ => Format.nil
@@ -508,20 +640,20 @@ def getModuleEntries {α β σ : Type} [Inhabited σ] (ext : PersistentEnvExtens
 
 def addEntry {α β σ : Type} (ext : PersistentEnvExtension α β σ) (env : Environment) (b : β) : Environment :=
   ext.toEnvExtension.modifyState env fun s =>
-    let state   := ext.addEntryFn s.state b;
-    { s with state := state }
+    let state   := ext.addEntryFn s.current b;
+    { s with state := state, lazyState? := none }
 
 /-- Get the current state of the given extension in the given environment. -/
 def getState {α β σ : Type} [Inhabited σ] (ext : PersistentEnvExtension α β σ) (env : Environment) : σ :=
-  (ext.toEnvExtension.getState env).state
+  (ext.toEnvExtension.getState env).current
 
 /-- Set the current state of the given extension in the given environment. -/
 def setState {α β σ : Type} (ext : PersistentEnvExtension α β σ) (env : Environment) (s : σ) : Environment :=
-  ext.toEnvExtension.modifyState env fun ps => { ps with  state := s }
+  ext.toEnvExtension.modifyState env fun ps => { ps with  state := s, lazyState? := none }
 
 /-- Modify the state of the given extension in the given environment by applying the given function. -/
 def modifyState {α β σ : Type} (ext : PersistentEnvExtension α β σ) (env : Environment) (f : σ → σ) : Environment :=
-  ext.toEnvExtension.modifyState env fun ps => { ps with state := f (ps.state) }
+  ext.toEnvExtension.modifyState env fun ps => { ps with state := f ps.current, lazyState? := none }
 
 end PersistentEnvExtension
 
@@ -531,6 +663,11 @@ structure PersistentEnvExtensionDescr (α β σ : Type) where
   name            : Name := by exact decl_name%
   mkInitial       : IO σ
   addImportedFn   : Array (Array α) → ImportM σ
+  /--
+  If set, the imported state is not computed by `addImportedFn` when importing but by this function
+  when the state is first accessed, which saves the work for modules that never access it.
+  -/
+  lazyAddImportedFn? : Option (Array (Array α) → σ) := none
   addEntryFn      : σ → β → σ
   exportEntriesFn : σ → Array α
   statsFn         : σ → Format := fun _ => Format.nil
@@ -549,6 +686,7 @@ unsafe def registerPersistentEnvExtensionUnsafe {α β σ : Type} [Inhabited σ]
     toEnvExtension  := ext,
     name            := descr.name,
     addImportedFn   := descr.addImportedFn,
+    lazyAddImportedFn? := descr.lazyAddImportedFn?,
     addEntryFn      := descr.addEntryFn,
     exportEntriesFn := descr.exportEntriesFn,
     statsFn         := descr.statsFn
@@ -570,12 +708,15 @@ structure SimplePersistentEnvExtensionDescr (α σ : Type) where
   addEntryFn    : σ → α → σ
   addImportedFn : Array (Array α) → σ
   toArrayFn     : List α → Array α := fun es => es.toArray
+  /-- Whether to run `addImportedFn` only when the state is first accessed, see `PersistentEnvExtensionDescr`. -/
+  lazyImport    : Bool := false
 
 def registerSimplePersistentEnvExtension {α σ : Type} [Inhabited σ] (descr : SimplePersistentEnvExtensionDescr α σ) : IO (SimplePersistentEnvExtension α σ) :=
   registerPersistentEnvExtension {
     name            := descr.name,
     mkInitial       := pure ([], descr.addImportedFn #[]),
     addImportedFn   := fun as => pure ([], descr.addImportedFn as),
+    lazyAddImportedFn? := if descr.lazyImport then some fun as => ([], descr.addImportedFn as) else none,
     addEntryFn      := fun s e => match s with
       | (entries, s) => (e::entries, descr.addEntryFn s e),
     exportEntriesFn := fun s => descr.toArrayFn s.1.reverse,
@@ -702,15 +843,23 @@ unsafe def Environment.freeRegions (env : Environment) : IO Unit :=
 
 def mkModuleData (env : Environment) : IO ModuleData := do
   let pExts ← persistentEnvExtensionsRef.get
-  let entries := pExts.map fun pExt =>
-    let state := pExt.getState env
+  -- Exporting the entries of some extensions, e.g. sorting large simp sets, is expensive, so the
+  -- extensions and the constants are exported in parallel.
+  let entryTasks := pExts.map fun pExt => Task.spawn fun _ =>
+    -- An unforced lazily imported state has not been modified, so there is nothing to export beyond
+    -- the initial state, which we use to avoid forcing it.
+    let state := (pExt.toEnvExtension.getState env).state
     (pExt.name, pExt.exportEntriesFn state)
-  let constNames := env.constants.foldStage2 (fun names name _ => names.push name) #[]
-  let constants  := env.constants.foldStage2 (fun cs _ c => cs.push c) #[]
+  let constsTask := Task.spawn fun _ =>
+    let constNames := env.constants.foldStage2 (fun names name _ => names.push name) #[]
+    let constants  := env.constants.foldStage2 (fun cs _ c => cs.push c) #[]
+    (constNames, constants, mkConstIndex constNames)
+  let entries := entryTasks.map (·.get)
+  let (constNames, constants, constSeeds, constIndex) := constsTask.get
   return {
     imports         := env.header.imports
     extraConstNames := env.extraConstNames.toArray
-    constNames, constants, entries
+    constNames, constants, constSeeds, constIndex, entries
   }
 
 @[export lean_write_module]
@@ -759,7 +908,11 @@ private def setImportedEntries (env : Environment) (mods : Array ModuleData) (st
 /-- "Forward declaration" for retrieving the number of builtin attributes. -/
 @[extern 1 "lean_get_num_attributes"] opaque getNumBuiltinAttributes : IO Nat
 
-private partial def finalizePersistentExtensions (env : Environment) (mods : Array ModuleData) (opts : Options) : IO Environment := do
+/--
+Last step of `finalizeImport`: computes the state of each persistent extension from its imported
+entries. This runs the `[init]` declarations of imported modules without native code.
+-/
+partial def finalizePersistentExtensions (env : Environment) (mods : Array ModuleData) (opts : Options) : IO Environment := do
   loop 0 env
 where
   loop (i : Nat) (env : Environment) : IO Environment := do
@@ -770,8 +923,14 @@ where
       let s := extDescr.toEnvExtension.getState env
       let prevSize := (← persistentEnvExtensionsRef.get).size
       let prevAttrSize ← getNumBuiltinAttributes
-      let newState ← extDescr.addImportedFn s.importedEntries { env := env, opts := opts }
-      let mut env := extDescr.toEnvExtension.setState env { s with state := newState }
+      let mut env := env
+      if let some addImportedFn := extDescr.lazyAddImportedFn? then
+        env := extDescr.toEnvExtension.setState env
+          { s with lazyState? := some (Thunk.mk fun _ => addImportedFn s.importedEntries) }
+      else
+        let newState ← profileitIO "import extension" opts (decl := extDescr.name) do
+          extDescr.addImportedFn s.importedEntries { env := env, opts := opts }
+        env := extDescr.toEnvExtension.setState env { s with state := newState }
       env ← ensureExtensionsArraySize env
       if (← persistentEnvExtensionsRef.get).size > prevSize || (← getNumBuiltinAttributes) > prevAttrSize then
         -- This branch is executed when `pExtDescrs[i]` is the extension associated with the `init` attribute, and
@@ -816,6 +975,62 @@ partial def importModulesCore (imports : Array Import) : ImportStateM Unit := do
       moduleNames := s.moduleNames.push i.module
     }
 
+private def readModuleDataOf (m : Name) : IO (ModuleData × CompactedRegion) := do
+  let mFile ← findOLean m
+  unless (← mFile.pathExists) do
+    throw <| IO.userError s!"object file '{mFile}' of module {m} does not exist"
+  readModuleData mFile
+
+private abbrev ModuleReadResult := Except IO.Error (ModuleData × CompactedRegion)
+
+/-- Adds the modules read by `importModulesParallelCore` to the state, in the order of `importModulesCore`. -/
+private partial def addReadModules (reads : Std.HashMap Name ModuleReadResult) (imports : Array Import) :
+    ImportStateM Unit := do
+  for i in imports do
+    if i.runtimeOnly || (← get).moduleNameSet.contains i.module then
+      continue
+    modify fun s => { s with moduleNameSet := s.moduleNameSet.insert i.module }
+    let (mod, region) ← match reads[i.module]? with
+      | some (.ok r)    => pure r
+      | some (.error e) => throw e
+      | none            => throw <| IO.userError s!"module {i.module} has not been read"
+    addReadModules reads mod.imports
+    modify fun s => { s with
+      moduleData  := s.moduleData.push mod
+      regions     := s.regions.push region
+      moduleNames := s.moduleNames.push i.module
+    }
+
+/--
+Like `importModulesCore`, but reads the `.olean` files in parallel: the file of a module is read in a
+separate task as soon as one of its importers has been read, with at most `maxTasks` reads in flight.
+The resulting state is the same as for `importModulesCore`, and so is the error reported for a
+missing or invalid file.
+-/
+def importModulesParallelCore (imports : Array Import) (maxTasks := 64) : ImportStateM Unit := do
+  let mut seen := (← get).moduleNameSet
+  -- modules in discovery order; `tasks[i]` reads `toRead[i]`
+  let mut toRead : Array Name := #[]
+  let mut tasks : Array (Task ModuleReadResult) := #[]
+  let mut reads : Std.HashMap Name ModuleReadResult := {}
+  for i in imports do
+    unless i.runtimeOnly || seen.contains i.module do
+      seen := seen.insert i.module
+      toRead := toRead.push i.module
+  let mut done := 0
+  while done < toRead.size do
+    while tasks.size < toRead.size && tasks.size - done < maxTasks do
+      tasks := tasks.push (← IO.asTask (readModuleDataOf toRead[tasks.size]!))
+    let r ← IO.wait tasks[done]!
+    if let .ok (mod, _) := r then
+      for i in mod.imports do
+        unless i.runtimeOnly || seen.contains i.module do
+          seen := seen.insert i.module
+          toRead := toRead.push i.module
+    reads := reads.insert toRead[done]! r
+    done := done + 1
+  addReadModules reads imports
+
 /--
 Return `true` if `cinfo₁` and `cinfo₂` are theorems with the same name, universe parameters,
 and types. We allow different modules to prove the same theorem.
@@ -844,36 +1059,54 @@ private def equivInfo (cinfo₁ cinfo₂ : ConstantInfo) : Bool := Id.run do
     && tval₁.all == tval₂.all
 
 /--
-  Construct environment from `importModulesCore` results.
-
-  If `leakEnv` is true, we mark the environment as persistent, which means it
-  will not be freed. We set this when the object would survive until the end of
-  the process anyway. In exchange, RC updates are avoided, which is especially
-  important when they would be atomic because the environment is shared across
-  threads (potentially, storing it in an `IO.Ref` is sufficient for marking it
-  as such). -/
-def finalizeImport (s : ImportState) (imports : Array Import) (opts : Options) (trustLevel : UInt32 := 0)
-    (leakEnv := false) : IO Environment := do
+First step of `finalizeImport`: builds the maps from the imported constants to their module index
+and, unless `lazyConstants` is true, to their `ConstantInfo`.
+-/
+def mkImportedConstMaps (s : ImportState) (lazyConstants := false) :
+    IO (Std.HashMap Name ModuleIdx × Std.HashMap Name ConstantInfo) := do
   let numConsts := s.moduleData.foldl (init := 0) fun numConsts mod =>
     numConsts + mod.constants.size + mod.extraConstNames.size
   let mut const2ModIdx : Std.HashMap Name ModuleIdx := Std.HashMap.empty (capacity := numConsts)
-  let mut constantMap : Std.HashMap Name ConstantInfo := Std.HashMap.empty (capacity := numConsts)
+  let mut constantMap : Std.HashMap Name ConstantInfo :=
+    Std.HashMap.empty (capacity := if lazyConstants then 0 else numConsts)
   for h : modIdx in [0:s.moduleData.size] do
     let mod := s.moduleData[modIdx]'h.upper
     for cname in mod.constNames, cinfo in mod.constants do
-      match constantMap.getThenInsertIfNew? cname cinfo with
-      | (cinfoPrev?, constantMap') =>
-        constantMap := constantMap'
-        if let some cinfoPrev := cinfoPrev? then
-          -- Recall that the map has not been modified when `cinfoPrev? = some _`.
-          unless equivInfo cinfoPrev cinfo do
-            throwAlreadyImported s const2ModIdx modIdx cname
-      const2ModIdx := const2ModIdx.insertIfNew cname modIdx
+      if lazyConstants then
+        match const2ModIdx.getThenInsertIfNew? cname modIdx with
+        | (modIdxPrev?, const2ModIdx') =>
+          const2ModIdx := const2ModIdx'
+          if let some modIdxPrev := modIdxPrev? then
+            match s.moduleData[modIdxPrev.toNat]!.findConst? cname with
+            | some cinfoPrev =>
+              unless equivInfo cinfoPrev cinfo do
+                throwAlreadyImported s const2ModIdx modIdx cname
+            | none =>
+              -- `cname` is an extra name of the previous module, but `find?` must find the declaring one
+              const2ModIdx := const2ModIdx.insert cname modIdx
+      else
+        match constantMap.getThenInsertIfNew? cname cinfo with
+        | (cinfoPrev?, constantMap') =>
+          constantMap := constantMap'
+          if let some cinfoPrev := cinfoPrev? then
+            -- Recall that the map has not been modified when `cinfoPrev? = some _`.
+            unless equivInfo cinfoPrev cinfo do
+              throwAlreadyImported s const2ModIdx modIdx cname
+        const2ModIdx := const2ModIdx.insertIfNew cname modIdx
     for cname in mod.extraConstNames do
       const2ModIdx := const2ModIdx.insertIfNew cname modIdx
+  return (const2ModIdx, constantMap)
+
+/--
+Second step of `finalizeImport`: creates the environment with the imported constants, and with the
+initial extension states together with the imported entries of persistent extensions.
+-/
+def mkImportedEnvironment (s : ImportState) (imports : Array Import) (const2ModIdx : Std.HashMap Name ModuleIdx)
+    (constantMap : Std.HashMap Name ConstantInfo) (trustLevel : UInt32 := 0) (lazyConstants := false) :
+    IO Environment := do
   let constants : ConstMap := SMap.fromHashMap constantMap false
   let exts ← mkInitialExtensionStates
-  let mut env : Environment := {
+  let env : Environment := {
     const2ModIdx    := const2ModIdx
     constants       := constants
     extraConstNames := {}
@@ -885,9 +1118,33 @@ def finalizeImport (s : ImportState) (imports : Array Import) (opts : Options) (
       regions      := s.regions
       moduleNames  := s.moduleNames
       moduleData   := s.moduleData
+      lazyConstants
     }
   }
-  env ← setImportedEntries env s.moduleData
+  setImportedEntries env s.moduleData
+
+/--
+  Construct environment from `importModulesCore` results.
+
+  If `leakEnv` is true, we mark the environment as persistent, which means it
+  will not be freed. We set this when the object would survive until the end of
+  the process anyway. In exchange, RC updates are avoided, which is especially
+  important when they would be atomic because the environment is shared across
+  threads (potentially, storing it in an `IO.Ref` is sufficient for marking it
+  as such).
+
+  If `lazyConstants` is true, imported constants are not inserted into `Environment.constants`, but are
+  looked up in the index of the declaring module (`ModuleData.constIndex`) by `Environment.find?`.
+  This saves building a map of all imported constants, and constants that are never looked up are not
+  touched at all. -/
+def finalizeImport (s : ImportState) (imports : Array Import) (opts : Options) (trustLevel : UInt32 := 0)
+    (leakEnv := false) (lazyConstants := false) : IO Environment := do
+  for h : modIdx in [0:s.regions.size] do
+    unless (← (s.regions[modIdx]'h.upper).externalRangesMapped) do
+      throw <| IO.userError s!"import {s.moduleNames[modIdx]!} failed, it refers to imported modules that could not \
+        be mapped at their base addresses, try rebuilding it without `LEAN_OLEAN_SHARE_IMPORTS`"
+  let (const2ModIdx, constantMap) ← mkImportedConstMaps s lazyConstants
+  let mut env ← mkImportedEnvironment s imports const2ModIdx constantMap trustLevel lazyConstants
   if leakEnv then
     /- Mark persistent a first time before `finalizePersistenExtensions`, which
        avoids costly MT markings when e.g. an interpreter closure (which
@@ -909,13 +1166,13 @@ def finalizeImport (s : ImportState) (imports : Array Import) (opts : Options) (
 
 @[export lean_import_modules]
 def importModules (imports : Array Import) (opts : Options) (trustLevel : UInt32 := 0)
-    (leakEnv := false) : IO Environment := profileitIO "import" opts do
+    (leakEnv := false) (lazyConstants := false) : IO Environment := profileitIO "import" opts do
   for imp in imports do
     if imp.module matches .anonymous then
       throw <| IO.userError "import failed, trying to import module with anonymous name"
   withImporting do
-    let (_, s) ← importModulesCore imports |>.run
-    finalizeImport (leakEnv := leakEnv) s imports opts trustLevel
+    let (_, s) ← importModulesParallelCore imports |>.run
+    finalizeImport (leakEnv := leakEnv) (lazyConstants := lazyConstants) s imports opts trustLevel
 
 /--
   Create environment object from imports and free compacted regions after calling `act`. No live references to the
@@ -942,11 +1199,31 @@ builtin_initialize namespacesExt : SimplePersistentEnvExtension Name NameSSet 
     addEntryFn      := fun s n => s.insert n
   }
 
+/-- Statistics for one phase of the kernel type checker, see `Kernel.Diagnostics.phases`. -/
+structure Kernel.PhaseStats where
+  /-- Number of calls, including the ones answered by a cache. -/
+  calls : Nat := 0
+  /-- Number of calls answered by the type checker caches. -/
+  hits : Nat := 0
+  /-- Time in seconds of the outermost calls. Nested calls of the same phase are not counted twice. -/
+  time : Float := 0
+  deriving Inhabited
+
 structure Kernel.Diagnostics where
   /-- Number of times each declaration has been unfolded by the kernel. -/
   unfoldCounter : PHashMap Name Nat := {}
   /-- If `enabled = true`, kernel records declarations that have been unfolded. -/
   enabled : Bool := false
+  /-- If `profile = true`, kernel records `phases` and `unfoldTime`. -/
+  profile : Bool := false
+  /--
+  Statistics for the phases `infer`, `whnf`, `whnf_core`, `is_def_eq` and `lazy_delta_reduction`
+  of the kernel type checker. -/
+  phases : PHashMap Name Kernel.PhaseStats := {}
+  /--
+  Time in seconds of the outermost kernel `whnf` calls, indexed by the first declaration they unfolded.
+  -/
+  unfoldTime : PHashMap Name Float := {}
   deriving Inhabited
 
 /--
@@ -983,6 +1260,23 @@ def Kernel.Diagnostics.recordUnfold (d : Diagnostics) (declName : Name) : Diagno
   else
     d
 
+@[export lean_kernel_diag_is_profiling]
+def Kernel.Diagnostics.isProfiling (d : Diagnostics) : Bool :=
+  d.profile
+
+@[export lean_kernel_record_phase]
+def Kernel.Diagnostics.recordPhase (d : Diagnostics) (phase : Name) (calls hits : Nat) (time : Float) : Diagnostics :=
+  let s := d.phases.findD phase {}
+  { d with phases := d.phases.insert phase { calls := s.calls + calls, hits := s.hits + hits, time := s.time + time } }
+
+@[export lean_kernel_record_unfold_time]
+def Kernel.Diagnostics.recordUnfoldTime (d : Diagnostics) (declName : Name) (time : Float) : Diagnostics :=
+  { d with unfoldTime := d.unfoldTime.insert declName (d.unfoldTime.findD declName 0 + time) }
+
+/-- Enables/disables kernel profiling, and clears the profiling data collected so far. -/
+def Kernel.enableProfile (env : Environment) (flag : Bool) : Environment :=
+  diagExt.modifyState env fun s => { s with profile := flag, phases := {}, unfoldTime := {} }
+
 @[export lean_kernel_get_diag]
 def Kernel.getDiagnostics (env : Environment) : Diagnostics :=
   diagExt.getState env
@@ -1014,6 +1308,13 @@ private def registerNamePrefixes : Environment → Name → Environment
   | env, .str p _ => if isNamespaceName p then registerNamePrefixes (registerNamespace env p) p else env
   | env, _        => env
 
+/--
+Constants added to the current module in order, so that the ones added since an earlier environment
+can be enumerated without traversing all of them, see `constantsSince`.
+-/
+builtin_initialize addedConstantsExt : EnvExtension (PersistentArray ConstantInfo) ←
+  registerEnvExtension (pure {})
+
 @[export lean_environment_add]
 private def add (env : Environment) (cinfo : ConstantInfo) : Environment :=
   let name := cinfo.name
@@ -1025,8 +1326,60 @@ private def add (env : Environment) (cinfo : ConstantInfo) : Environment :=
       else
         registerNamePrefixes env name
     | _ => env
+  let env := addedConstantsExt.modifyState env (·.push cinfo)
   env.addAux cinfo
 
+/--
+Returns the constants declared in the current module of `env` that are not in `base`, which `env`
+must extend.
+-/
+def constantsSince (env base : Environment) : Array ConstantInfo := Id.run do
+  let cs := addedConstantsExt.getState env
+  let mut r := #[]
+  for i in [(addedConstantsExt.getState base).size:cs.size] do
+    r := r.push cs[i]!
+  return r
+
+/--
+Adds constants that were checked by the kernel in another environment extending a common base with
+`env`, as when commands are elaborated speculatively in parallel. Their dependencies must be in
+`env` already, and their names must be fresh; they are not checked again.
+-/
+def addCheckedConstants (env : Environment) (cs : Array ConstantInfo) : Environment :=
+  cs.foldl add env
+
+private unsafe def extensionsPtrEqUnsafe (env₁ env₂ : Environment) : Bool :=
+  ptrEq env₁.extraConstNames env₂.extraConstNames &&
+  env₁.extensions.size == env₂.extensions.size &&
+  (List.range env₁.extensions.size).all fun i => ptrEq env₁.extensions[i]! env₂.extensions[i]!
+
+/--
+Returns `true` if the states of all environment extensions and the auxiliary constant names of
+`env₁` and `env₂` are the same objects, i.e. if no extension was modified between them.
+This check is cheap and conservative: an extension set to an equal but new state is reported as
+modified.
+-/
+@[implemented_by extensionsPtrEqUnsafe]
+opaque extensionsPtrEq (env₁ env₂ : @& Environment) : Bool
+
+/-- Sizes of the objects reachable from a value, see `reachableBytes`. -/
+structure ReachableBytes where
+  /-- Bytes of objects allocated on the heap. -/
+  heap    : Nat
+  /-- Bytes of objects stored in compacted regions, i.e. in imported .olean files. -/
+  regions : Nat
+  deriving Inhabited
+
+/--
+Counts the bytes of the objects reachable from `a`, separating the objects stored in one of the
+given compacted regions from the other ones. Waits for unfinished tasks reachable from `a`.
+-/
+@[extern "lean_reachable_bytes"]
+opaque reachableBytes {α : Type} (a : @& α) (regions : @& Array CompactedRegion) : BaseIO ReachableBytes
+
+private def ReachableBytes.format (b : ReachableBytes) : String :=
+  s!"{b.heap} bytes on the heap, {b.regions} bytes in .olean files"
+
 @[export lean_display_stats]
 def displayStats (env : Environment) : IO Unit := do
   let pExtDescrs ← persistentEnvExtensionsRef.get
@@ -1039,9 +1392,12 @@ def displayStats (env : Environment) : IO Unit := do
   pExtDescrs.forM fun extDescr => do
     IO.println ("extension '" ++ toString extDescr.name ++ "'")
     let s := extDescr.toEnvExtension.getState env
-    let fmt := extDescr.statsFn s.state
-    unless fmt.isNil do IO.println ("  " ++ toString (Format.nest 2 (extDescr.statsFn s.state)))
+    let fmt := extDescr.statsFn s.current
+    unless fmt.isNil do IO.println ("  " ++ toString (Format.nest 2 fmt))
     IO.println ("  number of imported entries: " ++ toString (s.importedEntries.foldl (fun sum es => sum + es.size) 0))
+    IO.println ("  memory: " ++ (← reachableBytes s env.header.regions).format)
+  IO.println ("memory of all extension states:        " ++ (← reachableBytes env.extensions env.header.regions).format)
+  IO.println ("memory of constants:                   " ++ (← reachableBytes env.constants env.header.regions).format)
 
 /--
   Evaluate the given declaration under the given environment to a value of the given type.
@@ -1103,6 +1459,31 @@ opaque whnf (env : Environment) (lctx : LocalContext) (a : Expr) : Except Kernel
 @[extern "lean_kernel_check"]
 opaque check (env : Environment) (lctx : LocalContext) (a : Expr) : Except KernelException Expr
 
+/--
+  Sets the number of entries of the kernel cache shared by all type checker instances and threads.
+  It stores weak head normal forms and inferred types of closed terms that only use imported constants,
+  so that they are not recomputed for every declaration. Least recently used entries are evicted first.
+  The cache is disabled by default (capacity `0`). -/
+@[extern "lean_kernel_set_closed_term_cache_capacity"]
+opaque setClosedTermCacheCapacity (capacity : USize) : IO Unit
+
+/--
+  Sets the number of declarations remembered by the kernel after checking them, shared by all threads.
+  When a declaration with the same name is added again (e.g., after an edit in the language server),
+  the kernel skips the check if neither the declaration nor the constants it was checked against changed.
+  If only the declaration changed, the types of its closed subterms are reused from the previous check.
+  Least recently used entries are evicted first. The cache is disabled by default (capacity `0`). -/
+@[extern "lean_kernel_set_checked_decl_cache_capacity"]
+opaque setCheckedDeclCacheCapacity (capacity : USize) : IO Unit
+
+/--
+  Enables or disables the kernel extension for `BitVec` literals. When it is enabled, the kernel
+  computes `BitVec.add`, `sub`, `mul`, `and`, `or`, `xor`, `ult` and `ule` directly on the values of
+  bitvectors that reduce to literals, instead of unfolding them to `Fin` and `Nat` arithmetic.
+  `UIntN` operations unfold to these. The extension is trusted code, and it is disabled by default. -/
+@[extern "lean_kernel_set_bitvec_reduction"]
+opaque setBitVecReduction (enable : Bool) : IO Unit
+
 end Kernel
 
 class MonadEnv (m : Type → Type) where
@@ -1374,18 +1374,22 @@ opaque abstract (e : @& Expr) (xs : @& Array Expr) : Expr
 @[extern "lean_expr_abstract_range"]
 opaque abstractRange (e : @& Expr) (n : @& Nat) (xs : @& Array Expr) : Expr
 
+/--
+Replace occurrences of the free variables `fvars` in `e` with `vs`.
+The implementation performs the `abstract` and the `instantiateRev` in a single traversal.
+-/
+@[extern "lean_expr_replace_fvars"]
+def replaceFVars (e : @& Expr) (fvars : @& Array Expr) (vs : @& Array Expr) : Expr :=
+  (e.abstract fvars).instantiateRev vs
+
 /-- Replace occurrences of the free variable `fvar` in `e` with `v` -/
 def replaceFVar (e : Expr) (fvar : Expr) (v : Expr) : Expr :=
-  (e.abstract #[fvar]).instantiate1 v
+  replaceFVars e #[fvar] #[v]
 
 /-- Replace occurrences of the free variable `fvarId` in `e` with `v` -/
 def replaceFVarId (e : Expr) (fvarId : FVarId) (v : Expr) : Expr :=
   replaceFVar e (mkFVar fvarId) v
 
-/-- Replace occurrences of the free variables `fvars` in `e` with `vs` -/
-def replaceFVars (e : Expr) (fvars : Array Expr) (vs : Array Expr) : Expr :=
-  (e.abstract fvars).instantiateRev vs
-
 instance : ToString Expr where
   toString := Expr.dbgToString
 
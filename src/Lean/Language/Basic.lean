@@ -43,6 +43,49 @@ def Snapshot.Diagnostics.empty : Snapshot.Diagnostics where
   -- nothing to memorize
   interactiveDiagsRef? := none
 
+/--
+A value of a snapshot that the language server may evict to reduce its memory usage. It is
+recomputed on the next access, which must yield an equivalent value.
+-/
+structure Evictable (α : Type) where
+  private mk ::
+  private ref       : IO.Ref (Option α)
+  private recompute : BaseIO α
+
+namespace Evictable
+
+/-- Creates an evictable slot holding `a` that is recomputed with `recompute` after eviction. -/
+def new (a : α) (recompute : BaseIO α) : BaseIO (Evictable α) :=
+  return { ref := (← IO.mkRef (some a)), recompute }
+
+/-- Returns the value, recomputing it if it has been evicted. -/
+def getIO (e : Evictable α) : BaseIO α := do
+  if let some a ← e.ref.get then
+    return a
+  let a ← e.recompute
+  e.ref.set (some a)
+  return a
+
+private unsafe def getUnsafe [Inhabited α] (e : Evictable α) : α :=
+  unsafeBaseIO e.getIO
+
+/--
+Returns the value, recomputing it if it has been evicted. Like `Thunk.get`, this is pure as the
+recomputed value is equivalent to the evicted one.
+-/
+@[implemented_by getUnsafe]
+opaque get [Inhabited α] (e : Evictable α) : α
+
+/-- Drops the value until it is accessed the next time. -/
+def evict (e : Evictable α) : BaseIO Unit :=
+  e.ref.set none
+
+/-- Returns the value without recomputing it, or `none` if it has been evicted. -/
+def peek? (e : Evictable α) : BaseIO (Option α) :=
+  e.ref.get
+
+end Evictable
+
 /--
   The base class of all snapshots: all the generic information the language server needs about a
   snapshot. -/
@@ -56,12 +99,21 @@ structure Snapshot where
   /-- General elaboration metadata produced by this step. -/
   infoTree? : Option Elab.InfoTree := none
   /--
+  Like `infoTree?`, but may be evicted by the language server under memory pressure, see
+  `internal.evictableInfoTrees`. At most one of the two fields is set.
+  -/
+  evictableInfoTree? : Option (Evictable Elab.InfoTree) := none
+  /--
   Whether it should be indicated to the user that a fatal error (which should be part of
   `diagnostics`) occurred that prevents processing of the remainder of the file.
   -/
   isFatal := false
 deriving Inhabited
 
+/-- The info tree of the snapshot, from `infoTree?` or `evictableInfoTree?`. -/
+def Snapshot.getInfoTree? (s : Snapshot) : Option Elab.InfoTree :=
+  s.infoTree? <|> s.evictableInfoTree?.map (·.get)
+
 /-- A task producing some snapshot type (usually a subclass of `Snapshot`). -/
 -- Longer-term TODO: Give the server more control over the priority of tasks, depending on e.g. the
 -- cursor position. This may require starting the tasks suspended (e.g. in `Thunk`). The server may
@@ -214,7 +266,7 @@ where go range? s := do
   if let some range := range? then
     desc := desc ++ f!"{file.toPosition range.start}-{file.toPosition range.stop} "
   desc := desc ++ .prefixJoin "\n• " (← s.element.diagnostics.msgLog.toList.mapM (·.toString))
-  if let some t := s.element.infoTree? then
+  if let some t := s.element.getInfoTree? then
     trace[Elab.info] (← t.format)
   withTraceNode `Elab.snapshotTree (fun _ => pure desc) do
     s.children.toList.forM fun c => go c.range? c.get
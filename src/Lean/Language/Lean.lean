@@ -13,6 +13,7 @@ import Lean.Language.Basic
 import Lean.Language.Lean.Types
 import Lean.Parser.Module
 import Lean.Elab.Import
+import Lean.Elab.Speculative
 
 /-!
 # Note [Incremental Parsing]
@@ -177,6 +178,13 @@ register_builtin_option stderrAsMessages : Bool := {
 structure LeanProcessingContext extends ProcessingContext where
   /-- Position of the first file difference if there was a previous invocation. -/
   firstDiffPos? : Option String.Pos
+  /--
+  Start positions of the longest common suffix of the previous and the current input that does not
+  overlap `firstDiffPos?`, in the previous and the current input, respectively.
+  -/
+  commonSuffixPos? : Option (String.Pos × String.Pos) := none
+  /-- See `SetupImportsResult.onInfoTree?`. -/
+  onInfoTree? : Option (Elab.InfoTree → BaseIO Unit) := none
   /-- Cancellation token of the previous invocation, if any. -/
   oldCancelTk? : Option IO.CancelToken
   /-- Cancellation token of the current run. -/
@@ -201,9 +209,27 @@ ruled out.
 def LeanProcessingM.run (act : LeanProcessingM α) (oldInputCtx? : Option InputContext)
     (oldCancelTk? : Option IO.CancelToken := none) : ProcessingM α := do
   -- compute position of syntactic change once
-  let firstDiffPos? := oldInputCtx?.map (·.input.firstDiffPos (← read).input)
+  let input := (← read).input
+  let firstDiffPos? := oldInputCtx?.map (·.input.firstDiffPos input)
+  let commonSuffixPos? := oldInputCtx?.map fun old =>
+    commonSuffixPos old.input input (old.input.firstDiffPos input)
   let newCancelTk ← IO.CancelToken.new
-  ReaderT.adapt ({ · with firstDiffPos?, oldCancelTk?, newCancelTk }) act
+  ReaderT.adapt ({ · with firstDiffPos?, commonSuffixPos?, oldCancelTk?, newCancelTk }) act
+where
+  commonSuffixPos (a b : String) (stop : String.Pos) : String.Pos × String.Pos := Id.run do
+    let mut pa := a.endPos
+    let mut pb := b.endPos
+    -- `pa` decreases in each iteration
+    for _ in [0:a.endPos.byteIdx] do
+      if pa ≤ stop || pb ≤ stop then
+        break
+      let pa' := a.prev pa
+      let pb' := b.prev pb
+      if a.get pa' != b.get pb' then
+        break
+      pa := pa'
+      pb := pb'
+    return (pa, pb)
 
 /--
 Returns true if there was a previous run and the given position is before any textual change
@@ -212,6 +238,37 @@ compared to it.
 def isBeforeEditPos (pos : String.Pos) : LeanProcessingM Bool := do
   return (← read).firstDiffPos?.any (pos < ·)
 
+/--
+If `pos` in the previous input lies in the common suffix with the current input, returns the
+corresponding position in the current input.
+-/
+def shiftOldPos? (pos : String.Pos) : LeanProcessingM (Option String.Pos) := do
+  let some (oldStart, newStart) := (← read).commonSuffixPos? | return none
+  if pos < oldStart then
+    return none
+  return some ⟨pos.byteIdx - oldStart.byteIdx + newStart.byteIdx⟩
+
+/--
+Moves syntax parsed from the common suffix of the previous input to the corresponding positions in
+the current input.
+-/
+private partial def shiftSyntax (input : String) (oldStart newStart : String.Pos) : Syntax → Syntax
+  | .node info k args => .node (shiftInfo info) k (args.map (shiftSyntax input oldStart newStart))
+  | .atom info v => .atom (shiftInfo info) v
+  | .ident info rawVal val pre =>
+    .ident (shiftInfo info) (shiftSubstring rawVal) val pre
+  | .missing => .missing
+where
+  shift (pos : String.Pos) : String.Pos :=
+    ⟨pos.byteIdx - oldStart.byteIdx + newStart.byteIdx⟩
+  shiftSubstring (s : Substring) : Substring :=
+    { str := input, startPos := shift s.startPos, stopPos := shift s.stopPos }
+  shiftInfo : SourceInfo → SourceInfo
+    | .original leading pos trailing endPos =>
+      .original (shiftSubstring leading) (shift pos) (shiftSubstring trailing) (shift endPos)
+    | .synthetic pos endPos canonical => .synthetic (shift pos) (shift endPos) canonical
+    | .none => .none
+
 /--
   Adds unexpected exceptions from header processing to the message log as a last resort; standard
   errors should already have been caught earlier. -/
@@ -233,6 +290,18 @@ structure SetupImportsResult where
   opts : Options
   /-- Kernel trust level. -/
   trustLevel : UInt32 := 0
+  /--
+  Environment with the imports of the header already loaded, e.g. by the fork server in
+  `util/shell.cpp`. It is used instead of importing them only if its imports and trust level match the
+  header.
+  -/
+  importedEnv? : Option Environment := none
+  /--
+  If set, the info tree of each command is passed to this function in order as soon as the command
+  has been elaborated instead of being stored in its snapshot, so that it can be freed early
+  (cmdline only).
+  -/
+  onInfoTree? : Option (Elab.InfoTree → BaseIO Unit) := none
 
 /-- Performance option used by cmdline driver. -/
 register_builtin_option internal.cmdlineSnapshots : Bool := {
@@ -241,6 +310,13 @@ register_builtin_option internal.cmdlineSnapshots : Bool := {
     for the cmdline driver: diagnostics per command and final full snapshot"
 }
 
+/-- Memory option used by the language server. -/
+register_builtin_option internal.evictableInfoTrees : Bool := {
+  defValue := false
+  descr    := "store the info tree of each command such that it can be evicted under memory pressure \
+    and recomputed by elaborating the command again on demand"
+}
+
 /--
 Parses values of options registered during import and left by the C++ frontend as strings, fails if
 any option names remain unknown.
@@ -291,6 +367,17 @@ is parsed in order to supply additional file metadata (or abort with a given ter
 
 `old?` is a previous resulting snapshot, if any, to be reused for incremental processing.
 -/
+/-- A command elaborated speculatively, see `Lean.Elab.Command.Speculative`. -/
+structure Speculation where
+  /-- Syntax tree of the command. -/
+  stx : Syntax
+  /-- Parser state after the command. -/
+  parserState : Parser.ModuleParserState
+  /-- Messages logged by the parser. -/
+  msgLog : MessageLog
+  /-- The command state after elaborating the command in the command state before the first one. -/
+  task : Task Command.State
+
 /-
 General notes:
 * For each processing function we pass in the previous state, if any, in order to reuse still-valid
@@ -330,7 +417,7 @@ where
                 -- elaboration reuse
                 oldProcSuccess.firstCmdSnap.bindIO (sync := true) fun oldCmd => do
                   let prom ← IO.Promise.new
-                  let _ ← IO.asTask (parseCmd oldCmd newParserState oldProcSuccess.cmdState prom ctx)
+                  let _ ← IO.asTask (parseCmd oldCmd newParserState oldProcSuccess.cmdState prom none ctx)
                   return .pure {
                     diagnostics := oldProcessed.diagnostics
                     result? := some {
@@ -400,8 +487,14 @@ where
 
       let startTime := (← IO.monoNanosNow).toFloat / 1000000000
       -- allows `headerEnv` to be leaked, which would live until the end of the process anyway
-      let (headerEnv, msgLog) ← Elab.processHeader (leakEnv := true) stx setup.opts .empty
-        ctx.toInputContext setup.trustLevel
+      let (headerEnv, msgLog) ← match setup.importedEnv? with
+        | some env =>
+          if env.header.imports == Elab.headerToImports stx && env.header.trustLevel == setup.trustLevel then
+            pure (env, .empty)
+          else
+            Elab.processHeader (leakEnv := true) stx setup.opts .empty ctx.toInputContext setup.trustLevel
+        | none =>
+          Elab.processHeader (leakEnv := true) stx setup.opts .empty ctx.toInputContext setup.trustLevel
       let stopTime := (← IO.monoNanosNow).toFloat / 1000000000
       let diagnostics := (← Snapshot.Diagnostics.ofMessageLog msgLog)
       if msgLog.hasErrors then
@@ -445,8 +538,8 @@ where
       -- `inc_ref_cold`s more visible
       let parserState := Runtime.markPersistent parserState
       let cmdState := Runtime.markPersistent cmdState
-      let ctx := Runtime.markPersistent ctx
-      let _ ← IO.asTask (parseCmd none parserState cmdState prom ctx)
+      let ctx := Runtime.markPersistent { ctx with onInfoTree? := setup.onInfoTree? }
+      let _ ← IO.asTask (parseCmd none parserState cmdState prom none ctx)
       return {
         diagnostics
         infoTree? := cmdState.infoState.trees[0]!
@@ -456,8 +549,14 @@ where
         }
       }
 
+  /--
+  Parses and elaborates the next command. `old?` is the snapshot of the command at the same position
+  before any change, if any. Otherwise, `oldPrev?` may be the snapshot of the previous command in the
+  previous input, whose syntax can be reused if it is unchanged but moved by an edit before it.
+  -/
   parseCmd (old? : Option CommandParsedSnapshot) (parserState : Parser.ModuleParserState)
-      (cmdState : Command.State) (prom : IO.Promise CommandParsedSnapshot) :
+      (cmdState : Command.State) (prom : IO.Promise CommandParsedSnapshot)
+      (oldPrev? : Option CommandParsedSnapshot) :
       LeanProcessingM Unit := do
     let ctx ← read
 
@@ -486,7 +585,7 @@ where
           -- also wait on old command parse snapshot as parsing is cheap and may allow for
           -- elaboration reuse
           oldNext.bindIO (sync := true) fun oldNext => do
-            parseCmd oldNext newParserState oldFinished.cmdState newProm ctx
+            parseCmd oldNext newParserState oldFinished.cmdState newProm none ctx
             return .pure ()
         prom.resolve <| .mk (data := old.data) (nextCmdSnap? := some { range? := none, task := newProm.result })
       else prom.resolve old  -- terminal command, we're done!
@@ -503,9 +602,15 @@ where
       env := cmdState.env, options := scope.opts, currNamespace := scope.currNamespace
       openDecls := scope.openDecls
     }
-    let (stx, parserState, msgLog) :=
-      profileit "parsing" scope.opts fun _ =>
-        Parser.parseCommand ctx.toInputContext pmctx parserState .empty
+    let oldCmd? ← if old?.isSome then pure none else alignedOldCmd? oldPrev? beginPos
+    let reused? ← match oldPrev?, oldCmd? with
+      | some oldPrev, some oldCmd => reuseParse? oldPrev oldCmd cmdState
+      | _, _ => pure none
+    let (stx, parserState, msgLog) := match reused? with
+      | some (stx, parserState) => (stx, parserState, .empty)
+      | none =>
+        profileit "parsing" scope.opts fun _ =>
+          Parser.parseCommand ctx.toInputContext pmctx parserState .empty
 
     -- semi-fast path
     if let some old := old? then
@@ -554,30 +659,131 @@ where
     }
     prom.resolve <| .mk (nextCmdSnap? := next?.map
       ({ range? := some ⟨parserState.pos, ctx.input.endPos⟩, task := ·.result })) data
+    let specs ← if minimalSnapshots && old?.isNone && Speculative.isCandidate stx then
+        speculate (Speculative.Elab.speculativeCommands.get scope.opts) pmctx parserState cmdState ctx
+      else pure #[]
+    let base := cmdState
     let cmdState ← doElab stx cmdState beginPos
       { old? := old?.map fun old => ⟨old.data.stx, old.data.elabSnap⟩, new := elabPromise }
       finishedPromise tacticCache ctx
     if let some next := next? then
-      parseCmd none parserState cmdState next ctx
-
-  doElab (stx : Syntax) (cmdState : Command.State) (beginPos : String.Pos)
-      (snap : SnapshotBundle DynamicSnapshot) (finishedPromise : IO.Promise CommandFinishedSnapshot)
-      (tacticCache : IO.Ref Tactic.Cache) :
+      let (parserState, cmdState, next) ← commitSpeculations base specs parserState cmdState next ctx
+      parseCmd none parserState cmdState next (old?.orElse fun _ => oldCmd?) ctx
+
+  /--
+  Returns the old command following `oldPrev?` if `oldPrev?` ends in the common suffix of the
+  previous and the current input at the position corresponding to `beginPos`.
+  -/
+  alignedOldCmd? (oldPrev? : Option CommandParsedSnapshot) (beginPos : String.Pos) :
+      LeanProcessingM (Option CommandParsedSnapshot) := do
+    let some oldPrev := oldPrev? | return none
+    unless (← shiftOldPos? oldPrev.data.parserState.pos) == some beginPos do
+      return none
+    oldPrev.nextCmdSnap?.bindM (·.get?)
+
+  /--
+  Reuses the syntax of `oldCmd`, which lies in the common suffix of the previous and the current
+  input, moved to the current input, if the parser context it was parsed in, given by the state after
+  `oldPrev`, is unchanged. As the edit lies before the command, it must be elaborated again all the
+  same.
+  -/
+  reuseParse? (oldPrev oldCmd : CommandParsedSnapshot) (cmdState : Command.State) :
+      LeanProcessingM (Option (Syntax × Parser.ModuleParserState)) := do
+    let ctx ← read
+    let some (oldStart, newStart) := ctx.commonSuffixPos? | return none
+    let some oldFinished ← oldPrev.data.finishedSnap.get? | return none
+    let oldState := oldFinished.cmdState
+    unless unsafe ptrEq (Parser.parserExtension.getState oldState.env)
+        (Parser.parserExtension.getState cmdState.env) && unsafe ptrEq oldState.scopes cmdState.scopes do
+      return none
+    -- parser messages would have to be moved as well
+    if oldCmd.data.stx.isMissing || oldCmd.data.diagnostics.msgLog.hasUnreported then
+      return none
+    let some endPos ← shiftOldPos? oldCmd.data.parserState.pos | return none
+    return some (shiftSyntax ctx.input oldStart newStart oldCmd.data.stx,
+      { oldCmd.data.parserState with pos := endPos })
+
+  /--
+  Parses up to `n` commands following the current one in the same parser context, as long as they
+  are candidates for speculation, and elaborates them in parallel in `cmdState`, the command state
+  before the current command.
+  -/
+  speculate (n : Nat) (pmctx : Parser.ParserModuleContext) (parserState : Parser.ModuleParserState)
+      (cmdState : Command.State) : LeanProcessingM (Array Speculation) := do
+    let ctx ← read
+    let mut specs := #[]
+    let mut parserState := parserState
+    for _ in [0:n] do
+      let beginPos := parserState.pos
+      let (stx, parserState', msgLog) :=
+        Parser.parseCommand ctx.toInputContext pmctx parserState .empty
+      unless Speculative.isCandidate stx do
+        break
+      let task ← BaseIO.asTask (runElab stx cmdState beginPos none (← IO.mkRef {}) ctx)
+      specs := specs.push { stx, parserState := parserState', msgLog, task }
+      parserState := parserState'
+    return specs
+
+  /--
+  Commits the speculative results of `specs` in order for as long as possible, resolving `next` with
+  their snapshots. `base` is the command state in which they were elaborated, and `cmdState` the one
+  after the current command. Returns the parser state, command state and snapshot promise to continue
+  with.
+  -/
+  commitSpeculations (base : Command.State) (specs : Array Speculation)
+      (parserState : Parser.ModuleParserState) (cmdState : Command.State)
+      (next : IO.Promise CommandParsedSnapshot) :
+      LeanProcessingM (Parser.ModuleParserState × Command.State × IO.Promise CommandParsedSnapshot) := do
+    let ctx ← read
+    let mut parserState := parserState
+    let mut cmdState := cmdState
+    let mut next := next
+    for spec in specs do
+      -- do not wait for the speculation if it cannot be committed anyway
+      unless Speculative.isPlainStep base cmdState do
+        break
+      let some cmdState' := Speculative.commit? base cmdState (← IO.wait spec.task) spec.stx
+        | break
+      let next' ← IO.Promise.new
+      next.resolve <| .mk
+        (nextCmdSnap? := some { range? := some ⟨spec.parserState.pos, ctx.input.endPos⟩, task := next'.result }) {
+        diagnostics := (← Snapshot.Diagnostics.ofMessageLog spec.msgLog)
+        stx := .missing
+        parserState := {}
+        elabSnap := .pure <| .ofTyped { diagnostics := .empty : SnapshotLeaf }
+        finishedSnap := .pure {
+          diagnostics := (← Snapshot.Diagnostics.ofMessageLog cmdState'.messages)
+          infoTree? := (← cmdlineInfoTree? cmdState'.infoState.trees[0]!)
+          cmdState := { env := Runtime.markPersistent cmdState'.env, maxRecDepth := 0 }
+        }
+        tacticCache := (← IO.mkRef {})
+      }
+      parserState := spec.parserState
+      cmdState := cmdState'
+      next := next'
+    return (parserState, cmdState, next)
+
+  /--
+  Returns the info tree of a command to be stored in its snapshot in cmdline mode, or passes it to
+  `onInfoTree?` if set.
+  -/
+  cmdlineInfoTree? (infoTree : Elab.InfoTree) : LeanProcessingM (Option Elab.InfoTree) := do
+    if let some onInfoTree := (← read).onInfoTree? then
+      onInfoTree infoTree
+      return none
+    return some (Runtime.markPersistent infoTree)
+
+  /-- Elaborates `stx` in `cmdState`, adding output to stdout to the resulting messages. -/
+  runElab (stx : Syntax) (cmdState : Command.State) (beginPos : String.Pos)
+      (snap? : Option (SnapshotBundle DynamicSnapshot)) (tacticCache : IO.Ref Tactic.Cache) :
       LeanProcessingM Command.State := do
     let ctx ← read
     let scope := cmdState.scopes.head!
     let cmdStateRef ← IO.mkRef { cmdState with messages := .empty }
-    /-
-    The same snapshot may be executed by different tasks. So, to make sure `elabCommandTopLevel`
-    has exclusive access to the cache, we create a fresh reference here. Before this change, the
-    following `tacticCache.modify` would reset the tactic post cache while another snapshot was
-    still using it.
-    -/
-    let tacticCacheNew ← IO.mkRef (← tacticCache.get)
     let cmdCtx : Elab.Command.Context := { ctx with
       cmdPos       := beginPos
-      tacticCache? := some tacticCacheNew
-      snap?        := if internal.cmdlineSnapshots.get scope.opts then none else snap
+      tacticCache? := some tacticCache
+      snap?
       cancelTk?    := some ctx.newCancelTk
     }
     let (output, _) ←
@@ -586,8 +792,6 @@ where
           withLoggingExceptions
             (getResetInfoTrees *> Elab.Command.elabCommandTopLevel stx)
             cmdCtx cmdStateRef
-    let postNew := (← tacticCacheNew.get).post
-    tacticCache.modify fun _ => { pre := postNew, post := {} }
     let cmdState ← cmdStateRef.get
     let mut messages := cmdState.messages
     if !output.isEmpty then
@@ -597,21 +801,58 @@ where
         pos      := ctx.fileMap.toPosition beginPos
         data     := output
       }
-    let cmdState := { cmdState with messages }
+    return { cmdState with messages }
+
+  /--
+  Recomputes the info tree of `stx` after it has been evicted by elaborating it again in
+  `cmdState`, the command state before it. The elaboration cannot be canceled by later edits, which
+  do not invalidate the snapshot the info tree is requested from anyway.
+  -/
+  reelabInfoTree (stx : Syntax) (cmdState : Command.State) (beginPos : String.Pos)
+      (ctx : LeanProcessingContext) : BaseIO Elab.InfoTree := do
+    let cmdState ← runElab stx cmdState beginPos none (← IO.mkRef {})
+      |>.run { ctx with newCancelTk := (← IO.CancelToken.new) }
+    return cmdState.infoState.trees[0]!
+
+  doElab (stx : Syntax) (cmdState : Command.State) (beginPos : String.Pos)
+      (snap : SnapshotBundle DynamicSnapshot) (finishedPromise : IO.Promise CommandFinishedSnapshot)
+      (tacticCache : IO.Ref Tactic.Cache) :
+      LeanProcessingM Command.State := do
+    let scope := cmdState.scopes.head!
+    /-
+    The same snapshot may be executed by different tasks. So, to make sure `elabCommandTopLevel`
+    has exclusive access to the cache, we create a fresh reference here. Before this change, the
+    following `tacticCache.modify` would reset the tactic post cache while another snapshot was
+    still using it.
+    -/
+    let tacticCacheNew ← IO.mkRef (← tacticCache.get)
+    let snap? := if internal.cmdlineSnapshots.get scope.opts then none else some snap
+    let prevCmdState := cmdState
+    let cmdState ← runElab stx cmdState beginPos snap? tacticCacheNew
+    let postNew := (← tacticCacheNew.get).post
+    tacticCache.modify fun _ => { pre := postNew, post := {} }
     -- definitely resolve eventually
     snap.new.resolve <| .ofTyped { diagnostics := .empty : SnapshotLeaf }
 
-    let mut infoTree := cmdState.infoState.trees[0]!
+    let infoTree := cmdState.infoState.trees[0]!
     let cmdline := internal.cmdlineSnapshots.get scope.opts && !Parser.isTerminalCommand stx
-    if cmdline then
-      infoTree := Runtime.markPersistent infoTree
+    let evictable := !cmdline && internal.evictableInfoTrees.get scope.opts
+    let evictableInfoTree? ← if evictable then
+      -- do not retain the info trees and messages of the previous command
+      let prevCmdState := { prevCmdState with infoState.trees := {}, messages := .empty }
+      some <$> Evictable.new infoTree (reelabInfoTree stx prevCmdState beginPos (← read))
+    else
+      pure none
     finishedPromise.resolve {
       diagnostics := (← Snapshot.Diagnostics.ofMessageLog cmdState.messages)
-      infoTree? := infoTree
+      infoTree? := (← if cmdline then cmdlineInfoTree? infoTree else if evictable then pure none else pure (some infoTree))
+      evictableInfoTree?
       cmdState := if cmdline then {
         env := Runtime.markPersistent cmdState.env
         maxRecDepth := 0
-      } else cmdState
+      } else if evictable then
+        { cmdState with infoState.trees := {} }
+      else cmdState
     }
     -- The reported `cmdState` in the snapshot may be minimized as seen above, so we return the full
     -- state here for further processing on the same thread
@@ -625,7 +866,7 @@ def processCommands (inputCtx : Parser.InputContext) (parserState : Parser.Modul
     (old? : Option (Parser.InputContext × CommandParsedSnapshot) := none) :
     BaseIO (Task CommandParsedSnapshot) := do
   let prom ← IO.Promise.new
-  process.parseCmd (old?.map (·.2)) parserState commandState prom
+  process.parseCmd (old?.map (·.2)) parserState commandState prom none
     |>.run (old?.map (·.1))
     |>.run { inputCtx with }
   return prom.result
@@ -5,6 +5,7 @@ Authors: Lars König
 -/
 prelude
 import Lean.Linter.Util
+import Lean.Linter.InfoTree
 import Lean.Linter.Builtin
 import Lean.Linter.ConstructorAsVariable
 import Lean.Linter.Deprecated
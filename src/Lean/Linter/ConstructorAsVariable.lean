@@ -6,6 +6,7 @@ Authors: David Thrane Christiansen
 prelude
 import Lean.Elab.Command
 import Lean.Linter.Util
+import Lean.Linter.InfoTree
 
 set_option linter.missingDocs true
 
@@ -28,16 +29,15 @@ Reports when bound variables' names overlap with constructor names for their typ
 especially new users that they have built a pattern that matches anything, rather than one that
 matches a particular constructor. Use `linter.constructorNameAsVariable` to disable.
 -/
-def constructorNameAsVariable : Linter where
-  run cmdStx := do
+def constructorNameAsVariable : InfoTreeLinter where
+  mkVisitor cmdStx := do
     let some cmdStxRange := cmdStx.getRange?
-      | return
+      | return none
 
-    let infoTrees := (← get).infoState.trees.toArray
     let warnings : IO.Ref (Std.HashMap String.Range (Syntax × Name × Name)) ← IO.mkRef {}
 
-    for tree in infoTrees do
-      tree.visitM' (postNode := fun ci info _ => do
+    return some {
+      visit := fun ci info => do
         match info with
         | .ofTermInfo ti =>
           match ti.expr with
@@ -72,12 +72,14 @@ def constructorNameAsVariable : Linter where
                           warnings.modify (·.insert range (info.stx, n, c))
             else pure ()
           | _ => pure ()
-        | _ => pure ())
+        | _ => pure ()
 
-    -- Sort the outputs by position
-    for (_range, declStx, userName, ctorName) in (← warnings.get).toArray.qsort (·.1.start < ·.1.start) do
-      logLint linter.constructorNameAsVariable declStx <|
-        m!"Local variable '{userName}' resembles constructor '{ctorName}' - " ++
-        m!"write '.{userName}' (with a dot) or '{ctorName}' to use the constructor."
+      finish := do
+        -- Sort the outputs by position
+        for (_range, declStx, userName, ctorName) in (← warnings.get).toArray.qsort (·.1.start < ·.1.start) do
+          logLint linter.constructorNameAsVariable declStx <|
+            m!"Local variable '{userName}' resembles constructor '{ctorName}' - " ++
+            m!"write '.{userName}' (with a dot) or '{ctorName}' to use the constructor."
+    }
 
-builtin_initialize addLinter constructorNameAsVariable
+builtin_initialize addInfoTreeLinter constructorNameAsVariable
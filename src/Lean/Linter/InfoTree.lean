@@ -0,0 +1,77 @@
+/-
+Copyright (c) 2024 Lean FRO, LLC. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+-/
+prelude
+import Lean.Elab.Command
+import Lean.Server.InfoUtils
+
+/-!
+# Info tree linters
+
+Many linters inspect every node of the info trees of a command. Instead of each of them walking the
+trees on its own, linters registered with `addInfoTreeLinter` are run by a single regular linter
+that traverses the trees once and passes every node to each of them.
+-/
+
+namespace Lean.Linter
+open Elab Command
+
+/-- The per-command state of an `InfoTreeLinter`. -/
+structure InfoTreeVisitor where
+  /-- Called for every node of the info trees of the command, in post-order. -/
+  visit  : ContextInfo → Info → CommandElabM Unit
+  /-- Called after the traversal. -/
+  finish : CommandElabM Unit := pure ()
+
+/-- A linter that is run as part of the shared traversal of the info trees of each command. -/
+structure InfoTreeLinter where
+  /-- Prepares the visitor for the command `stx`, or returns `none` if there is nothing to lint. -/
+  mkVisitor : Syntax → CommandElabM (Option InfoTreeVisitor)
+  name : Name := by exact decl_name%
+
+builtin_initialize infoTreeLintersRef : IO.Ref (Array InfoTreeLinter) ← IO.mkRef #[]
+
+def addInfoTreeLinter (l : InfoTreeLinter) : IO Unit :=
+  infoTreeLintersRef.modify (·.push l)
+
+private def logLinterFailure (name : Name) (ex : Exception) : CommandElabM Unit :=
+  match ex with
+  | .error ref msg => logException (.error ref m!"linter {name} failed: {msg}")
+  | .internal _ _  => logException ex
+
+/--
+Runs the linters registered with `addInfoTreeLinter` in a single traversal of the info trees. A
+linter that throws an exception is reported and not called again for the current command.
+-/
+def infoTreeLinters : Linter where
+  run stx := do
+    let mut visitors : Array (Name × InfoTreeVisitor) := #[]
+    for l in (← infoTreeLintersRef.get) do
+      try
+        if let some v ← l.mkVisitor stx then
+          visitors := visitors.push (l.name, v)
+      catch ex =>
+        logLinterFailure l.name ex
+    if visitors.isEmpty then
+      return
+    let visitors := visitors
+    let failed ← IO.mkRef (mkArray visitors.size false)
+    for tree in (← get).infoState.trees do
+      tree.visitM' (postNode := fun ci info _ => do
+        for h : i in [0:visitors.size] do
+          unless (← failed.get)[i]! do
+            let (name, v) := visitors[i]
+            try
+              v.visit ci info
+            catch ex =>
+              failed.modify (·.set! i true)
+              logLinterFailure name ex)
+    for h : i in [0:visitors.size] do
+      unless (← failed.get)[i]! do
+        let (name, v) := visitors[i]
+        try v.finish catch ex => logLinterFailure name ex
+
+builtin_initialize addLinter infoTreeLinters
+
+end Lean.Linter
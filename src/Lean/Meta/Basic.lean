@@ -10,6 +10,7 @@ import Lean.Class
 import Lean.ReducibilityAttrs
 import Lean.Util.ReplaceExpr
 import Lean.Util.MonadBacktrack
+import Lean.Util.CacheStats
 import Lean.Compiler.InlineAttrs
 import Lean.Meta.TransparencyMode
 
@@ -1905,7 +1906,7 @@ def isExprDefEq (t s : Expr) : MetaM Bool :=
     Remark: the kernel does *not* update the type of variables in the local context.
     -/
     resetDefEqPermCaches
-    checkpointDefEq (mayPostpone := true) <| Meta.isExprDefEqAux t s
+    CacheStat.isDefEq.time id <| checkpointDefEq (mayPostpone := true) <| Meta.isExprDefEqAux t s
 
 /--
   Determines whether two expressions are definitionally equal to each other.
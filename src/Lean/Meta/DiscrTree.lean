@@ -484,13 +484,70 @@ def insertCore [BEq α] (d : DiscrTree α) (keys : Array Key) (v : α) : DiscrTr
   if keys.isEmpty then panic! "invalid key sequence"
   else
     let k := keys[0]!
-    match d.root.find? k with
-    | none =>
-      let c := createNodes keys v 1
-      { root := d.root.insert k c }
-    | some c =>
-      let c := insertAux keys v 1 c
-      { root := d.root.insert k c }
+    { root := d.root.upsert k fun
+        | none   => createNodes keys v 1
+        | some c => insertAux keys v 1 c }
+
+/--
+Inserts the values of `t₂` into `t₁`. The result is the same as inserting the entries of `t₂` into
+`t₁` again in the order in which they were inserted into `t₂`.
+-/
+partial def Trie.merge [BEq α] : Trie α → Trie α → Trie α
+  | .node vs₁ cs₁, .node vs₂ cs₂ => .node (vs₂.foldl insertVal vs₁) (mergeChildren cs₁ cs₂)
+where
+  mergeChildren (cs₁ cs₂ : Array (Key × Trie α)) : Array (Key × Trie α) := Id.run do
+    if cs₁.isEmpty then return cs₂
+    if cs₂.isEmpty then return cs₁
+    let mut cs := .mkEmpty (cs₁.size + cs₂.size)
+    let mut i := 0
+    let mut j := 0
+    while i < cs₁.size && j < cs₂.size do
+      let (k₁, c₁) := cs₁[i]!
+      let (k₂, c₂) := cs₂[j]!
+      if k₁ < k₂ then
+        cs := cs.push (k₁, c₁)
+        i := i + 1
+      else if k₂ < k₁ then
+        cs := cs.push (k₂, c₂)
+        j := j + 1
+      else
+        cs := cs.push (k₁, merge c₁ c₂)
+        i := i + 1
+        j := j + 1
+    cs := cs₁.foldl (start := i) (init := cs) Array.push
+    return cs₂.foldl (start := j) (init := cs) Array.push
+
+/-- Inserts the values of `d₂` into `d₁`, see `Trie.merge`. -/
+def merge [BEq α] (d₁ d₂ : DiscrTree α) : DiscrTree α :=
+  { root := d₂.root.foldl (init := d₁.root) fun root k c₂ =>
+      root.upsert k fun
+        | none    => c₂
+        | some c₁ => c₁.merge c₂ }
+
+/--
+Inserts the values of `entries` with their keys into `d`, in order. The entries are split into
+consecutive groups of about `entriesPerTask` entries whose trees are built in parallel and then
+merged. Used to index the entries of all imported modules at once.
+-/
+def insertParallel [BEq α] (d : DiscrTree α) (entries : Array (Array (Array Key × α)))
+    (entriesPerTask := 4096) : DiscrTree α := Id.run do
+  let mut tasks := #[]
+  let mut group := #[]
+  let mut groupSize := 0
+  for es in entries do
+    group := group.push es
+    groupSize := groupSize + es.size
+    if groupSize ≥ entriesPerTask then
+      tasks := tasks.push (build group)
+      group := #[]
+      groupSize := 0
+  if groupSize > 0 then
+    tasks := tasks.push (build group)
+  return tasks.foldl (init := d) fun d t => d.merge t.get
+where
+  build (group : Array (Array (Array Key × α))) : Task (DiscrTree α) :=
+    Task.spawn fun _ => group.foldl (init := empty) fun d es =>
+      es.foldl (init := d) fun d (keys, v) => d.insertCore keys v
 
 def insert [BEq α] (d : DiscrTree α) (e : Expr) (v : α) (config : WhnfCoreConfig) (noIndexAtArgs := false) : MetaM (DiscrTree α) := do
   let keys ← mkPath e config noIndexAtArgs
@@ -641,7 +698,8 @@ private def getMatchCore (d : DiscrTree α) (e : Expr) (config : WhnfCoreConfig)
   Find values that match `e` in `d`.
 -/
 def getMatch (d : DiscrTree α) (e : Expr) (config : WhnfCoreConfig) : MetaM (Array α) :=
-  return (← getMatchCore d e config).2
+  CacheStat.discrTree.time (!·.isEmpty) do
+    return (← getMatchCore d e config).2
 
 /--
   Similar to `getMatch`, but returns solutions that are prefixes of `e`.
@@ -725,7 +783,7 @@ def getMatchLiberal (d : DiscrTree α) (e : Expr) (config : WhnfCoreConfig) : Me
     | _      => return (getAllValuesForKey d k result, numArgs)
 
 partial def getUnify (d : DiscrTree α) (e : Expr) (config : WhnfCoreConfig) : MetaM (Array α) :=
-  withReducible do
+  CacheStat.discrTree.time (!·.isEmpty) <| withReducible do
     let (k, args) ← getUnifyKeyArgs e (root := true) config
     match k with
     | .star => d.root.foldlM (init := #[]) fun result k c => process k.arity #[] c result
@@ -886,3 +944,20 @@ def mapArraysM (d : DiscrTree α) (f : Array α → m (Array β)) : m (DiscrTree
 /-- Apply a function to the array of values at each node in a `DiscrTree`. -/
 def mapArrays (d : DiscrTree α) (f : Array α → Array β) : DiscrTree β :=
   Id.run <| d.mapArraysM fun A => pure (f A)
+
+/--
+Copies the arrays of the trie into arrays of exactly their size. Arrays built by repeated insertion
+keep up to twice the capacity they need; the copies of a large, rarely modified trie are smaller and
+keep the children of a node next to each other.
+-/
+partial def Trie.compact : Trie α → Trie α
+  | .node vs children =>
+    let vs := vs.foldl (init := .mkEmpty vs.size) Array.push
+    .node vs (children.foldl (init := .mkEmpty children.size) fun cs (k, c) => cs.push (k, c.compact))
+
+/--
+Compacts the tries of a discrimination tree, see `Trie.compact`. Used when a tree is complete after
+importing a module, such as the `simp` set, before it is queried many times.
+-/
+def compact (d : DiscrTree α) : DiscrTree α :=
+  { root := d.root.map Trie.compact }
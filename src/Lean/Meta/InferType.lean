@@ -169,17 +169,21 @@ private def inferFVarType (fvarId : FVarId) : MetaM Expr := do
   match (← getTransparency) with
   | .default =>
     match (← get).cache.inferType.default.find? e with
-    | some type => return type
+    | some type =>
+      CacheStat.inferType.recordHit
+      return type
     | none =>
-      let type ← inferType
+      let type ← CacheStat.inferType.recordMiss inferType
       unless e.hasMVar || type.hasMVar do
         modifyInferTypeCacheDefault fun c => c.insert e type
       return type
   | .all =>
     match (← get).cache.inferType.all.find? e with
-    | some type => return type
+    | some type =>
+      CacheStat.inferType.recordHit
+      return type
     | none =>
-      let type ← inferType
+      let type ← CacheStat.inferType.recordMiss inferType
       unless e.hasMVar || type.hasMVar do
         modifyInferTypeCacheAll fun c => c.insert e type
       return type
@@ -80,6 +80,17 @@ def addInstanceEntry (d : Instances) (e : InstanceEntry) : Instances :=
   | some n => { d with discrTree := d.discrTree.insertCore e.keys e, instanceNames := d.instanceNames.insert n e, erased := d.erased.erase n }
   | none   => { d with discrTree := d.discrTree.insertCore e.keys e }
 
+/--
+Adds the instances of all imported modules, building their discrimination tree in parallel.
+Equivalent to adding them in order with `addInstanceEntry`.
+-/
+def addImportedInstanceEntries (d : Instances) (es : Array (Array InstanceEntry)) : Instances :=
+  let d := es.foldl (init := d) fun d es => es.foldl (init := d) fun d e =>
+    match e.globalName? with
+    | some n => { d with instanceNames := d.instanceNames.insert n e, erased := d.erased.erase n }
+    | none   => d
+  { d with discrTree := d.discrTree.insertParallel (es.map (·.map fun e => (e.keys, e))) }
+
 def Instances.eraseCore (d : Instances) (declName : Name) : Instances :=
   { d with erased := d.erased.insert declName, instanceNames := d.instanceNames.erase declName }
 
@@ -92,6 +103,7 @@ builtin_initialize instanceExtension : SimpleScopedEnvExtension InstanceEntry In
   registerSimpleScopedEnvExtension {
     initial  := {}
     addEntry := addInstanceEntry
+    addImportedEntries? := some addImportedInstanceEntries
   }
 
 private def mkInstanceKey (e : Expr) : MetaM (Array InstanceKey) := do
@@ -31,6 +31,12 @@ register_builtin_option backward.synthInstance.canonInstances : Bool := {
   descr := "use optimization that relies on 'morally canonical' instances during type class resolution"
 }
 
+register_builtin_option synthInstance.fileCache : Bool := {
+  defValue := false
+  descr := "reuse the results of type class problems without free variables, metavariables and local instances \
+    across the declarations of a file. The cache is reset when instances or reducibility attributes change"
+}
+
 namespace SynthInstance
 
 def getMaxHeartbeats (opts : Options) : Nat :=
@@ -775,6 +781,48 @@ private def cacheResult (cacheKey : SynthInstanceCacheKey) (abstResult? : Option
     else
       modify fun s => { s with cache.synthInstance := s.cache.synthInstance.insert cacheKey (some abstResult) }
 
+/--
+Results of closed type class problems shared by the declarations of a file, see `synthInstance.fileCache`.
+The entries are keyed by the type, `synthPendingDepth` and the maximum result size.
+-/
+structure SynthInstanceFileCache where
+  /-- The instances and reducibility attributes the results were computed with. -/
+  instances         : Instances := {}
+  reducibility      : NameMap ReducibilityStatus := {}
+  reducibilityExtra : SMap Name ReducibilityStatus := {}
+  map               : Std.HashMap (Expr × Nat × Nat) (Option Expr) := {}
+  deriving Inhabited
+
+builtin_initialize synthInstanceFileCacheExt : EnvExtension SynthInstanceFileCache ←
+  registerEnvExtension (pure {})
+
+/-- Returns the file cache, reset if the instances or reducibility attributes have changed. -/
+private def getSynthInstanceFileCache : MetaM SynthInstanceFileCache := do
+  let env ← getEnv
+  let instances := instanceExtension.getState env
+  let reducibility := reducibilityCoreExt.getState env
+  let reducibilityExtra := reducibilityExtraExt.getState env
+  let cache := synthInstanceFileCacheExt.getState env
+  if (unsafe ptrEq cache.instances instances) && (unsafe ptrEq cache.reducibility reducibility) &&
+      (unsafe ptrEq cache.reducibilityExtra reducibilityExtra) then
+    return cache
+  else
+    return { instances, reducibility, reducibilityExtra }
+
+/-- Adds a failure or a result without metavariables to the file cache. -/
+private def cacheFileResult (key : Expr × Nat × Nat) (abstResult? : Option AbstractMVarsResult)
+    (result? : Option Expr) : MetaM Unit := do
+  match result?, abstResult? with
+  | none, _ => insert none
+  | some result, some abstResult =>
+    if abstResult.numMVars == 0 && abstResult.paramNames.isEmpty && !result.hasMVar && !result.hasFVar then
+      insert (some result)
+  | _, _ => pure ()
+where
+  insert (entry : Option Expr) : MetaM Unit := do
+    let cache ← getSynthInstanceFileCache
+    modifyEnv (synthInstanceFileCacheExt.setState · { cache with map := cache.map.insert key entry })
+
 def synthInstance? (type : Expr) (maxResultSize? : Option Nat := none) : MetaM (Option Expr) := do profileitM Exception "typeclass inference" (← getOptions) (decl := type.getAppFn.constName?.getD .anonymous) do
   let opts ← getOptions
   let maxResultSize := maxResultSize?.getD (synthInstance.maxSize.get opts)
@@ -789,16 +837,32 @@ def synthInstance? (type : Expr) (maxResultSize? : Option Nat := none) : MetaM (
     let cacheKey := { localInsts, type, synthPendingDepth := (← read).synthPendingDepth }
     match (← get).cache.synthInstance.find? cacheKey with
     | some abstResult? =>
+      CacheStat.synthInstance.recordHit
       let result? ← applyCachedAbstractResult? type abstResult?
       trace[Meta.synthInstance] "result {result?} (cached)"
       return result?
     | none =>
-      let abstResult? ← withNewMCtxDepth (allowLevelAssignments := true) do
+      let fileKey? :=
+        if synthInstance.fileCache.get opts && localInsts.isEmpty && !type.hasFVar && !type.hasMVar then
+          some (type, cacheKey.synthPendingDepth, maxResultSize)
+        else
+          none
+      if let some fileKey := fileKey? then
+        if let some entry := (← getSynthInstanceFileCache).map[fileKey]? then
+          CacheStat.synthInstance.recordHit
+          let abstResult? := entry.map fun expr => { expr, paramNames := #[], numMVars := 0 }
+          let result? ← applyCachedAbstractResult? type abstResult?
+          trace[Meta.synthInstance] "result {result?} (cached in file)"
+          cacheResult cacheKey abstResult? result?
+          return result?
+      let abstResult? ← CacheStat.synthInstance.recordMiss <| withNewMCtxDepth (allowLevelAssignments := true) do
         let normType ← preprocessOutParam type
         SynthInstance.main normType maxResultSize
       let result? ← applyAbstractResult? type abstResult?
       trace[Meta.synthInstance] "result {result?}"
       cacheResult cacheKey abstResult? result?
+      if let some fileKey := fileKey? then
+        cacheFileResult fileKey abstResult? result?
       return result?
 
 /--
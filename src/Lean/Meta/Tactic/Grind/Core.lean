@@ -16,16 +16,6 @@ def isInterpreted (e : Expr) : MetaM Bool := do
   if e.isTrue || e.isFalse then return true
   isLitValue e
 
-/--
-Creates an `ENode` for `e` if one does not already exist.
-This method assumes `e` has been hashconsed.
--/
-def mkENode (e : Expr) (generation : Nat := 0) : GoalM Unit := do
-  if (← getENode? e).isSome then return ()
-  let ctor := (← isConstructorAppCore? e).isSome
-  let interpreted ← isInterpreted e
-  mkENodeCore e interpreted ctor generation
-
 /--
 Returns the root element in the equivalence class of `e`.
 -/
@@ -54,6 +44,50 @@ private def pushNewEqCore (lhs rhs proof : Expr) (isHEq : Bool) : GoalM Unit :=
 @[inline] private def pushNewHEq (lhs rhs proof : Expr) : GoalM Unit :=
   pushNewEqCore lhs rhs proof (isHEq := true)
 
+/-- Returns the key of the application `e` in the congruence table. -/
+private def mkCongrKey (e : Expr) : GoalM CongrKey := do
+  let args ← e.getAppArgs.mapM getRoot
+  return { fn := (← getRoot e.getAppFn), args }
+
+/--
+Inserts the application `e` into the congruence table. If it already contains a congruent
+application `e'`, then `e = e'` is scheduled to be merged instead.
+-/
+private def addCongrTable (e : Expr) : GoalM Unit := do
+  let key ← mkCongrKey e
+  if let some e' := (← get).congrTable.find? key then
+    let some node ← getENode? e | return ()
+    setENode e { node with cgRoot := e' }
+    unless isSameExpr (← getRoot e) (← getRoot e') do
+      pushNewEq e e' congrPlaceholderProof
+  else
+    modify fun s => { s with congrTable := s.congrTable.insert key e }
+
+/-- Removes the application `e` from the congruence table if it is the representative of its key. -/
+private def removeCongrTable (e : Expr) : GoalM Unit := do
+  let key ← mkCongrKey e
+  if let some e' := (← get).congrTable.find? key then
+    if isSameExpr e e' then
+      modify fun s => { s with congrTable := s.congrTable.erase key }
+
+/--
+Creates an `ENode` for `e` if one does not already exist.
+This method assumes `e` has been hashconsed.
+If `e` is an application, it is registered as a parent of the classes of its function and arguments
+and inserted into the congruence table.
+-/
+def mkENode (e : Expr) (generation : Nat := 0) : GoalM Unit := do
+  if (← getENode? e).isSome then return ()
+  let ctor := (← isConstructorAppCore? e).isSome
+  let interpreted ← isInterpreted e
+  mkENodeCore e interpreted ctor generation
+  if e.isApp then
+    let children := e.getAppArgs.push e.getAppFn
+    for child in children do
+      let root ← getRoot child
+      setParents root (e :: (← getParents root))
+    addCongrTable e
+
 /--
 The fields `target?` and `proof?` in `e`'s `ENode` are encoding a transitivity proof
 from `e` to the root of the equivalence class
@@ -112,10 +146,14 @@ where
       proof?  := proof
       flipped
     }
-    -- TODO: Remove parents from congruence table
+    -- The keys of the parents of `lhs`'s class change, so we remove them before updating the roots
+    let parents ← takeParents lhsNode.root
+    for parent in parents do
+      removeCongrTable parent
     -- TODO: set propagateBool
     updateRoots lhs rhsNode.root true -- TODO
-    -- TODO: Reinsert parents into congruence table
+    for parent in parents do
+      addCongrTable parent
     setENode lhsNode.root { lhsRoot with
       next := rhsRoot.next
     }
@@ -125,7 +163,7 @@ where
       hasLambdas := rhsRoot.hasLambdas || lhsRoot.hasLambdas
       heqProofs  := isHEq || rhsRoot.heqProofs || lhsRoot.heqProofs
     }
-    -- TODO: copy parentst from lhsRoot parents to rhsRoot parents
+    setParents rhsNode.root (parents ++ (← getParents rhsNode.root))
 
   updateRoots (lhs : Expr) (rootNew : Expr) (_propagateBool : Bool) : GoalM Unit := do
     let rec loop (e : Expr) : GoalM Unit := do
@@ -145,6 +183,7 @@ where
       modify fun s => { s with newEqs := #[] }
       return ()
     let some { lhs, rhs, proof, isHEq } := (← get).newEqs.back? | return ()
+    modify fun s => { s with newEqs := s.newEqs.pop }
     addEqStep lhs rhs proof isHEq
     processTodo
 
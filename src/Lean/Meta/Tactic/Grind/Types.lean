@@ -89,6 +89,33 @@ structure ENode where
   mt : Nat := 0
   -- TODO: see Lean 3 implementation
 
+/--
+Key of an application `f a₁ ... aₙ` in the congruence table: the roots of the equivalence classes of
+`f` and of each `aᵢ`. Two applications are congruent iff they have the same key. Keys are
+computed when the application is inserted, and the applications whose arguments are in a class that
+is being merged are removed from the table before the merge and reinserted afterwards.
+-/
+structure CongrKey where
+  fn   : Expr
+  args : Array Expr
+
+instance : Hashable CongrKey where
+  hash k := k.args.foldl (init := hash k.fn) fun h a => mixHash h (hash a)
+
+instance : BEq CongrKey where
+  -- It is safe to use pointer equality because roots are hashconsed
+  beq k₁ k₂ := unsafe ptrEq k₁.fn k₂.fn && k₁.args.size == k₂.args.size &&
+    k₁.args.size.all fun i => ptrEq k₁.args[i]! k₂.args[i]!
+
+/--
+Placeholder for the proof of an equality `f a₁ ... aₙ = g b₁ ... bₙ` discovered by congruence closure.
+The actual proof is constructed from the equalities between the arguments when needed.
+-/
+def congrPlaceholderProof := mkConst (Name.mkSimple "[congruence]")
+
+/-- Applications that have an argument (or function) in an equivalence class, stored at its root. -/
+abbrev ParentSet := List Expr
+
 structure Clause where
   expr  : Expr
   proof : Expr
@@ -107,6 +134,10 @@ structure Goal where
   mvarId       : MVarId
   clauses      : PArray Clause := {}
   enodes       : PHashMap USize ENode := {}
+  /-- Congruence table, mapping the `CongrKey` of each internalized application to its congruence root. -/
+  congrTable   : PHashMap CongrKey Expr := {}
+  /-- Parents of each equivalence class, indexed by the address of its root. -/
+  parents      : PHashMap USize ParentSet := {}
   newEqs       : Array NewEq := #[]
   /-- `inconsistent := true` if `ENode`s for `True` and `False` are in the same equivalence class. -/
   inconsistent : Bool := false
@@ -135,6 +166,19 @@ def getENode? (e : Expr) : GoalM (Option ENode) :=
 def setENode (e : Expr) (n : ENode) : GoalM Unit :=
   modify fun s => { s with enodes := s.enodes.insert (unsafe ptrAddrUnsafe e) n }
 
+/-- Returns the parents of the equivalence class whose root is `root`. -/
+def getParents (root : Expr) : GoalM ParentSet :=
+  return (← get).parents.find? (unsafe ptrAddrUnsafe root) |>.getD []
+
+def setParents (root : Expr) (parents : ParentSet) : GoalM Unit :=
+  modify fun s => { s with parents := s.parents.insert (unsafe ptrAddrUnsafe root) parents }
+
+/-- Removes and returns the parents of the equivalence class whose root is `root`. -/
+def takeParents (root : Expr) : GoalM ParentSet := do
+  let parents ← getParents root
+  modify fun s => { s with parents := s.parents.erase (unsafe ptrAddrUnsafe root) }
+  return parents
+
 def mkENodeCore (e : Expr) (interpreted ctor : Bool) (generation : Nat) : GoalM Unit := do
   setENode e {
     next := e, root := e, cgRoot := e, size := 1
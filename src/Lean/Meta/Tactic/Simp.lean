@@ -26,6 +26,7 @@ builtin_initialize registerTraceClass `Meta.Tactic.simp.unify (inherited := true
 builtin_initialize registerTraceClass `Meta.Tactic.simp.ground (inherited := true)
 builtin_initialize registerTraceClass `Meta.Tactic.simp.numSteps
 builtin_initialize registerTraceClass `Meta.Tactic.simp.heads
+builtin_initialize registerTraceClass `Meta.Tactic.simp.crossCache
 builtin_initialize registerTraceClass `Debug.Meta.Tactic.simp
 builtin_initialize registerTraceClass `Debug.Meta.Tactic.simp.congr (inherited := true)
 
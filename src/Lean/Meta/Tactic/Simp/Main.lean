@@ -654,7 +654,12 @@ where
     if cfg.memoize then
       let cache := (← get).cache
       if let some result := cache.find? e then
+        CacheStat.simp.recordHit
         return result
+      CacheStat.simp.recordMiss visit
+    else
+      visit
+  visit : SimpM Result := do
     trace[Meta.Tactic.simp.heads] "{repr e.toHeadIndex}"
     simpLoop e
 
@@ -693,13 +698,99 @@ where
         else
           throw ex
 
+register_builtin_option simp.crossCache : Bool := {
+  defValue := false
+  descr    := "(simp) reuse the results of `simp` calls on terms without free variables and metavariables \
+    within a declaration, for the same simp set and configuration"
+}
+
+/-- Key of `CrossCache`: a fingerprint of the simp set, the configuration, and the simplified term. -/
+structure CrossCacheKey where
+  fingerprint : UInt64
+  config      : Config
+  expr        : Expr
+
+instance : BEq CrossCacheKey where
+  beq a b := a.fingerprint == b.fingerprint && a.expr == b.expr && a.config == b.config
+
+instance : Hashable CrossCacheKey where
+  hash k := mixHash k.fingerprint (hash k.expr)
+
+/-- Results of `simp` calls reused across invocations when `simp.crossCache` is set. -/
+structure CrossCache where
+  /--
+  The constants of the environment the cache was created in. The cache is reset when a declaration
+  is added, which also happens when changing attributes such as `reducible` would invalidate it.
+  -/
+  constants    : ConstMap := {}
+  /-- The results, with the theorems used to obtain them. -/
+  map          : Std.HashMap CrossCacheKey (Result × Array Origin) := {}
+  /-- Fingerprints of the simp sets seen, which keep them alive so that their addresses are unique. -/
+  fingerprints : Array (SimpTheorems × UInt64) := #[]
+  hits         : Nat := 0
+  misses       : Nat := 0
+  deriving Inhabited
+
+builtin_initialize crossCacheExt : EnvExtension CrossCache ← registerEnvExtension (pure {})
+
+/-- Hash of a set that does not depend on its iteration order. -/
+private def sumHash [BEq α] [Hashable α] (s : PHashSet α) : UInt64 :=
+  s.fold (init := 0) fun h a => h + hash a
+
+private def fingerprintSimpTheorems (d : SimpTheorems) : UInt64 :=
+  let h := mixHash (mixHash (sumHash d.lemmaNames) (sumHash d.erased)) (sumHash d.toUnfold)
+  d.toUnfoldThms.foldl (init := h) fun h n thms => h + mixHash (hash n) (hash thms)
+
+private def fingerprintSimprocs (s : Simprocs) : UInt64 :=
+  mixHash (sumHash s.simprocNames) (sumHash s.erased)
+
+/--
+Runs `k`, which simplifies `e` with `ctx` and `simprocs`, through the cache of `simp.crossCache`.
+Only results without free variables and metavariables are cached, so that they do not depend on the
+local context; in particular no local hypothesis can have been used.
+-/
+def withCrossCache (e : Expr) (ctx : Context) (simprocs : SimprocsArray) (stats : Stats)
+    (k : MetaM (Result × Stats)) : MetaM (Result × Stats) := do
+  if !simp.crossCache.get (← getOptions) || e.hasFVar || e.hasMVar then
+    return (← k)
+  let env ← getEnv
+  let mut cache := crossCacheExt.getState env
+  unless (unsafe ptrEq cache.constants env.constants) do
+    cache := { constants := env.constants, hits := cache.hits, misses := cache.misses }
+  let mut fingerprint : UInt64 := 7
+  for thms in ctx.simpTheorems do
+    if let some (_, h) := cache.fingerprints.find? (unsafe ptrEq ·.1 thms) then
+      fingerprint := mixHash fingerprint h
+    else
+      let h := fingerprintSimpTheorems thms
+      cache := { cache with fingerprints := cache.fingerprints.push (thms, h) }
+      fingerprint := mixHash fingerprint h
+  for s in simprocs do
+    fingerprint := mixHash fingerprint (fingerprintSimprocs s)
+  let key := { fingerprint, config := ctx.config, expr := e : CrossCacheKey }
+  if let some (r, used) := cache.map[key]? then
+    cache := { cache with hits := cache.hits + 1 }
+    modifyEnv (crossCacheExt.setState · cache)
+    trace[Meta.Tactic.simp.crossCache] "hit, {cache.hits} hits and {cache.misses} misses so far"
+    return (r, { stats with usedTheorems := used.foldl (·.insert ·) stats.usedTheorems })
+  let (r, stats') ← k
+  cache := { cache with misses := cache.misses + 1 }
+  if !r.expr.hasFVar && !r.expr.hasMVar && r.proof?.all (fun p => !p.hasFVar && !p.hasMVar) then
+    let used := stats'.usedTheorems.toArray.filter (!stats.usedTheorems.map.contains ·)
+    cache := { cache with map := cache.map.insert key (r, used) }
+  modifyEnv (crossCacheExt.setState · cache)
+  trace[Meta.Tactic.simp.crossCache] "miss, {cache.hits} hits and {cache.misses} misses so far"
+  return (r, stats')
+
 end Simp
 open Simp (SimprocsArray Stats)
 
 def simp (e : Expr) (ctx : Simp.Context) (simprocs : SimprocsArray := #[]) (discharge? : Option Simp.Discharge := none)
     (stats : Stats := {}) : MetaM (Simp.Result × Stats) := do profileitM Exception "simp" (← getOptions) do
   match discharge? with
-  | none   => Simp.main e ctx stats (methods := Simp.mkDefaultMethodsCore simprocs)
+  | none   =>
+    Simp.withCrossCache e ctx simprocs stats do
+      Simp.main e ctx stats (methods := Simp.mkDefaultMethodsCore simprocs)
   | some d => Simp.main e ctx stats (methods := Simp.mkMethods simprocs d (wellBehavedDischarge := false))
 
 def dsimp (e : Expr) (ctx : Simp.Context) (simprocs : SimprocsArray := #[])
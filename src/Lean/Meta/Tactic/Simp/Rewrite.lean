@@ -158,7 +158,7 @@ private def tryTheoremCore (lhs : Expr) (xs : Array Expr) (bis : Array BinderInf
     extraArgs := extraArgs.push e.appArg!
     e := e.appFn!
   extraArgs := extraArgs.reverse
-  match (← go e) with
+  match (← CacheStat.simpRewrite.time (·.isSome) (go e)) with
   | none => return none
   | some r =>
     if (← hasAssignableMVar r.expr) then
@@ -239,6 +239,10 @@ where
   updateLemmaNames (s : PHashSet Origin) : PHashSet Origin :=
     s.insert e.origin
 
+/-- Compacts the discrimination trees of `d`, see `DiscrTree.compact`. -/
+def SimpTheorems.compact (d : SimpTheorems) : SimpTheorems :=
+  { d with pre := d.pre.compact, post := d.post.compact }
+
 def SimpTheorems.addDeclToUnfoldCore (d : SimpTheorems) (declName : Name) : SimpTheorems :=
   { d with toUnfold := d.toUnfold.insert declName }
 
@@ -409,6 +413,24 @@ def addSimpTheorem (ext : SimpExtension) (declName : Name) (post : Bool) (inv :
   for simpThm in simpThms do
     ext.add (SimpEntry.thm simpThm) attrKind
 
+/--
+Adds the entries of all imported modules, building the discrimination trees in parallel.
+Equivalent to adding them in order with `addSimpTheoremEntry` and friends, as erasing a theorem
+does not modify the trees.
+-/
+def addImportedSimpEntries (d : SimpTheorems) (es : Array (Array SimpEntry)) : SimpTheorems :=
+  let d := es.foldl (init := d) fun d es => es.foldl (init := d) fun d e =>
+    match e with
+    | .thm e =>
+      let d := eraseFwdIfBwd d e
+      { d with lemmaNames := d.lemmaNames.insert e.origin }
+    | .toUnfold n => d.addDeclToUnfoldCore n
+    | .toUnfoldThms n thms => d.registerDeclToUnfoldThms n thms
+  let thms (post : Bool) := es.map (·.filterMap fun
+    | .thm e => if e.post == post then some (e.keys, e) else none
+    | _      => none)
+  { d with pre := d.pre.insertParallel (thms false), post := d.post.insertParallel (thms true) }
+
 def mkSimpExt (name : Name := by exact decl_name%) : IO SimpExtension :=
   registerSimpleScopedEnvExtension {
     name     := name
@@ -418,6 +440,8 @@ def mkSimpExt (name : Name := by exact decl_name%) : IO SimpExtension :=
       | .thm e => addSimpTheoremEntry d e
       | .toUnfold n => d.addDeclToUnfoldCore n
       | .toUnfoldThms n thms => d.registerDeclToUnfoldThms n thms
+    finalizeImport := SimpTheorems.compact
+    addImportedEntries? := some addImportedSimpEntries
   }
 
 abbrev SimpExtensionMap := Std.HashMap Name SimpExtension
@@ -42,6 +42,13 @@ register_builtin_option smartUnfolding : Bool := {
   descr := "when computing weak head normal form, use auxiliary definition created for functions defined by structural recursion"
 }
 
+register_builtin_option whnf.kernel : Bool := {
+  defValue := false
+  descr := "when computing weak head normal form with transparency `all` of a term without free variables and \
+    metavariables, use the kernel, which shares its cache of closed terms between declarations. \
+    The kernel cannot be interrupted and does not use smart unfolding"
+}
+
 /-- Add auxiliary annotation to indicate the `match`-expression `e` must be reduced when performing smart unfolding. -/
 def markSmartUnfoldingMatch (e : Expr) : Expr :=
   mkAnnotation `sunfoldMatch e
@@ -936,6 +943,8 @@ def reduceNat? (e : Expr) : MetaM (Option Expr) :=
   | .app (.const fn _) a =>
     if fn == ``Nat.succ then
       reduceUnaryNatOp Nat.succ a
+    else if fn == ``Nat.log2 then
+      reduceUnaryNatOp Nat.log2 a
     else
       return none
   | .app (.app (.const fn _) a1) a2 =>
@@ -987,15 +996,31 @@ private def cache (useCache : Bool) (e r : Expr) : MetaM Expr := do
     | _        => unreachable!
   return r
 
+/--
+Computes the weak head normal form of `e` with the kernel if `whnf.kernel` is set. The kernel
+unfolds all definitions but opaque ones, which matches only transparency `all`. We use it only for
+terms we would cache, i.e., without free variables, metavariables and `canUnfold?` restrictions.
+-/
+private def kernelWhnf? (useCache : Bool) (e : Expr) : MetaM (Option Expr) := do
+  unless useCache && (← getConfig).transparency == .all && !e.hasMVar && whnf.kernel.get (← getOptions) do
+    return none
+  match Kernel.whnf (← getEnv) {} e with
+  | .ok v    => return some v
+  | .error _ => return none
+
 @[export lean_whnf]
 partial def whnfImp (e : Expr) : MetaM Expr :=
   withIncRecDepth <| whnfEasyCases e fun e => do
     let useCache ← useWHNFCache e
     match (← cached? useCache e) with
-    | some e' => pure e'
+    | some e' =>
+      CacheStat.whnf.recordHit
+      pure e'
     | none    =>
-      withTraceNode `Meta.whnf (fun _ => return m!"Non-easy whnf: {e}") do
+      let reduce := withTraceNode `Meta.whnf (fun _ => return m!"Non-easy whnf: {e}") do
         checkSystem "whnf"
+        if let some v ← kernelWhnf? useCache e then
+          return (← cache useCache e v)
         let e' ← whnfCore e
         match (← reduceNat? e') with
         | some v => cache useCache e v
@@ -1006,6 +1031,7 @@ partial def whnfImp (e : Expr) : MetaM Expr :=
             match (← unfoldDefinition? e') with
             | some e'' => cache useCache e (← whnfImp e'')
             | none => cache useCache e e'
+      if useCache then CacheStat.whnf.recordMiss reduce else reduce
 
 /-- If `e` is a projection function that satisfies `p`, then reduce it -/
 def reduceProjOf? (e : Expr) (p : Name → Bool) : MetaM (Option Expr) := do
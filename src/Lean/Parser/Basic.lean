@@ -549,6 +549,14 @@ partial def finishCommentBlock (nesting : Nat) : ParserFn := fun c s =>
 where
   eoi s := s.mkUnexpectedError (pushMissing := pushMissingOnError) "unterminated comment"
 
+/-- Returns the position after the run of spaces and newlines starting at byte `i`. -/
+private partial def skipSpacesAndNewlines (input : String) (i : Nat) : Nat :=
+  if h : i < input.utf8ByteSize then
+    let b := input.getUtf8Byte i h
+    if b == 32 /- ' ' -/ || b == 10 /- '\n' -/ then skipSpacesAndNewlines input (i + 1) else i
+  else
+    i
+
 /-- Consume whitespace and comments -/
 partial def whitespace : ParserFn := fun c s =>
   let input := c.input
@@ -560,6 +568,9 @@ partial def whitespace : ParserFn := fun c s =>
       s.mkUnexpectedError (pushMissing := false) "tabs are not allowed; please configure your editor to expand them"
     else if curr == '\r' then
       s.mkUnexpectedError (pushMissing := false) "isolated carriage returns are not allowed"
+    else if curr == ' ' || curr == '\n' then
+      -- skip the common run of indentation bytewise instead of decoding each character
+      whitespace c (s.setPos ⟨skipSpacesAndNewlines input (i.byteIdx + 1)⟩)
     else if curr.isWhitespace then whitespace c (s.next' input i h)
     else if curr == '-' then
       let i    := input.next' i h
@@ -930,6 +941,7 @@ def mkIdResult (startPos : String.Pos) (tk : Option Token) (val : Name) : Parser
     let leading         := mkEmptySubstringAt input startPos
     let trailing        := { str := input, startPos := stopPos, stopPos := trailingStopPos : Substring }
     let info            := SourceInfo.original leading startPos trailing stopPos
+    let (val, s)        := s.internIdent val
     let atom            := mkIdent info rawVal val
     s.pushSyntax atom
 
@@ -1006,11 +1018,11 @@ private def tokenFnAux : ParserFn := fun c s =>
 private def updateTokenCache (startPos : String.Pos) (s : ParserState) : ParserState :=
   -- do not cache token parsing errors, which are rare and usually fatal and thus not worth an extra field in `TokenCache`
   match s with
-  | ⟨stack, lhsPrec, pos, ⟨_, catCache⟩, none, errs⟩ =>
+  | ⟨stack, lhsPrec, pos, ⟨_, catCache, identCache⟩, none, errs⟩ =>
     if stack.size == 0 then s
     else
       let tk := stack.back
-      ⟨stack, lhsPrec, pos, ⟨{ startPos := startPos, stopPos := pos, token := tk }, catCache⟩, none, errs⟩
+      ⟨stack, lhsPrec, pos, ⟨{ startPos := startPos, stopPos := pos, token := tk }, catCache, identCache⟩, none, errs⟩
   | other => other
 
 def tokenFn (expected : List String := []) : ParserFn := fun c s =>
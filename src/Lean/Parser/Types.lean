@@ -133,10 +133,16 @@ structure ParserCacheEntry where
 structure ParserCache where
   tokenCache  : TokenCacheEntry
   parserCache : Std.HashMap ParserCacheKey ParserCacheEntry
+  /--
+  Identifiers parsed so far. Occurrences of the same identifier share the `Name` object of the
+  first one, which reduces the memory held by the syntax trees of large commands.
+  -/
+  identCache  : Std.HashMap Name Name
 
 def initCacheForInput (input : String) : ParserCache where
   tokenCache  := { startPos := input.endPos + ' ' /- make sure it is not a valid position -/ }
   parserCache := {}
+  identCache  := {}
 
 /-- A syntax array with an inaccessible prefix, used for sound caching. -/
 structure SyntaxStack where
@@ -220,6 +226,12 @@ def setPos (s : ParserState) (pos : String.Pos) : ParserState :=
 def setCache (s : ParserState) (cache : ParserCache) : ParserState :=
   { s with cache := cache }
 
+/-- Returns the `Name` object of a previous occurrence of the identifier `n`, if any. -/
+def internIdent (s : ParserState) (n : Name) : Name × ParserState :=
+  match s.cache.identCache[n]? with
+  | some n' => (n', s)
+  | none    => (n, { s with cache.identCache := s.cache.identCache.insert n n })
+
 def pushSyntax (s : ParserState) (n : Syntax) : ParserState :=
   { s with stxStack := s.stxStack.push n }
 
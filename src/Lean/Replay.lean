@@ -22,6 +22,9 @@ after replaying any inductive definitions occurring in `constantMap`.
 * a verifier for an `Environment`, by sending everything to the kernel, or
 * a mechanism to safely transfer constants from one `Environment` to another.
 
+With `parallel := true`, theorems are checked in separate tasks, see `Replay.addDeclDeferred`.
+With `timed := true`, `replayCore` also returns the time the kernel took for each declaration.
+
 -/
 
 namespace Lean.Environment
@@ -30,6 +33,14 @@ namespace Replay
 
 structure Context where
   newConstants : Std.HashMap Name ConstantInfo
+  parallel : Bool := false
+  /-- Record the time spent in the kernel on each declaration checked by `addDecl`. -/
+  timed : Bool := false
+
+/-- Time spent in the kernel on checking a declaration. -/
+structure DeclTime where
+  decl  : Declaration
+  nanos : Nat
 
 structure State where
   env : Environment
@@ -37,6 +48,10 @@ structure State where
   pending : NameSet := {}
   postponedConstructors : NameSet := {}
   postponedRecursors : NameSet := {}
+  /-- Checks of declarations added by `addDeclDeferred`, in order. -/
+  deferred : Array (Task (Option KernelException)) := #[]
+  /-- Declarations checked by `addDecl` and their checking times, if `Context.timed` is set. -/
+  times : Array DeclTime := #[]
 
 abbrev M := ReaderT Context <| StateRefT State IO
 
@@ -57,8 +72,28 @@ def throwKernelException (ex : KernelException) : M Unit := do
 
 /-- Add a declaration, possibly throwing a `KernelException`. -/
 def addDecl (d : Declaration) : M Unit := do
+  let timed := (← read).timed
+  let startTime ← if timed then IO.monoNanosNow else pure 0
   match (← get).env.addDecl {} d with
-  | .ok env => modify fun s => { s with env := env }
+  | .ok env =>
+    modify fun s => { s with env := env }
+    if timed then
+      let nanos := (← IO.monoNanosNow) - startTime
+      modify fun s => { s with times := s.times.push { decl := d, nanos } }
+  | .error ex => throwKernelException ex
+
+/--
+Add a declaration without checking it, and check it against the current environment in a separate task instead.
+Declarations added later can thus be checked at the same time. The result is only known after
+`checkDeferred`, which must be called before using the environment. -/
+def addDeclDeferred (d : Declaration) : M Unit := do
+  let env := (← get).env
+  let check := Task.spawn fun _ =>
+    match env.addDecl {} d with
+    | .ok _ => none
+    | .error ex => some ex
+  match addDeclWithoutChecking env d with
+  | .ok env => modify fun s => { s with env, deferred := s.deferred.push check }
   | .error ex => throwKernelException ex
 
 mutual
@@ -81,7 +116,12 @@ partial def replayConstant (name : Name) : M Unit := do
       | .defnInfo   info =>
         addDecl (Declaration.defnDecl   info)
       | .thmInfo    info =>
-        addDecl (Declaration.thmDecl    info)
+        -- theorems make up most of the checking time, and their proofs are usually irrelevant for later
+        -- declarations
+        if (← read).parallel then
+          addDeclDeferred (Declaration.thmDecl info)
+        else
+          addDecl (Declaration.thmDecl info)
       | .axiomInfo  info =>
         addDecl (Declaration.axiomDecl  info)
       | .opaqueInfo info =>
@@ -145,17 +185,22 @@ def checkPostponedRecursors : M Unit := do
       if ! (info == info') then throw <| IO.userError s!"Invalid recursor {ctor}"
     | _, _ => throw <| IO.userError s!"No such recursor {ctor}"
 
+/-- Wait for the checks started by `addDeclDeferred` and throw the first error, in order of the declarations. -/
+def checkDeferred : M Unit := do
+  for check in (← get).deferred do
+    if let some ex := check.get then
+      throwKernelException ex
+
 end Replay
 
 open Replay
 
 /--
-"Replay" some constants into an `Environment`, sending them to the kernel for checking.
-
-Throws a `IO.userError` if the kernel rejects a constant,
-or if there are malformed recursors or constructors for inductive types.
+Like `replay`, but returns the final `Replay.State`, which also contains the checking times of
+the declarations if `timed` is true.
 -/
-def replay (newConstants : Std.HashMap Name ConstantInfo) (env : Environment) : IO Environment := do
+def replayCore (newConstants : Std.HashMap Name ConstantInfo) (env : Environment) (parallel := false)
+    (timed := false) : IO Replay.State := do
   let mut remaining : NameSet := ∅
   for (n, ci) in newConstants.toList do
     -- We skip unsafe constants, and also partial constants.
@@ -163,9 +208,22 @@ def replay (newConstants : Std.HashMap Name ConstantInfo) (env : Environment) :
     if !ci.isUnsafe && !ci.isPartial then
       remaining := remaining.insert n
   let (_, s) ← StateRefT'.run (s := { env, remaining }) do
-    ReaderT.run (r := { newConstants }) do
+    ReaderT.run (r := { newConstants, parallel, timed }) do
       for n in remaining do
         replayConstant n
+      checkDeferred
       checkPostponedConstructors
       checkPostponedRecursors
-  return s.env
+  return s
+
+/--
+"Replay" some constants into an `Environment`, sending them to the kernel for checking.
+
+Throws a `IO.userError` if the kernel rejects a constant,
+or if there are malformed recursors or constructors for inductive types.
+
+If `parallel` is true, theorems are checked in parallel to each other and to the remaining declarations.
+-/
+def replay (newConstants : Std.HashMap Name ConstantInfo) (env : Environment) (parallel := false) :
+    IO Environment := do
+  return (← replayCore newConstants env parallel).env
@@ -37,6 +37,12 @@ structure Descr (α : Type) (β : Type) (σ : Type) where
   toOLeanEntry   : β → α
   addEntry       : σ → β → σ
   finalizeImport : σ → σ := id
+  /--
+  If set, adds the global entries of all imported modules at once instead of through `addEntry`,
+  e.g. to index them in parallel. It receives the entries of each module in import order, and
+  `ofOLeanEntry` is then called with the initial state.
+  -/
+  addImportedEntries? : Option (σ → Array (Array β) → σ) := none
 
 instance [Inhabited α] : Inhabited (Descr α β σ) where
   default := {
@@ -58,15 +64,24 @@ def ScopedEntries.insert (scopedEntries : ScopedEntries β) (ns : Name) (b : β)
 def addImportedFn (descr : Descr α β σ) (as : Array (Array (Entry α))) : ImportM (StateStack α β σ) := do
   let mut s ← descr.mkInitial
   let mut scopedEntries : ScopedEntries β := {}
+  let mut imported := #[]
   for a in as do
+    let mut globals := #[]
     for e in a do
       match e with
       | Entry.global a =>
         let b ← descr.ofOLeanEntry s a
-        s := descr.addEntry s b
+        if descr.addImportedEntries?.isSome then
+          globals := globals.push b
+        else
+          s := descr.addEntry s b
       | Entry.scoped ns a =>
         let b ← descr.ofOLeanEntry s a
         scopedEntries := scopedEntries.insert ns b
+    unless globals.isEmpty do
+      imported := imported.push globals
+  if let some addImportedEntries := descr.addImportedEntries? then
+    s := addImportedEntries s imported
   s := descr.finalizeImport s
   return { stateStack := [ { state := s } ], scopedEntries := scopedEntries }
 
@@ -206,6 +221,7 @@ structure SimpleScopedEnvExtension.Descr (α : Type) (σ : Type) where
   addEntry       : σ → α → σ
   initial        : σ
   finalizeImport : σ → σ := id
+  addImportedEntries? : Option (σ → Array (Array α) → σ) := none
 
 def registerSimpleScopedEnvExtension (descr : SimpleScopedEnvExtension.Descr α σ) : IO (SimpleScopedEnvExtension α σ) := do
   registerScopedEnvExtension {
@@ -215,6 +231,7 @@ def registerSimpleScopedEnvExtension (descr : SimpleScopedEnvExtension.Descr α
     toOLeanEntry   := id
     ofOLeanEntry   := fun _ a => return a
     finalizeImport := descr.finalizeImport
+    addImportedEntries? := descr.addImportedEntries?
   }
 
 end Lean
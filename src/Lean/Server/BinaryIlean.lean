@@ -0,0 +1,264 @@
+/-
+Copyright (c) 2024 Lean FRO, LLC. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+-/
+prelude
+import Lean.Data.Lsp.Internal
+
+/-!
+# Binary `.ilean` format
+
+A compact alternative to the JSON `.ilean` format that the language server maps into memory and
+queries lazily instead of decoding it in full at startup. All numbers are little-endian 32-bit
+unsigned integers, strings are stored as offset and length into the string table, and indices
+`0xFFFFFFFF` denote absent entries.
+
+* Header (40 bytes): the magic bytes `ILEANBIN`, the format version, the number of identifiers, the
+  file offsets of the identifier, location, parent declaration and string tables, and the module name.
+* Identifier table, sorted by kind (`const` before `fvar`), module name and name (32 bytes each):
+  kind, module name, name, index of the definition location, index of the first usage location and
+  number of usage locations. The usage locations of an identifier are consecutive.
+* Location table (20 bytes each): range and index of the parent declaration.
+* Parent declaration table (40 bytes each): name, range and selection range.
+* String table: UTF-8 bytes of all distinct strings.
+
+Looking up an identifier is a binary search over the identifier table, which only touches the
+pages of the file that are needed.
+-/
+
+namespace Lean.Server
+open Lsp
+
+/-- A memory-mapped binary `.ilean` file, see `BinaryIlean.load?`. -/
+structure BinaryIlean where
+  /-- The mapped file. -/
+  file       : IO.FS.MappedFile
+  /-- Name of the module that the references have been collected for. -/
+  module     : Name
+  /-- Number of entries of the identifier table. -/
+  numIdents  : Nat
+  /-- File offset of the identifier table. -/
+  identsOff  : Nat
+  /-- File offset of the location table. -/
+  locsOff    : Nat
+  /-- File offset of the parent declaration table. -/
+  parentsOff : Nat
+  /-- File offset of the string table. -/
+  stringsOff : Nat
+
+namespace BinaryIlean
+
+/-- Magic bytes at the start of a binary `.ilean` file. JSON `.ilean` files start with `{`. -/
+def magic : ByteArray := "ILEANBIN".toUTF8
+
+/-- Version of the binary format. -/
+def version : UInt32 := 1
+
+/-- Size of the header in bytes. -/
+def headerSize : Nat := 40
+/-- Size of an entry of the identifier table in bytes. -/
+def identSize : Nat := 32
+/-- Size of an entry of the location table in bytes. -/
+def locationSize : Nat := 20
+/-- Size of an entry of the parent declaration table in bytes. -/
+def parentSize : Nat := 40
+
+/-- Index denoting an absent definition location or parent declaration. -/
+def noIndex : UInt32 := 0xFFFFFFFF
+
+/-! ## Encoding -/
+
+private def pushUInt32 (bs : ByteArray) (v : UInt32) : ByteArray :=
+  bs.push v.toUInt8 |>.push (v >>> 8).toUInt8 |>.push (v >>> 16).toUInt8 |>.push (v >>> 24).toUInt8
+
+private def pushNat (bs : ByteArray) (n : Nat) : ByteArray :=
+  pushUInt32 bs n.toUInt32
+
+private def pushRange (bs : ByteArray) (r : Lsp.Range) : ByteArray :=
+  pushNat (pushNat (pushNat (pushNat bs r.start.line) r.start.character) r.end.line) r.end.character
+
+/-- The kind, module name and name of `ident`, in the order of the identifier table. -/
+private def identKey : RefIdent → Nat × String × String
+  | .const m n => (0, m, n)
+  | .fvar m i  => (1, m, i)
+
+/-- The order of the identifier table. -/
+private def identLt (a b : RefIdent) : Bool :=
+  let (k₁, m₁, n₁) := identKey a
+  let (k₂, m₂, n₂) := identKey b
+  k₁ < k₂ || k₁ == k₂ && (m₁ < m₂ || m₁ == m₂ && n₁ < n₂)
+
+/-- The location, parent declaration and string tables while they are being encoded. -/
+private structure Encoder where
+  locations    : ByteArray := .empty
+  numLocations : Nat := 0
+  parents      : ByteArray := .empty
+  parentIdx    : Std.HashMap (String × Lsp.Range × Lsp.Range) Nat := {}
+  strings      : ByteArray := .empty
+  stringIdx    : Std.HashMap String (Nat × Nat) := {}
+
+/-- Adds `s` to the string table if it is not there yet, and returns its offset and length. -/
+private def Encoder.string (e : Encoder) (s : String) : Encoder × Nat × Nat :=
+  match e.stringIdx[s]? with
+  | some r => (e, r)
+  | none =>
+    let bytes := s.toUTF8
+    let r := (e.strings.size, bytes.size)
+    ({ e with strings := e.strings ++ bytes, stringIdx := e.stringIdx.insert s r }, r)
+
+/-- Adds `d` to the parent declaration table if it is not there yet, and returns its index. -/
+private def Encoder.parent (e : Encoder) (d : RefInfo.ParentDecl) : Encoder × Nat :=
+  let key := (d.name, d.range, d.selectionRange)
+  match e.parentIdx[key]? with
+  | some i => (e, i)
+  | none =>
+    let (e, off, len) := e.string d.name
+    let i := e.parentIdx.size
+    let parents := pushRange (pushRange (pushNat (pushNat e.parents off) len) d.range) d.selectionRange
+    ({ e with parents, parentIdx := e.parentIdx.insert key i }, i)
+
+/-- Appends `l` to the location table and returns its index. -/
+private def Encoder.location (e : Encoder) (l : RefInfo.Location) : Encoder × Nat :=
+  let (e, parent) := match l.parentDecl? with
+    | some d => let (e, i) := e.parent d; (e, i.toUInt32)
+    | none   => (e, noIndex)
+  let i := e.numLocations
+  ({ e with locations := pushUInt32 (pushRange e.locations l.range) parent, numLocations := i + 1 }, i)
+
+/-- Encodes the references `refs` of `module` in the binary `.ilean` format. -/
+def encode (module : Name) (refs : ModuleRefs) : ByteArray := Id.run do
+  let idents := refs.toArray.qsort fun (a, _) (b, _) => identLt a b
+  let mut e : Encoder := {}
+  let mut table := ByteArray.empty
+  for (ident, info) in idents do
+    let (kind, m, n) := identKey ident
+    let (e', mOff, mLen) := e.string m
+    let (e', nOff, nLen) := e'.string n
+    e := e'
+    let mut defLoc := noIndex
+    if let some d := info.definition? then
+      let (e', i) := e.location d
+      e := e'
+      defLoc := i.toUInt32
+    let usagesStart := e.numLocations
+    for u in info.usages do
+      e := (e.location u).1
+    table := [kind, mOff, mLen, nOff, nLen].foldl pushNat table
+    table := pushNat (pushNat (pushUInt32 table defLoc) usagesStart) info.usages.size
+  let (e, modOff, modLen) := e.string (module.toString (escape := false))
+  let identsOff  := headerSize
+  let locsOff    := identsOff + table.size
+  let parentsOff := locsOff + e.locations.size
+  let stringsOff := parentsOff + e.parents.size
+  let header := pushUInt32 magic version
+  let header := [idents.size, identsOff, locsOff, parentsOff, stringsOff, modOff, modLen].foldl pushNat header
+  return header ++ table ++ e.locations ++ e.parents ++ e.strings
+
+/-! ## Decoding -/
+
+@[inline] private def u32 (f : IO.FS.MappedFile) (off : Nat) : Nat :=
+  (f.getUInt32LE off).toNat
+
+private def readRange (f : IO.FS.MappedFile) (off : Nat) : Lsp.Range where
+  start := { line := u32 f off,       character := u32 f (off + 4) }
+  «end» := { line := u32 f (off + 8), character := u32 f (off + 12) }
+
+/-- The string at offset `off` of length `len` in the string table. -/
+def string (self : BinaryIlean) (off len : Nat) : String :=
+  let start := self.stringsOff + off
+  String.fromUTF8? (self.file.extract start (start + len)) |>.getD ""
+
+/--
+Maps the `.ilean` file at `path`. Returns `none` if it is not in the binary format, e.g. because it
+is a JSON `.ilean` file.
+-/
+def load? (path : System.FilePath) : IO (Option BinaryIlean) := do
+  let file ← IO.FS.MappedFile.mk path
+  if (file.extract 0 magic.size).data != magic.data then
+    return none
+  if file.size < headerSize || file.getUInt32LE magic.size != version then
+    throw <| .userError s!"unsupported binary .ilean version at {path}"
+  let ilean : BinaryIlean := {
+    file, module := .anonymous
+    numIdents := u32 file 12, identsOff := u32 file 16, locsOff := u32 file 20
+    parentsOff := u32 file 24, stringsOff := u32 file 28
+  }
+  return some { ilean with module := (ilean.string (u32 file 32) (u32 file 36)).toName }
+
+/-- The file offset of the `i`-th entry of the identifier table. -/
+@[inline] private def identOff (self : BinaryIlean) (i : Nat) : Nat :=
+  self.identsOff + i * identSize
+
+/-- The identifier of the `i`-th entry of the identifier table. -/
+def ident (self : BinaryIlean) (i : Nat) : RefIdent :=
+  let off := self.identOff i
+  let m := self.string (u32 self.file (off + 4)) (u32 self.file (off + 8))
+  let n := self.string (u32 self.file (off + 12)) (u32 self.file (off + 16))
+  if u32 self.file off == 0 then .const m n else .fvar m n
+
+/-- The `i`-th entry of the location table. -/
+def location (self : BinaryIlean) (i : Nat) : RefInfo.Location :=
+  let off := self.locsOff + i * locationSize
+  let parent := u32 self.file (off + 16)
+  let parentDecl? := if parent == noIndex.toNat then none else
+    let p := self.parentsOff + parent * parentSize
+    some {
+      name           := self.string (u32 self.file p) (u32 self.file (p + 4))
+      range          := readRange self.file (p + 8)
+      selectionRange := readRange self.file (p + 24)
+    }
+  { range := readRange self.file off, parentDecl? }
+
+/-- The definition and usages of the `i`-th entry of the identifier table. -/
+def refInfo (self : BinaryIlean) (i : Nat) : RefInfo :=
+  let off := self.identOff i
+  let defLoc := u32 self.file (off + 20)
+  let usagesStart := u32 self.file (off + 24)
+  let numUsages := u32 self.file (off + 28)
+  { definition? := if defLoc == noIndex.toNat then none else some (self.location defLoc)
+    usages := (Array.range numUsages).map fun j => self.location (usagesStart + j) }
+
+/-- Binary search for `ident` in the entries `[lo, hi)` of the identifier table. -/
+private partial def findIdent? (self : BinaryIlean) (ident : RefIdent) (lo hi : Nat) : Option Nat :=
+  if lo < hi then
+    let mid := (lo + hi) / 2
+    let ident' := self.ident mid
+    if identLt ident' ident then
+      findIdent? self ident (mid + 1) hi
+    else if identLt ident ident' then
+      findIdent? self ident lo mid
+    else
+      some mid
+  else
+    none
+
+/-- Looks up the definition and usages of `ident`. -/
+def get? (self : BinaryIlean) (ident : RefIdent) : Option RefInfo :=
+  self.findIdent? ident 0 self.numIdents |>.map self.refInfo
+
+/-- Decodes all references of the file. -/
+def toModuleRefs (self : BinaryIlean) : ModuleRefs :=
+  (Array.range self.numIdents).foldl (init := Std.HashMap.empty) fun refs i =>
+    refs.insert (self.ident i) (self.refInfo i)
+
+/--
+Folds `f` over the names and definition ranges of all `RefIdent.const` identifiers with a definition,
+without decoding their usages.
+-/
+@[specialize] def foldDefinitions (self : BinaryIlean) (f : σ → String → Lsp.Range → σ) (init : σ) : σ := Id.run do
+  let mut acc := init
+  for i in [0:self.numIdents] do
+    let off := self.identOff i
+    -- `const` identifiers come first
+    if u32 self.file off != 0 then
+      break
+    let defLoc := u32 self.file (off + 20)
+    if defLoc == noIndex.toNat then
+      continue
+    let name := self.string (u32 self.file (off + 12)) (u32 self.file (off + 16))
+    acc := f acc name (readRange self.file (self.locsOff + defLoc * locationSize))
+  return acc
+
+end BinaryIlean
+
+end Lean.Server
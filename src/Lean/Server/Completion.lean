@@ -107,6 +107,35 @@ def getEligibleHeaderDecls (env : Environment) : IO EligibleHeaderDecls := do
                 eligibleHeaderDecls
       (eligibleHeaderDecls, some eligibleHeaderDecls)
 
+/-- A declaration in the completion index, see `getHeaderCompletionIndex`. -/
+structure CompletionIndexEntry where
+  declName : Name
+  info     : ConstantInfo
+  /-- `charMask` of the last component of `declName`, which is what `matchDecl?` fuzzy matches. -/
+  mask     : UInt64
+
+private def declNameMask (declName : Name) : UInt64 :=
+  match declName with
+  | .str _ s => charMask s
+  | _        => 0
+
+/-- Cached completion index of the header declarations. -/
+builtin_initialize headerCompletionIndexRef : IO.Ref (Option (Array CompletionIndexEntry)) ←
+  IO.mkRef none
+
+/--
+Returns the declarations of `getEligibleHeaderDecls` together with their character masks, building
+the index once per environment.
+-/
+def getHeaderCompletionIndex (env : Environment) : IO (Array CompletionIndexEntry) := do
+  if let some index ← headerCompletionIndexRef.get then
+    return index
+  let eligibleHeaderDecls ← getEligibleHeaderDecls env
+  let index := eligibleHeaderDecls.fold (init := Array.mkEmpty eligibleHeaderDecls.size)
+    fun index declName info => index.push { declName, info, mask := declNameMask declName }
+  headerCompletionIndexRef.set index
+  return index
+
 /-- Iterate over all declarations that are allowed in completion results. -/
 private def forEligibleDeclsM [Monad m] [MonadEnv m] [MonadLiftT (ST IO.RealWorld) m]
     [MonadLiftT IO m] (f : Name → ConstantInfo → m PUnit) : m PUnit := do
@@ -239,14 +268,14 @@ private def matchAtomic (id : Name) (declName : Name) : Option Float :=
   | .str .anonymous s₁, .str .anonymous s₂ => fuzzyMatchScoreWithThreshold? s₁ s₂
   | _, _ => none
 
-private def normPrivateName? (declName : Name) : MetaM (Option Name) := do
+private def normPrivateName? (env : Environment) (declName : Name) : Option Name :=
   match privateToUserName? declName with
-  | none => return declName
+  | none => some declName
   | some userName =>
-    if mkPrivateName (← getEnv) userName == declName then
-      return userName
+    if mkPrivateName env userName == declName then
+      some userName
     else
-      return none
+      none
 
 /--
   Return the auto-completion label if `id` can be auto completed using `declName` assuming namespace `ns` is open.
@@ -254,8 +283,9 @@ private def normPrivateName? (declName : Name) : MetaM (Option Name) := do
 
   Remark: `danglingDot == true` when the completion point is an identifier followed by `.`.
 -/
-private def matchDecl? (ns : Name) (id : Name) (danglingDot : Bool) (declName : Name) : MetaM (Option (Name × Float)) := do
-  let some declName ← normPrivateName? declName
+private def matchDecl? (env : Environment) (ns : Name) (id : Name) (danglingDot : Bool) (declName : Name) :
+    Option (Name × Float) := Id.run do
+  let some declName := normPrivateName? env declName
     | return none
   if !ns.isPrefixOf declName then
     return none
@@ -277,6 +307,56 @@ private def matchDecl? (ns : Name) (id : Name) (danglingDot : Bool) (declName :
       return fuzzyMatchScoreWithThreshold? s₁ s₂ |>.map (declName, · / (p₂.getNumParts + 1).toFloat)
   return none
 
+/--
+  Return the best auto-completion label and score for `declName`, trying the current namespace of
+  `ctx`, its parents, and the namespaces opened in `ctx`.
+-/
+private def bestDeclMatch? (env : Environment) (ctx : ContextInfo) (id : Name) (danglingDot : Bool)
+    (declName : Name) : Option (Name × Float) := Id.run do
+  -- use current namespace
+  let mut best? := visitNamespaces ctx.currNamespace none
+  -- use open decls
+  for openDecl in ctx.openDecls do
+    let OpenDecl.simple ns exs := openDecl
+      | continue
+    if exs.contains declName then
+      continue
+    best? := improve best? ns
+  return improve best? Name.anonymous
+where
+  improve (best? : Option (Name × Float)) (ns : Name) : Option (Name × Float) :=
+    match matchDecl? env ns id danglingDot declName, best? with
+    | some (label, score), some (bestLabel, _) =>
+      -- for open namespaces `A` and `A.B` and a decl `A.B.c`, pick the decl `c` over `B.c`
+      if label.isSuffixOf bestLabel then some (label, score) else best?
+    | some m, none => some m
+    | none,   _    => best?
+  visitNamespaces (ns : Name) (best? : Option (Name × Float)) : Option (Name × Float) :=
+    match ns with
+    | .str p .. => visitNamespaces p (improve best? ns)
+    | _         => best?
+
+/--
+  Return the declarations allowed in completion results that match `id`, with their labels and
+  scores. Header declarations whose character mask rules out a fuzzy match are skipped, and the
+  remaining ones are scored in parallel on chunks of `index`.
+-/
+private def matchEligibleDecls (env : Environment) (index : Array CompletionIndexEntry)
+    (ctx : ContextInfo) (id : Name) (danglingDot : Bool) : Array (Name × ConstantInfo × Name × Float) :=
+  -- without a dangling dot, `matchDecl?` only matches by fuzzy matching the last component of `id`
+  let patternMask := match id with
+    | .str _ s => if danglingDot then 0 else charMask s
+    | _        => 0
+  let matchDecl (acc : Array (Name × ConstantInfo × Name × Float)) (declName : Name) (c : ConstantInfo) :=
+    match bestDeclMatch? env ctx id danglingDot declName with
+    | some (label, score) => acc.push (declName, c, label, score)
+    | none                => acc
+  let headerMatches := index.parFoldl (grain := 4096) (combine := (· ++ ·)) (init := #[]) fun acc e =>
+    if maskMayMatch patternMask e.mask then matchDecl acc e.declName e.info else acc
+  -- map₂ are exactly the local decls
+  env.constants.map₂.foldl (init := headerMatches) fun acc declName c =>
+    if Lean.Meta.allowCompletion env declName then matchDecl acc declName c else acc
+
 /--
   Truncate the given identifier and make sure it has length `≤ newLength`.
   This function assumes `id` does not contain `Name.num` constructors.
@@ -368,37 +448,8 @@ private def idCompletionCore
         addUnresolvedCompletionItem localDecl.userName (.fvar localDecl.fvarId) (kind := CompletionItemKind.variable) score
   -- search for matches in the environment
   let env ← getEnv
-  forEligibleDeclsM fun declName c => do
-    let bestMatch? ← (·.2) <$> StateT.run (s := none) do
-      let matchUsingNamespace (ns : Name) : StateT (Option (Name × Float)) M Unit := do
-        let some (label, score) ← matchDecl? ns id danglingDot declName
-          | return
-        modify fun
-          | none =>
-            some (label, score)
-          | some (bestLabel, bestScore) =>
-            -- for open namespaces `A` and `A.B` and a decl `A.B.c`, pick the decl `c` over `B.c`
-            if label.isSuffixOf bestLabel then
-              some (label, score)
-            else
-              some (bestLabel, bestScore)
-      let rec visitNamespaces (ns : Name) : StateT (Option (Name × Float)) M Unit := do
-        let Name.str p .. := ns
-          | return ()
-        matchUsingNamespace ns
-        visitNamespaces p
-      -- use current namespace
-      visitNamespaces ctx.currNamespace
-      -- use open decls
-      for openDecl in ctx.openDecls do
-        let OpenDecl.simple ns exs := openDecl
-          | pure ()
-        if exs.contains declName then
-          continue
-        matchUsingNamespace ns
-      matchUsingNamespace Name.anonymous
-    if let some (bestLabel, bestScore) := bestMatch? then
-      addUnresolvedCompletionItem bestLabel (.const declName) (← getCompletionKindForDecl c) bestScore
+  for (declName, c, label, score) in matchEligibleDecls env (← getHeaderCompletionIndex env) ctx id danglingDot do
+    addUnresolvedCompletionItem label (.const declName) (← getCompletionKindForDecl c) score
   -- Recall that aliases may not be atomic and include the namespace where they were created.
   let matchAlias (ns : Name) (alias : Name) : Option Float :=
     if ns.isPrefixOf alias then
@@ -565,7 +616,7 @@ private def dotCompletion
       let unnormedTypeName := declName.getPrefix
       if ! nameSet.contains unnormedTypeName then
         return
-      let some declName ← normPrivateName? declName
+      let some declName := normPrivateName? (← getEnv) declName
         | return
       let typeName := declName.getPrefix
       if ! (← isDotCompletionMethod typeName c) then
@@ -598,7 +649,7 @@ private def dotIdCompletion
       if ! nameSet.contains unnormedTypeName then
         return
 
-      let some declName ← normPrivateName? declName
+      let some declName := normPrivateName? (← getEnv) declName
         | return
 
       let typeName := declName.getPrefix
@@ -611,7 +662,7 @@ private def dotIdCompletion
         addUnresolvedCompletionItem (.mkSimple c.name.getString!) (.const c.name) completionKind 1
         return
 
-      let some (label, score) ← matchDecl? typeName id (danglingDot := false) declName | pure ()
+      let some (label, score) := matchDecl? (← getEnv) typeName id (danglingDot := false) declName | pure ()
       addUnresolvedCompletionItem label (.const c.name) completionKind score
 
 private def fieldIdCompletion
@@ -26,6 +26,7 @@ import Lean.Server.FileWorker.Utils
 import Lean.Server.FileWorker.RequestHandling
 import Lean.Server.FileWorker.WidgetRequests
 import Lean.Server.FileWorker.SetupFile
+import Lean.Server.FileWorker.SnapshotCache
 import Lean.Server.Rpc.Basic
 import Lean.Widget.InteractiveDiagnostic
 import Lean.Server.ImportCompletion
@@ -59,6 +60,15 @@ open IO
 open Snapshots
 open JsonRpc
 
+/-- Diagnostics restored from the snapshot cache, see `server.snapshotCache`. -/
+structure RestoredDiagnostics where
+  /-- Position up to which the document has been processed and reported. -/
+  pos   : String.Pos := 0
+  /-- Restored diagnostics of commands at or after `pos`, with the start positions of their commands. -/
+  diags : Array (String.Pos × Diagnostic) := #[]
+  /-- Whether the document has been fully processed or edited, after which nothing is restored. -/
+  done  : Bool := false
+
 open Widget in
 
 structure WorkerContext where
@@ -80,6 +90,18 @@ structure WorkerContext where
   Diagnostics that are included in every single `textDocument/publishDiagnostics` notification.
   -/
   stickyDiagnosticsRef : IO.Ref (Array InteractiveDiagnostic)
+  /--
+  Diagnostics restored from the snapshot cache that are included in `textDocument/publishDiagnostics`
+  notifications until the commands they belong to have been processed again.
+  -/
+  restoredDiagnosticsRef : IO.Ref RestoredDiagnostics
+  /--
+  Evictable info trees of the current document version with the ranges of their commands, see
+  `server.memoryBudgetMb`.
+  -/
+  evictableInfoTreesRef : IO.Ref (Array (String.Range × Language.Evictable Elab.InfoTree))
+  /-- Position of the most recent request at a position in the document, taken as the cursor position. -/
+  cursorPosRef         : IO.Ref String.Pos
   hLog                 : FS.Stream
   initParams           : InitializeParams
   processor            : Parser.InputContext → BaseIO Lean.Language.Lean.InitialSnapshot
@@ -95,17 +117,16 @@ structure WorkerContext where
 section Elab
   -- Placed here instead of Lean.Server.Utils because of an import loop
   private def mkIleanInfoNotification (method : String) (m : DocumentMeta)
-      (trees : Array Elab.InfoTree) : BaseIO (JsonRpc.Notification Lsp.LeanIleanInfoParams) := do
-    let references ← findModuleRefs m.text trees (localVars := true) |>.toLspModuleRefs
+      (references : Lsp.ModuleRefs) : JsonRpc.Notification Lsp.LeanIleanInfoParams :=
     let param := { version := m.version, references }
-    return { method, param }
+    { method, param }
 
-  private def mkIleanInfoUpdateNotification : DocumentMeta → Array Elab.InfoTree →
-      BaseIO (JsonRpc.Notification Lsp.LeanIleanInfoParams) :=
+  private def mkIleanInfoUpdateNotification : DocumentMeta → Lsp.ModuleRefs →
+      JsonRpc.Notification Lsp.LeanIleanInfoParams :=
     mkIleanInfoNotification "$/lean/ileanInfoUpdate"
 
-  private def mkIleanInfoFinalNotification : DocumentMeta → Array Elab.InfoTree →
-      BaseIO (JsonRpc.Notification Lsp.LeanIleanInfoParams) :=
+  private def mkIleanInfoFinalNotification : DocumentMeta → Lsp.ModuleRefs →
+      JsonRpc.Notification Lsp.LeanIleanInfoParams :=
     mkIleanInfoNotification "$/lean/ileanInfoFinal"
 
   /-- Yields a `$/lean/importClosure` notification. -/
@@ -119,8 +140,13 @@ section Elab
   private structure ReportSnapshotsState where
     /-- Whether we have waited for a snapshot to finish at least once (see debouncing below). -/
     hasBlocked := false
-    /-- All info trees encountered so far. -/
-    allInfoTrees : Array Elab.InfoTree := #[]
+    /-- Whether diagnostics have been found since they were last published. -/
+    hasNewDiagnostics := false
+    /--
+    References of all info trees encountered so far. We do not keep the info trees themselves so
+    that they can be evicted, see `server.memoryBudgetMb`.
+    -/
+    allRefs : Lsp.ModuleRefs := Std.HashMap.empty
     /-- New info trees encountered since we last sent a .ilean update notification. -/
     newInfoTrees : Array Elab.InfoTree := #[]
     /-- Whether we encountered any snapshot with `Snapshot.isFatal`. -/
@@ -138,6 +164,17 @@ section Elab
     descr := "(server) time in milliseconds to wait before reporting progress and diagnostics on \
       document edit in order to reduce flickering
 
+This option can only be set on the command line, not in the lakefile or via `set_option`."
+  }
+
+  register_builtin_option server.memoryBudgetMb : Nat := {
+    defValue := 0
+    group := "server"
+    descr := "(server) resident memory in megabytes above which the file worker evicts the info \
+      trees of commands far away from the cursor, `0` for no limit. Evicted info trees are \
+      recomputed by elaborating their commands again when they are needed by requests at their \
+      position, but are skipped by requests about the whole document such as semantic tokens.
+
 This option can only be set on the command line, not in the lakefile or via `set_option`."
   }
 
@@ -152,18 +189,50 @@ This option can only be set on the command line, not in the lakefile or via `set
 
   /--
   Sends a `textDocument/publishDiagnostics` notification to the client that contains the diagnostics
-  in `ctx.stickyDiagnosticsRef` and `doc.diagnosticsRef`.
+  in `ctx.stickyDiagnosticsRef`, `doc.diagnosticsRef` and `ctx.restoredDiagnosticsRef`.
   -/
   private def publishDiagnostics (ctx : WorkerContext) (doc : EditableDocumentCore)
       : BaseIO Unit := do
     let stickyInteractiveDiagnostics ← ctx.stickyDiagnosticsRef.get
     let docInteractiveDiagnostics ← doc.diagnosticsRef.get
+    let restoredDiagnostics ← ctx.restoredDiagnosticsRef.get
     let diagnostics :=
       stickyInteractiveDiagnostics ++ docInteractiveDiagnostics
       |>.map (·.toDiagnostic)
+    let diagnostics := diagnostics ++ restoredDiagnostics.diags.map (·.2)
     let notification := mkPublishDiagnosticsNotification doc.meta diagnostics
     ctx.chanOut.send notification
 
+  /--
+  Shows the diagnostics from the snapshot cache of the document for the unchanged prefix of its
+  commands, once its imports `env` have been loaded.
+  -/
+  private def restoreSnapshotCache (ctx : WorkerContext) (doc : EditableDocumentCore)
+      (env : Environment) : IO Unit := do
+    let diags ← try
+      SnapshotCache.restore doc.meta.uri doc.meta.text (← SnapshotCache.importsHash env)
+    catch e =>
+      ctx.hLog.putStrLn s!"failed to restore snapshot cache: {e}"
+      pure #[]
+    if diags.isEmpty then
+      return
+    let restored ← ctx.restoredDiagnosticsRef.modifyGet fun r =>
+      if r.done then (false, r) else (true, { r with diags := diags.filter (r.pos ≤ ·.1) })
+    if restored then
+      publishDiagnostics ctx doc
+
+  /-- Stores the diagnostics of the fully processed document `doc` in its snapshot cache. -/
+  private def saveSnapshotCache (ctx : WorkerContext) (doc : EditableDocumentCore) : IO Unit := do
+    try
+      let (snaps, _) := doc.cmdSnaps.getAll
+      let some header := snaps.head?
+        | return
+      let diags := (← doc.diagnosticsRef.get).map (·.toDiagnostic)
+      SnapshotCache.save doc.meta.uri doc.meta.text (← SnapshotCache.importsHash header.env)
+        (snaps.toArray.map (·.endPos)) diags
+    catch e =>
+      ctx.hLog.putStrLn s!"failed to save snapshot cache: {e}"
+
   open Language in
   /--
     Reports status of a snapshot tree incrementally to the user: progress,
@@ -175,9 +244,10 @@ This option can only be set on the command line, not in the lakefile or via `set
     * after first waiting for `reportDelayMs`, to give trivial tasks a chance to finish
     * when first blocking, i.e. not before skipping over any unchanged snapshots and such trivial
       tasks
-    * afterwards, each time new information is found in a snapshot
-    * at the very end, if we never blocked (e.g. emptying a file should make
-      sure to empty diagnostics as well eventually) -/
+    * afterwards, each time we block again after new information was found in snapshots, so that
+      diagnostics of snapshots that have finished in the meantime are published together
+    * at the very end, if we never blocked or there is new information (e.g. emptying a file should
+      make sure to empty diagnostics as well eventually) -/
   private partial def reportSnapshots (ctx : WorkerContext) (doc : EditableDocumentCore)
       (cancelTk : CancelToken) : BaseIO (Task Unit) := do
     let t ← BaseIO.asTask do
@@ -192,11 +262,16 @@ This option can only be set on the command line, not in the lakefile or via `set
           ctx.chanOut.send <| mkFileProgressAtPosNotification doc.meta 0 .fatalError
         else
           ctx.chanOut.send <| mkFileProgressDoneNotification doc.meta
-        unless st.hasBlocked do
+        let hadRestored ← ctx.restoredDiagnosticsRef.modifyGet fun r =>
+          (!r.diags.isEmpty, { done := true })
+        if !st.hasBlocked || st.hasNewDiagnostics || hadRestored then
           publishDiagnostics ctx doc
+        if server.snapshotCache.get ctx.cmdlineOpts && !st.hasFatal then
+          let _ ← (saveSnapshotCache ctx doc).toBaseIO
         -- This will overwrite existing ilean info for the file, in case something
         -- went wrong during the incremental updates.
-        ctx.chanOut.send (← mkIleanInfoFinalNotification doc.meta st.allInfoTrees)
+        let allRefs := st.allRefs.append (← newRefs doc st.newInfoTrees)
+        ctx.chanOut.send (mkIleanInfoFinalNotification doc.meta allRefs)
         return .pure ()
   where
     go (node : SnapshotTree) (st : ReportSnapshotsState) : BaseIO (Task ReportSnapshotsState) := do
@@ -212,20 +287,27 @@ This option can only be set on the command line, not in the lakefile or via `set
               cacheRef.set <| some <| .mk { diags : MemorizedInteractiveDiagnostics }
             pure diags
         doc.diagnosticsRef.modify (· ++ diags)
-        if st.hasBlocked then
-          publishDiagnostics ctx doc
 
-      let mut st := { st with hasFatal := st.hasFatal || node.element.isFatal }
+      let mut st := { st with
+        hasFatal := st.hasFatal || node.element.isFatal
+        hasNewDiagnostics := st.hasNewDiagnostics || node.element.diagnostics.msgLog.hasUnreported
+      }
 
-      if let some itree := node.element.infoTree? then
-        let mut newInfoTrees := st.newInfoTrees.push itree
+      if let some itree := node.element.getInfoTree? then
+        st := { st with newInfoTrees := st.newInfoTrees.push itree }
         if st.hasBlocked then
-          ctx.chanOut.send (← mkIleanInfoUpdateNotification doc.meta newInfoTrees)
-          newInfoTrees := #[]
-        st := { st with newInfoTrees, allInfoTrees := st.allInfoTrees.push itree }
+          let refs ← newRefs doc st.newInfoTrees
+          ctx.chanOut.send (mkIleanInfoUpdateNotification doc.meta refs)
+          st := { st with newInfoTrees := #[], allRefs := st.allRefs.append refs }
+      if let some itree := node.element.evictableInfoTree? then
+        if let some range := st.lastRange? then
+          ctx.evictableInfoTreesRef.modify (·.push (range, itree))
 
       goSeq st node.children.toList
 
+    newRefs (doc : EditableDocumentCore) (trees : Array Elab.InfoTree) : BaseIO Lsp.ModuleRefs :=
+      findModuleRefs doc.meta.text trees (localVars := true) |>.toLspModuleRefs
+
     goSeq (st : ReportSnapshotsState) :
         List (SnapshotTask SnapshotTree) → BaseIO (Task ReportSnapshotsState)
       | [] => return .pure st
@@ -236,9 +318,12 @@ This option can only be set on the command line, not in the lakefile or via `set
           -- report *some* recent range even if `t.range?` is `none`; see also `State.lastRange?`
           if let some range := st.lastRange? then
             ctx.chanOut.send <| mkFileProgressAtPosNotification doc.meta range.start
-          if !st.hasBlocked then
+            -- commands before `range` have been reported
+            ctx.restoredDiagnosticsRef.modify fun r =>
+              { r with pos := range.start, diags := r.diags.filter (range.start ≤ ·.1) }
+          if !st.hasBlocked || st.hasNewDiagnostics then
             publishDiagnostics ctx doc
-            st := { st with hasBlocked := true }
+            st := { st with hasBlocked := true, hasNewDiagnostics := false }
         BaseIO.bindTask t.task fun t => do
           BaseIO.bindTask (← go t st) (goSeq · ts)
 end Elab
@@ -323,7 +408,9 @@ def setupImports (meta : DocumentMeta) (cmdlineOpts : Options) (chanOut : Channe
     pure Name.anonymous
 
   -- override cmdline options with file options
-  let opts := cmdlineOpts.mergeBy (fun _ _ fileOpt => fileOpt) fileSetupResult.fileOptions
+  let mut opts := cmdlineOpts.mergeBy (fun _ _ fileOpt => fileOpt) fileSetupResult.fileOptions
+  if server.memoryBudgetMb.get cmdlineOpts > 0 then
+    opts := Language.Lean.internal.evictableInfoTrees.set opts true
 
   return .ok {
     mainModuleName
@@ -339,6 +426,9 @@ section Initialization
     let freshRequestIdRef ← IO.mkRef (0 : Int)
     let chanIsProcessing ← IO.Channel.new
     let stickyDiagnosticsRef ← IO.mkRef ∅
+    let restoredDiagnosticsRef ← IO.mkRef {}
+    let evictableInfoTreesRef ← IO.mkRef #[]
+    let cursorPosRef ← IO.mkRef 0
     let chanOut ← mkLspOutputChannel maxDocVersionRef chanIsProcessing
     let srcSearchPathPromise ← IO.Promise.new
 
@@ -360,11 +450,18 @@ section Initialization
       chanIsProcessing
       cmdlineOpts := opts
       stickyDiagnosticsRef
+      restoredDiagnosticsRef
+      evictableInfoTreesRef
+      cursorPosRef
     }
     let doc : EditableDocumentCore := {
       meta, initSnap
       diagnosticsRef := (← IO.mkRef ∅)
     }
+    if server.snapshotCache.get opts then
+      let _ ← IO.mapTask (t := doc.cmdSnaps.waitHead?) fun
+        | .ok (some header) => restoreSnapshotCache ctx doc header.env
+        | _ => pure ()
     let reporterCancelTk ← CancelToken.new
     let reporter ← reportSnapshots ctx doc reporterCancelTk
     return (ctx, {
@@ -398,7 +495,8 @@ section Initialization
             return
           -- note that because of `server.reportDelayMs`, we cannot simply set `maxDocVersion` here
           -- as that would allow outdated messages to be reported until the delay is over
-        o.writeLspMessage msg |>.catchExceptions (fun _ => pure ())
+        -- the watchdog relays our messages verbatim where possible
+        o.writeLspMessage msg (relay := true) |>.catchExceptions (fun _ => pure ())
         if let .notification "$/lean/fileProgress" (some params) := msg then
           if let some (params : LeanFileProgressParams) := fromJson? (toJson params) |>.toOption then
             chanIsProcessing.send (! params.processing.isEmpty)
@@ -434,6 +532,10 @@ section Updates
   def updateDocument (meta : DocumentMeta) : WorkerM Unit := do
     (← get).reporterCancelTk.set
     let ctx ← read
+    -- the positions of restored diagnostics refer to the previous version
+    ctx.restoredDiagnosticsRef.set { done := true }
+    -- reused snapshots are registered again by the new reporter
+    ctx.evictableInfoTreesRef.set #[]
     let initSnap ← ctx.processor meta.mkInputContext
     let doc : EditableDocumentCore := {
       meta, initSnap
@@ -590,6 +692,8 @@ section MessageHandling
       : WorkerM Unit := do
     let ctx ← read
     let st ← get
+    if let .ok (p : TextDocumentPositionParams) := fromJson? params then
+      ctx.cursorPosRef.set <| st.doc.meta.text.lspPosToUtf8Pos p.position
 
     -- special cases
     try
@@ -709,6 +813,30 @@ def runRefreshTask : WorkerM (Task (Except IO.Error Unit)) := do
       sendServerRequest ctx "workspace/semanticTokens/refresh" (none : Option Nat)
       IO.sleep 2000
 
+/--
+Evicts the info trees of all commands except for the `keep` commands closest to the cursor, see
+`server.memoryBudgetMb`.
+-/
+def evictInfoTrees (ctx : WorkerContext) (keep := 32) : BaseIO Unit := do
+  let cursor := (← ctx.cursorPosRef.get).byteIdx
+  -- `0` for ranges containing the cursor
+  let distance (r : String.Range) := max (r.start.byteIdx - cursor) (cursor - r.stop.byteIdx)
+  let trees := (← ctx.evictableInfoTreesRef.get).qsort fun (r₁, _) (r₂, _) =>
+    distance r₁ < distance r₂
+  for (_, tree) in trees[keep:] do
+    tree.evict
+
+def runEvictionTask : WorkerM (Option (Task (Except IO.Error Unit))) := do
+  let ctx ← read
+  let budget := server.memoryBudgetMb.get ctx.cmdlineOpts
+  if budget == 0 then
+    return none
+  some <$> IO.asTask (prio := Task.Priority.dedicated) do
+    while ! (←IO.checkCanceled) do
+      IO.sleep 1000
+      if (← IO.getResidentMemory) > budget * 1024 * 1024 then
+        evictInfoTrees ctx
+
 def initAndRunWorker (i o e : FS.Stream) (opts : Options) : IO Unit := do
   let i ← maybeTee "fwIn.txt" false i
   let o ← maybeTee "fwOut.txt" true o
@@ -728,8 +856,11 @@ def initAndRunWorker (i o e : FS.Stream) (opts : Options) : IO Unit := do
   StateRefT'.run' (s := st) <| ReaderT.run (r := ctx) do
     try
       let refreshTask ← runRefreshTask
+      let evictionTask? ← runEvictionTask
       mainLoop i
       IO.cancel refreshTask
+      if let some evictionTask := evictionTask? then
+        IO.cancel evictionTask
     catch err =>
       let st ← get
       writeErrorDiag st.doc.meta err
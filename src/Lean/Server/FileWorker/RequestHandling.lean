@@ -72,6 +72,9 @@ def handleCompletionItemResolve (item : CompletionItem)
       | return item
     Completion.resolveCompletionItem? text pos cmdStx infoTree item id
 
+/-- Maximum number of characters of rendered hovers and goals, longer ones are truncated. -/
+def maxRenderedLength : Nat := 100000
+
 open Elab in
 def handleHover (p : HoverParams)
     : RequestM (RequestTask (Option Hover)) := do
@@ -103,7 +106,7 @@ def handleHover (p : HoverParams)
           -- prefer info tree if at least as specific as parser docstring
           if stxDoc?.all fun (_, stxRange) => stxRange.includes range then
             if let some hoverFmt ← ictx.info.fmtHover? ictx.ctx then
-              return mkHover (toString hoverFmt.fmt) range
+              return mkHover (hoverFmt.fmt.prettyTruncated maxRenderedLength) range
 
       if let some (doc, range) := stxDoc? then
         return mkHover doc range
@@ -268,7 +271,7 @@ def handlePlainGoal (p : PlainGoalParams)
     if goals.isEmpty then
       { goals := #[], rendered := "no goals" }
     else
-      let goalStrs := goals.map (toString ·.pretty)
+      let goalStrs := goals.map (·.pretty.prettyTruncated maxRenderedLength)
       let goalBlocks := goalStrs.map fun goal => s!"```lean
 {goal}
 ```"
@@ -296,7 +299,7 @@ def handlePlainTermGoal (p : PlainTermGoalParams)
     : RequestM (RequestTask (Option PlainTermGoal)) := do
   let t ← getInteractiveTermGoal p
   return t.map <| Except.map <| Option.map fun goal =>
-    { goal := toString goal.pretty
+    { goal := goal.pretty.prettyTruncated maxRenderedLength
       range := goal.range
     }
 
@@ -316,7 +319,8 @@ partial def handleDocumentHighlight (p : DocumentHighlightParams)
     | stx => stx.getArgs.findSome? (highlightReturn? doRange?)
 
   let highlightRefs? (snaps : Array Snapshot) : IO (Option (Array DocumentHighlight)) := do
-    let trees := snaps.map (·.infoTree)
+    -- evicted info trees are skipped, as they would have to be recomputed for the whole document
+    let trees ← snaps.filterMapM (·.peekInfoTree?)
     let refs : Lsp.ModuleRefs ← findModuleRefs text trees |>.toLspModuleRefs
     let mut ranges := #[]
     for ident in refs.findAt p.position (includeStop := true) do
@@ -570,7 +574,10 @@ where
       if s.endPos <= beginPos then
         continue
       let syntaxBasedSemanticTokens := collectSyntaxBasedSemanticTokens s.stx
-      let infoBasedSemanticTokens := collectInfoBasedSemanticTokens s.infoTree
+      -- do not elaborate all commands again for the full document if their info trees have been
+      -- evicted
+      let infoTree? ← if endPos?.isSome then pure (some s.infoTree) else s.peekInfoTree?
+      let infoBasedSemanticTokens := infoTree?.map collectInfoBasedSemanticTokens |>.getD #[]
       leanSemanticTokens := leanSemanticTokens ++ syntaxBasedSemanticTokens ++ infoBasedSemanticTokens
     let absoluteLspSemanticTokens := computeAbsoluteLspSemanticTokens doc.meta.text beginPos endPos? leanSemanticTokens
     let absoluteLspSemanticTokens := filterDuplicateSemanticTokens absoluteLspSemanticTokens
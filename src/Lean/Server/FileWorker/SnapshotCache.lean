@@ -0,0 +1,135 @@
+/-
+Copyright (c) 2024 Lean FRO, LLC. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+-/
+prelude
+import Lean.Util.ValueFile
+import Lean.Util.Path
+import Lean.Server.Utils
+
+/-!
+# On-disk snapshot cache
+
+When `server.snapshotCache` is set, the file worker stores the diagnostics of each command of a
+fully processed document in `.lake/snapshots`, and restores them when the document is opened again:
+the diagnostics of the longest prefix of commands whose source text and imports are unchanged are
+shown right away and replaced command by command as elaboration catches up.
+
+The cache is written with `IO.saveValue`. Environments and info trees cannot be stored that way as
+they contain closures, so elaboration itself is not skipped.
+-/
+
+namespace Lean.Server.FileWorker
+open Lsp
+
+register_builtin_option server.snapshotCache : Bool := {
+  defValue := false
+  group    := "server"
+  descr    := "(server) store the diagnostics of processed documents in `.lake/snapshots` and show \
+    them for unchanged commands while the document is processed again after reopening it
+
+This option can only be set on the command line, not in the lakefile or via `set_option`."
+}
+
+/-- A command in the snapshot cache. The header is stored as the first command. -/
+structure CachedCommand where
+  /-- Start position of the command, including preceding whitespace. -/
+  startPos    : String.Pos
+  /-- End position of the command, including trailing whitespace. -/
+  endPos      : String.Pos
+  /-- Hash of the source text up to `endPos`. -/
+  srcHash     : UInt64
+  /-- Diagnostics reported for the command. -/
+  diagnostics : Array Diagnostic
+  deriving Inhabited
+
+/-- Contents of a snapshot cache file. -/
+structure SnapshotCache where
+  /-- Hash of the imported modules, see `importsHash`. -/
+  importsHash : UInt64
+  commands    : Array CachedCommand
+  deriving Inhabited, TypeName
+
+namespace SnapshotCache
+
+/-- Fingerprint of cache files, to be bumped whenever the layout of `SnapshotCache` changes. -/
+def fingerprint : UInt64 := IO.valueFingerprint SnapshotCache (version := 1)
+
+/--
+The cache file of `uri`. The layout of the cache depends on the Lean version, so it is part of the
+file name as well as of `fingerprint`.
+-/
+def fileOf (uri : DocumentUri) : System.FilePath :=
+  let h := mixHash (hash uri) (hash Lean.githash)
+  ".lake" / "snapshots" / s!"{String.mk (Nat.toDigits 16 h.toNat)}.snap"
+
+/--
+Hash of the names and `.olean` modification times of the modules imported by `env`, which changes
+whenever an import is rebuilt.
+-/
+def importsHash (env : Environment) : IO UInt64 :=
+  env.header.moduleNames.foldlM (init := 7) fun h mod => do
+    let mtime ← try
+      let t := (← (← findOLean mod).metadata).modified
+      pure <| mixHash (hash t.sec) t.nsec.toUInt64
+    catch _ =>
+      pure 0
+    return mixHash h (mixHash (hash mod) mtime)
+
+/-- Extends the source hash `h` up to `startPos` with the source text from `startPos` to `endPos`. -/
+private def extendSrcHash (h : UInt64) (text : FileMap) (startPos endPos : String.Pos) : UInt64 :=
+  mixHash h (hash (text.source.extract startPos endPos))
+
+/--
+Stores the diagnostics `diags` of a document with text `text` and commands ending at `cmdEndPos`,
+including the header.
+-/
+def save (uri : DocumentUri) (text : FileMap) (importsHash : UInt64) (cmdEndPos : Array String.Pos)
+    (diags : Array Diagnostic) : IO Unit := do
+  let mut commands : Array CachedCommand := #[]
+  let mut startPos : String.Pos := 0
+  let mut srcHash : UInt64 := 7
+  for endPos in cmdEndPos do
+    srcHash := extendSrcHash srcHash text startPos endPos
+    commands := commands.push { startPos, endPos, srcHash, diagnostics := #[] }
+    startPos := endPos
+  if commands.isEmpty then
+    return
+  for diag in diags do
+    let pos := text.lspPosToUtf8Pos diag.range.start
+    -- the last command that starts at or before the diagnostic
+    let i := commands.findIdx? (pos < ·.startPos) |>.map (· - 1) |>.getD (commands.size - 1)
+    commands := commands.modify i fun c => { c with diagnostics := c.diagnostics.push diag }
+  let file := fileOf uri
+  if let some dir := file.parent then
+    IO.FS.createDirAll dir
+  IO.saveValue file fingerprint ({ importsHash, commands } : SnapshotCache)
+
+/--
+Restores the diagnostics of the longest prefix of cached commands that are unchanged in `text`, if
+the imports are unchanged as well. Each diagnostic is returned with the start position of its
+command.
+-/
+def restore (uri : DocumentUri) (text : FileMap) (importsHash : UInt64) :
+    IO (Array (String.Pos × Diagnostic)) := do
+  let file := fileOf uri
+  unless (← file.pathExists) do
+    return #[]
+  -- the region is never freed, as the diagnostics may still be referenced
+  let cache : SnapshotCache ← try IO.loadValue file fingerprint catch _ => return #[]
+  if cache.importsHash != importsHash then
+    return #[]
+  let mut diags := #[]
+  let mut srcHash : UInt64 := 7
+  for cmd in cache.commands do
+    if cmd.endPos > text.source.endPos then
+      break
+    srcHash := extendSrcHash srcHash text cmd.startPos cmd.endPos
+    if srcHash != cmd.srcHash then
+      break
+    diags := diags ++ cmd.diagnostics.map (cmd.startPos, ·)
+  return diags
+
+end SnapshotCache
+
+end Lean.Server.FileWorker
@@ -33,6 +33,7 @@ where
         stx := cmdParsed.data.stx
         mpState := cmdParsed.data.parserState
         cmdState := finished.cmdState
+        evictableInfoTree? := finished.evictableInfoTree?
       } (match cmdParsed.nextCmdSnap? with
         | some next => .delayed <| next.task.bind go
         | none => .nil)
@@ -7,6 +7,7 @@ Authors: Joscha Mennicken
 prelude
 import Lean.Data.Lsp.Internal
 import Lean.Server.Utils
+import Lean.Server.BinaryIlean
 
 /-! # Representing collected and deduplicated definitions and usages -/
 
@@ -175,6 +176,19 @@ def findRange? (self : ModuleRefs) (pos : Lsp.Position) (includeStop := false) :
       return loc.range
   none
 
+/--
+Adds the references `refs` found in a later part of the module, such as a single command, to `self`.
+Definitions in `self` take precedence over those in `refs`, as in `Server.RefInfo.addRef`.
+-/
+def append (self refs : ModuleRefs) : ModuleRefs :=
+  refs.fold (init := self) fun self ident info =>
+    self.insert ident <| match self.get? ident with
+      | some info' => {
+          definition? := info'.definition?.orElse fun _ => info.definition?
+          usages := info'.usages ++ info.usages
+        }
+      | none => info
+
 end Lean.Lsp.ModuleRefs
 
 namespace Lean.Server
@@ -194,14 +208,59 @@ structure Ilean where
 
 namespace Ilean
 
-/-- Reads and parses the .ilean file at `path`. -/
-def load (path : System.FilePath) : IO Ilean := do
+private def loadJson (path : System.FilePath) : IO Ilean := do
   let content ← FS.readFile path
   match Json.parse content >>= fromJson? with
     | Except.ok ilean => pure ilean
     | Except.error msg => throwServerError s!"Failed to load ilean at {path}: {msg}"
 
+/-- Reads and decodes the .ilean file at `path`, which may be in the JSON or the binary format. -/
+def load (path : System.FilePath) : IO Ilean := do
+  if let some ilean ← BinaryIlean.load? path then
+    return { module := ilean.module, references := ilean.toModuleRefs }
+  loadJson path
+
 end Ilean
+
+/-- References of a module loaded from an `.ilean` file. -/
+inductive IleanRefs where
+  /-- References decoded from a JSON `.ilean` file. -/
+  | decoded (refs : Lsp.ModuleRefs)
+  /-- References in a memory-mapped binary `.ilean` file, which are only decoded when queried. -/
+  | mapped (ilean : BinaryIlean)
+
+namespace IleanRefs
+
+/--
+Loads the `.ilean` file at `path` and returns the name of its module and its references. Binary
+files are mapped instead of decoded.
+-/
+def load (path : System.FilePath) : IO (Name × IleanRefs) := do
+  if let some ilean ← BinaryIlean.load? path then
+    return (ilean.module, .mapped ilean)
+  let ilean ← Ilean.loadJson path
+  return (ilean.module, .decoded ilean.references)
+
+/-- Looks up the references of `ident`. -/
+def get? : IleanRefs → RefIdent → Option Lsp.RefInfo
+  | .decoded refs, ident => refs.get? ident
+  | .mapped ilean, ident => ilean.get? ident
+
+/-- Yields all references, decoding them if necessary. -/
+def toModuleRefs : IleanRefs → Lsp.ModuleRefs
+  | .decoded refs => refs
+  | .mapped ilean => ilean.toModuleRefs
+
+/-- Yields the names and definition ranges of all `RefIdent.const` identifiers with a definition. -/
+def definitions : IleanRefs → Array (String × Lsp.Range)
+  | .decoded refs => refs.fold (init := #[]) fun acc ident info =>
+    match ident, info.definition? with
+    | .const _ nameString, some ⟨range, _⟩ => acc.push (nameString, range)
+    | _, _ => acc
+  | .mapped ilean => ilean.foldDefinitions (init := #[]) fun acc nameString range =>
+    acc.push (nameString, range)
+
+end IleanRefs
 /-! # Collecting and deduplicating definitions and usages -/
 
 /-- Gets the name of the module that contains `declName`. -/
@@ -378,7 +437,7 @@ def findModuleRefs (text : FileMap) (trees : Array InfoTree) (localVars : Bool :
 /-- References from ilean files and current ilean information from file workers. -/
 structure References where
   /-- References loaded from ilean files -/
-  ileans : Std.HashMap Name (System.FilePath × Lsp.ModuleRefs)
+  ileans : Std.HashMap Name (System.FilePath × IleanRefs)
   /-- References from workers, overriding the corresponding ilean files -/
   workers : Std.HashMap Name (Nat × Lsp.ModuleRefs)
 
@@ -389,7 +448,12 @@ def empty : References := { ileans := Std.HashMap.empty, workers := Std.HashMap.
 
 /-- Adds the contents of an ilean file `ilean` at `path` to `self`. -/
 def addIlean (self : References) (path : System.FilePath) (ilean : Ilean) : References :=
-  { self with ileans := self.ileans.insert ilean.module (path, ilean.references) }
+  { self with ileans := self.ileans.insert ilean.module (path, .decoded ilean.references) }
+
+/-- Adds the references `refs` of `module` loaded from the ilean file at `path` to `self`. -/
+def addIleanRefs (self : References) (path : System.FilePath) (module : Name) (refs : IleanRefs) :
+    References :=
+  { self with ileans := self.ileans.insert module (path, refs) }
 
 /-- Removes the ilean file data at `path` from `self`. -/
 def removeIlean (self : References) (path : System.FilePath) : References :=
@@ -428,11 +492,40 @@ def finalizeWorkerRefs (self : References) (name : Name) (version : Nat) (refs :
 def removeWorkerRefs (self : References) (name : Name) : References :=
   { self with workers := self.workers.erase name }
 
-/-- Yields a map from all modules to all of their references. -/
+/--
+Yields a map from all modules to all of their references. This decodes all binary ilean files, so
+queries about a single module or identifier should use `moduleRefs?` or `allRefsFor` instead.
+-/
 def allRefs (self : References) : Std.HashMap Name Lsp.ModuleRefs :=
-  let ileanRefs := self.ileans.toArray.foldl (init := Std.HashMap.empty) fun m (name, _, refs) => m.insert name refs
+  let ileanRefs := self.ileans.toArray.foldl (init := Std.HashMap.empty) fun m (name, _, refs) =>
+    m.insert name refs.toModuleRefs
   self.workers.toArray.foldl (init := ileanRefs) fun m (name, _, refs) => m.insert name refs
 
+/-- Yields the references of `module`, preferring those from its worker. -/
+def moduleRefs? (self : References) (module : Name) : Option Lsp.ModuleRefs :=
+  match self.workers[module]? with
+  | some (_, refs) => some refs
+  | none => self.ileans[module]?.map (·.2.toModuleRefs)
+
+/-- Yields the references of `ident` in `module`, preferring those from its worker. -/
+def refInfo? (self : References) (module : Name) (ident : RefIdent) : Option Lsp.RefInfo :=
+  match self.workers[module]? with
+  | some (_, refs) => refs.get? ident
+  | none => self.ileans[module]? >>= (·.2.get? ident)
+
+/-- Yields the references of `ident` in all modules, without decoding other references. -/
+def refInfos (self : References) (ident : RefIdent) : Array (Name × Lsp.RefInfo) :=
+  let ileanInfos := self.ileans.fold (init := #[]) fun acc module (_, refs) =>
+    if self.workers.contains module then
+      acc
+    else match refs.get? ident with
+      | some info => acc.push (module, info)
+      | none      => acc
+  self.workers.fold (init := ileanInfos) fun acc module (_, refs) =>
+    match refs.get? ident with
+    | some info => acc.push (module, info)
+    | none      => acc
+
 /--
 Yields all references in `self` for `ident`, as well as the `DocumentUri` that each
 reference occurs in.
@@ -443,16 +536,14 @@ def allRefsFor
     (ident         : RefIdent)
     : IO (Array (DocumentUri × Lsp.RefInfo)) := do
   let refsToCheck := match ident with
-    | RefIdent.const .. => self.allRefs.toArray
+    | RefIdent.const .. => self.refInfos ident
     | RefIdent.fvar identModule .. =>
       let identModuleName := identModule.toName
-      match self.allRefs[identModuleName]? with
+      match self.refInfo? identModuleName ident with
       | none => #[]
-      | some refs => #[(identModuleName, refs)]
+      | some info => #[(identModuleName, info)]
   let mut result := #[]
-  for (module, refs) in refsToCheck do
-    let some info := refs.get? ident
-      | continue
+  for (module, info) in refsToCheck do
     let some path ← srcSearchPath.findModuleWithExt "lean" module
       | continue
     -- Resolve symlinks (such as `src` in the build dir) so that files are
@@ -463,13 +554,13 @@ def allRefsFor
 
 /-- Yields all references in `module` at `pos`. -/
 def findAt (self : References) (module : Name) (pos : Lsp.Position) (includeStop := false) : Array RefIdent := Id.run do
-  if let some refs := self.allRefs[module]? then
+  if let some refs := self.moduleRefs? module then
     return refs.findAt pos includeStop
   #[]
 
 /-- Yields the first reference in `module` at `pos`. -/
 def findRange? (self : References) (module : Name) (pos : Lsp.Position) (includeStop := false) : Option Range := do
-  let refs ← self.allRefs[module]?
+  let refs ← self.moduleRefs? module
   refs.findRange? pos includeStop
 
 /-- Location and parent declaration of a reference. -/
@@ -514,13 +605,14 @@ def definitionsMatching
     (filter        : Name → Option α)
     (maxAmount?    : Option Nat := none) : IO $ Array (α × Location) := do
   let mut result := #[]
-  for (module, refs) in self.allRefs.toList do
+  let ileans := self.ileans.toList.filterMap fun (module, _, refs) =>
+    if self.workers.contains module then none else some (module, refs)
+  let workers := self.workers.toList.map fun (module, _, refs) => (module, IleanRefs.decoded refs)
+  for (module, refs) in ileans ++ workers do
     let some path ← srcSearchPath.findModuleWithExt "lean" module
       | continue
     let uri := System.Uri.pathToUri <| ← IO.FS.realPath path
-    for (ident, info) in refs.toList do
-      let (RefIdent.const _ nameString, some ⟨definitionRange, _⟩) := (ident, info.definition?)
-        | continue
+    for (nameString, definitionRange) in refs.definitions do
       let some a := filter nameString.toName
         | continue
       result := result.push (a, ⟨uri, definitionRange⟩)
@@ -32,7 +32,7 @@ where
     | t::ts =>
       if t.range?.any (·.contains pos) then
         t.task.bind (sync := true) fun tree => Id.run do
-          if let some infoTree := tree.element.infoTree? then
+          if let some infoTree := tree.element.getInfoTree? then
             return .pure infoTree
           tree.findInfoTreeAtPos pos |>.bind (sync := true) fun
             | some infoTree => .pure (some infoTree)
@@ -121,15 +121,15 @@ def readDoc [Monad m] [MonadReaderOf RequestContext m] : m EditableDocument := d
 
 def asTask (t : RequestM α) : RequestM (RequestTask α) := do
   let rc ← readThe RequestContext
-  EIO.asTask <| t.run rc
+  EIO.asTask (prio := .interactive) <| t.run rc
 
 def mapTask (t : Task α) (f : α → RequestM β) : RequestM (RequestTask β) := do
   let rc ← readThe RequestContext
-  EIO.mapTask (f · rc) t
+  EIO.mapTask (f · rc) t (prio := .interactive)
 
 def bindTask (t : Task α) (f : α → RequestM (RequestTask β)) : RequestM (RequestTask β) := do
   let rc ← readThe RequestContext
-  EIO.bindTask t (f · rc)
+  EIO.bindTask t (f · rc) (prio := .interactive)
 
 def waitFindSnapAux (notFoundX : RequestM α) (x : Snapshot → RequestM α)
     : Except IO.Error (Option Snapshot) → RequestM α
@@ -205,9 +205,12 @@ partial def findInfoTreeAtPos
     | some cmdParsed => toSnapshotTree cmdParsed |>.findInfoTreeAtPos pos |>.bind (sync := true) fun
       | some infoTree => .pure <| some infoTree
       | none          => cmdParsed.data.finishedSnap.task.map (sync := true) fun s =>
-        -- the parser returns exactly one command per snapshot, and the elaborator creates exactly one node per command
-        assert! s.cmdState.infoState.trees.size == 1
-        some s.cmdState.infoState.trees[0]!
+        match s.evictableInfoTree? with
+        | some infoTree => some infoTree.get
+        | none =>
+          -- the parser returns exactly one command per snapshot, and the elaborator creates exactly one node per command
+          assert! s.cmdState.infoState.trees.size == 1
+          some s.cmdState.infoState.trees[0]!
     | none => .pure none
 
 open Language in
@@ -227,9 +230,12 @@ def findCmdDataAtPos
     | some cmdParsed => toSnapshotTree cmdParsed |>.findInfoTreeAtPos pos |>.bind (sync := true) fun
       | some infoTree => .pure <| some (cmdParsed.data.stx, infoTree)
       | none          => cmdParsed.data.finishedSnap.task.map (sync := true) fun s =>
-        -- the parser returns exactly one command per snapshot, and the elaborator creates exactly one node per command
-        assert! s.cmdState.infoState.trees.size == 1
-        some (cmdParsed.data.stx, s.cmdState.infoState.trees[0]!)
+        match s.evictableInfoTree? with
+        | some infoTree => some (cmdParsed.data.stx, infoTree.get)
+        | none =>
+          -- the parser returns exactly one command per snapshot, and the elaborator creates exactly one node per command
+          assert! s.cmdState.infoState.trees.size == 1
+          some (cmdParsed.data.stx, s.cmdState.infoState.trees[0]!)
     | none => .pure none
 
 /--
@@ -9,6 +9,7 @@ import Init.System.IO
 
 import Lean.Elab.Import
 import Lean.Elab.Command
+import Lean.Language.Basic
 
 import Lean.Widget.InteractiveDiagnostic
 
@@ -29,6 +30,11 @@ structure Snapshot where
   stx : Syntax
   mpState : Parser.ModuleParserState
   cmdState : Command.State
+  /--
+  The info tree of the command if it is evictable, in which case it is not part of `cmdState`, see
+  `Language.Snapshot.evictableInfoTree?`.
+  -/
+  evictableInfoTree? : Option (Language.Evictable InfoTree) := none
 
 namespace Snapshot
 
@@ -42,9 +48,18 @@ def msgLog (s : Snapshot) : MessageLog :=
   s.cmdState.messages
 
 def infoTree (s : Snapshot) : InfoTree :=
-  -- the parser returns exactly one command per snapshot, and the elaborator creates exactly one node per command
-  assert! s.cmdState.infoState.trees.size == 1
-  s.cmdState.infoState.trees[0]!
+  match s.evictableInfoTree? with
+  | some t => t.get
+  | none =>
+    -- the parser returns exactly one command per snapshot, and the elaborator creates exactly one node per command
+    assert! s.cmdState.infoState.trees.size == 1
+    s.cmdState.infoState.trees[0]!
+
+/-- The info tree of the snapshot, or `none` if it has been evicted. -/
+def peekInfoTree? (s : Snapshot) : BaseIO (Option InfoTree) :=
+  match s.evictableInfoTree? with
+  | some t => t.peek?
+  | none   => return some s.infoTree
 
 def isAtEnd (s : Snapshot) : Bool :=
   Parser.isTerminalCommand s.stx
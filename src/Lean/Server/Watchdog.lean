@@ -308,6 +308,10 @@ section ServerM
     s.importData.modify fun importData =>
       importData.update fw.doc.uri (.ofList params.importClosure.toList)
 
+  /-- Notifications from file workers that are handled by the watchdog instead of being forwarded. -/
+  private def watchdogNotifications : Array String :=
+    #["$/lean/ileanInfoUpdate", "$/lean/ileanInfoFinal", "$/lean/importClosure"]
+
   /-- Creates a Task which forwards a worker's messages into the output stream until an event
   which must be handled in the main watchdog thread (e.g. an I/O error) happens. -/
   private partial def forwardMessages (fw : FileWorker) : ServerM (Task WorkerEvent) := do
@@ -320,7 +324,7 @@ section ServerM
       let o := (←read).hOut
       let msg ←
         try
-          fw.stdout.readLspMessage
+          fw.stdout.readLspRelayedMessage
         catch err =>
           let exitCode ← fw.waitForProc
           -- Remove surviving descendant processes, if any, such as from nested builds.
@@ -354,6 +358,19 @@ section ServerM
 
       -- Re. `o.writeLspMessage msg`:
       -- Writes to Lean I/O channels are atomic, so these won't trample on each other.
+
+      -- Relay messages marked by the worker without parsing and serializing them again; this
+      -- matters for large diagnostics and RPC responses.
+      if let .response id body := msg then
+        fw.erasePendingRequest id
+        o.writeLspRawMessage body
+        return (← loop)
+      if let .notification method body := msg then
+        unless watchdogNotifications.contains method do
+          o.writeLspRawMessage body
+          return (← loop)
+      let msg ← IO.ofExcept msg.toMessage
+
       match msg with
       | Message.response id _ => do
         fw.erasePendingRequest id
@@ -685,7 +702,7 @@ def handleCallHierarchyOutgoingCalls (p : CallHierarchyOutgoingCallsParams)
 
   let references ← (← read).references.get
 
-  let some refs := references.allRefs[module]?
+  let some refs := references.moduleRefs? module
     | return #[]
 
   let items ← refs.toArray.filterMapM fun ⟨ident, info⟩ => do
@@ -828,11 +845,11 @@ section NotificationHandling
           references.modify (fun r => r.removeIlean path)
         else if ileans.contains path then
           try
-            let ilean ← Ilean.load path
+            let (module, refs) ← IleanRefs.load path
             if let FileChangeType.Changed := change.type then
-              references.modify (fun r => r.removeIlean path |>.addIlean path ilean)
+              references.modify (fun r => r.removeIlean path |>.addIleanRefs path module refs)
             else
-              references.modify (fun r => r.addIlean path ilean)
+              references.modify (fun r => r.addIleanRefs path module refs)
           catch
             -- ilean vanished, ignore error
             | .noFileOrDirectory .. => references.modify (·.removeIlean path)
@@ -1165,9 +1182,9 @@ def startLoadingReferences (references : IO.Ref References) : IO Unit := do
     let oleanSearchPath ← Lean.searchPathRef.get
     for path in ← oleanSearchPath.findAllWithExt "ilean" do
       try
-        let ilean ← Ilean.load path
+        let (module, ileanRefs) ← IleanRefs.load path
         references.modify fun refs =>
-          refs.addIlean path ilean
+          refs.addIleanRefs path module ileanRefs
       catch _ =>
         -- could be a race with the build system, for example
         -- ilean load errors should not be fatal, but we *should* log them
@@ -34,3 +34,5 @@ import Lean.Util.SearchPath
 import Lean.Util.SafeExponentiation
 import Lean.Util.NumObjs
 import Lean.Util.NumApps
+import Lean.Util.CacheStats
+import Lean.Util.ValueFile
@@ -0,0 +1,50 @@
+/-
+Copyright (c) 2024 Lean FRO, LLC. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+-/
+prelude
+import Init.System.IO
+
+namespace Lean
+
+/--
+Caches of the elaborator whose lookups are counted, and displayed by `lean --stats`.
+Must be kept in sync with `cache_stat` in `src/runtime/cache_stats.h`.
+-/
+inductive CacheStat where
+  | inferType
+  | whnf
+  | synthInstance
+  /-- Discrimination tree lookups; a hit is a lookup with a nonempty result. -/
+  | discrTree
+  /-- Counted by the runtime for each call of `instantiateMVars` on a term with metavariables. -/
+  | instantiateMVars
+  /-- The cache of simplification results of `simp`. -/
+  | simp
+  /-- Attempts to rewrite with a simp theorem; a hit is a successful rewrite. -/
+  | simpRewrite
+  /-- Calls of `Meta.isExprDefEq`; a hit is a call returning `true`. -/
+  | isDefEq
+
+/-- Records a lookup of the cache `stat`, and the time in nanoseconds spent on it. -/
+@[extern "lean_record_cache_stat"]
+opaque CacheStat.record (stat : CacheStat) (hit : Bool) (nanos : UInt64) : BaseIO Unit
+
+/-- Records a hit of the cache `stat`. -/
+@[inline] def CacheStat.recordHit [MonadLiftT BaseIO m] (stat : CacheStat) : m Unit :=
+  stat.record true 0
+
+/-- Runs the lookup `x` of `stat`, recording the time it took and whether its result `hit`s. -/
+@[inline] def CacheStat.time [Monad m] [MonadLiftT BaseIO m] (stat : CacheStat) (hit : α → Bool) (x : m α) : m α := do
+  let startTime ← IO.monoNanosNow
+  let a ← x
+  stat.record (hit a) ((← IO.monoNanosNow) - startTime).toUInt64
+  return a
+
+/-- Runs `x` on a miss of the cache `stat`, recording the time it took. -/
+@[inline] def CacheStat.recordMiss [Monad m] [MonadLiftT BaseIO m] [MonadFinally m] (stat : CacheStat)
+    (x : m α) : m α := do
+  let startTime ← IO.monoNanosNow
+  try x finally stat.record false ((← IO.monoNanosNow) - startTime).toUInt64
+
+end Lean
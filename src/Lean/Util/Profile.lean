@@ -23,10 +23,21 @@ register_builtin_option profiler.threshold : Nat := {
   descr    := "threshold in milliseconds, profiling times under threshold will not be reported individually"
 }
 
+register_builtin_option profiler.counters : Bool := {
+  defValue := false
+  group    := "profiler"
+  descr    := "add the hardware performance counters of each profiled component (instructions, cycles, cache misses, \
+branch misses) to the output of `profiler`, `--profile-json` and `trace.profiler.output`; Linux only"
+}
+
 @[export lean_get_profiler]
 private def get_profiler (o : Options) : Bool :=
   profiler.get o
 
+@[export lean_get_profiler_counters]
+private def get_profiler_counters (o : Options) : Bool :=
+  profiler.counters.get o
+
 @[export lean_get_profiler_threshold]
 def profiler.threshold.getSecs (o : Options) : Float :=
   (profiler.threshold.get o).toFloat / 1000
@@ -40,6 +51,25 @@ unsafe def profileitIOUnsafe {ε α : Type} (category : String) (opts : Options)
   | Except.ok a    => pure a
   | Except.error e => throw e
 
+/-- A run of a component profiled by `profileit`, recorded between `startProfileTracing` and `stopProfileTracing`. -/
+structure ProfiledRegion where
+  /-- Index of the thread that ran the component, in order of the threads' first recorded region. -/
+  thread   : Nat
+  category : String
+  /-- Declaration the region is attributed to, as in `--profile-json`. -/
+  decl     : Name
+  /-- Instructions, cycles, cache misses and branch misses of the region if `profiler.counters` is set,
+  including nested regions. -/
+  counters : Array UInt64
+  /-- Start time, in the clock of `IO.monoNanosNow`. -/
+  start    : UInt64
+  stop     : UInt64
+
+/-- Starts recording each run of a component profiled by `profileit`. -/
+@[extern "lean_start_profile_tracing"] opaque startProfileTracing : BaseIO Unit
+/-- Stops recording profiled components and returns the recorded runs. -/
+@[extern "lean_stop_profile_tracing"] opaque stopProfileTracing : BaseIO (Array ProfiledRegion)
+
 @[implemented_by profileitIOUnsafe]
 def profileitIO {ε α : Type} (category : String) (opts : Options) (act : EIO ε α) (decl := Name.anonymous) : EIO ε α := act
 
@@ -5,6 +5,7 @@ Authors: Sebastian Ullrich
 -/
 prelude
 import Lean.Util.Trace
+import Lean.Compiler.NameMangling
 
 /-! `trace.profiler.output` Firefox Profiler integration -/
 
@@ -67,6 +68,11 @@ deriving FromJson, ToJson
 structure RawMarkerTable where
   data : Array Json := #[]
   name : Array Json := #[]
+  startTime : Array (Option Milliseconds) := #[]
+  endTime : Array (Option Milliseconds) := #[]
+  /-- `0`: instant, `1`: interval -/
+  phase : Array Nat := #[]
+  category : Array Nat := #[]
   length : Nat := 0
 deriving FromJson, ToJson
 
@@ -319,4 +325,197 @@ def Profile.collide (ps : Array Profile) : Option Profile := do
   let thread := ps.map (·.threads) |>.flatten.foldl collideThreads { thread with }
   return { base with threads := #[thread.toThread] }
 
+/-! Samples of the native sampling profiler, see `IO.startSampling` -/
+
+/-- Returns the stack index of a frame named `funcName` called from the stack `parentStackIdx?`. -/
+private def addFrame (funcName : String) (parentStackIdx? : Option Nat) : StateM ThreadWithMaps Nat := do
+  let strIdx ← modifyGet fun thread =>
+    if let some idx := thread.stringMap[funcName]? then
+      (idx, thread)
+    else
+      (thread.stringMap.size, { thread with
+        stringArray := thread.stringArray.push funcName
+        stringMap := thread.stringMap.insert funcName thread.stringMap.size })
+  let funcIdx ← modifyGet fun thread =>
+    if let some idx := thread.funcMap[strIdx]? then
+      (idx, thread)
+    else
+      (thread.funcMap.size, { thread with
+        funcTable := {
+          name := thread.funcTable.name.push strIdx
+          resource := thread.funcTable.resource.push (-1)
+          fileName := thread.funcTable.fileName.push none
+          lineNumber := thread.funcTable.lineNumber.push none
+          columnNumber := thread.funcTable.columnNumber.push none
+          length := thread.funcTable.length + 1
+        }
+        frameTable := {
+          func := thread.frameTable.func.push thread.funcMap.size
+          length := thread.frameTable.length + 1
+        }
+        funcMap := thread.funcMap.insert strIdx thread.funcMap.size })
+  let frameIdx := funcIdx
+  modifyGet fun thread =>
+    if let some idx := thread.stackMap[(frameIdx, parentStackIdx?)]? then
+      (idx, thread)
+    else
+      (thread.stackMap.size,
+        -- imperative to preserve linear use of arrays here!
+        let ⟨⟨t1, t2, t3, t4, t5, stackTable, t7, t8, t9, t10⟩, o2, o3, stackMap, o5⟩ := thread
+        let { frame, «prefix», category, subcategory, length } := stackTable
+        let stackTable : StackTable := {
+          frame := frame.push frameIdx
+          «prefix» := prefix.push parentStackIdx?
+          category := category.push 0
+          subcategory := subcategory.push 0
+          length := length + 1
+        }
+        let stackMap := stackMap.insert (frameIdx, parentStackIdx?) stackMap.size
+        ⟨⟨t1, t2, t3, t4, t5, stackTable, t7, t8, t9, t10⟩, o2, o3, stackMap, o5⟩)
+
+/--
+Returns the frames of `sample`, outermost first. Compiled Lean functions are demangled, and the
+native frames of the IR interpreter are replaced with the functions it interprets. If the
+interpreter's own frames cannot be identified, e.g. in a binary without symbols, the interpreted
+functions are put on top of the stack.
+-/
+def sampleFrames (sample : IO.ProfileSample) : Array String := Id.run do
+  let mut frames : Array String := #[]
+  let mut interpreted := false
+  for sym in sample.native do
+    if (sym.splitOn "lean::ir::interpreter::").length > 1 then
+      unless interpreted do
+        frames := frames ++ sample.interpreted.map toString
+        interpreted := true
+    else
+      let name := (Name.demangle? sym).map toString |>.getD sym
+      frames := frames.push name
+  unless interpreted do
+    frames := frames ++ sample.interpreted.map toString
+  return frames
+
+private def addSample (interval : Milliseconds) (thread : ThreadWithMaps) (sample : IO.ProfileSample) :
+    ThreadWithMaps := Id.run do
+  let addFrames := (sampleFrames sample).foldlM (init := none) fun parent f => some <$> addFrame f parent
+  let (stackIdx?, thread) := addFrames.run thread
+  let some stackIdx := stackIdx? | return thread
+  -- imperative to preserve linear use of arrays here!
+  let ⟨⟨t1, t2, t3, samples, t5, t6, t7, t8, t9, t10⟩, o2, o3, o4, o5⟩ := thread
+  let ⟨stack, time, weight, weightType, length⟩ := samples
+  let samples : SamplesTable := {
+    stack := stack.push stackIdx
+    time := time.push (sample.time.toFloat / 1000000)
+    weight := weight.push interval
+    weightType
+    length := length + 1
+  }
+  return ⟨⟨t1, t2, t3, samples, t5, t6, t7, t8, t9, t10⟩, o2, o3, o4, o5⟩
+
+/--
+Adds the result of `IO.stopSampling` to `profile`, as one thread per sampled thread. Each sample is
+weighted with the sampling interval.
+-/
+def Profile.addSamples (profile : Profile) (samples : Array IO.ProfileSample)
+    (interval : Milliseconds) : Profile := Id.run do
+  let numThreads := samples.foldl (fun n s => max n (s.thread.toNat + 1)) 0
+  let mut threads : Array Thread := #[]
+  for i in [0:numThreads] do
+    let thread := Thread.new s!"native samples (thread {i})"
+    let thread := samples.foldl (init := ({ thread with isMainThread := false } : ThreadWithMaps))
+      fun thread s => if s.thread.toNat == i then addSample interval thread s else thread
+    threads := threads.push thread.toThread
+  return { profile with threads := profile.threads ++ threads }
+
+/-! Task runs recorded by `IO.startTaskTracing` -/
+
+/-- Schema of the markers added by `Profile.addTaskMarkers`. -/
+def taskMarkerSchema : Json := Json.mkObj [
+  ("name", "Task"),
+  ("display", toJson #["marker-chart", "marker-table", "timeline-overview"]),
+  ("data", toJson #[
+    Json.mkObj [("key", "priority"), ("label", "Priority"), ("format", "integer")],
+    Json.mkObj [("key", "queueMs"), ("label", "Time in queue"), ("format", "milliseconds")]
+  ])
+]
+
+/--
+Adds the result of `IO.stopTaskTracing` to `profile`, as one thread per thread that ran tasks, with
+an interval marker for each task run.
+-/
+def Profile.addTaskMarkers (profile : Profile) (events : Array IO.TaskEvent) : Profile := Id.run do
+  let numThreads := events.foldl (fun n e => max n (e.thread + 1)) 0
+  let mut threads : Array Thread := #[]
+  for i in [0:numThreads] do
+    let mut markers : RawMarkerTable := {}
+    for e in events do
+      if e.thread == i then
+        let ms (t : UInt64) : Milliseconds := t.toFloat / 1000000
+        markers := {
+          data := markers.data.push <| Json.mkObj [
+            ("type", "Task"), ("priority", toJson e.prio), ("queueMs", toJson (ms e.start - ms e.enqueued))]
+          name := markers.name.push (toJson 0)
+          startTime := markers.startTime.push (ms e.start)
+          endTime := markers.endTime.push (ms e.stop)
+          phase := markers.phase.push 1
+          category := markers.category.push 0
+          length := markers.length + 1
+        }
+    let thread := Thread.new s!"tasks (thread {i})"
+    threads := threads.push { thread with isMainThread := false, markers, stringArray := #["Task"] }
+  return { profile with
+    meta.markerSchema := profile.meta.markerSchema.push taskMarkerSchema
+    threads := profile.threads ++ threads }
+
+/-! Profiled components recorded by `startProfileTracing` -/
+
+/-- Schema of the markers added by `Profile.addRegionMarkers`. -/
+def regionMarkerSchema : Json := Json.mkObj [
+  ("name", "ProfiledRegion"),
+  ("display", toJson #["marker-chart", "marker-table", "timeline-overview"]),
+  ("data", toJson #[
+    Json.mkObj [("key", "decl"), ("label", "Declaration"), ("format", "string")],
+    Json.mkObj [("key", "instructions"), ("label", "Instructions"), ("format", "integer")],
+    Json.mkObj [("key", "cycles"), ("label", "Cycles"), ("format", "integer")],
+    Json.mkObj [("key", "ipc"), ("label", "IPC"), ("format", "decimal")],
+    Json.mkObj [("key", "cacheMisses"), ("label", "Cache misses"), ("format", "integer")],
+    Json.mkObj [("key", "branchMisses"), ("label", "Branch misses"), ("format", "integer")]
+  ])
+]
+
+/--
+Adds the result of `stopProfileTracing` to `profile`, as one thread per thread that ran profiled
+components, with an interval marker for each run carrying its hardware performance counters.
+-/
+def Profile.addRegionMarkers (profile : Profile) (regions : Array ProfiledRegion) : Profile := Id.run do
+  let numThreads := regions.foldl (fun n r => max n (r.thread + 1)) 0
+  let mut threads : Array Thread := #[]
+  for i in [0:numThreads] do
+    let mut markers : RawMarkerTable := {}
+    let mut stringArray : Array String := #[]
+    for r in regions do
+      if r.thread == i then
+        let ms (t : UInt64) : Milliseconds := t.toFloat / 1000000
+        let nameIdx := stringArray.indexOf? r.category |>.map (·.val) |>.getD stringArray.size
+        if nameIdx == stringArray.size then
+          stringArray := stringArray.push r.category
+        let counter (j : Nat) : UInt64 := r.counters[j]?.getD 0
+        let ipc : Float := if counter 1 == 0 then 0 else (counter 0).toFloat / (counter 1).toFloat
+        markers := {
+          data := markers.data.push <| Json.mkObj [
+            ("type", "ProfiledRegion"), ("decl", toString r.decl), ("instructions", toJson (counter 0).toNat),
+            ("cycles", toJson (counter 1).toNat), ("ipc", toJson ipc), ("cacheMisses", toJson (counter 2).toNat),
+            ("branchMisses", toJson (counter 3).toNat)]
+          name := markers.name.push (toJson nameIdx)
+          startTime := markers.startTime.push (ms r.start)
+          endTime := markers.endTime.push (ms r.stop)
+          phase := markers.phase.push 1
+          category := markers.category.push 0
+          length := markers.length + 1
+        }
+    let thread := Thread.new s!"profiled components (thread {i})"
+    threads := threads.push { thread with isMainThread := false, markers, stringArray }
+  return { profile with
+    meta.markerSchema := profile.meta.markerSchema.push regionMarkerSchema
+    threads := profile.threads ++ threads }
+
 end Lean.Firefox
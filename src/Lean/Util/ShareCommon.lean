@@ -5,6 +5,7 @@ Authors: Leonardo de Moura
 -/
 prelude
 import Init.ShareCommon
+import Init.System.IO
 import Std.Data.HashSet
 import Std.Data.HashMap
 import Lean.Data.PersistentHashMap
@@ -48,3 +49,15 @@ instance PShareCommonT.monadShareCommon [Monad m] : MonadShareCommon (PShareComm
 @[inline] def PShareCommonM.run : PShareCommonM α → α := PShareCommonT.run
 
 def shareCommon (a : α) : α := (withShareCommon a : ShareCommonM α).run
+
+/--
+Removes the values that are only referenced by the global hash-consing table used by
+`ShareCommon.shareCommonGlobal`, and returns how many were removed.
+The table is also pruned automatically as it grows.
+-/
+@[extern "lean_sharecommon_global_prune"]
+opaque pruneGlobal : BaseIO Nat
+
+/-- Returns the number of values in the global hash-consing table used by `ShareCommon.shareCommonGlobal`. -/
+@[extern "lean_sharecommon_global_size"]
+opaque numGlobalObjs : BaseIO Nat
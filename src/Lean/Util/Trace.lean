@@ -188,6 +188,22 @@ This is useful when we are interested in the time taken by specific subsystems i
 invocations, which is the common case."
 }
 
+register_builtin_option trace.profiler.output.sampleInterval : Nat := {
+  defValue := 0
+  group    := "profiler"
+  descr    :=
+    "if positive, additionally sample native and interpreter call stacks every given number of \
+microseconds of CPU time and add them to the `trace.profiler.output` file, see `IO.startSampling`"
+}
+
+register_builtin_option trace.profiler.output.tasks : Bool := {
+  defValue := false
+  group    := "profiler"
+  descr    :=
+    "if true, add a track per thread with the tasks it ran to the `trace.profiler.output` file, see \
+`IO.startTaskTracing`"
+}
+
 @[inline] private def withStartStop [Monad m] [MonadLiftT BaseIO m] (opts : Options) (act : m α) :
     m (α × Float × Float) := do
   if trace.profiler.useHeartbeats.get opts then
@@ -0,0 +1,50 @@
+/-
+Copyright (c) 2024 Lean FRO, LLC. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+-/
+prelude
+import Lean.Environment
+
+/-!
+# Value files
+
+`IO.saveValue` stores any Lean value in a file with the `object_compactor` that is also used for
+`.olean` files, and `IO.loadValue` maps it back into memory without parsing it. The file stores a
+fingerprint of the type of the value that is checked when loading it, as the file itself does not
+describe its contents. Use `IO.valueFingerprint` to derive one from the name of the type, and bump
+its `version` whenever the definition of the type changes.
+
+The value must not contain closures or external objects other than those of `Task`, `Thunk` and
+`IO.Ref`, which are supported by the compactor; the process panics otherwise.
+-/
+
+namespace IO
+open Lean
+
+/--
+A fingerprint for values of type `α`, derived from its name, `version`, and the Lean version, which
+determines the layout of the types of the standard library.
+-/
+def valueFingerprint (α : Type) [TypeName α] (version : UInt64 := 0) : UInt64 :=
+  mixHash (mixHash (hash (TypeName.typeName α)) version) (hash Lean.githash)
+
+/-- Stores `value` in `fname`, together with the fingerprint `fingerprint` of its type. -/
+@[extern "lean_save_value"]
+opaque saveValue {α : Type} (fname : @& System.FilePath) (fingerprint : UInt64) (value : @& α) : IO Unit
+
+/--
+Maps the value stored in `fname` by `saveValue` into memory. Fails if the file has been stored with
+a different fingerprint. The value is valid as long as the returned region is not freed.
+-/
+@[extern "lean_load_value"]
+opaque loadValueWithRegion {α : Type} (fname : @& System.FilePath) (fingerprint : UInt64) :
+    IO (α × CompactedRegion)
+
+/--
+Maps the value stored in `fname` by `saveValue` into memory. Fails if the file has been stored with
+a different fingerprint. The mapping is never freed.
+-/
+def loadValue {α : Type} (fname : System.FilePath) (fingerprint : UInt64) : IO α :=
+  return (← loadValueWithRegion fname fingerprint).1
+
+end IO
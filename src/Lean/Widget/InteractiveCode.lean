@@ -73,9 +73,67 @@ where
         }
         TaggedText.tag t (go subTt)
 
-def ppExprTagged (e : Expr) (explicit : Bool := false) : MetaM CodeWithInfos := do
-  if pp.raw.get (← getOptions) then
-    return .text (toString (← instantiateMVars e))
+/-- Everything the result of `ppExprTagged` depends on. -/
+private structure PPCacheKey where
+  e             : Expr
+  explicit      : Bool
+  env           : Environment
+  mctx          : MetavarContext
+  lctx          : LocalContext
+  options       : Options
+  currNamespace : Name
+  openDecls     : List OpenDecl
+
+/--
+Compares the contexts by pointer, as they are shared by the requests of a snapshot, and the
+expression structurally, as goals are instantiated anew for every request. The cheap checks come
+first, including the cached hash of the expression, so that misses rarely traverse it.
+-/
+private unsafe def PPCacheKey.beqUnsafe (a b : PPCacheKey) : Bool :=
+  a.explicit == b.explicit && ptrEq a.env b.env && ptrEq a.mctx b.mctx && ptrEq a.lctx b.lctx &&
+    a.e.hash == b.e.hash && a.currNamespace == b.currNamespace && a.options == b.options &&
+    a.openDecls == b.openDecls && (ptrEq a.e b.e || a.e == b.e)
+
+@[implemented_by PPCacheKey.beqUnsafe]
+private opaque PPCacheKey.beq (a b : PPCacheKey) : Bool
+
+/--
+Results of `ppExprTagged` for the most recently used environment, so that e.g. the goal view and
+hovers do not delaborate the same terms again. Holds at most `ppCacheSize` entries.
+-/
+private structure PPCache where
+  env     : Option Environment := none
+  entries : Array (PPCacheKey × CodeWithInfos) := #[]
+  /-- Index of the entry to be replaced next once `entries` is full. -/
+  next    : Nat := 0
+  deriving Inhabited
+
+private def ppCacheSize : Nat := 256
+
+builtin_initialize ppCacheRef : IO.Ref PPCache ← IO.mkRef {}
+
+private unsafe def ppCacheFindUnsafe? (key : PPCacheKey) : BaseIO (Option CodeWithInfos) := do
+  let cache ← ppCacheRef.get
+  unless cache.env.any (ptrEq · key.env) do
+    return none
+  return cache.entries.findSome? fun (k, c) => if k.beq key then some c else none
+
+@[implemented_by ppCacheFindUnsafe?]
+private opaque ppCacheFind? (key : PPCacheKey) : BaseIO (Option CodeWithInfos)
+
+private unsafe def ppCacheInsertUnsafe (key : PPCacheKey) (c : CodeWithInfos) : BaseIO Unit :=
+  ppCacheRef.modify fun cache =>
+    -- entries of other environments are dropped, which also releases their contexts
+    let cache := if cache.env.any (ptrEq · key.env) then cache else { env := some key.env }
+    if cache.entries.size < ppCacheSize then
+      { cache with entries := cache.entries.push (key, c) }
+    else
+      { cache with entries := cache.entries.set! cache.next (key, c), next := (cache.next + 1) % ppCacheSize }
+
+@[implemented_by ppCacheInsertUnsafe]
+private opaque ppCacheInsert (key : PPCacheKey) (c : CodeWithInfos) : BaseIO Unit
+
+private def ppExprTaggedCore (e : Expr) (explicit : Bool) : MetaM CodeWithInfos := do
   let delab := open PrettyPrinter.Delaborator in
     if explicit then
       withOptionAtCurrPos pp.tagAppFns.name true do
@@ -103,4 +161,26 @@ def ppExprTagged (e : Expr) (explicit : Bool := false) : MetaM CodeWithInfos :=
   }
   return tagCodeInfos ctx infos tt
 
+/--
+Delaborates `e` into code tagged with the infos of its subexpressions. Results are cached for the
+current environment, see `PPCache`.
+-/
+def ppExprTagged (e : Expr) (explicit : Bool := false) : MetaM CodeWithInfos := do
+  if pp.raw.get (← getOptions) then
+    return .text (toString (← instantiateMVars e))
+  let key : PPCacheKey := {
+    e, explicit
+    env           := (← getEnv)
+    mctx          := (← getMCtx)
+    lctx          := (← getLCtx)
+    options       := (← getOptions)
+    currNamespace := (← getCurrNamespace)
+    openDecls     := (← getOpenDecls)
+  }
+  if let some c ← ppCacheFind? key then
+    return c
+  let c ← ppExprTaggedCore e explicit
+  ppCacheInsert key c
+  return c
+
 end Lean.Widget
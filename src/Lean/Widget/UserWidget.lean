@@ -76,6 +76,8 @@ builtin_initialize moduleRegistry : ModuleRegistry ←
     addImportedFn := fun xss => xss.foldl (Array.foldl (fun s n => s.insert n.1 n.2)) ∅
     addEntryFn    := fun s n => s.insert n.1 n.2
     toArrayFn     := fun es => es.toArray
+    -- only used by the language server
+    lazyImport    := true
   }
 
 /-- Registers a widget module. Its type must implement `Lean.Widget.ToModule`. -/
@@ -8,3 +8,4 @@ import Std.Data
 import Std.Sat
 import Std.Tactic
 import Std.Internal
+import Std.Sync
@@ -14,3 +14,6 @@ import Std.Data.HashSet
 import Std.Data.DHashMap.RawLemmas
 import Std.Data.HashMap.RawLemmas
 import Std.Data.HashSet.RawLemmas
+
+import Std.Data.ConcurrentHashMap
+import Std.Data.SwissMap
@@ -0,0 +1,81 @@
+/-
+Copyright (c) 2024 Lean FRO, LLC. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+-/
+prelude
+import Init.System.IO
+
+/-!
+A hash map that can be shared and updated by concurrent tasks without a global lock.
+
+Entries are split into shards by hash, and each shard is guarded by its own lock in the runtime,
+so that tasks working on different keys rarely contend. This is meant for caches shared by many
+tasks, where `IO.Ref (Std.HashMap α β)` or an `IO.Mutex` guarded map serialize every access.
+Entries are never removed; the map is freed when it is no longer referenced.
+-/
+
+namespace Std
+
+private opaque ConcurrentHashMapImpl : NonemptyType.{0}
+
+/--
+Concurrent hash map with keys `α` and values `β`.
+
+Keys and values are marked as shared between threads when they are inserted.
+-/
+def ConcurrentHashMap (α β : Type) : Type := ConcurrentHashMapImpl.type
+
+instance : Nonempty (ConcurrentHashMap α β) := ConcurrentHashMapImpl.property
+
+namespace ConcurrentHashMap
+
+variable {α β : Type}
+
+/-- Creates a new empty concurrent hash map. -/
+@[extern "lean_concurrent_hash_map_new"]
+opaque new : BaseIO (ConcurrentHashMap α β)
+
+/-- The equality test is called while the shard is locked, so it must not access the map. -/
+@[extern "lean_concurrent_hash_map_find"]
+private opaque findCore (m : @& ConcurrentHashMap α β) (hash : UInt64) (eq : @& (α → α → Bool))
+  (a : @& α) : BaseIO (Option β)
+
+@[extern "lean_concurrent_hash_map_insert_if_absent"]
+private opaque insertIfAbsentCore (m : @& ConcurrentHashMap α β) (hash : UInt64) (eq : @& (α → α → Bool))
+  (a : α) (b : β) : BaseIO (Option β)
+
+/-- Returns the number of entries of the map. -/
+@[extern "lean_concurrent_hash_map_size"]
+opaque size (m : @& ConcurrentHashMap α β) : BaseIO Nat
+
+variable [BEq α] [Hashable α]
+
+/-- Returns the value associated with `a`, if any. -/
+@[inline] def find? (m : ConcurrentHashMap α β) (a : α) : BaseIO (Option β) :=
+  findCore m (hash a) (· == ·) a
+
+/--
+Associates `b` with `a` unless `a` is already present. Returns the value that was already
+associated with `a`, or `none` if `b` was inserted.
+-/
+@[inline] def insertIfAbsent (m : ConcurrentHashMap α β) (a : α) (b : β) : BaseIO (Option β) :=
+  insertIfAbsentCore m (hash a) (· == ·) a b
+
+/--
+Returns the value associated with `a`, computing and inserting it using `f` if `a` is not present.
+
+`f` runs without holding any lock, so concurrent calls for the same key may each run `f`. All of
+them return the value inserted first.
+-/
+@[inline] def computeIfAbsent [Monad m] [MonadLiftT BaseIO m] (map : ConcurrentHashMap α β) (a : α)
+    (f : Unit → m β) : m β := do
+  if let some b ← map.find? a then
+    return b
+  let b ← f ()
+  match (← map.insertIfAbsent a b) with
+  | some b' => return b'
+  | none    => return b
+
+end ConcurrentHashMap
+
+end Std
@@ -0,0 +1,381 @@
+/-
+Copyright (c) 2024 Lean FRO, LLC. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+-/
+prelude
+import Init.Data.ByteArray
+import Init.Data.Hashable
+import Init.Data.Nat.Power2
+
+set_option linter.missingDocs true
+set_option autoImplicit false
+
+/-!
+# Open-addressing hash maps
+
+This module defines `Std.SwissMap`, a hash map with the same core API as `Std.HashMap` that uses
+open addressing in the style of Swiss tables instead of separate chaining.
+
+The table consists of a power-of-two number of slots, each with a control byte stored in a
+`ByteArray`: `ctrlEmpty`, `ctrlDeleted`, or the low 7 bits of the hash of the entry in the slot.
+A lookup compares the control bytes of 16 slots at once using `ByteArray.match16` and only
+compares keys for the slots whose control byte matches, so most lookups touch a single key.
+Keys and values are stored densely in insertion order in two arrays, and each slot records the
+index of its entry. Unlike `Std.HashMap`, inserting an entry does not allocate a bucket node.
+
+No lemmas are provided for this type.
+-/
+
+universe u v w
+
+namespace Std
+
+/--
+Open-addressing hash maps, see the module documentation of `Std.Data.SwissMap`.
+
+The map should be used linearly to avoid copying its arrays.
+-/
+structure SwissMap (α : Type u) (β : Type v) where
+  /--
+  The control byte of each slot, followed by a copy of the first `SwissMap.groupSize` control bytes
+  so that the group starting at any slot can be loaded at once.
+  -/
+  ctrl  : ByteArray
+  /-- The index into `keys` and `vals` of the entry in each full slot. -/
+  slots : Array Nat
+  /-- The keys of the entries, in insertion order except for the moves done by `erase`. -/
+  keys  : Array α
+  /-- The values of the entries, such that `vals[i]` is associated with `keys[i]`. -/
+  vals  : Array β
+  /-- The number of slots that are not empty, i.e., that are full or deleted. -/
+  used  : Nat
+
+namespace SwissMap
+
+variable {α : Type u} {β : Type v}
+
+/-- The number of control bytes compared at once. -/
+def groupSize : Nat := 16
+
+/-- The control byte of a slot that has never been used. -/
+def ctrlEmpty : UInt8 := 0x80
+
+/-- The control byte of a slot whose entry was erased. -/
+def ctrlDeleted : UInt8 := 0xfe
+
+/-- The position in the table at which the probe sequence for `hash` starts. -/
+@[inline] private def h1 (hash : UInt64) : USize :=
+  (hash >>> 7).toUSize
+
+/-- The control byte of an entry with hash `hash`. -/
+@[inline] private def h2 (hash : UInt64) : UInt8 :=
+  (hash &&& 0x7f).toUInt8
+
+/-- The number of slots needed to hold `capacity` entries below the maximal load factor of 7/8. -/
+private def numSlotsFor (capacity : Nat) : Nat :=
+  max groupSize (capacity * 8 / 7 + 1).nextPowerOfTwo
+
+/-- Index of the lowest set bit of the nonzero mask `bits`. -/
+private def lowestBit (bits : UInt16) : USize :=
+  go bits 0 groupSize
+where
+  go (bits : UInt16) (j : USize) : Nat → USize
+    | 0 => j
+    | fuel + 1 => if bits &&& 1 != 0 then j else go (bits >>> 1) (j + 1) fuel
+
+/-- Sets the control byte of `slot` in a table with `numSlots` slots, including its copy. -/
+@[inline] private def setCtrl (ctrl : ByteArray) (numSlots : Nat) (slot : USize) (c : UInt8) : ByteArray :=
+  let ctrl := ctrl.set! slot.toNat c
+  if slot.toNat < groupSize then ctrl.set! (numSlots + slot.toNat) c else ctrl
+
+/-- Creates a table of empty slots that can hold `capacity` entries without resizing. -/
+private def emptyTable (capacity : Nat) : ByteArray × Array Nat :=
+  let numSlots := numSlotsFor capacity
+  (⟨mkArray (numSlots + groupSize) ctrlEmpty⟩, mkArray numSlots 0)
+
+/--
+Returns the first slot that is empty or deleted along the probe sequence of `hash`. Such a slot
+always exists because the load factor is kept below 1.
+-/
+private def findFree (ctrl : ByteArray) (numSlots : Nat) (hash : UInt64) : USize :=
+  let mask := numSlots.toUSize - 1
+  go mask (h1 hash &&& mask) 0 (numSlots / groupSize)
+where
+  go (mask pos step : USize) : Nat → USize
+    | 0 => pos
+    | fuel + 1 =>
+      let bits := ctrl.match16 pos ctrlEmpty ||| ctrl.match16 pos ctrlDeleted
+      if bits != 0 then
+        (pos + lowestBit bits) &&& mask
+      else
+        let step := step + groupSize.toUSize
+        go mask ((pos + step) &&& mask) step fuel
+
+/-- Creates an empty map with room for `capacity` entries before it needs to grow. -/
+@[inline] def empty (capacity := 8) : SwissMap α β :=
+  let (ctrl, slots) := emptyTable capacity
+  { ctrl, slots, keys := .mkEmpty capacity, vals := .mkEmpty capacity, used := 0 }
+
+instance : EmptyCollection (SwissMap α β) where
+  emptyCollection := empty
+
+instance : Inhabited (SwissMap α β) where
+  default := ∅
+
+/-- The number of entries in the map. -/
+@[inline] def size (m : SwissMap α β) : Nat :=
+  m.keys.size
+
+/-- Returns `true` if the map contains no entries. -/
+@[inline] def isEmpty (m : SwissMap α β) : Bool :=
+  m.keys.isEmpty
+
+section
+variable [BEq α] [Hashable α]
+
+/--
+Returns the slot and the entry index of the key `a` with hash `hash`, or `none` if `a` is not in
+the map.
+-/
+@[specialize] private def findEntry? (m : SwissMap α β) (a : α) (hash : UInt64) : Option (USize × Nat) :=
+  let mask := m.slots.usize - 1
+  go mask (h2 hash) (h1 hash &&& mask) 0 (m.slots.size / groupSize)
+where
+  go (mask : USize) (tag : UInt8) (pos step : USize) : Nat → Option (USize × Nat)
+    | 0 => none
+    | fuel + 1 =>
+      match check mask pos (m.ctrl.match16 pos tag) 0 groupSize with
+      | some r => some r
+      | none =>
+        -- an empty slot ends the probe sequence, as `a` would have been inserted there
+        if m.ctrl.match16 pos ctrlEmpty != 0 then
+          none
+        else
+          let step := step + groupSize.toUSize
+          go mask tag ((pos + step) &&& mask) step fuel
+  /-- Compares `a` with the keys of the slots `pos + j + i` where bit `i` of `bits` is set. -/
+  check (mask pos : USize) (bits : UInt16) (j : USize) : Nat → Option (USize × Nat)
+    | 0 => none
+    | fuel + 1 =>
+      if bits == 0 then
+        none
+      else if bits &&& 1 != 0 then
+        let slot := (pos + j) &&& mask
+        let e := m.slots[slot.toNat]!
+        if h : e < m.keys.size then
+          if m.keys[e] == a then some (slot, e) else check mask pos (bits >>> 1) (j + 1) fuel
+        else
+          check mask pos (bits >>> 1) (j + 1) fuel
+      else
+        check mask pos (bits >>> 1) (j + 1) fuel
+
+/--
+Returns the slot whose entry index is `e`, where `hash` is the hash of the key of the entry.
+-/
+private def findSlotOf (ctrl : ByteArray) (slots : Array Nat) (hash : UInt64) (e : Nat) : USize :=
+  let mask := slots.usize - 1
+  go mask (h2 hash) (h1 hash &&& mask) 0 (slots.size / groupSize)
+where
+  go (mask : USize) (tag : UInt8) (pos step : USize) : Nat → USize
+    | 0 => pos
+    | fuel + 1 =>
+      match check mask pos (ctrl.match16 pos tag) 0 groupSize with
+      | some slot => slot
+      | none =>
+        let step := step + groupSize.toUSize
+        go mask tag ((pos + step) &&& mask) step fuel
+  check (mask pos : USize) (bits : UInt16) (j : USize) : Nat → Option USize
+    | 0 => none
+    | fuel + 1 =>
+      if bits == 0 then
+        none
+      else
+        let slot := (pos + j) &&& mask
+        if bits &&& 1 != 0 && slots[slot.toNat]! == e then
+          some slot
+        else
+          check mask pos (bits >>> 1) (j + 1) fuel
+
+/--
+Rebuilds the table for the entries `keys` in a table with room for at least `capacity` entries,
+dropping all deleted slots.
+-/
+private def rebuild (keys : Array α) (capacity : Nat) : ByteArray × Array Nat := Id.run do
+  let (ctrl, slots) := emptyTable capacity
+  let numSlots := slots.size
+  let mut ctrl := ctrl
+  let mut slots := slots
+  for h : e in [0:keys.size] do
+    let hash := hash (keys[e]'h.2)
+    let slot := findFree ctrl numSlots hash
+    ctrl := setCtrl ctrl numSlots slot (h2 hash)
+    slots := slots.set! slot.toNat e
+  return (ctrl, slots)
+
+/-- Inserts the entry `(a, b)`, where `a` is not in the map and `hash` is the hash of `a`. -/
+private def insertNew (m : SwissMap α β) (a : α) (b : β) (hash : UInt64) : SwissMap α β :=
+  let ⟨ctrl, slots, keys, vals, used⟩ := m
+  let (ctrl, slots, used) :=
+    if (used + 1) * 8 > slots.size * 7 then
+      -- grow unless at least half of the used slots are deleted, in which case rebuilding in
+      -- place suffices
+      let (ctrl, slots) := rebuild keys (if keys.size * 2 ≥ used then 2 * (keys.size + 1) else keys.size + 1)
+      (ctrl, slots, keys.size)
+    else
+      (ctrl, slots, used)
+  let numSlots := slots.size
+  let slot := findFree ctrl numSlots hash
+  let used := if ctrl.get! slot.toNat == ctrlEmpty then used + 1 else used
+  { ctrl := setCtrl ctrl numSlots slot (h2 hash), slots := slots.set! slot.toNat keys.size,
+    keys := keys.push a, vals := vals.push b, used }
+
+/--
+Inserts the given mapping into the map. If there is already a mapping for the given key, then both
+key and value will be replaced.
+-/
+@[specialize] def insert (m : SwissMap α β) (a : α) (b : β) : SwissMap α β :=
+  let hash := hash a
+  match m.findEntry? a hash with
+  | some (_, e) =>
+    let ⟨ctrl, slots, keys, vals, used⟩ := m
+    { ctrl, slots, keys := keys.set! e a, vals := vals.set! e b, used }
+  | none => m.insertNew a b hash
+
+/-- If there is no mapping for the given key, inserts the given mapping into the map. Otherwise, returns the map unaltered. -/
+@[specialize] def insertIfNew (m : SwissMap α β) (a : α) (b : β) : SwissMap α β :=
+  let hash := hash a
+  match m.findEntry? a hash with
+  | some _ => m
+  | none => m.insertNew a b hash
+
+/-- Tries to retrieve the mapping for the given key, returning `none` if no such mapping is present. -/
+@[inline] def get? (m : SwissMap α β) (a : α) : Option β :=
+  match m.findEntry? a (hash a) with
+  | some (_, e) => m.vals[e]?
+  | none => none
+
+/-- Retrieves the mapping for the given key, returning `fallback` if no such mapping is present. -/
+@[inline] def getD (m : SwissMap α β) (a : α) (fallback : β) : β :=
+  (m.get? a).getD fallback
+
+/-- Tries to retrieve the mapping for the given key, panicking if no such mapping is present. -/
+@[inline] def get! [Inhabited β] (m : SwissMap α β) (a : α) : β :=
+  match m.get? a with
+  | some b => b
+  | none => panic! "key is not present in hash table"
+
+/-- Returns `true` if there is a mapping for the given key. -/
+@[inline] def contains (m : SwissMap α β) (a : α) : Bool :=
+  (m.findEntry? a (hash a)).isSome
+
+/--
+Modifies the value associated with the given key, if there is one. Otherwise, returns the map
+unaltered.
+-/
+@[specialize] def modify (m : SwissMap α β) (a : α) (f : β → β) : SwissMap α β :=
+  match m.findEntry? a (hash a) with
+  | some (_, e) =>
+    let ⟨ctrl, slots, keys, vals, used⟩ := m
+    { ctrl, slots, keys, vals := vals.modify e f, used }
+  | none => m
+
+/--
+Removes the mapping for the given key if it exists. The last entry in insertion order takes the
+place of the removed one.
+-/
+@[specialize] def erase (m : SwissMap α β) (a : α) : SwissMap α β :=
+  match m.findEntry? a (hash a) with
+  | none => m
+  | some (slot, e) =>
+    let ⟨ctrl, slots, keys, vals, used⟩ := m
+    let numSlots := slots.size
+    let ctrl := setCtrl ctrl numSlots slot ctrlDeleted
+    let last := keys.size - 1
+    if e == last then
+      { ctrl, slots, keys := keys.pop, vals := vals.pop, used }
+    else
+      let keys := keys.swap! e last
+      let slots :=
+        if h : e < keys.size then
+          slots.set! (findSlotOf ctrl slots (hash keys[e]) last).toNat e
+        else
+          slots
+      { ctrl, slots, keys := keys.pop, vals := (vals.swap! e last).pop, used }
+
+/-- Inserts multiple mappings into the map by iterating over the given collection and calling `insert`. -/
+@[inline] def insertMany {ρ : Type w} [ForIn Id ρ (α × β)] (m : SwissMap α β) (l : ρ) :
+    SwissMap α β := Id.run do
+  let mut m := m
+  for (a, b) in l do
+    m := m.insert a b
+  return m
+
+/-- Creates a map from a list of mappings. If the same key appears multiple times, the last occurrence takes precedence. -/
+@[inline] def ofList (l : List (α × β)) : SwissMap α β :=
+  (empty l.length).insertMany l
+
+end
+
+/-- Monadically computes a value by folding the given function over the mappings in the map in insertion order. -/
+@[inline] def foldM {m : Type w → Type w} [Monad m] {γ : Type w} (f : γ → α → β → m γ) (init : γ)
+    (b : SwissMap α β) : m γ :=
+  b.keys.size.foldM (init := init) fun i acc => do
+    match b.keys[i]?, b.vals[i]? with
+    | some a, some v => f acc a v
+    | _, _ => pure acc
+
+/-- Folds the given function over the mappings in the map in insertion order. -/
+@[inline] def fold {γ : Type w} (f : γ → α → β → γ) (init : γ) (b : SwissMap α β) : γ :=
+  Id.run (b.foldM f init)
+
+/-- Carries out a monadic action on each mapping in the map in insertion order. -/
+@[inline] def forM {m : Type w → Type w} [Monad m] (f : α → β → m PUnit) (b : SwissMap α β) :
+    m PUnit :=
+  b.foldM (fun _ a v => f a v) ⟨⟩
+
+/-- Support for the `for` loop construct in `do` blocks, iterating in insertion order. -/
+@[inline] def forIn {m : Type w → Type w} [Monad m] {γ : Type w}
+    (f : α → β → γ → m (ForInStep γ)) (init : γ) (b : SwissMap α β) : m γ := do
+  let mut acc := init
+  for a in b.keys, v in b.vals do
+    match (← f a v acc) with
+    | .done acc' => return acc'
+    | .yield acc' => acc := acc'
+  return acc
+
+instance {m : Type w → Type w} : ForM m (SwissMap α β) (α × β) where
+  forM m f := m.forM (fun a b => f (a, b))
+
+instance {m : Type w → Type w} : ForIn m (SwissMap α β) (α × β) where
+  forIn m init f := m.forIn (fun a b acc => f (a, b) acc) init
+
+/-- Transforms the map into a list of mappings in insertion order. -/
+@[inline] def toList (m : SwissMap α β) : List (α × β) :=
+  m.keys.toList.zip m.vals.toList
+
+/-- Transforms the map into an array of mappings in insertion order. -/
+@[inline] def toArray (m : SwissMap α β) : Array (α × β) :=
+  m.keys.zip m.vals
+
+/-- Returns a list of all keys present in the map in insertion order. -/
+@[inline] def keysList (m : SwissMap α β) : List α :=
+  m.keys.toList
+
+/-- Returns an array of all keys present in the map in insertion order. -/
+@[inline] def keysArray (m : SwissMap α β) : Array α :=
+  m.keys
+
+/-- Returns a list of all values present in the map in insertion order. -/
+@[inline] def values (m : SwissMap α β) : List β :=
+  m.vals.toList
+
+/-- Returns an array of all values present in the map in insertion order. -/
+@[inline] def valuesArray (m : SwissMap α β) : Array β :=
+  m.vals
+
+instance [Repr α] [Repr β] : Repr (SwissMap α β) where
+  reprPrec m prec := Repr.addAppParen ("Std.SwissMap.ofList " ++ reprArg m.toList) prec
+
+end SwissMap
+
+end Std
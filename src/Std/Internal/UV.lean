@@ -0,0 +1,27 @@
+/-
+Copyright (c) 2024 Lean FRO, LLC. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+-/
+prelude
+import Init.System.Promise
+
+/-!
+Asynchronous operations on the libuv event loop of the runtime (see `runtime/libuv.cpp`). Instead of
+blocking a thread, each operation returns an `IO.Promise` that is resolved by the event loop thread
+when the operation completes; combine its `result` with `IO.bindTask` and friends to continue.
+-/
+
+namespace Std.Internal.UV
+
+/-- Returns a promise that is resolved after `ms` milliseconds. -/
+@[extern "lean_uv_sleep"]
+opaque sleep (ms : UInt64) : IO (IO.Promise Unit)
+
+/--
+Reads the contents of the file at `fname`. The promise is resolved with the contents, or with the
+error that occurred when opening or reading the file.
+-/
+@[extern "lean_uv_read_bin_file"]
+opaque readBinFile (fname : @& System.FilePath) : IO (IO.Promise (Except IO.Error ByteArray))
+
+end Std.Internal.UV
@@ -0,0 +1,119 @@
+/-
+Copyright (c) 2024 Lean FRO, LLC. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+-/
+prelude
+import Init.System.Mutex
+
+/-!
+Reader-writer locks: any number of threads can hold a `SharedMutex` in shared mode at the same time,
+but a thread holding it in exclusive mode excludes all others. This is meant for state that is read
+much more often than it is written, where `IO.Mutex` would serialize all reads.
+
+A contended lock spins for a short while before the thread is parked using futexes on Linux,
+`WaitOnAddress` on Windows, and condition variables elsewhere. Threads waiting for the exclusive lock
+block new readers, so that writers are not starved.
+-/
+
+set_option linter.missingDocs true
+
+namespace Std
+
+private opaque BaseSharedMutexImpl : NonemptyType.{0}
+
+/--
+Reader-writer lock.
+
+If you want to guard shared state, use `SharedMutex α` instead.
+-/
+def BaseSharedMutex : Type := BaseSharedMutexImpl.type
+
+instance : Nonempty BaseSharedMutex := BaseSharedMutexImpl.property
+
+namespace BaseSharedMutex
+
+/-- Creates a new `BaseSharedMutex`. -/
+@[extern "lean_io_shared_mutex_new"]
+opaque new : BaseIO BaseSharedMutex
+
+/--
+Locks the mutex exclusively. Waits until no other thread holds it in either mode.
+
+Reentrant locking is undefined behavior.
+-/
+@[extern "lean_io_shared_mutex_lock"]
+opaque lock (mutex : @& BaseSharedMutex) : BaseIO Unit
+
+/-- Locks the mutex exclusively if no other thread holds it, without waiting. Returns `true` on success. -/
+@[extern "lean_io_shared_mutex_try_lock"]
+opaque tryLock (mutex : @& BaseSharedMutex) : BaseIO Bool
+
+/-- Locks the mutex exclusively, waiting at most `ms` milliseconds. Returns `true` on success. -/
+@[extern "lean_io_shared_mutex_try_lock_for"]
+opaque tryLockFor (mutex : @& BaseSharedMutex) (ms : UInt32) : BaseIO Bool
+
+/-- Unlocks a mutex that the current thread has locked exclusively. -/
+@[extern "lean_io_shared_mutex_unlock"]
+opaque unlock (mutex : @& BaseSharedMutex) : BaseIO Unit
+
+/--
+Locks the mutex in shared mode. Waits until no thread holds or waits for the exclusive lock.
+
+Reentrant locking is undefined behavior.
+-/
+@[extern "lean_io_shared_mutex_lock_shared"]
+opaque lockShared (mutex : @& BaseSharedMutex) : BaseIO Unit
+
+/-- Locks the mutex in shared mode if that is possible without waiting. Returns `true` on success. -/
+@[extern "lean_io_shared_mutex_try_lock_shared"]
+opaque tryLockShared (mutex : @& BaseSharedMutex) : BaseIO Bool
+
+/-- Locks the mutex in shared mode, waiting at most `ms` milliseconds. Returns `true` on success. -/
+@[extern "lean_io_shared_mutex_try_lock_shared_for"]
+opaque tryLockSharedFor (mutex : @& BaseSharedMutex) (ms : UInt32) : BaseIO Bool
+
+/-- Unlocks a mutex that the current thread has locked in shared mode. -/
+@[extern "lean_io_shared_mutex_unlock_shared"]
+opaque unlockShared (mutex : @& BaseSharedMutex) : BaseIO Unit
+
+end BaseSharedMutex
+
+/--
+Reader-writer lock guarding shared state of type `α`.
+
+Like `IO.Mutex α`, except that `atomicallyRead` only takes the lock in shared mode, so that several
+threads can read the state at the same time.
+-/
+structure SharedMutex (α : Type) where private mk ::
+  private ref : IO.Ref α
+  /-- The underlying lock. -/
+  mutex : BaseSharedMutex
+  deriving Nonempty
+
+namespace SharedMutex
+
+/-- Creates a new reader-writer lock guarding `a`. -/
+def new (a : α) : BaseIO (SharedMutex α) :=
+  return { ref := ← IO.mkRef a, mutex := ← BaseSharedMutex.new }
+
+/-- `mutex.atomically k` runs `k` with access to the state while holding the exclusive lock. -/
+def atomically [Monad m] [MonadLiftT BaseIO m] [MonadFinally m]
+    (mutex : SharedMutex α) (k : IO.AtomicT α m β) : m β := do
+  try
+    mutex.mutex.lock
+    k mutex.ref
+  finally
+    mutex.mutex.unlock
+
+/-- `mutex.atomicallyRead k` runs `k` on the state while holding the lock in shared mode. -/
+def atomicallyRead [Monad m] [MonadLiftT BaseIO m] [MonadFinally m]
+    (mutex : SharedMutex α) (k : α → m β) : m β := do
+  try
+    mutex.mutex.lockShared
+    k (← (mutex.ref.get : BaseIO α))
+  finally
+    mutex.mutex.unlockShared
+
+end SharedMutex
+
+end Std
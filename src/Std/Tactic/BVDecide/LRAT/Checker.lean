@@ -8,11 +8,13 @@ import Std.Tactic.BVDecide.LRAT.Actions
 import Std.Tactic.BVDecide.LRAT.Internal.Convert
 import Std.Tactic.BVDecide.LRAT.Internal.LRATChecker
 import Std.Tactic.BVDecide.LRAT.Internal.LRATCheckerSound
+import Std.Tactic.BVDecide.LRAT.Parser
 import Std.Sat.CNF
 
 /-!
 This module contains the implementation of the LRAT checker as well as a proof that the given
-CNF is unsat if the checker succeeds.
+CNF is unsat if the checker succeeds. `checkStream` checks a serialized proof while parsing it, so
+that neither the proof nor its parsed actions have to be held in memory as a whole.
 -/
 
 open Std.Sat
@@ -80,5 +82,61 @@ theorem check_sound (lratProof : Array IntAction) (cnf : CNF Nat) :
   apply CNF.unsat_of_convertLRAT_unsat
   assumption
 
+open Std.Tactic.BVDecide.LRAT.Internal in
+/--
+Convert an action of an LRAT proof as in `check`, discarding actions that cannot be converted and
+RAT additions whose pivot is not in the clause.
+-/
+def toWellFormedAction? (n : Nat) (action : IntAction) :
+    Option { a : DefaultClauseAction n // WellFormedAction a } :=
+  match intActionToDefaultClauseAction n action with
+  | none => none
+  | some (.addEmpty id rupHints) => some ⟨.addEmpty id rupHints, trivial⟩
+  | some (.addRup id c rupHints) => some ⟨.addRup id c rupHints, trivial⟩
+  | some (.del ids) => some ⟨.del ids, trivial⟩
+  | some (.addRat id c pivot rupHints ratHints) =>
+    if h : pivot ∈ Clause.toList c then
+      some ⟨.addRat id c pivot rupHints ratHints, (Clause.limplies_iff_mem pivot c).mpr h⟩
+    else
+      none
+
+open Std.Tactic.BVDecide.LRAT.Internal in
+/--
+Parse the next action of a serialized LRAT proof, see `checkStream`.
+-/
+def nextAction (n : Nat) (binary : Bool) (it : ByteArray.Iterator) :
+    Option (Option { a : DefaultClauseAction n // WellFormedAction a } × ByteArray.Iterator) :=
+  match Parser.parseNextAction binary it with
+  | .success it (some action) => some (toWellFormedAction? n action, it)
+  | _ => none
+
+open Std.Tactic.BVDecide.LRAT.Internal in
+/--
+Check whether the binary or non-binary LRAT proof `proof` is a valid certificate for the
+unsatisfiability of `cnf`. Unlike `check`, the proof is parsed action by action while checking it,
+so memory usage is bounded by the clauses of the formula that are alive at any point. Parsing stops
+at the first syntax error, after which the proof is rejected unless the empty clause was already
+derived.
+-/
+def checkStream (proof : ByteArray) (cnf : CNF Nat) : Bool :=
+  let internalFormula := CNF.convertLRAT cnf
+  let next := nextAction (cnf.numLiterals + 1) (Parser.isBinary proof)
+  -- every action takes at least one byte
+  let checkerResult := lratCheckerStream internalFormula next (proof.size + 1) proof.iter
+  checkerResult = .success
+
+open Std.Tactic.BVDecide.LRAT.Internal in
+/--
+If the `checkStream` functions succeeds on `proof` and `cnf` then the `cnf` is unsatisfiable.
+-/
+theorem checkStream_sound (proof : ByteArray) (cnf : CNF Nat) :
+    checkStream proof cnf → cnf.Unsat := by
+  intro h1
+  unfold checkStream at h1
+  simp only [decide_eq_true_eq] at h1
+  apply CNF.unsat_of_convertLRAT_unsat
+  exact lratCheckerStreamSound _ (CNF.convertLRAT_readyForRupAdd cnf)
+    (CNF.convertLRAT_readyForRatAdd cnf) _ _ _ h1
+
 end LRAT
 end Std.Tactic.BVDecide
@@ -392,6 +392,63 @@ eliminate every literal in the clause that is not compatible with the `assignmen
 def reduce (c : DefaultClause n) (assignments : Array Assignment) : ReduceResult (PosFin n) :=
   c.clause.foldl (reduce_fold_fn assignments) .reducedToEmpty
 
+/--
+Folds `reduce_fold_fn` over `ls` like `List.foldl`, but stops as soon as the result is
+`encounteredBoth` or `reducedToNonunit`, which `reduce_fold_fn` never leaves.
+-/
+def reduceEarly (assignments : Array Assignment) :
+    List (Literal (PosFin n)) → ReduceResult (PosFin n) → ReduceResult (PosFin n)
+  | [], acc => acc
+  | l :: ls, acc =>
+    match reduce_fold_fn assignments acc l with
+    | .encounteredBoth => .encounteredBoth
+    | .reducedToNonunit => .reducedToNonunit
+    | acc => reduceEarly assignments ls acc
+
+theorem foldl_reduce_fold_fn_encounteredBoth (assignments : Array Assignment)
+    (ls : List (Literal (PosFin n))) :
+    ls.foldl (reduce_fold_fn assignments) .encounteredBoth = .encounteredBoth := by
+  induction ls with
+  | nil => rfl
+  | cons l ls ih =>
+    simp only [List.foldl_cons, reduce_fold_fn]
+    exact ih
+
+theorem foldl_reduce_fold_fn_reducedToNonunit (assignments : Array Assignment)
+    (ls : List (Literal (PosFin n))) :
+    ls.foldl (reduce_fold_fn assignments) .reducedToNonunit = .reducedToNonunit := by
+  induction ls with
+  | nil => rfl
+  | cons l ls ih =>
+    simp only [List.foldl_cons, reduce_fold_fn]
+    exact ih
+
+theorem reduceEarly_eq_foldl (assignments : Array Assignment) (ls : List (Literal (PosFin n)))
+    (acc : ReduceResult (PosFin n)) :
+    reduceEarly assignments ls acc = ls.foldl (reduce_fold_fn assignments) acc := by
+  induction ls generalizing acc with
+  | nil => rfl
+  | cons l ls ih =>
+    simp only [reduceEarly, List.foldl_cons]
+    generalize reduce_fold_fn assignments acc l = acc'
+    cases acc' with
+    | encounteredBoth => simp only [foldl_reduce_fold_fn_encounteredBoth]
+    | reducedToNonunit => simp only [foldl_reduce_fold_fn_reducedToNonunit]
+    | reducedToEmpty => exact ih _
+    | reducedToUnit l' => exact ih _
+
+/--
+The implementation of `reduce`: clauses that a RAT or failing RUP check reduces to a non-unit are
+only traversed up to their second unrefuted literal.
+-/
+def reduceImpl (c : DefaultClause n) (assignments : Array Assignment) : ReduceResult (PosFin n) :=
+  reduceEarly assignments c.clause .reducedToEmpty
+
+@[csimp]
+theorem reduce_eq_reduceImpl : @reduce = @reduceImpl := by
+  funext n c assignments
+  simp only [reduce, reduceImpl, reduceEarly_eq_foldl]
+
 instance : Clause (PosFin n) (DefaultClause n) where
   toList := toList
   not_tautology := not_tautology
@@ -6,6 +6,7 @@ Authors: Josh Clune
 prelude
 import Std.Tactic.BVDecide.LRAT.Actions
 import Std.Tactic.BVDecide.LRAT.Internal.Formula.Class
+import Std.Tactic.BVDecide.LRAT.Internal.Actions
 
 namespace Std.Tactic.BVDecide
 namespace LRAT
@@ -50,6 +51,41 @@ def lratChecker [DecidableEq α] [Clause α β] [Entails α σ] [Formula α β 
       .rupFailure
   | .del ids :: restPrf => lratChecker (delete f ids) restPrf
 
+/--
+Like `lratChecker`, but reads the proof action by action from a stream, so that the proof never has
+to be held in memory as a whole. `next s` returns the next action and the rest of the stream, or
+`none` at its end. Actions that are not well-formed are returned as `some (none, s')` and skipped.
+At most `fuel` actions are read.
+-/
+def lratCheckerStream [DecidableEq α] [Clause α β] [Entails α σ] [Formula α β σ] (f : σ)
+    (next : ρ → Option (Option { a : Action β α // WellFormedAction a } × ρ)) (fuel : Nat) (s : ρ) :
+    Result :=
+  match fuel with
+  | 0 => .outOfProof
+  | fuel + 1 =>
+    match next s with
+    | none => .outOfProof
+    | some (none, s) => lratCheckerStream f next fuel s
+    | some (some ⟨.addEmpty _ rupHints, _⟩, _) =>
+      let (_, checkSuccess) := performRupAdd f Clause.empty rupHints
+      if checkSuccess then
+        .success
+      else
+        .rupFailure
+    | some (some ⟨.addRup _ c rupHints, _⟩, s) =>
+      let (f, checkSuccess) := performRupAdd f c rupHints
+      if checkSuccess then
+        lratCheckerStream f next fuel s
+      else
+        .rupFailure
+    | some (some ⟨.addRat _ c pivot rupHints ratHints, _⟩, s) =>
+      let (f, checkSuccess) := performRatAdd f c pivot rupHints ratHints
+      if checkSuccess then
+        lratCheckerStream f next fuel s
+      else
+        .rupFailure
+    | some (some ⟨.del ids, _⟩, s) => lratCheckerStream (delete f ids) next fuel s
+
 end Internal
 end LRAT
 end Std.Tactic.BVDecide
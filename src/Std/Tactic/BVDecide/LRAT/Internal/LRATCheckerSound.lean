@@ -147,6 +147,40 @@ theorem lratCheckerSound [DecidableEq α] [Clause α β] [Entails α σ] [Formul
       rw [← hprf.2] at h
       exact delCaseSound f f_readyForRupAdd f_readyForRatAdd ids restPrf restPrfWellFormed ih h
 
+/--
+The well-formed actions that `lratCheckerStream` reads from `next` if it does not stop early.
+-/
+def streamToList [Clause α β] (next : ρ → Option (Option { a : Action β α // WellFormedAction a } × ρ)) :
+    Nat → ρ → List { a : Action β α // WellFormedAction a }
+  | 0, _ => []
+  | fuel + 1, s =>
+    match next s with
+    | none => []
+    | some (none, s) => streamToList next fuel s
+    | some (some a, s) => a :: streamToList next fuel s
+
+theorem lratCheckerStream_eq [DecidableEq α] [Clause α β] [Entails α σ] [Formula α β σ] (f : σ)
+    (next : ρ → Option (Option { a : Action β α // WellFormedAction a } × ρ)) (fuel : Nat) (s : ρ) :
+    lratCheckerStream f next fuel s = lratChecker f ((streamToList next fuel s).map Subtype.val) := by
+  induction fuel generalizing f s with
+  | zero => simp [lratCheckerStream, streamToList, lratChecker]
+  | succ fuel ih =>
+    unfold lratCheckerStream streamToList
+    rcases next s with _ | ⟨_ | ⟨a, ha⟩, s'⟩
+    · simp [lratChecker]
+    · simp [ih]
+    · cases a <;> simp [lratChecker, ih]
+
+theorem lratCheckerStreamSound [DecidableEq α] [Clause α β] [Entails α σ] [Formula α β σ] (f : σ)
+    (f_readyForRupAdd : ReadyForRupAdd f) (f_readyForRatAdd : ReadyForRatAdd f)
+    (next : ρ → Option (Option { a : Action β α // WellFormedAction a } × ρ)) (fuel : Nat) (s : ρ) :
+    lratCheckerStream f next fuel s = success → Unsatisfiable α f := by
+  rw [lratCheckerStream_eq]
+  apply lratCheckerSound f f_readyForRupAdd f_readyForRatAdd
+  intro a h
+  rcases List.mem_map.mp h with ⟨b, _, rfl⟩
+  exact b.property
+
 end Internal
 end LRAT
 end Std.Tactic.BVDecide
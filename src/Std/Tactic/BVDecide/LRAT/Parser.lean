@@ -145,6 +145,21 @@ where
       else
         go actions
 
+/--
+Parse the next action, skipping comments, or return `none` at the end of the input.
+-/
+partial def parseNextAction : Parser (Option IntAction) := do
+  if ← isEof then
+    return none
+  else if (← peek!) == 'c'.toUInt8 then
+    let _ ← many (satisfy (fun c => c != '\n'.toUInt8 && c != '\r'.toUInt8))
+    skipNewline
+    parseNextAction
+  else
+    let action ← parseAction
+    skipNewline
+    return some action
+
 end Text
 
 namespace Binary
@@ -267,8 +282,23 @@ def parseActions : Parser (Array IntAction) := do
   eof
   return actions
 
+/--
+Parse the next action, or return `none` at the end of the input.
+-/
+def parseNextAction : Parser (Option IntAction) := do
+  if ← isEof then
+    return none
+  else
+    some <$> parseAction
+
 end Binary
 
+/--
+Whether `proof` is in the binary LRAT format, judging by its first byte.
+-/
+def isBinary (proof : ByteArray) : Bool :=
+  proof.size > 0 && (proof[0]! == 'a'.toUInt8 || proof[0]! == 'd'.toUInt8)
+
 /--
 Based on the first byte parses the input either as a binary or non-binary LRAT.
 -/
@@ -279,6 +309,16 @@ def parseActions : Parser (Array IntAction) := do
   else
     Text.parseActions
 
+/--
+Parse the next action of an LRAT proof in the binary or non-binary format, or return `none` at the
+end of the input. Used to check proofs without parsing them as a whole, see `LRAT.checkStream`.
+-/
+def parseNextAction (binary : Bool) : Parser (Option IntAction) :=
+  if binary then
+    Binary.parseNextAction
+  else
+    Text.parseNextAction
+
 end Parser
 
 /--
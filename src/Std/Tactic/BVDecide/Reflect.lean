@@ -148,17 +148,12 @@ open Std.Sat
 Verify that a proof certificate is valid for a given formula.
 -/
 def verifyCert (cnf : CNF Nat) (cert : String) : Bool :=
-  match LRAT.parseLRATProof cert.toUTF8 with
-  | .ok lratProof => LRAT.check lratProof cnf
-  | .error _ => false
+  LRAT.checkStream cert.toUTF8 cnf
 
 theorem verifyCert_correct : ∀ cnf cert, verifyCert cnf cert = true → cnf.Unsat := by
   intro c b h1
   unfold verifyCert at h1
-  split at h1
-  . apply LRAT.check_sound
-    assumption
-  . contradiction
+  exact LRAT.checkStream_sound _ _ h1
 
 /--
 Verify that `cert` is an UNSAT proof for the SAT problem obtained by bitblasting `bv`.
@@ -3,5 +3,13 @@ CXX ?= c++
 %.o: src/%.cpp
 	$(CXX) -std=c++11 -O3 -DNDEBUG -DNBUILD $(CXXFLAGS) -c $< -o $@
 
+all: ../../cadical$(CMAKE_EXECUTABLE_SUFFIX) ../../libcadical.a
+
 ../../cadical$(CMAKE_EXECUTABLE_SUFFIX): $(patsubst src/%.cpp,%.o,$(shell ls src/*.cpp | grep -v mobical))
 	$(CXX) -o $@ $^
+
+# the solver library linked into Lean with `-DLINK_CADICAL=ON`; `cadical.cpp` and `mobical.cpp` only contain the
+# `main` functions of the binaries
+../../libcadical.a: $(patsubst src/%.cpp,%.o,$(shell ls src/*.cpp | grep -v 'mobical\|cadical.cpp'))
+	rm -f $@
+	$(AR) rcs $@ $^
@@ -199,6 +199,20 @@ typedef struct {
 
 struct lean_task;
 
+/* Bytes allocated by a task and by the tasks spawned while it was running, which share its account. */
+typedef struct {
+    _Atomic(size_t)   m_rc;
+    _Atomic(uint64_t) m_bytes;
+} lean_task_memory_account;
+
+/* Cancellation scope shared by the tasks spawned while it was active, see `IO.CancelScope`.
+   A scope is canceled if it or one of its parents is canceled. */
+typedef struct lean_cancel_scope {
+    _Atomic(size_t)            m_rc;
+    _Atomic(uint8_t)           m_canceled;
+    struct lean_cancel_scope * m_parent;
+} lean_cancel_scope;
+
 /* Data required for executing a Lean task. It is released as soon as
    the task terminates even if the task object itself is still referenced. */
 typedef struct {
@@ -210,6 +224,13 @@ typedef struct {
     // If true, task will not be freed until finished
     uint8_t              m_keep_alive;
     uint8_t              m_deleted;
+    /* Time of the last time the task was queued, in nanoseconds, used by the task manager's telemetry */
+    uint64_t             m_enqueue_time;
+    lean_task_memory_account * m_mem_account;
+    /* `nullptr` if the task was not spawned inside a cancellation scope */
+    lean_cancel_scope *        m_cancel_scope;
+    /* Task this task is registered as a dependent of, if any; used for priority inheritance */
+    struct lean_task *         m_awaited;
 } lean_task_imp;
 
 /* Object of type `Task _`. The lifetime of a `lean_task` object can be represented as a state machine with atomic
@@ -301,6 +322,12 @@ LEAN_EXPORT LEAN_NORETURN void lean_internal_panic_out_of_memory(void);
 LEAN_EXPORT LEAN_NORETURN void lean_internal_panic_unreachable(void);
 LEAN_EXPORT LEAN_NORETURN void lean_internal_panic_rc_overflow(void);
 
+/* Stack segments: the code emitted for recursive functions calls `lean_stack_is_low` on entry and, if it returns
+   true, continues the call on a freshly allocated stack segment via `lean_run_on_stack_segment`, which calls
+   `fn(arg)` there. Threads can thus start with small stacks that grow on demand. */
+LEAN_EXPORT bool lean_stack_is_low(void);
+LEAN_EXPORT void lean_run_on_stack_segment(void (*fn)(void *), void * arg);
+
 static inline size_t lean_align(size_t v, size_t a) {
     return (v / a)*a + a * (v % a != 0);
 }
@@ -447,9 +474,33 @@ static inline void lean_dec_ref(lean_object * o) {
         lean_dec_ref_cold(o);
     }
 }
+
+/* Address range of the "region window", a part of the address space reserved for mmapped compacted regions
+   (i.e., `.olean` files), see `runtime/compact.h`. The range is empty until the first region is mapped into it. */
+extern LEAN_EXPORT size_t lean_region_window_base;
+extern LEAN_EXPORT size_t lean_region_window_size;
+
+/* Return true iff `o` is a scalar or an object in the region window. Neither needs reference counting,
+   and we can tell without loading the object header. */
+static inline bool lean_is_scalar_or_region_obj(lean_object * o) {
+    return lean_is_scalar(o) || (size_t)(o) - lean_region_window_base < lean_region_window_size;
+}
+
+static inline void lean_inc_skip_region(lean_object * o) { if (!lean_is_scalar_or_region_obj(o)) lean_inc_ref(o); }
+static inline void lean_inc_n_skip_region(lean_object * o, size_t n) { if (!lean_is_scalar_or_region_obj(o)) lean_inc_ref_n(o, n); }
+static inline void lean_dec_skip_region(lean_object * o) { if (!lean_is_scalar_or_region_obj(o)) lean_dec_ref(o); }
+
+/* Code that mostly traverses imported data (e.g., `Meta` code over `Expr`s) can be compiled with
+   `-DLEAN_REGION_RC_CHECK` to skip the RC operations on such data with a single address comparison. */
+#ifdef LEAN_REGION_RC_CHECK
+static inline void lean_inc(lean_object * o) { lean_inc_skip_region(o); }
+static inline void lean_inc_n(lean_object * o, size_t n) { lean_inc_n_skip_region(o, n); }
+static inline void lean_dec(lean_object * o) { lean_dec_skip_region(o); }
+#else
 static inline void lean_inc(lean_object * o) { if (!lean_is_scalar(o)) lean_inc_ref(o); }
 static inline void lean_inc_n(lean_object * o, size_t n) { if (!lean_is_scalar(o)) lean_inc_ref_n(o, n); }
 static inline void lean_dec(lean_object * o) { if (!lean_is_scalar(o)) lean_dec_ref(o); }
+#endif
 
 static inline bool lean_is_ctor(lean_object * o) { return lean_ptr_tag(o) <= LeanMaxCtorTag; }
 static inline bool lean_is_closure(lean_object * o) { return lean_ptr_tag(o) == LeanClosure; }
@@ -499,6 +550,25 @@ static inline bool lean_is_shared(lean_object * o) {
 LEAN_EXPORT void lean_mark_mt(lean_object * o);
 LEAN_EXPORT void lean_mark_persistent(lean_object * o);
 
+LEAN_EXPORT lean_object * lean_init_closed_term(lean_object ** p, lean_object * (*init)(void));
+
+/* Returns the closed term stored in `*p`, computing it with `init` and marking it persistent on first
+   access. Modules compiled with `LEAN_LAZY_CLOSED_TERMS` access their closed terms this way instead of
+   initializing all of them at startup. */
+static inline lean_object * lean_get_closed_term(lean_object ** p, lean_object * (*init)(void)) {
+#if defined(__GNUC__) || defined(__clang__)
+    lean_object * v = __atomic_load_n(p, __ATOMIC_ACQUIRE);
+    if (LEAN_LIKELY(v != NULL)) return v;
+#endif
+    return lean_init_closed_term(p, init);
+}
+
+#ifdef LEAN_LAZY_CLOSED_TERMS
+#define LEAN_CLOSED_TERM(x, init) lean_get_closed_term(&(x), (init))
+#else
+#define LEAN_CLOSED_TERM(x, init) (x)
+#endif
+
 static inline void lean_set_st_header(lean_object * o, unsigned tag, unsigned other) {
     o->m_rc       = 1;
     o->m_tag      = tag;
@@ -562,6 +632,21 @@ static inline void lean_ctor_set_tag(b_lean_obj_arg o, uint8_t new_tag) {
     o->m_tag = new_tag;
 }
 
+/* Update the header of the exclusive constructor object `o`, whose memory is reused for a constructor
+   with a different tag or number of fields of the same small object size, see `lean_alloc_ctor_memory`. */
+static inline void lean_ctor_set_layout(b_lean_obj_arg o, uint8_t new_tag, unsigned num_objs, unsigned scalar_sz) {
+    assert(new_tag <= LeanMaxCtorTag);
+    unsigned sz  = sizeof(lean_ctor_object) + sizeof(void*)*num_objs + scalar_sz;
+    unsigned sz1 = lean_align(sz, LEAN_OBJECT_SIZE_DELTA);
+    o->m_tag   = new_tag;
+    o->m_other = num_objs;
+    if (sz1 > sz) {
+        /* Initialize last word, as `lean_alloc_ctor_memory` does. */
+        size_t * end = (size_t*)(((char*)o) + sz1);
+        end[-1] = 0;
+    }
+}
+
 static inline void lean_ctor_release(b_lean_obj_arg o, unsigned i) {
     assert(i < lean_ctor_num_objs(o));
     lean_object ** objs = lean_ctor_obj_cptr(o);
@@ -859,6 +944,12 @@ LEAN_EXPORT lean_obj_res lean_byte_array_mk(lean_obj_arg a);
 LEAN_EXPORT lean_obj_res lean_byte_array_data(lean_obj_arg a);
 LEAN_EXPORT lean_obj_res lean_copy_byte_array(lean_obj_arg a);
 LEAN_EXPORT uint64_t lean_byte_array_hash(b_lean_obj_arg a);
+LEAN_EXPORT lean_obj_res lean_byte_array_find(b_lean_obj_arg a, uint8_t b, b_lean_obj_arg start);
+LEAN_EXPORT uint16_t lean_byte_array_match16(b_lean_obj_arg a, size_t i, uint8_t b);
+LEAN_EXPORT bool lean_byte_array_beq(b_lean_obj_arg a, b_lean_obj_arg b);
+LEAN_EXPORT uint8_t lean_byte_array_compare(b_lean_obj_arg a, b_lean_obj_arg b);
+LEAN_EXPORT lean_obj_res lean_byte_array_xor(lean_obj_arg a, b_lean_obj_arg b);
+LEAN_EXPORT lean_obj_res lean_byte_array_fill(lean_obj_arg a, uint8_t b);
 
 static inline lean_obj_res lean_mk_empty_byte_array(b_lean_obj_arg capacity) {
     if (!lean_is_scalar(capacity)) lean_internal_panic_out_of_memory();
@@ -918,6 +1009,16 @@ static inline lean_obj_res lean_byte_array_fset(lean_obj_arg a, b_lean_obj_arg i
 LEAN_EXPORT lean_obj_res lean_float_array_mk(lean_obj_arg a);
 LEAN_EXPORT lean_obj_res lean_float_array_data(lean_obj_arg a);
 LEAN_EXPORT lean_obj_res lean_copy_float_array(lean_obj_arg a);
+LEAN_EXPORT lean_obj_res lean_float_array_add(lean_obj_arg a, b_lean_obj_arg b);
+LEAN_EXPORT lean_obj_res lean_float_array_sub(lean_obj_arg a, b_lean_obj_arg b);
+LEAN_EXPORT lean_obj_res lean_float_array_mul(lean_obj_arg a, b_lean_obj_arg b);
+LEAN_EXPORT lean_obj_res lean_float_array_div(lean_obj_arg a, b_lean_obj_arg b);
+LEAN_EXPORT lean_obj_res lean_float_array_scale(lean_obj_arg a, double c);
+LEAN_EXPORT lean_obj_res lean_float_array_shift(lean_obj_arg a, double c);
+LEAN_EXPORT double lean_float_array_sum(b_lean_obj_arg a);
+LEAN_EXPORT double lean_float_array_dot(b_lean_obj_arg a, b_lean_obj_arg b);
+LEAN_EXPORT double lean_float_array_minimum(b_lean_obj_arg a);
+LEAN_EXPORT double lean_float_array_maximum(b_lean_obj_arg a);
 
 static inline lean_obj_res lean_mk_empty_float_array(b_lean_obj_arg capacity) {
     if (!lean_is_scalar(capacity)) lean_internal_panic_out_of_memory();
@@ -978,6 +1079,136 @@ static inline lean_obj_res lean_float_array_set(lean_obj_arg a, b_lean_obj_arg i
     }
 }
 
+/* UInt32Array */
+
+LEAN_EXPORT lean_obj_res lean_uint32_array_mk(lean_obj_arg a);
+LEAN_EXPORT lean_obj_res lean_uint32_array_data(lean_obj_arg a);
+LEAN_EXPORT lean_obj_res lean_copy_uint32_array(lean_obj_arg a);
+
+static inline lean_obj_res lean_mk_empty_uint32_array(b_lean_obj_arg capacity) {
+    if (!lean_is_scalar(capacity)) lean_internal_panic_out_of_memory();
+    return lean_alloc_sarray(sizeof(uint32_t), 0, lean_unbox(capacity)); // NOLINT
+}
+
+static inline lean_obj_res lean_uint32_array_size(b_lean_obj_arg a) {
+    return lean_box(lean_sarray_size(a));
+}
+
+static inline uint32_t * lean_uint32_array_cptr(b_lean_obj_arg a) {
+    return (uint32_t*)(lean_sarray_cptr(a)); // NOLINT
+}
+
+static inline uint32_t lean_uint32_array_uget(b_lean_obj_arg a, size_t i) {
+    return lean_uint32_array_cptr(a)[i];
+}
+
+static inline uint32_t lean_uint32_array_fget(b_lean_obj_arg a, b_lean_obj_arg i) {
+    return lean_uint32_array_uget(a, lean_unbox(i));
+}
+
+static inline uint32_t lean_uint32_array_get(b_lean_obj_arg a, b_lean_obj_arg i) {
+    if (lean_is_scalar(i)) {
+        size_t idx = lean_unbox(i);
+        return idx < lean_sarray_size(a) ? lean_uint32_array_uget(a, idx) : 0;
+    } else {
+        /* The index must be out of bounds. Otherwise we would be out of memory. */
+        return 0;
+    }
+}
+
+LEAN_EXPORT lean_obj_res lean_uint32_array_push(lean_obj_arg a, uint32_t v);
+
+static inline lean_obj_res lean_uint32_array_uset(lean_obj_arg a, size_t i, uint32_t v) {
+    lean_obj_res r;
+    if (lean_is_exclusive(a)) r = a;
+    else r = lean_copy_uint32_array(a);
+    uint32_t * it = lean_uint32_array_cptr(r) + i;
+    *it = v;
+    return r;
+}
+
+static inline lean_obj_res lean_uint32_array_fset(lean_obj_arg a, b_lean_obj_arg i, uint32_t v) {
+    return lean_uint32_array_uset(a, lean_unbox(i), v);
+}
+
+static inline lean_obj_res lean_uint32_array_set(lean_obj_arg a, b_lean_obj_arg i, uint32_t v) {
+    if (!lean_is_scalar(i)) {
+        return a;
+    } else {
+        size_t idx = lean_unbox(i);
+        if (idx >= lean_sarray_size(a)) {
+            return a;
+        } else {
+            return lean_uint32_array_uset(a, idx, v);
+        }
+    }
+}
+
+/* UInt64Array */
+
+LEAN_EXPORT lean_obj_res lean_uint64_array_mk(lean_obj_arg a);
+LEAN_EXPORT lean_obj_res lean_uint64_array_data(lean_obj_arg a);
+LEAN_EXPORT lean_obj_res lean_copy_uint64_array(lean_obj_arg a);
+
+static inline lean_obj_res lean_mk_empty_uint64_array(b_lean_obj_arg capacity) {
+    if (!lean_is_scalar(capacity)) lean_internal_panic_out_of_memory();
+    return lean_alloc_sarray(sizeof(uint64_t), 0, lean_unbox(capacity)); // NOLINT
+}
+
+static inline lean_obj_res lean_uint64_array_size(b_lean_obj_arg a) {
+    return lean_box(lean_sarray_size(a));
+}
+
+static inline uint64_t * lean_uint64_array_cptr(b_lean_obj_arg a) {
+    return (uint64_t*)(lean_sarray_cptr(a)); // NOLINT
+}
+
+static inline uint64_t lean_uint64_array_uget(b_lean_obj_arg a, size_t i) {
+    return lean_uint64_array_cptr(a)[i];
+}
+
+static inline uint64_t lean_uint64_array_fget(b_lean_obj_arg a, b_lean_obj_arg i) {
+    return lean_uint64_array_uget(a, lean_unbox(i));
+}
+
+static inline uint64_t lean_uint64_array_get(b_lean_obj_arg a, b_lean_obj_arg i) {
+    if (lean_is_scalar(i)) {
+        size_t idx = lean_unbox(i);
+        return idx < lean_sarray_size(a) ? lean_uint64_array_uget(a, idx) : 0;
+    } else {
+        /* The index must be out of bounds. Otherwise we would be out of memory. */
+        return 0;
+    }
+}
+
+LEAN_EXPORT lean_obj_res lean_uint64_array_push(lean_obj_arg a, uint64_t v);
+
+static inline lean_obj_res lean_uint64_array_uset(lean_obj_arg a, size_t i, uint64_t v) {
+    lean_obj_res r;
+    if (lean_is_exclusive(a)) r = a;
+    else r = lean_copy_uint64_array(a);
+    uint64_t * it = lean_uint64_array_cptr(r) + i;
+    *it = v;
+    return r;
+}
+
+static inline lean_obj_res lean_uint64_array_fset(lean_obj_arg a, b_lean_obj_arg i, uint64_t v) {
+    return lean_uint64_array_uset(a, lean_unbox(i), v);
+}
+
+static inline lean_obj_res lean_uint64_array_set(lean_obj_arg a, b_lean_obj_arg i, uint64_t v) {
+    if (!lean_is_scalar(i)) {
+        return a;
+    } else {
+        size_t idx = lean_unbox(i);
+        if (idx >= lean_sarray_size(a)) {
+            return a;
+        } else {
+            return lean_uint64_array_uset(a, idx, v);
+        }
+    }
+}
+
 /* Strings */
 
 static inline lean_obj_res lean_alloc_string(size_t size, size_t capacity, size_t len) {
@@ -1115,12 +1346,20 @@ static inline lean_obj_res lean_task_get_own(lean_obj_arg t) {
 
 /* primitive for implementing `IO.checkCanceled : IO Bool` */
 LEAN_EXPORT bool lean_io_check_canceled_core(void);
+/* Returns true iff the cancellation scope of the current thread has been canceled, see `IO.CancelScope`. */
+LEAN_EXPORT bool lean_io_cancel_scope_check_core(void);
+LEAN_EXPORT uint64_t lean_io_get_task_allocated_bytes_core(void);
 /* primitive for implementing `IO.cancel : Task a -> IO Unit` */
 LEAN_EXPORT void lean_io_cancel_core(b_lean_obj_arg t);
 /* primitive for implementing `IO.getTaskState : Task a -> IO TaskState` */
 LEAN_EXPORT uint8_t lean_io_get_task_state_core(b_lean_obj_arg t);
 /* primitive for implementing `IO.waitAny : List (Task a) -> IO (Task a)` */
 LEAN_EXPORT b_lean_obj_res lean_io_wait_any_core(b_lean_obj_arg task_list);
+/* primitive for implementing `IO.getTaskManagerStats : BaseIO IO.TaskManagerStats` */
+LEAN_EXPORT lean_obj_res lean_io_get_task_manager_stats_core(void);
+/* primitives for implementing `IO.startTaskTracing : BaseIO Unit` and `IO.stopTaskTracing : BaseIO (Array IO.TaskEvent)` */
+LEAN_EXPORT void lean_io_start_task_tracing_core(void);
+LEAN_EXPORT lean_obj_res lean_io_stop_task_tracing_core(void);
 
 /* External objects */
 
@@ -1324,6 +1563,9 @@ static inline lean_obj_res lean_nat_lxor(b_lean_obj_arg a1, b_lean_obj_arg a2) {
 LEAN_EXPORT lean_obj_res lean_nat_shiftl(b_lean_obj_arg a1, b_lean_obj_arg a2);
 LEAN_EXPORT lean_obj_res lean_nat_shiftr(b_lean_obj_arg a1, b_lean_obj_arg a2);
 LEAN_EXPORT lean_obj_res lean_nat_pow(b_lean_obj_arg a1, b_lean_obj_arg a2);
+LEAN_EXPORT lean_obj_res lean_nat_mul_add(b_lean_obj_arg a1, b_lean_obj_arg a2, b_lean_obj_arg a3);
+LEAN_EXPORT lean_obj_res lean_nat_pow_mod(b_lean_obj_arg a1, b_lean_obj_arg a2, b_lean_obj_arg a3);
+LEAN_EXPORT lean_obj_res lean_nat_big_repr(b_lean_obj_arg a);
 LEAN_EXPORT lean_obj_res lean_nat_gcd(b_lean_obj_arg a1, b_lean_obj_arg a2);
 LEAN_EXPORT lean_obj_res lean_nat_log2(b_lean_obj_arg a);
 
@@ -1850,6 +2092,7 @@ static inline uint64_t lean_usize_to_uint64(size_t a) { return ((uint64_t)a); }
 /* Float */
 
 LEAN_EXPORT lean_obj_res lean_float_to_string(double a);
+LEAN_EXPORT double lean_float_of_scientific(b_lean_obj_arg m, uint8_t esign, b_lean_obj_arg e);
 LEAN_EXPORT double lean_float_scaleb(double a, b_lean_obj_arg b);
 LEAN_EXPORT uint8_t lean_float_isnan(double a);
 LEAN_EXPORT uint8_t lean_float_isfinite(double a);
@@ -2108,6 +2351,8 @@ static inline lean_obj_res lean_runtime_mark_persistent(lean_obj_arg a) {
     return a;
 }
 
+LEAN_EXPORT lean_obj_res lean_runtime_with_region(lean_obj_arg f);
+
 #ifdef __cplusplus
 }
 #endif
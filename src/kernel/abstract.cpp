@@ -15,7 +15,7 @@ expr abstract(expr const & e, unsigned n, expr const * subst) {
     lean_assert(std::all_of(subst, subst+n, [](expr const & e) { return !has_loose_bvars(e) && is_fvar(e); }));
     if (!has_fvar(e))
         return e;
-    return replace(e, [=](expr const & m, unsigned offset) -> optional<expr> {
+    return replace_iter(e, [=](expr const & m, unsigned offset) -> optional<expr> {
             if (!has_fvar(m))
                 return some_expr(m); // expression m does not contain free variables
             if (is_fvar(m)) {
@@ -43,7 +43,7 @@ static object * lean_expr_abstract_core(object * e0, size_t n, object * subst) {
         lean_inc(e0);
         return e0;
     }
-    expr r = replace(e, [=](expr const & m, unsigned offset) -> optional<expr> {
+    expr r = replace_iter(e, [=](expr const & m, unsigned offset) -> optional<expr> {
             if (!has_fvar(m) && !has_mvar(m))
                 return some_expr(m); // expression m does not contain free/meta variables
             bool fv = is_fvar(m);
@@ -75,4 +75,54 @@ extern "C" LEAN_EXPORT object * lean_expr_abstract_range(object * e, object * n,
 extern "C" LEAN_EXPORT object * lean_expr_abstract(object * e, object * subst) {
     return lean_expr_abstract_core(e, lean_array_size(subst), subst);
 }
+
+/* `(e.abstract xs).instantiateRev vs` in a single traversal: an occurrence of `xs[i]` is treated as
+   the loose bound variable that `abstract` would have produced for it. */
+extern "C" LEAN_EXPORT object * lean_expr_replace_fvars(b_obj_arg e0, b_obj_arg xs, b_obj_arg vs) {
+    expr const & e = reinterpret_cast<expr const &>(e0);
+    size_t nx = lean_array_size(xs);
+    size_t nv = lean_array_size(vs);
+    if ((nx == 0 || (!has_fvar(e) && !has_mvar(e))) && (nv == 0 || !has_loose_bvars(e))) {
+        lean_inc(e0);
+        return e0;
+    }
+    /* Result for the loose bound variable `offset + k`. */
+    auto instantiate_idx = [=](size_t k, unsigned offset) -> expr {
+        if (k < nv) {
+            object * v = lean_array_get_core(vs, nv - k - 1);
+            return lift_loose_bvars(TO_REF(expr, v), offset);
+        } else {
+            return mk_bvar(nat::of_size_t(offset + k - nv));
+        }
+    };
+    expr r = replace_iter(e, [=](expr const & m, unsigned offset) -> optional<expr> {
+            if (offset >= get_loose_bvar_range(m) && !has_fvar(m) && !has_mvar(m))
+                return some_expr(m);
+            if (is_bvar(m)) {
+                nat const & vidx = bvar_idx(m);
+                if (vidx >= offset && nv > 0) {
+                    if (vidx.is_small())
+                        return some_expr(instantiate_idx(vidx.get_small_value() - offset, offset));
+                    else
+                        return some_expr(mk_bvar(vidx - nat::of_size_t(nv)));
+                }
+                return some_expr(m);
+            }
+            bool fv = is_fvar(m);
+            bool mv = is_mvar(m);
+            if (fv || mv) {
+                size_t i = nx;
+                while (i > 0) {
+                    --i;
+                    object * v = lean_array_get_core(xs, i);
+                    if ((fv && is_fvar_core(v) && fvar_name_core(v) == fvar_name(m)) ||
+                        (mv && is_mvar_core(v) && mvar_name_core(v) == mvar_name(m)))
+                        return some_expr(instantiate_idx(nx - i - 1, offset));
+                }
+                return some_expr(m);
+            }
+            return none_expr();
+        });
+    return r.steal();
+}
 }
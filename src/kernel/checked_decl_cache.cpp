@@ -0,0 +1,125 @@
+/*
+Copyright (c) 2024 Lean FRO, LLC. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+*/
+#include "kernel/checked_decl_cache.h"
+
+namespace lean {
+void checked_decl_cache::set_capacity(size_t c) {
+    lock_guard<mutex> lock(m_mutex);
+    m_capacity = c;
+    while (m_lru.size() > c) {
+        m_map.erase(m_lru.back().first);
+        m_lru.pop_back();
+    }
+}
+
+auto checked_decl_cache::find(name const & n) -> entry_ptr {
+    lock_guard<mutex> lock(m_mutex);
+    auto it = m_map.find(n);
+    if (it == m_map.end())
+        return entry_ptr();
+    m_lru.splice(m_lru.begin(), m_lru, it->second);
+    return it->second->second;
+}
+
+void checked_decl_cache::insert(name const & n, entry_ptr const & e) {
+    /* The entries are read by other threads. */
+    mark_mt(n.raw());
+    mark_mt(e->m_imports.raw());
+    mark_mt(e->m_decl.raw());
+    for (constant_info const & d : e->m_deps)
+        mark_mt(d.raw());
+    for (auto const & p : e->m_types) {
+        mark_mt(p.first.raw());
+        mark_mt(p.second.raw());
+    }
+    lock_guard<mutex> lock(m_mutex);
+    size_t capacity = m_capacity;
+    if (capacity == 0)
+        return;
+    auto it = m_map.find(n);
+    if (it != m_map.end()) {
+        it->second->second = e;
+        m_lru.splice(m_lru.begin(), m_lru, it->second);
+        return;
+    }
+    m_lru.emplace_front(n, e);
+    m_map.insert(mk_pair(m_lru.front().first, m_lru.begin()));
+    while (m_lru.size() > capacity) {
+        m_map.erase(m_lru.back().first);
+        m_lru.pop_back();
+    }
+}
+
+/* Constants that are not pointer equal are only compared if they do not belong to an inductive
+   declaration: inductive types, constructors and recursors are re-added when their declaration is
+   elaborated again, and comparing all their fields is not worth it. */
+static bool is_same_constant(constant_info const & c1, constant_info const & c2) {
+    if (is_eqp(c1, c2))
+        return true;
+    if (c1.kind() != c2.kind() || c1.is_unsafe() != c2.is_unsafe() ||
+        c1.get_lparams() != c2.get_lparams() || c1.get_type() != c2.get_type())
+        return false;
+    switch (c1.kind()) {
+    case constant_info_kind::Axiom:
+        return true;
+    case constant_info_kind::Definition:
+        return c1.to_definition_val().get_value() == c2.to_definition_val().get_value();
+    case constant_info_kind::Theorem:
+        return c1.to_theorem_val().get_value() == c2.to_theorem_val().get_value();
+    case constant_info_kind::Opaque:
+        return c1.to_opaque_val().get_value() == c2.to_opaque_val().get_value();
+    default:
+        return false;
+    }
+}
+
+bool is_valid_in(checked_decl_cache::entry const & e, environment const & env) {
+    if (e.m_imports.raw() != env.get_imports().raw())
+        return false;
+    for (constant_info const & d : e.m_deps) {
+        optional<constant_info> c = env.find(d.get_name());
+        if (!c || !is_same_constant(*c, d))
+            return false;
+    }
+    return true;
+}
+
+static constant_val const & get_constant_val(declaration const & d) {
+    switch (d.kind()) {
+    case declaration_kind::Definition: return d.to_definition_val().to_constant_val();
+    case declaration_kind::Theorem:    return d.to_theorem_val().to_constant_val();
+    case declaration_kind::Opaque:     return d.to_opaque_val().to_constant_val();
+    default:                           lean_unreachable();
+    }
+}
+
+bool is_same_declaration(declaration const & d1, declaration const & d2) {
+    if (is_eqp(d1, d2))
+        return true;
+    if (d1.kind() != d2.kind())
+        return false;
+    switch (d1.kind()) {
+    case declaration_kind::Definition:
+        if (d1.to_definition_val().get_safety() != d2.to_definition_val().get_safety() ||
+            d1.to_definition_val().get_value() != d2.to_definition_val().get_value())
+            return false;
+        break;
+    case declaration_kind::Theorem:
+        if (d1.to_theorem_val().get_value() != d2.to_theorem_val().get_value())
+            return false;
+        break;
+    case declaration_kind::Opaque:
+        if (d1.to_opaque_val().is_unsafe() != d2.to_opaque_val().is_unsafe() ||
+            d1.to_opaque_val().get_value() != d2.to_opaque_val().get_value())
+            return false;
+        break;
+    default:
+        return false;
+    }
+    constant_val const & v1 = get_constant_val(d1);
+    constant_val const & v2 = get_constant_val(d2);
+    return v1.get_name() == v2.get_name() && v1.get_lparams() == v2.get_lparams() && v1.get_type() == v2.get_type();
+}
+}
@@ -0,0 +1,60 @@
+/*
+Copyright (c) 2024 Lean FRO, LLC. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+*/
+#pragma once
+#include <atomic>
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "runtime/thread.h"
+#include "kernel/environment.h"
+#include "kernel/expr_maps.h"
+
+namespace lean {
+/** \brief Bounded LRU cache of the declarations accepted by the kernel, shared by all threads.
+
+    When a declaration is elaborated again (e.g., by the language server after an edit), `addDecl` skips
+    the kernel check if the declaration is unchanged and the constants looked up while checking it are
+    still the same. If only the declaration changed, the types inferred for its closed subterms by the
+    previous check are reused.
+
+    Entries are indexed by declaration name. The cache is disabled when its capacity is 0. */
+class checked_decl_cache {
+public:
+    struct entry {
+        /* `environment::get_imports` of the environment the declaration was checked in. */
+        object_ref                 m_imports;
+        declaration                m_decl;
+        /* Constants found by `environment::find` while checking `m_decl` (see `scoped_constant_recorder`). */
+        std::vector<constant_info> m_deps;
+        /* Types inferred (and checked) for the closed subterms of `m_decl`. */
+        expr_map<expr>             m_types;
+    };
+    typedef std::shared_ptr<entry const> entry_ptr;
+private:
+    typedef std::list<std::pair<name, entry_ptr>> lru_list;
+    typedef std::unordered_map<name, lru_list::iterator, name_hash_fn> lru_map;
+    std::atomic<size_t> m_capacity;
+    mutex               m_mutex;
+    lru_list            m_lru;
+    lru_map             m_map;
+public:
+    checked_decl_cache():m_capacity(0) {}
+    bool enabled() const { return m_capacity.load(std::memory_order_relaxed) > 0; }
+    /** \brief Set the maximum number of entries. A capacity of 0 disables the cache. */
+    void set_capacity(size_t c);
+    entry_ptr find(name const & n);
+    void insert(name const & n, entry_ptr const & e);
+};
+
+/** \brief Return true iff the constants the entry depends on are the same in \c env. */
+bool is_valid_in(checked_decl_cache::entry const & e, environment const & env);
+/** \brief Return true iff \c d1 and \c d2 are structurally equal definitions, theorems or opaque constants. */
+bool is_same_declaration(declaration const & d1, declaration const & d2);
+
+/** \brief Set the capacity of the `checked_decl_cache` used by `environment::add`. */
+void set_checked_decl_cache_capacity(size_t c);
+}
@@ -0,0 +1,65 @@
+/*
+Copyright (c) 2024 Lean FRO, LLC. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+*/
+#include "kernel/closed_term_cache.h"
+
+namespace lean {
+void closed_term_cache::clear_core() {
+    m_map.clear();
+    m_lru.clear();
+    m_imports = object_ref();
+}
+
+void closed_term_cache::set_capacity(size_t c) {
+    lock_guard<mutex> lock(m_mutex);
+    m_capacity = c;
+    while (m_lru.size() > c) {
+        m_map.erase(m_lru.back().first);
+        m_lru.pop_back();
+    }
+}
+
+optional<expr> closed_term_cache::find(object_ref const & imports, kind k, expr const & e) {
+    lock_guard<mutex> lock(m_mutex);
+    if (m_imports.raw() != imports.raw())
+        return none_expr();
+    auto it = m_map.find(key(e, k));
+    if (it == m_map.end())
+        return none_expr();
+    m_lru.splice(m_lru.begin(), m_lru, it->second);
+    return some_expr(it->second->second);
+}
+
+void closed_term_cache::insert(object_ref const & imports, kind k, expr const & e, expr const & r) {
+    /* The entries are read by other threads. */
+    mark_mt(e.raw());
+    mark_mt(r.raw());
+    lock_guard<mutex> lock(m_mutex);
+    size_t capacity = m_capacity;
+    if (capacity == 0)
+        return;
+    if (m_imports.raw() != imports.raw()) {
+        clear_core();
+        mark_mt(imports.raw());
+        m_imports = imports;
+    }
+    auto it = m_map.find(key(e, k));
+    if (it != m_map.end()) {
+        it->second->second = r;
+        m_lru.splice(m_lru.begin(), m_lru, it->second);
+        return;
+    }
+    m_lru.emplace_front(key(e, k), r);
+    m_map.insert(mk_pair(m_lru.front().first, m_lru.begin()));
+    while (m_lru.size() > capacity) {
+        m_map.erase(m_lru.back().first);
+        m_lru.pop_back();
+    }
+}
+
+void closed_term_cache::clear() {
+    lock_guard<mutex> lock(m_mutex);
+    clear_core();
+}
+}
@@ -0,0 +1,56 @@
+/*
+Copyright (c) 2024 Lean FRO, LLC. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+*/
+#pragma once
+#include <atomic>
+#include <list>
+#include <unordered_map>
+#include <utility>
+#include "runtime/thread.h"
+#include "kernel/environment.h"
+
+namespace lean {
+/** \brief Bounded LRU cache of `whnf_core`, `whnf` and `infer` results, and of unfolded constants, shared by all
+    type checkers.
+
+    Only closed terms whose constants are all imported may be stored here (see `type_checker::is_shareable`).
+    Their results depend neither on the local context nor on declarations of the current module, so they
+    can be reused across declarations and threads. The entries are only valid for one set of imported
+    modules: inserting a result for an environment with different imports clears the cache.
+
+    The cache is disabled when its capacity is 0. */
+class closed_term_cache {
+public:
+    enum class kind { WhnfCore, Whnf, Infer, Unfold };
+private:
+    struct key {
+        expr m_expr;
+        kind m_kind;
+        key(expr const & e, kind k):m_expr(e), m_kind(k) {}
+    };
+    struct key_hash {
+        size_t operator()(key const & k) const { return hash(k.m_expr) + static_cast<unsigned>(k.m_kind); }
+    };
+    struct key_eq {
+        bool operator()(key const & k1, key const & k2) const { return k1.m_kind == k2.m_kind && k1.m_expr == k2.m_expr; }
+    };
+    typedef std::list<std::pair<key, expr>> lru_list;
+    typedef std::unordered_map<key, lru_list::iterator, key_hash, key_eq> lru_map;
+    std::atomic<size_t> m_capacity;
+    mutex               m_mutex;
+    /* `environment::get_imports` of the environments the entries were computed in. */
+    object_ref          m_imports;
+    lru_list            m_lru;
+    lru_map             m_map;
+    void clear_core();
+public:
+    closed_term_cache():m_capacity(0) {}
+    bool enabled() const { return m_capacity.load(std::memory_order_relaxed) > 0; }
+    /** \brief Set the maximum number of entries. A capacity of 0 disables the cache. */
+    void set_capacity(size_t c);
+    optional<expr> find(object_ref const & imports, kind k, expr const & e);
+    void insert(object_ref const & imports, kind k, expr const & e, expr const & r);
+    void clear();
+};
+}
@@ -10,11 +10,13 @@ Author: Leonardo de Moura
 #include "runtime/sstream.h"
 #include "runtime/thread.h"
 #include "runtime/sharecommon.h"
+#include "runtime/io.h"
 #include "util/map_foreach.h"
 #include "util/io.h"
 #include "kernel/environment.h"
 #include "kernel/kernel_exception.h"
 #include "kernel/type_checker.h"
+#include "kernel/checked_decl_cache.h"
 #include "kernel/quot.h"
 
 namespace lean {
@@ -29,37 +31,65 @@ extern "C" object* lean_get_extension(object*, object*);
 extern "C" object* lean_set_extension(object*, object*, object*);
 extern "C" object* lean_environment_set_main_module(object*, object*);
 extern "C" object* lean_environment_main_module(object*);
+extern "C" object* lean_environment_imports_id(object*);
+extern "C" uint8 lean_environment_is_imported_const(object*, object*);
 extern "C" object* lean_kernel_record_unfold (object*, object*);
 extern "C" object* lean_kernel_get_diag(object*);
 extern "C" object* lean_kernel_set_diag(object*, object*);
 extern "C" uint8* lean_kernel_diag_is_enabled(object*);
+extern "C" uint8 lean_kernel_diag_is_profiling(object*);
+extern "C" object* lean_kernel_record_phase(object*, object*, object*, object*, double);
+extern "C" object* lean_kernel_record_unfold_time(object*, object*, double);
 
 void diagnostics::record_unfold(name const & decl_name) {
     m_obj = lean_kernel_record_unfold(to_obj_arg(), decl_name.to_obj_arg());
 }
 
-scoped_diagnostics::scoped_diagnostics(environment const & env, bool collect) {
+void diagnostics::record_profile(kernel_profile const & p) {
+    auto record_phase = [&](char const * n, kernel_profile::phase const & ph) {
+        if (ph.m_calls > 0)
+            m_obj = lean_kernel_record_phase(m_obj, name(n).to_obj_arg(), nat::of_size_t(ph.m_calls).to_obj_arg(),
+                                             nat::of_size_t(ph.m_hits).to_obj_arg(), ph.m_time);
+    };
+    record_phase("infer", p.m_infer);
+    record_phase("whnf", p.m_whnf);
+    record_phase("whnf_core", p.m_whnf_core);
+    record_phase("is_def_eq", p.m_is_def_eq);
+    record_phase("lazy_delta_reduction", p.m_lazy_delta);
+    for (auto const & e : p.m_unfold_time)
+        m_obj = lean_kernel_record_unfold_time(m_obj, e.first.to_obj_arg(), e.second);
+}
+
+scoped_diagnostics::scoped_diagnostics(environment const & env, bool collect):
+    m_diag(nullptr), m_profile(nullptr) {
     if (collect) {
         diagnostics d(env.get_diag());
-        if (lean_kernel_diag_is_enabled(d.to_obj_arg())) {
+        bool profile = lean_kernel_diag_is_profiling(d.to_obj_arg());
+        if (lean_kernel_diag_is_enabled(d.to_obj_arg()) || profile) {
             m_diag = new diagnostics(d);
-        } else
-            m_diag = nullptr;
-    } else {
-        m_diag = nullptr;
+            if (profile) {
+                m_profile = new kernel_profile();
+                m_diag->m_profile = m_profile;
+            }
+        }
     }
 }
 
 scoped_diagnostics::~scoped_diagnostics() {
     if (m_diag)
         delete m_diag;
+    if (m_profile)
+        delete m_profile;
 }
 
 environment scoped_diagnostics::update(environment const & env) const {
-    if (m_diag)
+    if (m_diag) {
+        if (m_profile)
+            m_diag->record_profile(*m_profile);
         return env.set_diag(*m_diag);
-    else
+    } else {
         return env;
+    }
 }
 
 environment mk_empty_environment(uint32 trust_lvl) {
@@ -86,6 +116,14 @@ name environment::get_main_module() const {
     return name(lean_environment_main_module(to_obj_arg()));
 }
 
+object_ref environment::get_imports() const {
+    return object_ref(lean_environment_imports_id(to_obj_arg()));
+}
+
+bool environment::is_imported(name const & n) const {
+    return lean_environment_is_imported_const(to_obj_arg(), n.to_obj_arg()) != 0;
+}
+
 unsigned environment::trust_lvl() const {
     return lean_environment_trust_level(to_obj_arg());
 }
@@ -98,8 +136,28 @@ void environment::mark_quot_initialized() {
     m_obj = lean_environment_mark_quot_init(m_obj);
 }
 
+LEAN_THREAD_PTR(scoped_constant_recorder, g_constant_recorder);
+
+scoped_constant_recorder::scoped_constant_recorder():m_prev(g_constant_recorder) {
+    g_constant_recorder = this;
+}
+
+scoped_constant_recorder::~scoped_constant_recorder() {
+    g_constant_recorder = m_prev;
+}
+
+std::vector<constant_info> scoped_constant_recorder::get_constants() const {
+    std::vector<constant_info> r;
+    for (auto const & p : m_constants)
+        r.push_back(p.second);
+    return r;
+}
+
 optional<constant_info> environment::find(name const & n) const {
-    return to_optional<constant_info>(lean_environment_find(to_obj_arg(), n.to_obj_arg()));
+    optional<constant_info> r = to_optional<constant_info>(lean_environment_find(to_obj_arg(), n.to_obj_arg()));
+    if (g_constant_recorder && r)
+        g_constant_recorder->record(*r);
+    return r;
 }
 
 constant_info environment::get(name const & n) const {
@@ -108,6 +166,8 @@ constant_info environment::get(name const & n) const {
         throw unknown_constant_exception(*this, n);
     constant_info r(cnstr_get(o, 0), true);
     dec(o);
+    if (g_constant_recorder)
+        g_constant_recorder->record(r);
     return r;
 }
 
@@ -168,6 +228,70 @@ static void check_constant_val(environment const & env, constant_val const & v,
     check_constant_val(env, v, diag, safe_only ? definition_safety::safe : definition_safety::unsafe);
 }
 
+static checked_decl_cache * g_checked_decl_cache = nullptr;
+
+/*
+Reuse the results of a previous check of a declaration with the same name (see `checked_decl_cache`).
+It is only used for safe definitions, theorems and opaque constants, and not when kernel diagnostics
+are being collected.
+*/
+class incremental_check {
+    environment const &                       m_env;
+    declaration const &                       m_decl;
+    name                                      m_name;
+    checked_decl_cache::entry_ptr             m_prev;
+    bool                                      m_checked = false;
+    std::unique_ptr<scoped_constant_recorder> m_recorder;
+public:
+    incremental_check(environment const & env, declaration const & d, constant_val const & v, diagnostics * diag):
+        m_env(env), m_decl(d), m_name(v.get_name()) {
+        if (!g_checked_decl_cache->enabled() || diag || d.is_unsafe())
+            return;
+        m_prev = g_checked_decl_cache->find(m_name);
+        if (m_prev && !is_valid_in(*m_prev, env))
+            m_prev.reset();
+        if (m_prev && is_same_declaration(m_prev->m_decl, d)) {
+            m_checked = true;
+            return;
+        }
+        m_recorder.reset(new scoped_constant_recorder());
+        if (m_prev) {
+            /* The types of the closed terms were checked with the level parameters of the previous version. */
+            if (get_lparams(m_prev->m_decl) != v.get_lparams()) {
+                m_prev.reset();
+            } else {
+                /* The reused types depend on these constants. */
+                for (constant_info const & c : m_prev->m_deps)
+                    env.get(c.get_name());
+            }
+        }
+    }
+    /* Return true if the declaration was already accepted, and the constants it depends on did not change. */
+    bool is_checked() const { return m_checked; }
+    void init(type_checker & checker) {
+        if (m_prev)
+            checker.set_checked_types(&m_prev->m_types);
+    }
+    void save(type_checker & checker) {
+        if (!m_recorder)
+            return;
+        std::shared_ptr<checked_decl_cache::entry> e = std::make_shared<checked_decl_cache::entry>();
+        e->m_imports = m_env.get_imports();
+        e->m_decl    = m_decl;
+        e->m_deps    = m_recorder->get_constants();
+        checker.get_checked_types(e->m_types);
+        g_checked_decl_cache->insert(m_name, e);
+    }
+private:
+    static names const & get_lparams(declaration const & d) {
+        switch (d.kind()) {
+        case declaration_kind::Definition: return d.to_definition_val().get_lparams();
+        case declaration_kind::Theorem:    return d.to_theorem_val().get_lparams();
+        default:                           return d.to_opaque_val().get_lparams();
+        }
+    }
+};
+
 void environment::add_core(constant_info const & info) {
     m_obj = lean_environment_add(m_obj, info.to_obj_arg());
 }
@@ -197,20 +321,33 @@ environment environment::add_definition(declaration const & d, bool check) const
         environment new_env = add(constant_info(d));
         if (check) {
             type_checker checker(new_env, diag.get(), definition_safety::unsafe);
-            check_no_metavar_no_fvar(new_env, v.get_name(), v.get_value());
-            expr val_type = checker.check(v.get_value(), v.get_lparams());
-            if (!checker.is_def_eq(val_type, v.get_type()))
+            sharecommon_persistent_fn share;
+            expr val(share(v.get_value().raw()));
+            expr type(share(v.get_type().raw()));
+            check_no_metavar_no_fvar(new_env, v.get_name(), val);
+            expr val_type = checker.check(val, v.get_lparams());
+            if (!checker.is_def_eq(val_type, type))
                 throw definition_type_mismatch_exception(new_env, d, val_type);
         }
         return diag.update(new_env);
     } else {
         if (check) {
-            type_checker checker(*this, diag.get());
-            check_constant_val(*this, v.to_constant_val(), checker);
-            check_no_metavar_no_fvar(*this, v.get_name(), v.get_value());
-            expr val_type = checker.check(v.get_value(), v.get_lparams());
-            if (!checker.is_def_eq(val_type, v.get_type()))
-                throw definition_type_mismatch_exception(*this, d, val_type);
+            incremental_check inc(*this, d, v.to_constant_val(), diag.get());
+            if (inc.is_checked()) {
+                check_name(v.get_name());
+            } else {
+                type_checker checker(*this, diag.get());
+                inc.init(checker);
+                sharecommon_persistent_fn share;
+                expr val(share(v.get_value().raw()));
+                expr type(share(v.get_type().raw()));
+                check_constant_val(*this, v.to_constant_val(), checker);
+                check_no_metavar_no_fvar(*this, v.get_name(), val);
+                expr val_type = checker.check(val, v.get_lparams());
+                if (!checker.is_def_eq(val_type, type))
+                    throw definition_type_mismatch_exception(*this, d, val_type);
+                inc.save(checker);
+            }
         }
         return diag.update(add(constant_info(d)));
     }
@@ -220,17 +357,24 @@ environment environment::add_theorem(declaration const & d, bool check) const {
     scoped_diagnostics diag(*this, check);
     theorem_val const & v = d.to_theorem_val();
     if (check) {
-        type_checker checker(*this, diag.get());
-        sharecommon_persistent_fn share;
-        expr val(share(v.get_value().raw()));
-        expr type(share(v.get_type().raw()));
-        if (!checker.is_prop(type))
-            throw theorem_type_is_not_prop(*this, v.get_name(), type);
-        check_constant_val(*this, v.to_constant_val(), checker);
-        check_no_metavar_no_fvar(*this, v.get_name(), val);
-        expr val_type = checker.check(val, v.get_lparams());
-        if (!checker.is_def_eq(val_type, type))
-            throw definition_type_mismatch_exception(*this, d, val_type);
+        incremental_check inc(*this, d, v.to_constant_val(), diag.get());
+        if (inc.is_checked()) {
+            check_name(v.get_name());
+        } else {
+            type_checker checker(*this, diag.get());
+            inc.init(checker);
+            sharecommon_persistent_fn share;
+            expr val(share(v.get_value().raw()));
+            expr type(share(v.get_type().raw()));
+            if (!checker.is_prop(type))
+                throw theorem_type_is_not_prop(*this, v.get_name(), type);
+            check_constant_val(*this, v.to_constant_val(), checker);
+            check_no_metavar_no_fvar(*this, v.get_name(), val);
+            expr val_type = checker.check(val, v.get_lparams());
+            if (!checker.is_def_eq(val_type, type))
+                throw definition_type_mismatch_exception(*this, d, val_type);
+            inc.save(checker);
+        }
     }
     return diag.update(add(constant_info(d)));
 }
@@ -239,11 +383,21 @@ environment environment::add_opaque(declaration const & d, bool check) const {
     scoped_diagnostics diag(*this, check);
     opaque_val const & v = d.to_opaque_val();
     if (check) {
-        type_checker checker(*this, diag.get());
-        check_constant_val(*this, v.to_constant_val(), checker);
-        expr val_type = checker.check(v.get_value(), v.get_lparams());
-        if (!checker.is_def_eq(val_type, v.get_type()))
-            throw definition_type_mismatch_exception(*this, d, val_type);
+        incremental_check inc(*this, d, v.to_constant_val(), diag.get());
+        if (inc.is_checked()) {
+            check_name(v.get_name());
+        } else {
+            type_checker checker(*this, diag.get());
+            inc.init(checker);
+            sharecommon_persistent_fn share;
+            expr val(share(v.get_value().raw()));
+            expr type(share(v.get_type().raw()));
+            check_constant_val(*this, v.to_constant_val(), checker);
+            expr val_type = checker.check(val, v.get_lparams());
+            if (!checker.is_def_eq(val_type, type))
+                throw definition_type_mismatch_exception(*this, d, val_type);
+            inc.save(checker);
+        }
     }
     return diag.update(add(constant_info(d)));
 }
@@ -273,10 +427,13 @@ environment environment::add_mutual(declaration const & d, bool check) const {
     /* Check actual definitions */
     if (check) {
         type_checker checker(new_env, diag.get(), safety);
+        sharecommon_persistent_fn share;
         for (definition_val const & v : vs) {
-            check_no_metavar_no_fvar(new_env, v.get_name(), v.get_value());
-            expr val_type = checker.check(v.get_value(), v.get_lparams());
-            if (!checker.is_def_eq(val_type, v.get_type()))
+            expr val(share(v.get_value().raw()));
+            expr type(share(v.get_type().raw()));
+            check_no_metavar_no_fvar(new_env, v.get_name(), val);
+            expr val_type = checker.check(val, v.get_lparams());
+            if (!checker.is_def_eq(val_type, type))
                 throw definition_type_mismatch_exception(new_env, d, val_type);
         }
     }
@@ -327,9 +484,20 @@ void environment::display_stats() const {
     dec_ref(lean_display_stats(to_obj_arg(), io_mk_world()));
 }
 
+void set_checked_decl_cache_capacity(size_t c) {
+    g_checked_decl_cache->set_capacity(c);
+}
+
+extern "C" LEAN_EXPORT obj_res lean_kernel_set_checked_decl_cache_capacity(size_t c, obj_arg) {
+    set_checked_decl_cache_capacity(c);
+    return io_result_mk_ok(box(0));
+}
+
 void initialize_environment() {
+    g_checked_decl_cache = new checked_decl_cache();
 }
 
 void finalize_environment() {
+    delete g_checked_decl_cache;
 }
 }
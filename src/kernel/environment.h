@@ -8,6 +8,7 @@ Author: Leonardo de Moura
 #include <utility>
 #include <memory>
 #include <vector>
+#include <unordered_map>
 #include "runtime/optional.h"
 #include "util/rc.h"
 #include "util/list.h"
@@ -29,27 +30,51 @@ public:
     virtual ~environment_extension() {}
 };
 
+/* Statistics collected by the type checker when `Kernel.Diagnostics.profile = true`. */
+struct kernel_profile {
+    struct phase {
+        size_t   m_calls = 0;
+        size_t   m_hits  = 0;
+        /* Time in seconds of the outermost calls. */
+        double   m_time  = 0;
+        unsigned m_depth = 0;
+    };
+    phase m_infer;
+    phase m_whnf;
+    phase m_whnf_core;
+    phase m_is_def_eq;
+    phase m_lazy_delta;
+    /* Time in seconds of the outermost `whnf` calls, indexed by the first declaration they unfolded. */
+    std::unordered_map<name, double, name_hash_fn> m_unfold_time;
+};
+
 /* Wrapper for `Kernel.Diagnostics` */
 class diagnostics : public object_ref {
+    kernel_profile * m_profile = nullptr;
+    friend class scoped_diagnostics;
 public:
-    diagnostics(diagnostics const & other):object_ref(other) {}
-    diagnostics(diagnostics && other):object_ref(other) {}
+    diagnostics(diagnostics const & other):object_ref(other), m_profile(other.m_profile) {}
+    diagnostics(diagnostics && other):object_ref(other), m_profile(other.m_profile) {}
     explicit diagnostics(b_obj_arg o, bool b):object_ref(o, b) {}
     explicit diagnostics(obj_arg o):object_ref(o) {}
     ~diagnostics() {}
     void record_unfold(name const & decl_name);
+    /* Return the profile to be updated by the type checker, or `nullptr` if profiling is disabled. */
+    kernel_profile * profile() const { return m_profile; }
+    void record_profile(kernel_profile const & p);
 };
 
 /*
 Store `Kernel.Diagnostics` stored in environment extension in `m_diag` IF
-- `Kernel.Diagnostics.enable = true`
+- `Kernel.Diagnostics.enable = true` or `Kernel.Diagnostics.profile = true`
 - `collect = true`. This is a minor optimization.
 
 We use this class to ensure we don't waste time collecting information
 that was not requested.
 */
 class scoped_diagnostics {
-    diagnostics * m_diag;
+    diagnostics *    m_diag;
+    kernel_profile * m_profile;
 public:
     scoped_diagnostics(environment const & env, bool collect);
     scoped_diagnostics(scoped_diagnostics const &) = delete;
@@ -59,6 +84,22 @@ public:
     diagnostics * get() const { return m_diag; }
 };
 
+/*
+Record the constants found by `environment::find` and `environment::get` in the current thread while the
+object is alive. We use it to collect the constants a kernel check depends on (see `checked_decl_cache`).
+*/
+class scoped_constant_recorder {
+    std::unordered_map<name, constant_info, name_hash_fn> m_constants;
+    scoped_constant_recorder * m_prev;
+public:
+    scoped_constant_recorder();
+    scoped_constant_recorder(scoped_constant_recorder const &) = delete;
+    scoped_constant_recorder(scoped_constant_recorder &&) = delete;
+    ~scoped_constant_recorder();
+    void record(constant_info const & info) { m_constants.insert(mk_pair(info.get_name(), info)); }
+    std::vector<constant_info> get_constants() const;
+};
+
 class LEAN_EXPORT environment : public object_ref {
     friend class add_inductive_fn;
 
@@ -97,6 +138,11 @@ public:
     void set_main_module(name const & n);
 
     name get_main_module() const;
+    /** \brief Return an object identifying the imported modules. Environments with the same imports
+        return the same (pointer equal) object. */
+    object_ref get_imports() const;
+    /** \brief Return true iff the constant \c n was imported from another module. */
+    bool is_imported(name const & n) const;
 
     /** \brief Return information for the constant with name \c n (if it is defined in this environment). */
     optional<constant_info> find(name const & n) const;
@@ -18,7 +18,7 @@ class equiv_manager {
     };
 
     std::vector<node>  m_nodes;
-    expr_map<node_ref> m_to_node;
+    expr_flat_map<node_ref> m_to_node;
     bool               m_use_hash;
 
     node_ref mk_node();
@@ -80,27 +80,11 @@ expr lit_type(literal const & lit) { return expr(lean_lit_type(lit.to_obj_arg())
 
 extern "C" uint64_t lean_expr_hash(obj_arg e);
 unsigned hash(expr const & e) {
-    object * o = e.raw();
-    unsigned r = static_cast<unsigned>(lean_ctor_get_uint64(o, lean_ctor_num_objs(o)*sizeof(object*)));
+    unsigned r = static_cast<unsigned>(get_data(e));
     lean_assert(r == lean_expr_hash(e.to_obj_arg()));
     return r;
 }
 
-extern "C" uint8 lean_expr_has_fvar(obj_arg e);
-bool has_fvar(expr const & e) { return lean_expr_has_fvar(e.to_obj_arg()); }
-
-extern "C" uint8 lean_expr_has_expr_mvar(obj_arg e);
-bool has_expr_mvar(expr const & e) { return lean_expr_has_expr_mvar(e.to_obj_arg()); }
-
-extern "C" uint8 lean_expr_has_level_mvar(obj_arg e);
-bool has_univ_mvar(expr const & e) { return lean_expr_has_level_mvar(e.to_obj_arg()); }
-
-extern "C" uint8 lean_expr_has_level_param(obj_arg e);
-bool has_univ_param(expr const & e) { return lean_expr_has_level_param(e.to_obj_arg()); }
-
-extern "C" unsigned lean_expr_loose_bvar_range(object * e);
-unsigned get_loose_bvar_range(expr const & e) { return lean_expr_loose_bvar_range(e.to_obj_arg()); }
-
 // =======================================
 // Constructors
 
@@ -388,7 +372,7 @@ expr lower_loose_bvars(expr const & e, unsigned s, unsigned d) {
     if (d == 0 || s >= get_loose_bvar_range(e))
         return e;
     lean_assert(s >= d);
-    return replace(e, [=](expr const & e, unsigned offset) -> optional<expr> {
+    return replace_iter(e, [=](expr const & e, unsigned offset) -> optional<expr> {
             unsigned s1 = s + offset;
             if (s1 < s)
                 return some_expr(e); // overflow, vidx can't be >= max unsigned
@@ -418,7 +402,7 @@ extern "C" LEAN_EXPORT object * lean_expr_lower_loose_bvars(b_obj_arg e, b_obj_a
 expr lift_loose_bvars(expr const & e, unsigned s, unsigned d) {
     if (d == 0 || s >= get_loose_bvar_range(e))
         return e;
-    return replace(e, [=](expr const & e, unsigned offset) -> optional<expr> {
+    return replace_iter(e, [=](expr const & e, unsigned offset) -> optional<expr> {
             unsigned s1 = s + offset;
             if (s1 < s)
                 return some_expr(e); // overflow, vidx can't be >= max unsigned
@@ -123,13 +123,21 @@ inline bool is_eqp(optional<expr> const & a, optional<expr> const & b) {
     return static_cast<bool>(a) == static_cast<bool>(b) && (!a || is_eqp(*a, *b));
 }
 
+/* Data cached in each expression: hash code, approximate depth, flags, and loose bound variable range.
+   See `Expr.Data` at `Expr.lean` for the layout. */
+inline uint64 get_data(expr const & e) {
+    object * o = e.raw();
+    return lean_ctor_get_uint64(o, lean_ctor_num_objs(o)*sizeof(object*));
+}
 unsigned hash(expr const & e);
-bool has_expr_mvar(expr const & e);
-bool has_univ_mvar(expr const & e);
-inline bool has_mvar(expr const & e) { return has_expr_mvar(e) || has_univ_mvar(e); }
-bool has_fvar(expr const & e);
-bool has_univ_param(expr const & e);
-unsigned get_loose_bvar_range(expr const & e);
+/* Return the depth of `e`, saturated at 255. */
+inline unsigned get_approx_depth(expr const & e) { return (get_data(e) >> 32) & 255; }
+inline bool has_fvar(expr const & e) { return (get_data(e) >> 40) & 1; }
+inline bool has_expr_mvar(expr const & e) { return (get_data(e) >> 41) & 1; }
+inline bool has_univ_mvar(expr const & e) { return (get_data(e) >> 42) & 1; }
+inline bool has_mvar(expr const & e) { return (get_data(e) >> 41) & 3; }
+inline bool has_univ_param(expr const & e) { return (get_data(e) >> 43) & 1; }
+inline unsigned get_loose_bvar_range(expr const & e) { return get_data(e) >> 44; }
 
 struct expr_hash { unsigned operator()(expr const & e) const { return hash(e); } };
 struct expr_pair_hash {
@@ -7,12 +7,16 @@ Author: Leonardo de Moura
 #pragma once
 #include <unordered_map>
 #include <functional>
+#include "util/flat_hash_map.h"
 #include "kernel/expr.h"
 
 namespace lean {
 // Maps based on structural equality. That is, two keys are equal iff they are structurally equal
 template<typename T>
 using expr_map = typename std::unordered_map<expr, T, expr_hash, std::equal_to<expr>>;
+// Like `expr_map`, but with open addressing (see `flat_hash_map`). It does not support erasing entries.
+template<typename T>
+using expr_flat_map = flat_hash_map<expr, T, expr_hash, std::equal_to<expr>>;
 // The following map also takes into account binder information
 template<typename T>
 using expr_bi_map = typename std::unordered_map<expr, T, expr_hash, is_bi_equal_proc>;
@@ -4,9 +4,11 @@ Released under Apache 2.0 license as described in the file LICENSE.
 
 Author: Leonardo de Moura
 */
+#include <vector>
 #include "runtime/sstream.h"
 #include "runtime/utf8.h"
 #include "util/name_generator.h"
+#include "util/name_map.h"
 #include "kernel/environment.h"
 #include "kernel/type_checker.h"
 #include "kernel/instantiate.h"
@@ -141,6 +143,8 @@ class add_inductive_fn {
     buffer<expr>           m_params;
     /* A constant for each inductive type */
     buffer<expr>           m_ind_cnsts;
+    /* Position of each inductive type in `m_ind_types` */
+    name_map<unsigned>     m_ind_idx;
 
     level                  m_elim_level;
     bool                   m_K_target;
@@ -158,17 +162,42 @@ class add_inductive_fn {
        and for nested inductive datatypes. */
     buffer<rec_info>       m_rec_infos;
 
+    /* A recursive field `u : Pi xs, I As is` of a constructor. */
+    struct rec_field_info {
+        expr         m_field;
+        buffer<expr> m_xs;
+        unsigned     m_ind_idx;  /* position of `I` in `m_ind_types` */
+        buffer<expr> m_indices;
+    };
+
+    /* The free variables for the fields of a constructor are created by `check_constructors`, and reused
+       by `mk_rec_infos` and `mk_rec_rules`. So, the type checker caches are hit when the field types are
+       processed again, and the recursive fields are only analyzed once. */
+    struct cnstr_info {
+        buffer<expr>                m_fields;
+        std::vector<rec_field_info> m_rec_fields;
+    };
+    /* An entry for each constructor, in declaration order. */
+    std::vector<cnstr_info> m_cnstr_infos;
+
+    /* We use the same type checker state in all steps. Its caches remain valid when `m_env` is
+       extended with the new inductive types and constructors, and `m_lctx` only grows. */
+    type_checker::state    m_st;
+
 public:
     add_inductive_fn(environment const & env, diagnostics * diag, inductive_decl const & decl, unsigned nnested):
         m_env(env), m_ngen(*g_ind_fresh), m_diag(diag), m_lparams(decl.get_lparams()), m_is_unsafe(decl.is_unsafe()),
-        m_nnested(nnested) {
+        m_nnested(nnested), m_st(env) {
         if (!decl.get_nparams().is_small())
             throw kernel_exception(env, "invalid inductive datatype, number of parameters is too big");
         m_nparams = decl.get_nparams().get_small_value();
         to_buffer(decl.get_types(), m_ind_types);
     }
 
-    type_checker tc() { return type_checker(m_env, m_lctx, m_diag, m_is_unsafe ? definition_safety::unsafe : definition_safety::safe); }
+    type_checker tc() {
+        m_st.env() = m_env;
+        return type_checker(m_st, m_lctx, m_diag, m_is_unsafe ? definition_safety::unsafe : definition_safety::safe);
+    }
 
     /** Return type of the parameter at position `i` */
     expr get_param_type(unsigned i) const {
@@ -251,6 +280,7 @@ public:
                 throw kernel_exception(m_env, "mutually inductive types must live in the same universe");
             }
 
+            m_ind_idx.insert(ind_type.get_name(), m_ind_cnsts.size());
             m_ind_cnsts.push_back(mk_constant(ind_type.get_name(), m_levels));
             first = false;
         }
@@ -268,16 +298,8 @@ public:
             for (constructor const & cnstr : ind_type.get_cnstrs()) {
                 expr t = constructor_type(cnstr);
                 while (is_pi(t)) {
-                    if (find(binding_domain(t), [&](expr const & e, unsigned) {
-                                if (is_constant(e)) {
-                                    for (expr const & I : m_ind_cnsts)
-                                        if (const_name(I) == const_name(e))
-                                            return true;
-                                }
-                                return false;
-                            })) {
+                    if (has_ind_occ(binding_domain(t)))
                         return true;
-                    }
                     t = binding_body(t);
                 }
             }
@@ -357,19 +379,18 @@ public:
 
     /** \brief Return some(i) iff `t` is of the form `I As t` where `I` the inductive `i`-th datatype being defined. */
     optional<unsigned> is_valid_ind_app(expr const & t) {
-        for (unsigned i = 0; i < m_ind_types.size(); i++) {
-            if (is_valid_ind_app(t, i))
-                return optional<unsigned>(i);
-        }
+        expr const & I = get_app_fn(t);
+        if (!is_constant(I))
+            return optional<unsigned>();
+        unsigned const * i = m_ind_idx.find(const_name(I));
+        if (i && is_valid_ind_app(t, *i))
+            return optional<unsigned>(*i);
         return optional<unsigned>();
     }
 
     /** \brief Return true iff `e` is one of the inductive datatype being declared. */
     bool is_ind_occ(expr const & e) {
-        return
-            is_constant(e) &&
-            std::any_of(m_ind_cnsts.begin(), m_ind_cnsts.end(),
-                        [&](expr const & c) { return const_name(e) == const_name(c); });
+        return is_constant(e) && m_ind_idx.contains(const_name(e));
     }
 
     /** \brief Return true iff `t` does not contain any occurrence of a datatype being declared. */
@@ -419,6 +440,7 @@ public:
                     throw kernel_exception(m_env, sstream() << "duplicate constructor name '" << n << "'");
                 }
                 found_cnstrs.insert(n);
+                cnstr_info info;
                 expr t = constructor_type(cnstr);
                 m_env.check_name(n);
                 check_no_metavar_no_fvar(m_env, n, t);
@@ -442,12 +464,14 @@ public:
                         if (!m_is_unsafe)
                             check_positivity(binding_domain(t), n, i);
                         expr local = mk_local_decl_for(t);
+                        info.m_fields.push_back(local);
                         t = instantiate(binding_body(t), local);
                     }
                     i++;
                 }
                 if (!is_valid_ind_app(t, idx))
                     throw kernel_exception(m_env, sstream() << "invalid return type for '" << n << "'");
+                m_cnstr_infos.push_back(info);
             }
         }
     }
@@ -616,11 +640,12 @@ public:
         }
         /* First, populate the field m_minors */
         d_idx = 0;
+        unsigned cnstr_idx = 0;
         for (inductive_type const & ind_type : m_ind_types) {
             name ind_type_name = ind_type.get_name();
             for (constructor const & cnstr : ind_type.get_cnstrs()) {
-                buffer<expr> b_u; // nonrec and rec args;
-                buffer<expr> u;   // rec args
+                cnstr_info & c_info = m_cnstr_infos[cnstr_idx++];
+                buffer<expr> const & b_u = c_info.m_fields; // nonrec and rec args;
                 buffer<expr> v;   // inductive args
                 name cnstr_name = constructor_name(cnstr);
                 expr t          = constructor_type(cnstr);
@@ -629,10 +654,11 @@ public:
                     if (i < m_nparams) {
                         t = instantiate(binding_body(t), m_params[i]);
                     } else {
-                        expr l = mk_local_decl_for(t);
-                        b_u.push_back(l);
-                        if (is_rec_argument(binding_domain(t)))
-                            u.push_back(l);
+                        expr const & l = b_u[i - m_nparams];
+                        if (is_rec_argument(binding_domain(t))) {
+                            c_info.m_rec_fields.push_back(rec_field_info());
+                            c_info.m_rec_fields.back().m_field = l;
+                        }
                         t = instantiate(binding_body(t), l);
                     }
                     i++;
@@ -642,19 +668,18 @@ public:
                 expr C_app      = mk_app(m_rec_infos[it_idx].m_C, it_indices);
                 expr intro_app  = mk_app(mk_app(mk_constant(cnstr_name, m_levels), m_params), b_u);
                 C_app = mk_app(C_app, intro_app);
-                /* populate v using u */
-                for (unsigned i = 0; i < u.size(); i++) {
-                    expr u_i    = u[i];
-                    expr u_i_ty = whnf(infer_type(u_i));
-                    buffer<expr> xs;
+                /* populate v using the recursive fields */
+                for (rec_field_info & u_info : c_info.m_rec_fields) {
+                    expr const & u_i = u_info.m_field;
+                    expr u_i_ty      = whnf(infer_type(u_i));
+                    buffer<expr> & xs = u_info.m_xs;
                     while (is_pi(u_i_ty)) {
                         expr x = mk_local_decl_for(u_i_ty);
                         xs.push_back(x);
                         u_i_ty = whnf(instantiate(binding_body(u_i_ty), x));
                     }
-                    buffer<expr> it_indices;
-                    unsigned it_idx = get_I_indices(u_i_ty, it_indices);
-                    expr C_app  = mk_app(m_rec_infos[it_idx].m_C, it_indices);
+                    u_info.m_ind_idx = get_I_indices(u_i_ty, u_info.m_indices);
+                    expr C_app  = mk_app(m_rec_infos[u_info.m_ind_idx].m_C, u_info.m_indices);
                     expr u_app  = mk_app(u_i, xs);
                     C_app = mk_app(C_app, u_app);
                     expr v_i_ty = mk_pi(xs, C_app);
@@ -705,38 +730,16 @@ public:
         levels lvls = get_rec_levels();
         buffer<recursor_rule> rules;
         for (constructor const & cnstr : d.get_cnstrs()) {
-            buffer<expr> b_u;
-            buffer<expr> u;
-            expr t = constructor_type(cnstr);
-            unsigned i = 0;
-            while (is_pi(t)) {
-                if (i < m_nparams) {
-                    t = instantiate(binding_body(t), m_params[i]);
-                } else {
-                    expr l = mk_local_decl_for(t);
-                    b_u.push_back(l);
-                    if (is_rec_argument(binding_domain(t)))
-                        u.push_back(l);
-                    t = instantiate(binding_body(t), l);
-                }
-                i++;
-            }
+            /* Constructors and minor premises are in the same order. */
+            cnstr_info const & c_info = m_cnstr_infos[minor_idx];
+            buffer<expr> const & b_u  = c_info.m_fields;
             buffer<expr> v;
-            for (unsigned i = 0; i < u.size(); i++) {
-                expr u_i    = u[i];
-                expr u_i_ty = whnf(infer_type(u_i));
-                buffer<expr> xs;
-                while (is_pi(u_i_ty)) {
-                    expr x = mk_local_decl_for(u_i_ty);
-                    xs.push_back(x);
-                    u_i_ty = whnf(instantiate(binding_body(u_i_ty), x));
-                }
-                buffer<expr> it_indices;
-                unsigned it_idx = get_I_indices(u_i_ty, it_indices);
-                name rec_name   = mk_rec_name(m_ind_types[it_idx].get_name());
+            for (rec_field_info const & u_info : c_info.m_rec_fields) {
+                name rec_name   = mk_rec_name(m_ind_types[u_info.m_ind_idx].get_name());
                 expr rec_app    = mk_constant(rec_name, lvls);
-                rec_app         = mk_app(mk_app(mk_app(mk_app(mk_app(rec_app, m_params), Cs), minors), it_indices), mk_app(u_i, xs));
-                v.push_back(mk_lambda(xs, rec_app));
+                rec_app         = mk_app(mk_app(mk_app(mk_app(mk_app(rec_app, m_params), Cs), minors), u_info.m_indices),
+                                         mk_app(u_info.m_field, u_info.m_xs));
+                v.push_back(mk_lambda(u_info.m_xs, rec_app));
             }
             expr e_app    = mk_app(mk_app(minors[minor_idx], b_u), v);
             expr comp_rhs = mk_lambda(m_params, mk_lambda(Cs, mk_lambda(minors, mk_lambda(b_u, e_app))));
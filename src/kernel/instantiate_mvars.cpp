@@ -4,12 +4,16 @@ Released under Apache 2.0 license as described in the file LICENSE.
 
 Authors: Leonardo de Moura
 */
+#include <chrono>
 #include <vector>
-#include <unordered_map>
 #include "util/name_set.h"
+#include "util/name_hash_map.h"
+#include "util/flat_hash_map.h"
 #include "runtime/option_ref.h"
 #include "runtime/array_ref.h"
+#include "runtime/cache_stats.h"
 #include "kernel/instantiate.h"
+#include "kernel/abstract.h"
 #include "kernel/replace_fn.h"
 
 /*
@@ -33,7 +37,7 @@ option_ref<level> get_lmvar_assignment(metavar_ctx & mctx, name const & mid) {
 
 class instantiate_lmvars_fn {
     metavar_ctx & m_mctx;
-    std::unordered_map<lean_object *, level> m_cache;
+    flat_hash_map<lean_object *, level> m_cache;
     std::vector<level> m_saved; // Helper vector to prevent values from being garbage collected
 
     inline level cache(level const & l, level r, bool shared) {
@@ -116,32 +120,14 @@ option_ref<delayed_assignment> get_delayed_mvar_assignment(metavar_ctx & mctx, n
     return option_ref<delayed_assignment>(lean_get_delayed_mvar_assignment(mctx.to_obj_arg(), mid.to_obj_arg()));
 }
 
-expr replace_fvars(expr const & e, array_ref<expr> const & fvars, expr const * rev_args) {
-    size_t sz = fvars.size();
-    if (sz == 0)
-        return e;
-    return replace(e, [=](expr const & m, unsigned offset) -> optional<expr> {
-            if (!has_fvar(m))
-                return some_expr(m); // expression m does not contain free variables
-            if (is_fvar(m)) {
-                size_t i = sz;
-                name const & fid = fvar_name(m);
-                while (i > 0) {
-                    --i;
-                    if (fvar_name(fvars[i]) == fid) {
-                        return some_expr(lift_loose_bvars(rev_args[sz - i - 1], offset));
-                    }
-                }
-            }
-            return none_expr();
-        });
-}
-
 class instantiate_mvars_fn {
     metavar_ctx & m_mctx;
     instantiate_lmvars_fn m_level_fn;
     name_set m_already_normalized; // Store metavariables whose assignment has already been normalized.
-    std::unordered_map<lean_object *, expr> m_cache;
+    flat_hash_map<lean_object *, expr> m_cache;
+    /* Delayed-assigned metavariables whose pending value has been fully instantiated, mapped to this value
+       with the delayed assignment free variables abstracted. */
+    name_hash_map<expr> m_delayed_cache;
     std::vector<expr> m_saved; // Helper vector to prevent values from being garbage collected
 
     level visit_level(level const & l) {
@@ -245,20 +231,26 @@ class instantiate_mvars_fn {
     `e` is a term of the form `?m t1 t2 t3`
     Moreover, `?m` is delayed assigned
       `?m #[x, y] := g x y`
-    where, `fvars := #[x, y]` and `val := g x y`.
+    where, `body` is `g #1 #0` (i.e., `g x y` with `x` and `y` abstracted),
+    and `num_fvars` is 2.
     `args` is an accumulator for `e`'s arguments.
 
     We want to return `g t1' t2' t3'` where
     `ti'`s are `visit(ti)`.
+
+    The body is abstracted only once for each delayed-assigned metavariable. Then, `instantiate` only
+    visits the subterms that contain `x` or `y`, while replacing the free variables directly would
+    have to visit all subterms containing free variables. This matters for nested tactic blocks,
+    where each delayed assignment contains the ones of the nested blocks.
     */
-    expr visit_delayed(array_ref<expr> const & fvars, expr const & val, expr const & e, buffer<expr> & args) {
+    expr visit_delayed(expr const & body, unsigned num_fvars, expr const & e, buffer<expr> & args) {
         expr const * curr = &e;
         while (is_app(*curr)) {
             args.push_back(visit(app_arg(*curr)));
             curr = &app_fn(*curr);
         }
-        expr val_new = replace_fvars(val, fvars, args.data() + (args.size() - fvars.size()));
-        return mk_rev_app(val_new, args.size() - fvars.size(), args.data());
+        expr val_new = instantiate(body, num_fvars, args.data() + (args.size() - num_fvars));
+        return mk_rev_app(val_new, args.size() - num_fvars, args.data());
     }
 
     expr visit_app(expr const & e) {
@@ -307,8 +299,13 @@ class instantiate_mvars_fn {
             if (has_expr_mvar(*val))
                 // mid_pending has been assigned, but assignment contains mvars.
                 return visit_mvar_app_args(e);
+            auto it = m_delayed_cache.find(mid);
+            if (it == m_delayed_cache.end()) {
+                expr body = fvars.size() == 0 ? *val : abstract(*val, fvars.size(), &fvars[0]);
+                it = m_delayed_cache.insert(mk_pair(mid, body)).first;
+            }
             buffer<expr> args;
-            return visit_delayed(fvars, *val, e, args);
+            return visit_delayed(it->second, fvars.size(), e, args);
         }
     }
 
@@ -363,8 +360,12 @@ public:
 };
 
 extern "C" LEAN_EXPORT object * lean_instantiate_expr_mvars(object * m, object * e) {
+    auto start = std::chrono::steady_clock::now();
     metavar_ctx mctx(m);
-    expr e_new = instantiate_mvars_fn(mctx)(expr(e));
+    expr e_old(e);
+    expr e_new = instantiate_mvars_fn(mctx)(e_old);
+    auto nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+    record_cache_stat(cache_stat::instantiate_mvars, is_eqp(e_new, e_old), nanos.count());
     object * r = alloc_cnstr(0, 2, 0);
     cnstr_set(r, 0, mctx.steal());
     cnstr_set(r, 1, e_new.steal());
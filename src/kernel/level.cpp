@@ -12,7 +12,9 @@ Author: Leonardo de Moura
 #include "runtime/interrupt.h"
 #include "runtime/hash.h"
 #include "runtime/buffer.h"
+#include "runtime/thread.h"
 #include "util/list.h"
+#include "util/flat_hash_map.h"
 #include "kernel/level.h"
 #include "kernel/environment.h"
 
@@ -426,7 +428,33 @@ level mk_succ(level l, unsigned k) {
     return l;
 }
 
+/* Cache for the normalization of levels containing `max` or `imax`, keyed by pointer. The entries keep
+   their key alive, so that a pointer cannot be reused for a different level while it is in the cache. */
+struct normalize_cache {
+    static constexpr size_t capacity = 4096;
+    flat_hash_map<lean_object *, std::pair<level, level>> m_cache;
+};
+
+MK_THREAD_LOCAL_GET_DEF(normalize_cache, get_normalize_cache);
+
+static level normalize_core(level const & l);
+
 level normalize(level const & l) {
+    level_kind k = kind(to_offset(l).first);
+    if (k != level_kind::Max && k != level_kind::IMax)
+        return l;
+    flat_hash_map<lean_object *, std::pair<level, level>> & cache = get_normalize_cache().m_cache;
+    auto it = cache.find(l.raw());
+    if (it != cache.end())
+        return it->second.second;
+    level r = normalize_core(l);
+    if (cache.size() >= normalize_cache::capacity)
+        cache.clear();
+    cache.insert(mk_pair(l.raw(), mk_pair(l, r)));
+    return r;
+}
+
+static level normalize_core(level const & l) {
     auto p = to_offset(l);
     level const & r = p.first;
     switch (kind(r)) {
@@ -492,7 +520,21 @@ level normalize(level const & l) {
 
 bool is_equivalent(level const & lhs, level const & rhs) {
     check_system("level constraints");
-    return lhs == rhs || normalize(lhs) == normalize(rhs);
+    if (lhs == rhs)
+        return true;
+    level_kind k1 = kind(to_offset(lhs).first);
+    level_kind k2 = kind(to_offset(rhs).first);
+    bool norm1 = k1 == level_kind::Max || k1 == level_kind::IMax;
+    bool norm2 = k2 == level_kind::Max || k2 == level_kind::IMax;
+    if (!norm1 && !norm2) {
+        // `lhs` and `rhs` are already normalized
+        return false;
+    }
+    if (is_max(lhs) && is_max(rhs) && max_lhs(lhs) == max_rhs(rhs) && max_rhs(lhs) == max_lhs(rhs)) {
+        // `max u v` and `max v u`
+        return true;
+    }
+    return normalize(lhs) == normalize(rhs);
 }
 
 bool is_geq_core(level l1, level l2) {
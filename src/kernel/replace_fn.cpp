@@ -7,7 +7,8 @@ Author: Leonardo de Moura
 #include <vector>
 #include <memory>
 #include <utility>
-#include <unordered_map>
+#include "runtime/thread.h"
+#include "util/flat_hash_map.h"
 #include "kernel/replace_fn.h"
 
 namespace lean {
@@ -18,7 +19,7 @@ class replace_rec_fn {
             return hash((size_t)p.first >> 3, p.second);
         }
     };
-    std::unordered_map<std::pair<lean_object *, unsigned>, expr, key_hasher> m_cache;
+    flat_hash_map<std::pair<lean_object *, unsigned>, expr, key_hasher> m_cache;
     std::function<optional<expr>(expr const &, unsigned)> m_f;
     bool                                                  m_use_cache;
 
@@ -83,8 +84,34 @@ expr replace(expr const & e, std::function<optional<expr>(expr const &, unsigned
     return replace_rec_fn(f, use_cache)(e);
 }
 
+struct replace_iter_caches {
+    std::vector<std::unique_ptr<replace_iter_cache>> m_caches;
+    unsigned                                         m_depth = 0;
+};
+
+MK_THREAD_LOCAL_GET_DEF(replace_iter_caches, get_replace_iter_caches);
+
+replace_iter_cache_ref::replace_iter_cache_ref() {
+    replace_iter_caches & cs = get_replace_iter_caches();
+    if (cs.m_depth == cs.m_caches.size())
+        cs.m_caches.emplace_back(new replace_iter_cache());
+    m_cache = cs.m_caches[cs.m_depth].get();
+    cs.m_depth++;
+}
+
+replace_iter_cache_ref::~replace_iter_cache_ref() {
+    /* `clear` is linear in the capacity of the table, do not keep large tables around for small calls. */
+    if (m_cache->m_cache.size() > 1024)
+        m_cache->m_cache = flat_hash_map<std::pair<lean_object *, unsigned>, expr, replace_iter_cache::key_hasher>();
+    else
+        m_cache->m_cache.clear();
+    m_cache->m_todo.clear();
+    m_cache->m_results.clear();
+    get_replace_iter_caches().m_depth--;
+}
+
 class replace_fn {
-    std::unordered_map<lean_object *, expr> m_cache;
+    flat_hash_map<lean_object *, expr> m_cache;
     lean_object * m_f;
 
     expr save_result(expr const & e, expr const & r, bool shared) {
@@ -6,7 +6,10 @@ Author: Leonardo de Moura
 */
 #pragma once
 #include <tuple>
+#include <vector>
+#include <utility>
 #include "runtime/interrupt.h"
+#include "util/flat_hash_map.h"
 #include "kernel/expr.h"
 #include "kernel/expr_maps.h"
 
@@ -23,4 +26,134 @@ expr replace(expr const & e, std::function<optional<expr>(expr const &, unsigned
 inline expr replace(expr const & e, std::function<optional<expr>(expr const &)> const & f, bool use_cache = true) {
     return replace(e, [&](expr const & e, unsigned) { return f(e); }, use_cache);
 }
+
+/** \brief Scratch space for `replace_iter`. Each thread reuses one instance, so that hot primitives
+    such as `instantiate` and `abstract` do not allocate a new cache and stack on every call. */
+struct replace_iter_cache {
+    struct key_hasher {
+        std::size_t operator()(std::pair<lean_object *, unsigned> const & p) const {
+            return hash((size_t)p.first >> 3, p.second);
+        }
+    };
+    struct frame {
+        lean_object * m_e;
+        unsigned      m_offset;
+        unsigned      m_next; // next child to visit
+        bool          m_shared;
+    };
+    flat_hash_map<std::pair<lean_object *, unsigned>, expr, key_hasher> m_cache;
+    std::vector<frame> m_todo;
+    std::vector<expr>  m_results;
+};
+
+/** \brief Borrow a thread local `replace_iter_cache`. Reentrant calls (e.g., `lift_loose_bvars` invoked
+    by the function given to `replace_iter`) use the next cache of the thread. */
+class replace_iter_cache_ref {
+    replace_iter_cache * m_cache;
+public:
+    replace_iter_cache_ref();
+    ~replace_iter_cache_ref();
+    replace_iter_cache & operator*() { return *m_cache; }
+};
+
+/**
+   \brief Non-recursive version of `replace` for the substitution primitives.
+
+   `f` is invoked as `replace` does, but it is not type-erased, subexpressions are visited using an
+   explicit stack instead of the C++ stack, and the cache storage is reused across calls.
+*/
+template<typename F> expr replace_iter(expr const & e, F const & f) {
+    replace_iter_cache_ref ref;
+    replace_iter_cache & c = *ref;
+    auto visit = [&](expr const & t, unsigned offset) {
+        bool shared = false;
+        if (is_shared(t)) {
+            auto it = c.m_cache.find(mk_pair(t.raw(), offset));
+            if (it != c.m_cache.end()) {
+                c.m_results.push_back(it->second);
+                return;
+            }
+            shared = true;
+        }
+        if (optional<expr> r = f(t, offset)) {
+            if (shared)
+                c.m_cache.insert(mk_pair(mk_pair(t.raw(), offset), *r));
+            c.m_results.push_back(std::move(*r));
+            return;
+        }
+        switch (t.kind()) {
+        case expr_kind::Const: case expr_kind::Sort:
+        case expr_kind::BVar:  case expr_kind::Lit:
+        case expr_kind::MVar:  case expr_kind::FVar:
+            c.m_results.push_back(t);
+            return;
+        default:
+            c.m_todo.push_back(replace_iter_cache::frame{t.raw(), offset, 0, shared});
+            return;
+        }
+    };
+    visit(e, 0);
+    while (!c.m_todo.empty()) {
+        replace_iter_cache::frame & fr = c.m_todo.back();
+        lean_object * raw = fr.m_e;
+        expr const & t    = TO_REF(expr, raw);
+        unsigned offset   = fr.m_offset;
+        unsigned i        = fr.m_next;
+        /* `visit` may push a new frame and invalidate `fr`. */
+        switch (t.kind()) {
+        case expr_kind::MData:
+            if (i == 0) { fr.m_next++; visit(mdata_expr(t), offset); continue; }
+            break;
+        case expr_kind::Proj:
+            if (i == 0) { fr.m_next++; visit(proj_expr(t), offset); continue; }
+            break;
+        case expr_kind::App:
+            if (i == 0) { fr.m_next++; visit(app_fn(t), offset); continue; }
+            if (i == 1) { fr.m_next++; visit(app_arg(t), offset); continue; }
+            break;
+        case expr_kind::Pi: case expr_kind::Lambda:
+            if (i == 0) { fr.m_next++; visit(binding_domain(t), offset); continue; }
+            if (i == 1) { fr.m_next++; visit(binding_body(t), offset+1); continue; }
+            break;
+        case expr_kind::Let:
+            if (i == 0) { fr.m_next++; visit(let_type(t), offset); continue; }
+            if (i == 1) { fr.m_next++; visit(let_value(t), offset); continue; }
+            if (i == 2) { fr.m_next++; visit(let_body(t), offset+1); continue; }
+            break;
+        default:
+            lean_unreachable();
+        }
+        /* All children have been visited, their results are on top of `m_results`. */
+        size_t sz = c.m_results.size();
+        expr r;
+        switch (t.kind()) {
+        case expr_kind::MData:
+            r = update_mdata(t, c.m_results[sz-1]);
+            break;
+        case expr_kind::Proj:
+            r = update_proj(t, c.m_results[sz-1]);
+            break;
+        case expr_kind::App:
+            r = update_app(t, c.m_results[sz-2], c.m_results[sz-1]);
+            break;
+        case expr_kind::Pi: case expr_kind::Lambda:
+            r = update_binding(t, c.m_results[sz-2], c.m_results[sz-1]);
+            break;
+        case expr_kind::Let:
+            r = update_let(t, c.m_results[sz-3], c.m_results[sz-2], c.m_results[sz-1]);
+            break;
+        default:
+            lean_unreachable();
+        }
+        c.m_results.resize(sz - i);
+        if (fr.m_shared)
+            c.m_cache.insert(mk_pair(mk_pair(raw, offset), r));
+        c.m_todo.pop_back();
+        c.m_results.push_back(std::move(r));
+    }
+    lean_assert(c.m_results.size() == 1);
+    expr r = std::move(c.m_results.back());
+    c.m_results.pop_back();
+    return r;
+}
 }
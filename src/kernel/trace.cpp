@@ -115,6 +115,14 @@ scope_trace_env::scope_trace_env(environment const & env, options const & o) {
     init(const_cast<environment*>(&env), const_cast<options*>(&o));
 }
 
+scope_trace_env::scope_trace_env(trace_env_ref const & r) {
+    init(const_cast<environment*>(r.m_env), const_cast<options*>(r.m_opts));
+}
+
+trace_env_ref get_trace_env() {
+    return trace_env_ref{g_env, g_opts};
+}
+
 scope_trace_env::~scope_trace_env() {
     g_env  = const_cast<environment*>(m_old_env);
     g_opts = const_cast<options*>(m_old_opts);
@@ -19,6 +19,16 @@ bool is_trace_class_enabled(name const & n);
 
 #define lean_is_trace_enabled(CName) (::lean::is_trace_enabled() && ::lean::is_trace_class_enabled(CName))
 
+/* The trace environment and options of a thread, see `get_trace_env`. */
+struct trace_env_ref {
+    environment const * m_env;
+    options     const * m_opts;
+};
+
+/* Return the trace environment of the current thread, to be installed on another thread using `scope_trace_env`.
+   The environment and options must outlive its use. */
+trace_env_ref get_trace_env();
+
 class scope_trace_env {
     unsigned                m_enable_sz;
     unsigned                m_disable_sz;
@@ -27,6 +37,7 @@ class scope_trace_env {
     void init(environment * env, options * opts);
 public:
     scope_trace_env(environment const & env, options const & opts);
+    scope_trace_env(trace_env_ref const & r);
     ~scope_trace_env();
 };
 
@@ -6,9 +6,11 @@ Author: Leonardo de Moura
 */
 #include <utility>
 #include <vector>
+#include <chrono>
 #include "runtime/interrupt.h"
 #include "runtime/sstream.h"
 #include "runtime/flet.h"
+#include "runtime/io.h"
 #include "util/lbool.h"
 #include "kernel/type_checker.h"
 #include "kernel/expr_maps.h"
@@ -31,6 +33,7 @@ static expr * g_nat_sub      = nullptr;
 static expr * g_nat_mul      = nullptr;
 static expr * g_nat_pow      = nullptr;
 static expr * g_nat_gcd      = nullptr;
+static expr * g_nat_log2     = nullptr;
 static expr * g_nat_mod      = nullptr;
 static expr * g_nat_div      = nullptr;
 static expr * g_nat_beq      = nullptr;
@@ -40,10 +43,47 @@ static expr * g_nat_lor      = nullptr;
 static expr * g_nat_xor      = nullptr;
 static expr * g_nat_shiftLeft  = nullptr;
 static expr * g_nat_shiftRight = nullptr;
+static expr * g_bitvec_of_nat = nullptr;
+static expr * g_bitvec_to_nat = nullptr;
+static name * g_bitvec_add    = nullptr;
+static name * g_bitvec_sub    = nullptr;
+static name * g_bitvec_mul    = nullptr;
+static name * g_bitvec_and    = nullptr;
+static name * g_bitvec_or     = nullptr;
+static name * g_bitvec_xor    = nullptr;
+static name * g_bitvec_ult    = nullptr;
+static name * g_bitvec_ule    = nullptr;
+static std::atomic<bool> g_reduce_bitvec(false);
+static closed_term_cache * g_closed_term_cache = nullptr;
 
 type_checker::state::state(environment const & env):
     m_env(env), m_ngen(*g_kernel_fresh) {}
 
+/* Count a call to a type checker phase and measure the time of the outermost one
+   when kernel profiling is enabled (see `kernel_profile`). */
+class profile_scope {
+    kernel_profile::phase *               m_phase;
+    std::chrono::steady_clock::time_point m_start;
+public:
+    profile_scope(diagnostics * diag, kernel_profile::phase kernel_profile::* ph):m_phase(nullptr) {
+        if (diag && diag->profile()) {
+            m_phase = &(diag->profile()->*ph);
+            m_phase->m_calls++;
+            if (m_phase->m_depth++ == 0)
+                m_start = std::chrono::steady_clock::now();
+        }
+    }
+    ~profile_scope() {
+        if (m_phase && --m_phase->m_depth == 0)
+            m_phase->m_time += elapsed();
+    }
+    bool is_outermost() const { return m_phase && m_phase->m_depth == 1; }
+    double elapsed() const {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - m_start).count();
+    }
+    void hit() { if (m_phase) m_phase->m_hits++; }
+};
+
 /** \brief Make sure \c e "is" a sort, and return the corresponding sort.
     If \c e is not a sort, then the whnf procedure is invoked.
 
@@ -80,8 +120,59 @@ void type_checker::check_level(level const & l) {
     }
 }
 
+static void save_fvar_decl(std::vector<local_decl> & decls, local_decl const & d) {
+    name const & n = d.get_name();
+    if (!n.get_numeral().is_small())
+        return;
+    size_t idx = n.get_numeral().get_small_value();
+    if (idx >= decls.size())
+        decls.resize(idx + 1);
+    decls[idx] = d;
+}
+
+/* Create a local declaration with a fresh name, and record it in `m_st->m_fvar_decls`. */
+expr type_checker::mk_local_decl(name const & un, expr const & type, binder_info bi) {
+    local_decl d = m_lctx.mk_local_decl(m_st->m_ngen.next(), un, type, bi);
+    save_fvar_decl(m_st->m_fvar_decls, d);
+    return d.mk_ref();
+}
+
+expr type_checker::mk_local_decl(name const & un, expr const & type, expr const & value) {
+    local_decl d = m_lctx.mk_local_decl(m_st->m_ngen.next(), un, type, value);
+    save_fvar_decl(m_st->m_fvar_decls, d);
+    return d.mk_ref();
+}
+
+/* Return the declaration of the free variable `e`.
+
+   Declarations created by `mk_local_decl` are found in constant time using the numeral of their
+   fresh name, instead of searching `m_lctx`. This is correct because fresh names are never reused by
+   a type checker state, which the caches in `m_st` already rely on. Other declarations (e.g., the
+   ones in the local context provided by the caller) are searched in `m_lctx`. */
+optional<local_decl> type_checker::find_local_decl(expr const & e) const {
+    name const & n = fvar_name(e);
+    if (n.is_numeral() && n.get_numeral().is_small() && n.get_prefix() == m_st->m_ngen.prefix()) {
+        size_t idx = n.get_numeral().get_small_value();
+        if (idx < m_st->m_fvar_decls.size()) {
+            local_decl const & d = m_st->m_fvar_decls[idx];
+            if (d.get_name() == n)
+                return optional<local_decl>(d);
+        }
+    }
+    return m_lctx.find_local_decl(e);
+}
+
+bool type_checker::is_let_fvar(expr const & e) const {
+    lean_assert(is_fvar(e));
+    if (optional<local_decl> decl = find_local_decl(e)) {
+        return static_cast<bool>(decl->get_value());
+    } else {
+        return false;
+    }
+}
+
 expr type_checker::infer_fvar(expr const & e) {
-    if (optional<local_decl> decl = m_lctx.find_local_decl(e)) {
+    if (optional<local_decl> decl = find_local_decl(e)) {
         return decl->get_type();
     } else {
         throw kernel_exception(env(), "unknown free variable");
@@ -109,7 +200,7 @@ expr type_checker::infer_constant(expr const & e, bool infer_only) {
             check_level(l);
         }
     }
-    return instantiate_type_lparams(info, ls);
+    return instantiate_lparams_cached(info, e, false);
 }
 
 expr type_checker::infer_lambda(expr const & _e, bool infer_only) {
@@ -118,7 +209,7 @@ expr type_checker::infer_lambda(expr const & _e, bool infer_only) {
     expr e = _e;
     while (is_lambda(e)) {
         expr d    = instantiate_rev(binding_domain(e), fvars.size(), fvars.data());
-        expr fvar = m_lctx.mk_local_decl(m_st->m_ngen, binding_name(e), d, binding_info(e));
+        expr fvar = mk_local_decl(binding_name(e), d, binding_info(e));
         fvars.push_back(fvar);
         if (!infer_only) {
             ensure_sort_core(infer_type_core(d, infer_only), d);
@@ -139,7 +230,7 @@ expr type_checker::infer_pi(expr const & _e, bool infer_only) {
         expr d  = instantiate_rev(binding_domain(e), fvars.size(), fvars.data());
         expr t1 = ensure_sort_core(infer_type_core(d, infer_only), d);
         us.push_back(sort_level(t1));
-        expr fvar  = m_lctx.mk_local_decl(m_st->m_ngen, binding_name(e), d, binding_info(e));
+        expr fvar  = mk_local_decl(binding_name(e), d, binding_info(e));
         fvars.push_back(fvar);
         e = binding_body(e);
     }
@@ -156,13 +247,29 @@ expr type_checker::infer_pi(expr const & _e, bool infer_only) {
 
 expr type_checker::infer_app(expr const & e, bool infer_only) {
     if (!infer_only) {
-        expr f_type = ensure_pi_core(infer_type_core(app_fn(e), infer_only), e);
-        expr a_type = infer_type_core(app_arg(e), infer_only);
-        expr d_type = binding_domain(f_type);
-        if (!is_def_eq(a_type, d_type)) {
-            throw app_type_mismatch_exception(env(), m_lctx, e, f_type, a_type);
+        /* We process all arguments at once to avoid instantiating the remaining telescope of the
+           function type for each argument. Only the binder domains are instantiated, and the body
+           is instantiated once per maximal chain of Pi binders. */
+        buffer<expr> args;
+        expr const & f = get_app_args(e, args);
+        expr f_type    = infer_type_core(f, infer_only);
+        unsigned j     = 0;
+        unsigned nargs = args.size();
+        for (unsigned i = 0; i < nargs; i++) {
+            if (!is_pi(f_type)) {
+                f_type = instantiate_rev(f_type, i-j, args.data()+j);
+                f_type = ensure_pi_core(f_type, mk_app(f, i+1, args.data()));
+                j = i;
+            }
+            expr a_type = infer_type_core(args[i], infer_only);
+            expr d_type = instantiate_rev(binding_domain(f_type), i-j, args.data()+j);
+            if (!is_def_eq(a_type, d_type)) {
+                throw app_type_mismatch_exception(env(), m_lctx, mk_app(f, i+1, args.data()),
+                                                  instantiate_rev(f_type, i-j, args.data()+j), a_type);
+            }
+            f_type = binding_body(f_type);
         }
-        return instantiate(binding_body(f_type), app_arg(e));
+        return instantiate_rev(f_type, nargs-j, args.data()+j);
     } else {
         buffer<expr> args;
         expr const & f = get_app_args(e, args);
@@ -207,7 +314,7 @@ expr type_checker::infer_let(expr const & _e, bool infer_only) {
     while (is_let(e)) {
         expr type = instantiate_rev(let_type(e), fvars.size(), fvars.data());
         expr val  = instantiate_rev(let_value(e), fvars.size(), fvars.data());
-        expr fvar = m_lctx.mk_local_decl(m_st->m_ngen, let_name(e), type, val);
+        expr fvar = mk_local_decl(let_name(e), type, val);
         fvars.push_back(fvar);
         vals.push_back(val);
         if (!infer_only) {
@@ -259,25 +366,34 @@ expr type_checker::infer_proj(expr const & e, bool infer_only) {
 
     constant_info c_info = env().get(head(I_val.get_cnstrs()));
     expr r = instantiate_type_lparams(c_info, const_levels(I));
+    /* The constructor type is instantiated with the parameters and the previous projections
+       only when it is not a Pi (see `infer_app`), and not once per binder.
+       `subst` contains the values for the loose bound variables of `r`. */
+    buffer<expr> subst;
     for (unsigned i = 0; i < I_val.get_nparams(); i++) {
         lean_assert(i < args.size());
-        r = whnf(r);
-        if (!is_pi(r)) throw invalid_proj_exception(env(), m_lctx, e);
-        r = instantiate(binding_body(r), args[i]);
+        if (!is_pi(r)) {
+            r = whnf(instantiate_rev(r, subst.size(), subst.data()));
+            subst.clear();
+            if (!is_pi(r)) throw invalid_proj_exception(env(), m_lctx, e);
+        }
+        subst.push_back(args[i]);
+        r = binding_body(r);
     }
     bool is_prop_type = is_prop(type);
     for (unsigned i = 0; i < idx; i++) {
-        r = whnf(r);
-        if (!is_pi(r)) throw invalid_proj_exception(env(), m_lctx, e);
-        if (has_loose_bvars(binding_body(r))) {
-            if (is_prop_type && !is_prop(binding_domain(r)))
-                throw invalid_proj_exception(env(), m_lctx, e);
-            r = instantiate(binding_body(r), mk_proj(I_name, i, proj_expr(e)));
-        } else {
-            r = binding_body(r);
+        if (!is_pi(r)) {
+            r = whnf(instantiate_rev(r, subst.size(), subst.data()));
+            subst.clear();
+            if (!is_pi(r)) throw invalid_proj_exception(env(), m_lctx, e);
         }
+        if (is_prop_type && has_loose_bvar(binding_body(r), 0) &&
+            !is_prop(instantiate_rev(binding_domain(r), subst.size(), subst.data())))
+            throw invalid_proj_exception(env(), m_lctx, e);
+        subst.push_back(mk_proj(I_name, i, proj_expr(e)));
+        r = binding_body(r);
     }
-    r = whnf(r);
+    r = whnf(instantiate_rev(r, subst.size(), subst.data()));
     if (!is_pi(r)) throw invalid_proj_exception(env(), m_lctx, e);
     r = binding_domain(r);
     if (is_prop_type && !is_prop(r))
@@ -285,6 +401,73 @@ expr type_checker::infer_proj(expr const & e, bool infer_only) {
     return r;
 }
 
+/** \brief Auxiliary method for \c is_shareable. The result is cached in `m_st->m_shareable`. */
+bool type_checker::is_shareable_core(expr const & e) {
+    switch (e.kind()) {
+    case expr_kind::BVar: case expr_kind::Sort: case expr_kind::Lit:
+        return true;
+    case expr_kind::FVar: case expr_kind::MVar:
+        return false;
+    case expr_kind::Const:
+        return env().is_imported(const_name(e));
+    case expr_kind::App:    case expr_kind::Lambda: case expr_kind::Pi:
+    case expr_kind::Let:    case expr_kind::MData:  case expr_kind::Proj:
+        break;
+    }
+
+    auto it = m_st->m_shareable.find(e);
+    if (it != m_st->m_shareable.end())
+        return it->second;
+
+    bool r = false;
+    switch (e.kind()) {
+    case expr_kind::BVar:  case expr_kind::Sort:  case expr_kind::Lit:
+    case expr_kind::FVar:  case expr_kind::MVar:  case expr_kind::Const:
+        lean_unreachable(); // LCOV_EXCL_LINE
+    case expr_kind::App:
+        r = is_shareable_core(app_fn(e)) && is_shareable_core(app_arg(e));
+        break;
+    case expr_kind::Lambda: case expr_kind::Pi:
+        r = is_shareable_core(binding_domain(e)) && is_shareable_core(binding_body(e));
+        break;
+    case expr_kind::Let:
+        r = is_shareable_core(let_type(e)) && is_shareable_core(let_value(e)) && is_shareable_core(let_body(e));
+        break;
+    case expr_kind::MData:
+        r = is_shareable_core(mdata_expr(e));
+        break;
+    case expr_kind::Proj:
+        r = env().is_imported(proj_sname(e)) && is_shareable_core(proj_expr(e));
+        break;
+    }
+    m_st->m_shareable.insert(mk_pair(e, r));
+    return r;
+}
+
+/** \brief Return true iff the results of `whnf_core`, `whnf` and `infer` for \c e can be stored in the shared
+    `closed_term_cache`. That is, the cache is enabled, \c e is closed, and all its constants are imported.
+    Then, the results depend neither on the local context nor on the declarations of the current module.
+
+    We do not share results when collecting diagnostics, since cache hits skip the unfold counters. */
+bool type_checker::is_shareable(expr const & e) {
+    return
+        g_closed_term_cache->enabled() && !m_diag &&
+        !has_fvar(e) && !has_loose_bvars(e) && !has_mvar(e) &&
+        is_shareable_core(e);
+}
+
+optional<expr> type_checker::find_shared(closed_term_cache::kind k, expr const & e) {
+    if (!m_st->m_imports)
+        m_st->m_imports = env().get_imports();
+    return g_closed_term_cache->find(*m_st->m_imports, k, e);
+}
+
+void type_checker::cache_shared(closed_term_cache::kind k, expr const & e, expr const & r) {
+    if (!m_st->m_imports)
+        m_st->m_imports = env().get_imports();
+    g_closed_term_cache->insert(*m_st->m_imports, k, e, r);
+}
+
 /** \brief Return type of expression \c e, if \c infer_only is false, then it also check whether \c e is type correct or not.
     \pre closed(e) */
 expr type_checker::infer_type_core(expr const & e, bool infer_only) {
@@ -293,10 +476,31 @@ expr type_checker::infer_type_core(expr const & e, bool infer_only) {
 
     lean_assert(!has_loose_bvars(e));
     check_system("type checker", /* do_check_interrupted */ true);
+    profile_scope prof(m_diag, &kernel_profile::m_infer);
 
     auto it = m_st->m_infer_type[infer_only].find(e);
-    if (it != m_st->m_infer_type[infer_only].end())
+    if (it != m_st->m_infer_type[infer_only].end()) {
+        prof.hit();
         return it->second;
+    }
+
+    if (!infer_only && m_checked_types && !has_fvar(e)) {
+        auto it2 = m_checked_types->find(e);
+        if (it2 != m_checked_types->end()) {
+            prof.hit();
+            m_st->m_infer_type[infer_only].insert(mk_pair(e, it2->second));
+            return it2->second;
+        }
+    }
+
+    /* Type checking results depend on `m_lparams` and `m_definition_safety`, so we only share inferred types. */
+    bool shared = infer_only && is_shareable(e);
+    if (shared) {
+        if (auto r = find_shared(closed_term_cache::kind::Infer, e)) {
+            m_st->m_infer_type[infer_only].insert(mk_pair(e, *r));
+            return *r;
+        }
+    }
 
     expr r;
     switch (e.kind()) {
@@ -319,6 +523,8 @@ expr type_checker::infer_type_core(expr const & e, bool infer_only) {
     }
 
     m_st->m_infer_type[infer_only].insert(mk_pair(e, r));
+    if (shared)
+        cache_shared(closed_term_cache::kind::Infer, e, r);
     return r;
 }
 
@@ -331,6 +537,13 @@ expr type_checker::check(expr const & e, names const & lps) {
     return infer_type_core(e, false);
 }
 
+void type_checker::get_checked_types(expr_map<expr> & m) const {
+    m_st->m_infer_type[false].for_each([&](expr const & e, expr const & t) {
+            if (!has_fvar(e))
+                m.insert(mk_pair(e, t));
+        });
+}
+
 expr type_checker::check_ignore_undefined_universes(expr const & e) {
     flet<names const *> updt(m_lparams, nullptr);
     return infer_type_core(e, false);
@@ -367,7 +580,7 @@ optional<expr> type_checker::reduce_recursor(expr const & e, bool cheap_rec, boo
 }
 
 expr type_checker::whnf_fvar(expr const & e, bool cheap_rec, bool cheap_proj) {
-    if (optional<local_decl> decl = m_lctx.find_local_decl(e)) {
+    if (optional<local_decl> decl = find_local_decl(e)) {
         if (optional<expr> const & v = decl->get_value()) {
             /* zeta-reduction */
             return whnf_core(*v, cheap_rec, cheap_proj);
@@ -407,15 +620,6 @@ optional<expr> type_checker::reduce_proj(expr const & e, bool cheap_rec, bool ch
     return reduce_proj_core(c, idx);
 }
 
-static bool is_let_fvar(local_ctx const & lctx, expr const & e) {
-    lean_assert(is_fvar(e));
-    if (optional<local_decl> decl = lctx.find_local_decl(e)) {
-        return static_cast<bool>(decl->get_value());
-    } else {
-        return false;
-    }
-}
-
 /** \brief Weak head normal form core procedure. It does not perform delta reduction nor normalization extensions.
     If `cheap == true`, then we don't perform delta-reduction when reducing major premise of recursors and projections.
     We also do not cache results. */
@@ -431,7 +635,7 @@ expr type_checker::whnf_core(expr const & e, bool cheap_rec, bool cheap_proj) {
     case expr_kind::MData:
         return whnf_core(mdata_expr(e), cheap_rec, cheap_proj);
     case expr_kind::FVar:
-        if (is_let_fvar(m_lctx, e))
+        if (is_let_fvar(e))
             break;
         else
             return e;
@@ -441,9 +645,20 @@ expr type_checker::whnf_core(expr const & e, bool cheap_rec, bool cheap_proj) {
     }
 
     // check cache
+    profile_scope prof(m_diag, &kernel_profile::m_whnf_core);
     auto it = m_st->m_whnf_core.find(e);
-    if (it != m_st->m_whnf_core.end())
+    if (it != m_st->m_whnf_core.end()) {
+        prof.hit();
         return it->second;
+    }
+
+    bool shared = !cheap_rec && !cheap_proj && is_shareable(e);
+    if (shared) {
+        if (auto r = find_shared(closed_term_cache::kind::WhnfCore, e)) {
+            m_st->m_whnf_core.insert(mk_pair(e, *r));
+            return *r;
+        }
+    }
 
     // do the actual work
     expr r;
@@ -500,6 +715,8 @@ expr type_checker::whnf_core(expr const & e, bool cheap_rec, bool cheap_proj) {
     if (!cheap_rec && !cheap_proj) {
         m_st->m_whnf_core.insert(mk_pair(e, r));
     }
+    if (shared)
+        cache_shared(closed_term_cache::kind::WhnfCore, e, r);
     return r;
 }
 
@@ -515,6 +732,36 @@ optional<constant_info> type_checker::is_delta(expr const & e) const {
     return none_constant_info();
 }
 
+/* Number of entries of each of the `state::m_inst_lparams` caches after which it is cleared. */
+#define LEAN_INST_LPARAMS_CACHE_SIZE 16384
+
+/** \brief Return the type (or value if `value` is true) of the constant `info` instantiated with the universe
+    levels of the constant term `c`. Universe polymorphic constants such as `List.{0}` usually occur many times
+    with the same levels, so the results are cached per constant term instead of traversing the type or value
+    again for each occurrence. Unfolded values of imported constants are shared with other type checkers. */
+expr type_checker::instantiate_lparams_cached(constant_info const & info, expr const & c, bool value) {
+    levels const & ls = const_levels(c);
+    if (is_nil(ls) || !has_param_univ(value ? info.get_value() : info.get_type()))
+        return value ? instantiate_value_lparams(info, ls) : instantiate_type_lparams(info, ls);
+    expr_flat_map<expr> & cache = m_st->m_inst_lparams[value];
+    auto it = cache.find(c);
+    if (it != cache.end())
+        return it->second;
+    bool shared = value && is_shareable(c);
+    optional<expr> r;
+    if (shared)
+        r = find_shared(closed_term_cache::kind::Unfold, c);
+    if (!r) {
+        r = value ? instantiate_value_lparams(info, ls) : instantiate_type_lparams(info, ls);
+        if (shared)
+            cache_shared(closed_term_cache::kind::Unfold, c, *r);
+    }
+    if (cache.size() >= LEAN_INST_LPARAMS_CACHE_SIZE)
+        cache.clear();
+    cache.insert(mk_pair(c, *r));
+    return *r;
+}
+
 optional<expr> type_checker::unfold_definition_core(expr const & e) {
     if (is_constant(e)) {
         if (auto d = is_delta(e)) {
@@ -522,7 +769,7 @@ optional<expr> type_checker::unfold_definition_core(expr const & e) {
                 if (m_diag) {
                     m_diag->record_unfold(d->get_name());
                 }
-                return some_expr(instantiate_value_lparams(*d, const_levels(e)));
+                return some_expr(instantiate_lparams_cached(*d, e, true));
             }
         }
     }
@@ -579,10 +826,16 @@ optional<expr> reduce_native(environment const & env, expr const & e) {
 }
 
 static inline bool is_nat_lit_ext(expr const & e) { return e == *g_nat_zero || is_nat_lit(e); }
-static inline nat get_nat_val(expr const & e) {
+/* Return the value of the numeral `e` as a borrowed reference into `e`. It avoids the reference counting
+   operations of copying the `nat`, and the operations below can read the `mpz` in place. */
+static inline b_obj_arg get_nat_val(expr const & e) {
     lean_assert(is_nat_lit_ext(e));
-    if (e == *g_nat_zero) return nat((unsigned)0);
-    return lit_value(e).get_nat();
+    if (e == *g_nat_zero) return box(0);
+    return lit_value(e).get_nat().raw();
+}
+
+static inline expr mk_nat_lit(obj_arg v) {
+    return mk_lit(literal(nat(v)));
 }
 
 template<typename F> optional<expr> type_checker::reduce_bin_nat_op(F const & f, expr const & e) {
@@ -590,9 +843,7 @@ template<typename F> optional<expr> type_checker::reduce_bin_nat_op(F const & f,
     if (!is_nat_lit_ext(arg1)) return none_expr();
     expr arg2 = whnf(app_arg(e));
     if (!is_nat_lit_ext(arg2)) return none_expr();
-    nat v1 = get_nat_val(arg1);
-    nat v2 = get_nat_val(arg2);
-    return some_expr(mk_lit(literal(nat(f(v1.raw(), v2.raw())))));
+    return some_expr(mk_nat_lit(f(get_nat_val(arg1), get_nat_val(arg2))));
 }
 
 #define ReducePowMaxExp 1<<24 // TODO: make it configurable
@@ -601,10 +852,10 @@ optional<expr> type_checker::reduce_pow(expr const & e) {
     expr arg1 = whnf(app_arg(app_fn(e)));
     expr arg2 = whnf(app_arg(e));
     if (!is_nat_lit_ext(arg2)) return none_expr();
-    nat v1 = get_nat_val(arg1);
-    nat v2 = get_nat_val(arg2);
-    if (v2 > nat(ReducePowMaxExp)) return none_expr();
-    return some_expr(mk_lit(literal(nat(nat_pow(v1.raw(), v2.raw())))));
+    if (!is_nat_lit_ext(arg1)) return none_expr();
+    b_obj_arg v2 = get_nat_val(arg2);
+    if (!is_scalar(v2) || unbox(v2) > ReducePowMaxExp) return none_expr();
+    return some_expr(mk_nat_lit(nat_pow(get_nat_val(arg1), v2)));
 }
 
 template<typename F> optional<expr> type_checker::reduce_bin_nat_pred(F const & f, expr const & e) {
@@ -612,9 +863,7 @@ template<typename F> optional<expr> type_checker::reduce_bin_nat_pred(F const &
     if (!is_nat_lit_ext(arg1)) return none_expr();
     expr arg2 = whnf(app_arg(e));
     if (!is_nat_lit_ext(arg2)) return none_expr();
-    nat v1 = get_nat_val(arg1);
-    nat v2 = get_nat_val(arg2);
-    return f(v1.raw(), v2.raw()) ? some_expr(mk_bool_true()) : some_expr(mk_bool_false());
+    return f(get_nat_val(arg1), get_nat_val(arg2)) ? some_expr(mk_bool_true()) : some_expr(mk_bool_false());
 }
 
 optional<expr> type_checker::reduce_nat(expr const & e) {
@@ -625,8 +874,12 @@ optional<expr> type_checker::reduce_nat(expr const & e) {
         if (f == *g_nat_succ) {
             expr arg = whnf(app_arg(e));
             if (!is_nat_lit_ext(arg)) return none_expr();
-            nat v = get_nat_val(arg);
-            return some_expr(mk_lit(literal(nat(v+nat(1)))));
+            return some_expr(mk_nat_lit(nat_succ(get_nat_val(arg))));
+        }
+        if (f == *g_nat_log2) {
+            expr arg = whnf(app_arg(e));
+            if (!is_nat_lit_ext(arg)) return none_expr();
+            return some_expr(mk_nat_lit(lean_nat_log2(get_nat_val(arg))));
         }
     } else if (nargs == 2) {
         expr const & f = app_fn(app_fn(e));
@@ -649,6 +902,61 @@ optional<expr> type_checker::reduce_nat(expr const & e) {
     return none_expr();
 }
 
+/* Return the value of the bitvector `x : BitVec w` as a numeral, if `BitVec.toNat x` reduces to one. */
+optional<expr> type_checker::get_bitvec_val(expr const & w, expr const & x) {
+    expr v = whnf(mk_app(*g_bitvec_to_nat, w, x));
+    if (!is_nat_lit_ext(v)) return none_expr();
+    return some_expr(v);
+}
+
+/* Trusted extension for `BitVec` operations on bitvectors whose values reduce to numerals.
+   `BitVec.add w x y`, `sub`, `mul`, `and`, `or` and `xor` reduce to `BitVec.ofNat w v`, and `BitVec.ult w x y` and
+   `BitVec.ule` to `Bool.true` or `Bool.false`. The results are definitionally equal to the ones obtained by unfolding
+   the definitions, but they are computed directly on the `nat` values instead of going through `Fin` and `Nat`
+   arithmetic on projections. `UIntN` operations unfold to these `BitVec` operations.
+   The extension is disabled unless `set_bitvec_reduction(true)` is used. */
+optional<expr> type_checker::reduce_bitvec(expr const & e) {
+    if (!g_reduce_bitvec.load(std::memory_order_relaxed) || has_fvar(e)) return none_expr();
+    if (get_app_num_args(e) != 3) return none_expr();
+    expr const & f = get_app_fn(e);
+    if (!is_constant(f)) return none_expr();
+    name const & op = const_name(f);
+    if (op != *g_bitvec_add && op != *g_bitvec_sub && op != *g_bitvec_mul &&
+        op != *g_bitvec_and && op != *g_bitvec_or  && op != *g_bitvec_xor &&
+        op != *g_bitvec_ult && op != *g_bitvec_ule)
+        return none_expr();
+    expr const & w_arg = app_arg(app_fn(app_fn(e)));
+    expr w = whnf(w_arg);
+    if (!is_nat_lit_ext(w)) return none_expr();
+    b_obj_arg w_val = get_nat_val(w);
+    if (!is_scalar(w_val) || unbox(w_val) > ReducePowMaxExp) return none_expr();
+    optional<expr> x = get_bitvec_val(w_arg, app_arg(app_fn(e)));
+    if (!x) return none_expr();
+    optional<expr> y = get_bitvec_val(w_arg, app_arg(e));
+    if (!y) return none_expr();
+    nat v1(get_nat_val(*x), true);
+    nat v2(get_nat_val(*y), true);
+    if (op == *g_bitvec_ult) return nat_lt(v1.raw(), v2.raw()) ? some_expr(mk_bool_true()) : some_expr(mk_bool_false());
+    if (op == *g_bitvec_ule) return nat_le(v1.raw(), v2.raw()) ? some_expr(mk_bool_true()) : some_expr(mk_bool_false());
+    nat r;
+    if (op == *g_bitvec_and) {
+        r = nat(nat_land(v1.raw(), v2.raw()));
+    } else if (op == *g_bitvec_or) {
+        r = nat(nat_lor(v1.raw(), v2.raw()));
+    } else if (op == *g_bitvec_xor) {
+        r = nat(nat_lxor(v1.raw(), v2.raw()));
+    } else {
+        nat m(lean_nat_shiftl(box(1), w_val));
+        if (op == *g_bitvec_add)
+            r = (v1 + v2) % m;
+        else if (op == *g_bitvec_sub)
+            r = ((m - v2) + v1) % m;
+        else
+            r = (v1 * v2) % m;
+    }
+    return some_expr(mk_app(*g_bitvec_of_nat, w_arg, mk_lit(literal(r))));
+}
+
 /** \brief Put expression \c t in weak head normal form */
 expr type_checker::whnf(expr const & e) {
     // Do not cache easy cases
@@ -659,7 +967,7 @@ expr type_checker::whnf(expr const & e) {
     case expr_kind::MData:
         return whnf(mdata_expr(e));
     case expr_kind::FVar:
-        if (is_let_fvar(m_lctx, e))
+        if (is_let_fvar(e))
             break;
         else
             return e;
@@ -669,27 +977,47 @@ expr type_checker::whnf(expr const & e) {
     }
 
     // check cache
+    profile_scope prof(m_diag, &kernel_profile::m_whnf);
     auto it = m_st->m_whnf.find(e);
-    if (it != m_st->m_whnf.end())
+    if (it != m_st->m_whnf.end()) {
+        prof.hit();
         return it->second;
+    }
+
+    bool shared = is_shareable(e);
+    if (shared) {
+        if (auto r = find_shared(closed_term_cache::kind::Whnf, e)) {
+            m_st->m_whnf.insert(mk_pair(e, *r));
+            return *r;
+        }
+    }
 
     expr t = e;
-    while (true) {
+    optional<expr> r;
+    optional<name> unfolded;
+    while (!r) {
         expr t1 = whnf_core(t);
         if (auto v = reduce_native(env(), t1)) {
-            m_st->m_whnf.insert(mk_pair(e, *v));
-            return *v;
+            r = v;
         } else if (auto v = reduce_nat(t1)) {
-            m_st->m_whnf.insert(mk_pair(e, *v));
-            return *v;
+            r = v;
+        } else if (auto v = reduce_bitvec(t1)) {
+            /* `BitVec.ofNat w v` is not in weak head normal form yet. */
+            t = *v;
         } else if (auto next_t = unfold_definition(t1)) {
+            if (!unfolded && prof.is_outermost())
+                unfolded = const_name(get_app_fn(t1));
             t = *next_t;
         } else {
-            auto r = t1;
-            m_st->m_whnf.insert(mk_pair(e, r));
-            return r;
+            r = t1;
         }
     }
+    if (unfolded)
+        m_diag->profile()->m_unfold_time[*unfolded] += prof.elapsed();
+    m_st->m_whnf.insert(mk_pair(e, *r));
+    if (shared)
+        cache_shared(closed_term_cache::kind::Whnf, e, *r);
+    return *r;
 }
 
 /** \brief Given lambda/Pi expressions \c t and \c s, return true iff \c t is def eq to \c s.
@@ -717,7 +1045,7 @@ bool type_checker::is_def_eq_binding(expr t, expr s) {
             // free variable is used inside t or s
             if (!var_s_type)
                 var_s_type = instantiate_rev(binding_domain(s), subst.size(), subst.data());
-            subst.push_back(m_lctx.mk_local_decl(m_st->m_ngen, binding_name(s), *var_s_type, binding_info(s)));
+            subst.push_back(mk_local_decl(binding_name(s), *var_s_type, binding_info(s)));
         } else {
             subst.push_back(*g_dont_care); // don't care
         }
@@ -982,6 +1310,7 @@ lbool type_checker::is_def_eq_offset(expr const & t, expr const & s) {
 }
 
 lbool type_checker::lazy_delta_reduction(expr & t_n, expr & s_n) {
+    profile_scope prof(m_diag, &kernel_profile::m_lazy_delta);
     while (true) {
         lbool r = is_def_eq_offset(t_n, s_n);
         if (r != l_undef) return r;
@@ -991,6 +1320,10 @@ lbool type_checker::lazy_delta_reduction(expr & t_n, expr & s_n) {
                 return to_lbool(is_def_eq_core(*t_v, s_n));
             } else if (auto s_v = reduce_nat(s_n)) {
                 return to_lbool(is_def_eq_core(t_n, *s_v));
+            } else if (auto t_v = reduce_bitvec(t_n)) {
+                return to_lbool(is_def_eq_core(*t_v, s_n));
+            } else if (auto s_v = reduce_bitvec(s_n)) {
+                return to_lbool(is_def_eq_core(t_n, *s_v));
             }
         }
 
@@ -1066,6 +1399,7 @@ bool type_checker::is_def_eq_unit_like(expr const & t, expr const & s) {
 
 bool type_checker::is_def_eq_core(expr const & t, expr const & s) {
     check_system("is_definitionally_equal", /* do_check_interrupted */ true);
+    profile_scope prof(m_diag, &kernel_profile::m_is_def_eq);
     bool use_hash = true;
     lbool r = quick_is_def_eq(t, s, use_hash);
     if (r != l_undef) return r == l_true;
@@ -1153,18 +1487,26 @@ expr type_checker::eta_expand(expr const & e) {
     expr it = e;
     while (is_lambda(it)) {
         expr d = instantiate_rev(binding_domain(it), fvars.size(), fvars.data());
-        fvars.push_back(m_lctx.mk_local_decl(m_st->m_ngen, binding_name(it), d, binding_info(it)));
+        fvars.push_back(mk_local_decl(binding_name(it), d, binding_info(it)));
         it     = binding_body(it);
     }
     it = instantiate_rev(it, fvars.size(), fvars.data());
     expr it_type = whnf(infer(it));
     if (!is_pi(it_type)) return e;
     buffer<expr> args;
-    while (is_pi(it_type)) {
-        expr arg = m_lctx.mk_local_decl(m_st->m_ngen, binding_name(it_type), binding_domain(it_type), binding_info(it_type));
+    unsigned j = 0;
+    while (true) {
+        if (!is_pi(it_type)) {
+            it_type = whnf(instantiate_rev(it_type, args.size() - j, args.data() + j));
+            j = args.size();
+            if (!is_pi(it_type))
+                break;
+        }
+        expr d   = instantiate_rev(binding_domain(it_type), args.size() - j, args.data() + j);
+        expr arg = mk_local_decl(binding_name(it_type), d, binding_info(it_type));
         args.push_back(arg);
         fvars.push_back(arg);
-        it_type  = whnf(instantiate(binding_body(it_type), arg));
+        it_type  = binding_body(it_type);
     }
     expr r = mk_app(it, args);
     return m_lctx.mk_lambda(fvars, r);
@@ -1172,17 +1514,17 @@ expr type_checker::eta_expand(expr const & e) {
 
 type_checker::type_checker(environment const & env, local_ctx const & lctx, diagnostics * diag, definition_safety ds):
     m_st_owner(true), m_st(new state(env)), m_diag(diag),
-    m_lctx(lctx), m_definition_safety(ds), m_lparams(nullptr) {
+    m_lctx(lctx), m_definition_safety(ds), m_lparams(nullptr), m_checked_types(nullptr) {
 }
 
-type_checker::type_checker(state & st, local_ctx const & lctx, definition_safety ds):
-    m_st_owner(false), m_st(&st), m_diag(nullptr), m_lctx(lctx),
-    m_definition_safety(ds), m_lparams(nullptr) {
+type_checker::type_checker(state & st, local_ctx const & lctx, diagnostics * diag, definition_safety ds):
+    m_st_owner(false), m_st(&st), m_diag(diag), m_lctx(lctx),
+    m_definition_safety(ds), m_lparams(nullptr), m_checked_types(nullptr) {
 }
 
 type_checker::type_checker(type_checker && src):
     m_st_owner(src.m_st_owner), m_st(src.m_st), m_diag(src.m_diag), m_lctx(std::move(src.m_lctx)),
-    m_definition_safety(src.m_definition_safety), m_lparams(src.m_lparams) {
+    m_definition_safety(src.m_definition_safety), m_lparams(src.m_lparams), m_checked_types(src.m_checked_types) {
     src.m_st_owner = false;
 }
 
@@ -1191,6 +1533,24 @@ type_checker::~type_checker() {
         delete m_st;
 }
 
+void set_closed_term_cache_capacity(size_t c) {
+    g_closed_term_cache->set_capacity(c);
+}
+
+extern "C" LEAN_EXPORT obj_res lean_kernel_set_closed_term_cache_capacity(size_t c, obj_arg) {
+    set_closed_term_cache_capacity(c);
+    return io_result_mk_ok(box(0));
+}
+
+void set_bitvec_reduction(bool enable) {
+    g_reduce_bitvec = enable;
+}
+
+extern "C" LEAN_EXPORT obj_res lean_kernel_set_bitvec_reduction(uint8 enable, obj_arg) {
+    set_bitvec_reduction(enable != 0);
+    return io_result_mk_ok(box(0));
+}
+
 extern "C" LEAN_EXPORT lean_object * lean_kernel_is_def_eq(lean_object * env, lean_object * lctx, lean_object * a, lean_object * b) {
     return catch_kernel_exceptions<object*>([&]() {
         return lean_box(type_checker(environment(env), local_ctx(lctx)).is_def_eq(expr(a), expr(b)));
@@ -1228,6 +1588,7 @@ void initialize_type_checker() {
     g_nat_mul      = new_persistent_expr_const({"Nat", "mul"});
     g_nat_pow      = new_persistent_expr_const({"Nat", "pow"});
     g_nat_gcd      = new_persistent_expr_const({"Nat", "gcd"});
+    g_nat_log2     = new_persistent_expr_const({"Nat", "log2"});
     g_nat_div      = new_persistent_expr_const({"Nat", "div"});
     g_nat_mod      = new_persistent_expr_const({"Nat", "mod"});
     g_nat_beq      = new_persistent_expr_const({"Nat", "beq"});
@@ -1240,6 +1601,25 @@ void initialize_type_checker() {
     g_string_mk    = new_persistent_expr_const({"String", "mk"});
     g_lean_reduce_bool = new_persistent_expr_const({"Lean", "reduceBool"});
     g_lean_reduce_nat  = new_persistent_expr_const({"Lean", "reduceNat"});
+    g_bitvec_of_nat = new_persistent_expr_const({"BitVec", "ofNat"});
+    g_bitvec_to_nat = new_persistent_expr_const({"BitVec", "toNat"});
+    g_bitvec_add    = new name{"BitVec", "add"};
+    mark_persistent(g_bitvec_add->raw());
+    g_bitvec_sub    = new name{"BitVec", "sub"};
+    mark_persistent(g_bitvec_sub->raw());
+    g_bitvec_mul    = new name{"BitVec", "mul"};
+    mark_persistent(g_bitvec_mul->raw());
+    g_bitvec_and    = new name{"BitVec", "and"};
+    mark_persistent(g_bitvec_and->raw());
+    g_bitvec_or     = new name{"BitVec", "or"};
+    mark_persistent(g_bitvec_or->raw());
+    g_bitvec_xor    = new name{"BitVec", "xor"};
+    mark_persistent(g_bitvec_xor->raw());
+    g_bitvec_ult    = new name{"BitVec", "ult"};
+    mark_persistent(g_bitvec_ult->raw());
+    g_bitvec_ule    = new name{"BitVec", "ule"};
+    mark_persistent(g_bitvec_ule->raw());
+    g_closed_term_cache = new closed_term_cache();
     register_name_generator_prefix(*g_kernel_fresh);
 }
 
@@ -1254,6 +1634,7 @@ void finalize_type_checker() {
     delete g_nat_mul;
     delete g_nat_pow;
     delete g_nat_gcd;
+    delete g_nat_log2;
     delete g_nat_div;
     delete g_nat_mod;
     delete g_nat_beq;
@@ -1266,5 +1647,16 @@ void finalize_type_checker() {
     delete g_string_mk;
     delete g_lean_reduce_bool;
     delete g_lean_reduce_nat;
+    delete g_bitvec_of_nat;
+    delete g_bitvec_to_nat;
+    delete g_bitvec_add;
+    delete g_bitvec_sub;
+    delete g_bitvec_mul;
+    delete g_bitvec_and;
+    delete g_bitvec_or;
+    delete g_bitvec_xor;
+    delete g_bitvec_ult;
+    delete g_bitvec_ule;
+    delete g_closed_term_cache;
 }
 }
@@ -6,6 +6,7 @@ Author: Leonardo de Moura
 */
 #pragma once
 #include <unordered_set>
+#include <vector>
 #include <memory>
 #include <utility>
 #include <algorithm>
@@ -16,6 +17,7 @@ Author: Leonardo de Moura
 #include "kernel/local_ctx.h"
 #include "kernel/expr_maps.h"
 #include "kernel/equiv_manager.h"
+#include "kernel/closed_term_cache.h"
 
 namespace lean {
 /** \brief Lean Type Checker. It can also be used to infer types, check whether a
@@ -23,15 +25,24 @@ namespace lean {
 class type_checker {
 public:
     class state {
-        typedef expr_map<expr> infer_cache;
+        typedef expr_flat_map<expr> infer_cache;
         typedef std::unordered_set<expr_pair, expr_pair_hash, expr_pair_eq> expr_pair_set;
         environment               m_env;
         name_generator            m_ngen;
         infer_cache               m_infer_type[2];
-        expr_map<expr>            m_whnf_core;
-        expr_map<expr>            m_whnf;
+        expr_flat_map<expr>       m_whnf_core;
+        expr_flat_map<expr>       m_whnf;
         equiv_manager             m_eqv_manager;
         expr_pair_set             m_failure;
+        /* `m_env.get_imports()`, the scope of the results stored in the shared `closed_term_cache`. */
+        optional<object_ref>      m_imports;
+        expr_flat_map<bool>       m_shareable;
+        /* Types (`[0]`) and values (`[1]`) of universe polymorphic constants instantiated with the levels of
+           the constant term used as the key, see `type_checker::instantiate_lparams_cached`. */
+        expr_flat_map<expr>       m_inst_lparams[2];
+        /* Local declarations created by `type_checker::mk_local_decl`, indexed by the numeral of
+           their fresh name. See `type_checker::find_local_decl`. */
+        std::vector<local_decl>   m_fvar_decls;
         friend type_checker;
     public:
         state(environment const & env);
@@ -48,10 +59,16 @@ private:
     /* When `m_lparams != nullptr, the `check` method makes sure all level parameters
        are in `m_lparams`. */
     names const *             m_lparams;
+    /* Types of closed terms checked by a previous run (see `checked_decl_cache`). */
+    expr_map<expr> const *    m_checked_types;
 
     expr ensure_sort_core(expr e, expr const & s);
     expr ensure_pi_core(expr e, expr const & s);
     void check_level(level const & l);
+    expr mk_local_decl(name const & un, expr const & type, binder_info bi);
+    expr mk_local_decl(name const & un, expr const & type, expr const & value);
+    optional<local_decl> find_local_decl(expr const & e) const;
+    bool is_let_fvar(expr const & e) const;
     expr infer_fvar(expr const & e);
     expr infer_constant(expr const & e, bool infer_only);
     expr infer_lambda(expr const & e, bool infer_only);
@@ -62,12 +79,18 @@ private:
     expr infer_type_core(expr const & e, bool infer_only);
     expr infer_type(expr const & e);
 
+    bool is_shareable_core(expr const & e);
+    bool is_shareable(expr const & e);
+    optional<expr> find_shared(closed_term_cache::kind k, expr const & e);
+    void cache_shared(closed_term_cache::kind k, expr const & e, expr const & r);
+
     enum class reduction_status { Continue, DefUnknown, DefEqual, DefDiff };
     optional<expr> reduce_recursor(expr const & e, bool cheap_rec, bool cheap_proj);
     optional<expr> reduce_proj_core(expr c, unsigned idx);
     optional<expr> reduce_proj(expr const & e, bool cheap_rec, bool cheap_proj);
     expr whnf_fvar(expr const & e, bool cheap_rec, bool cheap_proj);
     optional<constant_info> is_delta(expr const & e) const;
+    expr instantiate_lparams_cached(constant_info const & info, expr const & c, bool value);
     optional<expr> unfold_definition_core(expr const & e);
 
     bool is_def_eq_binding(expr t, expr s);
@@ -103,8 +126,11 @@ private:
     template<typename F> optional<expr> reduce_bin_nat_pred(F const & f, expr const & e);
     optional<expr> reduce_pow(expr const & e);
     optional<expr> reduce_nat(expr const & e);
+    optional<expr> get_bitvec_val(expr const & w, expr const & x);
+    optional<expr> reduce_bitvec(expr const & e);
 public:
-    type_checker(state & st, local_ctx const & lctx, definition_safety ds = definition_safety::safe);
+    type_checker(state & st, local_ctx const & lctx, diagnostics * diag, definition_safety ds = definition_safety::safe);
+    type_checker(state & st, local_ctx const & lctx, definition_safety ds = definition_safety::safe):type_checker(st, lctx, nullptr, ds) {}
     type_checker(state & st, definition_safety ds = definition_safety::safe):type_checker(st, local_ctx(), ds) {}
     type_checker(environment const & env, local_ctx const & lctx, diagnostics * diag = nullptr, definition_safety ds = definition_safety::safe);
     type_checker(environment const & env, diagnostics * diag = nullptr, definition_safety ds = definition_safety::safe):type_checker(env, local_ctx(), diag, ds) {}
@@ -126,6 +152,12 @@ public:
     expr check(expr const & t, names const & ps);
     /** \brief Like \c check, but ignores undefined universes */
     expr check(expr const & t) { return check_ignore_undefined_universes(t); }
+    /** \brief Trust the types in \c m for closed terms in \c check.
+        \pre They were checked with the same level parameters, and in an environment where
+        the constants they depend on are the same. */
+    void set_checked_types(expr_map<expr> const * m) { m_checked_types = m; }
+    /** \brief Store in \c m the types of the closed terms checked so far. */
+    void get_checked_types(expr_map<expr> & m) const;
 
     /** \brief Return true iff t is definitionally equal to s. */
     bool is_def_eq(expr const & t, expr const & s);
@@ -161,6 +193,11 @@ public:
     optional<expr> unfold_definition(expr const & e);
 };
 
+/** \brief Set the capacity of the `closed_term_cache` shared by all type checkers. It is disabled by default (capacity 0). */
+void set_closed_term_cache_capacity(size_t c);
+/** \brief Enable or disable the trusted `BitVec` literal extension (see `type_checker::reduce_bitvec`). It is disabled by default. */
+void set_bitvec_reduction(bool enable);
+
 void initialize_type_checker();
 void finalize_type_checker();
 }
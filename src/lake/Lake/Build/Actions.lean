@@ -16,13 +16,16 @@ open Lean hiding SearchPath
 
 namespace Lake
 
-def compileLeanModule
+/--
+Create the parent directories of the output files of a module and
+compute the arguments of the `lean` invocation that compiles it.
+-/
+def mkLeanModuleArgs
   (leanFile : FilePath)
   (oleanFile? ileanFile? cFile? bcFile?: Option FilePath)
-  (leanPath : SearchPath := []) (rootDir : FilePath := ".")
-  (dynlibs : Array FilePath := #[]) (dynlibPath : SearchPath := {})
-  (leanArgs : Array String := #[]) (lean : FilePath := "lean")
-: LogIO Unit := do
+  (rootDir : FilePath := ".") (dynlibs : Array FilePath := #[])
+  (leanArgs : Array String := #[])
+: IO (Array String) := do
   let mut args := leanArgs ++
     #[leanFile.toString, "-R", rootDir.toString]
   if let some oleanFile := oleanFile? then
@@ -39,18 +42,21 @@ def compileLeanModule
     args := args ++ #["-b", bcFile.toString]
   for dynlib in dynlibs do
     args := args.push s!"--load-dynlib={dynlib}"
-  args := args.push "--json"
-  withLogErrorPos do
-  let out ← rawProc {
-    args
-    cmd := lean.toString
-    env := #[
-      ("LEAN_PATH", leanPath.toString),
-      (sharedLibPathEnvVar, (← getSearchPath sharedLibPathEnvVar) ++ dynlibPath |>.toString)
-    ]
-  }
-  unless out.stdout.isEmpty do
-    let txt ← out.stdout.split (· == '\n') |>.foldlM (init := "") fun txt ln => do
+  return args.push "--json"
+
+/-- The environment of the `lean` invocation that compiles a module. -/
+def mkLeanModuleEnv
+  (leanPath : SearchPath := []) (dynlibPath : SearchPath := {})
+: BaseIO (Array (String × Option String)) := do
+  return #[
+    ("LEAN_PATH", leanPath.toString),
+    (sharedLibPathEnvVar, (← getSearchPath sharedLibPathEnvVar) ++ dynlibPath |>.toString)
+  ]
+
+/-- Log the output of `lean --json`, turning its JSON messages into log entries. -/
+def logLeanOutput (stdout stderr : String) : LogIO Unit := do
+  unless stdout.isEmpty do
+    let txt ← stdout.split (· == '\n') |>.foldlM (init := "") fun txt ln => do
       if let .ok (msg : SerialMessage) := Json.parse ln >>= fromJson? then
         unless txt.isEmpty do
           logInfo s!"stdout:\n{txt}"
@@ -62,8 +68,24 @@ def compileLeanModule
         return txt ++ ln ++ "\n"
     unless txt.isEmpty do
       logInfo s!"stdout:\n{txt}"
-  unless out.stderr.isEmpty do
-    logInfo s!"stderr:\n{out.stderr}"
+  unless stderr.isEmpty do
+    logInfo s!"stderr:\n{stderr}"
+
+def compileLeanModule
+  (leanFile : FilePath)
+  (oleanFile? ileanFile? cFile? bcFile?: Option FilePath)
+  (leanPath : SearchPath := []) (rootDir : FilePath := ".")
+  (dynlibs : Array FilePath := #[]) (dynlibPath : SearchPath := {})
+  (leanArgs : Array String := #[]) (lean : FilePath := "lean")
+: LogIO Unit := do
+  let args ← mkLeanModuleArgs leanFile oleanFile? ileanFile? cFile? bcFile? rootDir dynlibs leanArgs
+  withLogErrorPos do
+  let out ← rawProc {
+    args
+    cmd := lean.toString
+    env := ← mkLeanModuleEnv leanPath dynlibPath
+  }
+  logLeanOutput out.stdout out.stderr
   if out.exitCode ≠ 0 then
     error s!"Lean exited with code {out.exitCode}"
 
@@ -77,14 +99,23 @@ def compileO
     args := #["-c", "-o", oFile.toString, srcFile.toString] ++ moreArgs
   }
 
+/--
+Creates the static library `libFile` from `oFiles` using `ar`, replacing any previous version.
+A `thin` archive only references the object files instead of copying them, which requires an
+`ar` that supports `--thin` (e.g., `llvm-ar` or GNU `ar`).
+-/
 def compileStaticLib
   (libFile : FilePath) (oFiles : Array FilePath)
-  (ar : FilePath := "ar")
+  (ar : FilePath := "ar") (thin := false)
 : LogIO Unit := do
   createParentDirs libFile
+  -- `ar` would otherwise keep members that are no longer part of the library
+  if (← libFile.pathExists) then
+    IO.FS.removeFile libFile
+  let thinArgs := if thin then #["--thin"] else #[]
   proc {
     cmd := ar.toString
-    args := #["rcs", libFile.toString] ++ oFiles.map toString
+    args := #["rcs"] ++ thinArgs ++ #[libFile.toString] ++ oFiles.map toString
   }
 
 def compileSharedLib
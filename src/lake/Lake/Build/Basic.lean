@@ -8,6 +8,10 @@ import Lake.Util.Exit
 import Lake.Util.Lift
 import Lake.Config.Context
 import Lake.Build.Trace
+import Lake.Build.HashCache
+import Lake.Build.Schedule
+import Lake.Build.LeanWorker
+import Lean.Environment
 
 open System
 namespace Lake
@@ -42,6 +46,11 @@ structure BuildConfig where
   out : OutStream := .stderr
   /-- Whether to use ANSI escape codes in build output. -/
   ansiMode : AnsiMode := .auto
+  /--
+  Compile modules in long-lived `lean --fork-server` processes
+  instead of spawning `lean` for each module.
+  -/
+  leanWorkers : Bool := false
 
 /--
 Whether the build should show progress information.
@@ -71,9 +80,20 @@ declare_opaque_type OpaqueJobTask
 /-- A Lake job with an opaque value type in `Type`. -/
 abbrev OpaqueJob := JobCore OpaqueJobTask
 
+/-- A task parsing the imports of a Lean source file. -/
+abbrev HeaderTask := Task (Except IO.Error (Array Lean.Import))
+
 /-- A Lake context with a build configuration and additional build data. -/
 structure BuildContext extends BuildConfig, Context where
   leanTrace : BuildTrace
+  /-- The workspace's cache of input file hashes. -/
+  hashCache : HashCache
+  /-- The module build timings used to prioritize module builds. -/
+  schedule : BuildSchedule
+  /-- The pool of Lean workers, if `leanWorkers` is enabled. -/
+  leanWorkers? : Option LeanWorkerPool
+  /-- The header parsing tasks spawned so far, keyed by source file path. -/
+  headerTasks : IO.Ref (Std.HashMap String HeaderTask)
   registeredJobs : IO.Ref (Array OpaqueJob)
 
 /-- A transformer to equip a monad with a `BuildContext`. -/
@@ -89,6 +109,12 @@ abbrev MonadBuild (m : Type → Type u) :=
 @[inline] def getLeanTrace [Functor m] [MonadBuild m] : m BuildTrace :=
   (·.leanTrace) <$> getBuildContext
 
+@[inline] def getHashCache [Functor m] [MonadBuild m] : m HashCache :=
+  (·.hashCache) <$> getBuildContext
+
+@[inline] def getBuildSchedule [Functor m] [MonadBuild m] : m BuildSchedule :=
+  (·.schedule) <$> getBuildContext
+
 @[inline] def getBuildConfig [Functor m] [MonadBuild m] : m BuildConfig :=
   (·.toBuildConfig) <$> getBuildContext
 
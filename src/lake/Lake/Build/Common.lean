@@ -174,6 +174,13 @@ def fetchFileHash (file : FilePath) : JobM Hash := do
   IO.FS.writeFile hashFile hash.toString
   return hash
 
+/--
+Computes the trace of a file, reusing its hash from the workspace's
+hash cache if the file has not changed since it was last hashed.
+-/
+def computeCachedTrace (file : FilePath) (text := false) : JobM BuildTrace := do
+  (← getHashCache).computeTrace file text
+
 /--
 Fetches the trace of a file that may have already have its hash cached
 in a `.hash` file. If no such `.hash` file exists, recomputes and creates it.
@@ -235,14 +242,14 @@ A build job for binary file that is expected to already exist (e.g., a data blob
 Any byte difference in the file will trigger a rebuild of dependents.
 -/
 def inputBinFile (path : FilePath) : SpawnM (BuildJob FilePath) :=
-  Job.async <| (path, ·) <$> computeTrace path
+  Job.async <| (path, ·) <$> computeCachedTrace path
 
 /--
 A build job for text file that is expected to already exist (e.g., a source file).
 Normalizes line endings (converts CRLF to LF) to produce platform-independent traces.
 -/
 def inputTextFile (path : FilePath) : SpawnM (BuildJob FilePath) :=
-  Job.async <| (path, ·) <$> computeTrace (TextFilePath.mk path)
+  Job.async <| (path, ·) <$> computeCachedTrace path (text := true)
 
 /--
 A build job for file that is expected to already exist.
@@ -277,22 +284,78 @@ which will be computed in the resulting `BuildJob` before building.
   buildFileAfterDep oFile srcJob (extraDepTrace := extraDepTrace) fun srcFile => do
     compileO oFile srcFile (weakArgs ++ traceArgs) compiler
 
-/-- Build an object file from a source fie job (i.e, a `lean -c` output) using `leanc`. -/
+/-- The number of versions of each object file kept in the object cache (see `buildCachedO`). -/
+def objCacheVersions : Nat := 8
+
+/--
+Deletes all but the `objCacheVersions` most recently added object files of the object cache
+directory `dir`. Files that have already been deleted by another Lake process are skipped.
+-/
+def pruneObjCache (dir : FilePath) : IO PUnit := do
+  let files ← (← dir.readDir).filterMapM fun entry => do
+    if entry.path.extension != some "o" then
+      return none
+    try return some (entry.path, (← entry.path.metadata).modified) catch _ => return none
+  if files.size ≤ objCacheVersions then
+    return
+  let files := files.qsort (fun a b => a.2 > b.2)
+  for (file, _) in files.extract objCacheVersions files.size do
+    try IO.FS.removeFile file catch _ => pure ()
+
+/--
+Creates `oFile` using `build` unless the root package's object cache contains an object file for
+`key`, in which case that one is copied to `oFile` instead. After building, `oFile` is added to
+the cache. Unlike the `.trace` file of `oFile`, which only describes its latest version, the cache
+keeps the object files of the last `objCacheVersions` versions of the source, so that, e.g.,
+reverting an edit or switching branches does not recompile C code that has been compiled before.
+The cache is part of the build directory and thus removed by `lake clean`.
+-/
+def buildCachedO (oFile : FilePath) (key : Hash) (build : JobM PUnit) : JobM PUnit := do
+  -- the versions of an object file are stored together, so that old ones can be evicted
+  let cacheDir := (← getRootPackage).objCacheDir / toString (pureHash oFile.toString)
+  let cacheFile := cacheDir / s!"{key}.o"
+  if (← cacheFile.pathExists) then
+    createParentDirs oFile
+    IO.FS.writeBinFile oFile (← IO.FS.readBinFile cacheFile)
+  else
+    build
+    IO.FS.createDirAll cacheDir
+    -- write to a unique file first, as other Lake processes may use the cache concurrently
+    let tmpFile := cacheFile.addExtension s!"{← IO.monoNanosNow}.tmp"
+    IO.FS.writeBinFile tmpFile (← IO.FS.readBinFile oFile)
+    IO.FS.rename tmpFile cacheFile
+    pruneObjCache cacheDir
+
+/--
+Build an object file from a source fie job (i.e, a `lean -c` output) using `leanc`.
+Object files are cached by the hash of the C code and the arguments (see `buildCachedO`).
+-/
 @[inline] def buildLeanO
   (oFile : FilePath) (srcJob : BuildJob FilePath)
   (weakArgs traceArgs : Array String := #[])
 : SpawnM (BuildJob FilePath) :=
-  let extraDepTrace :=
-    return (← getLeanTrace).mix <| (pureHash traceArgs).mix platformTrace
-  buildFileAfterDep oFile srcJob (extraDepTrace := extraDepTrace) fun srcFile => do
-     compileO oFile srcFile (weakArgs ++ traceArgs) (← getLeanc)
+  srcJob.bindSync fun srcFile srcTrace => do
+    let depTrace := srcTrace.mix <| (← getLeanTrace).mix <| (pureHash traceArgs).mix platformTrace
+    let trace ← buildFileUnlessUpToDate oFile depTrace do
+      buildCachedO oFile depTrace.hash do
+        compileO oFile srcFile (weakArgs ++ traceArgs) (← getLeanc)
+    return (oFile, trace)
 
-/-- Build a static library from object file jobs using the `ar` packaged with Lean. -/
+/--
+Build a static library from object file jobs using the `ar` packaged with Lean.
+A `thin` archive only references the object files (see `compileStaticLib`).
+-/
 def buildStaticLib
-  (libFile : FilePath) (oFileJobs : Array (BuildJob FilePath))
-: SpawnM (BuildJob FilePath) :=
-  buildFileAfterDepArray libFile oFileJobs fun oFiles => do
-    compileStaticLib libFile oFiles (← getLeanAr)
+  (libFile : FilePath) (oFileJobs : Array (BuildJob FilePath)) (thin := false)
+: SpawnM (BuildJob FilePath) := do
+  (← BuildJob.collectArray oFileJobs).bindSync fun oFiles oTrace => do
+    let trace ← buildFileUnlessUpToDate libFile oTrace do
+      compileStaticLib libFile oFiles (← getLeanAr) thin
+    if thin then
+      -- the contents of a thin archive do not change with those of its members
+      return (libFile, trace.mix oTrace)
+    else
+      return (libFile, trace)
 
 /-- Build a shared library by linking the results of `linkJobs` using `leanc`. -/
 def buildLeanSharedLib
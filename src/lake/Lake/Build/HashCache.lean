@@ -0,0 +1,112 @@
+/-
+Copyright (c) 2024 Lean FRO, LLC. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+-/
+import Std.Data.HashMap.Basic
+import Lake.Build.Trace
+
+/-! # Hash Cache
+
+A persistent cache of input file hashes, which lets a no-op build
+skip rehashing the files that did not change since the previous build.
+-/
+
+open System
+
+namespace Lake
+
+/-- The key of a `HashCache` entry. -/
+structure HashCache.Key where
+  path : String
+  /-- Whether the file was hashed as text (i.e., with normalized line endings). -/
+  text : Bool
+  deriving BEq, Hashable
+
+/-- A file hash, together with the file stamp it is valid for. -/
+structure HashCache.Entry where
+  size : UInt64
+  mtime : IO.FS.SystemTime
+  hash : Hash
+
+/-- The contents of a `HashCache`. -/
+structure HashCache.Data where
+  entries : Std.HashMap HashCache.Key HashCache.Entry := {}
+  /-- Whether entries have been added since the cache was loaded. -/
+  dirty : Bool := false
+
+/--
+A cache of file hashes keyed by path, size, and modification time.
+A file whose size and modification time match its cached entry is not rehashed.
+-/
+structure HashCache where
+  ref : IO.Ref HashCache.Data
+
+namespace HashCache
+
+/-- The first line of a hash cache file. Bump it when the hash or file format changes. -/
+def header : String := "lake-hash-cache 1"
+
+/-- The path of the hash cache file of a workspace with the given `.lake` directory. -/
+def file (lakeDir : FilePath) : FilePath :=
+  lakeDir / "hashes"
+
+/-- Parses a line of the format `<sec> <nsec> <size> <text> <hash> <path>`. -/
+def parseEntry? (line : String) : Option (Key × Entry) := do
+  let sec :: nsec :: size :: text :: hash :: path := line.splitOn " " | none
+  let path := " ".intercalate path
+  guard !path.isEmpty
+  let mtime : IO.FS.SystemTime := ⟨← sec.toInt?, (← nsec.toNat?).toUInt32⟩
+  let entry := {size := (← size.toNat?).toUInt64, mtime, hash := ← Hash.ofString? hash}
+  return ({path, text := text == "1"}, entry)
+
+def Entry.toLine (key : Key) (entry : Entry) : String :=
+  let text := if key.text then "1" else "0"
+  s!"{entry.mtime.sec} {entry.mtime.nsec} {entry.size} {text} {entry.hash} {key.path}\n"
+
+/--
+Loads the hash cache from `file`, starting afresh if it is missing or invalid.
+
+As in Git's index, entries whose modification time is not older than the
+cache file itself are dropped: the file may have been modified again within
+the resolution of the file system timestamps after it was hashed.
+-/
+def load (file : FilePath) : BaseIO HashCache := do
+  let entries ← loadEntries.catchExceptions fun _ => pure {}
+  return ⟨← IO.mkRef {entries}⟩
+where
+  loadEntries : IO (Std.HashMap Key Entry) := do
+    let savedAt := (← file.metadata).modified
+    let contents ← IO.FS.readFile file
+    let header' :: lines := contents.splitOn "\n" | return {}
+    unless header' == header do return {}
+    return lines.foldl (init := {}) fun entries line =>
+      match parseEntry? line with
+      | some (key, entry) =>
+        if entry.mtime < savedAt then entries.insert key entry else entries
+      | none => entries
+
+/-- Writes the hash cache to `file` if entries have been added since it was loaded. -/
+def save (self : HashCache) (file : FilePath) : IO Unit := do
+  let data ← self.ref.get
+  unless data.dirty do return
+  let contents := data.entries.fold (init := header ++ "\n") fun s key entry =>
+    if key.path.contains '\n' then s else s ++ entry.toLine key
+  createParentDirs file
+  IO.FS.writeFile file contents
+
+/--
+Computes the trace of `path`, reusing the cached hash if the size and
+modification time of the file match the cached ones.
+-/
+def computeTrace (self : HashCache) (path : FilePath) (text := false) : IO BuildTrace := do
+  let md ← path.metadata
+  let key := {path := path.toString, text}
+  if let some entry := (← self.ref.get).entries[key]? then
+    if entry.size == md.byteSize && entry.mtime == md.modified then
+      return .mk entry.hash md.modified
+  let hash ← if text then computeTextFileHash path else computeFileHash path
+  let entry := {size := md.byteSize, mtime := md.modified, hash}
+  self.ref.modify fun data => {entries := data.entries.insert key entry, dirty := true}
+  return .mk hash md.modified
+
+end HashCache
@@ -0,0 +1,138 @@
+/-
+Copyright (c) 2024 Lean FRO, LLC. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+-/
+import Lake.Build.Actions
+import Lean.Environment
+
+/-! # Lean Workers
+
+Long-lived `lean --fork-server` processes that compile modules.
+A server loads the imports of the first module it is given and forks a child
+process for each module, so that modules with the same imports do not each
+import them again from `.olean` files.
+-/
+
+open System
+
+namespace Lake
+
+def LeanWorker.stdioConfig : IO.Process.StdioConfig where
+  stdin := .piped
+  stdout := .piped
+  -- Lean only writes to stderr on internal errors, which are passed through.
+  stderr := .inherit
+
+/-- A `lean --fork-server` process. -/
+structure LeanWorker where
+  /--
+  Identifies the `lean` command, its environment, and the imports of
+  the first module, which are loaded in the server.
+  -/
+  key : String
+  child : IO.Process.Child LeanWorker.stdioConfig
+
+namespace LeanWorker
+
+def spawn (key : String) (lean : FilePath) (env : Array (String × Option String)) : IO LeanWorker := do
+  let child ← IO.Process.spawn {
+    toStdioConfig := stdioConfig
+    cmd := lean.toString
+    args := #["--fork-server"]
+    env
+  }
+  return {key, child}
+
+def stop (self : LeanWorker) : BaseIO Unit :=
+  discard <| (do self.child.kill; discard self.child.wait : IO Unit).toBaseIO
+
+/-- Read the output of the child process until the server reports its exit code. -/
+partial def readOutput (self : LeanWorker) (out : String) : IO (String × UInt32) := do
+  let ln ← self.child.stdout.getLine
+  if ln.isEmpty then
+    throw <| IO.userError "Lean worker exited unexpectedly"
+  if let some code := ln.trimRight.dropPrefix? "exit " |>.bind (·.toString.toNat?) then
+    return (out, code.toUInt32)
+  readOutput self (out ++ ln)
+
+/--
+Compile a module with the given `lean` arguments, which must not contain whitespace.
+Returns the output of the child process and its exit code.
+-/
+def compile (self : LeanWorker) (args : Array String) : IO (String × UInt32) := do
+  self.child.stdin.putStrLn (" ".intercalate args.toList)
+  self.child.stdin.flush
+  self.readOutput ""
+
+end LeanWorker
+
+/-- A pool of idle `LeanWorker`s. -/
+structure LeanWorkerPool where
+  idle : IO.Ref (Array LeanWorker)
+  /-- The maximum number of idle workers, beyond which the least recently used ones are stopped. -/
+  maxIdle : Nat
+
+namespace LeanWorkerPool
+
+def new (maxIdle : Nat) : BaseIO LeanWorkerPool :=
+  return {idle := ← IO.mkRef #[], maxIdle}
+
+/-- Take an idle worker with the given key out of the pool, if any. -/
+def acquire? (self : LeanWorkerPool) (key : String) : BaseIO (Option LeanWorker) :=
+  self.idle.modifyGet fun idle =>
+    match idle.findIdx? (·.key == key) with
+    | some i => (idle[i]?, idle.eraseIdx i)
+    | none => (none, idle)
+
+/-- Return an idle worker to the pool. -/
+def release (self : LeanWorkerPool) (worker : LeanWorker) : BaseIO Unit := do
+  let evicted? ← self.idle.modifyGet fun idle =>
+    let idle := idle.push worker
+    if idle.size > self.maxIdle then (idle[0]?, idle.eraseIdx 0) else (none, idle)
+  if let some evicted := evicted? then
+    evicted.stop
+
+/-- Stop all idle workers. -/
+def stop (self : LeanWorkerPool) : BaseIO Unit := do
+  (← self.idle.modifyGet (·, #[])).forM (·.stop)
+
+/--
+Compile a module in a worker whose server has loaded the given imports,
+starting one if none is idle. Like `compileLeanModule`, but falls back to
+it for arguments containing whitespace, which the server cannot parse.
+-/
+def compileLeanModule
+  (self : LeanWorkerPool) (imports : Array Lean.Import)
+  (leanFile : FilePath)
+  (oleanFile? ileanFile? cFile? bcFile?: Option FilePath)
+  (leanPath : SearchPath := []) (rootDir : FilePath := ".")
+  (dynlibs : Array FilePath := #[]) (dynlibPath : SearchPath := {})
+  (leanArgs : Array String := #[]) (lean : FilePath := "lean")
+: LogIO Unit := do
+  let args ← mkLeanModuleArgs leanFile oleanFile? ileanFile? cFile? bcFile? rootDir dynlibs leanArgs
+  if args.any (·.any Char.isWhitespace) then
+    Lake.compileLeanModule leanFile oleanFile? ileanFile? cFile? bcFile?
+      leanPath rootDir dynlibs dynlibPath leanArgs lean
+    return
+  withLogErrorPos do
+  let env ← mkLeanModuleEnv leanPath dynlibPath
+  let key := s!"{lean} {env} {imports.map toString}"
+  let worker ← match (← self.acquire? key) with
+    | some worker => pure worker
+    | none => do
+      logVerbose s!"starting Lean worker: {lean} --fork-server"
+      match (← LeanWorker.spawn key lean env |>.toBaseIO) with
+      | .ok worker => pure worker
+      | .error err => error s!"failed to execute '{lean}': {err}"
+  logVerbose s!"{lean} --fork-server < {" ".intercalate args.toList}"
+  match (← worker.compile args |>.toBaseIO) with
+  | .ok (out, code) =>
+    self.release worker
+    logLeanOutput out ""
+    if code ≠ 0 then
+      error s!"Lean exited with code {code}"
+  | .error err =>
+    worker.stop
+    error s!"Lean worker failed: {err}"
+
+end LeanWorkerPool
@@ -5,6 +5,7 @@ Authors: Mac Malone
 -/
 import Lake.Build.Common
 import Lake.Build.Targets
+import Lake.Build.Module
 
 /-! # Library Facet Builds
 Build function definitions for a library's builtin facets.
@@ -21,7 +22,9 @@ That is, the modules from `getModuleArray` plus their local transitive imports.
 partial def LeanLib.recCollectLocalModules (self : LeanLib) : FetchM (Array Module) := do
   let mut mods := #[]
   let mut modSet := ModuleSet.empty
-  for mod in (← self.getModuleArray) do
+  let roots ← self.getModuleArray
+  prefetchHeaders roots
+  for mod in roots do
     (mods, modSet) ← go mod mods modSet
   return mods
 where
@@ -63,7 +66,9 @@ def LeanLib.leanArtsFacetConfig : LibraryFacetConfig leanArtsFacet :=
   let oJobs ← mods.flatMapM fun mod =>
     mod.nativeFacets shouldExport |>.mapM fun facet => fetch <| mod.facet facet.name
   let libFile := if shouldExport then self.staticExportLibFile else self.staticLibFile
-  buildStaticLib libFile oJobs
+  -- thin archives are not supported by the macOS and Windows linkers
+  let thin := self.thinStaticLib && !System.Platform.isOSX && !System.Platform.isWindows
+  buildStaticLib libFile oJobs thin
 
 /-- The `LibraryFacetConfig` for the builtin `staticFacet`. -/
 def LeanLib.staticFacetConfig : LibraryFacetConfig staticFacet :=
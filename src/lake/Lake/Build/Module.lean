@@ -26,16 +26,41 @@ def recBuildExternDynlibs (pkgs : Array Package)
     jobs := jobs.append <| ← pkg.externLibs.mapM (·.dynlib.fetch)
   return (jobs, libDirs)
 
+/--
+Start parsing the header of the module's Lean file in a dedicated task,
+unless it has already been started. Returns the task.
+-/
+def Module.prefetchHeader (mod : Module) : FetchM HeaderTask := do
+  let ref := (← getBuildContext).headerTasks
+  let path := mod.leanFile.toString
+  if let some task := (← ref.get)[path]? then
+    return task
+  let task ← IO.asTask do
+    Lean.parseImports' (← IO.FS.readFile mod.leanFile) path
+  ref.modify (·.insert path task)
+  return task
+
+/--
+Start parsing the headers of the given modules in parallel.
+This lets header parsing run ahead of the (sequential) computation of build jobs.
+-/
+def prefetchHeaders (mods : Array Module) : FetchM PUnit :=
+  mods.forM fun mod => discard mod.prefetchHeader
+
 /--
 Recursively parse the Lean files of a module and its imports
 building an `Array` product of its direct local imports.
+The headers of the local imports are prefetched, so that the
+imports of a whole module graph are parsed in parallel.
 -/
 def Module.recParseImports (mod : Module) : FetchM (Array Module) := do
-  let contents ← IO.FS.readFile mod.leanFile
-  let imports ← Lean.parseImports' contents mod.leanFile.toString
+  let imports ← IO.ofExcept (← IO.wait (← mod.prefetchHeader))
   let mods ← imports.foldlM (init := OrdModuleSet.empty) fun set imp =>
     findModule? imp.module <&> fun | some mod => set.insert mod | none => set
-  return mods.toArray
+  let mods := mods.toArray
+  prefetchHeaders mods
+  (← getBuildSchedule).recordImports mod.name (mods.map (·.name))
+  return mods
 
 /-- The `ModuleFacetConfig` for the builtin `importsFacet`. -/
 def Module.importsFacetConfig : ModuleFacetConfig importsFacet :=
@@ -165,13 +190,22 @@ all possible artifacts (i.e., `.olean`, `ilean`, `.c`, and `.bc`).
 -/
 def Module.recBuildLean (mod : Module) : FetchM (BuildJob Unit) := do
   withRegisterJob mod.name.toString do
-  (← mod.deps.fetch).bindSync fun (dynlibPath, dynlibs) depTrace => do
+  let schedule ← getBuildSchedule
+  let header ← mod.prefetchHeader
+  (← mod.deps.fetch).bindSync (prio := schedule.priority mod.name) fun (dynlibPath, dynlibs) depTrace => do
     let argTrace : BuildTrace := pureHash mod.leanArgs
-    let srcTrace : BuildTrace ← computeTrace { path := mod.leanFile : TextFilePath }
+    let srcTrace ← computeCachedTrace mod.leanFile (text := true)
     let modTrace := (← getLeanTrace).mix <| argTrace.mix <| srcTrace.mix depTrace
     let upToDate ← buildUnlessUpToDate? (oldTrace := srcTrace.mtime) mod modTrace mod.traceFile do
-      compileLeanModule mod.leanFile mod.oleanFile mod.ileanFile mod.cFile mod.bcFile?
-        (← getLeanPath) mod.rootDir dynlibs dynlibPath (mod.weakLeanArgs ++ mod.leanArgs) (← getLean)
+      let start ← IO.monoMsNow
+      if let some pool := (← getBuildContext).leanWorkers? then
+        let imports ← IO.ofExcept (← IO.wait header)
+        pool.compileLeanModule imports mod.leanFile mod.oleanFile mod.ileanFile mod.cFile mod.bcFile?
+          (← getLeanPath) mod.rootDir dynlibs dynlibPath (mod.weakLeanArgs ++ mod.leanArgs) (← getLean)
+      else
+        compileLeanModule mod.leanFile mod.oleanFile mod.ileanFile mod.cFile mod.bcFile?
+          (← getLeanPath) mod.rootDir dynlibs dynlibPath (mod.weakLeanArgs ++ mod.leanArgs) (← getLean)
+      schedule.recordDuration mod.name ((← IO.monoMsNow) - start)
       mod.clearOutputHashes
     unless upToDate && (← getTrustHash) do
       mod.cacheOutputHashes
@@ -18,10 +18,17 @@ namespace Lake
 
 /-- Create a fresh build context from a workspace and a build configuration. -/
 def mkBuildContext (ws : Workspace) (config : BuildConfig) : BaseIO BuildContext := do
+  -- `lean --fork-server` is not available on Windows
+  let leanWorkers? ← if config.leanWorkers && !Platform.isWindows then
+    some <$> LeanWorkerPool.new (maxIdle := 16) else pure none
   return {
     opaqueWs := ws,
     toBuildConfig := config,
     registeredJobs := ← IO.mkRef #[],
+    hashCache := ← HashCache.load (HashCache.file ws.lakeDir),
+    schedule := ← BuildSchedule.load (BuildSchedule.file ws.lakeDir),
+    leanWorkers?,
+    headerTasks := ← IO.mkRef {},
     leanTrace := Hash.ofString ws.lakeEnv.leanGithash
   }
 
@@ -235,6 +242,11 @@ def Workspace.runFetchM
   let showOptional := cfg.verbosity = .verbose
   let failures ← monitorJobs jobs out failLv outLv minAction showOptional useAnsi showProgress
     (resetCtrl := resetCtrl) (initFailures := failures)
+  if let some pool := ctx.leanWorkers? then
+    pool.stop
+  -- Hash Cache & Build Times
+  try ctx.hashCache.save (HashCache.file ws.lakeDir) catch _ => pure ()
+  try ctx.schedule.save (BuildSchedule.file ws.lakeDir) catch _ => pure ()
   -- Failure Report
   if failures.isEmpty then
     let some a := a?
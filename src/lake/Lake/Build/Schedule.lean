@@ -0,0 +1,144 @@
+/-
+Copyright (c) 2024 Lean FRO, LLC. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+-/
+import Std.Data.HashMap.Basic
+import Lake.Util.IO
+import Lean.Data.Name
+
+/-! # Build Schedule
+
+Module build durations recorded across Lake invocations, which are used
+to start the jobs on long chains of dependent modules first.
+-/
+
+open System Lean
+
+namespace Lake
+
+/-- The recorded build time of a module. -/
+structure ModuleTiming where
+  /-- Wall-clock time (in milliseconds) of the last build of the module. -/
+  duration : Nat
+  /--
+  Estimated time (in milliseconds) of the longest chain of module builds
+  that starts with this module, i.e., of the module and its dependents.
+  -/
+  chain : Nat
+
+/-- The data recorded by a `BuildSchedule` during a build. -/
+structure BuildSchedule.Data where
+  /-- The build durations measured in this build. -/
+  durations : Std.HashMap Name Nat := {}
+  /-- The direct local imports of the modules visited in this build. -/
+  imports : Std.HashMap Name (Array Name) := {}
+
+/--
+Prioritizes module builds on the critical path using the timings of
+previous builds, and records the timings of this build.
+-/
+structure BuildSchedule where
+  /-- The timings loaded from previous builds. -/
+  timings : Std.HashMap Name ModuleTiming
+  /-- The longest chain in `timings`. -/
+  maxChain : Nat
+  ref : IO.Ref BuildSchedule.Data
+
+namespace BuildSchedule
+
+/-- The path of the schedule file of a workspace with the given `.lake` directory. -/
+def file (lakeDir : FilePath) : FilePath :=
+  lakeDir / "build-times"
+
+/-- Parses a line of the format `<duration> <chain> <module>`. -/
+def parseEntry? (line : String) : Option (Name × ModuleTiming) := do
+  let [duration, chain, mod] := line.splitOn " " | none
+  return (mod.toName, {duration := ← duration.toNat?, chain := ← chain.toNat?})
+
+/-- Loads the timings from `file`, starting afresh if it is missing or invalid. -/
+def load (file : FilePath) : BaseIO BuildSchedule := do
+  let timings ← loadTimings.catchExceptions fun _ => pure {}
+  let maxChain := timings.fold (init := 0) fun m _ t => max m t.chain
+  return {timings, maxChain, ref := ← IO.mkRef {}}
+where
+  loadTimings : IO (Std.HashMap Name ModuleTiming) := do
+    let contents ← IO.FS.readFile file
+    return contents.splitOn "\n" |>.foldl (init := {}) fun timings line =>
+      match parseEntry? line with
+      | some (mod, timing) => timings.insert mod timing
+      | none => timings
+
+/--
+The priority of the build job of a module. Modules on longer chains of
+dependents get higher priorities, up to `Task.Priority.max` for the critical
+path. Modules without recorded timings get the default priority.
+-/
+def priority (self : BuildSchedule) (mod : Name) : Task.Priority :=
+  match self.timings[mod]? with
+  | some t =>
+    if self.maxChain = 0 then .default else
+    (t.chain * (Task.Priority.max : Nat) / self.maxChain : Nat)
+  | none => .default
+
+/-- Records the direct local imports of a module visited in this build. -/
+def recordImports (self : BuildSchedule) (mod : Name) (imports : Array Name) : BaseIO Unit :=
+  self.ref.modify fun data => {data with imports := data.imports.insert mod imports}
+
+/-- Records the duration (in milliseconds) of a module build. -/
+def recordDuration (self : BuildSchedule) (mod : Name) (duration : Nat) : BaseIO Unit :=
+  self.ref.modify fun data => {data with durations := data.durations.insert mod duration}
+
+/--
+Computes the chain of `mod` from the chains of its dependents, memoized in `chains`.
+A provisional entry guards against import cycles (which fail the build anyway).
+-/
+partial def chainOf
+  (duration : Name → Nat) (dependents : Std.HashMap Name (Array Name))
+  (mod : Name) (chains : Std.HashMap Name Nat)
+: Nat × Std.HashMap Name Nat :=
+  if let some chain := chains[mod]? then (chain, chains) else
+  let chains := chains.insert mod (duration mod)
+  let (longest, chains) := (dependents.getD mod #[]).foldl (init := (0, chains))
+    fun (longest, chains) dep =>
+      let (chain, chains) := chainOf duration dependents dep chains
+      (max longest chain, chains)
+  let chain := duration mod + longest
+  (chain, chains.insert mod chain)
+
+/--
+Computes the timings of the modules visited in this build, using the
+durations of this build where available. Timings of the modules that were
+not visited are kept as they are.
+-/
+def computeTimings (self : BuildSchedule) (data : Data) : Std.HashMap Name ModuleTiming := Id.run do
+  let duration (mod : Name) : Nat :=
+    match data.durations[mod]?, self.timings[mod]? with
+    | some d, _ => d
+    | none, some t => t.duration
+    | none, none => 0
+  let mut dependents : Std.HashMap Name (Array Name) := {}
+  for (mod, imps) in data.imports do
+    for imp in imps do
+      dependents := dependents.insert imp <| (dependents.getD imp #[]).push mod
+  let mut chains : Std.HashMap Name Nat := {}
+  let mut timings := self.timings
+  for (mod, _) in data.imports do
+    let (chain, chains') := chainOf duration dependents mod chains
+    chains := chains'
+    timings := timings.insert mod {duration := duration mod, chain}
+  return timings
+
+/--
+Writes the timings to `file` if modules have been built in this build.
+They are sorted by decreasing chain to ease inspection.
+-/
+def save (self : BuildSchedule) (file : FilePath) : IO Unit := do
+  let data ← self.ref.get
+  if data.durations.isEmpty then return
+  let timings := self.computeTimings data |>.toArray.qsort (·.2.chain > ·.2.chain)
+  let contents := timings.foldl (init := "") fun s (mod, t) =>
+    s ++ s!"{t.duration} {t.chain} {mod}\n"
+  createParentDirs file
+  IO.FS.writeFile file contents
+
+end BuildSchedule
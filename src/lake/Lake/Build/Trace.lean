@@ -140,14 +140,13 @@ instance [ComputeHash α m] : ComputeTrace α m Hash := ⟨ComputeHash.computeHa
 instance : ComputeHash String Id := ⟨Hash.ofString⟩
 
 def computeFileHash (file : FilePath) : IO Hash :=
-  Hash.ofByteArray <$> IO.FS.readBinFile file
+  Hash.mk <$> IO.FS.hashFile file
 
 instance : ComputeHash FilePath IO := ⟨computeFileHash⟩
 
+/-- Same as `Hash.ofString` on the contents of `file` with `\r\n` normalized to `\n`. -/
 def computeTextFileHash (file : FilePath) : IO Hash := do
-  let text ← IO.FS.readFile file
-  let text := text.crlfToLf
-  return Hash.ofString text
+  return Hash.nil.mix ⟨← IO.FS.hashFile file (text := true)⟩
 
 /--
   A wrapper around `FilePath` that adjusts its `ComputeHash` implementation
@@ -45,6 +45,8 @@ BASIC OPTIONS:
   -K key[=value]        set the configuration file option named key
   --old                 only rebuild modified modules (ignore transitive deps)
   --rehash, -H          hash all files for traces (do not trust `.hash` files)
+  --lean-workers        compile modules in long-lived `lean` processes that
+                        reuse the imports shared by modules (not on Windows)
   --update, -U          update manifest before building
   --reconfigure, -R     elaborate configuration files instead of using OLeans
   --no-build            exit immediately if a build target is not up-to-date
@@ -86,6 +86,7 @@ def LeanConfig.addDeclFields (cfg : LeanConfig) (fs : Array DeclField) : Array D
   fs
   |> addDeclFieldD `buildType  cfg.buildType .release
   |> addDeclFieldD `backend cfg.backend .default
+  |> addDeclFieldD `lto cfg.lto false
   |> addDeclField? `platformIndependent cfg.platformIndependent
   |> addDeclFieldNotEmpty `leanOptions cfg.leanOptions
   |> addDeclFieldNotEmpty `moreServerOptions cfg.moreServerOptions
@@ -50,6 +50,7 @@ def LeanConfig.toToml (cfg : LeanConfig) (t : Table := {}) : Table :=
   have : ToToml (Array LeanOption) := leanOptionsEncoder
   t.insertD `buildType cfg.buildType .release
   |>.smartInsert `backend cfg.backend
+  |>.insertD `lto cfg.lto false
   |>.smartInsert `platformIndependent cfg.platformIndependent
   |>.smartInsert `leanOptions cfg.leanOptions
   |>.smartInsert `moreServerOptions cfg.moreServerOptions
@@ -91,6 +91,9 @@ def Backend.orPreferLeft : Backend → Backend → Backend
 | .default, b => b
 | b, _ => b
 
+/-- The arguments to pass to `leanc` when compiling and linking with `lto := true`. -/
+def ltoLeancArgs : Array String := #["-flto=thin"]
+
 /-- The arguments to pass to `leanc` based on the build type. -/
 def BuildType.leancArgs : BuildType → Array String
 | debug => #["-Og", "-g"]
@@ -196,6 +199,16 @@ structure LeanConfig where
   -/
   backend : Backend := .default
   /--
+  Whether to optimize across modules at link time (LTO).
+
+  If `true`, Lake compiles the modules' C or LLVM bitcode files with `-flto=thin`, which
+  makes their object files contain LLVM bitcode, and links executables and shared libraries
+  with `-flto=thin` as well. The linker then optimizes the program as a whole, inlining small
+  functions across module boundaries. Only modules of packages or libraries with `lto := true`
+  take part in the optimization. Defaults to `false`.
+  -/
+  lto : Bool := false
+  /--
   Asserts whether Lake should assume Lean modules are platform-independent.
 
   * If `false`, Lake will add `System.Platform.target` to the module traces
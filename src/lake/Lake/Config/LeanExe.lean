@@ -78,16 +78,18 @@ By default, the package's plus the executable's `moreLinkArgs`.
 
 If `supportInterpreter := true`, Lake links directly to the Lean shared
 libraries on Windows by prepending `-leanshared` and adds `-rdynamic` on
-other systems.
+other systems. If the executable or its package sets `lto`, Lake links with
+link-time optimization.
 -/
 def linkArgs (self : LeanExe) : Array String :=
+  let ltoArgs := if self.config.lto || self.pkg.lto then ltoLeancArgs else #[]
   if self.config.supportInterpreter then
     if Platform.isWindows then
-      #["-leanshared"] ++ self.pkg.moreLinkArgs ++ self.config.moreLinkArgs
+      #["-leanshared"] ++ ltoArgs ++ self.pkg.moreLinkArgs ++ self.config.moreLinkArgs
     else
-      #["-rdynamic"] ++ self.pkg.moreLinkArgs ++ self.config.moreLinkArgs
+      #["-rdynamic"] ++ ltoArgs ++ self.pkg.moreLinkArgs ++ self.config.moreLinkArgs
   else
-    self.pkg.moreLinkArgs ++ self.config.moreLinkArgs
+    ltoArgs ++ self.pkg.moreLinkArgs ++ self.config.moreLinkArgs
 
 
 /--
@@ -83,6 +83,13 @@ Is true if either the package or the library have `precompileModules` set.
 @[inline] def precompileModules (self : LeanLib) : Bool :=
   self.pkg.precompileModules || self.config.precompileModules
 
+/--
+Whether to build the library's static libraries as thin archives.
+Is true if either the package or the library have `thinStaticLib` set.
+-/
+@[inline] def thinStaticLib (self : LeanLib) : Bool :=
+  self.pkg.thinStaticLib || self.config.thinStaticLib
+
 /--
 Whether to the library's Lean code is platform-independent.
 Returns the library's `platformIndependent` configuration if non-`none`.
@@ -125,6 +132,13 @@ then the default (which is C for now).
 @[inline] def backend (self : LeanLib) : Backend :=
   Backend.orPreferLeft self.config.backend self.pkg.backend
 
+/--
+Whether to optimize the library's modules at link time.
+That is, whether either the library or its package sets `lto`.
+-/
+@[inline] def lto (self : LeanLib) : Bool :=
+  self.config.lto || self.pkg.lto
+
 /--
 The arguments to pass to `lean` when compiling the library's Lean files.
 `leanArgs` is the accumulation of:
@@ -145,11 +159,12 @@ That is, the package's `weakLeanArgs` plus the library's  `weakLeanArgs`.
 
 /--
 The arguments to pass to `leanc` when compiling the library's Lean-produced C files.
-That is, the build type's `leancArgs`, the package's `moreLeancArgs`,
-and then the library's `moreLeancArgs`.
+That is, the build type's `leancArgs`, the LTO arguments if `lto` is set,
+the package's `moreLeancArgs`, and then the library's `moreLeancArgs`.
 -/
 @[inline] def leancArgs (self : LeanLib) : Array String :=
-  self.buildType.leancArgs ++ self.pkg.moreLeancArgs ++ self.config.moreLeancArgs
+  let ltoArgs := if self.lto then ltoLeancArgs else #[]
+  self.buildType.leancArgs ++ ltoArgs ++ self.pkg.moreLeancArgs ++ self.config.moreLeancArgs
 
 /--
 The arguments to weakly pass to `leanc` when compiling the library's Lean-produced C files.
@@ -160,10 +175,12 @@ That is, the package's `weakLeancArgs` plus the library's  `weakLeancArgs`.
 
 /--
 The arguments to pass to `leanc` when linking the shared library.
-That is, the package's `moreLinkArgs` plus the library's  `moreLinkArgs`.
+That is, the LTO arguments if `lto` is set, the package's `moreLinkArgs`,
+and then the library's `moreLinkArgs`.
 -/
 @[inline] def linkArgs (self : LeanLib) : Array String :=
-  self.pkg.moreLinkArgs ++ self.config.moreLinkArgs
+  let ltoArgs := if self.lto then ltoLeancArgs else #[]
+  ltoArgs ++ self.pkg.moreLinkArgs ++ self.config.moreLinkArgs
 
 /--
 The arguments to weakly pass to `leanc` when linking the shared library.
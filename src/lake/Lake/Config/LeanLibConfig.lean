@@ -62,6 +62,17 @@ structure LeanLibConfig extends LeanConfig where
   -/
   precompileModules : Bool := false
 
+  /--
+  Whether to build the library's static libraries as thin archives, which only
+  reference the object files instead of copying them.
+  Thin archives break when they are moved or distributed without the object
+  files, and require an `ar` that supports `--thin`. They are never built on
+  macOS and Windows, whose linkers do not support them.
+
+  Defaults to `false`.
+  -/
+  thinStaticLib : Bool := false
+
   /--
   An `Array` of library facets to build on a bare `lake build` of the library.
   For example, `#[LeanLib.sharedLib]` will build the shared library facet.
@@ -106,6 +106,17 @@ structure PackageConfig extends WorkspaceConfig, LeanConfig where
   -/
   precompileModules : Bool := false
 
+  /--
+  Whether to build the static libraries of the package's Lean libraries as thin
+  archives, which only reference the object files instead of copying them.
+  Thin archives break when they are moved or distributed without the object
+  files, and require an `ar` that supports `--thin`. They are never built on
+  macOS and Windows, whose linkers do not support them.
+
+  Defaults to `false`.
+  -/
+  thinStaticLib : Bool := false
+
   /--
   **Deprecated in favor of `moreGlobalServerArgs`.**
   Additional arguments to pass to the Lean language server
@@ -584,6 +595,10 @@ namespace Package
 @[inline] def precompileModules (self : Package) : Bool :=
   self.config.precompileModules
 
+/-- The package's `thinStaticLib` configuration. -/
+@[inline] def thinStaticLib (self : Package) : Bool :=
+  self.config.thinStaticLib
+
 /-- The package's `moreGlobalServerArgs` configuration. -/
 @[inline] def moreGlobalServerArgs (self : Package) : Array String :=
   self.config.moreGlobalServerArgs
@@ -600,6 +615,10 @@ namespace Package
 @[inline] def backend (self : Package) : Backend :=
   self.config.backend
 
+/-- The package's `lto` configuration. -/
+@[inline] def lto (self : Package) : Bool :=
+  self.config.lto
+
 /-- The package's `leanOptions` configuration. -/
 @[inline] def leanOptions (self : Package) : Array LeanOption :=
   self.config.leanOptions
@@ -652,6 +671,13 @@ namespace Package
 @[inline] def irDir (self : Package) : FilePath :=
   self.buildDir / self.config.irDir
 
+/--
+The directory of the package's object cache, which stores the object files compiled from its
+modules' C code by content (see `buildLeanO`).
+-/
+@[inline] def objCacheDir (self : Package) : FilePath :=
+  self.buildDir / "ocache"
+
 /-- Whether the given module is considered local to the package. -/
 def isLocalModule (mod : Name) (self : Package) : Bool :=
   self.leanLibConfigs.any (fun lib => lib.isLocalModule mod)
@@ -152,12 +152,32 @@ where
       manifestEntry := mkEntry <| .git gitUrl rev inputRev? subDir?
     }
 
+/--
+Identifies the state of a Git checkout without running `git`:
+the contents of `.git/HEAD`, which is the revision itself for the detached checkouts made by Lake,
+and the modification time of the Git index.
+-/
+def GitRepo.checkoutStamp? (repo : GitRepo) : BaseIO (Option String) := do
+  let gitDir := repo.dir / ".git"
+  let .ok head ← IO.FS.readFile (gitDir / "HEAD") |>.toBaseIO | return none
+  let .ok md ← (gitDir / "index").metadata |>.toBaseIO | return none
+  return some s!"{head.trim}@{md.modified.sec}.{md.modified.nsec}"
+
+/-- The Git repository of a manifest package entry, if it is a Git dependency. -/
+def PackageEntry.gitRepo? (entry : PackageEntry) (wsDir relPkgsDir : FilePath) : Option GitRepo :=
+  match entry.src with
+  | .git .. => some <| GitRepo.mk <| wsDir / relPkgsDir / entry.name.toString (escape := false)
+  | .path .. => none
+
 /--
 Materializes a manifest package entry, cloning and/or checking it out as necessary.
+
+If the checkout of a Git dependency still has the `stamp?` it had when it was last found
+up-to-date (see `GitRepo.checkoutStamp?`), it is not checked again.
 -/
 def PackageEntry.materialize
   (manifestEntry : PackageEntry)
-  (lakeEnv : Env) (wsDir relPkgsDir : FilePath)
+  (lakeEnv : Env) (wsDir relPkgsDir : FilePath) (stamp? : Option String := none)
 : LogIO MaterializedDep :=
   match manifestEntry.src with
   | .path (dir := relPkgDir) .. =>
@@ -177,7 +197,9 @@ def PackageEntry.materialize
 
     [104]: https://github.com/leanprover/lake/issues/104
     -/
-    if (← repo.dirExists) then
+    if stamp?.isSome && (← repo.checkoutStamp?) == stamp? then
+      pure ()
+    else if (← repo.dirExists) then
       if (← repo.getHeadRevision?) = rev then
         if (← repo.hasDiff) then
           logWarning s!"{sname}: repository '{repo.dir}' has local changes"
@@ -6,6 +6,7 @@ Authors: Mac Malone, Gabriel Ebner
 import Lake.Config.Monad
 import Lake.Util.StoreInsts
 import Lake.Build.Topological
+import Lake.Build.Trace
 import Lake.Load.Materialize
 import Lake.Load.Package
 
@@ -275,6 +276,25 @@ def validateManifest
     | .path .., .path .. => pure ()
     | _, _ => warnOutOfDate "source kind (git/path)"
 
+/--
+The stamps (see `GitRepo.checkoutStamp?`) of the Git dependencies that `Workspace.materializeDeps`
+found up-to-date, saved in `.lake/packages.json` together with the hash of the manifest.
+Dependencies whose checkouts still have these stamps are not checked again with `git`
+(so local changes to them are only reported once the snapshot is invalidated).
+-/
+structure MaterializeSnapshot where
+  manifestHash : String
+  stamps : Array (Name × String)
+  deriving ToJson, FromJson
+
+/-- Loads the stamps of the snapshot in `file` if it was taken for the manifest with hash `manifestHash`. -/
+def MaterializeSnapshot.load (file : FilePath) (manifestHash : String) : BaseIO (NameMap String) := do
+  let .ok contents ← IO.FS.readFile file |>.toBaseIO | return {}
+  let .ok (snap : MaterializeSnapshot) := Json.parse contents >>= fromJson? | return {}
+  if snap.manifestHash != manifestHash then
+    return {}
+  return snap.stamps.foldl (init := {}) fun stamps (name, stamp) => stamps.insert name stamp
+
 /--
 Resolving a workspace's dependencies using a manifest,
 downloading and/or updating them as necessary.
@@ -292,10 +312,19 @@ def Workspace.materializeDeps
   let pkgEntries : NameMap PackageEntry := manifest.packages.foldl (init := {})
     fun map entry => map.insert entry.name entry
   validateManifest pkgEntries ws.root.depConfigs
-  ws.resolveDeps fun pkg dep => do
+  let snapshotFile := ws.lakeDir / "packages.json"
+  let manifestHash? := (← (toString <$> computeTextFileHash ws.manifestFile).toBaseIO).toOption
+  let stamps : NameMap String ← match manifestHash? with
+    | some manifestHash => if reconfigure then pure {} else MaterializeSnapshot.load snapshotFile manifestHash
+    | none => pure {}
+  let newStamps ← IO.mkRef (#[] : Array (Name × String))
+  let ws ← ws.resolveDeps fun pkg dep => do
     let ws ← getThe Workspace
     if let some entry := pkgEntries.find? dep.name then
-      let result ← entry.materialize ws.lakeEnv ws.dir relPkgsDir
+      let result ← entry.materialize ws.lakeEnv ws.dir relPkgsDir (stamps.find? dep.name)
+      if let some repo := entry.gitRepo? ws.dir relPkgsDir then
+        if let some stamp ← repo.checkoutStamp? then
+          newStamps.modify (·.push (dep.name, stamp))
       loadDepPackage result dep.opts leanOpts reconfigure
     else
       if pkg.name = ws.root.name then
@@ -308,3 +337,9 @@ def Workspace.materializeDeps
           this suggests that the manifest is corrupt; \
           use `lake update` to generate a new, complete file \
           (warning: this will update ALL workspace dependencies)"
+  let stamps ← newStamps.get
+  if let some manifestHash := manifestHash? then
+    unless stamps.isEmpty do
+      let snapshot : MaterializeSnapshot := {manifestHash, stamps}
+      discard <| IO.FS.writeFile snapshotFile (toJson snapshot).compress |>.toBaseIO
+  return ws
@@ -171,6 +171,7 @@ instance : DecodeToml WorkspaceConfig := ⟨fun v => do WorkspaceConfig.decodeTo
 protected def LeanConfig.decodeToml (t : Table) : Except (Array DecodeError) LeanConfig := ensureDecode do
   let buildType ← t.tryDecodeD `buildType .release
   let backend ← t.tryDecodeD `backend .default
+  let lto ← t.tryDecodeD `lto false
   let platformIndependent ← t.tryDecode? `platformIndependent
   let leanOptions ← optDecodeD #[] (t.find? `leanOptions) decodeLeanOptions
   let moreServerOptions ← optDecodeD #[] (t.find? `moreServerOptions) decodeLeanOptions
@@ -181,7 +182,7 @@ protected def LeanConfig.decodeToml (t : Table) : Except (Array DecodeError) Lea
   let moreLinkArgs ← t.tryDecodeD `moreLinkArgs #[]
   let weakLinkArgs ← t.tryDecodeD `weakLinkArgs #[]
   return {
-    buildType, backend, platformIndependent, leanOptions, moreServerOptions,
+    buildType, backend, lto, platformIndependent, leanOptions, moreServerOptions,
     moreLeanArgs, weakLeanArgs, moreLeancArgs, weakLeancArgs, moreLinkArgs, weakLinkArgs
   }
 
@@ -190,6 +191,7 @@ instance : DecodeToml LeanConfig := ⟨fun v => do LeanConfig.decodeToml (← v.
 protected def PackageConfig.decodeToml (t : Table) (ref := Syntax.missing) : Except (Array DecodeError) PackageConfig := ensureDecode do
   let name ← stringToLegalOrSimpleName <$> t.tryDecode `name ref
   let precompileModules ← t.tryDecodeD `precompileModules false
+  let thinStaticLib ← t.tryDecodeD `thinStaticLib false
   let moreGlobalServerArgs ← t.tryDecodeD `moreGlobalServerArgs #[]
   let srcDir ← t.tryDecodeD `srcDir "."
   let buildDir ← t.tryDecodeD `buildDir defaultBuildDir
@@ -219,7 +221,7 @@ protected def PackageConfig.decodeToml (t : Table) (ref := Syntax.missing) : Exc
   let toLeanConfig ← tryDecode <| LeanConfig.decodeToml t
   let toWorkspaceConfig ← tryDecode <| WorkspaceConfig.decodeToml t
   return {
-    name, precompileModules, moreGlobalServerArgs
+    name, precompileModules, thinStaticLib, moreGlobalServerArgs
     srcDir, buildDir, leanLibDir, nativeLibDir, binDir, irDir
     releaseRepo, buildArchive?, preferReleaseBuild
     testDriver, testDriverArgs, lintDriver, lintDriverArgs
@@ -237,11 +239,12 @@ protected def LeanLibConfig.decodeToml (t : Table) (ref := Syntax.missing) : Exc
   let globs ← optDecodeD (roots.map Glob.one) (t.find? `globs) (·.decodeArrayOrSingleton)
   let libName ← t.tryDecodeD `libName (name.toString (escape := false))
   let precompileModules ← t.tryDecodeD `precompileModules false
+  let thinStaticLib ← t.tryDecodeD `thinStaticLib false
   let defaultFacets ← t.tryDecodeD `defaultFacets #[LeanLib.leanArtsFacet]
   let toLeanConfig ← tryDecode <| LeanConfig.decodeToml t
   return {
     name, srcDir, roots, globs, libName,
-    precompileModules, defaultFacets, toLeanConfig
+    precompileModules, thinStaticLib, defaultFacets, toLeanConfig
   }
 
 instance : DecodeToml LeanLibConfig := ⟨fun v => do LeanLibConfig.decodeToml (← v.decodeTable) v.ref⟩
@@ -9,6 +9,7 @@ package hello where
   weakLeanArgs  := configToArray <| get_config? weakLeanArgs
   moreLeancArgs := configToArray <| get_config? leancArgs
   moreLinkArgs  := configToArray <| get_config? linkArgs
+  lto           := get_config? lto |>.isSome
 
 lean_lib Hello
 
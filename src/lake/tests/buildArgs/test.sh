@@ -39,3 +39,10 @@ ${LAKE} build +Hello:dynlib -R -KweakLinkArgs=-L.lake/build/lib  --no-build
 ${LAKE} build Hello:shared -R -KweakLinkArgs=-L.lake/build/lib  --no-build
 ${LAKE} build hello -R -KweakLinkArgs=-L.lake/build/lib  --no-build
 
+
+# Test that `lto` compiles and links with `-flto=thin` and triggers a rebuild
+
+${LAKE} build +Hello:o hello -R
+${LAKE} build +Hello:o -R -Klto=true -v | grep --color flto
+${LAKE} build hello -R -Klto=true -v | grep --color flto
+./.lake/build/bin/hello
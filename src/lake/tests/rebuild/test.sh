@@ -21,3 +21,12 @@ echo $'import Foo.Test def hello := b' > Foo.lean
 ${LAKE} build Foo
 ${LAKE} build
 ./.lake/build/bin/foo | grep --color b
+
+# Tests that modules compiled by Lean workers are rebuilt the same way
+rm -rf .lake
+${LAKE} build --lean-workers
+./.lake/build/bin/foo | grep --color b
+echo $'def c := "c"' > Foo/Test.lean
+echo $'import Foo.Test def hello := c' > Foo.lean
+${LAKE} build --lean-workers
+./.lake/build/bin/foo | grep --color c
@@ -1 +1,2 @@
 rm -rf .lake lake-manifest.json
+rm -f Foo.lean.bak
@@ -33,3 +33,17 @@ $LAKE build --no-build
 touch .lake/build/lib/Foo.trace
 $LAKE build | grep --color "Built Foo"
 $LAKE build --no-build
+
+# Tests that source hashes are cached in the workspace's hash cache
+grep --color "Foo.lean" .lake/hashes
+$LAKE build --no-build
+
+# Tests that a corrupt hash cache is ignored
+echo "garbage" > .lake/hashes
+$LAKE build --no-build
+
+# Tests that a changed source is rehashed despite the hash cache
+cp Foo.lean Foo.lean.bak
+echo "-- changed" >> Foo.lean
+$LAKE build --no-build && exit 1 || [ $? = 3 ]
+mv Foo.lean.bak Foo.lean
@@ -0,0 +1,125 @@
+/*
+Copyright (c) 2024 Lean FRO, LLC. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+
+In-process bindings to the CaDiCaL SAT solver for `bv_decide`, see
+`src/Lean/Elab/Tactic/BVDecide/External.lean`. They are only available when
+Lean is built with `-DLINK_CADICAL=ON`; otherwise `lean_cadical_solve` returns
+`none` and the solver binary is run instead.
+*/
+#include <lean/lean.h>
+#include <chrono>
+#include <string>
+#include "runtime/io.h"
+#include "util/io.h"
+
+#ifdef LEAN_CADICAL
+#include "cadical.hpp"
+#endif
+
+#if defined(__clang__)
+#pragma clang diagnostic ignored "-Wunused-parameter"
+#elif defined(__GNUC__) && !defined(__CLANG__)
+#pragma GCC diagnostic ignored "-Wunused-parameter"
+#endif
+
+namespace lean {
+extern "C" lean_obj_res lean_io_cancel_token_is_set(lean_obj_arg cancel_tk, lean_obj_arg);
+
+#ifdef LEAN_CADICAL
+/* Stops the search on timeout or when the cancellation token is set. CaDiCaL asks very often, so
+   the clock and the token are only consulted every few milliseconds. */
+class cadical_terminator : public CaDiCaL::Terminator {
+    typedef std::chrono::steady_clock clock;
+    clock::time_point m_deadline;
+    clock::time_point m_next_check;
+    b_lean_obj_arg    m_cancel_tk;
+    bool              m_timed_out = false;
+    bool              m_cancelled = false;
+public:
+    cadical_terminator(uint64_t timeout_ms, b_lean_obj_arg cancel_tk):
+        m_deadline(clock::now() + std::chrono::milliseconds(timeout_ms)),
+        m_next_check(clock::now()), m_cancel_tk(cancel_tk) {}
+
+    bool terminate() override {
+        clock::time_point now = clock::now();
+        if (now < m_next_check)
+            return false;
+        m_next_check = now + std::chrono::milliseconds(10);
+        if (now >= m_deadline)
+            m_timed_out = true;
+        else if (m_cancel_tk) {
+            lean_inc(m_cancel_tk);
+            m_cancelled = get_io_scalar_result<bool>(lean_io_cancel_token_is_set(m_cancel_tk, lean_io_mk_world()));
+        }
+        return m_timed_out || m_cancelled;
+    }
+
+    bool cancelled() const { return m_cancelled; }
+};
+#endif
+
+/* cadicalAvailable : Unit → Bool */
+extern "C" LEAN_EXPORT uint8_t lean_cadical_available(obj_arg /* unit */) {
+#ifdef LEAN_CADICAL
+    return true;
+#else
+    return false;
+#endif
+}
+
+/*
+  cadicalSolve (clauses : @& Array Int) (proofPath : @& String) (binaryProofs : Bool) (timeoutMs : UInt64)
+    (cancelTk? : @& Option IO.CancelToken) : IO (Option InProcessResult)
+
+  `clauses` contains the literals of the CNF in DIMACS numbering, each clause terminated by `0`.
+*/
+extern "C" LEAN_EXPORT obj_res lean_cadical_solve(b_obj_arg clauses, b_obj_arg proof_path, uint8_t binary_proofs,
+                                                  uint64_t timeout_ms, b_obj_arg cancel_tk, obj_arg /* w */) {
+#ifdef LEAN_CADICAL
+    CaDiCaL::Solver solver;
+    // Same configuration as the arguments passed to the solver binary in `External.satQuery`.
+    solver.configure("unsat");
+    solver.set("quiet", 1);
+    solver.set("shrink", 0);
+    solver.set("lrat", 1);
+    solver.set("binary", binary_proofs);
+    if (!solver.trace_proof(lean_string_cstr(proof_path))) {
+        return io_result_mk_error(std::string("failed to open LRAT proof file '") + lean_string_cstr(proof_path) + "'");
+    }
+    size_t n = lean_array_size(clauses);
+    for (size_t i = 0; i < n; i++) {
+        b_obj_arg lit = lean_array_get_core(clauses, i);
+        if (!lean_is_scalar(lit))
+            return io_result_mk_error("literal out of range for CaDiCaL");
+        solver.add(lean_scalar_to_int(lit));
+    }
+    cadical_terminator terminator(timeout_ms, lean_is_scalar(cancel_tk) ? nullptr : lean_ctor_get(cancel_tk, 0));
+    solver.connect_terminator(&terminator);
+    int status = solver.solve();
+    solver.disconnect_terminator();
+    solver.close_proof_trace();
+    obj_res r;
+    if (status == 20) {
+        // InProcessResult.unsat
+        r = lean_box(0);
+    } else if (status == 10) {
+        int vars = solver.vars();
+        obj_res model = lean_alloc_array(0, vars);
+        for (int v = 1; v <= vars; v++)
+            model = lean_array_push(model, lean_int64_to_int(solver.val(v) > 0 ? v : -v));
+        // InProcessResult.sat model
+        r = lean_alloc_ctor(1, 1, 0);
+        lean_ctor_set(r, 0, model);
+    } else {
+        // InProcessResult.timeout / InProcessResult.interrupted
+        r = lean_box(terminator.cancelled() ? 3 : 2);
+    }
+    obj_res some = lean_alloc_ctor(1, 1, 0);
+    lean_ctor_set(some, 0, r);
+    return io_result_mk_ok(some);
+#else
+    return io_result_mk_ok(lean_box(0));
+#endif
+}
+}
@@ -4,6 +4,10 @@ Released under Apache 2.0 license as described in the file LICENSE.
 
 Author: Leonardo de Moura
 */
+#include <exception>
+#include <functional>
+#include <vector>
+#include "runtime/interrupt.h"
 #include "util/option_declarations.h"
 #include "util/io.h"
 #include "kernel/type_checker.h"
@@ -16,6 +20,7 @@ Author: Leonardo de Moura
 #include "library/compiler/find_jp.h"
 #include "library/compiler/cse.h"
 #include "library/compiler/csimp.h"
+#include "library/compiler/csimp_cache.h"
 #include "library/compiler/elim_dead_let.h"
 #include "library/compiler/erase_irrelevant.h"
 #include "library/compiler/specialize.h"
@@ -32,6 +37,10 @@ Author: Leonardo de Moura
 #include "library/compiler/struct_cases_on.h"
 #include "library/compiler/ir.h"
 
+#ifndef LEAN_COMPILER_PARALLEL_MIN_DECLS
+#define LEAN_COMPILER_PARALLEL_MIN_DECLS 4
+#endif
+
 namespace lean {
 static name * g_extract_closed = nullptr;
 
@@ -55,14 +64,75 @@ static expr eta_expand(environment const & env, expr const & e) {
     return type_checker(env).eta_expand(e);
 }
 
-template<typename F>
-comp_decls apply(F && f, environment const & env, comp_decls const & ds) {
-    return map(ds, [&](comp_decl const & d) { return comp_decl(d.fst(), f(env, d.snd())); });
+static obj_res run_apply_task(obj_arg fn, obj_arg) {
+    (*reinterpret_cast<std::function<void()> *>(lean_unbox_usize(fn)))();
+    lean_dec(fn);
+    return box(0);
 }
 
+/* Apply the per-declaration pass `f` to each declaration in `ds`. Batches of at least
+   `LEAN_COMPILER_PARALLEL_MIN_DECLS` declarations (e.g., large mutual blocks) are processed by tasks of the task
+   manager, which run with the heartbeat limit, cancellation token and trace environment of the caller. The passes only
+   depend on the environment and the declaration (in particular, each invocation uses its own name generator), so the
+   result does not depend on the schedule. Trace messages are only collected on the current thread, so we stay
+   sequential when tracing is enabled. */
 template<typename F>
 comp_decls apply(F && f, comp_decls const & ds) {
-    return map(ds, [&](comp_decl const & d) { return comp_decl(d.fst(), f(d.snd())); });
+    size_t n = length(ds);
+    if (n < LEAN_COMPILER_PARALLEL_MIN_DECLS || is_trace_enabled()) {
+        return map(ds, [&](comp_decl const & d) { return comp_decl(d.fst(), f(d.snd())); });
+    }
+    buffer<comp_decl> in;
+    to_buffer(ds, in);
+    for (comp_decl const & d : in) {
+        mark_mt(d.raw());
+    }
+    std::vector<expr> out(n);
+    std::vector<std::exception_ptr> errs(n);
+    trace_env_ref trace_env = get_trace_env();
+    size_t max_heartbeat    = get_max_heartbeat();
+    object * cancel_tk      = get_cancel_tk();
+    std::vector<std::function<void()>> jobs;
+    for (size_t i = 0; i < n; i++) {
+        jobs.push_back([&, i]() {
+            scope_trace_env scope_trace(trace_env);
+            scope_max_heartbeat scope_heartbeat(max_heartbeat);
+            scope_cancel_tk scope_cancel(cancel_tk);
+            try {
+                out[i] = f(in[i].snd());
+            } catch (...) {
+                errs[i] = std::current_exception();
+            }
+        });
+    }
+    // the first declaration is processed by the current thread, which then waits for the others
+    std::vector<object *> tasks;
+    for (size_t i = 1; i < n; i++) {
+        object * c = lean_alloc_closure(reinterpret_cast<void *>(run_apply_task), 2, 1);
+        lean_closure_set(c, 0, lean_box_usize(reinterpret_cast<size_t>(&jobs[i])));
+        tasks.push_back(task_spawn(c));
+    }
+    jobs[0]();
+    for (object * t : tasks) {
+        task_get(t);
+        lean_dec(t);
+    }
+    // report the error of the first declaration, as in sequential mode
+    for (std::exception_ptr const & err : errs) {
+        if (err)
+            std::rethrow_exception(err);
+    }
+    buffer<comp_decl> r;
+    for (size_t i = 0; i < n; i++)
+        r.push_back(comp_decl(in[i].fst(), out[i]));
+    return comp_decls(r);
+}
+
+template<typename F>
+comp_decls apply(F && f, environment const & env, comp_decls const & ds) {
+    if (length(ds) >= LEAN_COMPILER_PARALLEL_MIN_DECLS)
+        mark_mt(env.raw());
+    return apply([&](expr const & e) { return f(env, e); }, ds);
 }
 
 void trace_comp_decl(comp_decl const & d) {
@@ -156,7 +226,16 @@ bool is_main_fn_type(expr const & type) {
     }
 }
 
-#define trace_compiler(k, ds) lean_trace(k, trace_comp_decls(ds););
+static void trace_comp_decl_sizes(environment const & env, name const & pass, comp_decls const & ds) {
+    for (comp_decl const & d : ds) {
+        tout() << ">> " << d.fst() << " [" << pass << "] size: " << get_lcnf_size(env, d.snd()) << "\n";
+    }
+}
+
+#define trace_compiler(k, ds) do {                                                  \
+        lean_trace(k, trace_comp_decls(ds););                                       \
+        lean_trace(name({"compiler", "stats"}), trace_comp_decl_sizes(env, k, ds);); \
+    } while (0)
 
 extern "C" object* lean_csimp_replace_constants(object* env, object* n);
 
@@ -204,9 +283,9 @@ environment compile(environment const & env, options const & opts, names cs) {
     // scope_traces_as_string trace_scope;
     auto simp  = [&](environment const & env, expr const & e) { return csimp(env, e, cfg); };
     auto esimp = [&](environment const & env, expr const & e) { return cesimp(env, e, cfg); };
-    trace_compiler(name({"compiler", "input"}), ds);
+    lean_trace(name({"compiler", "input"}), trace_comp_decls(ds););
     ds = apply(eta_expand, env, ds);
-    trace_compiler(name({"compiler", "eta_expand"}), ds);
+    lean_trace(name({"compiler", "eta_expand"}), trace_comp_decls(ds););
     ds = apply(to_lcnf, env, ds);
     ds = apply(find_jp, env, ds);
     // trace(ds);
@@ -215,7 +294,13 @@ environment compile(environment const & env, options const & opts, names cs) {
     ds = apply(cce, env, ds);
     trace_compiler(name({"compiler", "cce"}), ds);
     ds = apply(csimp_replace_constants, env, ds);
-    ds = apply(simp, env, ds);
+    csimp_cache cache(env, opts, cfg, ds);
+    if (optional<comp_decls> cached = cache.find()) {
+        ds = *cached;
+    } else {
+        ds = apply(simp, env, ds);
+        cache.store(ds);
+    }
     trace_compiler(name({"compiler", "simp"}), ds);
     // trace(ds);
     environment new_env = env;
@@ -292,6 +377,8 @@ void initialize_compiler() {
     register_trace_class({"compiler", "simp"});
     register_trace_class({"compiler", "simp_detail"});
     register_trace_class({"compiler", "simp_float_cases"});
+    register_trace_class({"compiler", "simp_stats"});
+    register_trace_class({"compiler", "stats"});
     register_trace_class({"compiler", "elim_dead_let"});
     register_trace_class({"compiler", "cse"});
     register_trace_class({"compiler", "specialize"});
@@ -312,6 +399,7 @@ void initialize_compiler() {
     register_trace_class({"compiler", "ir"});
     register_trace_class({"compiler", "ir", "init"});
     register_trace_class({"compiler", "ir", "push_proj"});
+    register_trace_class({"compiler", "ir", "flatten_params"});
     register_trace_class({"compiler", "ir", "reset_reuse"});
     register_trace_class({"compiler", "ir", "elim_dead_branches"});
     register_trace_class({"compiler", "ir", "elim_dead"});
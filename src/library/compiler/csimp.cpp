@@ -8,6 +8,7 @@ Author: Leonardo de Moura
 #include <unordered_set>
 #include <unordered_map>
 #include "runtime/flet.h"
+#include "util/option_declarations.h"
 #include "kernel/type_checker.h"
 #include "kernel/for_each_fn.h"
 #include "kernel/find_fn.h"
@@ -29,8 +30,11 @@ Author: Leonardo de Moura
 #include "library/compiler/init_attribute.h"
 
 namespace lean {
-csimp_cfg::csimp_cfg(options const &):
+static name * g_inline_growth_factor = nullptr;
+
+csimp_cfg::csimp_cfg(options const & opts):
     csimp_cfg() {
+    m_inline_growth_factor            = opts.get_unsigned(*g_inline_growth_factor, m_inline_growth_factor);
 }
 
 csimp_cfg::csimp_cfg() {
@@ -38,6 +42,7 @@ csimp_cfg::csimp_cfg() {
     m_inline_threshold                = 1;
     m_float_cases_threshold           = 20;
     m_inline_jp_threshold             = 2;
+    m_inline_growth_factor            = 0;
 }
 
 /*
@@ -95,6 +100,15 @@ class csimp_fn {
        We use this information to reduce nested cases_on applications and projections. */
     typedef rb_expr_map<expr> expr2ctor;
     expr2ctor                m_expr2ctor;
+    /* Inlining budget, see `csimp_cfg::m_inline_growth_factor`. It is set when visiting the initial code. */
+    optional<unsigned>       m_initial_size;
+    unsigned                 m_inlined_size{0};
+    /* Statistics for the `compiler.simp_stats` trace class. */
+    bool                     m_collect_stats;
+    unsigned                 m_num_inlined{0};
+    unsigned                 m_num_inline_refused{0};
+    unsigned                 m_num_float_cases{0};
+    unsigned                 m_float_cases_size{0};
 
     environment const & env() const { return m_st.env(); }
 
@@ -665,6 +679,11 @@ class csimp_fn {
             new_minor                 = mk_minor_lambda(zs, new_minor);
             c_args[minor_idx]         = new_minor;
         }
+        if (m_collect_stats) {
+            m_num_float_cases++;
+            if (nminors > 1)
+                m_float_cases_size += get_lcnf_size(env(), e) * (nminors - 1);
+        }
         lean_trace(name({"compiler", "simp_float_cases"}),
                    tout() << "float_cases_on [" << get_lcnf_size(env(), e) << "]\n" << c << "\n----\n" << e << "\n=====>\n"
                    << mk_app(c_fn, c_args) << "\n";);
@@ -1726,6 +1745,21 @@ class csimp_fn {
         return !arity_was_reduced(comp_decl(n, info->get_value()));
     }
 
+    /* Return true if inlining `fn := val` keeps the code inlined so far within the budget, and charge it.
+       Matchers are always inlined since we do not generate code for them. */
+    bool check_inline_budget(name const & fn, expr const & val) {
+        unsigned size = get_lcnf_size(env(), val);
+        if (m_cfg.m_inline_growth_factor > 0 && m_initial_size && !is_matcher(env(), fn) &&
+            m_inlined_size + size > *m_initial_size * m_cfg.m_inline_growth_factor) {
+            m_num_inline_refused++;
+            lean_trace(name({"compiler", "inline"}), tout() << fn << " [budget exceeded]\n";);
+            return false;
+        }
+        m_inlined_size += size;
+        m_num_inlined++;
+        return true;
+    }
+
     optional<expr> try_inline(expr const & fn, expr const & e, bool is_let_val) {
         lean_assert(is_constant(fn));
         lean_assert(is_constant(e) || is_eqp(find(get_app_fn(e)), fn));
@@ -1752,6 +1786,7 @@ class csimp_fn {
                 // REMARK: the to be implemented `[strong_inline]` attribute should not be used in unsafe code.
                 if (uses_unsafe_inductive(c)) return none_expr();
             }
+            if (!check_inline_budget(const_name(fn), info->get_value())) return none_expr();
             lean_trace(name({"compiler", "inline"}), tout() << const_name(fn) << "\n";);
             expr new_fn = instantiate_value_lparams(*info, const_levels(fn));
             if (inline_if_reduce_attr && !inline_attr) {
@@ -1770,6 +1805,7 @@ class csimp_fn {
             if (get_lcnf_size(env(), info->get_value()) > m_cfg.m_inline_threshold) return none_expr();
             if (is_recursive(const_name(fn))) return none_expr();
             if (uses_unsafe_inductive(c)) return none_expr();
+            if (!check_inline_budget(const_name(fn), info->get_value())) return none_expr();
             return some_expr(beta_reduce(info->get_value(), e, is_let_val));
         }
     }
@@ -1970,9 +2006,12 @@ class csimp_fn {
 
 public:
     csimp_fn(environment const & env, local_ctx const & lctx, bool before_erasure, csimp_cfg const & cfg):
-        m_st(env), m_lctx(lctx), m_before_erasure(before_erasure), m_cfg(cfg), m_x("_x"), m_j("j") {}
+        m_st(env), m_lctx(lctx), m_before_erasure(before_erasure), m_cfg(cfg), m_x("_x"), m_j("j"),
+        m_collect_stats(lean_is_trace_enabled(name({"compiler", "simp_stats"}))) {}
 
     expr operator()(expr const & e) {
+        if (!m_initial_size)
+            m_initial_size = get_lcnf_size(env(), e);
         if (is_lambda(e)) {
             return visit_lambda(e, false, true);
         } else {
@@ -1981,6 +2020,16 @@ public:
             return mk_let(empty_xs, 0, r, true);
         }
     }
+
+    void trace_stats(expr const & e, unsigned num_iterations) const {
+        lean_trace(name({"compiler", "simp_stats"}),
+                   tout() << "size: " << *m_initial_size << " => " << get_lcnf_size(env(), e)
+                   << ", iterations: " << num_iterations
+                   << ", inlined: " << m_num_inlined << " (size " << m_inlined_size << ")"
+                   << ", inline budget exceeded: " << m_num_inline_refused
+                   << ", join points: " << m_next_jp_idx - 1
+                   << ", float cases: " << m_num_float_cases << " (duplicated size " << m_float_cases_size << ")\n";);
+    }
 };
 
 extern "C" uint8 lean_at_most_once(obj_arg e, obj_arg x);
@@ -2107,8 +2156,10 @@ expr csimp_core(environment const & env, local_ctx const & lctx, expr const & e0
     csimp_fn simp(env, lctx, before_erasure, cfg);
     elim_jp1_fn elim_jp1(env, lctx, before_erasure);
     expr e = e0;
+    unsigned num_iterations = 0;
     while (true) {
         e = simp(e);
+        num_iterations++;
         bool modified = false;
         e = elim_jp1(e);
         if (elim_jp1.expanded())
@@ -2117,9 +2168,22 @@ expr csimp_core(environment const & env, local_ctx const & lctx, expr const & e0
         new_e = elim_dead_let(new_e);
         if (e != new_e)
             modified = true;
-        if (!modified)
+        if (!modified) {
+            simp.trace_stats(e, num_iterations);
             return e;
+        }
         e = new_e;
     }
 }
+
+void initialize_csimp() {
+    g_inline_growth_factor = new name{"compiler", "inline_growth_factor"};
+    mark_persistent(g_inline_growth_factor->raw());
+    register_unsigned_option(*g_inline_growth_factor, 0,
+                             "(compiler) stop inlining into a declaration when the inlined code exceeds this factor of its initial size, disabled if 0");
+}
+
+void finalize_csimp() {
+    delete g_inline_growth_factor;
+}
 }
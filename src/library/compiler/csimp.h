@@ -18,6 +18,9 @@ struct csimp_cfg {
     unsigned m_float_cases_threshold;
     /* We inline join-points that are smaller m_inline_threshold. */
     unsigned m_inline_jp_threshold;
+    /* We stop inlining into a declaration when the total size of the code inlined into it exceeds
+       `m_inline_growth_factor` times its initial size. The budget is disabled when it is 0. */
+    unsigned m_inline_growth_factor;
 public:
     csimp_cfg(options const & opts);
     csimp_cfg();
@@ -30,4 +33,6 @@ inline expr csimp(environment const & env, expr const & e, csimp_cfg const & cfg
 inline expr cesimp(environment const & env, expr const & e, csimp_cfg const & cfg = csimp_cfg()) {
     return csimp_core(env, local_ctx(), e, false, cfg);
 }
+void initialize_csimp();
+void finalize_csimp();
 }
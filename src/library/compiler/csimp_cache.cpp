@@ -0,0 +1,262 @@
+/*
+Copyright (c) 2024 Lean FRO, LLC. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+
+The cache key of a batch combines the build githash, the `csimp` configuration, the input declarations, and a
+fingerprint of every constant `csimp` may look into while simplifying them: the constants occurring in the input and,
+transitively, in their stage1 code (or definition, if they have not been compiled). The fingerprint of a constant
+covers its type, that value, and its compiler attributes. The fingerprints of the transitive closure are summed, so
+the key does not depend on the traversal order.
+
+Cache files contain the compacted input and output of the pass; the input is compared to the actual input on lookup to
+rule out key collisions for the declarations themselves. The regions of cache hits are kept alive until finalization,
+like the regions of imported modules.
+*/
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <sstream>
+#include <vector>
+#include "runtime/compact.h"
+#include "runtime/hash.h"
+#include "runtime/thread.h"
+#include "util/name_hash_map.h"
+#include "util/name_set.h"
+#include "util/option_declarations.h"
+#include "kernel/for_each_fn.h"
+#include "library/compiler/csimp_cache.h"
+#include "library/compiler/extern_attribute.h"
+#include "library/compiler/implemented_by_attribute.h"
+#include "githash.h" // NOLINT
+
+#ifdef LEAN_WINDOWS
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace lean {
+static name * g_compiler_cache_dir = nullptr;
+static char const g_csimp_cache_magic[] = "leancsimp";
+
+struct constant_fingerprint {
+    // the value `m_fingerprint` was computed from, to detect changes
+    optional<expr> m_value;
+    uint64         m_fingerprint;
+    // constants occurring in `m_value`
+    buffer<name>   m_deps;
+};
+
+/* Fingerprints of imported constants, which do not change as long as their values do not. */
+static name_hash_map<std::shared_ptr<constant_fingerprint const>> * g_imported_fingerprints = nullptr;
+static mutex * g_imported_fingerprints_mutex = nullptr;
+
+/* Regions of cache hits, whose objects may be referenced until finalization. */
+static std::vector<std::unique_ptr<compacted_region>> * g_regions = nullptr;
+static mutex * g_regions_mutex = nullptr;
+
+/* Counter for the names of temporary cache files of this process. */
+static atomic<unsigned> g_tmp_file_counter(0);
+
+static unsigned get_process_id() {
+#ifdef LEAN_WINDOWS
+    return GetCurrentProcessId();
+#else
+    return getpid();
+#endif
+}
+
+/* The code `csimp` may inline for `c`. */
+static optional<expr> get_inlinable_value(environment const & env, name const & c) {
+    if (optional<constant_info> info = env.find(mk_cstage1_name(c)))
+        return some_expr(info->get_value());
+    if (optional<constant_info> info = env.find(c))
+        if (info->is_definition())
+            return some_expr(info->get_value());
+    return none_expr();
+}
+
+static std::shared_ptr<constant_fingerprint const> mk_fingerprint(environment const & env, name const & c) {
+    auto r = std::make_shared<constant_fingerprint>();
+    uint64 h = c.hash();
+    if (optional<constant_info> info = env.find(c))
+        h = hash(h, hash(info->get_type()));
+    h = hash(h, (has_inline_attribute(env, c) ? 1 : 0) | (has_noinline_attribute(env, c) ? 2 : 0) |
+                (has_inline_if_reduce_attribute(env, c) ? 4 : 0) | (has_never_extract_attribute(env, c) ? 8 : 0) |
+                (is_extern_constant(env, c) ? 16 : 0));
+    if (optional<name> impl = get_implemented_by_attribute(env, c))
+        h = hash(h, impl->hash());
+    if (optional<expr> v = get_inlinable_value(env, c)) {
+        r->m_value = v;
+        h = hash(h, hash(*v));
+        name_set seen;
+        for_each(*v, [&](expr const & e) {
+            if (is_constant(e) && !seen.contains(const_name(e))) {
+                seen.insert(const_name(e));
+                r->m_deps.push_back(const_name(e));
+            }
+            return true;
+        });
+    }
+    r->m_fingerprint = h;
+    return r;
+}
+
+static std::shared_ptr<constant_fingerprint const> get_fingerprint(environment const & env, name const & c) {
+    if (!env.is_imported(c))
+        return mk_fingerprint(env, c);
+    optional<expr> v = get_inlinable_value(env, c);
+    {
+        lock_guard<mutex> _(*g_imported_fingerprints_mutex);
+        auto it = g_imported_fingerprints->find(c);
+        if (it != g_imported_fingerprints->end() && is_eqp(it->second->m_value, v))
+            return it->second;
+    }
+    std::shared_ptr<constant_fingerprint const> r = mk_fingerprint(env, c);
+    if (r->m_value)
+        mark_mt(r->m_value->raw());
+    lock_guard<mutex> _(*g_imported_fingerprints_mutex);
+    (*g_imported_fingerprints)[c] = r;
+    return r;
+}
+
+/* Sum of the fingerprints of the constants reachable from `ds`. */
+static uint64 get_closure_fingerprint(environment const & env, comp_decls const & ds) {
+    name_set visited;
+    buffer<name> todo;
+    for (comp_decl const & d : ds) {
+        for_each(d.snd(), [&](expr const & e) {
+            if (is_constant(e) && !visited.contains(const_name(e))) {
+                visited.insert(const_name(e));
+                todo.push_back(const_name(e));
+            }
+            return true;
+        });
+    }
+    uint64 r = 0;
+    while (!todo.empty()) {
+        name c = todo.back();
+        todo.pop_back();
+        std::shared_ptr<constant_fingerprint const> fp = get_fingerprint(env, c);
+        r += hash(fp->m_fingerprint, 11);
+        for (name const & d : fp->m_deps) {
+            if (!visited.contains(d)) {
+                visited.insert(d);
+                todo.push_back(d);
+            }
+        }
+    }
+    return r;
+}
+
+csimp_cache::csimp_cache(environment const & env, options const & opts, csimp_cfg const & cfg, comp_decls const & ds):
+    m_input(ds) {
+    char const * dir = opts.get_string(*g_compiler_cache_dir, "");
+    if (!dir || !*dir)
+        return;
+    uint64 h = hash_str(strlen(LEAN_GITHASH), reinterpret_cast<unsigned char const *>(LEAN_GITHASH), 31);
+    h = hash(h, cfg.m_inline);
+    h = hash(h, cfg.m_inline_threshold);
+    h = hash(h, cfg.m_float_cases_threshold);
+    h = hash(h, cfg.m_inline_jp_threshold);
+    h = hash(h, cfg.m_inline_growth_factor);
+    for (comp_decl const & d : ds) {
+        h = hash(h, d.fst().hash());
+        h = hash(h, hash(d.snd()));
+    }
+    h = hash(h, get_closure_fingerprint(env, ds));
+    std::ostringstream out;
+    out << dir << "/" << std::hex << std::setw(16) << std::setfill('0') << h << ".csimp";
+    m_file = out.str();
+}
+
+optional<comp_decls> csimp_cache::find() const {
+    if (m_file.empty())
+        return optional<comp_decls>();
+    std::ifstream in(m_file, std::ios_base::binary);
+    if (!in)
+        return optional<comp_decls>();
+    char header[sizeof(g_csimp_cache_magic) + 42];
+    in.read(header, sizeof(header));
+    if (!in || memcmp(header, g_csimp_cache_magic, sizeof(g_csimp_cache_magic)) != 0 ||
+        strncmp(header + sizeof(g_csimp_cache_magic), LEAN_GITHASH, 42) != 0)
+        return optional<comp_decls>();
+    in.seekg(0, in.end);
+    size_t size = static_cast<size_t>(in.tellg()) - sizeof(header);
+    in.seekg(sizeof(header));
+    char * data = static_cast<char *>(malloc(size));
+    in.read(data, size);
+    if (!in) {
+        free(data);
+        return optional<comp_decls>();
+    }
+    std::unique_ptr<compacted_region> region(new compacted_region(size, data, nullptr, false, [=]() { free(data); }));
+    optional<comp_decls> r;
+    {
+        object_ref o(region->read());
+        if (equal_input(comp_decls(cnstr_get(o.raw(), 0), true)))
+            r = comp_decls(cnstr_get(o.raw(), 1), true);
+    }
+    if (r) {
+        lock_guard<mutex> _(*g_regions_mutex);
+        g_regions->push_back(std::move(region));
+    }
+    return r;
+}
+
+bool csimp_cache::equal_input(comp_decls const & input) const {
+    if (length(input) != length(m_input))
+        return false;
+    auto it = m_input.begin();
+    for (comp_decl const & d : input) {
+        if (d.fst() != (*it).fst() || d.snd() != (*it).snd())
+            return false;
+        ++it;
+    }
+    return true;
+}
+
+void csimp_cache::store(comp_decls const & ds) const {
+    if (m_file.empty())
+        return;
+    object_ref r(mk_cnstr(0, m_input, ds));
+    object_compactor compactor;
+    compactor(r.raw());
+    // write to a temporary file first so that concurrent builds never see partial files
+    std::string tmp_file = m_file + "." + std::to_string(get_process_id()) + "." + std::to_string(g_tmp_file_counter++) + ".tmp";
+    {
+        std::ofstream out(tmp_file, std::ios_base::binary);
+        char header[sizeof(g_csimp_cache_magic) + 42] = {0};
+        memcpy(header, g_csimp_cache_magic, sizeof(g_csimp_cache_magic));
+        strncpy(header + sizeof(g_csimp_cache_magic), LEAN_GITHASH, 42);
+        out.write(header, sizeof(header));
+        out.write(static_cast<char const *>(compactor.data()), compactor.size());
+        if (!out) {
+            out.close();
+            std::remove(tmp_file.c_str());
+            return;
+        }
+    }
+    if (std::rename(tmp_file.c_str(), m_file.c_str()) != 0)
+        std::remove(tmp_file.c_str());
+}
+
+void initialize_csimp_cache() {
+    g_compiler_cache_dir = new name{"compiler", "cache_dir"};
+    mark_persistent(g_compiler_cache_dir->raw());
+    register_string_option(*g_compiler_cache_dir, "", "(compiler) directory for caching the simplified code of declarations across builds, disabled if empty");
+    g_imported_fingerprints = new name_hash_map<std::shared_ptr<constant_fingerprint const>>();
+    g_imported_fingerprints_mutex = new mutex();
+    g_regions = new std::vector<std::unique_ptr<compacted_region>>();
+    g_regions_mutex = new mutex();
+}
+
+void finalize_csimp_cache() {
+    delete g_regions_mutex;
+    delete g_regions;
+    delete g_imported_fingerprints_mutex;
+    delete g_imported_fingerprints;
+    delete g_compiler_cache_dir;
+}
+}
@@ -0,0 +1,28 @@
+/*
+Copyright (c) 2024 Lean FRO, LLC. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+*/
+#pragma once
+#include <string>
+#include "library/compiler/util.h"
+#include "library/compiler/csimp.h"
+
+namespace lean {
+/** \brief On-disk cache of the result of the first `csimp` pass of `compile` on a batch of declarations, enabled by
+    setting the option `compiler.cache_dir`. The key covers the input of the pass and everything `csimp` may inline
+    into it, so that unchanged declarations of a modified module skip the pass. */
+class csimp_cache {
+    // empty if the cache is disabled
+    std::string m_file;
+    comp_decls  m_input;
+    bool equal_input(comp_decls const & input) const;
+public:
+    csimp_cache(environment const & env, options const & opts, csimp_cfg const & cfg, comp_decls const & ds);
+    /** \brief Return the cached result for the batch, if any. */
+    optional<comp_decls> find() const;
+    void store(comp_decls const & ds) const;
+};
+
+void initialize_csimp_cache();
+void finalize_csimp_cache();
+}
@@ -9,13 +9,16 @@ Author: Leonardo de Moura
 #include "library/compiler/lcnf.h"
 #include "library/compiler/elim_dead_let.h"
 #include "library/compiler/cse.h"
+#include "library/compiler/csimp.h"
 #include "library/compiler/specialize.h"
 #include "library/compiler/llnf.h"
 #include "library/compiler/compiler.h"
+#include "library/compiler/csimp_cache.h"
 #include "library/compiler/borrowed_annotation.h"
 #include "library/compiler/ll_infer_type.h"
 #include "library/compiler/ir.h"
 #include "library/compiler/ir_interpreter.h"
+#include "library/compiler/ir_jit.h"
 
 namespace lean {
 void initialize_compiler_module() {
@@ -23,23 +26,29 @@ void initialize_compiler_module() {
     initialize_lcnf();
     initialize_elim_dead_let();
     initialize_cse();
+    initialize_csimp();
     initialize_specialize();
     initialize_llnf();
     initialize_compiler();
+    initialize_csimp_cache();
     initialize_borrowed_annotation();
     initialize_ll_infer_type();
     initialize_ir();
     initialize_ir_interpreter();
+    initialize_ir_jit();
 }
 
 void finalize_compiler_module() {
+    finalize_ir_jit();
     finalize_ir_interpreter();
     finalize_ir();
     finalize_ll_infer_type();
     finalize_borrowed_annotation();
+    finalize_csimp_cache();
     finalize_compiler();
     finalize_llnf();
     finalize_specialize();
+    finalize_csimp();
     finalize_cse();
     finalize_elim_dead_let();
     finalize_lcnf();
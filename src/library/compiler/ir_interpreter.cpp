@@ -10,8 +10,9 @@ Motivation
 ==========
 
 Even with a JIT compiler, we still have a need for a simpler interpreter on platforms LLVM JIT does not support (i.e.
-WebAssembly). Because this is mostly an edge case, we strive for simplicity instead of performance and thus reuse the
-existing compiler IR instead of inventing something like a new bytecode format.
+WebAssembly). The interpreter is also used for code of the current package that has not been compiled yet (`#eval`,
+macros, elaborators), so we lower the IR of each declaration into a simple bytecode the first time it is executed
+instead of repeatedly walking the IR objects.
 
 Implementation
 ==============
@@ -25,8 +26,26 @@ code by checking for the mangled symbol via dlsym/GetProcAddress, which is also
 functions, which have a (relatively) homogeneous ABI that we can use without runtime code generation; see also
 `call/lookup_symbol` below.
 
+The bytecode (see `code` below) is a flat array of instructions whose operands (stack slots, field indices, offsets,
+constructor tags) are decoded from the IR once. Join points become direct jumps, `case` uses a table indexed by
+constructor tag, and callees are resolved on their first call. Less frequent instructions (partial applications,
+closure applications, object literals) are still evaluated from the IR. Setting `interpreter.bytecode` to `false`
+walks the IR directly instead.
+
+When Lean is built with LLVM support, imported functions that are called more than `interpreter.jit_threshold` times are
+compiled to native code using LLVM's ORC JIT (see `ir_jit.cpp`) and from then on called like precompiled code.
+
+Setting `interpreter.profile` reports the number of calls (native and total) and the self time of each function called
+by an interpreter instance, i.e. per `#eval` or `lean --run`, which helps deciding which modules to precompile.
+
 */
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <memory>
 #include <string>
+#include <type_traits>
+#include <unordered_map>
 #include <vector>
 #ifdef LEAN_WINDOWS
 #include <windows.h>
@@ -39,19 +58,39 @@ functions, which have a (relatively) homogeneous ABI that we can use without run
 #include "runtime/apply.h"
 #include "runtime/interrupt.h"
 #include "runtime/io.h"
+#include "runtime/load_dynlib.h"
 #include "runtime/option_ref.h"
 #include "runtime/array_ref.h"
+#include "runtime/sampler.h"
 #include "kernel/trace.h"
 #include "library/time_task.h"
 #include "library/compiler/ir.h"
 #include "library/compiler/init_attribute.h"
+#include "library/compiler/ir_jit.h"
 #include "util/nat.h"
+#include "util/name_interner.h"
 #include "util/option_declarations.h"
 
 #ifndef LEAN_DEFAULT_INTERPRETER_PREFER_NATIVE
 #define LEAN_DEFAULT_INTERPRETER_PREFER_NATIVE true
 #endif
 
+#ifndef LEAN_DEFAULT_INTERPRETER_BYTECODE
+#define LEAN_DEFAULT_INTERPRETER_BYTECODE true
+#endif
+
+#ifndef LEAN_DEFAULT_INTERPRETER_PROFILE
+#define LEAN_DEFAULT_INTERPRETER_PROFILE false
+#endif
+
+#ifndef LEAN_DEFAULT_INTERPRETER_JIT_THRESHOLD
+#ifdef LEAN_LLVM
+#define LEAN_DEFAULT_INTERPRETER_JIT_THRESHOLD 10000
+#else
+#define LEAN_DEFAULT_INTERPRETER_JIT_THRESHOLD 0
+#endif
+#endif
+
 namespace lean {
 namespace ir {
 // C++ wrappers of Lean data types
@@ -192,6 +231,9 @@ static string_ref * g_mangle_prefix = nullptr;
 static string_ref * g_boxed_suffix = nullptr;
 static string_ref * g_boxed_mangled_suffix = nullptr;
 static name * g_interpreter_prefer_native = nullptr;
+static name * g_interpreter_bytecode = nullptr;
+static name * g_interpreter_jit_threshold = nullptr;
+static name * g_interpreter_profile = nullptr;
 
 // constants (lacking native declarations) initialized by `lean_run_init`
 static name_map<object *> * g_init_globals;
@@ -274,6 +316,77 @@ value unbox_t(object * o, type t) {
     lean_unreachable();
 }
 
+/* Trampolines for calling native code using the unboxed ABI, i.e. the signature given by the IR, for functions with up
+   to `max_trampoline_args` parameters. Objects and integers of any width are passed in the same way as `uint64` on
+   64-bit platforms, so we only need to distinguish them from floats. Return values must be read at their exact type,
+   however, as the upper bits of the register are undefined. */
+typedef value (*trampoline)(void * fn, value const * args);
+static constexpr unsigned max_trampoline_args = 5;
+
+template<class T> T trampoline_arg(value const & v);
+template<> uint64 trampoline_arg<uint64>(value const & v) { return v.m_num; }
+template<> double trampoline_arg<double>(value const & v) { return v.m_float; }
+
+inline value trampoline_result(object * r) { return r; }
+inline value trampoline_result(double r) { return value::from_float(r); }
+inline value trampoline_result(uint8 r) { return static_cast<uint64>(r); }
+inline value trampoline_result(uint16 r) { return static_cast<uint64>(r); }
+inline value trampoline_result(uint32 r) { return static_cast<uint64>(r); }
+inline value trampoline_result(uint64 r) { return r; }
+
+template<class R, class... Ts, size_t... Is>
+value call_trampoline(void * fn, value const * args, std::index_sequence<Is...>) {
+    return trampoline_result(reinterpret_cast<R (*)(Ts...)>(fn)(trampoline_arg<Ts>(args[Is])...));
+}
+
+template<class R, class... Ts> value call_trampoline(void * fn, value const * args) {
+    return call_trampoline<R, Ts...>(fn, args, std::index_sequence_for<Ts...>());
+}
+
+template<class R, class... Ts> trampoline get_trampoline(array_ref<param> const & ps);
+
+/** \brief Add the C type of the next parameter in `ps` to `Ts`, unless there are `max_trampoline_args` already. */
+template<class R, class... Ts> trampoline extend_trampoline(array_ref<param> const & ps, std::true_type) {
+    if (param_type(ps[sizeof...(Ts)]) == type::Float) {
+        return get_trampoline<R, Ts..., double>(ps);
+    } else {
+        return get_trampoline<R, Ts..., uint64>(ps);
+    }
+}
+
+template<class R, class... Ts> trampoline extend_trampoline(array_ref<param> const &, std::false_type) {
+    return nullptr;
+}
+
+/** \brief Return the trampoline for the parameter types `ps` whose leading parameters have C types `Ts`. */
+template<class R, class... Ts> trampoline get_trampoline(array_ref<param> const & ps) {
+    if (sizeof...(Ts) == ps.size()) {
+        return call_trampoline<R, Ts...>;
+    }
+    return extend_trampoline<R, Ts...>(ps, std::integral_constant<bool, (sizeof...(Ts) < max_trampoline_args)>());
+}
+
+/** \brief Return a trampoline for calling the native code of `d` using the unboxed ABI, if there is one. */
+trampoline get_trampoline(decl const & d) {
+    array_ref<param> const & ps = decl_params(d);
+    if (sizeof(void *) != sizeof(uint64) || decl_tag(d) != decl_kind::Fun || ps.size() > max_trampoline_args) {
+        return nullptr;
+    }
+    switch (decl_type(d)) {
+        case type::Float: return get_trampoline<double>(ps);
+        case type::UInt8: return get_trampoline<uint8>(ps);
+        case type::UInt16: return get_trampoline<uint16>(ps);
+        case type::UInt32: return get_trampoline<uint32>(ps);
+        case type::UInt64:
+        case type::USize: return get_trampoline<uint64>(ps);
+        case type::Irrelevant:
+        case type::Object:
+        case type::TObject:
+            return get_trampoline<object *>(ps);
+    }
+    lean_unreachable();
+}
+
 /** \pre Very simple debug output of arbitrary values, should be extended. */
 void print_value(tout & ios, value const & v, type t) {
     if (t == type::Float) {
@@ -296,8 +409,8 @@ void print_value(tout const & ios, value const & v, type t) {
   return print_value(const_cast<tout &>(ios), v, t);
 }
 
-void * lookup_symbol_in_cur_exe(char const * sym) {
 #ifdef LEAN_WINDOWS
+static std::vector<HMODULE> get_process_modules() {
     std::vector<HMODULE> hmods(128);
     DWORD bytes_needed;
     lean_always_assert(EnumProcessModules(GetCurrentProcess(), &hmods[0], hmods.size() * sizeof(HMODULE), &bytes_needed));
@@ -308,7 +421,39 @@ void * lookup_symbol_in_cur_exe(char const * sym) {
     } else {
         hmods.resize(num_mods);
     }
-    for (HMODULE hmod : hmods) {
+    return hmods;
+}
+
+/* Add the named exports of the loaded module `hmod` to `symbols`, keeping existing entries so that earlier modules take
+   precedence as with `GetProcAddress` in module order. Forwarded exports point into the export directory instead of at
+   code; they are skipped and left to `GetProcAddress`. */
+static void index_module_exports(HMODULE hmod, std::unordered_map<std::string, void *> & symbols) {
+    char * base = reinterpret_cast<char *>(hmod);
+    auto dos = reinterpret_cast<IMAGE_DOS_HEADER *>(base);
+    if (dos->e_magic != IMAGE_DOS_SIGNATURE)
+        return;
+    auto nt = reinterpret_cast<IMAGE_NT_HEADERS *>(base + dos->e_lfanew);
+    if (nt->Signature != IMAGE_NT_SIGNATURE)
+        return;
+    IMAGE_DATA_DIRECTORY const & dir = nt->OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_EXPORT];
+    if (dir.VirtualAddress == 0 || dir.Size == 0)
+        return;
+    auto exports   = reinterpret_cast<IMAGE_EXPORT_DIRECTORY *>(base + dir.VirtualAddress);
+    auto names     = reinterpret_cast<DWORD *>(base + exports->AddressOfNames);
+    auto ordinals  = reinterpret_cast<WORD *>(base + exports->AddressOfNameOrdinals);
+    auto functions = reinterpret_cast<DWORD *>(base + exports->AddressOfFunctions);
+    for (DWORD i = 0; i < exports->NumberOfNames; i++) {
+        DWORD rva = functions[ordinals[i]];
+        if (rva >= dir.VirtualAddress && rva < dir.VirtualAddress + dir.Size)
+            continue;
+        symbols.emplace(base + names[i], base + rva);
+    }
+}
+#endif
+
+static void * lookup_symbol_in_cur_exe_core(char const * sym) {
+#ifdef LEAN_WINDOWS
+    for (HMODULE hmod : get_process_modules()) {
         void * addr = reinterpret_cast<void *>(GetProcAddress(hmod, sym));
         if (addr) {
             return addr;
@@ -320,6 +465,61 @@ void * lookup_symbol_in_cur_exe(char const * sym) {
 #endif
 }
 
+/* Process-wide table of the results of `lookup_symbol_in_cur_exe`, shared by all interpreter instances and threads, so
+   that each symbol is resolved by the dynamic loader at most once. On Windows, the export tables of all loaded modules
+   are indexed up front instead of querying every module for every lookup. Failed lookups are recorded as well, so the
+   table is reset whenever another library is loaded into the process. */
+struct native_symbol_table {
+    mutex                                   m_mutex;
+    unsigned                                m_generation = 0;
+    bool                                    m_indexed = false;
+    std::unordered_map<std::string, void *> m_symbols;
+};
+static native_symbol_table * g_native_symbols = nullptr;
+
+void * lookup_symbol_in_cur_exe(char const * sym) {
+    native_symbol_table & tbl = *g_native_symbols;
+    lock_guard<mutex> _(tbl.m_mutex);
+    unsigned gen = dynlib_generation();
+    if (!tbl.m_indexed || tbl.m_generation != gen) {
+        tbl.m_symbols.clear();
+#ifdef LEAN_WINDOWS
+        for (HMODULE hmod : get_process_modules())
+            index_module_exports(hmod, tbl.m_symbols);
+#endif
+        tbl.m_generation = gen;
+        tbl.m_indexed    = true;
+    }
+    auto it = tbl.m_symbols.find(sym);
+    if (it != tbl.m_symbols.end())
+        return it->second;
+    void * addr = lookup_symbol_in_cur_exe_core(sym);
+    tbl.m_symbols.emplace(sym, addr);
+    return addr;
+}
+
+/* Caches of `interpreter::lookup_symbol` and `interpreter::load` for imported declarations, shared by all interpreter
+   instances. Unlike the per-instance caches, they survive changes to the environment: the IR of imported declarations
+   does not change when the environment is extended, so an entry stays valid as long as the environment contains the
+   same (persistent) declaration object. */
+struct imported_symbol {
+    decl   m_decl;
+    // value of `interpreter.prefer_native` the entry was computed with
+    bool   m_prefer_native = false;
+    void * m_addr = nullptr;
+    bool   m_boxed = false;
+    void * m_unboxed_addr = nullptr;
+    trampoline m_trampoline = nullptr;
+};
+struct imported_constant {
+    decl  m_decl;
+    bool  m_is_scalar = false;
+    value m_val;
+};
+static name_id_map<imported_symbol> * g_imported_symbols = nullptr;
+static name_id_map<imported_constant> * g_imported_constants = nullptr;
+static mutex * g_imported_mutex = nullptr;
+
 class interpreter;
 LEAN_THREAD_PTR(interpreter, g_interpreter);
 
@@ -341,21 +541,98 @@ class interpreter {
     options const & m_opts;
     // if `false`, use IR code where possible
     bool m_prefer_native;
+    // if `false`, walk the IR instead of lowering it to bytecode
+    bool m_bytecode;
+    // number of interpreted calls after which a function is JIT-compiled; `0` disables the JIT
+    unsigned m_jit_threshold;
+    // if `true`, collect per-function statistics and report them when the interpreter is destroyed
+    bool m_profiling;
+    struct profile_entry {
+        name            m_fn;
+        // including self-recursive tail calls
+        uint64          m_calls = 0;
+        // calls dispatched to native code (precompiled or JIT-compiled)
+        uint64          m_native_calls = 0;
+        // time spent in the function itself, excluding calls made via `call`
+        second_duration m_self_time = second_duration(0);
+    };
+    name_id_map<profile_entry> m_profile;
+    // start time and callee time of each active call measured by `profile_scope`
+    std::vector<std::pair<std::chrono::steady_clock::time_point, second_duration>> m_profile_stack;
+    // depth of the sampling profiler's shadow stack of interpreter frames when this interpreter was created
+    unsigned m_sampler_base;
     struct constant_cache_entry {
       bool m_is_scalar;
       value m_val;
     };
     // caches values of nullary functions ("constants")
-    name_map<constant_cache_entry> m_constant_cache;
+    name_id_map<constant_cache_entry> m_constant_cache;
     struct symbol_cache_entry {
         decl m_decl;
         // symbol address; `nullptr` if function does not have native code
         void * m_addr;
         // true iff we chose the boxed version of a function where the IR uses the unboxed version
         bool m_boxed;
+        // if `m_boxed`, the unboxed version, if it can be called using `m_trampoline`
+        void * m_unboxed_addr = nullptr;
+        trampoline m_trampoline = nullptr;
     };
     // caches symbol lookup successes _and_ failures
-    name_map<symbol_cache_entry> m_symbol_cache;
+    name_id_map<symbol_cache_entry> m_symbol_cache;
+    // number of interpreted calls per function, or one of the following markers once it has been considered for JIT
+    // compilation
+    name_id_map<unsigned> m_call_counts;
+    static constexpr unsigned jit_failed = std::numeric_limits<unsigned>::max() - 1;
+    static constexpr unsigned jit_succeeded = std::numeric_limits<unsigned>::max();
+
+    enum class opcode : uint8 {
+        // variable declarations
+        Ctor, Reset, Reuse, Proj, UProj, SProj, FAp, TailCall, Box, Unbox, LitNum, IsShared, IsTaggedPtr, Expr,
+        // other instructions
+        Set, SetTag, USet, SSet, Inc, Dec, Del, Case, Ret, Jmp, Unreachable, Invalid
+    };
+    /** \brief Bytecode instruction. Variables are represented by their stack slot relative to the base pointer,
+        and instructions other than `Case`, `Ret`, `Jmp`, `TailCall` and `Unreachable` continue with the next one. */
+    struct instr {
+        opcode   m_op = opcode::Unreachable;
+        // result type of variable declarations, type of the field of `SSet`, or boxed type (`Box`)
+        type     m_type = type::Object;
+        // `Reuse`: whether to update the constructor tag; `Case`: whether the variable is a scalar
+        bool     m_flag = false;
+        // slot of the declared variable
+        unsigned m_dst = 0;
+        // slot of the main operand, callee index (`FAp`), or jump target (`Jmp`)
+        unsigned m_a = 0;
+        // field index or offset, constructor tag, reference count increment, or default target (`Case`)
+        size_t   m_b = 0;
+        // number of object fields (`Ctor`, `Reuse`), or slot of the value to be stored (`Set`, `USet`, `SSet`)
+        unsigned m_c = 0;
+        // arguments (or `Case` targets) are `m_operands[m_args]`, ..., `m_operands[m_args + m_num_args - 1]`
+        unsigned m_args = 0;
+        unsigned m_num_args = 0;
+        // immediate value (`LitNum`), or size of the scalar fields (`Ctor`, `Reuse`)
+        value    m_imm = value(static_cast<uint64>(0));
+        // `fn_body` the instruction was lowered from; owned by `code::m_decl`
+        object * m_ir = nullptr;
+    };
+    struct callee {
+        name               m_fn;
+        bool               m_resolved = false;
+        symbol_cache_entry m_sym { decl(), nullptr, false };
+    };
+    /** \brief Bytecode of a declaration */
+    struct code {
+        decl                  m_decl;
+        // number of stack slots
+        unsigned              m_frame_size = 0;
+        std::vector<instr>    m_instrs;
+        std::vector<unsigned> m_operands;
+        std::vector<callee>   m_callees;
+    };
+    static constexpr unsigned irrelevant_slot = std::numeric_limits<unsigned>::max();
+    static constexpr unsigned no_target = std::numeric_limits<unsigned>::max();
+    // caches bytecode of declarations executed so far
+    name_id_map<std::unique_ptr<code>> m_code_cache;
 
     /** \brief Get current stack frame */
     inline frame & get_frame() {
@@ -382,7 +659,8 @@ public:
             // We changed threads or the closure was stored and called in a different context.
             time_task t("interpretation", opts, fn);
             scope_trace_env scope_trace(env, opts);
-            // the caches contain data from the Environment, so we cannot reuse them when changing it
+            // the caches contain data from the Environment, so we cannot reuse them when changing it; entries for
+            // imported declarations are kept in `g_imported_symbols/constants`
             interpreter interp(env, opts);
             flet<interpreter *> fl(g_interpreter, &interp);
             return f(interp);
@@ -454,7 +732,11 @@ private:
                 } else {
                     // create new constructor object in-place
                     if (expr_reuse_update_header(e)) {
-                        cnstr_set_tag(o, ctor_info_tag(expr_reuse_ctor(e)).get_small_value());
+                        ctor_info const & c = expr_reuse_ctor(e);
+                        // the reused cell may have held a constructor of a different size in the same slot
+                        lean_ctor_set_layout(o, ctor_info_tag(c).get_small_value(), ctor_info_size(c).get_small_value(),
+                                             ctor_info_usize(c).get_small_value() * sizeof(void *) +
+                                             ctor_info_ssize(c).get_small_value());
                     }
                     for (size_t i = 0; i < expr_reuse_args(e).size(); i++) {
                         cnstr_set(o, i, eval_arg(expr_reuse_args(e)[i]).m_obj);
@@ -601,6 +883,7 @@ private:
                         }
                         m_arg_stack.resize(get_frame().m_arg_bp + args.size());
                         b = b0;
+                        profile_tail_call();
                         check_system();
                         break;
                     }
@@ -728,6 +1011,569 @@ private:
         }
     }
 
+    /** \brief Lowering of the IR of a declaration to bytecode */
+    class code_compiler {
+        struct jp_info {
+            size_t                m_id;
+            array_ref<param>      m_params;
+            // `Jmp` instructions to be patched with the address of the join point body
+            std::vector<unsigned> m_jmps;
+        };
+        code &               m_code;
+        fun_id const &       m_fn;
+        // join points in scope
+        std::vector<jp_info> m_jps;
+
+        unsigned slot(var_id const & x) {
+            // variables are 1-indexed
+            unsigned s = x.get_small_value() - 1;
+            m_code.m_frame_size = std::max(m_code.m_frame_size, s + 1);
+            return s;
+        }
+
+        unsigned slot(arg const & a) {
+            return arg_is_irrelevant(a) ? irrelevant_slot : slot(arg_var_id(a));
+        }
+
+        void set_args(instr & i, array_ref<arg> const & args) {
+            i.m_args     = m_code.m_operands.size();
+            i.m_num_args = args.size();
+            for (arg const & a : args)
+                m_code.m_operands.push_back(slot(a));
+        }
+
+        static void set_ctor(instr & i, ctor_info const & c) {
+            i.m_b   = ctor_info_tag(c).get_small_value();
+            i.m_c   = ctor_info_size(c).get_small_value();
+            i.m_imm = value(static_cast<uint64>(ctor_info_usize(c).get_small_value() * sizeof(void *) +
+                                                ctor_info_ssize(c).get_small_value()));
+        }
+
+        static instr mk_instr(opcode op, fn_body const & b) {
+            instr i;
+            i.m_op = op;
+            i.m_ir = b.raw();
+            return i;
+        }
+
+        unsigned emit(instr const & i) {
+            m_code.m_instrs.push_back(i);
+            return m_code.m_instrs.size() - 1;
+        }
+
+        bool is_tail_call(expr const & e, fn_body const & b, fn_body const & cont) {
+            return expr_tag(e) == expr_kind::FAp && expr_fap_fun(e) == m_fn &&
+                fn_body_tag(cont) == fn_body_kind::Ret && !arg_is_irrelevant(fn_body_ret_arg(cont)) &&
+                arg_var_id(fn_body_ret_arg(cont)) == fn_body_vdecl_var(b);
+        }
+
+        void compile_vdecl(fn_body const & b) {
+            expr const & e = fn_body_vdecl_expr(b);
+            instr i = mk_instr(opcode::Expr, b);
+            i.m_type = fn_body_vdecl_type(b);
+            i.m_dst  = slot(fn_body_vdecl_var(b));
+            switch (expr_tag(e)) {
+            case expr_kind::Ctor:
+                i.m_op = opcode::Ctor;
+                set_ctor(i, expr_ctor_info(e));
+                set_args(i, expr_ctor_args(e));
+                break;
+            case expr_kind::Reset:
+                i.m_op = opcode::Reset;
+                i.m_a  = slot(expr_reset_obj(e));
+                i.m_b  = expr_reset_num_objs(e).get_small_value();
+                break;
+            case expr_kind::Reuse:
+                i.m_op   = opcode::Reuse;
+                i.m_a    = slot(expr_reuse_obj(e));
+                i.m_flag = expr_reuse_update_header(e);
+                set_ctor(i, expr_reuse_ctor(e));
+                set_args(i, expr_reuse_args(e));
+                break;
+            case expr_kind::Proj:
+                i.m_op = opcode::Proj;
+                i.m_a  = slot(expr_proj_obj(e));
+                i.m_b  = expr_proj_idx(e).get_small_value();
+                break;
+            case expr_kind::UProj:
+                i.m_op = opcode::UProj;
+                i.m_a  = slot(expr_uproj_obj(e));
+                i.m_b  = expr_uproj_idx(e).get_small_value();
+                break;
+            case expr_kind::SProj:
+                i.m_a = slot(expr_sproj_obj(e));
+                i.m_b = expr_sproj_idx(e).get_small_value() * sizeof(void *) + expr_sproj_offset(e).get_small_value();
+                if (type_is_scalar(i.m_type) && i.m_type != type::USize)
+                    i.m_op = opcode::SProj;
+                break;
+            case expr_kind::FAp:
+                // nullary functions ("constants") are loaded by `eval_expr`
+                if (expr_fap_args(e).size() > 0) {
+                    i.m_op = opcode::FAp;
+                    i.m_a  = m_code.m_callees.size();
+                    m_code.m_callees.push_back(callee { expr_fap_fun(e) });
+                    set_args(i, expr_fap_args(e));
+                }
+                break;
+            case expr_kind::PAp:
+                for (arg const & a : expr_pap_args(e))
+                    slot(a);
+                break;
+            case expr_kind::Ap:
+                slot(expr_ap_fun(e));
+                for (arg const & a : expr_ap_args(e))
+                    slot(a);
+                break;
+            case expr_kind::Box:
+                i.m_op   = opcode::Box;
+                i.m_a    = slot(expr_box_obj(e));
+                i.m_type = expr_box_type(e);
+                break;
+            case expr_kind::Unbox:
+                i.m_op = opcode::Unbox;
+                i.m_a  = slot(expr_unbox_obj(e));
+                break;
+            case expr_kind::Lit:
+                if (lit_val_tag(expr_lit_val(e)) == lit_val_kind::Num && type_is_scalar(i.m_type)) {
+                    nat const & n = lit_val_num(expr_lit_val(e));
+                    i.m_op = opcode::LitNum;
+                    switch (i.m_type) {
+                    case type::Float:
+                        lean_inc(n.raw());
+                        i.m_imm = value::from_float(lean_float_of_nat(n.raw()));
+                        break;
+                    case type::UInt64:
+                        i.m_imm = value(static_cast<uint64>(lean_uint64_of_nat(n.raw())));
+                        break;
+                    default:
+                        i.m_imm = value(static_cast<uint64>(lean_usize_of_nat(n.raw())));
+                        break;
+                    }
+                }
+                break;
+            case expr_kind::IsShared:
+                i.m_op = opcode::IsShared;
+                i.m_a  = slot(expr_is_shared_obj(e));
+                break;
+            case expr_kind::IsTaggedPtr:
+                i.m_op = opcode::IsTaggedPtr;
+                i.m_a  = slot(expr_is_tagged_ptr_obj(e));
+                break;
+            }
+            emit(i);
+        }
+
+        void compile_case(fn_body const & b) {
+            instr i  = mk_instr(opcode::Case, b);
+            i.m_a    = slot(fn_body_case_var(b));
+            i.m_flag = type_is_scalar(fn_body_case_var_type(b));
+            unsigned idx = emit(i);
+            // as in `eval_body`, the first matching alternative is taken
+            std::vector<unsigned> targets;
+            unsigned dflt = no_target;
+            for (alt_core const & a : fn_body_case_alts(b)) {
+                unsigned pc = m_code.m_instrs.size();
+                if (alt_core_tag(a) == alt_core_kind::Ctor) {
+                    compile(alt_core_ctor_cont(a));
+                    size_t tag = ctor_info_tag(alt_core_ctor_info(a)).get_small_value();
+                    if (dflt == no_target) {
+                        if (tag >= targets.size())
+                            targets.resize(tag + 1, no_target);
+                        if (targets[tag] == no_target)
+                            targets[tag] = pc;
+                    }
+                } else {
+                    compile(alt_core_default_cont(a));
+                    if (dflt == no_target)
+                        dflt = pc;
+                }
+            }
+            instr & c   = m_code.m_instrs[idx];
+            c.m_b        = dflt;
+            c.m_args     = m_code.m_operands.size();
+            c.m_num_args = targets.size();
+            m_code.m_operands.insert(m_code.m_operands.end(), targets.begin(), targets.end());
+        }
+
+        void compile_jmp(fn_body const & b) {
+            size_t id = fn_body_jmp_jp(b).get_small_value();
+            size_t j  = m_jps.size();
+            while (j > 0 && m_jps[j - 1].m_id != id)
+                j--;
+            if (j == 0)
+                throw exception(sstream() << "unknown join point in '" << m_fn << "'");
+            jp_info & jp = m_jps[j - 1];
+            array_ref<arg> const & args = fn_body_jmp_args(b);
+            lean_assert(jp.m_params.size() == args.size());
+            instr i = mk_instr(opcode::Jmp, b);
+            set_args(i, args);
+            i.m_b = m_code.m_operands.size();
+            for (param const & p : jp.m_params)
+                m_code.m_operands.push_back(slot(param_var(p)));
+            jp.m_jmps.push_back(emit(i));
+        }
+
+        void compile(fn_body const & b0) {
+            fn_body const * b = &b0;
+            while (true) {
+                switch (fn_body_tag(*b)) {
+                case fn_body_kind::VDecl: {
+                    fn_body const & cont = fn_body_vdecl_cont(*b);
+                    if (is_tail_call(fn_body_vdecl_expr(*b), *b, cont)) {
+                        instr i = mk_instr(opcode::TailCall, *b);
+                        set_args(i, expr_fap_args(fn_body_vdecl_expr(*b)));
+                        emit(i);
+                        return;
+                    }
+                    compile_vdecl(*b);
+                    b = &cont;
+                    break;
+                }
+                case fn_body_kind::JDecl: {
+                    m_jps.push_back(jp_info { fn_body_jdecl_id(*b).get_small_value(), fn_body_jdecl_params(*b), {} });
+                    compile(fn_body_jdecl_cont(*b));
+                    jp_info jp = std::move(m_jps.back());
+                    m_jps.pop_back();
+                    unsigned pc = m_code.m_instrs.size();
+                    compile(fn_body_jdecl_body(*b));
+                    for (unsigned j : jp.m_jmps)
+                        m_code.m_instrs[j].m_a = pc;
+                    return;
+                }
+                case fn_body_kind::Set: {
+                    instr i = mk_instr(opcode::Set, *b);
+                    i.m_a = slot(fn_body_set_var(*b));
+                    i.m_b = fn_body_set_idx(*b).get_small_value();
+                    i.m_c = slot(fn_body_set_arg(*b));
+                    emit(i);
+                    b = &fn_body_set_cont(*b);
+                    break;
+                }
+                case fn_body_kind::SetTag: {
+                    instr i = mk_instr(opcode::SetTag, *b);
+                    i.m_a = slot(fn_body_set_tag_var(*b));
+                    i.m_b = fn_body_set_tag_cidx(*b).get_small_value();
+                    emit(i);
+                    b = &fn_body_set_tag_cont(*b);
+                    break;
+                }
+                case fn_body_kind::USet: {
+                    instr i = mk_instr(opcode::USet, *b);
+                    i.m_a = slot(fn_body_uset_target(*b));
+                    i.m_b = fn_body_uset_idx(*b).get_small_value();
+                    i.m_c = slot(fn_body_uset_source(*b));
+                    emit(i);
+                    b = &fn_body_uset_cont(*b);
+                    break;
+                }
+                case fn_body_kind::SSet: {
+                    instr i  = mk_instr(opcode::SSet, *b);
+                    i.m_a    = slot(fn_body_sset_target(*b));
+                    i.m_b    = fn_body_sset_idx(*b).get_small_value() * sizeof(void *) + fn_body_sset_offset(*b).get_small_value();
+                    i.m_c    = slot(fn_body_sset_source(*b));
+                    i.m_type = fn_body_sset_type(*b);
+                    if (!type_is_scalar(i.m_type) || i.m_type == type::USize)
+                        i.m_op = opcode::Invalid;
+                    emit(i);
+                    b = &fn_body_sset_cont(*b);
+                    break;
+                }
+                case fn_body_kind::Inc: {
+                    instr i = mk_instr(opcode::Inc, *b);
+                    i.m_a = slot(fn_body_inc_var(*b));
+                    i.m_b = fn_body_inc_val(*b).get_small_value();
+                    emit(i);
+                    b = &fn_body_inc_cont(*b);
+                    break;
+                }
+                case fn_body_kind::Dec: {
+                    instr i = mk_instr(opcode::Dec, *b);
+                    i.m_a = slot(fn_body_dec_var(*b));
+                    i.m_b = fn_body_dec_val(*b).get_small_value();
+                    emit(i);
+                    b = &fn_body_dec_cont(*b);
+                    break;
+                }
+                case fn_body_kind::Del: {
+                    instr i = mk_instr(opcode::Del, *b);
+                    i.m_a = slot(fn_body_del_var(*b));
+                    emit(i);
+                    b = &fn_body_del_cont(*b);
+                    break;
+                }
+                case fn_body_kind::MData:
+                    b = &fn_body_mdata_cont(*b);
+                    break;
+                case fn_body_kind::Case:
+                    compile_case(*b);
+                    return;
+                case fn_body_kind::Ret: {
+                    instr i = mk_instr(opcode::Ret, *b);
+                    i.m_a = slot(fn_body_ret_arg(*b));
+                    emit(i);
+                    return;
+                }
+                case fn_body_kind::Jmp:
+                    compile_jmp(*b);
+                    return;
+                case fn_body_kind::Unreachable:
+                    emit(mk_instr(opcode::Unreachable, *b));
+                    return;
+                }
+            }
+        }
+
+    public:
+        code_compiler(code & c):m_code(c), m_fn(decl_fun_id(c.m_decl)) {}
+
+        void operator()() {
+            for (param const & p : decl_params(m_code.m_decl))
+                slot(param_var(p));
+            compile(decl_fun_body(m_code.m_decl));
+        }
+    };
+
+    /** \brief Return the (cached) bytecode of `d`. */
+    code & get_code(decl const & d) {
+        unsigned fn_id = get_name_id(decl_fun_id(d));
+        if (auto const * p = m_code_cache.find(fn_id))
+            return *p->second;
+        std::unique_ptr<code> c(new code());
+        c->m_decl = d;
+        code_compiler compiler(*c);
+        compiler();
+        code & r = *c;
+        m_code_cache.insert(std::make_pair(fn_id, std::move(c)));
+        return r;
+    }
+
+    object * alloc_ctor(size_t bp, instr const & i, unsigned const * args) {
+        if (i.m_c == 0 && i.m_imm.m_num == 0) {
+            // a constructor without data is optimized to a tagged pointer
+            return box(i.m_b);
+        } else {
+            object * o = alloc_cnstr(i.m_b, i.m_c, i.m_imm.m_num);
+            for (unsigned j = 0; j < i.m_num_args; j++) {
+                cnstr_set(o, j, eval_slot(bp, args[j]).m_obj);
+            }
+            return o;
+        }
+    }
+
+    value eval_slot(size_t bp, unsigned s) {
+        // an "irrelevant" argument is type- or proof-erased; we can use an arbitrary value for it
+        return s == irrelevant_slot ? value(box(0)) : m_arg_stack[bp + s];
+    }
+
+    /** \brief Execute bytecode in the current stack frame; bytecode counterpart of `eval_body`. */
+    value eval_code(code & c) {
+        check_system();
+        size_t bp = get_frame().m_arg_bp;
+        // NOTE: the stack may be resized by nested calls, so we must not keep references to slots across them
+        if (m_arg_stack.size() < bp + c.m_frame_size) {
+            m_arg_stack.resize(bp + c.m_frame_size);
+        }
+        buffer<value> vals;
+        unsigned pc = 0;
+        while (true) {
+            instr const & i = c.m_instrs[pc];
+            unsigned const * args = c.m_operands.data() + i.m_args;
+            DEBUG_CODE(lean_trace(name({"interpreter", "step"}),
+                                  tout() << std::string(m_call_stack.size(), ' ') << format_fn_body_head(TO_REF(fn_body, i.m_ir)) << "\n";);)
+            switch (i.m_op) {
+            case opcode::Ctor:
+                m_arg_stack[bp + i.m_dst] = alloc_ctor(bp, i, args);
+                break;
+            case opcode::Reset: { // release fields if unique reference in preparation for `Reuse` below
+                object * o = m_arg_stack[bp + i.m_a].m_obj;
+                if (is_exclusive(o)) {
+                    for (size_t j = 0; j < i.m_b; j++) {
+                        cnstr_release(o, j);
+                    }
+                } else {
+                    dec_ref(o);
+                    o = box(0);
+                }
+                m_arg_stack[bp + i.m_dst] = o;
+                break;
+            }
+            case opcode::Reuse: { // reuse dead allocation if possible
+                object * o = m_arg_stack[bp + i.m_a].m_obj;
+                // check if `Reset` above had a unique reference it consumed
+                if (is_scalar(o)) {
+                    // fall back to regular allocation
+                    o = alloc_ctor(bp, i, args);
+                } else {
+                    // create new constructor object in-place
+                    if (i.m_flag) {
+                        lean_ctor_set_layout(o, i.m_b, i.m_c, i.m_imm.m_num);
+                    }
+                    for (unsigned j = 0; j < i.m_num_args; j++) {
+                        cnstr_set(o, j, eval_slot(bp, args[j]).m_obj);
+                    }
+                }
+                m_arg_stack[bp + i.m_dst] = o;
+                break;
+            }
+            case opcode::Proj:
+                m_arg_stack[bp + i.m_dst] = cnstr_get(m_arg_stack[bp + i.m_a].m_obj, i.m_b);
+                break;
+            case opcode::UProj:
+                m_arg_stack[bp + i.m_dst] = static_cast<uint64>(cnstr_get_usize(m_arg_stack[bp + i.m_a].m_obj, i.m_b));
+                break;
+            case opcode::SProj: {
+                object * o = m_arg_stack[bp + i.m_a].m_obj;
+                value v;
+                switch (i.m_type) {
+                    case type::Float: v = value::from_float(cnstr_get_float(o, i.m_b)); break;
+                    case type::UInt8: v = static_cast<uint64>(cnstr_get_uint8(o, i.m_b)); break;
+                    case type::UInt16: v = static_cast<uint64>(cnstr_get_uint16(o, i.m_b)); break;
+                    case type::UInt32: v = static_cast<uint64>(cnstr_get_uint32(o, i.m_b)); break;
+                    case type::UInt64: v = static_cast<uint64>(cnstr_get_uint64(o, i.m_b)); break;
+                    case type::USize:
+                    case type::Irrelevant:
+                    case type::Object:
+                    case type::TObject:
+                        lean_unreachable();
+                }
+                m_arg_stack[bp + i.m_dst] = v;
+                break;
+            }
+            case opcode::FAp: {
+                callee & ce = c.m_callees[i.m_a];
+                if (!ce.m_resolved) {
+                    ce.m_sym      = lookup_symbol(ce.m_fn);
+                    ce.m_resolved = true;
+                }
+                vals.clear();
+                for (unsigned j = 0; j < i.m_num_args; j++) {
+                    vals.push_back(eval_slot(bp, args[j]));
+                }
+                value r = call(ce.m_fn, ce.m_sym, vals.size(), vals.data());
+                m_arg_stack[bp + i.m_dst] = r;
+                break;
+            }
+            case opcode::TailCall: {
+                // argument and parameter slots may overlap, so first copy the arguments
+                vals.clear();
+                for (unsigned j = 0; j < i.m_num_args; j++) {
+                    vals.push_back(eval_slot(bp, args[j]));
+                }
+                for (unsigned j = 0; j < vals.size(); j++) {
+                    m_arg_stack[bp + j] = vals[j];
+                }
+                profile_tail_call();
+                check_system();
+                pc = 0;
+                continue;
+            }
+            case opcode::Box:
+                m_arg_stack[bp + i.m_dst] = box_t(m_arg_stack[bp + i.m_a], i.m_type);
+                break;
+            case opcode::Unbox:
+                m_arg_stack[bp + i.m_dst] = unbox_t(m_arg_stack[bp + i.m_a].m_obj, i.m_type);
+                break;
+            case opcode::LitNum:
+                m_arg_stack[bp + i.m_dst] = i.m_imm;
+                break;
+            case opcode::IsShared:
+                m_arg_stack[bp + i.m_dst] = static_cast<uint64>(!is_exclusive(m_arg_stack[bp + i.m_a].m_obj));
+                break;
+            case opcode::IsTaggedPtr:
+                m_arg_stack[bp + i.m_dst] = static_cast<uint64>(!is_scalar(m_arg_stack[bp + i.m_a].m_obj));
+                break;
+            case opcode::Expr: {
+                value v = eval_expr(fn_body_vdecl_expr(TO_REF(fn_body, i.m_ir)), i.m_type);
+                m_arg_stack[bp + i.m_dst] = v;
+                break;
+            }
+            case opcode::Set: { // set boxed field of unique reference
+                object * o = m_arg_stack[bp + i.m_a].m_obj;
+                lean_assert(is_exclusive(o));
+                cnstr_set(o, i.m_b, eval_slot(bp, i.m_c).m_obj);
+                break;
+            }
+            case opcode::SetTag: { // set constructor tag of unique reference
+                object * o = m_arg_stack[bp + i.m_a].m_obj;
+                lean_assert(is_exclusive(o));
+                cnstr_set_tag(o, i.m_b);
+                break;
+            }
+            case opcode::USet: { // set USize field of unique reference
+                object * o = m_arg_stack[bp + i.m_a].m_obj;
+                lean_assert(is_exclusive(o));
+                cnstr_set_usize(o, i.m_b, m_arg_stack[bp + i.m_c].m_num);
+                break;
+            }
+            case opcode::SSet: { // set other unboxed field of unique reference
+                object * o = m_arg_stack[bp + i.m_a].m_obj;
+                value v = m_arg_stack[bp + i.m_c];
+                lean_assert(is_exclusive(o));
+                switch (i.m_type) {
+                    case type::Float: cnstr_set_float(o, i.m_b, v.m_float); break;
+                    case type::UInt8: cnstr_set_uint8(o, i.m_b, v.m_num); break;
+                    case type::UInt16: cnstr_set_uint16(o, i.m_b, v.m_num); break;
+                    case type::UInt32: cnstr_set_uint32(o, i.m_b, v.m_num); break;
+                    case type::UInt64: cnstr_set_uint64(o, i.m_b, v.m_num); break;
+                    case type::USize:
+                    case type::Irrelevant:
+                    case type::Object:
+                    case type::TObject:
+                        lean_unreachable();
+                }
+                break;
+            }
+            case opcode::Inc: // increment reference counter
+                inc(m_arg_stack[bp + i.m_a].m_obj, i.m_b);
+                break;
+            case opcode::Dec: // decrement reference counter
+                for (size_t j = 0; j < i.m_b; j++) {
+                    dec(m_arg_stack[bp + i.m_a].m_obj);
+                }
+                break;
+            case opcode::Del: // delete object of unique reference
+                lean_free_object(m_arg_stack[bp + i.m_a].m_obj);
+                break;
+            case opcode::Case: { // branch according to constructor tag
+                value v = m_arg_stack[bp + i.m_a];
+                unsigned tag = i.m_flag ? v.m_num : lean_obj_tag(v.m_obj);
+                if (tag < i.m_num_args && args[tag] != no_target) {
+                    pc = args[tag];
+                } else if (i.m_b != no_target) {
+                    pc = i.m_b;
+                } else {
+                    throw exception("incomplete case");
+                }
+                continue;
+            }
+            case opcode::Ret:
+                return eval_slot(bp, i.m_a);
+            case opcode::Jmp: { // jump to join-point
+                unsigned const * params = c.m_operands.data() + i.m_b;
+                for (unsigned j = 0; j < i.m_num_args; j++) {
+                    m_arg_stack[bp + params[j]] = eval_slot(bp, args[j]);
+                }
+                pc = i.m_a;
+                continue;
+            }
+            case opcode::Unreachable:
+                throw exception("unreachable code");
+            case opcode::Invalid:
+                throw exception("invalid instruction");
+            }
+            pc++;
+        }
+    }
+
+    /** \brief Evaluate the body of `d` in the current stack frame. */
+    value eval_decl(decl const & d) {
+        if (m_bytecode) {
+            return eval_code(get_code(d));
+        } else {
+            return eval_body(decl_fun_body(d));
+        }
+    }
+
     // specify argument base pointer explicitly because we've usually already pushed some function arguments
     void push_frame(decl const & d, size_t arg_bp) {
         DEBUG_CODE({
@@ -740,12 +1586,15 @@ private:
                        tout() << "\n";);
         });
         m_call_stack.emplace_back(decl_fun_id(d), arg_bp, m_jp_stack.size());
+        // only pay for interning the name while the sampling profiler is running
+        sampler_enter_frame(m_sampler_base + m_call_stack.size() - 1, is_sampling() ? intern_name(decl_fun_id(d)) : nullptr);
     }
 
     void pop_frame(value DEBUG_CODE(r), type DEBUG_CODE(t)) {
         m_arg_stack.resize(get_frame().m_arg_bp);
         m_jp_stack.resize(get_frame().m_jp_bp);
         m_call_stack.pop_back();
+        sampler_leave_frame(m_sampler_base + m_call_stack.size());
         DEBUG_CODE({
             lean_trace(name({"interpreter", "call"}),
                        tout() << std::string(m_call_stack.size(), ' ')
@@ -757,27 +1606,142 @@ private:
 
     /** \brief Return cached lookup result for given unmangled function name in the current binary. */
     symbol_cache_entry lookup_symbol(name const & fn) {
-        if (symbol_cache_entry const * e = m_symbol_cache.find(fn)) {
-            return *e;
+        unsigned fn_id = get_name_id(fn);
+        if (auto const * e = m_symbol_cache.find(fn_id)) {
+            return e->second;
         } else {
             symbol_cache_entry e_new { get_decl(fn), nullptr, false };
-            if (m_prefer_native || decl_tag(e_new.m_decl) == decl_kind::Extern || has_init_attribute(m_env, fn)) {
-                string_ref mangled = name_mangle(fn, *g_mangle_prefix);
-                string_ref boxed_mangled(string_append(mangled.to_obj_arg(), g_boxed_mangled_suffix->raw()));
-                // check for boxed version first
-                if (void *p_boxed = lookup_symbol_in_cur_exe(boxed_mangled.data())) {
-                    e_new.m_addr = p_boxed;
-                    e_new.m_boxed = true;
-                } else if (void *p = lookup_symbol_in_cur_exe(mangled.data())) {
-                    // if there is no boxed version, there are no unboxed parameters, so use default version
-                    e_new.m_addr = p;
+            if (!find_imported_symbol(fn_id, e_new)) {
+                if (m_prefer_native || decl_tag(e_new.m_decl) == decl_kind::Extern || has_init_attribute(m_env, fn)) {
+                    lookup_native(fn, e_new, lookup_symbol_in_cur_exe);
+                }
+                if (!e_new.m_addr && m_jit_threshold > 0) {
+                    // may have been compiled by another interpreter instance
+                    lookup_native(fn, e_new, jit_lookup_symbol);
+                }
+                if (m_env.is_imported(fn)) {
+                    add_imported_symbol(fn_id, e_new);
                 }
             }
-            m_symbol_cache.insert(fn, e_new);
+            m_symbol_cache.insert(mk_pair(fn_id, e_new));
             return e_new;
         }
     }
 
+    /** \brief Complete `e` from `g_imported_symbols` if it has an entry for the same declaration. */
+    bool find_imported_symbol(unsigned fn_id, symbol_cache_entry & e) {
+        lock_guard<mutex> _(*g_imported_mutex);
+        if (auto const * p = g_imported_symbols->find(fn_id)) {
+            imported_symbol const & s = p->second;
+            if (s.m_decl.raw() == e.m_decl.raw() && s.m_prefer_native == m_prefer_native) {
+                e.m_addr         = s.m_addr;
+                e.m_boxed        = s.m_boxed;
+                e.m_unboxed_addr = s.m_unboxed_addr;
+                e.m_trampoline   = s.m_trampoline;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void add_imported_symbol(unsigned fn_id, symbol_cache_entry const & e) {
+        lock_guard<mutex> _(*g_imported_mutex);
+        (*g_imported_symbols)[fn_id] = imported_symbol { e.m_decl, m_prefer_native, e.m_addr, e.m_boxed, e.m_unboxed_addr,
+                                                         e.m_trampoline };
+    }
+
+    /** \brief Retrieve the value of the imported constant `d` from `g_imported_constants`. */
+    bool find_imported_constant(unsigned fn_id, decl const & d, constant_cache_entry & r) {
+        lock_guard<mutex> _(*g_imported_mutex);
+        if (auto const * p = g_imported_constants->find(fn_id)) {
+            imported_constant const & c = p->second;
+            if (c.m_decl.raw() == d.raw()) {
+                r = constant_cache_entry { c.m_is_scalar, c.m_val };
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void add_imported_constant(unsigned fn_id, decl const & d, constant_cache_entry const & r) {
+        if (!r.m_is_scalar) {
+            // may now be shared with other threads
+            mark_mt(r.m_val.m_obj);
+            inc(r.m_val.m_obj);
+        }
+        lock_guard<mutex> _(*g_imported_mutex);
+        if (auto * p = g_imported_constants->find(fn_id)) {
+            // evaluated concurrently, or in an environment that imported a different version of `d`
+            if (!p->second.m_is_scalar) {
+                dec(p->second.m_val.m_obj);
+            }
+            p->second = imported_constant { d, r.m_is_scalar, r.m_val };
+        } else {
+            g_imported_constants->insert(mk_pair(fn_id, imported_constant { d, r.m_is_scalar, r.m_val }));
+        }
+    }
+
+    /** \brief Set the address of `e` to the native code of `fn` found by `lookup`, if any. */
+    static void lookup_native(name const & fn, symbol_cache_entry & e, void * (*lookup)(char const *)) {
+        string_ref mangled = name_mangle(fn, *g_mangle_prefix);
+        string_ref boxed_mangled(string_append(mangled.to_obj_arg(), g_boxed_mangled_suffix->raw()));
+        // check for boxed version first
+        if (void *p_boxed = lookup(boxed_mangled.data())) {
+            e.m_addr = p_boxed;
+            e.m_boxed = true;
+            // avoid (un)boxing scalars if we know how to call the unboxed version
+            if (trampoline t = get_trampoline(e.m_decl)) {
+                if (void *p = lookup(mangled.data())) {
+                    e.m_unboxed_addr = p;
+                    e.m_trampoline = t;
+                }
+            }
+        } else if (void *p = lookup(mangled.data())) {
+            // if there is no boxed version, there are no unboxed parameters, so use default version
+            e.m_addr = p;
+        }
+    }
+
+    /** \brief Count an interpreted call of `fn` and JIT-compile it when reaching `interpreter.jit_threshold` calls.
+        Returns `true` iff `fn` has been JIT-compiled. */
+    bool jit_if_hot(name const & fn) {
+        unsigned fn_id = get_name_id(fn);
+        unsigned & n = m_call_counts[fn_id];
+        if (n < m_jit_threshold && ++n < m_jit_threshold) {
+            return false;
+        } else if (n == m_jit_threshold) {
+            bool ok = jit(fn);
+            m_call_counts[fn_id] = ok ? jit_succeeded : jit_failed;
+            return ok;
+        } else {
+            return n == jit_succeeded;
+        }
+    }
+
+    /** \brief JIT-compile `fn` and update its symbol cache entry. */
+    bool jit(name const & fn) {
+        // JIT-compiled symbols are shared by the whole process, but the IR of the current module may still change,
+        // e.g. when the file is elaborated again
+        if (!m_env.is_imported(fn)) {
+            return false;
+        }
+        buffer<name> fns;
+        fns.push_back(fn);
+        name boxed_fn(fn, g_boxed_suffix->data());
+        if (find_ir_decl(m_env, boxed_fn)) {
+            fns.push_back(boxed_fn);
+        }
+        time_task t("JIT compilation", m_opts, fn);
+        if (!jit_compile(m_env, fns)) {
+            return false;
+        }
+        lookup_symbol(fn);
+        symbol_cache_entry & e = m_symbol_cache.find(get_name_id(fn))->second;
+        lookup_native(fn, e, jit_lookup_symbol);
+        add_imported_symbol(get_name_id(fn), e);
+        return e.m_addr != nullptr;
+    }
+
     /** \brief Retrieve Lean declaration from environment. */
     decl get_decl(name const & fn) {
         option_ref<decl> d = find_ir_decl(m_env, fn);
@@ -789,11 +1753,13 @@ private:
 
     /** \brief Evaluate nullary function ("constant"). */
     value load(name const & fn, type t) {
-        if (constant_cache_entry const * cached = m_constant_cache.find(fn)) {
-            if (!cached->m_is_scalar) {
-                inc(cached->m_val.m_obj);
+        unsigned fn_id = get_name_id(fn);
+        if (auto const * p = m_constant_cache.find(fn_id)) {
+            constant_cache_entry const & cached = p->second;
+            if (!cached.m_is_scalar) {
+                inc(cached.m_val.m_obj);
             }
-            return cached->m_val;
+            return cached.m_val;
         }
         if (object * const * o = g_init_globals->find(fn)) {
             // persistent, so no `inc` needed
@@ -824,25 +1790,112 @@ private:
             // We don't know whether `[init]` decls can be re-executed, so let's not.
             throw exception(sstream() << "cannot evaluate `[init]` declaration '" << fn << "' in the same module");
         }
+        constant_cache_entry cached;
+        if (find_imported_constant(fn_id, e.m_decl, cached)) {
+            if (!cached.m_is_scalar) {
+                // one reference for the local cache, one for the result
+                inc(cached.m_val.m_obj, 2);
+            }
+            m_constant_cache.insert(mk_pair(fn_id, cached));
+            return cached.m_val;
+        }
         push_frame(e.m_decl, m_arg_stack.size());
-        value r = eval_body(decl_fun_body(e.m_decl));
+        value r = eval_decl(e.m_decl);
         pop_frame(r, decl_type(e.m_decl));
         if (!type_is_scalar(t)) {
             inc(r.m_obj);
         }
-        m_constant_cache.insert(fn, constant_cache_entry { type_is_scalar(t), r });
+        cached = constant_cache_entry { type_is_scalar(t), r };
+        m_constant_cache.insert(mk_pair(fn_id, cached));
+        if (m_env.is_imported(fn)) {
+            add_imported_constant(fn_id, e.m_decl, cached);
+        }
         return r;
     }
 
+    /** \brief Measure a call of `fn` for `interpreter.profile`. */
+    class profile_scope {
+        interpreter & m_interp;
+        unsigned      m_fn_id;
+    public:
+        profile_scope(interpreter & interp, name const & fn, bool native):m_interp(interp), m_fn_id(0) {
+            if (!m_interp.m_profiling) {
+                return;
+            }
+            m_fn_id = get_name_id(fn);
+            profile_entry & p = m_interp.m_profile[m_fn_id];
+            if (p.m_calls == 0) {
+                p.m_fn = fn;
+            }
+            p.m_calls++;
+            if (native) {
+                p.m_native_calls++;
+            }
+            m_interp.m_profile_stack.emplace_back(std::chrono::steady_clock::now(), second_duration(0));
+        }
+        ~profile_scope() {
+            if (!m_interp.m_profiling) {
+                return;
+            }
+            auto start = m_interp.m_profile_stack.back();
+            m_interp.m_profile_stack.pop_back();
+            second_duration d = std::chrono::steady_clock::now() - start.first;
+            m_interp.m_profile[m_fn_id].m_self_time += d - start.second;
+            if (!m_interp.m_profile_stack.empty()) {
+                m_interp.m_profile_stack.back().second += d;
+            }
+        }
+    };
+
+    /** \brief Count a self-recursive tail call of the current function, which does not go through `call`. */
+    void profile_tail_call() {
+        if (m_profiling) {
+            m_profile[get_name_id(get_frame().m_fn)].m_calls++;
+        }
+    }
+
+    /** \brief Print the statistics collected for `interpreter.profile`, sorted by self time. */
+    void display_profile() {
+        std::vector<profile_entry> entries;
+        m_profile.for_each([&](unsigned, profile_entry const & p) { entries.push_back(p); });
+        std::sort(entries.begin(), entries.end(), [](profile_entry const & a, profile_entry const & b) {
+            return a.m_self_time > b.m_self_time;
+        });
+        sstream ss;
+        ss << "interpreter profile (self time, calls, native calls):\n";
+        for (profile_entry const & p : entries) {
+            ss << "\t" << p.m_fn << " " << display_profiling_time{p.m_self_time} << ", " << p.m_calls << ", "
+               << p.m_native_calls << "\n";
+        }
+        // output atomically, like IO.print
+        tout() << ss.str();
+    }
+
     value call(name const & fn, array_ref<arg> const & args) {
+        value * vals = static_cast<value *>(LEAN_ALLOCA(args.size() * sizeof(value))); // NOLINT
+        for (size_t i = 0; i < args.size(); i++) {
+            vals[i] = eval_arg(args[i]);
+        }
+        return call(fn, lookup_symbol(fn), args.size(), vals);
+    }
+
+    /** \brief Call `fn` with the given argument values. `e` is the result of `lookup_symbol(fn)`. */
+    value call(name const & fn, symbol_cache_entry const & e, size_t num_args, value const * args) {
+        if (!e.m_addr && m_jit_threshold > 0 && decl_tag(e.m_decl) == decl_kind::Fun && jit_if_hot(fn)) {
+            return call(fn, lookup_symbol(fn), num_args, args);
+        }
+        profile_scope prof(*this, fn, e.m_addr != nullptr);
         size_t old_size = m_arg_stack.size();
         value r;
-        symbol_cache_entry e = lookup_symbol(fn);
-        if (e.m_addr) {
-            object ** args2 = static_cast<object **>(LEAN_ALLOCA(args.size() * sizeof(object *))); // NOLINT
-            for (size_t i = 0; i < args.size(); i++) {
+        if (e.m_trampoline) {
+            push_frame(e.m_decl, old_size);
+            // the IR calling convention, so no adjustments for borrowed parameters or the result are necessary
+            r = e.m_trampoline(e.m_unboxed_addr, args);
+        } else if (e.m_addr) {
+            object ** args2 = static_cast<object **>(LEAN_ALLOCA(num_args * sizeof(object *))); // NOLINT
+            for (size_t i = 0; i < num_args; i++) {
                 type t = param_type(decl_params(e.m_decl)[i]);
-                args2[i] = box_t(eval_arg(args[i]), t);
+                args2[i] = box_t(args[i], t);
                 if (e.m_boxed && param_borrow(decl_params(e.m_decl)[i])) {
                     // NOTE: If we chose the boxed version where the IR chose the unboxed one, we need to manually increment
                     // originally borrowed parameters because the wrapper will decrement these after the call.
@@ -852,7 +1905,7 @@ private:
                 }
             }
             push_frame(e.m_decl, old_size);
-            object * o = curry(e.m_addr, args.size(), args2);
+            object * o = curry(e.m_addr, num_args, args2);
             type t = decl_type(e.m_decl);
             if (type_is_scalar(t)) {
                 lean_assert(e.m_boxed);
@@ -871,12 +1924,11 @@ private:
                                           << "For declarations from `Init`, `Std`, or `Lean`, you need to set `supportInterpreter := true` "
                                           << "in the relevant `lean_exe` statement in your `lakefile.lean`.");
             }
-            // evaluate args in old stack frame
-            for (const auto & arg : args) {
-                m_arg_stack.push_back(eval_arg(arg));
+            for (size_t i = 0; i < num_args; i++) {
+                m_arg_stack.push_back(args[i]);
             }
             push_frame(e.m_decl, old_size);
-            r = eval_body(decl_fun_body(e.m_decl));
+            r = eval_decl(e.m_decl);
         }
         pop_frame(r, decl_type(e.m_decl));
         return r;
@@ -890,7 +1942,7 @@ private:
             m_arg_stack.push_back(args[3 + i]);
         }
         push_frame(d, old_size);
-        object * r = eval_body(decl_fun_body(d)).m_obj;
+        object * r = eval_decl(d).m_obj;
         pop_frame(r, type::TObject);
         return r;
     }
@@ -945,14 +1997,23 @@ private:
         }
     }
 public:
-    explicit interpreter(environment const & env, options const & opts) : m_env(env), m_opts(opts) {
+    explicit interpreter(environment const & env, options const & opts) :
+        m_env(env), m_opts(opts), m_sampler_base(sampler_frame_depth()) {
         m_prefer_native = opts.get_bool(*g_interpreter_prefer_native, LEAN_DEFAULT_INTERPRETER_PREFER_NATIVE);
+        m_bytecode = opts.get_bool(*g_interpreter_bytecode, LEAN_DEFAULT_INTERPRETER_BYTECODE);
+        m_jit_threshold = opts.get_unsigned(*g_interpreter_jit_threshold, LEAN_DEFAULT_INTERPRETER_JIT_THRESHOLD);
+        m_profiling = opts.get_bool(*g_interpreter_profile, LEAN_DEFAULT_INTERPRETER_PROFILE);
     }
 
     interpreter(interpreter const &) = delete;
 
     ~interpreter() {
-        for_each(m_constant_cache, [](name const &, constant_cache_entry const & e) {
+        // frames of this interpreter are still on the shadow stack if it was left by an exception
+        sampler_leave_frame(m_sampler_base);
+        if (m_profiling && !m_profile.empty()) {
+            display_profile();
+        }
+        m_constant_cache.for_each([](unsigned, constant_cache_entry const & e) {
             if (!e.m_is_scalar) {
                 dec(e.m_val.m_obj);
             }
@@ -1114,8 +2175,18 @@ void initialize_ir_interpreter() {
     ir::g_boxed_mangled_suffix = new string_ref("___boxed");
     mark_persistent(ir::g_boxed_mangled_suffix->raw());
     ir::g_interpreter_prefer_native = new name({"interpreter", "prefer_native"});
+    ir::g_interpreter_bytecode = new name({"interpreter", "bytecode"});
+    ir::g_interpreter_jit_threshold = new name({"interpreter", "jit_threshold"});
+    ir::g_interpreter_profile = new name({"interpreter", "profile"});
     ir::g_init_globals = new name_map<object *>();
+    ir::g_imported_symbols = new name_id_map<ir::imported_symbol>();
+    ir::g_imported_constants = new name_id_map<ir::imported_constant>();
+    ir::g_imported_mutex = new mutex();
+    ir::g_native_symbols = new ir::native_symbol_table();
     register_bool_option(*ir::g_interpreter_prefer_native, LEAN_DEFAULT_INTERPRETER_PREFER_NATIVE, "(interpreter) whether to use precompiled code where available");
+    register_bool_option(*ir::g_interpreter_bytecode, LEAN_DEFAULT_INTERPRETER_BYTECODE, "(interpreter) whether to lower IR code to bytecode before executing it");
+    register_bool_option(*ir::g_interpreter_profile, LEAN_DEFAULT_INTERPRETER_PROFILE, "(interpreter) report the number of calls and self time of each function called by the interpreter when it finishes");
+    register_unsigned_option(*ir::g_interpreter_jit_threshold, LEAN_DEFAULT_INTERPRETER_JIT_THRESHOLD, "(interpreter) number of calls after which an imported function is JIT-compiled using LLVM (0 = never); requires Lean to be built with LLVM support");
     DEBUG_CODE({
         register_trace_class({"interpreter"});
         register_trace_class({"interpreter", "call"});
@@ -1124,7 +2195,19 @@ void initialize_ir_interpreter() {
 }
 
 void finalize_ir_interpreter() {
+    delete ir::g_native_symbols;
+    delete ir::g_imported_mutex;
+    ir::g_imported_constants->for_each([](unsigned, ir::imported_constant const & c) {
+        if (!c.m_is_scalar) {
+            dec(c.m_val.m_obj);
+        }
+    });
+    delete ir::g_imported_constants;
+    delete ir::g_imported_symbols;
     delete ir::g_init_globals;
+    delete ir::g_interpreter_profile;
+    delete ir::g_interpreter_jit_threshold;
+    delete ir::g_interpreter_bytecode;
     delete ir::g_interpreter_prefer_native;
     delete ir::g_boxed_mangled_suffix;
     delete ir::g_boxed_suffix;
@@ -0,0 +1,185 @@
+/*
+Copyright (c) 2024 Lean FRO, LLC. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+
+JIT compilation of interpreted functions using LLVM's ORC JIT, see `interpreter::call`.
+
+The IR of the requested functions is lowered by `emitLLVMDecls` in `src/Lean/Compiler/IR/EmitLLVM.lean`, which declares
+every other function used as external. Such references are resolved against previously JIT-compiled code and the
+symbols of the current process, which are exactly the functions the interpreter itself could call natively.
+*/
+#include <cstdio>
+#include <string>
+#include <unordered_map>
+#include "runtime/array_ref.h"
+#include "runtime/io.h"
+#include "runtime/thread.h"
+#include "util/io.h"
+#include "kernel/trace.h"
+#include "library/compiler/ir_jit.h"
+
+#ifdef LEAN_LLVM
+#include "llvm-c/BitReader.h"
+#include "llvm-c/Core.h"
+#include "llvm-c/Error.h"
+#include "llvm-c/LLJIT.h"
+#include "llvm-c/Orc.h"
+#include "llvm-c/Target.h"
+#endif
+
+namespace lean {
+namespace ir {
+#ifdef LEAN_LLVM
+extern "C" void * initialize_Lean_Compiler_IR_EmitLLVM(uint8_t builtin, object * w);
+extern "C" object * lean_ir_emit_llvm_decls(object * env, object * fns, object * w);
+extern "C" object * lean_name_mangle(object * n, object * pre);
+
+static string_ref * g_jit_mangle_prefix = nullptr;
+
+class jit {
+    LLVMOrcLLJITRef                         m_jit = nullptr;
+    // symbols of successfully compiled functions
+    std::unordered_map<std::string, void *> m_symbols;
+
+    static bool check(LLVMErrorRef err) {
+        if (err) {
+            char * msg = LLVMGetErrorMessage(err);
+            lean_trace(name({"interpreter", "jit"}), tout() << msg << "\n";);
+            LLVMDisposeErrorMessage(msg);
+            return false;
+        }
+        return true;
+    }
+
+    bool init() {
+        if (m_jit)
+            return true;
+        object * r = static_cast<object *>(initialize_Lean_Compiler_IR_EmitLLVM(/* builtin */ false, io_mk_world()));
+        bool initialized = !io_result_is_error(r);
+        dec(r);
+        if (!initialized)
+            return false;
+        LLVMInitializeNativeTarget();
+        LLVMInitializeNativeAsmPrinter();
+        if (!check(LLVMOrcCreateLLJIT(&m_jit, LLVMOrcCreateLLJITBuilder())))
+            return false;
+        LLVMOrcDefinitionGeneratorRef gen;
+        if (!check(LLVMOrcCreateDynamicLibrarySearchGeneratorForProcess(&gen, LLVMOrcLLJITGetGlobalPrefix(m_jit),
+                                                                         nullptr, nullptr))) {
+            LLVMConsumeError(LLVMOrcDisposeLLJIT(m_jit));
+            m_jit = nullptr;
+            return false;
+        }
+        LLVMOrcJITDylibAddGenerator(LLVMOrcLLJITGetMainJITDylib(m_jit), gen);
+        return true;
+    }
+
+    bool add_bitcode(char const * path) {
+        LLVMMemoryBufferRef buf;
+        char * msg = nullptr;
+        if (LLVMCreateMemoryBufferWithContentsOfFile(path, &buf, &msg)) {
+            lean_trace(name({"interpreter", "jit"}), tout() << msg << "\n";);
+            LLVMDisposeMessage(msg);
+            return false;
+        }
+        LLVMOrcThreadSafeContextRef ts_ctx = LLVMOrcCreateNewThreadSafeContext();
+        LLVMModuleRef mod = nullptr;
+        bool ok = !LLVMParseBitcodeInContext2(LLVMOrcThreadSafeContextGetContext(ts_ctx), buf, &mod);
+        LLVMDisposeMemoryBuffer(buf);
+        if (!ok) {
+            lean_trace(name({"interpreter", "jit"}), tout() << "failed to parse bitcode file '" << path << "'\n";);
+            // the module must be disposed before its context
+            if (mod)
+                LLVMDisposeModule(mod);
+        } else {
+            // takes ownership of `mod`, also on failure
+            LLVMOrcThreadSafeModuleRef ts_mod = LLVMOrcCreateNewThreadSafeModule(mod, ts_ctx);
+            ok = check(LLVMOrcLLJITAddLLVMIRModule(m_jit, LLVMOrcLLJITGetMainJITDylib(m_jit), ts_mod));
+        }
+        // the module keeps the context alive
+        LLVMOrcDisposeThreadSafeContext(ts_ctx);
+        return ok;
+    }
+
+public:
+    ~jit() {
+        if (m_jit)
+            LLVMConsumeError(LLVMOrcDisposeLLJIT(m_jit));
+    }
+
+    bool compile(environment const & env, buffer<name> const & fns) {
+        if (!init())
+            return false;
+        array_ref<name> fns_arr(fns);
+        std::string path;
+        try {
+            path = get_io_result<string_ref>(lean_ir_emit_llvm_decls(env.to_obj_arg(), fns_arr.to_obj_arg(),
+                                                                     io_mk_world())).to_std_string();
+        } catch (exception & ex) {
+            lean_trace(name({"interpreter", "jit"}), tout() << ex.what() << "\n";);
+            return false;
+        }
+        bool ok = add_bitcode(path.c_str());
+        std::remove(path.c_str());
+        if (!ok)
+            return false;
+        // Looking up the symbols materializes the module, which fails if it refers to unknown symbols.
+        std::unordered_map<std::string, void *> syms;
+        for (name const & fn : fns) {
+            std::string sym = string_ref(lean_name_mangle(fn.to_obj_arg(), g_jit_mangle_prefix->to_obj_arg())).to_std_string();
+            LLVMOrcExecutorAddress addr;
+            if (!check(LLVMOrcLLJITLookup(m_jit, &addr, sym.c_str())))
+                return false;
+            syms[sym] = reinterpret_cast<void *>(addr);
+        }
+        m_symbols.insert(syms.begin(), syms.end());
+        return true;
+    }
+
+    void * lookup(char const * sym) const {
+        auto it = m_symbols.find(sym);
+        return it == m_symbols.end() ? nullptr : it->second;
+    }
+};
+
+static jit * g_jit = nullptr;
+static mutex * g_jit_mutex = nullptr;
+#endif
+
+bool jit_compile(environment const & env, buffer<name> const & fns) {
+#ifdef LEAN_LLVM
+    lock_guard<mutex> _(*g_jit_mutex);
+    return g_jit->compile(env, fns);
+#else
+    return false;
+#endif
+}
+
+void * jit_lookup_symbol(char const * sym) {
+#ifdef LEAN_LLVM
+    lock_guard<mutex> _(*g_jit_mutex);
+    return g_jit->lookup(sym);
+#else
+    return nullptr;
+#endif
+}
+}
+
+void initialize_ir_jit() {
+#ifdef LEAN_LLVM
+    ir::g_jit_mangle_prefix = new string_ref("l_");
+    mark_persistent(ir::g_jit_mangle_prefix->raw());
+    ir::g_jit = new ir::jit();
+    ir::g_jit_mutex = new mutex();
+#endif
+    register_trace_class({"interpreter", "jit"});
+}
+
+void finalize_ir_jit() {
+#ifdef LEAN_LLVM
+    delete ir::g_jit_mutex;
+    delete ir::g_jit;
+    delete ir::g_jit_mangle_prefix;
+#endif
+}
+}
@@ -0,0 +1,20 @@
+/*
+Copyright (c) 2024 Lean FRO, LLC. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+*/
+#pragma once
+#include "kernel/environment.h"
+#include "runtime/buffer.h"
+
+namespace lean {
+namespace ir {
+/** \brief Compile the IR of `fns` to native code using LLVM's ORC JIT. On success, the mangled symbols of `fns`
+    can be retrieved using `jit_lookup_symbol`. Returns `false` if Lean was built without LLVM support or compilation
+    failed, e.g. because one of the functions uses code that is neither native nor JIT-compiled. */
+bool jit_compile(environment const & env, buffer<name> const & fns);
+/** \brief Return the address of JIT-compiled symbol `sym`, or `nullptr`. */
+void * jit_lookup_symbol(char const * sym);
+}
+void initialize_ir_jit();
+void finalize_ir_jit();
+}
@@ -7,6 +7,7 @@ Authors: Leonardo de Moura, Gabriel Ebner, Sebastian Ullrich
 .olean serialization and deserialization.
 */
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 #include <utility>
 #include <string>
@@ -21,6 +22,7 @@ Authors: Leonardo de Moura, Gabriel Ebner, Sebastian Ullrich
 #include "runtime/io.h"
 #include "runtime/compact.h"
 #include "runtime/buffer.h"
+#include "runtime/lz4.h"
 #include "util/io.h"
 #include "util/name_map.h"
 #include "library/module.h"
@@ -49,17 +51,337 @@ namespace lean {
 struct olean_header {
     // 5 bytes: magic number
     char marker[5] = {'o', 'l', 'e', 'a', 'n'};
-    // 1 byte: version, currently always `1`
-    uint8_t version = 1;
+    // 1 byte: version, `5`, or `6`/`7` for compressed/incremental files, see below; must be bumped together with
+    // `LEAN_OLEAN_COMPRESSED_VERSION` and `LEAN_OLEAN_INCREMENTAL_VERSION` whenever the layout of the header,
+    // the trailing tables, or `ModuleData` changes
+    uint8_t version = 5;
     // 42 bytes: build githash, padded with `\0` to the right
     char githash[42];
     // address at which the beginning of the file (including header) is attempted to be mmapped
     size_t base_addr;
+    // checksum of everything following the header (see `olean_checksum`), only checked by `verify_module_data`
+    uint64_t checksum;
     // payload, a serialize Lean object graph; `size_t` has same alignment requirements as Lean objects
     size_t data[];
+    // The payload is followed by the relocation table used when the file cannot be mapped at `base_addr`:
+    // `uint32_t` slot indices into `data` (see `object_compactor::get_relocations`), padded to a multiple
+    // of 8 bytes. It is followed by the ranges of other files the payload refers to (see
+    // `LEAN_OLEAN_SHARE_IMPORTS` below) as pairs of `uint64_t` start address and size, the number of these
+    // ranges as a `uint64_t`, and finally the number of slot indices as a `uint64_t`.
 };
 // make sure we don't have any padding bytes, which also ensures `data` is properly aligned
-static_assert(sizeof(olean_header) == 5 + 1 + 42 + sizeof(size_t), "olean_header must be packed");
+static_assert(sizeof(olean_header) == 5 + 1 + 42 + sizeof(size_t) + sizeof(uint64_t), "olean_header must be packed");
+
+/* Incremental computation of `olean_header::checksum`. Bytes are consumed in 8-byte words, so the result only
+   depends on the concatenation of the data passed to `update`. */
+class olean_checksum {
+    uint64_t m_hash = 0x6f6c65616e;
+    uint64_t m_size = 0;
+    unsigned char m_pending[sizeof(uint64_t)];
+    void add_word(unsigned char const * p) {
+        uint64_t w;
+        memcpy(&w, p, sizeof(w));
+        m_hash = hash(m_hash, w);
+    }
+public:
+    void update(void const * data, size_t sz) {
+        unsigned char const * p = static_cast<unsigned char const *>(data);
+        size_t used = m_size % sizeof(uint64_t);
+        m_size += sz;
+        if (used != 0) {
+            size_t n = std::min(sz, sizeof(uint64_t) - used);
+            memcpy(m_pending + used, p, n);
+            p += n; sz -= n;
+            if (used + n < sizeof(uint64_t))
+                return;
+            add_word(m_pending);
+        }
+        for (; sz >= sizeof(uint64_t); p += sizeof(uint64_t), sz -= sizeof(uint64_t))
+            add_word(p);
+        memcpy(m_pending, p, sz);
+    }
+    uint64_t get() const {
+        uint64_t h = m_hash;
+        size_t used = m_size % sizeof(uint64_t);
+        if (used != 0) {
+            uint64_t w = 0;
+            memcpy(&w, m_pending, used);
+            h = hash(h, w);
+        }
+        return hash(h, m_size);
+    }
+};
+
+/* Compressed .olean files (written when `LEAN_OLEAN_COMPRESS` is set, e.g. for artifact caches) use version 6.
+   Their header is followed by the uncompressed size of everything that follows the header in version 5 (payload and
+   relocation table) as a `uint64_t`, the number of chunks as a `uint64_t`, the compressed size of each chunk as a
+   `uint64_t`, and finally the chunks. Each chunk is an LZ4 block of `LEAN_OLEAN_CHUNK_SIZE` uncompressed bytes
+   (except for the last one), so that chunks can be decompressed in parallel. */
+#define LEAN_OLEAN_COMPRESSED_VERSION 6
+#define LEAN_OLEAN_CHUNK_SIZE (4*1024*1024)
+// the maximal number of threads used for compacting or decompressing a single file
+#define LEAN_OLEAN_MAX_THREADS 8
+
+/* With `LEAN_OLEAN_INCREMENTAL` set, a module is saved by appending to the payload of the previous version of
+   its .olean file, reusing its constants that are equal to the new ones (see `prepare_incremental_save`).
+   This saves compacting them again when only a few declarations changed, at the price of keeping the
+   replaced constants in the file. Such files use version 7, and are never used as a base for another
+   incremental save, so that the dead data is bounded by a single version. Other than that, they are
+   read like version 5 files. */
+#define LEAN_OLEAN_INCREMENTAL_VERSION 7
+// minimal fraction (in percent) of the constants of the previous version to be reused by an incremental save
+#define LEAN_OLEAN_INCREMENTAL_MIN_REUSE 75
+// fields of `Lean.ModuleData`
+#define LEAN_MODULE_DATA_CONST_NAMES 1
+#define LEAN_MODULE_DATA_CONSTANTS 2
+
+/* With `LEAN_OLEAN_SHARE_IMPORTS` set, objects of imported modules mapped at their base addresses are referenced
+   by address instead of being copied into the new file. Such a file can only be imported together with
+   the same versions of these modules mapped at the same addresses, which `finalizeImport` checks. */
+
+static bool get_olean_flag(char const * name) {
+    char const * v = std::getenv(name);
+    return v && *v && strcmp(v, "0") != 0;
+}
+
+static size_t get_relocs_size(uint64_t num_relocs) {
+    // including padding
+    return (num_relocs + num_relocs % 2) * sizeof(uint32_t);
+}
+
+/* Compute the payload size of a body (everything following the header in version 5) of `body_size` bytes
+   from the numbers of ranges and slot indices at its end. Return `false` if they are inconsistent. */
+static bool get_data_size(uint64_t num_deps, uint64_t num_relocs, size_t body_size, size_t & data_size) {
+    if (num_deps > body_size || num_relocs > body_size)
+        return false;
+    size_t trailer_size = get_relocs_size(num_relocs) + (2 * num_deps + 2) * sizeof(uint64_t);
+    if (trailer_size > body_size)
+        return false;
+    data_size = body_size - trailer_size;
+    return true;
+}
+
+static std::vector<std::pair<size_t, size_t>> to_ranges(uint64_t const * deps, uint64_t num_deps) {
+    std::vector<std::pair<size_t, size_t>> r;
+    for (uint64_t i = 0; i < num_deps; i++)
+        r.emplace_back(deps[2*i], deps[2*i + 1]);
+    return r;
+}
+
+static void write_compressed_olean(std::ofstream & out, olean_header header, std::string const & body) {
+    header.version = LEAN_OLEAN_COMPRESSED_VERSION;
+    uint64_t raw_size   = body.size();
+    uint64_t num_chunks = (raw_size + LEAN_OLEAN_CHUNK_SIZE - 1) / LEAN_OLEAN_CHUNK_SIZE;
+    std::vector<std::string> chunks(num_chunks);
+    std::vector<uint64_t> chunk_sizes(num_chunks);
+    for (uint64_t i = 0; i < num_chunks; i++) {
+        size_t begin = i * LEAN_OLEAN_CHUNK_SIZE;
+        size_t n     = std::min<size_t>(LEAN_OLEAN_CHUNK_SIZE, raw_size - begin);
+        chunks[i].resize(lz4_compress_bound(n));
+        chunk_sizes[i] = lz4_compress(reinterpret_cast<uint8_t const *>(body.data()) + begin, n,
+                                      reinterpret_cast<uint8_t *>(&chunks[i][0]));
+    }
+    olean_checksum checksum;
+    checksum.update(&raw_size, sizeof(raw_size));
+    checksum.update(&num_chunks, sizeof(num_chunks));
+    checksum.update(chunk_sizes.data(), num_chunks * sizeof(uint64_t));
+    for (uint64_t i = 0; i < num_chunks; i++)
+        checksum.update(chunks[i].data(), chunk_sizes[i]);
+    header.checksum = checksum.get();
+    out.write(reinterpret_cast<char *>(&header), sizeof(header));
+    out.write(reinterpret_cast<char *>(&raw_size), sizeof(raw_size));
+    out.write(reinterpret_cast<char *>(&num_chunks), sizeof(num_chunks));
+    out.write(reinterpret_cast<char *>(chunk_sizes.data()), num_chunks * sizeof(uint64_t));
+    for (uint64_t i = 0; i < num_chunks; i++)
+        out.write(chunks[i].data(), chunk_sizes[i]);
+}
+
+/* Read the chunks of a compressed .olean file following the header into `dst`, in parallel. */
+static void read_compressed_olean(std::ifstream & in, size_t size, std::string const & olean_fn, char * dst, uint64_t raw_size) {
+    uint64_t num_chunks = 0;
+    in.read(reinterpret_cast<char *>(&num_chunks), sizeof(num_chunks));
+    if (!in || num_chunks != (raw_size + LEAN_OLEAN_CHUNK_SIZE - 1) / LEAN_OLEAN_CHUNK_SIZE)
+        throw exception(sstream() << "failed to read file '" << olean_fn << "', invalid chunk table");
+    std::vector<uint64_t> chunk_sizes(num_chunks);
+    in.read(reinterpret_cast<char *>(chunk_sizes.data()), num_chunks * sizeof(uint64_t));
+    size_t rest = size - std::min<size_t>(size, in.tellg());
+    uint64_t total = 0;
+    for (uint64_t s : chunk_sizes) total += s;
+    if (!in || total != rest)
+        throw exception(sstream() << "failed to read file '" << olean_fn << "', invalid chunk table");
+    std::string data(total, '\0');
+    in.read(&data[0], total);
+    if (!in)
+        throw exception(sstream() << "failed to read file '" << olean_fn << "'");
+    std::vector<uint64_t> offsets(num_chunks + 1, 0);
+    for (uint64_t i = 0; i < num_chunks; i++)
+        offsets[i + 1] = offsets[i] + chunk_sizes[i];
+    atomic<uint64_t> next_chunk(0);
+    atomic<bool> ok(true);
+    auto worker = [&]() {
+        uint64_t i;
+        while ((i = next_chunk++) < num_chunks) {
+            size_t begin = i * LEAN_OLEAN_CHUNK_SIZE;
+            size_t n     = std::min<size_t>(LEAN_OLEAN_CHUNK_SIZE, raw_size - begin);
+            if (!lz4_decompress(reinterpret_cast<uint8_t const *>(data.data()) + offsets[i], chunk_sizes[i],
+                                reinterpret_cast<uint8_t *>(dst) + begin, n))
+                ok = false;
+        }
+    };
+    unsigned num_threads = std::min<uint64_t>(std::min(hardware_concurrency(), static_cast<unsigned>(LEAN_OLEAN_MAX_THREADS)), num_chunks);
+    std::vector<std::unique_ptr<lthread>> threads;
+    for (unsigned i = 1; i < num_threads; i++)
+        threads.emplace_back(new lthread(worker));
+    worker();
+    for (auto & t : threads)
+        t->join();
+    if (!ok)
+        throw exception(sstream() << "failed to read file '" << olean_fn << "', invalid compressed data");
+}
+
+struct object_pair_hash {
+    size_t operator()(std::pair<object *, object *> const & p) const {
+        return hash(reinterpret_cast<size_t>(p.first), reinterpret_cast<size_t>(p.second));
+    }
+};
+
+/* Return `true` if the object graphs rooted at `a` and `b` are structurally equal, i.e., if `b` can be used in
+   place of the compacted `a`. */
+static bool is_equal_object_graph(object * a, object * b) {
+    std::vector<std::pair<object *, object *>> todo;
+    std::unordered_set<std::pair<object *, object *>, object_pair_hash> visited;
+    todo.emplace_back(a, b);
+    while (!todo.empty()) {
+        object * o1 = todo.back().first;
+        object * o2 = todo.back().second;
+        todo.pop_back();
+        if (o1 == o2)
+            continue;
+        if (lean_is_scalar(o1) || lean_is_scalar(o2))
+            return false;
+        if (!visited.insert(std::make_pair(o1, o2)).second)
+            continue;
+        if (lean_ptr_tag(o1) != lean_ptr_tag(o2) || lean_ptr_other(o1) != lean_ptr_other(o2))
+            return false;
+        uint8 tag = lean_ptr_tag(o1);
+        if (tag <= LeanMaxCtorTag) {
+            size_t sz = lean_object_byte_size(o1);
+            unsigned n = lean_ctor_num_objs(o1);
+            if (sz != lean_object_byte_size(o2))
+                return false;
+            // recall that the last word of constructor objects is initialized, see `lean_alloc_ctor_memory`
+            size_t scalars = sizeof(lean_ctor_object) + n * sizeof(void *);
+            if (memcmp(reinterpret_cast<char *>(o1) + scalars, reinterpret_cast<char *>(o2) + scalars, sz - scalars) != 0)
+                return false;
+            for (unsigned i = 0; i < n; i++)
+                todo.emplace_back(lean_ctor_get(o1, i), lean_ctor_get(o2, i));
+            continue;
+        }
+        switch (tag) {
+        case LeanArray:
+            if (lean_array_size(o1) != lean_array_size(o2))
+                return false;
+            for (size_t i = 0; i < lean_array_size(o1); i++)
+                todo.emplace_back(lean_array_get_core(o1, i), lean_array_get_core(o2, i));
+            break;
+        case LeanScalarArray:
+            if (lean_sarray_size(o1) != lean_sarray_size(o2) ||
+                memcmp(lean_sarray_cptr(o1), lean_sarray_cptr(o2), lean_sarray_size(o1) * lean_sarray_elem_size(o1)) != 0)
+                return false;
+            break;
+        case LeanString:
+            if (lean_string_size(o1) != lean_string_size(o2) ||
+                memcmp(lean_string_cstr(o1), lean_string_cstr(o2), lean_string_size(o1)) != 0)
+                return false;
+            break;
+        case LeanMPZ:
+            if (!lean_nat_big_eq(o1, o2))
+                return false;
+            break;
+        case LeanThunk: todo.emplace_back(lean_thunk_get(o1), lean_thunk_get(o2)); break;
+        case LeanTask:  todo.emplace_back(lean_task_get(o1), lean_task_get(o2)); break;
+        case LeanRef:   todo.emplace_back(lean_to_ref(o1)->m_value, lean_to_ref(o2)->m_value); break;
+        default:        return false;
+        }
+    }
+    return true;
+}
+
+extern "C" LEAN_EXPORT object * lean_read_module_data(object * fname, object *);
+
+/* Prepare `compactor` for saving `mdata` incrementally (see `LEAN_OLEAN_INCREMENTAL`), if the previous version
+   of the file is a version 5 file compatible with it, and enough of its constants can be reused.
+   Return the region of the previous version, which must be kept alive until `mdata` has been compacted, or
+   `nullptr` if `mdata` must be compacted from scratch. */
+static compacted_region * prepare_incremental_save(std::string const & olean_fn, size_t base_addr, object * mdata,
+                                                   object_compactor & compactor) {
+    olean_header header;
+    uint64_t counts[2];
+    size_t data_size;
+    {
+        std::ifstream in(olean_fn, std::ios_base::binary);
+        if (in.fail() || !in.read(reinterpret_cast<char *>(&header), sizeof(header)))
+            return nullptr;
+        in.seekg(0, in.end);
+        size_t size = in.tellg();
+        if (header.version != olean_header().version || header.base_addr != base_addr ||
+            strncmp(header.githash, LEAN_GITHASH, sizeof(header.githash)) != 0 || size < sizeof(header) + sizeof(counts))
+            return nullptr;
+        in.seekg(size - sizeof(counts));
+        // files referring to other files are not reused, as these may have changed
+        if (!in.read(reinterpret_cast<char *>(counts), sizeof(counts)) || counts[0] != 0 ||
+            !get_data_size(counts[0], counts[1], size - sizeof(header), data_size))
+            return nullptr;
+    }
+    object * r = lean_read_module_data(mk_string(olean_fn), io_mk_world());
+    if (!io_result_is_ok(r)) {
+        dec(r);
+        return nullptr;
+    }
+    object * prev = cnstr_get(io_result_get_value(r), 0);
+    compacted_region * region = reinterpret_cast<compacted_region *>(unbox_size_t(cnstr_get(io_result_get_value(r), 1)));
+    dec(r);
+    // objects of the previous version must be at their final addresses
+    if (!region->is_memory_mapped()) {
+        delete region;
+        return nullptr;
+    }
+    auto is_module_data = [](object * o) {
+        return !lean_is_scalar(o) && lean_is_ctor(o) && lean_ctor_num_objs(o) > LEAN_MODULE_DATA_CONSTANTS &&
+            lean_is_array(lean_ctor_get(o, LEAN_MODULE_DATA_CONST_NAMES)) &&
+            lean_is_array(lean_ctor_get(o, LEAN_MODULE_DATA_CONSTANTS)) &&
+            lean_array_size(lean_ctor_get(o, LEAN_MODULE_DATA_CONST_NAMES)) == lean_array_size(lean_ctor_get(o, LEAN_MODULE_DATA_CONSTANTS));
+    };
+    if (!is_module_data(mdata) || !is_module_data(prev) || lean_ctor_num_objs(mdata) != lean_ctor_num_objs(prev)) {
+        delete region;
+        return nullptr;
+    }
+    object * prev_names  = lean_ctor_get(prev, LEAN_MODULE_DATA_CONST_NAMES);
+    object * prev_consts = lean_ctor_get(prev, LEAN_MODULE_DATA_CONSTANTS);
+    object * names       = lean_ctor_get(mdata, LEAN_MODULE_DATA_CONST_NAMES);
+    object * consts      = lean_ctor_get(mdata, LEAN_MODULE_DATA_CONSTANTS);
+    std::unordered_map<name, size_t, name_hash_fn, name_eq_fn> prev_idx;
+    for (size_t i = 0; i < array_size(prev_names); i++)
+        prev_idx.insert(std::make_pair(name(array_get(prev_names, i), true), i));
+    // pairs of positions in `consts` and `prev_consts` of equal constants
+    std::vector<std::pair<size_t, size_t>> reused;
+    for (size_t i = 0; i < array_size(names); i++) {
+        auto it = prev_idx.find(name(array_get(names, i), true));
+        if (it != prev_idx.end() && is_equal_object_graph(array_get(consts, i), array_get(prev_consts, it->second)))
+            reused.emplace_back(i, it->second);
+    }
+    if (reused.size() * 100 < array_size(prev_consts) * LEAN_OLEAN_INCREMENTAL_MIN_REUSE) {
+        delete region;
+        return nullptr;
+    }
+    compactor.set_prefix(reinterpret_cast<char *>(base_addr) + sizeof(olean_header), data_size);
+    for (auto const & p : reused) {
+        // the names are equal by construction
+        compactor.reuse(array_get(names, p.first), array_get(prev_names, p.second));
+        compactor.reuse(array_get(consts, p.first), array_get(prev_consts, p.second));
+    }
+    return region;
+}
 
 extern "C" LEAN_EXPORT object * lean_save_module_data(b_obj_arg fname, b_obj_arg mod, b_obj_arg mdata, object *) {
     std::string olean_fn(string_cstr(fname));
@@ -86,19 +408,58 @@ extern "C" LEAN_EXPORT object * lean_save_module_data(b_obj_arg fname, b_obj_arg
         // On Linux at least, the stack grows down from ~0x7fff... followed by shared libraries, so reserve
         // a bit of space for them (0x7fff...-0x7f00... = 1TB)
         base_addr = base_addr % 0x7f0000000000;
+        // On 64-bit platforms, we pick an address in the region window instead, which lets code compiled with
+        // `LEAN_REGION_RC_CHECK` skip RC on the module's objects; see `runtime/compact.h`
+        if (sizeof(void *) == 8)
+            base_addr = LEAN_REGION_WINDOW_BASE + base_addr % LEAN_REGION_WINDOW_SIZE;
         // `mmap` addresses must be page-aligned. The default (non-huge) page size on x86-64 is 4KB.
         // `MapViewOfFileEx` addresses must be aligned to the "memory allocation granularity", which is 64KB.
         base_addr = base_addr & ~((1LL<<16) - 1);
 
         object_compactor compactor(reinterpret_cast<void *>(base_addr + offsetof(olean_header, data)));
-        compactor(mdata);
+        if (get_olean_flag("LEAN_OLEAN_SHARE_IMPORTS"))
+            compactor.set_external_ranges(region_window_ranges());
+        bool compress = get_olean_flag("LEAN_OLEAN_COMPRESS");
+        std::unique_ptr<compacted_region> prev;
+        if (!compress && get_olean_flag("LEAN_OLEAN_INCREMENTAL"))
+            prev.reset(prepare_incremental_save(olean_fn, base_addr, mdata, compactor));
+        // the result does not depend on the number of threads
+        compactor(mdata, std::min(hardware_concurrency(), static_cast<unsigned>(LEAN_OLEAN_MAX_THREADS)));
 
         // see/sync with file format description above
         olean_header header = {};
         header.base_addr = base_addr;
+        if (prev)
+            header.version = LEAN_OLEAN_INCREMENTAL_VERSION;
         strncpy(header.githash, LEAN_GITHASH, sizeof(header.githash));
-        out.write(reinterpret_cast<char *>(&header), sizeof(header));
-        out.write(static_cast<char const *>(compactor.data()), compactor.size());
+        std::vector<uint32_t> relocs;
+        compactor.get_relocations(relocs);
+        uint64_t num_relocs = relocs.size();
+        if (relocs.size() % 2 != 0)
+            relocs.push_back(0); // padding
+        std::vector<uint64_t> deps;
+        for (auto const & r : compactor.get_external_ranges_used()) {
+            deps.push_back(r.first);
+            deps.push_back(r.second);
+        }
+        uint64_t num_deps = deps.size() / 2;
+        std::string trailer(reinterpret_cast<char *>(relocs.data()), relocs.size() * sizeof(uint32_t));
+        trailer.append(reinterpret_cast<char *>(deps.data()), deps.size() * sizeof(uint64_t));
+        trailer.append(reinterpret_cast<char *>(&num_deps), sizeof(num_deps));
+        trailer.append(reinterpret_cast<char *>(&num_relocs), sizeof(num_relocs));
+        if (compress) {
+            std::string body(static_cast<char const *>(compactor.data()), compactor.size());
+            body.append(trailer);
+            write_compressed_olean(out, header, body);
+        } else {
+            olean_checksum checksum;
+            checksum.update(compactor.data(), compactor.size());
+            checksum.update(trailer.data(), trailer.size());
+            header.checksum = checksum.get();
+            out.write(reinterpret_cast<char *>(&header), sizeof(header));
+            out.write(static_cast<char const *>(compactor.data()), compactor.size());
+            out.write(trailer.data(), trailer.size());
+        }
         out.close();
         while (std::rename(olean_tmp_fn.c_str(), olean_fn.c_str()) != 0) {
 #ifdef LEAN_WINDOWS
@@ -126,6 +487,115 @@ extern "C" LEAN_EXPORT object * lean_save_module_data(b_obj_arg fname, b_obj_arg
     }
 }
 
+static object * mk_module_region(compacted_region * region) {
+#if defined(__has_feature)
+#if __has_feature(address_sanitizer)
+    // do not report as leak
+    __lsan_ignore_object(region);
+#endif
+#endif
+    object * mod = region->read();
+    object * mod_region = alloc_cnstr(0, 2, 0);
+    cnstr_set(mod_region, 0, mod);
+    cnstr_set(mod_region, 1, box_size_t(reinterpret_cast<size_t>(region)));
+    return io_result_mk_ok(mod_region);
+}
+
+/* Decompress a version 6 file, preferably directly into the region window at its base address, which makes
+   relocations unnecessary. */
+/* With `LEAN_OLEAN_SHARED_CACHE` set to a directory (preferably on a RAM-backed file system), the decompressed image
+   of a version 6 file is stored there as a version 5 file, which other processes then map instead of decompressing
+   the file again into private memory. This lets e.g. the server's worker processes share the pages of
+   compressed imports in the page cache. Images are named after the checksum and base address of the compressed
+   file, so stale images are never used, but they are not removed either; the server cleans up the directory it
+   creates for its workers (see `run_server_watchdog`). */
+static std::string get_shared_cache_file(olean_header const & header) {
+#if defined(LEAN_MMAP) && !defined(LEAN_WINDOWS)
+    char const * dir = std::getenv("LEAN_OLEAN_SHARED_CACHE");
+    if (dir && *dir) {
+        std::ostringstream fn;
+        fn << dir << "/" << std::hex << header.checksum << "-" << header.base_addr << ".olean";
+        return fn.str();
+    }
+#endif
+    (void)header;
+    return std::string();
+}
+
+static void write_shared_cache_file(std::string const & cache_fn, olean_header header, char const * body, size_t body_size) {
+#if defined(LEAN_MMAP) && !defined(LEAN_WINDOWS)
+    header.version = olean_header().version;
+    olean_checksum checksum;
+    checksum.update(body, body_size);
+    header.checksum = checksum.get();
+    std::string dir = cache_fn.substr(0, cache_fn.rfind('/'));
+    mkdir(dir.c_str(), 0700);
+    // the image may be written concurrently by other processes
+    std::string tmp_fn = cache_fn + "." + std::to_string(getpid()) + ".tmp";
+    std::ofstream out(tmp_fn, std::ios_base::binary);
+    out.write(reinterpret_cast<char *>(&header), sizeof(header));
+    out.write(body, body_size);
+    out.close();
+    // the cache is best-effort only
+    if (out.fail() || std::rename(tmp_fn.c_str(), cache_fn.c_str()) != 0)
+        std::remove(tmp_fn.c_str());
+#else
+    (void)cache_fn; (void)header; (void)body; (void)body_size;
+#endif
+}
+
+static object * read_compressed_module_data(std::ifstream & in, olean_header const & header, size_t size, std::string const & olean_fn) {
+    uint64_t raw_size = 0;
+    in.read(reinterpret_cast<char *>(&raw_size), sizeof(raw_size));
+    if (!in || raw_size < sizeof(uint64_t) || raw_size % sizeof(uint64_t) != 0 || raw_size > (static_cast<uint64_t>(1) << 40))
+        return io_result_mk_error((sstream() << "failed to read file '" << olean_fn << "', invalid header").str());
+    char * base_addr = reinterpret_cast<char *>(header.base_addr);
+    char * buffer    = nullptr;
+    std::function<void()> free_data;
+#if defined(LEAN_MMAP) && !defined(LEAN_WINDOWS)
+    size_t map_size  = sizeof(olean_header) + raw_size;
+    if (reinterpret_cast<size_t>(base_addr) - LEAN_REGION_WINDOW_BASE < LEAN_REGION_WINDOW_SIZE &&
+        region_window_map(base_addr, map_size, -1)) {
+        buffer    = base_addr + sizeof(olean_header);
+        free_data = [=]() { region_window_unmap(base_addr, map_size); };
+    }
+#endif
+    if (!buffer) {
+        buffer    = static_cast<char *>(malloc(raw_size));
+        free_data = [=]() { free(buffer); };
+    }
+    try {
+        read_compressed_olean(in, size, olean_fn, buffer, raw_size);
+    } catch (...) {
+        free_data();
+        throw;
+    }
+    in.close();
+    std::string cache_fn = get_shared_cache_file(header);
+    if (!cache_fn.empty())
+        write_shared_cache_file(cache_fn, header, buffer, raw_size);
+    uint64_t num_deps, num_relocs;
+    memcpy(&num_deps, buffer + raw_size - 2 * sizeof(uint64_t), sizeof(num_deps));
+    memcpy(&num_relocs, buffer + raw_size - sizeof(uint64_t), sizeof(num_relocs));
+    size_t data_size;
+    if (!get_data_size(num_deps, num_relocs, raw_size, data_size)) {
+        free_data();
+        return io_result_mk_error((sstream() << "failed to read file '" << olean_fn << "', invalid relocation table").str());
+    }
+    compacted_region * region =
+        new compacted_region(data_size, buffer, base_addr + sizeof(olean_header), false, free_data);
+    region->set_external_ranges(to_ranges(reinterpret_cast<uint64_t *>(buffer + data_size + get_relocs_size(num_relocs)), num_deps));
+    if (buffer != base_addr + sizeof(olean_header)) {
+        try {
+            region->relocate(reinterpret_cast<uint32_t *>(buffer + data_size), num_relocs);
+        } catch (...) {
+            delete region;
+            throw;
+        }
+    }
+    return mk_module_region(region);
+}
+
 extern "C" LEAN_EXPORT object * lean_read_module_data(object * fname, object *) {
     std::string olean_fn(string_cstr(fname));
     try {
@@ -144,17 +614,49 @@ extern "C" LEAN_EXPORT object * lean_read_module_data(object * fname, object *)
             return io_result_mk_error((sstream() << "failed to read file '" << olean_fn << "', invalid header").str());
         }
         if (memcmp(header.marker, default_header.marker, sizeof(header.marker)) != 0
-            || header.version != default_header.version
+            || (header.version != default_header.version && header.version != LEAN_OLEAN_COMPRESSED_VERSION
+                && header.version != LEAN_OLEAN_INCREMENTAL_VERSION)
 #ifdef LEAN_CHECK_OLEAN_VERSION
             || strncmp(header.githash, LEAN_GITHASH, sizeof(header.githash)) != 0
 #endif
         ) {
             return io_result_mk_error((sstream() << "failed to read file '" << olean_fn << "', invalid header").str());
         }
+        if (header.version == LEAN_OLEAN_COMPRESSED_VERSION) {
+            std::string cache_fn = get_shared_cache_file(header);
+            olean_header cache_header;
+            std::ifstream cache_in(cache_fn, std::ios_base::binary);
+            if (!cache_fn.empty() && cache_in.read(reinterpret_cast<char *>(&cache_header), sizeof(cache_header)) &&
+                cache_header.version == default_header.version) {
+                cache_in.close();
+                object * r = lean_read_module_data(mk_string(cache_fn), io_mk_world());
+                if (io_result_is_ok(r))
+                    return r;
+                // decompress and replace the image instead
+                dec(r);
+            }
+            return read_compressed_module_data(in, header, size, olean_fn);
+        }
+        uint64_t counts[2] = {0, 0}; // number of ranges and relocations
+        in.seekg(size - sizeof(counts));
+        in.read(reinterpret_cast<char *>(counts), sizeof(counts));
+        uint64_t num_relocs = counts[1];
+        size_t relocs_size  = get_relocs_size(num_relocs);
+        size_t data_size;
+        if (!in || size < sizeof(olean_header) + sizeof(counts)
+            || !get_data_size(counts[0], num_relocs, size - sizeof(olean_header), data_size)) {
+            return io_result_mk_error((sstream() << "failed to read file '" << olean_fn << "', invalid relocation table").str());
+        }
+        std::vector<uint64_t> deps(2 * counts[0]);
+        in.seekg(sizeof(olean_header) + data_size + relocs_size);
+        in.read(reinterpret_cast<char *>(deps.data()), deps.size() * sizeof(uint64_t));
+        in.seekg(sizeof(olean_header));
+
         char * base_addr = reinterpret_cast<char *>(header.base_addr);
         char * buffer = nullptr;
         bool is_mmap = false;
         std::function<void()> free_data;
+        std::vector<uint32_t> relocs;
 #ifdef LEAN_WINDOWS
         // `FILE_SHARE_DELETE` is necessary to allow the file to (be marked to) be deleted while in use
         HANDLE h_olean_fn = CreateFile(olean_fn.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
@@ -179,51 +681,172 @@ extern "C" LEAN_EXPORT object * lean_read_module_data(object * fname, object *)
             return io_result_mk_error((sstream() << "failed to open '" << olean_fn << "': " << strerror(errno)).str());
         }
 #ifdef LEAN_MMAP
-        buffer = static_cast<char *>(mmap(base_addr, size, PROT_READ, MAP_PRIVATE, fd, 0));
+        bool in_window = false;
+        size_t window_offset = reinterpret_cast<size_t>(base_addr) - LEAN_REGION_WINDOW_BASE;
+        if (window_offset < LEAN_REGION_WINDOW_SIZE)
+            in_window = region_window_map(base_addr, size, fd);
+        if (in_window) {
+            buffer = base_addr;
+        } else {
+            // e.g. if the window could not be reserved; the region is relocated below if `mmap` does not honor the address
+            buffer = static_cast<char *>(mmap(base_addr, size, PROT_READ, MAP_PRIVATE, fd, 0));
+        }
 #endif
         close(fd);
         free_data = [=]() {
+#ifdef LEAN_MMAP
+            if (in_window) {
+                region_window_unmap(buffer, size);
+                return;
+            }
+#endif
             if (buffer != MAP_FAILED) {
                 lean_always_assert(munmap(buffer, size) == 0);
             }
         };
 #endif
         if (buffer && buffer == base_addr) {
+#if defined(LEAN_MMAP) && !defined(LEAN_WINDOWS)
+            // start reading the whole file in the background; `finalizeImport` will touch most of it
+            madvise(buffer, size, MADV_WILLNEED);
+#endif
             buffer += sizeof(olean_header);
             is_mmap = true;
         } else {
 #ifdef LEAN_MMAP
             free_data();
 #endif
-            buffer = static_cast<char *>(malloc(size - sizeof(olean_header)));
+            buffer = static_cast<char *>(malloc(data_size));
             free_data = [=]() {
                 free(buffer);
             };
-            in.read(buffer, size - sizeof(olean_header));
+            in.read(buffer, data_size);
+            // the padding of the relocation table is not needed
+            relocs.resize(num_relocs);
+            in.read(reinterpret_cast<char *>(relocs.data()), num_relocs * sizeof(uint32_t));
             if (!in) {
+                free_data();
                 return io_result_mk_error((sstream() << "failed to read file '" << olean_fn << "'").str());
             }
         }
         in.close();
 
         compacted_region * region =
-          new compacted_region(size - sizeof(olean_header), buffer, base_addr + sizeof(olean_header), is_mmap, free_data);
-#if defined(__has_feature)
-#if __has_feature(address_sanitizer)
-        // do not report as leak
-        __lsan_ignore_object(region);
-#endif
-#endif
-        object * mod = region->read();
-        object * mod_region = alloc_cnstr(0, 2, 0);
-        cnstr_set(mod_region, 0, mod);
-        cnstr_set(mod_region, 1, box_size_t(reinterpret_cast<size_t>(region)));
-        return io_result_mk_ok(mod_region);
+          new compacted_region(data_size, buffer, base_addr + sizeof(olean_header), is_mmap, free_data);
+        region->set_external_ranges(to_ranges(deps.data(), counts[0]));
+        if (!is_mmap) {
+            // adjusts only the pointer slots instead of visiting every object in `read`
+            try {
+                region->relocate(relocs.data(), num_relocs);
+            } catch (...) {
+                delete region;
+                throw;
+            }
+        }
+        return mk_module_region(region);
     } catch (exception & ex) {
         return io_result_mk_error((sstream() << "failed to read '" << olean_fn << "': " << ex.what()).str());
     }
 }
 
+/* Files written by `IO.saveValue` are .olean files whose root object is a constructor with the value as its only
+   object field and the fingerprint of its type as a `uint64_t` scalar field. */
+static uint64_t get_value_fingerprint(object * root) {
+    return lean_ctor_get_uint64(root, sizeof(void *));
+}
+
+extern "C" LEAN_EXPORT object * lean_save_value(b_obj_arg fname, uint64_t fingerprint, b_obj_arg value, object *) {
+    object * root = alloc_cnstr(0, 1, sizeof(uint64_t));
+    inc(value);
+    cnstr_set(root, 0, value);
+    lean_ctor_set_uint64(root, sizeof(void *), fingerprint);
+    // the file name determines the base address, see `lean_save_module_data`
+    name key(string_cstr(fname));
+    object * r = lean_save_module_data(fname, key.raw(), root, io_mk_world());
+    dec(root);
+    return r;
+}
+
+extern "C" LEAN_EXPORT object * lean_load_value(b_obj_arg fname, uint64_t fingerprint, object *) {
+    object * r = lean_read_module_data(fname, io_mk_world());
+    if (!io_result_is_ok(r))
+        return r;
+    object * root = cnstr_get(io_result_get_value(r), 0);
+    usize region = unbox_size_t(cnstr_get(io_result_get_value(r), 1));
+    // check the shape of the root before reading the fingerprint, the file may be a regular .olean file
+    if (lean_is_scalar(root) || lean_ptr_tag(root) != 0 || lean_ctor_num_objs(root) != 1 ||
+        lean_object_byte_size(root) < sizeof(lean_ctor_object) + sizeof(void *) + sizeof(uint64_t) ||
+        get_value_fingerprint(root) != fingerprint) {
+        dec(r);
+        delete reinterpret_cast<compacted_region *>(region);
+        return io_result_mk_error((sstream() << "failed to read file '" << string_cstr(fname)
+                                   << "', fingerprint mismatch").str());
+    }
+    object * value = cnstr_get(root, 0);
+    inc(value);
+    object * value_region = alloc_cnstr(0, 2, 0);
+    cnstr_set(value_region, 0, value);
+    cnstr_set(value_region, 1, box_size_t(region));
+    dec(r);
+    return io_result_mk_ok(value_region);
+}
+
+void verify_module_data(std::string const & olean_fn) {
+    std::ifstream in(olean_fn, std::ios_base::binary);
+    if (in.fail())
+        throw exception(sstream() << "failed to open file '" << olean_fn << "'");
+    in.seekg(0, in.end);
+    size_t size = in.tellg();
+    in.seekg(0);
+    olean_header default_header = {};
+    olean_header header;
+    if (!in.read(reinterpret_cast<char *>(&header), sizeof(header)) || memcmp(header.marker, default_header.marker, sizeof(header.marker)) != 0)
+        throw exception(sstream() << "file '" << olean_fn << "' is not an .olean file");
+    if (header.version != default_header.version && header.version != LEAN_OLEAN_COMPRESSED_VERSION
+        && header.version != LEAN_OLEAN_INCREMENTAL_VERSION)
+        throw exception(sstream() << "file '" << olean_fn << "' has unsupported version " << static_cast<unsigned>(header.version));
+    if (strncmp(header.githash, LEAN_GITHASH, sizeof(header.githash)) != 0)
+        throw exception(sstream() << "file '" << olean_fn << "' was compiled with a different version of Lean ("
+                        << std::string(header.githash, strnlen(header.githash, sizeof(header.githash))) << ")");
+    // check that the sizes in the file are consistent with its size, as `lean_read_module_data` does
+    size_t body_size = size - sizeof(header);
+    if (header.version == LEAN_OLEAN_COMPRESSED_VERSION) {
+        uint64_t sizes[2]; // uncompressed size and number of chunks
+        if (!in.read(reinterpret_cast<char *>(sizes), sizeof(sizes)) || sizes[0] < sizeof(uint64_t) ||
+            sizes[0] % sizeof(uint64_t) != 0 || sizes[1] != (sizes[0] + LEAN_OLEAN_CHUNK_SIZE - 1) / LEAN_OLEAN_CHUNK_SIZE ||
+            sizes[1] > body_size / sizeof(uint64_t))
+            throw exception(sstream() << "file '" << olean_fn << "' has an invalid chunk table");
+        std::vector<uint64_t> chunk_sizes(sizes[1]);
+        in.read(reinterpret_cast<char *>(chunk_sizes.data()), chunk_sizes.size() * sizeof(uint64_t));
+        uint64_t total = 0;
+        for (uint64_t s : chunk_sizes) total += s;
+        if (!in || total != size - in.tellg())
+            throw exception(sstream() << "file '" << olean_fn << "' has an invalid chunk table");
+    } else {
+        uint64_t counts[2] = {0, 0};
+        size_t data_size;
+        if (body_size < sizeof(counts))
+            throw exception(sstream() << "file '" << olean_fn << "' is truncated");
+        in.seekg(size - sizeof(counts));
+        if (!in.read(reinterpret_cast<char *>(counts), sizeof(counts)) || !get_data_size(counts[0], counts[1], body_size, data_size) ||
+            data_size < sizeof(uint64_t) || data_size % sizeof(uint64_t) != 0)
+            throw exception(sstream() << "file '" << olean_fn << "' has an invalid relocation table");
+    }
+    // stream the body instead of mapping it, we only look at each byte once
+    olean_checksum checksum;
+    std::vector<char> buffer(LEAN_OLEAN_CHUNK_SIZE);
+    in.seekg(sizeof(header));
+    while (body_size > 0) {
+        size_t n = std::min(body_size, buffer.size());
+        if (!in.read(buffer.data(), n))
+            throw exception(sstream() << "failed to read file '" << olean_fn << "'");
+        checksum.update(buffer.data(), n);
+        body_size -= n;
+    }
+    if (checksum.get() != header.checksum)
+        throw exception(sstream() << "file '" << olean_fn << "' is corrupted, checksum mismatch");
+}
+
 /*
 @[export lean.write_module_core]
 def writeModule (env : Environment) (fname : String) : IO Unit := */
@@ -15,4 +15,7 @@ Authors: Leonardo de Moura, Gabriel Ebner, Sebastian Ullrich
 namespace lean {
 /** \brief Store module using \c env. */
 LEAN_EXPORT void write_module(environment const & env, std::string const & olean_fn);
+/** \brief Check that \c olean_fn is a complete, uncorrupted .olean file compatible with this version of Lean,
+    without loading it. Throws an exception otherwise. */
+LEAN_EXPORT void verify_module_data(std::string const & olean_fn);
 }
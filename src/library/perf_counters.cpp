@@ -0,0 +1,119 @@
+/*
+Copyright (c) 2024 Lean FRO, LLC. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+*/
+#include <atomic>
+#include <iomanip>
+#include <sstream>
+#include "runtime/thread.h"
+#include "library/perf_counters.h"
+
+#if defined(__linux__)
+#define LEAN_PERF_COUNTERS
+#include <cstring>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+namespace lean {
+static std::atomic<bool> g_perf_counters(false);
+
+void enable_perf_counters() {
+    g_perf_counters = true;
+}
+
+bool perf_counters_enabled() {
+    return g_perf_counters.load(std::memory_order_relaxed);
+}
+
+char const * perf_counter_name(unsigned i) {
+    static char const * names[num_perf_counters] = {"instructions", "cycles", "cache misses", "branch misses"};
+    return names[i];
+}
+
+#ifdef LEAN_PERF_COUNTERS
+/* File descriptors of the counters of a thread, `-1` for counters that could not be opened. The first one is the
+   group leader. */
+struct perf_counter_fds {
+    int m_fds[num_perf_counters];
+};
+
+LEAN_THREAD_PTR(perf_counter_fds, g_perf_counter_fds);
+
+static void close_perf_counters(void * p) {
+    perf_counter_fds * fds = static_cast<perf_counter_fds *>(p);
+    for (int fd : fds->m_fds)
+        if (fd >= 0) close(fd);
+    delete fds;
+    g_perf_counter_fds = nullptr;
+}
+
+static int open_perf_counter(uint64 config, int group_fd) {
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size           = sizeof(attr);
+    attr.type           = PERF_TYPE_HARDWARE;
+    attr.config         = config;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv     = 1;
+    attr.read_format    = PERF_FORMAT_GROUP;
+    // current thread, any CPU
+    return syscall(__NR_perf_event_open, &attr, 0, -1, group_fd, 0);
+}
+
+static perf_counter_fds * open_perf_counters() {
+    // `PERF_COUNT_HW_CACHE_MISSES` usually counts last-level cache misses
+    static uint64 const configs[num_perf_counters] = {
+        PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES
+    };
+    perf_counter_fds * fds = new perf_counter_fds;
+    for (unsigned i = 0; i < num_perf_counters; i++)
+        fds->m_fds[i] = i == 0 || fds->m_fds[0] >= 0 ? open_perf_counter(configs[i], i == 0 ? -1 : fds->m_fds[0]) : -1;
+    register_thread_finalizer(close_perf_counters, fds);
+    return fds;
+}
+
+perf_counter_values read_perf_counters() {
+    perf_counter_values r;
+    if (!perf_counters_enabled())
+        return r;
+    if (!g_perf_counter_fds)
+        g_perf_counter_fds = open_perf_counters();
+    perf_counter_fds const & fds = *g_perf_counter_fds;
+    if (fds.m_fds[0] < 0)
+        return r;
+    // `PERF_FORMAT_GROUP`: number of counters, followed by their values in the order they were opened
+    uint64 buf[1 + num_perf_counters];
+    if (read(fds.m_fds[0], buf, sizeof(buf)) < static_cast<ssize_t>(sizeof(uint64)))
+        return r;
+    unsigned j = 1;
+    for (unsigned i = 0; i < num_perf_counters && j <= buf[0]; i++)
+        if (fds.m_fds[i] >= 0)
+            r.m_values[i] = buf[j++];
+    return r;
+}
+#else
+perf_counter_values read_perf_counters() {
+    return perf_counter_values();
+}
+#endif
+
+void display_perf_counters(std::ostream & out, perf_counter_values const & v) {
+    bool any = false;
+    for (uint64 c : v.m_values)
+        any = any || c != 0;
+    if (!any)
+        return;
+    out << " (";
+    for (unsigned i = 0; i < num_perf_counters; i++) {
+        out << (i > 0 ? ", " : "") << perf_counter_name(i) << ": " << v.m_values[i];
+        if (i == perf_cycles && v.m_values[perf_cycles] != 0) {
+            std::ostringstream ipc;
+            ipc << std::fixed << std::setprecision(2) << static_cast<double>(v.m_values[perf_instructions]) / v.m_values[perf_cycles];
+            out << ", IPC: " << ipc.str();
+        }
+    }
+    out << ")";
+}
+}
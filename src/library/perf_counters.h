@@ -0,0 +1,37 @@
+/*
+Copyright (c) 2024 Lean FRO, LLC. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+*/
+#pragma once
+#include <iostream>
+#include "runtime/object.h"
+
+namespace lean {
+/* Hardware performance counters of the current thread, for `time_task`.
+
+   Once `enable_perf_counters` has been called, each thread opens a group of counters with `perf_event_open` on its
+   first call of `read_perf_counters`; they count user-space events of that thread only and are closed when the
+   thread finishes. Counters that cannot be opened (other platforms than Linux, `perf_event_paranoid`, virtual
+   machines without a PMU) read as zero. */
+enum perf_counter { perf_instructions, perf_cycles, perf_cache_misses, perf_branch_misses, num_perf_counters };
+
+struct perf_counter_values {
+    uint64 m_values[num_perf_counters] = {};
+    perf_counter_values & operator+=(perf_counter_values const & o) {
+        for (unsigned i = 0; i < num_perf_counters; i++) m_values[i] += o.m_values[i];
+        return *this;
+    }
+    perf_counter_values operator-(perf_counter_values const & o) const {
+        perf_counter_values r;
+        for (unsigned i = 0; i < num_perf_counters; i++) r.m_values[i] = m_values[i] - o.m_values[i];
+        return r;
+    }
+};
+
+LEAN_EXPORT void enable_perf_counters();
+LEAN_EXPORT bool perf_counters_enabled();
+LEAN_EXPORT perf_counter_values read_perf_counters();
+LEAN_EXPORT char const * perf_counter_name(unsigned i);
+/* Print the counters as ` (instructions: ..., IPC: ..., ...)`, or nothing if they are all zero. */
+LEAN_EXPORT void display_perf_counters(std::ostream & out, perf_counter_values const & v);
+}
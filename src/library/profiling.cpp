@@ -20,6 +20,11 @@ second_duration get_profiling_threshold(options const & opts) {
     return second_duration(ms);
 }
 
+extern "C" uint8_t lean_get_profiler_counters(obj_arg opts);
+bool get_profiler_counters(options const & opts) {
+    return lean_get_profiler_counters(opts.to_obj_arg());
+}
+
 void initialize_profiling() {
 }
 
@@ -14,6 +14,7 @@ using second_duration = std::chrono::duration<double>;
 
 LEAN_EXPORT bool get_profiler(options const &);
 LEAN_EXPORT second_duration get_profiling_threshold(options const &);
+LEAN_EXPORT bool get_profiler_counters(options const &);
 
 void initialize_profiling();
 void finalize_profiling();
@@ -6,27 +6,121 @@ Author: Sebastian Ullrich
 */
 #include <string>
 #include <map>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <unordered_map>
+#include <vector>
+#include "runtime/alloc.h"
+#include "runtime/io.h"
 #include "library/time_task.h"
 #include "kernel/trace.h"
 
 namespace lean {
 
 static std::map<std::string, second_duration> * g_cum_times;
+/* Exclusive performance counters per category, protected by `g_cum_times_mutex` */
+static std::map<std::string, perf_counter_values> * g_cum_counters;
 static mutex * g_cum_times_mutex;
 LEAN_THREAD_PTR(time_task, g_current_time_task);
 
+struct profile_json_entry {
+    second_duration m_time{0};
+    uint64_t        m_allocated{0};
+    uint64_t        m_heartbeats{0};
+    perf_counter_values m_counters;
+};
+
+struct profile_region {
+    thread::id          m_thread;
+    std::string         m_category;
+    name                m_decl;
+    uint64_t            m_start;
+    uint64_t            m_stop;
+    perf_counter_values m_counters;
+};
+
+static std::atomic<bool> g_profile_tracing(false);
+/* Protected by `g_cum_times_mutex` */
+static std::vector<profile_region> * g_profile_trace;
+
+static uint64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static std::atomic<bool> g_profile_json(false);
+/* Per declaration and category, protected by `g_cum_times_mutex` */
+static std::map<std::string, std::map<std::string, profile_json_entry>> * g_profile_json_entries;
+
+void enable_profile_json() {
+    g_profile_json = true;
+}
+
+static void write_json_string(std::ostream & out, std::string const & s) {
+    out << '"';
+    for (unsigned char c : s) {
+        if (c == '"' || c == '\\')
+            out << '\\' << c;
+        else if (c < 0x20)
+            out << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<unsigned>(c) << std::dec;
+        else
+            out << c;
+    }
+    out << '"';
+}
+
+void write_profile_json(std::ostream & out, name const & module) {
+    lock_guard<mutex> _(*g_cum_times_mutex);
+    for (auto const & d : *g_profile_json_entries) {
+        out << "{\"module\":";
+        write_json_string(out, module.to_string());
+        out << ",\"decl\":";
+        if (d.first.empty())
+            out << "null";
+        else
+            write_json_string(out, d.first);
+        out << ",\"categories\":{";
+        bool first = true;
+        for (auto const & c : d.second) {
+            if (!first)
+                out << ",";
+            first = false;
+            write_json_string(out, c.first);
+            out << ":{\"time\":" << c.second.m_time.count() << ",\"allocated\":" << c.second.m_allocated
+            << ",\"heartbeats\":" << c.second.m_heartbeats;
+            if (perf_counters_enabled()) {
+                for (unsigned i = 0; i < num_perf_counters; i++) {
+                    out << ",";
+                    write_json_string(out, perf_counter_name(i));
+                    out << ":" << c.second.m_counters.m_values[i];
+                }
+            }
+            out << "}";
+        }
+        out << "}}\n";
+    }
+}
+
 void report_profiling_time(std::string const & category, second_duration time) {
     lock_guard<mutex> _(*g_cum_times_mutex);
     (*g_cum_times)[category] += time;
 }
 
 void display_cumulative_profiling_times(std::ostream & out) {
+    double mark_time = take_mark_time();
+    if (mark_time > 0)
+        report_profiling_time("marking shared objects", second_duration(mark_time));
     if (g_cum_times->empty())
         return;
     sstream ss;
-    ss << "cumulative profiling times:\n";
-    for (auto const & p : *g_cum_times)
-        ss << "\t" << p.first << " " << display_profiling_time{p.second} << "\n";
+    out << "cumulative profiling times:\n";
+    for (auto const & p : *g_cum_times) {
+        out << "\t" << p.first << " " << display_profiling_time{p.second};
+        auto it = g_cum_counters->find(p.first);
+        if (it != g_cum_counters->end())
+            display_perf_counters(out, it->second);
+        out << "\n";
+    }
     // output atomically, like IO.print
     out << ss.str();
 }
@@ -34,26 +128,45 @@ void display_cumulative_profiling_times(std::ostream & out) {
 void initialize_time_task() {
     g_cum_times_mutex = new mutex;
     g_cum_times = new std::map<std::string, second_duration>;
+    g_cum_counters = new std::map<std::string, perf_counter_values>;
+    g_profile_trace = new std::vector<profile_region>;
+    g_profile_json_entries = new std::map<std::string, std::map<std::string, profile_json_entry>>;
 }
 
 void finalize_time_task() {
+    delete g_profile_trace;
+    delete g_cum_counters;
+    delete g_profile_json_entries;
     delete g_cum_times;
     delete g_cum_times_mutex;
 }
 
 time_task::time_task(std::string const & category, options const & opts, name decl) :
         m_category(category) {
-    if (get_profiler(opts)) {
-        m_timeit = optional<xtimeit>(get_profiling_threshold(opts), [=](second_duration duration) mutable {
-            sstream ss;
-            ss << m_category;
-            if (decl)
-                ss << " of " << decl;
-            ss << " took " << display_profiling_time{duration} << "\n";
-            // output atomically, like IO.print
-            tout() << ss.str();
-        });
+    m_report = get_profiler(opts);
+    if (get_profiler_counters(opts))
+        enable_perf_counters();
+    if (m_report || g_profile_json || g_profile_tracing) {
+        if (m_report) {
+            enable_mark_profiling();
+            m_timeit = optional<xtimeit>(get_profiling_threshold(opts), [=](second_duration duration) mutable {
+                sstream ss;
+                ss << m_category;
+                if (decl)
+                    ss << " of " << decl;
+                ss << " took " << display_profiling_time{duration} << "\n";
+                // output atomically, like IO.print
+                tout() << ss.str();
+            });
+        } else {
+            m_timeit = optional<xtimeit>(std::function<void(second_duration)>());
+        }
         m_parent_task = g_current_time_task;
+        m_profile_decl = m_parent_task ? m_parent_task->m_profile_decl : decl;
+        m_start_allocated  = get_allocated_bytes();
+        m_start_heartbeats = get_num_heartbeats();
+        m_start_ns         = g_profile_tracing ? now_ns() : 0;
+        m_start_counters   = read_perf_counters();
         g_current_time_task = this;
     }
 }
@@ -61,11 +174,74 @@ time_task::time_task(std::string const & category, options const & opts, name de
 time_task::~time_task() {
     if (m_timeit) {
         g_current_time_task = m_parent_task;
-        report_profiling_time(m_category, m_timeit->get_elapsed());
-        if (m_parent_task && m_parent_task->m_timeit)
+        if (m_report)
+            report_profiling_time(m_category, m_timeit->get_elapsed());
+        uint64_t allocated  = get_allocated_bytes() - m_start_allocated;
+        uint64_t heartbeats = get_num_heartbeats() - m_start_heartbeats;
+        perf_counter_values counters = read_perf_counters() - m_start_counters;
+        if (m_report && perf_counters_enabled()) {
+            lock_guard<mutex> _(*g_cum_times_mutex);
+            (*g_cum_counters)[m_category] += counters - m_excluded_counters;
+        }
+        if (g_profile_json) {
+            lock_guard<mutex> _(*g_cum_times_mutex);
+            profile_json_entry & e = (*g_profile_json_entries)[m_profile_decl ? m_profile_decl.to_string() : std::string()][m_category];
+            e.m_time       += m_timeit->get_elapsed();
+            e.m_allocated  += allocated - m_excluded_allocated;
+            e.m_heartbeats += heartbeats - m_excluded_heartbeats;
+            e.m_counters   += counters - m_excluded_counters;
+        }
+        if (m_start_ns && g_profile_tracing) {
+            lock_guard<mutex> _(*g_cum_times_mutex);
+            g_profile_trace->push_back({this_thread::get_id(), m_category, m_profile_decl, m_start_ns, now_ns(), counters});
+        }
+        if (m_parent_task && m_parent_task->m_timeit) {
             // report exclusive times
             m_parent_task->m_timeit->exclude_duration(m_timeit->get_elapsed_inclusive());
+            m_parent_task->m_excluded_allocated  += allocated;
+            m_parent_task->m_excluded_heartbeats += heartbeats;
+            m_parent_task->m_excluded_counters   += counters;
+        }
+    }
+}
+
+void start_profile_tracing() {
+    lock_guard<mutex> _(*g_cum_times_mutex);
+    g_profile_trace->clear();
+    g_profile_tracing = true;
+}
+
+/* Lean.startProfileTracing : BaseIO Unit */
+extern "C" LEAN_EXPORT obj_res lean_start_profile_tracing(obj_arg /* w */) {
+    start_profile_tracing();
+    return io_result_mk_ok(box(0));
+}
+
+/* Lean.stopProfileTracing : BaseIO (Array ProfiledRegion) */
+extern "C" LEAN_EXPORT obj_res lean_stop_profile_tracing(obj_arg /* w */) {
+    std::vector<profile_region> trace;
+    {
+        lock_guard<mutex> _(*g_cum_times_mutex);
+        g_profile_tracing = false;
+        trace.swap(*g_profile_trace);
+    }
+    std::unordered_map<thread::id, unsigned> threads;
+    object * r = array_mk_empty();
+    for (profile_region const & e : trace) {
+        unsigned thread = threads.emplace(e.m_thread, threads.size()).first->second;
+        object * counters = array_mk_empty();
+        for (uint64 c : e.m_counters.m_values)
+            counters = array_push(counters, box_uint64(c));
+        object * o = alloc_cnstr(0, 4, 2 * sizeof(uint64));
+        cnstr_set(o, 0, usize_to_nat(thread));
+        cnstr_set(o, 1, mk_string(e.m_category));
+        cnstr_set(o, 2, e.m_decl.to_obj_arg());
+        cnstr_set(o, 3, counters);
+        cnstr_set_uint64(o, 4 * sizeof(object *), e.m_start);
+        cnstr_set_uint64(o, 4 * sizeof(object *) + sizeof(uint64), e.m_stop);
+        r = array_push(r, o);
     }
+    return io_result_mk_ok(r);
 }
 
 /* profileit {α : Type} (category : String) (opts : Options) (fn : Unit → α) (decl : Name) : α */
@@ -7,18 +7,37 @@ Author: Sebastian Ullrich
 #pragma once
 #include <string>
 #include "library/profiling.h"
+#include "library/perf_counters.h"
 #include "util/timeit.h"
 #include "util/message_definitions.h"
 
 namespace lean {
 LEAN_EXPORT void report_profiling_time(std::string const & category, second_duration time);
 LEAN_EXPORT void display_cumulative_profiling_times(std::ostream & out);
+/** Record the time, allocations and heartbeats of every `time_task` per declaration, independently of the
+    `profiler` option, for `write_profile_json`. */
+LEAN_EXPORT void enable_profile_json();
+/** Write the records collected since `enable_profile_json`, one JSON object per declaration and line. */
+LEAN_EXPORT void write_profile_json(std::ostream & out, name const & module);
+/** Record every `time_task` with its inclusive time and hardware performance counters, for `Lean.stopProfileTracing`. */
+LEAN_EXPORT void start_profile_tracing();
 
 /** Measure time of some task and report it for the final cumulative profile. */
 class LEAN_EXPORT time_task {
     std::string     m_category;
     optional<xtimeit> m_timeit;
     time_task *     m_parent_task;
+    bool            m_report;
+    /* Declaration the task is attributed to in `write_profile_json`: the one of the outermost task of the thread. */
+    name            m_profile_decl;
+    uint64_t        m_start_allocated;
+    uint64_t        m_start_heartbeats;
+    uint64_t        m_start_ns;
+    perf_counter_values m_start_counters;
+    /* Allocations, heartbeats and performance counters of nested tasks, excluded like their durations. */
+    uint64_t        m_excluded_allocated{0};
+    uint64_t        m_excluded_heartbeats{0};
+    perf_counter_values m_excluded_counters;
 public:
     time_task(std::string const & category, options const & opts, name decl = name());
     ~time_task();
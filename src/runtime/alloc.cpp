@@ -5,10 +5,24 @@ Released under Apache 2.0 license as described in the file LICENSE.
 Author: Leonardo de Moura
 */
 #include <vector>
+#include <cstdlib>
+#include <cstring>
 #include <lean/lean.h>
 #include "runtime/thread.h"
 #include "runtime/debug.h"
 #include "runtime/alloc.h"
+#include "runtime/int64.h"
+#include "runtime/allocprof.h"
+
+#if defined(LEAN_WINDOWS)
+#include <windows.h>
+#elif !defined(LEAN_EMSCRIPTEN)
+#include <sys/mman.h>
+#endif
+#if defined(__linux__)
+#include <unistd.h>
+#include <sys/syscall.h>
+#endif
 
 #ifdef LEAN_RUNTIME_STATS
 #define LEAN_RUNTIME_STAT_CODE(c) c
@@ -26,6 +40,13 @@ Author: Leonardo de Moura
 #define LEAN_SEGMENT_SIZE          8*1024*1024 // 8 Mb
 #define LEAN_NUM_SLOTS             (LEAN_MAX_SMALL_OBJECT_SIZE / LEAN_OBJECT_SIZE_DELTA)
 #define LEAN_MAX_TO_EXPORT_OBJS    1024
+// default number of empty segments per heap kept committed, see `LEAN_SEGMENT_RETENTION`
+#define LEAN_DEFAULT_SEGMENT_RETENTION 1
+#define LEAN_HUGE_PAGE_SIZE        2*1024*1024 // 2 Mb
+// while the heap profiler is disabled, each heap checks every this many allocations whether it has been enabled
+#define LEAN_HEAP_PROFILE_POLL     65536
+// maximal number of pages of a region, further allocations in the region are served by the heap
+#define LEAN_MAX_REGION_PAGES      (256*1024*1024 / LEAN_PAGE_SIZE)
 
 LEAN_CASSERT(LEAN_PAGE_SIZE > LEAN_MAX_SMALL_OBJECT_SIZE);
 LEAN_CASSERT(LEAN_SEGMENT_SIZE > LEAN_PAGE_SIZE);
@@ -43,7 +64,14 @@ static atomic<uint64> g_num_small_dealloc(0);
 static atomic<uint64> g_num_segments(0);
 static atomic<uint64> g_num_pages(0);
 static atomic<uint64> g_num_exports(0);
+static atomic<uint64> g_num_exported_objs(0);
+static atomic<uint64> g_num_imports(0);
+static atomic<uint64> g_num_imported_objs(0);
 static atomic<uint64> g_num_recycled_pages(0);
+static atomic<uint64> g_num_empty_pages(0);
+static atomic<uint64> g_num_reused_pages(0);
+static atomic<uint64> g_num_empty_segments(0);
+static atomic<uint64> g_num_decommits(0);
 struct alloc_stats {
     ~alloc_stats() {
         std::cerr << "num. alloc.:         " << g_num_alloc << "\n";
@@ -53,16 +81,37 @@ struct alloc_stats {
         std::cerr << "num. segments:       " << g_num_segments << "\n";
         std::cerr << "num. pages:          " << g_num_pages << "\n";
         std::cerr << "num. recycled pages: " << g_num_recycled_pages << "\n";
+        std::cerr << "num. empty pages:    " << g_num_empty_pages << "\n";
+        std::cerr << "num. reused pages:   " << g_num_reused_pages << "\n";
+        std::cerr << "num. empty segments: " << g_num_empty_segments << "\n";
+        std::cerr << "num. decommits:      " << g_num_decommits << "\n";
         std::cerr << "num. exports:        " << g_num_exports << "\n";
+        std::cerr << "num. exported objs:  " << g_num_exported_objs << "\n";
+        std::cerr << "num. imports:        " << g_num_imports << "\n";
+        std::cerr << "num. imported objs:  " << g_num_imported_objs << "\n";
     }
 };
 static alloc_stats g_alloc_stats;
 #endif
 
+/* Bytes of segment memory currently returned to the OS, see `heap::release_segment`. */
+static atomic<size_t> g_decommitted_bytes(0);
+/* Number of empty segments per heap that are kept committed for fast reuse. */
+static unsigned g_segment_retention = LEAN_DEFAULT_SEGMENT_RETENTION;
+
+/* How segment memory is obtained, see `LEAN_SEGMENT_HUGE_PAGES`. */
+enum class segment_mode { Default, TransparentHugePages, HugeTLB };
+static segment_mode g_segment_mode = segment_mode::Default;
+/* If true, segments are bound to the NUMA node the owning heap was created on, see `LEAN_SEGMENT_NUMA`. */
+static bool g_segment_numa = false;
+
 struct heap;
 struct page;
+struct segment;
+struct region;
 struct page_header {
     atomic<heap *>   m_heap;
+    segment *        m_segment;
     page *           m_next;
     page *           m_prev;
     void *           m_free_list;
@@ -71,6 +120,12 @@ struct page_header {
     unsigned         m_num_free;
     unsigned         m_slot_idx;
     bool             m_in_page_free_list;
+    /* True if all objects are free and the page is in `heap::m_empty_pages`, ready to be reused for any slot. */
+    bool             m_empty;
+    /* Number of live objects in this page recorded by the heap profiler */
+    atomic<unsigned> m_num_samples;
+    /* Region the page belongs to, see `begin_region`. Objects in region pages are not freed individually. */
+    region *         m_region;
 };
 
 struct page {
@@ -84,6 +139,7 @@ struct page {
     heap * get_heap() { return m_header.m_heap; }
     bool has_many_free() const { return m_header.m_num_free > m_header.m_max_free / 4; }
     bool in_page_free_list() const { return m_header.m_in_page_free_list; }
+    bool is_empty() const { return m_header.m_num_free == m_header.m_max_free; }
     unsigned get_slot_idx() const { return m_header.m_slot_idx; }
     void push_free_obj(void * o);
 };
@@ -95,6 +151,10 @@ inline char * align_ptr(char * p, size_t a) {
 struct segment {
     segment *    m_next{nullptr};
     char *       m_next_page_mem;
+    /* Number of pages carved out of `m_data` so far, and how many of them are currently empty. */
+    unsigned     m_num_pages{0};
+    unsigned     m_num_empty_pages{0};
+    bool         m_decommitted{false};
     char         m_data[LEAN_SEGMENT_SIZE];
 
     char * get_first_page_mem() {
@@ -110,24 +170,86 @@ struct segment {
     bool is_full() const {
         return m_next_page_mem + LEAN_PAGE_SIZE > m_data + LEAN_SEGMENT_SIZE;
     }
+
+    void reset() {
+        m_next_page_mem   = get_first_page_mem();
+        m_num_pages       = 0;
+        m_num_empty_pages = 0;
+    }
+
+    /* Returns the memory of all pages to the OS; the address range stays reserved for reuse. */
+    void decommit() {
+        char * begin = get_first_page_mem();
+        size_t sz    = m_next_page_mem - begin;
+        if (sz == 0 || m_decommitted)
+            return;
+#if defined(LEAN_WINDOWS)
+        // the segment is part of a larger allocation, so we cannot use `MEM_DECOMMIT`;
+        // unlocking pages that are not locked removes them from the working set
+        VirtualAlloc(begin, sz, MEM_RESET, PAGE_READWRITE);
+        VirtualUnlock(begin, sz);
+#elif !defined(LEAN_EMSCRIPTEN)
+        madvise(begin, sz, MADV_DONTNEED);
+#endif
+        m_decommitted = true;
+        g_decommitted_bytes += sz;
+        LEAN_RUNTIME_STAT_CODE(g_num_decommits++);
+    }
+
+    void recommit() {
+        if (m_decommitted) {
+            g_decommitted_bytes -= m_next_page_mem - get_first_page_mem();
+            m_decommitted = false;
+        }
+    }
 };
 
+/* A region is a bump allocator for the small objects allocated by one thread, which releases all of
+   its pages at once. Each page holds objects of a single size, so that `lean_small_mem_size` still works. */
+struct region {
+    region *  m_parent{nullptr};
+    /* Pages of the region, linked by `m_next` */
+    page *    m_pages{nullptr};
+    unsigned  m_num_pages{0};
+    /* Page we are currently allocating from for each slot, its `m_free_list` is the next free byte. */
+    page *    m_curr_page[LEAN_NUM_SLOTS] = {};
+};
+
+/* Owner of the pages of abandoned regions, see `abandon_region`. */
+static region g_abandoned_region;
+
 struct heap {
     segment * m_curr_segment{nullptr};
+    /* Pages without any live objects, see `page::m_empty`. */
+    page *    m_empty_pages{nullptr};
+    /* Segments without any live objects, the first `g_segment_retention` ones are still committed. */
+    segment * m_free_segments{nullptr};
+    unsigned  m_num_free_segments{0};
     heap *    m_next_orphan{nullptr};
     page *    m_curr_page[LEAN_NUM_SLOTS];
     page *    m_page_free_list[LEAN_NUM_SLOTS];
     /* Objects that must be sent to other heaps. */
     void *    m_to_export_list{nullptr};
     unsigned  m_to_export_list_size{0};
-    mutex     m_mutex; /* for the following fields */
     /* The following list contains object by this heap that were deallocated
-       by other heaps. */
-    void *    m_to_import_list{nullptr};
+       by other heaps. It is a lock-free multi-producer single-consumer stack:
+       other heaps push whole batches using compare-and-swap, and the owner
+       takes all of them at once in `import_objs`. */
+    atomic<void *> m_to_import_list{nullptr};
     uint64_t  m_heartbeat{0}; /* Counter for implementing "deterministic timeouts". It is currently the number of small allocations */
+    uint64_t  m_allocated_bytes{0}; /* Total size of the objects allocated by the thread, see `get_allocated_bytes` */
+    int       m_numa_node{-1}; /* Preferred NUMA node for new segments, `-1` if unknown */
+    unsigned  m_sample_countdown{LEAN_HEAP_PROFILE_POLL}; /* Allocations until the next heap profiler sample */
+    uint64_t  m_sample_seed{0x853c49e6748fea9bull};
+    /* Innermost region of the thread, and whether allocations in regions are currently suspended. */
+    region *  m_region{nullptr};
+    unsigned  m_region_suspended{0};
     void import_objs();
     void export_objs();
     void alloc_segment();
+    void add_empty_page(page * p);
+    void insert_empty_page(page * p);
+    void release_segment(segment * s);
 };
 
 struct heap_manager {
@@ -175,6 +297,7 @@ static inline void page_list_insert(page * & head, page * new_head) {
     if (head)
         head->set_prev(new_head);
     new_head->set_next(head);
+    new_head->set_prev(nullptr);
     head = new_head;
 }
 
@@ -182,6 +305,9 @@ static inline void page_list_remove(page * & head, page * to_remove) {
     if (head == to_remove) {
         /* First element */
         head = to_remove->get_next();
+        if (head)
+            head->set_prev(nullptr);
+        return;
     }
     page * prev = to_remove->get_prev();
     lean_assert(prev);
@@ -216,16 +342,50 @@ void page::push_free_obj(void * o) {
             page_list_insert(h->m_page_free_list[slot_idx], this);
         }
     }
+    if (LEAN_UNLIKELY(is_empty()) && in_page_free_list()) {
+        get_heap()->add_empty_page(this);
+    }
 }
 
-void heap::import_objs() {
-    void * to_import = nullptr;
-    {   // TODO(Leo): avoid mutex using compare and swap
-        lock_guard<mutex> lock(m_mutex);
-        to_import = m_to_import_list;
-        m_to_import_list = nullptr;
+LEAN_NOINLINE
+void heap::add_empty_page(page * p) {
+    LEAN_RUNTIME_STAT_CODE(g_num_empty_pages++);
+    page_list_remove(m_page_free_list[p->get_slot_idx()], p);
+    p->m_header.m_in_page_free_list = false;
+    insert_empty_page(p);
+}
+
+void heap::insert_empty_page(page * p) {
+    p->m_header.m_empty = true;
+    page_list_insert(m_empty_pages, p);
+    segment * s = p->m_header.m_segment;
+    s->m_num_empty_pages++;
+    if (s->m_num_empty_pages == s->m_num_pages && s != m_curr_segment)
+        release_segment(s);
+}
+
+/* `s` does not contain any live objects anymore */
+void heap::release_segment(segment * s) {
+    LEAN_RUNTIME_STAT_CODE(g_num_empty_segments++);
+    for (char * it = s->get_first_page_mem(); it < s->m_next_page_mem; it += LEAN_PAGE_SIZE) {
+        page * p = reinterpret_cast<page*>(it);
+        lean_assert(p->m_header.m_empty);
+        page_list_remove(m_empty_pages, p);
     }
+    if (m_num_free_segments >= g_segment_retention)
+        s->decommit();
+    s->m_next = m_free_segments;
+    m_free_segments = s;
+    m_num_free_segments++;
+}
+
+void heap::import_objs() {
+    if (m_to_import_list.load(memory_order_relaxed) == nullptr)
+        return;
+    void * to_import = m_to_import_list.exchange(nullptr, memory_order_acquire);
+    LEAN_RUNTIME_STAT_CODE(g_num_imports++);
     while (to_import) {
+        LEAN_RUNTIME_STAT_CODE(g_num_imported_objs++);
         page * p = get_page_of(to_import);
         void * n = get_next_obj(to_import);
         p->push_free_obj(to_import);
@@ -260,34 +420,142 @@ void heap::export_objs() {
         }
         o = n;
     }
+    LEAN_RUNTIME_STAT_CODE(g_num_exported_objs += m_to_export_list_size);
     m_to_export_list      = nullptr;
     m_to_export_list_size = 0;
     for (export_entry const & e : to_export) {
-        unique_lock<mutex> lock(e.m_heap->m_mutex);
-        set_next_obj(e.m_tail, e.m_heap->m_to_import_list);
-        e.m_heap->m_to_import_list = e.m_head;
+        atomic<void *> & import_list = e.m_heap->m_to_import_list;
+        void * head = import_list.load(memory_order_relaxed);
+        do {
+            set_next_obj(e.m_tail, head);
+        } while (!import_list.compare_exchange_weak(head, e.m_head, memory_order_release, memory_order_relaxed));
+    }
+}
+
+#if defined(__linux__)
+static void bind_to_numa_node(void * mem, size_t sz, int node) {
+#if defined(SYS_mbind)
+    // `MPOL_PREFERRED` from <numaif.h>, which we use directly to avoid a dependency on libnuma
+    const int mpol_preferred = 1;
+    unsigned long nodemask[1024 / (8 * sizeof(unsigned long))] = {};
+    if (node < 0 || node >= 1024)
+        return;
+    nodemask[node / (8 * sizeof(unsigned long))] |= 1ul << (node % (8 * sizeof(unsigned long)));
+    syscall(SYS_mbind, mem, sz, mpol_preferred, nodemask, 1024, 0);
+#endif
+}
+
+static int get_current_numa_node() {
+#if defined(SYS_getcpu)
+    unsigned cpu, node;
+    if (syscall(SYS_getcpu, &cpu, &node, nullptr) == 0)
+        return static_cast<int>(node);
+#endif
+    return -1;
+}
+
+/* Allocates a segment aligned to `LEAN_HUGE_PAGE_SIZE` so that its pages are backed by huge pages, either
+   transparently or from the hugetlbfs pool. Returns `nullptr` on failure. */
+static void * alloc_huge_segment_memory(int numa_node) {
+    size_t sz = lean_align(sizeof(segment), LEAN_HUGE_PAGE_SIZE);
+    void * mem = MAP_FAILED;
+#if defined(MAP_HUGETLB)
+    if (g_segment_mode == segment_mode::HugeTLB)
+        mem = mmap(nullptr, sz, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+    if (mem == MAP_FAILED) {
+        // over-allocate and trim to get an aligned region
+        size_t total = sz + LEAN_HUGE_PAGE_SIZE;
+        char * raw = static_cast<char *>(mmap(nullptr, total, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+        if (raw == MAP_FAILED)
+            return nullptr;
+        char * aligned = align_ptr(raw, LEAN_HUGE_PAGE_SIZE);
+        if (aligned != raw)
+            munmap(raw, aligned - raw);
+        if (aligned + sz != raw + total)
+            munmap(aligned + sz, (raw + total) - (aligned + sz));
+        mem = aligned;
+#if defined(MADV_HUGEPAGE)
+        madvise(mem, sz, MADV_HUGEPAGE);
+#endif
     }
+    if (g_segment_numa)
+        bind_to_numa_node(mem, sz, numa_node);
+    return mem;
+}
+#endif
+
+static segment * new_segment(heap * h) {
+#if defined(__linux__)
+    if (g_segment_mode != segment_mode::Default) {
+        if (void * mem = alloc_huge_segment_memory(h->m_numa_node))
+            return new (mem) segment();
+    }
+    if (g_segment_numa) {
+        segment * s = new segment();
+        // only the pages are bound, the remainder of the allocation may be shared with other objects
+        bind_to_numa_node(s->get_first_page_mem(), LEAN_SEGMENT_SIZE - LEAN_PAGE_SIZE, h->m_numa_node);
+        return s;
+    }
+#else
+    (void)h;
+#endif
+    return new segment();
 }
 
 void heap::alloc_segment() {
-    LEAN_RUNTIME_STAT_CODE(g_num_segments++);
-    segment * s = new segment();
+    segment * s;
+    if (m_free_segments) {
+        s = m_free_segments;
+        m_free_segments = s->m_next;
+        m_num_free_segments--;
+        s->recommit();
+        s->reset();
+    } else {
+        LEAN_RUNTIME_STAT_CODE(g_num_segments++);
+        s = new_segment(this);
+    }
     s->m_next   = m_curr_segment;
     m_curr_segment = s;
 }
 
+/* Take an empty page of `h`, or carve a new one out of its current segment. */
+static page * take_page(heap * h) {
+    page * p;
+    segment * s;
+    if (h->m_empty_pages) {
+        /* reuse an empty page, possibly of a different slot */
+        LEAN_RUNTIME_STAT_CODE(g_num_reused_pages++);
+        p = page_list_pop(h->m_empty_pages);
+        if (h->m_empty_pages)
+            h->m_empty_pages->set_prev(nullptr);
+        s = p->m_header.m_segment;
+        lean_assert(s->m_num_empty_pages > 0);
+        s->m_num_empty_pages--;
+        p = new (p) page();
+    } else {
+        s = h->m_curr_segment;
+        LEAN_RUNTIME_STAT_CODE(g_num_pages++);
+        p = new (s->m_next_page_mem) page();
+        s->m_next_page_mem += LEAN_PAGE_SIZE;
+        s->m_num_pages++;
+        if (s->is_full()) {
+            /* s is full, we need to allocate a new one. */
+            h->alloc_segment();
+        }
+    }
+    p->m_header.m_heap       = h;
+    p->m_header.m_segment    = s;
+    p->m_header.m_empty      = false;
+    p->m_header.m_region     = nullptr;
+    p->m_header.m_num_samples.store(0, memory_order_relaxed);
+    return p;
+}
+
 static page * alloc_page(heap * h, unsigned obj_size) {
     lean_assert(lean_align(obj_size, LEAN_OBJECT_SIZE_DELTA) == obj_size);
-    segment * s = h->m_curr_segment;
-    LEAN_RUNTIME_STAT_CODE(g_num_pages++);
-    page * p    = new (s->m_next_page_mem) page();
-    s->m_next_page_mem += LEAN_PAGE_SIZE;
-    if (s->is_full()) {
-        /* s is full, we need to allocate a new one. */
-        h->alloc_segment();
-    }
+    page * p                 = take_page(h);
     unsigned slot_idx        = lean_get_slot_idx(obj_size);
-    p->m_header.m_heap       = h;
     page_list_insert(h->m_curr_page[slot_idx], p);
     p->m_header.m_slot_idx   = slot_idx;
     p->m_header.m_obj_size   = obj_size;
@@ -336,6 +604,10 @@ static void init_heap(bool main) {
         g_heap = h;
     } else {
         g_heap = new heap();
+#if defined(__linux__)
+        if (g_segment_numa)
+            g_heap->m_numa_node = get_current_numa_node();
+#endif
         g_curr_pages = g_heap->m_curr_page;
         for (unsigned i = 0; i < LEAN_NUM_SLOTS; i++) {
             g_heap->m_curr_page[i] = nullptr;
@@ -381,9 +653,79 @@ void * lean_alloc_small_cold(unsigned sz, unsigned slot_idx, page * p) {
     return r;
 }
 
-extern "C" LEAN_EXPORT void * lean_alloc_small(unsigned sz, unsigned slot_idx) {
+static unsigned next_sample_countdown(heap * h) {
+    size_t rate = get_heap_profile_rate();
+    if (rate == 0)
+        return LEAN_HEAP_PROFILE_POLL;
+    if (rate > (1u << 30))
+        rate = 1u << 30;
+    // randomize the distance between samples to avoid aliasing with periodic allocation patterns
+    h->m_sample_seed = h->m_sample_seed * 6364136223846793005ull + 1442695040888963407ull;
+    return 1 + static_cast<unsigned>((h->m_sample_seed >> 33) % (2 * rate));
+}
+
+/* Big objects are sampled as well, we only need to check their deallocations while some are live */
+static atomic<size_t> g_num_big_samples(0);
+
+LEAN_NOINLINE
+static void * lean_alloc_small_sampled(unsigned sz, unsigned slot_idx) {
+    bool sample = get_heap_profile_rate() > 0;
+    g_heap->m_sample_countdown = next_sample_countdown(g_heap);
+    page * p = g_heap->m_curr_page[slot_idx];
+    void * r = p->m_header.m_free_list;
+    if (r == nullptr) {
+        r = lean_alloc_small_cold(sz, slot_idx, p);
+    } else {
+        p->m_header.m_free_list = get_next_obj(r);
+        p->m_header.m_num_free--;
+    }
+    if (sample) {
+        get_page_of(r)->m_header.m_num_samples++;
+        heap_profile_alloc(r, sz);
+    }
+    return r;
+}
+
+/* Allocate in the innermost region, or return `nullptr` if allocations in regions are suspended
+   or the region is full. */
+LEAN_NOINLINE
+static void * alloc_in_region(unsigned sz, unsigned slot_idx) {
+    heap * h   = g_heap;
+    region * r = h->m_region;
+    if (h->m_region_suspended > 0)
+        return nullptr;
+    if (page * p = r->m_curr_page[slot_idx]) {
+        char * o = static_cast<char *>(p->m_header.m_free_list);
+        if (o + sz <= reinterpret_cast<char *>(p) + LEAN_PAGE_SIZE) {
+            p->m_header.m_free_list = o + sz;
+            return o;
+        }
+    }
+    if (r->m_num_pages >= LEAN_MAX_REGION_PAGES)
+        return nullptr;
+    page * p = take_page(h);
+    p->m_header.m_region    = r;
+    p->m_header.m_next      = r->m_pages;
+    p->m_header.m_prev      = nullptr;
+    p->m_header.m_slot_idx  = slot_idx;
+    p->m_header.m_obj_size  = sz;
+    p->m_header.m_max_free  = 0;
+    p->m_header.m_num_free  = 0;
+    p->m_header.m_in_page_free_list = false;
+    p->m_header.m_free_list = p->m_data + sz;
+    r->m_pages = p;
+    r->m_num_pages++;
+    r->m_curr_page[slot_idx] = p;
+    return p->m_data;
+}
+
+static inline void * alloc_small_core(unsigned sz, unsigned slot_idx) {
     page * p = g_heap->m_curr_page[slot_idx];
     g_heap->m_heartbeat++;
+    g_heap->m_allocated_bytes += sz;
+    if (LEAN_UNLIKELY(--g_heap->m_sample_countdown == 0)) {
+        return lean_alloc_small_sampled(sz, slot_idx);
+    }
     void * r = p->m_header.m_free_list;
     if (LEAN_UNLIKELY(r == nullptr)) {
         return lean_alloc_small_cold(sz, slot_idx, p);
@@ -394,18 +736,52 @@ extern "C" LEAN_EXPORT void * lean_alloc_small(unsigned sz, unsigned slot_idx) {
     return r;
 }
 
+extern "C" LEAN_EXPORT void * lean_alloc_small(unsigned sz, unsigned slot_idx) {
+    if (LEAN_UNLIKELY(g_heap->m_region != nullptr)) {
+        if (void * r = alloc_in_region(sz, slot_idx)) {
+            g_heap->m_heartbeat++;
+            g_heap->m_allocated_bytes += sz;
+            return r;
+        }
+    }
+    return alloc_small_core(sz, slot_idx);
+}
+
 void * alloc(size_t sz) {
     sz = lean_align(sz, LEAN_OBJECT_SIZE_DELTA);
     LEAN_RUNTIME_STAT_CODE(g_num_alloc++);
     if (LEAN_UNLIKELY(sz > LEAN_MAX_SMALL_OBJECT_SIZE)) {
         void * r = malloc(sz);
         if (r == nullptr) lean_internal_panic_out_of_memory();
+        if (g_heap) {
+            g_heap->m_allocated_bytes += sz;
+            if (LEAN_UNLIKELY(--g_heap->m_sample_countdown == 0)) {
+                bool sample = get_heap_profile_rate() > 0;
+                g_heap->m_sample_countdown = next_sample_countdown(g_heap);
+                if (sample) {
+                    g_num_big_samples++;
+                    heap_profile_alloc(r, sz);
+                }
+            }
+        }
         return r;
     }
     lean_assert(g_heap);
     LEAN_RUNTIME_STAT_CODE(g_num_small_alloc++);
     unsigned slot_idx = lean_get_slot_idx(sz);
-    return lean_alloc_small(sz, slot_idx);
+    return alloc_small_core(sz, slot_idx);
+}
+
+void * alloc_object(size_t sz) {
+    sz = lean_align(sz, LEAN_OBJECT_SIZE_DELTA);
+    if (sz <= LEAN_MAX_SMALL_OBJECT_SIZE && LEAN_UNLIKELY(g_heap->m_region != nullptr)) {
+        if (void * r = alloc_in_region(sz, lean_get_slot_idx(sz))) {
+            g_heap->m_heartbeat++;
+            g_heap->m_allocated_bytes += sz;
+            return r;
+        }
+    }
+    return alloc(sz);
 }
 
 LEAN_NOINLINE
@@ -426,6 +802,14 @@ static inline void dealloc_small_core(void * o) {
     }
     lean_assert(g_heap);
     page * p = get_page_of(o);
+    if (LEAN_UNLIKELY(p->m_header.m_region != nullptr)) {
+        /* released together with its region */
+        return;
+    }
+    if (LEAN_UNLIKELY(p->m_header.m_num_samples.load(memory_order_relaxed) > 0)) {
+        if (heap_profile_free(o))
+            p->m_header.m_num_samples--;
+    }
     if (LEAN_LIKELY(p->get_heap() == g_heap)) {
         p->push_free_obj(o);
     } else {
@@ -437,6 +821,10 @@ void dealloc(void * o, size_t sz) {
     LEAN_RUNTIME_STAT_CODE(g_num_dealloc++);
     sz = lean_align(sz, LEAN_OBJECT_SIZE_DELTA);
     if (LEAN_UNLIKELY(sz > LEAN_MAX_SMALL_OBJECT_SIZE)) {
+        if (LEAN_UNLIKELY(g_num_big_samples.load(memory_order_relaxed) > 0)) {
+            if (heap_profile_free(o))
+                g_num_big_samples--;
+        }
         return free(o);
     }
     dealloc_small_core(o);
@@ -451,10 +839,102 @@ extern "C" LEAN_EXPORT unsigned lean_small_mem_size(void * o) {
     return p->m_header.m_obj_size;
 }
 
+region * begin_region() {
+    if (LEAN_UNLIKELY(g_heap == nullptr)) {
+        init_heap(false);
+    }
+    region * r   = new region();
+    r->m_parent  = g_heap->m_region;
+    g_heap->m_region = r;
+    return r;
+}
+
+void end_region(region * r) {
+    lean_assert(g_heap->m_region == r);
+    g_heap->m_region = r->m_parent;
+}
+
+void free_region(region * r) {
+    lean_assert(g_heap->m_region != r);
+    page * p = r->m_pages;
+    while (p != nullptr) {
+        page * n = p->get_next();
+        lean_assert(p->get_heap() == g_heap);
+        p->m_header.m_region = nullptr;
+        g_heap->insert_empty_page(p);
+        p = n;
+    }
+    delete r;
+}
+
+void abandon_region(region * r) {
+    lean_assert(g_heap->m_region != r);
+    for (page * p = r->m_pages; p != nullptr; p = p->get_next())
+        p->m_header.m_region = &g_abandoned_region;
+    delete r;
+}
+
+bool in_region(void * o, region * r) {
+    return get_page_of(o)->m_header.m_region == r;
+}
+
+bool is_region_object(void * o) {
+    if (g_heap == nullptr || g_heap->m_region == nullptr)
+        return false;
+    region * r = get_page_of(o)->m_header.m_region;
+    return r != nullptr && r != &g_abandoned_region;
+}
+
+suspend_regions::suspend_regions() {
+    if (LEAN_UNLIKELY(g_heap == nullptr)) {
+        init_heap(false);
+    }
+    g_heap->m_region_suspended++;
+}
+
+suspend_regions::~suspend_regions() {
+    g_heap->m_region_suspended--;
+}
+
+#else
+
+region * begin_region() { return nullptr; }
+void end_region(region *) {}
+void free_region(region *) {}
+void abandon_region(region *) {}
+bool in_region(void *, region *) { return false; }
+bool is_region_object(void *) { return false; }
+suspend_regions::suspend_regions() {}
+suspend_regions::~suspend_regions() {}
+
+#endif
+
+size_t get_decommitted_memory() {
+#ifdef LEAN_SMALL_ALLOCATOR
+    return g_decommitted_bytes;
+#else
+    return 0;
 #endif
+}
 
 void initialize_alloc() {
 #ifdef LEAN_SMALL_ALLOCATOR
+#ifndef LEAN_EMSCRIPTEN
+    if (char const * retention = std::getenv("LEAN_SEGMENT_RETENTION")) {
+        g_segment_retention = atoi(retention);
+    }
+    /* `LEAN_SEGMENT_HUGE_PAGES=thp` aligns segments for transparent huge pages,
+       `LEAN_SEGMENT_HUGE_PAGES=hugetlb` takes them from the hugetlbfs pool if possible. */
+    if (char const * huge = std::getenv("LEAN_SEGMENT_HUGE_PAGES")) {
+        if (strcmp(huge, "thp") == 0)
+            g_segment_mode = segment_mode::TransparentHugePages;
+        else if (strcmp(huge, "hugetlb") == 0)
+            g_segment_mode = segment_mode::HugeTLB;
+    }
+    if (char const * numa = std::getenv("LEAN_SEGMENT_NUMA")) {
+        g_segment_numa = atoi(numa) != 0;
+    }
+#endif
     g_heap_manager = new heap_manager();
     init_heap(true);
 #endif
@@ -481,6 +961,14 @@ extern "C" LEAN_EXPORT void lean_inc_heartbeat() {
     add_heartbeats(1);
 }
 
+uint64_t get_allocated_bytes() {
+#ifdef LEAN_SMALL_ALLOCATOR
+    if (g_heap)
+        return g_heap->m_allocated_bytes;
+#endif
+    return 0;
+}
+
 uint64_t get_num_heartbeats() {
 #ifdef LEAN_SMALL_ALLOCATOR
     if (g_heap)
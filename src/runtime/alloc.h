@@ -13,8 +13,39 @@ namespace lean {
 void init_thread_heap();
 LEAN_EXPORT void * alloc(size_t sz);
 LEAN_EXPORT void dealloc(void * o, size_t sz);
+/** \brief Like `alloc`, but small objects are allocated in the innermost region of the thread if there is one. */
+LEAN_EXPORT void * alloc_object(size_t sz);
 LEAN_EXPORT void add_heartbeats(uint64_t count);
 LEAN_EXPORT uint64_t get_num_heartbeats();
+/** \brief Total size of the objects allocated by the current thread so far.
+    Always `0` if the small object allocator is disabled. */
+LEAN_EXPORT uint64_t get_allocated_bytes();
+/** \brief Number of bytes of empty small object segments that have been returned to the OS. */
+LEAN_EXPORT size_t get_decommitted_memory();
+
+namespace allocator { struct region; }
+using allocator::region;
+/** \brief Allocate the small objects of the current thread in a new region until `end_region` is invoked.
+    Freeing objects of a region is a no-op, the memory of all of them is released by `free_region`.
+    Return `nullptr` if the small object allocator is disabled. */
+LEAN_EXPORT region * begin_region();
+/** \brief Stop allocating in `r`, which must be the innermost region of the current thread. */
+LEAN_EXPORT void end_region(region * r);
+/** \brief Release the memory of the ended region `r`. Its objects must not be used anymore. */
+LEAN_EXPORT void free_region(region * r);
+/** \brief Keep the memory of the ended region `r` forever, for when some of its objects may still be in use. */
+LEAN_EXPORT void abandon_region(region * r);
+/** \brief Return true if the small heap object `o` was allocated in `r`. */
+LEAN_EXPORT bool in_region(void * o, region * r);
+/** \brief Return true if the small heap object `o` was allocated in a region of the current thread that has not been freed. */
+LEAN_EXPORT bool is_region_object(void * o);
+/** \brief While alive, small objects of the current thread are allocated in the heap even inside a region. */
+class LEAN_EXPORT suspend_regions {
+public:
+    suspend_regions();
+    ~suspend_regions();
+};
+
 void initialize_alloc();
 void finalize_alloc();
 }
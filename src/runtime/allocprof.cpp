@@ -4,7 +4,23 @@ Released under Apache 2.0 license as described in the file LICENSE.
 
 Author: Leonardo de Moura
 */
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <sstream>
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+#include <cstdlib>
 #include "runtime/allocprof.h"
+#include "runtime/thread.h"
+
+#ifdef __GLIBC__
+#include <execinfo.h>
+#endif
+
+#define LEAN_HEAP_PROFILE_MAX_DEPTH 32
+
 namespace lean {
 allocprof::allocprof(std::ostream & out, char const * msg):
     m_out(out), m_msg(msg) {
@@ -44,4 +60,164 @@ allocprof::~allocprof() {
     m_out << "Allocation profiling data is not available, compile lean using `-D RUNTIME_STATS=ON`\n";
 #endif
 }
+
+struct heap_sample {
+    size_t   m_size;
+    unsigned m_depth;
+    void *   m_stack[LEAN_HEAP_PROFILE_MAX_DEPTH];
+};
+
+static atomic<size_t>                              g_heap_profile_rate(0);
+static mutex *                                     g_heap_profile_mutex = nullptr;
+/* Sampled objects that have not been freed yet, protected by `g_heap_profile_mutex`. */
+static std::unordered_map<void *, heap_sample> *   g_heap_samples = nullptr;
+static uint64                                      g_heap_num_samples = 0;
+static uint64                                      g_heap_num_sampled_frees = 0;
+
+void set_heap_profile_rate(size_t rate) {
+    g_heap_profile_rate = rate;
+}
+
+size_t get_heap_profile_rate() {
+    return g_heap_profile_rate;
+}
+
+void heap_profile_alloc(void * o, size_t sz) {
+    if (!g_heap_profile_mutex)
+        return;
+    heap_sample s;
+    s.m_size  = sz;
+    s.m_depth = 0;
+#ifdef __GLIBC__
+    void * stack[LEAN_HEAP_PROFILE_MAX_DEPTH + 2];
+    int n = backtrace(stack, LEAN_HEAP_PROFILE_MAX_DEPTH + 2);
+    // skip `heap_profile_alloc` and the sampling path of the allocator
+    for (int i = 2; i < n; i++)
+        s.m_stack[s.m_depth++] = stack[i];
+#endif
+    lock_guard<mutex> lock(*g_heap_profile_mutex);
+    (*g_heap_samples)[o] = s;
+    g_heap_num_samples++;
+}
+
+bool heap_profile_free(void * o) {
+    if (!g_heap_profile_mutex)
+        return false;
+    lock_guard<mutex> lock(*g_heap_profile_mutex);
+    if (g_heap_samples->erase(o) > 0) {
+        g_heap_num_sampled_frees++;
+        return true;
+    }
+    return false;
+}
+
+/* Describes the kind of a live object from its header. */
+static std::string heap_object_kind(lean_object * o) {
+    std::ostringstream out;
+    uint8_t tag = lean_ptr_tag(o);
+    if (tag <= LeanMaxCtorTag) {
+        out << "constructor (tag " << static_cast<unsigned>(tag) << ", " << lean_ptr_other(o) << " fields)";
+        return out.str();
+    }
+    switch (tag) {
+    case LeanClosure:
+        out << "closure (arity " << lean_closure_arity(o) << ", " << lean_closure_num_fixed(o) << " fixed)";
+        return out.str();
+    case LeanArray:       return "array";
+    case LeanStructArray: return "struct array";
+    case LeanScalarArray: return "scalar array";
+    case LeanString:      return "string";
+    case LeanMPZ:         return "mpz";
+    case LeanThunk:       return "thunk";
+    case LeanTask:        return "task";
+    case LeanRef:         return "ref";
+    case LeanExternal:    return "external";
+    default:              return "other";
+    }
+}
+
+struct heap_profile_entry {
+    uint64 m_count{0};
+    uint64 m_bytes{0};
+    void add(size_t sz, size_t rate) { m_count += rate; m_bytes += rate * sz; }
+};
+
+static void heap_profile_print_table(std::ostream & out, char const * title,
+                                     std::vector<std::pair<std::string, heap_profile_entry>> entries) {
+    std::sort(entries.begin(), entries.end(), [](auto const & a, auto const & b) { return a.second.m_bytes > b.second.m_bytes; });
+    out << title << "\n";
+    for (auto const & e : entries) {
+        out << std::setw(14) << e.second.m_bytes << " bytes " << std::setw(10) << e.second.m_count << " objects  " << e.first << "\n";
+    }
+}
+
+std::string heap_profile_summary() {
+    std::ostringstream out;
+    size_t rate = g_heap_profile_rate;
+    if (!g_heap_profile_mutex) {
+        return "heap profiler is not available\n";
+    }
+    lock_guard<mutex> lock(*g_heap_profile_mutex);
+    std::map<std::string, heap_profile_entry> by_kind;
+    std::map<size_t, heap_profile_entry> by_size;
+    heap_profile_entry total;
+    size_t w = rate > 0 ? rate : 1;
+    for (auto const & s : *g_heap_samples) {
+        by_kind[heap_object_kind(static_cast<lean_object *>(s.first))].add(s.second.m_size, w);
+        by_size[s.second.m_size].add(s.second.m_size, w);
+        total.add(s.second.m_size, w);
+    }
+    out << "heap profile (sampling rate 1/" << rate << ", " << g_heap_num_samples << " samples, "
+        << g_heap_num_sampled_frees << " freed)\n";
+    out << "estimated live: " << total.m_bytes << " bytes, " << total.m_count << " objects\n";
+    heap_profile_print_table(out, "by object kind:", std::vector<std::pair<std::string, heap_profile_entry>>(by_kind.begin(), by_kind.end()));
+    std::vector<std::pair<std::string, heap_profile_entry>> sizes;
+    for (auto const & e : by_size)
+        sizes.emplace_back(std::to_string(e.first) + " bytes", e.second);
+    heap_profile_print_table(out, "by size class:", sizes);
+    return out.str();
+}
+
+bool heap_profile_dump(char const * fname) {
+    std::ofstream out(fname);
+    if (!out)
+        return false;
+    size_t rate = g_heap_profile_rate;
+    size_t w = rate > 0 ? rate : 1;
+    std::map<std::vector<void *>, heap_profile_entry> by_stack;
+    heap_profile_entry total;
+    if (g_heap_profile_mutex) {
+        lock_guard<mutex> lock(*g_heap_profile_mutex);
+        for (auto const & s : *g_heap_samples) {
+            std::vector<void *> stack(s.second.m_stack, s.second.m_stack + s.second.m_depth);
+            by_stack[stack].add(s.second.m_size, w);
+            total.add(s.second.m_size, w);
+        }
+    }
+    // legacy pprof heap profile format; every sample has already been scaled by the sampling rate
+    out << "heap profile: " << total.m_count << ": " << total.m_bytes << " [" << total.m_count << ": " << total.m_bytes << "] @ heapprofile\n";
+    for (auto const & e : by_stack) {
+        out << e.second.m_count << ": " << e.second.m_bytes << " [" << e.second.m_count << ": " << e.second.m_bytes << "] @";
+        for (void * addr : e.first)
+            out << " " << addr;
+        out << "\n";
+    }
+#if defined(__linux__)
+    out << "\nMAPPED_LIBRARIES:\n";
+    std::ifstream maps("/proc/self/maps");
+    out << maps.rdbuf();
+#endif
+    return static_cast<bool>(out);
+}
+
+void initialize_allocprof() {
+    g_heap_profile_mutex = new mutex();
+    g_heap_samples       = new std::unordered_map<void *, heap_sample>();
+    if (char const * rate = std::getenv("LEAN_HEAP_PROFILE_RATE")) {
+        g_heap_profile_rate = atoi(rate);
+    }
+}
+
+void finalize_allocprof() {
+}
 }
@@ -26,4 +26,21 @@ public:
     allocprof(std::ostream & out, char const * msg);
     ~allocprof();
 };
+
+/* Sampling heap profiler.
+
+   When the sampling rate is `n > 0` (`LEAN_HEAP_PROFILE_RATE` or `IO.setHeapProfileRate`), roughly every `n`-th
+   allocation of each thread is recorded together with its size and a backtrace of the allocation site. Sampled
+   objects are tracked until they are freed, so that the live set can be broken down by object kind and size
+   class (`heap_profile_summary`) or dumped in the legacy pprof heap profile format (`heap_profile_dump`).
+   Each sample stands for `n` allocations of the same size. */
+LEAN_EXPORT void set_heap_profile_rate(size_t rate);
+LEAN_EXPORT size_t get_heap_profile_rate();
+/* Hooks called by the allocator. `heap_profile_free` returns `true` iff `o` was a sampled object. */
+void heap_profile_alloc(void * o, size_t sz);
+bool heap_profile_free(void * o);
+LEAN_EXPORT std::string heap_profile_summary();
+LEAN_EXPORT bool heap_profile_dump(char const * fname);
+void initialize_allocprof();
+void finalize_allocprof();
 }
@@ -0,0 +1,53 @@
+/*
+Copyright (c) 2024 Lean FRO, LLC. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+*/
+#include <atomic>
+#include <iomanip>
+#include "runtime/cache_stats.h"
+#include "runtime/io.h"
+
+namespace lean {
+/* Each cache gets its own cache line, as they are updated from all elaboration threads. */
+struct alignas(64) cache_counters {
+    std::atomic<uint64> m_lookups{0};
+    std::atomic<uint64> m_hits{0};
+    std::atomic<uint64> m_nanos{0};
+};
+
+static cache_counters g_cache_stats[static_cast<unsigned>(cache_stat::num_stats)];
+
+static char const * g_cache_stat_names[] = {
+    "inferType", "whnf", "synthInstance", "DiscrTree", "instantiateMVars", "simp", "simpRewrite", "isDefEq"
+};
+
+void record_cache_stat(cache_stat s, bool hit, uint64 nanos) {
+    cache_counters & c = g_cache_stats[static_cast<unsigned>(s)];
+    c.m_lookups.fetch_add(1, std::memory_order_relaxed);
+    if (hit)
+        c.m_hits.fetch_add(1, std::memory_order_relaxed);
+    if (nanos)
+        c.m_nanos.fetch_add(nanos, std::memory_order_relaxed);
+}
+
+void display_cache_stats(std::ostream & out) {
+    out << "cache statistics (lookups, hits, misses, hit rate, time):\n";
+    for (unsigned i = 0; i < static_cast<unsigned>(cache_stat::num_stats); i++) {
+        cache_counters const & c = g_cache_stats[i];
+        uint64 lookups = c.m_lookups.load(std::memory_order_relaxed);
+        uint64 hits    = c.m_hits.load(std::memory_order_relaxed);
+        double rate    = lookups ? 100.0 * hits / lookups : 0.0;
+        out << "  " << std::left << std::setw(18) << g_cache_stat_names[i] << std::right
+            << std::setw(12) << lookups << std::setw(12) << hits << std::setw(12) << lookups - hits
+            << std::setw(8) << std::fixed << std::setprecision(1) << rate << "%"
+            << std::setw(10) << std::setprecision(3) << c.m_nanos.load(std::memory_order_relaxed) / 1e9 << "s\n";
+    }
+}
+
+/* CacheStat.record (stat : CacheStat) (hit : Bool) (nanos : UInt64) : BaseIO Unit */
+extern "C" LEAN_EXPORT obj_res lean_record_cache_stat(uint8 stat, uint8 hit, uint64 nanos, obj_arg /* w */) {
+    if (stat < static_cast<uint8>(cache_stat::num_stats))
+        record_cache_stat(static_cast<cache_stat>(stat), hit, nanos);
+    return io_result_mk_ok(box(0));
+}
+}
@@ -0,0 +1,26 @@
+/*
+Copyright (c) 2024 Lean FRO, LLC. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+*/
+#pragma once
+#include <iostream>
+#include "runtime/object.h"
+
+namespace lean {
+/* Counters of lookups in the caches of the elaborator, displayed by `lean --stats`.
+
+   For each cache we count the lookups, the hits, and the time spent on computing the results of misses, which
+   includes the time of nested lookups of the same cache.
+   `discr_tree` counts discrimination tree lookups, where a hit is a lookup with a nonempty result, and
+   `instantiate_mvars` counts calls of `lean_instantiate_expr_mvars`, where a hit is a call that did not change
+   the expression; for both, the time of all calls is counted. `simp_rewrite` counts attempts to rewrite with a simp
+   theorem, where a hit is a successful rewrite, and `is_def_eq` counts calls of `Meta.isExprDefEq`, where a hit is
+   a call returning `true`; for both, the time of all calls is counted as well. The counters are always enabled and
+   updated with relaxed atomic increments. Must be kept in sync with `Lean.CacheStat`. */
+enum class cache_stat : uint8 {
+    infer_type, whnf, synth_instance, discr_tree, instantiate_mvars, simp, simp_rewrite, is_def_eq, num_stats
+};
+
+LEAN_EXPORT void record_cache_stat(cache_stat s, bool hit, uint64 nanos);
+LEAN_EXPORT void display_cache_stats(std::ostream & out);
+}
@@ -0,0 +1,292 @@
+/*
+Copyright (c) 2024 Lean FRO, LLC. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+*/
+#include <atomic>
+#include <deque>
+#include <utility>
+#include <vector>
+#include <lean/lean.h>
+#include "runtime/channel.h"
+#include "runtime/io.h"
+#include "runtime/object.h"
+#include "runtime/thread.h"
+
+/* Log2 of the number of values a channel buffers without taking its lock. */
+#define LEAN_CHANNEL_RING_BITS 8
+
+namespace lean {
+extern "C" obj_res lean_io_promise_new(obj_arg);
+extern "C" obj_res lean_io_promise_resolve(obj_arg value, b_obj_arg promise, obj_arg);
+
+/*
+Multi-producer multi-consumer FIFO channel backing `IO.Channel`.
+
+Values are buffered in a bounded lock-free ring buffer (D. Vyukov's MPMC queue), so that `send` and
+`recv?` do not take a lock while the ring is neither full nor empty. Values that do not fit into the
+ring are appended to `m_overflow`, and receivers that find the channel empty register a promise in
+`m_waiters`; both are protected by `m_mutex`. Once a value is in the overflow queue, further values
+go there as well until it is empty again, so that the values of each sender stay in order.
+
+A sender that added a value reads `m_num_waiters` after a full fence, and a receiver registers
+itself in `m_num_waiters` before looking for values again, so at least one of them sees the other
+and hands the value to the oldest waiter in `drain`. A `send` that runs concurrently with `close`
+may still deliver its value.
+*/
+class channel {
+    struct cell {
+        std::atomic<size_t> m_seq;
+        object *            m_val;
+    };
+    static constexpr size_t ring_size = 1u << LEAN_CHANNEL_RING_BITS;
+    /* The positions and the lock are padded to avoid false sharing. We do not use `alignas(64)` as
+       channels are allocated using `new`, which only respects extended alignment since C++17. */
+    cell                            m_ring[ring_size];
+    char                            m_padding1[64];
+    std::atomic<size_t>             m_enqueue_pos;
+    char                            m_padding2[64];
+    std::atomic<size_t>             m_dequeue_pos;
+    char                            m_padding3[64];
+    mutex                           m_mutex;
+    std::deque<object *>            m_overflow;
+    std::atomic<size_t>             m_overflow_size{0};
+    std::deque<object *>            m_waiters;
+    std::atomic<size_t>             m_num_waiters{0};
+    std::atomic<bool>               m_closed{false};
+
+    typedef std::vector<std::pair<object *, object *>> resolutions;
+
+    bool ring_push(object * v) {
+        size_t pos = m_enqueue_pos.load(std::memory_order_relaxed);
+        while (true) {
+            cell & c = m_ring[pos & (ring_size - 1)];
+            size_t seq = c.m_seq.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (m_enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    c.m_val = v;
+                    c.m_seq.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = m_enqueue_pos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    object * ring_pop() {
+        size_t pos = m_dequeue_pos.load(std::memory_order_relaxed);
+        while (true) {
+            cell & c = m_ring[pos & (ring_size - 1)];
+            size_t seq = c.m_seq.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+            if (diff == 0) {
+                if (m_dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    object * v = c.m_val;
+                    c.m_seq.store(pos + ring_size, std::memory_order_release);
+                    return v;
+                }
+            } else if (diff < 0) {
+                return nullptr;
+            } else {
+                pos = m_dequeue_pos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /* Pop the oldest value, or return `nullptr`. `m_mutex` must be held. */
+    object * pop_locked() {
+        if (object * v = ring_pop())
+            return v;
+        if (m_overflow.empty())
+            return nullptr;
+        object * v = m_overflow.front();
+        m_overflow.pop_front();
+        m_overflow_size.fetch_sub(1);
+        return v;
+    }
+
+    /*
+    Hand values to waiters while there are both, and resolve all waiters with `none` once the
+    channel is closed and empty. `m_mutex` must be held; the promises are resolved by `resolve` after
+    it has been released, since resolving runs arbitrary code.
+    */
+    void drain(resolutions & rs) {
+        while (!m_waiters.empty()) {
+            object * v = pop_locked();
+            if (!v) {
+                if (!m_closed.load())
+                    return;
+                rs.emplace_back(m_waiters.front(), box(0));
+            } else {
+                object * some = alloc_cnstr(1, 1, 0);
+                cnstr_set(some, 0, v);
+                rs.emplace_back(m_waiters.front(), some);
+            }
+            m_waiters.pop_front();
+            m_num_waiters.fetch_sub(1);
+        }
+    }
+
+    static void resolve(resolutions & rs) {
+        for (auto & r : rs) {
+            dec(lean_io_promise_resolve(r.second, r.first, io_mk_world()));
+            dec(r.first);
+        }
+    }
+
+public:
+    channel() : m_enqueue_pos(0), m_dequeue_pos(0) {
+        for (size_t i = 0; i < ring_size; i++)
+            m_ring[i].m_seq.store(i, std::memory_order_relaxed);
+    }
+
+    ~channel() {
+        while (object * v = ring_pop())
+            dec(v);
+        for (object * v : m_overflow)
+            dec(v);
+        for (object * p : m_waiters)
+            dec(p);
+    }
+
+    void send(obj_arg v) {
+        if (m_closed.load(std::memory_order_acquire)) {
+            dec(v);
+            return;
+        }
+        lean_mark_mt(v);
+        if (m_overflow_size.load() != 0 || !ring_push(v)) {
+            unique_lock<mutex> lock(m_mutex);
+            /* The ring may have been emptied in the meantime, but older values may already be in the overflow queue. */
+            if (!m_overflow.empty() || !ring_push(v)) {
+                m_overflow.push_back(v);
+                m_overflow_size.fetch_add(1);
+            }
+        }
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_num_waiters.load() != 0) {
+            resolutions rs;
+            {
+                unique_lock<mutex> lock(m_mutex);
+                drain(rs);
+            }
+            resolve(rs);
+        }
+    }
+
+    /* Return a task for the next value. */
+    obj_res recv() {
+        if (m_num_waiters.load() == 0) {
+            object * v = ring_pop();
+            if (!v && m_overflow_size.load() != 0) {
+                unique_lock<mutex> lock(m_mutex);
+                v = pop_locked();
+            }
+            if (v) {
+                object * some = alloc_cnstr(1, 1, 0);
+                cnstr_set(some, 0, v);
+                return lean_task_pure(some);
+            }
+        }
+        object * r = lean_io_promise_new(io_mk_world());
+        object * promise = io_result_get_value(r);
+        /* one reference is returned, the other one is owned by `m_waiters` */
+        inc(promise);
+        inc(promise);
+        dec(r);
+        resolutions rs;
+        {
+            unique_lock<mutex> lock(m_mutex);
+            m_waiters.push_back(promise);
+            m_num_waiters.fetch_add(1);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            drain(rs);
+        }
+        resolve(rs);
+        return promise;
+    }
+
+    void close() {
+        resolutions rs;
+        {
+            unique_lock<mutex> lock(m_mutex);
+            m_closed.store(true);
+            drain(rs);
+        }
+        resolve(rs);
+    }
+
+    /* Return all currently buffered values. */
+    obj_res recv_all() {
+        object * r = lean_mk_empty_array();
+        unique_lock<mutex> lock(m_mutex);
+        while (object * v = pop_locked())
+            r = lean_array_push(r, v);
+        return r;
+    }
+
+    void for_each(b_obj_arg fn) {
+        unique_lock<mutex> lock(m_mutex);
+        size_t end = m_enqueue_pos.load();
+        for (size_t pos = m_dequeue_pos.load(); pos != end; pos++) {
+            cell & c = m_ring[pos & (ring_size - 1)];
+            if (c.m_seq.load(std::memory_order_acquire) == pos + 1) {
+                inc(fn); inc(c.m_val);
+                lean_apply_1(fn, c.m_val);
+            }
+        }
+        for (object * v : m_overflow) {
+            inc(fn); inc(v);
+            lean_apply_1(fn, v);
+        }
+        for (object * p : m_waiters) {
+            inc(fn); inc(p);
+            lean_apply_1(fn, p);
+        }
+    }
+};
+
+static lean_external_class * g_channel_external_class = nullptr;
+static void channel_finalizer(void * h) {
+    delete static_cast<channel *>(h);
+}
+static void channel_foreach(void * h, b_obj_arg fn) {
+    static_cast<channel *>(h)->for_each(fn);
+}
+
+static channel * channel_get(b_obj_arg ch) {
+    return static_cast<channel *>(lean_get_external_data(ch));
+}
+
+extern "C" LEAN_EXPORT obj_res lean_io_channel_new(obj_arg) {
+    return io_result_mk_ok(lean_alloc_external(g_channel_external_class, new channel));
+}
+
+extern "C" LEAN_EXPORT obj_res lean_io_channel_send(b_obj_arg ch, obj_arg v, obj_arg) {
+    channel_get(ch)->send(v);
+    return io_result_mk_ok(box(0));
+}
+
+extern "C" LEAN_EXPORT obj_res lean_io_channel_recv(b_obj_arg ch, obj_arg) {
+    return io_result_mk_ok(channel_get(ch)->recv());
+}
+
+extern "C" LEAN_EXPORT obj_res lean_io_channel_close(b_obj_arg ch, obj_arg) {
+    channel_get(ch)->close();
+    return io_result_mk_ok(box(0));
+}
+
+extern "C" LEAN_EXPORT obj_res lean_io_channel_recv_all_current(b_obj_arg ch, obj_arg) {
+    return io_result_mk_ok(channel_get(ch)->recv_all());
+}
+
+void initialize_channel() {
+    g_channel_external_class = lean_register_external_class(channel_finalizer, channel_foreach);
+}
+
+void finalize_channel() {
+}
+}
@@ -9,8 +9,11 @@ Author: Leonardo de Moura
 #include <string>
 #include <vector>
 #include <cstring>
+#include <map>
 #include <lean/lean.h>
 #include "runtime/hash.h"
+#include "runtime/thread.h"
+#include "runtime/exception.h"
 #include "runtime/compact.h"
 
 #ifndef LEAN_WINDOWS
@@ -19,6 +22,12 @@ Author: Leonardo de Moura
 
 #define LEAN_COMPACTOR_INIT_SZ 1024*1024
 #define LEAN_MAX_SHARING_TABLE_INITIAL_SIZE 1024*1024
+// minimal number of array elements in a partition compacted by a separate thread, see `compact_parallel`
+#define LEAN_COMPACTOR_MIN_PARTITION_SIZE 1024
+#define LEAN_COMPACTOR_PARTITION_INIT_SZ 64*1024
+#define LEAN_COMPACTOR_PARTITION_TABLE_INITIAL_SIZE 16*1024
+// appending the partitions is sequential and costs more than half of compacting them, so fewer threads do not pay off
+#define LEAN_COMPACTOR_MIN_THREADS 4
 
 // uncomment to track the number of each kind of object in an .olean file
 // #define LEAN_TAG_COUNTERS
@@ -35,7 +44,7 @@ struct max_sharing_hash {
     object_compactor * m;
     max_sharing_hash(object_compactor * manager):m(manager) {}
     unsigned operator()(max_sharing_key const & k) const {
-        return hash_str(k.m_size, reinterpret_cast<unsigned char const *>(m->m_begin) + k.m_offset, 17);
+        return hash_bytes(k.m_size, reinterpret_cast<unsigned char const *>(m->m_begin) + k.m_offset, 17);
     }
 };
 
@@ -51,17 +60,21 @@ struct max_sharing_eq {
 
 struct object_compactor::max_sharing_table {
     std::unordered_set<max_sharing_key, max_sharing_hash, max_sharing_eq> m_table;
-    max_sharing_table(object_compactor * manager):
-        m_table(LEAN_MAX_SHARING_TABLE_INITIAL_SIZE, max_sharing_hash(manager), max_sharing_eq(manager)) {
+    max_sharing_table(object_compactor * manager, size_t sz):
+        m_table(sz, max_sharing_hash(manager), max_sharing_eq(manager)) {
     }
 };
 
-object_compactor::object_compactor(void * base_addr):
-    m_max_sharing_table(new max_sharing_table(this)),
+object_compactor::object_compactor(void * base_addr, size_t init_sz, size_t max_sharing_table_sz):
+    m_max_sharing_table(new max_sharing_table(this, max_sharing_table_sz)),
     m_base_addr(base_addr),
-    m_begin(malloc(LEAN_COMPACTOR_INIT_SZ)),
+    m_begin(malloc(init_sz)),
     m_end(m_begin),
-    m_capacity(static_cast<char*>(m_begin) + LEAN_COMPACTOR_INIT_SZ) {
+    m_capacity(static_cast<char*>(m_begin) + init_sz) {
+}
+
+object_compactor::object_compactor(void * base_addr):
+    object_compactor(base_addr, LEAN_COMPACTOR_INIT_SZ, LEAN_MAX_SHARING_TABLE_INITIAL_SIZE) {
 }
 
 object_compactor::~object_compactor() {
@@ -95,26 +108,67 @@ void * object_compactor::alloc(size_t sz) {
     return r;
 }
 
+object_offset object_compactor::to_region_offset(object * new_o) const {
+    return reinterpret_cast<object_offset>(reinterpret_cast<char*>(new_o) - reinterpret_cast<char*>(m_begin) + reinterpret_cast<size_t>(m_base_addr));
+}
+
 void object_compactor::save(object * o, object * new_o) {
     lean_assert(m_begin <= new_o && new_o < m_end);
-    m_obj_table.insert(std::make_pair(o, reinterpret_cast<object_offset>(reinterpret_cast<char*>(new_o) - reinterpret_cast<char*>(m_begin) + reinterpret_cast<size_t>(m_base_addr))));
+    m_obj_table.insert(std::make_pair(o, to_region_offset(new_o)));
 }
 
-void object_compactor::save_max_sharing(object * o, object * new_o, size_t new_o_sz) {
+/* Return an object equal to the last allocated object `new_o`, deallocating `new_o` if there already is one. */
+object * object_compactor::max_share(object * new_o, size_t new_o_sz) {
     max_sharing_key k(reinterpret_cast<char*>(new_o) - reinterpret_cast<char*>(m_begin), new_o_sz);
     auto it = m_max_sharing_table->m_table.find(k);
     if (it != m_max_sharing_table->m_table.end()) {
         m_end = new_o;
-        new_o = reinterpret_cast<lean_object*>(reinterpret_cast<char*>(m_begin) + it->m_offset);
+        return reinterpret_cast<lean_object*>(reinterpret_cast<char*>(m_begin) + it->m_offset);
     } else {
         m_max_sharing_table->m_table.insert(k);
+        return new_o;
+    }
+}
+
+void object_compactor::save_max_sharing(object * o, object * new_o, size_t new_o_sz) {
+    save(o, max_share(new_o, new_o_sz));
+}
+
+bool object_compactor::is_external(object * o) {
+    size_t addr = reinterpret_cast<size_t>(o);
+    // the last range starting at or before `addr`
+    auto it = std::upper_bound(m_external_ranges.begin(), m_external_ranges.end(), std::make_pair(addr, static_cast<size_t>(-1)));
+    if (it == m_external_ranges.begin() || addr - std::prev(it)->first >= std::prev(it)->second)
+        return false;
+    m_external_used[std::prev(it) - m_external_ranges.begin()] = true;
+    return true;
+}
+
+void object_compactor::set_prefix(void const * data, size_t sz) {
+    lean_assert(size() == 0);
+    memcpy(alloc(sz), data, sz);
+    m_has_prefix = true;
+}
+
+void object_compactor::set_external_ranges(std::vector<std::pair<size_t, size_t>> const & ranges) {
+    m_external_ranges = ranges;
+    m_external_used.assign(ranges.size(), false);
+}
+
+std::vector<std::pair<size_t, size_t>> object_compactor::get_external_ranges_used() const {
+    std::vector<std::pair<size_t, size_t>> r;
+    for (size_t i = 0; i < m_external_ranges.size(); i++) {
+        if (m_external_used[i])
+            r.push_back(m_external_ranges[i]);
     }
-    save(o, new_o);
+    return r;
 }
 
 object_offset object_compactor::to_offset(object * o) {
     if (lean_is_scalar(o)) {
         return o;
+    } else if (!m_external_ranges.empty() && is_external(o)) {
+        return o;
     } else {
         auto it = m_obj_table.find(o);
         if (it == m_obj_table.end()) {
@@ -273,6 +327,7 @@ void object_compactor::insert_mpz(object * o) {
     memcpy(data, m._mp_d, data_sz);
     m._mp_d = reinterpret_cast<mp_limb_t *>(reinterpret_cast<char *>(data) - reinterpret_cast<char *>(m_begin) + reinterpret_cast<ptrdiff_t>(m_base_addr));
     m._mp_alloc = nlimbs;
+    m_mpz_objs.push_back(o);
     save(o, (lean_object*)new_o);
 #else
     size_t data_sz = sizeof(mpn_digit) * to_mpz(o)->m_value.m_size;
@@ -283,6 +338,7 @@ void object_compactor::insert_mpz(object * o) {
     void * data = reinterpret_cast<char*>(new_o) + sizeof(mpz_object);
     memcpy(data, to_mpz(o)->m_value.m_digits, data_sz);
     new_o->m_value.m_digits = reinterpret_cast<mpn_digit *>(reinterpret_cast<char *>(data) - reinterpret_cast<char *>(m_begin) + reinterpret_cast<ptrdiff_t>(m_base_addr));
+    m_mpz_objs.push_back(o);
     save(o, (lean_object*)new_o);
 #endif
 }
@@ -324,10 +380,65 @@ tag_counter_manager g_tag_counter_manager;
 
 #endif
 
-void object_compactor::operator()(object * o) {
+/* Call `f` on every slot of the compacted objects in `[begin, end)` that contains a pointer into the region,
+   i.e., on every slot `compacted_region::read` fixes when the region is not at its base address. */
+template<typename F> void object_compactor::for_each_relocation(char * begin, char * end, F && f) {
+    auto align = [](size_t d) { size_t rem = d % sizeof(void*); return rem == 0 ? d : d + sizeof(void*) - rem; };
+    auto slot  = [&](void * p) { if (!lean_is_scalar(*static_cast<object **>(p))) f(p); };
+    char * it = begin;
+    while (it < end) {
+        object * curr = reinterpret_cast<object*>(it);
+        uint8 tag = lean_ptr_tag(curr);
+        if (tag <= LeanMaxCtorTag) {
+            object ** fs = lean_ctor_obj_cptr(curr);
+            for (unsigned i = 0; i < lean_ctor_num_objs(curr); i++) slot(fs + i);
+            it += align(lean_object_byte_size(curr));
+        } else {
+            switch (tag) {
+            case LeanArray: {
+                object ** fs = lean_array_cptr(curr);
+                for (size_t i = 0; i < lean_array_size(curr); i++) slot(fs + i);
+                it += align(lean_object_byte_size(curr));
+                break;
+            }
+            case LeanScalarArray: it += align(lean_sarray_byte_size(curr)); break;
+            case LeanString:      it += align(lean_string_byte_size(curr)); break;
+            case LeanMPZ:
+#ifdef LEAN_USE_GMP
+                f(&to_mpz(curr)->m_value.m_val[0]._mp_d);
+                it += align(sizeof(mpz_object) + sizeof(mp_limb_t) * mpz_size(to_mpz(curr)->m_value.m_val));
+#else
+                f(&to_mpz(curr)->m_value.m_digits);
+                it += align(sizeof(mpz_object) + sizeof(mpn_digit) * to_mpz(curr)->m_value.m_size);
+#endif
+                break;
+            case LeanThunk: slot(&lean_to_thunk(curr)->m_value); it += align(sizeof(lean_thunk_object)); break;
+            case LeanRef:   slot(&lean_to_ref(curr)->m_value); it += align(sizeof(lean_ref_object)); break;
+            case LeanTask:  slot(&lean_to_task(curr)->m_value); it += align(sizeof(lean_task_object)); break;
+            default:        lean_unreachable();
+            }
+        }
+    }
+}
+
+void object_compactor::get_relocations(std::vector<uint32_t> & r) const {
+    char * begin = static_cast<char *>(m_begin);
+    lean_always_assert(size() / sizeof(void*) <= UINT32_MAX);
+    size_t base = reinterpret_cast<size_t>(m_base_addr);
+    auto add = [&](void * p) {
+        // references to external objects (see `set_external_ranges`) are absolute
+        if (*static_cast<size_t *>(p) - base < size())
+            r.push_back((static_cast<char *>(p) - begin) / sizeof(void*));
+    };
+    // root address, see `operator()`
+    if (!lean_is_scalar(*static_cast<object **>(m_begin)))
+        add(m_begin);
+    for_each_relocation(begin + sizeof(object_offset), static_cast<char *>(m_end), add);
+}
+
+/* Copy the objects reachable from `o` that have not been copied yet. */
+void object_compactor::compact(object * o) {
     lean_assert(m_todo.empty());
-    // allocate for root address, see end of function
-    alloc(sizeof(object_offset));
     if (!lean_is_scalar(o)) {
         m_todo.push_back(o);
         while (!m_todo.empty()) {
@@ -358,9 +469,216 @@ void object_compactor::operator()(object * o) {
         }
         m_tmp.clear();
     }
+}
+
+/* Append the objects of the partition `p`, which was compacted with `nullptr` as base address, such that
+   the result is the same as if they had been copied by `compact`: objects are appended in the same order
+   and the ones that are equal to an object of the region are dropped. Objects copied by `compact` before
+   are equal to their copies in `p` after adjusting references, so they are dropped as well.
+   The offsets (in `p`) in `offsets` are replaced with the corresponding offsets in this region. */
+void object_compactor::append(object_compactor & p, std::vector<object_offset> & offsets) {
+    auto align = [](size_t d) { size_t rem = d % sizeof(void*); return rem == 0 ? d : d + sizeof(void*) - rem; };
+    char * begin = static_cast<char *>(p.m_begin);
+    char * end   = static_cast<char *>(p.m_end);
+    // offsets in this region of the objects of `p`, indexed by their offset in `p` in words
+    std::vector<object_offset> new_offsets(p.size() / sizeof(void*));
+    auto fix = [&](object * c) {
+        // references to external objects are absolute in `p` as well, see `to_offset`
+        if (lean_is_scalar(c) || (!m_external_ranges.empty() && is_external(c)))
+            return c;
+        return new_offsets[reinterpret_cast<size_t>(c) / sizeof(void*)];
+    };
+    size_t next_mpz = 0;
+    char * it = begin;
+    while (it < end) {
+        object * curr = reinterpret_cast<object*>(it);
+        size_t sz = lean_object_byte_size(curr);
+        object_offset r;
+        if (lean_ptr_tag(curr) == LeanMPZ) {
+            object * o = p.m_mpz_objs[next_mpz++];
+            if (m_obj_table.find(o) == m_obj_table.end())
+                insert_mpz(o);
+            r = m_obj_table.find(o)->second;
+        } else {
+            object * new_o = static_cast<object*>(alloc(sz));
+            memcpy(new_o, curr, sz);
+            uint8 tag = lean_ptr_tag(new_o);
+            if (tag <= LeanMaxCtorTag) {
+                object ** fs = lean_ctor_obj_cptr(new_o);
+                for (unsigned i = 0; i < lean_ctor_num_objs(new_o); i++) fs[i] = fix(fs[i]);
+            } else {
+                switch (tag) {
+                case LeanArray: {
+                    object ** fs = lean_array_cptr(new_o);
+                    for (size_t i = 0; i < lean_array_size(new_o); i++) fs[i] = fix(fs[i]);
+                    break;
+                }
+                case LeanScalarArray: case LeanString: break;
+                case LeanThunk: lean_to_thunk(new_o)->m_value = fix(lean_to_thunk(new_o)->m_value); break;
+                case LeanRef:   lean_to_ref(new_o)->m_value = fix(lean_to_ref(new_o)->m_value); break;
+                case LeanTask:  lean_to_task(new_o)->m_value = fix(lean_to_task(new_o)->m_value); break;
+                default:        lean_unreachable();
+                }
+            }
+            r = to_region_offset(max_share(new_o, sz));
+        }
+        new_offsets[(it - begin) / sizeof(void*)] = r;
+        it += align(sz);
+    }
+    for (object_offset & o : offsets)
+        o = fix(o);
+}
+
+/* Compact the elements of large arrays referenced by the root `o` in partitions of consecutive elements,
+   concurrently and independently of each other, and then append the partitions in order. This yields the
+   same region as `compact(o)`, which visits the fields of the root and the elements of arrays in order.
+   Return `false` if `o` does not reference any large arrays. */
+bool object_compactor::compact_parallel(object * o, unsigned num_threads) {
+    if (lean_is_scalar(o) || lean_ptr_tag(o) > LeanMaxCtorTag)
+        return false;
+    struct partition {
+        object ** m_elems;
+        size_t m_num_elems;
+        std::unique_ptr<object_compactor> m_compactor;
+        std::vector<object_offset> m_offsets;
+    };
+    std::vector<partition> partitions;
+    // for each field of the root, the number of partitions its elements have been split into
+    std::vector<size_t> num_field_partitions(lean_ctor_num_objs(o), 0);
+    for (unsigned i = 0; i < lean_ctor_num_objs(o); i++) {
+        object * f = lean_ctor_get(o, i);
+        if (lean_is_scalar(f) || lean_ptr_tag(f) != LeanArray || lean_array_size(f) < 2*LEAN_COMPACTOR_MIN_PARTITION_SIZE)
+            continue;
+        size_t n  = lean_array_size(f);
+        size_t sz = std::max<size_t>(LEAN_COMPACTOR_MIN_PARTITION_SIZE, (n + 4*num_threads - 1) / (4*num_threads));
+        for (size_t begin = 0; begin < n; begin += sz) {
+            partitions.push_back(partition{lean_array_cptr(f) + begin, std::min(sz, n - begin), nullptr, {}});
+            num_field_partitions[i]++;
+        }
+    }
+    if (partitions.empty())
+        return false;
+    atomic<size_t> next_partition(0);
+    auto worker = [&]() {
+        size_t i;
+        while ((i = next_partition++) < partitions.size()) {
+            partition & p = partitions[i];
+            p.m_compactor.reset(new object_compactor(nullptr, LEAN_COMPACTOR_PARTITION_INIT_SZ,
+                                                     LEAN_COMPACTOR_PARTITION_TABLE_INITIAL_SIZE));
+            p.m_compactor->set_external_ranges(m_external_ranges);
+            for (size_t j = 0; j < p.m_num_elems; j++) {
+                p.m_compactor->compact(p.m_elems[j]);
+                p.m_offsets.push_back(p.m_compactor->to_offset(p.m_elems[j]));
+            }
+        }
+    };
+    num_threads = std::min<size_t>(num_threads, partitions.size());
+    std::vector<std::unique_ptr<lthread>> threads;
+    for (unsigned i = 1; i < num_threads; i++)
+        threads.emplace_back(new lthread(worker));
+    worker();
+    for (auto & t : threads)
+        t->join();
+    size_t next = 0;
+    for (unsigned i = 0; i < lean_ctor_num_objs(o); i++) {
+        object * f = lean_ctor_get(o, i);
+        for (size_t j = 0; j < num_field_partitions[i]; j++, next++) {
+            partition & p = partitions[next];
+            append(*p.m_compactor, p.m_offsets);
+            for (size_t k = 0; k < m_external_used.size(); k++)
+                m_external_used[k] |= p.m_compactor->m_external_used[k];
+            for (size_t k = 0; k < p.m_num_elems; k++) {
+                if (!lean_is_scalar(p.m_elems[k]))
+                    m_obj_table.insert(std::make_pair(p.m_elems[k], p.m_offsets[k]));
+            }
+            p.m_compactor.reset();
+        }
+        compact(f);
+    }
+    compact(o);
+    return true;
+}
+
+void object_compactor::operator()(object * o, unsigned num_threads) {
+    // allocate for root address, see end of function; a prefix already starts with one
+    if (!m_has_prefix)
+        alloc(sizeof(object_offset));
+    // partitions cannot use objects of the prefix
+    if (num_threads < LEAN_COMPACTOR_MIN_THREADS || m_has_prefix || !compact_parallel(o, num_threads))
+        compact(o);
     *static_cast<object_offset *>(m_begin) = to_offset(o);
 }
 
+// declared in `lean.h`
+extern "C" {
+LEAN_EXPORT size_t lean_region_window_base = 0;
+LEAN_EXPORT size_t lean_region_window_size = 0;
+}
+
+#if !defined(LEAN_WINDOWS)
+static mutex *                     g_region_window_mutex = new mutex();
+/* start address -> size of the ranges mapped into the window */
+static std::map<size_t, size_t> *  g_region_window_ranges = new std::map<size_t, size_t>();
+static bool                        g_region_window_failed = false;
+
+static bool reserve_region_window() {
+    if (lean_region_window_size != 0)
+        return true;
+    if (g_region_window_failed || sizeof(void*) != 8)
+        return false;
+    void * p = mmap(reinterpret_cast<void *>(LEAN_REGION_WINDOW_BASE), LEAN_REGION_WINDOW_SIZE, PROT_NONE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (p != reinterpret_cast<void *>(LEAN_REGION_WINDOW_BASE)) {
+        // the hint was not honored because part of the range is in use already
+        if (p != MAP_FAILED)
+            munmap(p, LEAN_REGION_WINDOW_SIZE);
+        g_region_window_failed = true;
+        return false;
+    }
+    lean_region_window_base = LEAN_REGION_WINDOW_BASE;
+    lean_region_window_size = LEAN_REGION_WINDOW_SIZE;
+    return true;
+}
+
+bool region_window_map(void * addr, size_t sz, int fd) {
+    size_t start = reinterpret_cast<size_t>(addr);
+    if (start < LEAN_REGION_WINDOW_BASE || sz > LEAN_REGION_WINDOW_SIZE ||
+        start - LEAN_REGION_WINDOW_BASE > LEAN_REGION_WINDOW_SIZE - sz)
+        return false;
+    lock_guard<mutex> lock(*g_region_window_mutex);
+    if (!reserve_region_window())
+        return false;
+    // check for overlaps with the closest ranges on both sides
+    auto next = g_region_window_ranges->lower_bound(start);
+    if (next != g_region_window_ranges->end() && next->first < start + sz)
+        return false;
+    if (next != g_region_window_ranges->begin() && std::prev(next)->first + std::prev(next)->second > start)
+        return false;
+    // replaces the reserved pages, so nothing else can be mapped in between
+    int prot  = fd == -1 ? PROT_READ | PROT_WRITE : PROT_READ;
+    int flags = fd == -1 ? MAP_PRIVATE | MAP_FIXED | MAP_ANONYMOUS : MAP_PRIVATE | MAP_FIXED;
+    if (mmap(addr, sz, prot, flags, fd, 0) != addr)
+        return false;
+    g_region_window_ranges->emplace(start, sz);
+    return true;
+}
+
+void region_window_unmap(void * addr, size_t sz) {
+    lock_guard<mutex> lock(*g_region_window_mutex);
+    lean_always_assert(mmap(addr, sz, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED, -1, 0) == addr);
+    g_region_window_ranges->erase(reinterpret_cast<size_t>(addr));
+}
+
+std::vector<std::pair<size_t, size_t>> region_window_ranges() {
+    lock_guard<mutex> lock(*g_region_window_mutex);
+    return std::vector<std::pair<size_t, size_t>>(g_region_window_ranges->begin(), g_region_window_ranges->end());
+}
+#else
+bool region_window_map(void *, size_t, int) { return false; }
+void region_window_unmap(void *, size_t) {}
+std::vector<std::pair<size_t, size_t>> region_window_ranges() { return {}; }
+#endif
+
 compacted_region::compacted_region(size_t sz, void * data, void * base_addr, bool is_mmap, std::function<void()> free_data):
     m_base_addr(base_addr),
     m_is_mmap(is_mmap),
@@ -383,6 +701,9 @@ compacted_region::~compacted_region() {
 
 inline object * compacted_region::fix_object_ptr(object * o) {
     if (lean_is_scalar(o)) return o;
+    // keep references to external objects, see `object_compactor::set_external_ranges`
+    if (reinterpret_cast<size_t>(o) - reinterpret_cast<size_t>(m_base_addr) >= static_cast<size_t>(static_cast<char*>(m_end) - static_cast<char*>(m_begin)))
+        return o;
     return reinterpret_cast<object*>(static_cast<char*>(m_begin) + (reinterpret_cast<size_t>(o) - reinterpret_cast<size_t>(m_base_addr)));
 }
 
@@ -480,10 +801,32 @@ object * compacted_region::read() {
     return root;
 }
 
+void compacted_region::relocate(uint32_t const * slots, size_t num_slots) {
+    lean_assert(m_next == m_begin);
+    size_t delta = reinterpret_cast<size_t>(m_begin) - reinterpret_cast<size_t>(m_base_addr);
+    size_t * data = static_cast<size_t *>(m_begin);
+    size_t size   = (static_cast<char *>(m_end) - static_cast<char *>(m_begin)) / sizeof(size_t);
+    for (size_t i = 0; i < num_slots; i++) {
+        if (slots[i] >= size)
+            throw exception("invalid relocation");
+        data[slots[i]] += delta;
+    }
+    m_base_addr = m_begin;
+}
+
 extern "C" LEAN_EXPORT uint8 lean_compacted_region_is_memory_mapped(usize region) {
     return reinterpret_cast<compacted_region *>(region)->is_memory_mapped();
 }
 
+extern "C" LEAN_EXPORT obj_res lean_compacted_region_external_ranges_mapped(usize region, object *) {
+    std::vector<std::pair<size_t, size_t>> mapped = region_window_ranges();
+    for (auto const & r : reinterpret_cast<compacted_region *>(region)->get_external_ranges()) {
+        if (!std::binary_search(mapped.begin(), mapped.end(), r))
+            return lean_io_result_mk_ok(lean_box(false));
+    }
+    return lean_io_result_mk_ok(lean_box(true));
+}
+
 extern "C" LEAN_EXPORT obj_res lean_compacted_region_free(usize region, object *) {
     delete reinterpret_cast<compacted_region *>(region);
     return lean_io_result_mk_ok(lean_box(0));
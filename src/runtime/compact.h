@@ -21,6 +21,15 @@ class LEAN_EXPORT object_compactor {
     std::unique_ptr<max_sharing_table> m_max_sharing_table;
     std::vector<object*> m_todo;
     std::vector<object_offset> m_tmp;
+    // Source objects of the `mpz` objects in the region, in order, which are not subject to max sharing
+    // and therefore must be identified by address when appending partitions, see `append`.
+    std::vector<object*> m_mpz_objs;
+    // Sorted, disjoint address ranges `[start, start + size)` of objects that are referenced instead of
+    // copied, and whether they have been referenced, see `set_external_ranges`
+    std::vector<std::pair<size_t, size_t>> m_external_ranges;
+    std::vector<char> m_external_used;
+    // whether the region starts with a copy of a previously compacted region, see `set_prefix`
+    bool m_has_prefix = false;
     // On-disk base address used for `mmap`ing compacted regions without relocations
     // References within the compacted region are rewritten by subtracting `m_begin` and adding `m_base_addr`
     // In the simplest case `base_addr == nullptr`, we get region-relative pointers
@@ -29,7 +38,11 @@ class LEAN_EXPORT object_compactor {
     void * m_end;
     void * m_capacity;
     size_t capacity() const { return static_cast<char*>(m_capacity) - static_cast<char*>(m_begin); }
+    object_compactor(void * base_addr, size_t init_sz, size_t max_sharing_table_sz);
+    object_offset to_region_offset(object * new_o) const;
+    bool is_external(object * o);
     void save(object * o, object * new_o);
+    object * max_share(object * new_o, size_t new_o_sz);
     void save_max_sharing(object * o, object * new_o, size_t new_o_sz);
     void * alloc(size_t sz);
     object_offset to_offset(object * o);
@@ -43,6 +56,10 @@ class LEAN_EXPORT object_compactor {
     bool insert_task(object * o);
     bool insert_ref(object * o);
     void insert_mpz(object * o);
+    void compact(object * o);
+    void append(object_compactor & p, std::vector<object_offset> & offsets);
+    bool compact_parallel(object * o, unsigned num_threads);
+    template<typename F> static void for_each_relocation(char * begin, char * end, F && f);
 public:
     object_compactor(void * base_addr = nullptr);
     object_compactor(object_compactor const &) = delete;
@@ -50,9 +67,27 @@ public:
     ~object_compactor();
     object_compactor operator=(object_compactor const &) = delete;
     object_compactor operator=(object_compactor &&) = delete;
-    void operator()(object * o);
+    /* Compact the object graph rooted at `o`. If `num_threads` is large enough, the elements of large arrays
+       referenced by the root are compacted using that many threads. The result is the same in either case. */
+    void operator()(object * o, unsigned num_threads = 1);
     size_t size() const { return static_cast<char*>(m_end) - static_cast<char*>(m_begin); }
     void const * data() const { return m_begin; }
+    /* Store in `r` the indices (in units of `sizeof(void*)`) of all slots in `data()` that contain pointers
+       that must be adjusted when the region is not loaded at its base address. */
+    void get_relocations(std::vector<uint32_t> & r) const;
+    /* Reference objects in the given sorted, disjoint ranges `[start, start + size)` by address instead of
+       copying them, e.g. objects of imported modules mapped at their base addresses. The result is valid
+       only while the same data is mapped at the ranges that are actually referenced. */
+    void set_external_ranges(std::vector<std::pair<size_t, size_t>> const & ranges);
+    /* Return the external ranges that objects in `data()` refer to. */
+    std::vector<std::pair<size_t, size_t>> get_external_ranges_used() const;
+    /* Start the region with a copy of the `sz` bytes at `data`, a region compacted before with the same base
+       address. Its objects can then be used via `reuse`, and its root is replaced by the compacted object.
+       Must be called before compacting. */
+    void set_prefix(void const * data, size_t sz);
+    /* Use the object at `offset` in the prefix (see `set_prefix`) instead of copying `o`.
+       The object must be equal to `o`. */
+    void reuse(object * o, object_offset offset) { m_obj_table.insert(std::make_pair(o, offset)); }
 };
 
 class LEAN_EXPORT compacted_region {
@@ -72,6 +107,8 @@ class LEAN_EXPORT compacted_region {
     void fix_ref(object * o);
     void fix_task(object * o);
     void fix_mpz(object * o);
+    // see `object_compactor::set_external_ranges`
+    std::vector<std::pair<size_t, size_t>> m_external_ranges;
 public:
     /* Creates a compacted object region using the given region in memory.
        This object takes ownership of the region. */
@@ -85,6 +122,31 @@ public:
     compacted_region operator=(compacted_region const &) = delete;
     compacted_region operator=(compacted_region &&) = delete;
     object * read();
+    /* Adjust the given slots (see `object_compactor::get_relocations`) for the actual address of the region.
+       Afterwards, `read` does not have to visit every object anymore. */
+    void relocate(uint32_t const * slots, size_t num_slots);
     bool is_memory_mapped() const { return m_is_mmap; }
+    /* Return `true` iff `p` points into the objects of this region. */
+    bool contains(void const * p) const { return m_begin <= p && p < m_end; }
+    /* Record the ranges of other regions that objects in this region refer to (see `object_compactor::set_external_ranges`),
+       so that importers can check that they are mapped. */
+    void set_external_ranges(std::vector<std::pair<size_t, size_t>> const & ranges) { m_external_ranges = ranges; }
+    std::vector<std::pair<size_t, size_t>> const & get_external_ranges() const { return m_external_ranges; }
 };
+
+/* The region window is a range of the address space reserved (on 64-bit Unix systems) on first use,
+   such that only compacted regions can be mapped into it. This allows `lean_is_scalar_or_region_obj`
+   to identify their objects with a single comparison. `.olean` files pick their base address
+   inside the window. */
+#define LEAN_REGION_WINDOW_BASE 0x100000000000ull // 16 TB
+#define LEAN_REGION_WINDOW_SIZE 0x40000000000ull  // 4 TB
+
+/* Map `sz` bytes of the file `fd` read-only at `addr`, which must be in the region window, or
+   anonymous zero-initialized read-write memory if `fd == -1`.
+   Return `false` if the window could not be reserved, or if the range overlaps a region mapped before. */
+LEAN_EXPORT bool region_window_map(void * addr, size_t sz, int fd);
+/* Unmap a range mapped by `region_window_map`, returning it to the window. */
+LEAN_EXPORT void region_window_unmap(void * addr, size_t sz);
+/* Return the ranges `[start, start + size)` currently mapped into the region window, sorted by address. */
+LEAN_EXPORT std::vector<std::pair<size_t, size_t>> region_window_ranges();
 }
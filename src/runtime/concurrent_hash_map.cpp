@@ -0,0 +1,164 @@
+/*
+Copyright (c) 2024 Lean FRO, LLC. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+*/
+#include <unordered_map>
+#include <utility>
+#include <lean/lean.h>
+#include "runtime/concurrent_hash_map.h"
+#include "runtime/io.h"
+#include "runtime/object.h"
+#include "runtime/thread.h"
+
+/* Log2 of the number of independently locked shards. */
+#define LEAN_CONCURRENT_HASH_MAP_SHARD_BITS 6
+
+namespace lean {
+
+/*
+Hash map shared between tasks. Entries are split into shards by hash, each protected by its own
+mutex, so that accesses to different shards do not contend. Keys and values are marked as
+multi-threaded on insertion, since any thread may read them afterwards.
+
+The hash and equality test are computed by the Lean side. The equality test is called while the
+shard lock is held, so it must not access the map itself.
+*/
+class concurrent_hash_map {
+    typedef std::unordered_multimap<uint64_t, std::pair<object *, object *>> entries;
+    /* Shards are padded to avoid false sharing between their locks. We do not use `alignas(64)` as
+       the map is allocated using `new`, which only respects extended alignment since C++17. */
+    struct shard {
+        mutex   m_mutex;
+        entries m_entries;
+        char    m_padding[64];
+    };
+    shard m_shards[1u << LEAN_CONCURRENT_HASH_MAP_SHARD_BITS];
+
+    shard & get_shard(uint64_t h) {
+        /* Fibonacci hashing, so that the shard does not only depend on the low bits of `h`. */
+        return m_shards[(h * 0x9E3779B97F4A7C15ull) >> (64 - LEAN_CONCURRENT_HASH_MAP_SHARD_BITS)];
+    }
+
+    static bool is_eq(b_obj_arg eq, b_obj_arg k1, b_obj_arg k2) {
+        lean_inc(eq);
+        lean_inc(k1);
+        lean_inc(k2);
+        return lean_unbox(lean_apply_2(eq, k1, k2));
+    }
+
+    static object * find_core(entries & es, uint64_t h, b_obj_arg eq, b_obj_arg k) {
+        auto r = es.equal_range(h);
+        for (auto it = r.first; it != r.second; ++it) {
+            if (is_eq(eq, it->second.first, k))
+                return it->second.second;
+        }
+        return nullptr;
+    }
+
+public:
+    ~concurrent_hash_map() {
+        for (shard & s : m_shards) {
+            for (auto & e : s.m_entries) {
+                lean_dec(e.second.first);
+                lean_dec(e.second.second);
+            }
+        }
+    }
+
+    /* Return the value associated with `k`, or `nullptr`. The result is owned by the caller. */
+    object * find(uint64_t h, b_obj_arg eq, b_obj_arg k) {
+        shard & s = get_shard(h);
+        lock_guard<mutex> lock(s.m_mutex);
+        object * v = find_core(s.m_entries, h, eq, k);
+        if (v) lean_inc(v);
+        return v;
+    }
+
+    /*
+    Associate `v` with `k` unless `k` is already present, in which case `k` and `v` are dropped and
+    the existing value is returned. Return `nullptr` if `v` was inserted.
+    */
+    object * insert_if_absent(uint64_t h, b_obj_arg eq, obj_arg k, obj_arg v) {
+        lean_mark_mt(k);
+        lean_mark_mt(v);
+        shard & s = get_shard(h);
+        object * old;
+        {
+            lock_guard<mutex> lock(s.m_mutex);
+            old = find_core(s.m_entries, h, eq, k);
+            if (!old) {
+                s.m_entries.emplace(h, std::make_pair(k, v));
+                return nullptr;
+            }
+            lean_inc(old);
+        }
+        /* `k` and `v` are released outside of the lock, since freeing them may run arbitrary code */
+        lean_dec(k);
+        lean_dec(v);
+        return old;
+    }
+
+    size_t size() {
+        size_t r = 0;
+        for (shard & s : m_shards) {
+            lock_guard<mutex> lock(s.m_mutex);
+            r += s.m_entries.size();
+        }
+        return r;
+    }
+
+    void for_each(b_obj_arg fn) {
+        for (shard & s : m_shards) {
+            lock_guard<mutex> lock(s.m_mutex);
+            for (auto & e : s.m_entries) {
+                lean_inc(fn); lean_inc(e.second.first);
+                lean_apply_1(fn, e.second.first);
+                lean_inc(fn); lean_inc(e.second.second);
+                lean_apply_1(fn, e.second.second);
+            }
+        }
+    }
+};
+
+static lean_external_class * g_concurrent_hash_map_external_class = nullptr;
+static void concurrent_hash_map_finalizer(void * h) {
+    delete static_cast<concurrent_hash_map *>(h);
+}
+static void concurrent_hash_map_foreach(void * h, b_obj_arg fn) {
+    static_cast<concurrent_hash_map *>(h)->for_each(fn);
+}
+
+static concurrent_hash_map * concurrent_hash_map_get(b_obj_arg m) {
+    return static_cast<concurrent_hash_map *>(lean_get_external_data(m));
+}
+
+static obj_res mk_option(object * v) {
+    if (!v) return box(0);
+    object * r = alloc_cnstr(1, 1, 0);
+    cnstr_set(r, 0, v);
+    return r;
+}
+
+extern "C" LEAN_EXPORT obj_res lean_concurrent_hash_map_new(obj_arg) {
+    return io_result_mk_ok(lean_alloc_external(g_concurrent_hash_map_external_class, new concurrent_hash_map));
+}
+
+extern "C" LEAN_EXPORT obj_res lean_concurrent_hash_map_find(b_obj_arg m, uint64_t h, b_obj_arg eq, b_obj_arg k, obj_arg) {
+    return io_result_mk_ok(mk_option(concurrent_hash_map_get(m)->find(h, eq, k)));
+}
+
+extern "C" LEAN_EXPORT obj_res lean_concurrent_hash_map_insert_if_absent(b_obj_arg m, uint64_t h, b_obj_arg eq, obj_arg k, obj_arg v, obj_arg) {
+    return io_result_mk_ok(mk_option(concurrent_hash_map_get(m)->insert_if_absent(h, eq, k, v)));
+}
+
+extern "C" LEAN_EXPORT obj_res lean_concurrent_hash_map_size(b_obj_arg m, obj_arg) {
+    return io_result_mk_ok(box(concurrent_hash_map_get(m)->size()));
+}
+
+void initialize_concurrent_hash_map() {
+    g_concurrent_hash_map_external_class = lean_register_external_class(concurrent_hash_map_finalizer, concurrent_hash_map_foreach);
+}
+
+void finalize_concurrent_hash_map() {
+}
+}
@@ -4,6 +4,7 @@ Released under Apache 2.0 license as described in the file LICENSE.
 
 Author: Leonardo de Moura
 */
+#include <cstring>
 #include "runtime/hash.h"
 
 namespace lean {
@@ -55,4 +56,73 @@ uint64 hash_str(size_t len, unsigned char const * str, uint64 init_value) {
     return MurmurHash64A(str, len, init_value);
 }
 
+//-----------------------------------------------------------------------------
+// wyhash (final version 4), by Wang Yi
+// https://github.com/wangyi-fudan/wyhash
+static inline void wymum(uint64 & a, uint64 & b) {
+#if defined(__SIZEOF_INT128__)
+    __uint128_t r = static_cast<__uint128_t>(a) * b;
+    a = static_cast<uint64>(r);
+    b = static_cast<uint64>(r >> 64);
+#else
+    uint64 ha = a >> 32, hb = b >> 32, la = static_cast<uint32_t>(a), lb = static_cast<uint32_t>(b);
+    uint64 rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb, t = rl + (rm0 << 32);
+    uint64 c = t < rl;
+    uint64 lo = t + (rm1 << 32);
+    c += lo < t;
+    uint64 hi = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+    a = lo;
+    b = hi;
+#endif
+}
+
+static inline uint64 wymix(uint64 a, uint64 b) { wymum(a, b); return a ^ b; }
+static inline uint64 wyr8(unsigned char const * p) { uint64 v; memcpy(&v, p, 8); return v; }
+static inline uint64 wyr4(unsigned char const * p) { uint32_t v; memcpy(&v, p, 4); return v; }
+static inline uint64 wyr3(unsigned char const * p, size_t k) {
+    return (uint64(p[0]) << 16) | (uint64(p[k >> 1]) << 8) | p[k - 1];
+}
+
+uint64 hash_bytes(size_t len, unsigned char const * p, uint64 seed) {
+    const uint64 s0 = 0xa0761d6478bd642f, s1 = 0xe7037ed1a0b428db, s2 = 0x8ebc6af09c88c6e3, s3 = 0x589965cc75374cc3;
+    seed ^= wymix(seed ^ s0, s1);
+    uint64 a, b;
+    if (len <= 16) {
+        if (len >= 4) {
+            a = (wyr4(p) << 32) | wyr4(p + ((len >> 3) << 2));
+            b = (wyr4(p + len - 4) << 32) | wyr4(p + len - 4 - ((len >> 3) << 2));
+        } else if (len > 0) {
+            a = wyr3(p, len);
+            b = 0;
+        } else {
+            a = b = 0;
+        }
+    } else {
+        size_t i = len;
+        if (i > 48) {
+            // three independent lanes
+            uint64 see1 = seed, see2 = seed;
+            do {
+                seed = wymix(wyr8(p) ^ s1, wyr8(p + 8) ^ seed);
+                see1 = wymix(wyr8(p + 16) ^ s2, wyr8(p + 24) ^ see1);
+                see2 = wymix(wyr8(p + 32) ^ s3, wyr8(p + 40) ^ see2);
+                p += 48;
+                i -= 48;
+            } while (i > 48);
+            seed ^= see1 ^ see2;
+        }
+        while (i > 16) {
+            seed = wymix(wyr8(p) ^ s1, wyr8(p + 8) ^ seed);
+            i -= 16;
+            p += 16;
+        }
+        a = wyr8(p + i - 16);
+        b = wyr8(p + i - 8);
+    }
+    a ^= s1;
+    b ^= seed;
+    wymum(a, b);
+    return wymix(a ^ s0 ^ len, b ^ s1);
+}
+
 }
@@ -10,8 +10,14 @@ Author: Leonardo de Moura
 
 namespace lean {
 
+/* Hash used by `String.hash` and `ByteArray.hash`, and thus by `Name.hash`. Its values are stored in .olean files,
+   so it must not change. */
 uint64 hash_str(size_t len, unsigned char const * str, uint64 init_value);
 
+/* Faster hash for in-memory tables. Unlike `hash_str`, its values must not be persisted or exposed
+   as they may change between versions. */
+uint64 hash_bytes(size_t len, unsigned char const * str, uint64 seed);
+
 inline uint64 hash(uint64 h, uint64 k) {
     uint64 m = 0xc6a4a7935bd1e995;
     uint64 r = 47;
@@ -5,6 +5,7 @@ Released under Apache 2.0 license as described in the file LICENSE.
 Author: Leonardo de Moura
 */
 #include "runtime/alloc.h"
+#include "runtime/allocprof.h"
 #include "runtime/debug.h"
 #include "runtime/thread.h"
 #include "runtime/object.h"
@@ -12,16 +13,23 @@ Author: Leonardo de Moura
 #include "runtime/stack_overflow.h"
 #include "runtime/process.h"
 #include "runtime/mutex.h"
+#include "runtime/concurrent_hash_map.h"
+#include "runtime/channel.h"
+#include "runtime/sharecommon.h"
 #include "runtime/init_module.h"
 
 namespace lean {
 extern "C" LEAN_EXPORT void lean_initialize_runtime_module() {
     initialize_alloc();
+    initialize_allocprof();
     initialize_debug();
     initialize_object();
     initialize_io();
     initialize_thread();
     initialize_mutex();
+    initialize_concurrent_hash_map();
+    initialize_channel();
+    initialize_sharecommon();
     initialize_process();
     initialize_stack_overflow();
 }
@@ -31,11 +39,15 @@ void initialize_runtime_module() {
 void finalize_runtime_module() {
     finalize_stack_overflow();
     finalize_process();
+    finalize_sharecommon();
+    finalize_channel();
+    finalize_concurrent_hash_map();
     finalize_mutex();
     finalize_thread();
     finalize_io();
     finalize_object();
     finalize_debug();
+    finalize_allocprof();
     finalize_alloc();
 }
 }
@@ -5,6 +5,7 @@ Released under Apache 2.0 license as described in the file LICENSE.
 Author: Leonardo de Moura
 */
 #include <limits>
+#include <atomic>
 #include "runtime/thread.h"
 #include "runtime/interrupt.h"
 #include "runtime/exception.h"
@@ -42,18 +43,44 @@ void check_heartbeat() {
 
 LEAN_THREAD_VALUE(lean_object *, g_cancel_tk, nullptr);
 
+/* Incremented by `request_attention`. A thread whose last complete `check_interrupted` found nothing to
+   interrupt stores the value read before that check in `g_attention_seen` and can skip inspecting its cancel
+   token and scope until the counter changes. `0` is never a valid epoch and forces a complete check. */
+static std::atomic<uint64_t> g_attention_epoch(1);
+LEAN_THREAD_VALUE(uint64_t, g_attention_seen, 0);
+
+void request_attention() {
+    g_attention_epoch.fetch_add(1, std::memory_order_release);
+}
+
+void reset_attention() { g_attention_seen = 0; }
+
+/* requestAttention : BaseIO Unit */
+extern "C" LEAN_EXPORT lean_obj_res lean_io_request_attention(lean_obj_arg) {
+    request_attention();
+    return lean_io_result_mk_ok(lean_box(0));
+}
+
+lean_object * get_cancel_tk() { return g_cancel_tk; }
+
 LEAN_EXPORT scope_cancel_tk::scope_cancel_tk(lean_object * o):flet<lean_object *>(g_cancel_tk, o) {}
 
 /* CancelToken.isSet : @& IO.CancelToken → BaseIO Bool */
 extern "C" lean_obj_res lean_io_cancel_token_is_set(b_lean_obj_arg cancel_tk, lean_obj_arg);
 
 void check_interrupted() {
-    if (g_cancel_tk) {
+    uint64_t epoch = g_attention_epoch.load(std::memory_order_acquire);
+    if (g_attention_seen == epoch)
+        return;
+    bool canceled = lean_io_cancel_scope_check_core();
+    if (!canceled && g_cancel_tk) {
         inc_ref(g_cancel_tk);
-        if (get_io_scalar_result<bool>(lean_io_cancel_token_is_set(g_cancel_tk, lean_io_mk_world())) &&
-            !std::uncaught_exception()) {
-            throw interrupted();
-        }
+        canceled = get_io_scalar_result<bool>(lean_io_cancel_token_is_set(g_cancel_tk, lean_io_mk_world()));
+    }
+    if (!canceled) {
+        g_attention_seen = epoch;
+    } else if (!std::uncaught_exception()) {
+        throw interrupted();
     }
 }
 
@@ -42,14 +42,42 @@ public:
 
 LEAN_EXPORT void check_heartbeat();
 
+/**
+   \brief Signal all threads that cancellation may have been requested, i.e. that a cancel token was set
+   or a cancel scope was canceled. `check_interrupted` only inspects the cancel token and scope of the
+   current thread after such a signal, so it must be raised by everything that sets one of them.
+*/
+LEAN_EXPORT void request_attention();
+
+/**
+   \brief Make the next `check_interrupted` on this thread inspect its cancel token and scope. Must be
+   called whenever they are replaced, as the new ones may already be set.
+*/
+LEAN_EXPORT void reset_attention();
+
+/* Resets the attention flag of the current thread on entry and exit of a scope that replaces its cancel
+   token or cancel scope. */
+class scope_reset_attention {
+public:
+    scope_reset_attention() { reset_attention(); }
+    ~scope_reset_attention() { reset_attention(); }
+};
+
+/* Return the thread local `IO.CancelToken` (`nullptr` if unset) */
+LEAN_EXPORT lean_object * get_cancel_tk();
+
 /* Update the thread local `IO.CancelToken` (`nullptr` if unset) */
 class LEAN_EXPORT scope_cancel_tk : flet<lean_object *> {
+    scope_reset_attention m_reset;
 public:
     LEAN_EXPORT scope_cancel_tk(lean_object *);
 };
 
 /**
    \brief Throw an interrupted exception if the current thread's cancel token is set.
+
+   Called from hot loops, so unless `request_attention` or `reset_attention` were called since the last
+   check on this thread, this only compares a thread local with a global counter.
 */
 LEAN_EXPORT void check_interrupted();
 
@@ -13,6 +13,7 @@ Authors: Leonardo de Moura, Sebastian Ullrich
 #elif defined(__APPLE__)
 #include <mach-o/dyld.h>
 #include <unistd.h>
+#include <sys/mman.h>
 #else
 #if defined(LEAN_EMSCRIPTEN)
 #include <emscripten.h>
@@ -47,6 +48,12 @@ Authors: Leonardo de Moura, Sebastian Ullrich
 #include "runtime/object.h"
 #include "runtime/thread.h"
 #include "runtime/allocprof.h"
+#include "runtime/memory.h"
+#include "runtime/hash.h"
+
+#ifndef LEAN_STDOUT_BUFFER_SIZE
+#define LEAN_STDOUT_BUFFER_SIZE (1 << 16)
+#endif
 
 #ifdef _MSC_VER
 #define S_ISDIR(mode) ((mode & _S_IFDIR) != 0)
@@ -104,6 +111,37 @@ lean_object * io_wrap_handle(FILE *hfile) {
     return lean_alloc_external(g_io_handle_external_class, hfile);
 }
 
+struct io_mapped_file {
+    char * m_data = nullptr;
+    size_t m_size = 0;
+#ifdef LEAN_WINDOWS
+    HANDLE m_file = INVALID_HANDLE_VALUE;
+    HANDLE m_map  = NULL;
+#endif
+    ~io_mapped_file() {
+#ifdef LEAN_WINDOWS
+        if (m_data) UnmapViewOfFile(m_data);
+        if (m_map) CloseHandle(m_map);
+        if (m_file != INVALID_HANDLE_VALUE) CloseHandle(m_file);
+#else
+        if (m_data) munmap(m_data, m_size);
+#endif
+    }
+};
+
+static lean_external_class * g_io_mapped_file_external_class = nullptr;
+
+static void io_mapped_file_finalizer(void * f) {
+    delete static_cast<io_mapped_file *>(f);
+}
+
+static void io_mapped_file_foreach(void * /* mod */, b_obj_arg /* fn */) {
+}
+
+static io_mapped_file * io_get_mapped_file(b_obj_arg f) {
+    return static_cast<io_mapped_file *>(lean_get_external_data(f));
+}
+
 extern "C" obj_res lean_stream_of_handle(obj_arg h);
 
 static object * g_stream_stdin  = nullptr;
@@ -152,7 +190,7 @@ extern "C" LEAN_EXPORT obj_res lean_get_set_stderr(obj_arg h, obj_arg /* w */) {
     return io_result_mk_ok(r);
 }
 
-static FILE * io_get_handle(lean_object * hfile) {
+FILE * io_get_handle(lean_object * hfile) {
     return static_cast<FILE *>(lean_get_external_data(hfile));
 }
 
@@ -582,6 +620,27 @@ extern "C" LEAN_EXPORT obj_res lean_io_prim_handle_read(b_obj_arg h, usize nbyte
     }
 }
 
+/* Handle.readInto : (@& Handle) → ByteArray → USize → IO ByteArray */
+extern "C" LEAN_EXPORT obj_res lean_io_prim_handle_read_into(b_obj_arg h, obj_arg buf, usize nbytes, obj_arg /* w */) {
+    FILE * fp = io_get_handle(h);
+    if (!lean_is_exclusive(buf) || lean_sarray_capacity(buf) < nbytes) {
+        dec(buf);
+        buf = lean_alloc_sarray(1, 0, nbytes);
+    }
+    usize n = std::fread(lean_sarray_cptr(buf), 1, nbytes, fp);
+    if (n > 0) {
+        lean_sarray_set_size(buf, n);
+        return io_result_mk_ok(buf);
+    } else if (feof(fp)) {
+        clearerr(fp);
+        lean_sarray_set_size(buf, n);
+        return io_result_mk_ok(buf);
+    } else {
+        dec_ref(buf);
+        return io_result_mk_error(decode_io_error(errno, nullptr));
+    }
+}
+
 /* Handle.write : (@& Handle) → (@& ByteArray) → IO Unit */
 extern "C" LEAN_EXPORT obj_res lean_io_prim_handle_write(b_obj_arg h, b_obj_arg buf, obj_arg /* w */) {
     FILE * fp = io_get_handle(h);
@@ -594,28 +653,124 @@ extern "C" LEAN_EXPORT obj_res lean_io_prim_handle_write(b_obj_arg h, b_obj_arg
     }
 }
 
+/* MappedFile.mk : (@& FilePath) → IO MappedFile */
+extern "C" LEAN_EXPORT obj_res lean_io_mapped_file_mk(b_obj_arg filename, obj_arg /* w */) {
+    io_mapped_file * f = new io_mapped_file();
+#ifdef LEAN_WINDOWS
+    // see `lean_read_module_data`
+    f->m_file = CreateFile(string_cstr(filename), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    LARGE_INTEGER size;
+    if (f->m_file == INVALID_HANDLE_VALUE || !GetFileSizeEx(f->m_file, &size)) {
+        delete f;
+        return io_result_mk_error((sstream() << "failed to open '" << string_cstr(filename) << "': " << GetLastError()).str());
+    }
+    f->m_size = size.QuadPart;
+    if (f->m_size > 0) {
+        f->m_map = CreateFileMapping(f->m_file, NULL, PAGE_READONLY, 0, 0, NULL);
+        f->m_data = f->m_map ? static_cast<char *>(MapViewOfFile(f->m_map, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+        if (!f->m_data) {
+            delete f;
+            return io_result_mk_error((sstream() << "failed to map '" << string_cstr(filename) << "': " << GetLastError()).str());
+        }
+    }
+#else
+    int fd = open(string_cstr(filename), O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd == -1 || fstat(fd, &st) != 0) {
+        int err = errno;
+        if (fd != -1) close(fd);
+        delete f;
+        return io_result_mk_error(decode_io_error(err, filename));
+    }
+    f->m_size = st.st_size;
+    // `mmap` rejects empty mappings
+    if (f->m_size > 0) {
+        void * data = mmap(nullptr, f->m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            int err = errno;
+            close(fd);
+            delete f;
+            return io_result_mk_error(decode_io_error(err, filename));
+        }
+        f->m_data = static_cast<char *>(data);
+    }
+    close(fd);
+#endif
+    return io_result_mk_ok(lean_alloc_external(g_io_mapped_file_external_class, f));
+}
+
+/* MappedFile.size : (@& MappedFile) → Nat */
+extern "C" LEAN_EXPORT obj_res lean_io_mapped_file_size(b_obj_arg f) {
+    return lean_usize_to_nat(io_get_mapped_file(f)->m_size);
+}
+
+/* MappedFile.get : (@& MappedFile) → (@& Nat) → UInt8 */
+extern "C" LEAN_EXPORT uint8 lean_io_mapped_file_get(b_obj_arg f, b_obj_arg i) {
+    io_mapped_file * mf = io_get_mapped_file(f);
+    if (!lean_is_scalar(i) || lean_unbox(i) >= mf->m_size)
+        return 0;
+    return mf->m_data[lean_unbox(i)];
+}
+
+/* MappedFile.getUInt32LE : (@& MappedFile) → (@& Nat) → UInt32 */
+extern "C" LEAN_EXPORT uint32 lean_io_mapped_file_get_uint32_le(b_obj_arg f, b_obj_arg i) {
+    io_mapped_file * mf = io_get_mapped_file(f);
+    if (!lean_is_scalar(i) || mf->m_size < 4 || lean_unbox(i) > mf->m_size - 4)
+        return 0;
+    unsigned char const * p = reinterpret_cast<unsigned char const *>(mf->m_data) + lean_unbox(i);
+    return static_cast<uint32>(p[0]) | (static_cast<uint32>(p[1]) << 8) |
+        (static_cast<uint32>(p[2]) << 16) | (static_cast<uint32>(p[3]) << 24);
+}
+
+/* MappedFile.extract : (@& MappedFile) → (@& Nat) → (@& Nat) → ByteArray */
+extern "C" LEAN_EXPORT obj_res lean_io_mapped_file_extract(b_obj_arg f, b_obj_arg start, b_obj_arg stop) {
+    io_mapped_file * mf = io_get_mapped_file(f);
+    size_t e = lean_is_scalar(stop) ? std::min(lean_unbox(stop), mf->m_size) : mf->m_size;
+    size_t b = lean_is_scalar(start) ? std::min(lean_unbox(start), e) : e;
+    obj_res r = lean_alloc_sarray(1, e - b, e - b);
+    if (e > b)
+        memcpy(lean_sarray_cptr(r), mf->m_data + b, e - b);
+    return r;
+}
+
 /* Handle.getLine : (@& Handle) → IO Unit */
 extern "C" LEAN_EXPORT obj_res lean_io_prim_handle_get_line(b_obj_arg h, obj_arg /* w */) {
     FILE * fp = io_get_handle(h);
 
+#if defined(LEAN_WINDOWS)
     std::string result;
     int c; // Note: int, not char, required to handle EOF
-    while ((c = std::fgetc(fp)) != EOF) {
+    _lock_file(fp);
+    while ((c = _fgetc_nolock(fp)) != EOF) {
         result.push_back(c);
         if (c == '\n') {
             break;
         }
     }
+    _unlock_file(fp);
+    char const * line = result.data();
+    size_t n = result.size();
+#else
+    // `getline` searches for the line break directly in the buffer of `fp` (using `memchr` in glibc) instead of
+    // locking and reading it once per character
+    char * line = nullptr;
+    size_t cap = 0;
+    ssize_t r = getline(&line, &cap, fp);
+    size_t n = r < 0 ? 0 : r;
+#endif
 
+    obj_res ret;
     if (std::ferror(fp)) {
-        return io_result_mk_error(decode_io_error(errno, nullptr));
-    } else if (std::feof(fp)) {
-        clearerr(fp);
-        return io_result_mk_ok(mk_string(result));
+        ret = io_result_mk_error(decode_io_error(errno, nullptr));
     } else {
-        obj_res ret = io_result_mk_ok(mk_string(result));
-        return ret;
+        if (std::feof(fp))
+            clearerr(fp);
+        ret = io_result_mk_ok(lean_mk_string_from_bytes(line, n));
     }
+#if !defined(LEAN_WINDOWS)
+    free(line);
+#endif
+    return ret;
 }
 
 /* Handle.putStr : (@& Handle) → (@& String) → IO Unit */
@@ -736,6 +891,24 @@ extern "C" LEAN_EXPORT obj_res lean_io_allocprof(b_obj_arg msg, obj_arg fn, obj_
     return res;
 }
 
+/* setHeapProfileRate (rate : USize) : BaseIO Unit */
+extern "C" LEAN_EXPORT obj_res lean_io_set_heap_profile_rate(size_t rate, obj_arg /* w */) {
+    set_heap_profile_rate(rate);
+    return io_result_mk_ok(box(0));
+}
+
+/* heapProfileSummary : BaseIO String */
+extern "C" LEAN_EXPORT obj_res lean_io_heap_profile_summary(obj_arg /* w */) {
+    return io_result_mk_ok(mk_string(heap_profile_summary()));
+}
+
+/* heapProfileDump (fname : @& FilePath) : IO Unit */
+extern "C" LEAN_EXPORT obj_res lean_io_heap_profile_dump(b_obj_arg fname, obj_arg /* w */) {
+    if (!heap_profile_dump(string_cstr(fname)))
+        return io_result_mk_error((sstream() << "failed to write heap profile '" << string_cstr(fname) << "'").str());
+    return io_result_mk_ok(box(0));
+}
+
 /* getNumHeartbeats : BaseIO Nat */
 extern "C" LEAN_EXPORT obj_res lean_io_get_num_heartbeats(obj_arg /* w */) {
     return io_result_mk_ok(lean_uint64_to_nat(get_num_heartbeats()));
@@ -747,6 +920,22 @@ extern "C" LEAN_EXPORT obj_res lean_io_add_heartbeats(int64_t count, obj_arg /*
     return io_result_mk_ok(box(0));
 }
 
+/* getTaskAllocatedBytes : BaseIO Nat */
+extern "C" LEAN_EXPORT obj_res lean_io_get_task_allocated_bytes(obj_arg /* w */) {
+    return io_result_mk_ok(lean_uint64_to_nat(lean_io_get_task_allocated_bytes_core()));
+}
+
+/* setTaskMemoryLimit (bytes : UInt64) : BaseIO Unit */
+extern "C" LEAN_EXPORT obj_res lean_io_set_task_memory_limit(uint64_t bytes, obj_arg /* w */) {
+    set_task_memory_limit(bytes);
+    return io_result_mk_ok(box(0));
+}
+
+/* getResidentMemory : BaseIO Nat */
+extern "C" LEAN_EXPORT obj_res lean_io_get_resident_memory(obj_arg /* w */) {
+    return io_result_mk_ok(lean_usize_to_nat(get_allocated_memory()));
+}
+
 extern "C" LEAN_EXPORT obj_res lean_io_getenv(b_obj_arg env_var, obj_arg) {
 #if defined(LEAN_EMSCRIPTEN)
     // HACK(WN): getenv doesn't seem to work in Emscripten even though it should
@@ -839,6 +1028,87 @@ extern "C" LEAN_EXPORT obj_res lean_io_read_dir(b_obj_arg dirname, obj_arg) {
     return io_result_mk_ok(arr);
 }
 
+/* The `FileType` constructor index of `mode`. */
+static uint8 file_type_of_mode(mode_t mode) {
+    return S_ISDIR(mode) ? 0 :
+           S_ISREG(mode) ? 1 :
+#ifndef LEAN_WINDOWS
+           S_ISLNK(mode) ? 2 :
+#endif
+           3;
+}
+
+/*
+Stores the `FileType` of the directory entry `entry` of `dp` in `type`, without following symbolic
+links. The type reported in `d_type` is used where available, so that no `stat` call is necessary on
+most file systems. Returns `0` on success and the `errno` of the failed `stat` call otherwise.
+*/
+static int dir_entry_type(DIR * dp, b_obj_arg dirname, dirent * entry, uint8 & type) {
+#if !defined(LEAN_WINDOWS) && defined(DT_UNKNOWN)
+    (void)dirname;
+    switch (entry->d_type) {
+    case DT_DIR: type = 0; return 0;
+    case DT_REG: type = 1; return 0;
+    case DT_LNK: type = 2; return 0;
+    case DT_UNKNOWN: break;
+    default: type = 3; return 0;
+    }
+    struct stat st;
+    if (fstatat(dirfd(dp), entry->d_name, &st, AT_SYMLINK_NOFOLLOW) != 0)
+        return errno;
+#else
+    (void)dp;
+    std::string path(string_cstr(dirname));
+    path += '/';
+    path += entry->d_name;
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0)
+        return errno;
+#endif
+    type = file_type_of_mode(st.st_mode);
+    return 0;
+}
+
+/* readDirWithFileTypes : @& FilePath → IO (Array (DirEntry × FileType)) */
+extern "C" LEAN_EXPORT obj_res lean_io_read_dir_with_file_types(b_obj_arg dirname, obj_arg) {
+    object * arr = array_mk_empty();
+    DIR * dp = opendir(string_cstr(dirname));
+    if (!dp) {
+        return io_result_mk_error(decode_io_error(errno, dirname));
+    }
+    while (dirent * entry = readdir(dp)) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
+            continue;
+        }
+        uint8 type;
+        if (int err = dir_entry_type(dp, dirname, entry, type)) {
+            if (err == ENOENT) {
+                // entry vanished, ignore
+                continue;
+            }
+            std::string path(string_cstr(dirname));
+            path += '/';
+            path += entry->d_name;
+            lean_always_assert(closedir(dp) == 0);
+            dec(arr);
+            object * fname = mk_string(path);
+            object * ex = decode_io_error(err, fname);
+            dec(fname);
+            return io_result_mk_error(ex);
+        }
+        object * lentry = alloc_cnstr(0, 2, 0);
+        lean_inc(dirname);
+        cnstr_set(lentry, 0, dirname);
+        cnstr_set(lentry, 1, lean_mk_string(entry->d_name));
+        object * pair = alloc_cnstr(0, 2, 0);
+        cnstr_set(pair, 0, lentry);
+        cnstr_set(pair, 1, box(type));
+        arr = lean_array_push(arr, pair);
+    }
+    lean_always_assert(closedir(dp) == 0);
+    return io_result_mk_ok(arr);
+}
+
 /*
 inductive FileType where
   | dir
@@ -884,14 +1154,83 @@ extern "C" LEAN_EXPORT obj_res lean_io_metadata(b_obj_arg fname, obj_arg) {
     cnstr_set(mdata, 1, timespec_to_obj(st.st_mtim));
 #endif
     cnstr_set_uint64(mdata, 2 * sizeof(object *), st.st_size);
-    cnstr_set_uint8(mdata, 2 * sizeof(object *) + sizeof(uint64),
-                    S_ISDIR(st.st_mode) ? 0 :
-                    S_ISREG(st.st_mode) ? 1 :
+    cnstr_set_uint8(mdata, 2 * sizeof(object *) + sizeof(uint64), file_type_of_mode(st.st_mode));
+    return io_result_mk_ok(mdata);
+}
+
+/* Hash of `data` as computed by `hash` on `ByteArray` and `String`, with `\r\n` replaced by `\n` if `text`. */
+static uint64 hash_file_data(uint8 const * data, size_t size, bool text) {
+    if (text && memchr(data, '\r', size)) {
+        std::string normalized;
+        normalized.reserve(size);
+        for (size_t i = 0; i < size; i++) {
+            if (!(data[i] == '\r' && i + 1 < size && data[i + 1] == '\n'))
+                normalized.push_back(data[i]);
+        }
+        return hash_str(normalized.size(), reinterpret_cast<unsigned char const *>(normalized.data()), 11);
+    }
+    return hash_str(size, data, 11);
+}
+
+/* IO.FS.hashFile (fname : @& FilePath) (text : Bool) : IO UInt64 */
+extern "C" LEAN_EXPORT obj_res lean_io_hash_file(b_obj_arg fname, uint8 text, obj_arg) {
+#ifdef LEAN_WINDOWS
+    int fd = open(string_cstr(fname), O_RDONLY | O_BINARY | O_NOINHERIT);
+#else
+    int fd = open(string_cstr(fname), O_RDONLY | O_CLOEXEC);
+#endif
+    if (fd == -1)
+        return io_result_mk_error(decode_io_error(errno, fname));
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        int err = errno;
+        close(fd);
+        return io_result_mk_error(decode_io_error(err, fname));
+    }
+    uint8 const * data = nullptr;
+    size_t size = 0;
+    std::string buf;
 #ifndef LEAN_WINDOWS
-                    S_ISLNK(st.st_mode) ? 2 :
+    void * map = MAP_FAILED;
+    if (S_ISREG(st.st_mode) && st.st_size > 0)
+        map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map != MAP_FAILED) {
+        data = static_cast<uint8 const *>(map);
+        size = st.st_size;
+    } else
 #endif
-                    3);
-    return io_result_mk_ok(mdata);
+    {
+        // not a regular file, or the file could not be mapped
+        char chunk[64 * 1024];
+        while (true) {
+            auto n = read(fd, chunk, sizeof(chunk));
+            if (n < 0) {
+                int err = errno;
+                close(fd);
+                return io_result_mk_error(decode_io_error(err, fname));
+            }
+            if (n == 0)
+                break;
+            buf.append(chunk, n);
+        }
+        data = reinterpret_cast<uint8 const *>(buf.data());
+        size = buf.size();
+    }
+    close(fd);
+    bool valid = true;
+    if (text) {
+        size_t pos = 0, i = 0;
+        valid = validate_utf8(data, size, pos, i);
+    }
+    uint64 h = valid ? hash_file_data(data, size, text) : 0;
+#ifndef LEAN_WINDOWS
+    if (map != MAP_FAILED)
+        munmap(map, st.st_size);
+#endif
+    if (!valid)
+        return io_result_mk_error(lean_mk_io_user_error(mk_string(
+            std::string("Tried to read file '") + string_cstr(fname) + "' containing non UTF-8 data.")));
+    return io_result_mk_ok(box_uint64(h));
 }
 
 extern "C" LEAN_EXPORT obj_res lean_io_create_dir(b_obj_arg p, obj_arg) {
@@ -1081,24 +1420,66 @@ static inline atomic<object*> * mt_ref_val_addr(object * o) {
 */
 static inline bool ref_maybe_mt(b_obj_arg ref) { return lean_is_mt(ref) || lean_is_persistent(ref); }
 
+/*
+  Readers of a multi-threaded ref cannot simply load its value and `inc` it: a writer could remove the value and
+  release its last owning reference in between. Instead, readers announce themselves in a counter of the stripe of
+  the ref while they load and `inc` the value, and writers wait until the readers that may have loaded the old value
+  are gone before releasing it. Readers never wait for each other.
+
+  Each stripe has two counters, selected by its epoch, so that writers only wait for the readers that entered before
+  the write, and cannot be starved by a steady stream of new readers. Writers to refs of the same stripe are
+  serialized while waiting.
+*/
+struct alignas(64) ref_readers {
+    atomic<unsigned> m_epoch{0};
+    atomic<unsigned> m_count[2];
+    mutex            m_writer_mutex;
+    ref_readers() { m_count[0] = 0; m_count[1] = 0; }
+};
+
+#define LEAN_REF_READER_STRIPES 64
+static ref_readers g_ref_readers[LEAN_REF_READER_STRIPES];
+
+static inline ref_readers & get_ref_readers(b_obj_arg ref) {
+    return g_ref_readers[(reinterpret_cast<size_t>(ref) >> 4) % LEAN_REF_READER_STRIPES];
+}
+
+/* Return a new reference to the value of the multi-threaded `ref`, or `nullptr` if it has been taken. */
+static object * mt_ref_read(b_obj_arg ref) {
+    ref_readers & rs = get_ref_readers(ref);
+    unsigned epoch;
+    while (true) {
+        epoch = rs.m_epoch;
+        rs.m_count[epoch]++;
+        if (rs.m_epoch == epoch)
+            break;
+        rs.m_count[epoch]--;
+    }
+    object * val = mt_ref_val_addr(ref)->load();
+    if (val != nullptr)
+        inc(val);
+    rs.m_count[epoch]--;
+    return val;
+}
+
+/* Wait until the readers that may have loaded a value removed from `ref` before this call have taken their
+   reference to it, so that the caller can release the value. */
+static void mt_ref_wait_for_readers(b_obj_arg ref) {
+    ref_readers & rs = get_ref_readers(ref);
+    lock_guard<mutex> lock(rs.m_writer_mutex);
+    unsigned epoch = rs.m_epoch;
+    rs.m_epoch = epoch ^ 1;
+    while (rs.m_count[epoch] != 0)
+        this_thread::yield();
+}
+
 extern "C" LEAN_EXPORT obj_res lean_st_ref_get(b_obj_arg ref, obj_arg) {
     if (ref_maybe_mt(ref)) {
-        atomic<object *> * val_addr = mt_ref_val_addr(ref);
         while (true) {
-            /*
-              We cannot simply read `val` from the ref and `inc` it like in the `else` branch since someone else could
-              write to the ref in between and remove the last owning reference to the object. Instead, we must take
-              ownership of the RC token in the ref via `exchange`, duplicate it, then put one RC token back. */
-            object * val = val_addr->exchange(nullptr);
-            if (val != nullptr) {
-                inc(val);
-                object * tmp = val_addr->exchange(val);
-                if (tmp != nullptr) {
-                    /* this may happen if another thread wrote `ref` */
-                    dec(tmp);
-                }
+            if (object * val = mt_ref_read(ref))
                 return io_result_mk_ok(val);
-            }
+            /* the value has been taken by another thread, wait for it to be put back */
+            this_thread::yield();
         }
     } else {
         object * val = lean_to_ref(ref)->m_value;
@@ -1113,8 +1494,10 @@ extern "C" LEAN_EXPORT obj_res lean_st_ref_take(b_obj_arg ref, obj_arg) {
         atomic<object *> * val_addr = mt_ref_val_addr(ref);
         while (true) {
             object * val = val_addr->exchange(nullptr);
-            if (val != nullptr)
+            if (val != nullptr) {
+                mt_ref_wait_for_readers(ref);
                 return io_result_mk_ok(val);
+            }
         }
     } else {
         object * val = lean_to_ref(ref)->m_value;
@@ -1134,8 +1517,10 @@ extern "C" LEAN_EXPORT obj_res lean_st_ref_set(b_obj_arg ref, obj_arg a, obj_arg
         mark_mt(a);
         atomic<object *> * val_addr = mt_ref_val_addr(ref);
         object * old_a = val_addr->exchange(a);
-        if (old_a != nullptr)
+        if (old_a != nullptr) {
+            mt_ref_wait_for_readers(ref);
             dec(old_a);
+        }
         return io_result_mk_ok(box(0));
     } else {
         if (lean_to_ref(ref)->m_value != nullptr)
@@ -1152,8 +1537,10 @@ extern "C" LEAN_EXPORT obj_res lean_st_ref_swap(b_obj_arg ref, obj_arg a, obj_ar
         atomic<object *> * val_addr = mt_ref_val_addr(ref);
         while (true) {
             object * old_a = val_addr->exchange(a);
-            if (old_a != nullptr)
+            if (old_a != nullptr) {
+                mt_ref_wait_for_readers(ref);
                 return io_result_mk_ok(old_a);
+            }
         }
     } else {
         object * old_a = lean_to_ref(ref)->m_value;
@@ -1164,6 +1551,56 @@ extern "C" LEAN_EXPORT obj_res lean_st_ref_swap(b_obj_arg ref, obj_arg a, obj_ar
     }
 }
 
+/* modifyGetAtomic {σ α β : Type} (r : @& Ref σ α) (f : α → β × α) : ST σ β */
+extern "C" LEAN_EXPORT obj_res lean_st_ref_modify_get_atomic(b_obj_arg ref, obj_arg f, obj_arg) {
+    if (ref_maybe_mt(ref)) {
+        atomic<object *> * val_addr = mt_ref_val_addr(ref);
+        while (true) {
+            object * val = mt_ref_read(ref);
+            if (val == nullptr) {
+                this_thread::yield();
+                continue;
+            }
+            /* We keep a reference to `val` while `f` runs so that it cannot be freed and its address reused, which
+               would make the compare-and-swap below succeed after an intervening write. */
+            inc(val);
+            inc(f);
+            object * p = apply_1(f, val);
+            object * new_val = cnstr_get(p, 1);
+            inc(new_val);
+            mark_mt(new_val);
+            object * expected = val;
+            if (val_addr->compare_exchange_strong(expected, new_val)) {
+                dec(f);
+                object * r = cnstr_get(p, 0);
+                inc(r);
+                dec(p);
+                /* we now own the reference the ref held */
+                dec(val);
+                mt_ref_wait_for_readers(ref);
+                dec(val);
+                return io_result_mk_ok(r);
+            }
+            dec(new_val);
+            dec(p);
+            dec(val);
+            this_thread::yield();
+        }
+    } else {
+        object * val = lean_to_ref(ref)->m_value;
+        lean_assert(val != nullptr);
+        lean_to_ref(ref)->m_value = nullptr;
+        object * p = apply_1(f, val);
+        object * new_val = cnstr_get(p, 1);
+        object * r = cnstr_get(p, 0);
+        inc(new_val);
+        inc(r);
+        dec(p);
+        lean_to_ref(ref)->m_value = new_val;
+        return io_result_mk_ok(r);
+    }
+}
+
 extern "C" LEAN_EXPORT obj_res lean_st_ref_ptr_eq(b_obj_arg ref1, b_obj_arg ref2, obj_arg) {
     // TODO(Leo): ref_maybe_mt
     bool r = lean_to_ref(ref1)->m_value == lean_to_ref(ref2)->m_value;
@@ -1221,6 +1658,19 @@ extern "C" LEAN_EXPORT obj_res lean_io_get_task_state(b_obj_arg t, obj_arg) {
     return io_result_mk_ok(box(lean_io_get_task_state_core(t)));
 }
 
+extern "C" LEAN_EXPORT obj_res lean_io_get_task_manager_stats(obj_arg) {
+    return io_result_mk_ok(lean_io_get_task_manager_stats_core());
+}
+
+extern "C" LEAN_EXPORT obj_res lean_io_start_task_tracing(obj_arg) {
+    lean_io_start_task_tracing_core();
+    return io_result_mk_ok(box(0));
+}
+
+extern "C" LEAN_EXPORT obj_res lean_io_stop_task_tracing(obj_arg) {
+    return io_result_mk_ok(lean_io_stop_task_tracing_core());
+}
+
 extern "C" LEAN_EXPORT obj_res lean_io_wait(obj_arg t, obj_arg) {
     return io_result_mk_ok(lean_task_get_own(t));
 }
@@ -1240,10 +1690,18 @@ void initialize_io() {
     g_io_error_nullptr_read = lean_mk_io_user_error(mk_ascii_string_unchecked("null reference read"));
     mark_persistent(g_io_error_nullptr_read);
     g_io_handle_external_class = lean_register_external_class(io_handle_finalizer, io_handle_foreach);
+    g_io_mapped_file_external_class = lean_register_external_class(io_mapped_file_finalizer, io_mapped_file_foreach);
 #if defined(LEAN_WINDOWS)
     _setmode(_fileno(stdout), _O_BINARY);
     _setmode(_fileno(stderr), _O_BINARY);
     _setmode(_fileno(stdin), _O_BINARY);
+#endif
+#if !defined(LEAN_WINDOWS) && !defined(LEAN_EMSCRIPTEN)
+    /* When stdout is not a terminal, it is already fully buffered, but the default buffer of a few KB
+       turns programs that print a lot into a stream of small `write` calls. Use a larger buffer
+       instead; terminals stay line buffered so that output appears as soon as a line is complete. */
+    if (!isatty(fileno(stdout)))
+        setvbuf(stdout, nullptr, _IOFBF, LEAN_STDOUT_BUFFER_SIZE);
 #endif
     g_stream_stdout = lean_stream_of_handle(io_wrap_handle(stdout));
     mark_persistent(g_stream_stdout);
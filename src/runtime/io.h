@@ -17,6 +17,7 @@ LEAN_EXPORT lean_obj_res io_result_mk_error(std::string const & msg);
 inline lean_obj_res decode_io_error(int errnum, b_lean_obj_arg fname) { return lean_decode_io_error(errnum, fname); }
 inline lean_obj_res decode_uv_error(int errnum, b_lean_obj_arg fname) { return lean_decode_uv_error(errnum, fname); }
 LEAN_EXPORT lean_obj_res io_wrap_handle(FILE * hfile);
+LEAN_EXPORT FILE * io_get_handle(b_lean_obj_arg hfile);
 void initialize_io();
 void finalize_io();
 }
@@ -0,0 +1,113 @@
+/*
+Copyright (c) 2024 Lean FRO, LLC. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+*/
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include "runtime/jobserver.h"
+#if !defined(LEAN_WINDOWS) && !defined(LEAN_EMSCRIPTEN)
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#define LEAN_JOBSERVER
+#endif
+
+/* Interval in milliseconds in which a thread blocked in `jobserver::acquire` checks whether it should stop
+   waiting or can take the implicit token. */
+#define LEAN_JOBSERVER_POLL_MS 10
+
+namespace lean {
+#if defined(LEAN_JOBSERVER)
+jobserver::~jobserver() {
+    if (m_close_read_fd)
+        close(m_read_fd);
+    if (m_close_write_fd)
+        close(m_write_fd);
+}
+
+static bool is_open_fd(int fd) {
+    return fd >= 0 && fcntl(fd, F_GETFD) != -1;
+}
+
+jobserver * jobserver::from_env() {
+    char const * flags = std::getenv("MAKEFLAGS");
+    if (!flags)
+        return nullptr;
+    // the last occurrence wins; `--jobserver-fds` is the name used before GNU make 4.2
+    std::string auth;
+    std::string makeflags(flags);
+    for (char const * opt : {"--jobserver-fds=", "--jobserver-auth="}) {
+        size_t pos = makeflags.rfind(opt);
+        if (pos != std::string::npos) {
+            size_t start = pos + strlen(opt);
+            auth = makeflags.substr(start, makeflags.find(' ', start) - start);
+        }
+    }
+    if (auth.empty())
+        return nullptr;
+    if (auth.compare(0, 5, "fifo:") == 0) {
+        // our own file description, so we can make it non-blocking
+        int fd = open(auth.c_str() + 5, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+        if (fd < 0)
+            return nullptr;
+        return new jobserver(fd, fd, true, false);
+    }
+    int read_fd, write_fd;
+    if (sscanf(auth.c_str(), "%d,%d", &read_fd, &write_fd) != 2)
+        return nullptr;
+    // `make` closes the pipe for commands it does not consider recursive, and the descriptors may have been reused
+    if (!is_open_fd(read_fd) || !is_open_fd(write_fd) ||
+        (fcntl(read_fd, F_GETFL) & O_ACCMODE) == O_WRONLY || (fcntl(write_fd, F_GETFL) & O_ACCMODE) == O_RDONLY)
+        return nullptr;
+    // The pipe is shared with other processes, so setting `O_NONBLOCK` on it would affect them as well. On Linux,
+    // reopening it gives us a file description of our own; otherwise, a read may block after a successful `poll`
+    // if another process takes the token in between.
+    int own_fd = open(("/proc/self/fd/" + std::to_string(read_fd)).c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    if (own_fd >= 0)
+        return new jobserver(own_fd, write_fd, true, false);
+    return new jobserver(read_fd, write_fd, false, false);
+}
+
+int jobserver::acquire(std::function<bool()> const & stop) {
+    while (true) {
+        bool expected = true;
+        if (m_implicit_free.compare_exchange_strong(expected, false))
+            return implicit;
+        if (stop())
+            return untracked;
+        pollfd pfd;
+        pfd.fd      = m_read_fd;
+        pfd.events  = POLLIN;
+        pfd.revents = 0;
+        int r = poll(&pfd, 1, LEAN_JOBSERVER_POLL_MS);
+        if (r < 0 && errno != EINTR)
+            return untracked;
+        if (r <= 0)
+            continue;
+        unsigned char c;
+        ssize_t n = read(m_read_fd, &c, 1);
+        if (n == 1)
+            return c;
+        if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+            return untracked;
+    }
+}
+
+void jobserver::release(int token) {
+    if (token == implicit) {
+        m_implicit_free.store(true);
+    } else if (0 <= token && token < implicit) {
+        unsigned char c = static_cast<unsigned char>(token);
+        while (write(m_write_fd, &c, 1) < 0 && errno == EINTR) {}
+    }
+}
+#else
+jobserver::~jobserver() {}
+jobserver * jobserver::from_env() { return nullptr; }
+int jobserver::acquire(std::function<bool()> const &) { return untracked; }
+void jobserver::release(int) {}
+#endif
+}
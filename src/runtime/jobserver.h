@@ -0,0 +1,41 @@
+/*
+Copyright (c) 2024 Lean FRO, LLC. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+*/
+#pragma once
+#include <atomic>
+#include <functional>
+
+namespace lean {
+/* Client of the GNU make jobserver of a parent `make` (or other build tool implementing its protocol)
+   advertised in `MAKEFLAGS` as `--jobserver-auth=R,W` (inherited pipe) or `--jobserver-auth=fifo:PATH`.
+
+   Each token read from the jobserver allows the process to run one more job in parallel, and must be written
+   back when the job is done. In addition, every process started by `make` owns one implicit token. The task
+   manager makes worker threads hold a token while they run tasks, so that all processes started by the same
+   `make` invocation share its CPU budget. Threads not managed by the task manager, such as the main thread, do
+   not take part. Not supported on Windows, where `make` uses a semaphore instead. */
+class jobserver {
+    int               m_read_fd;
+    int               m_write_fd;
+    bool              m_close_read_fd;
+    bool              m_close_write_fd;
+    std::atomic<bool> m_implicit_free{true};
+    jobserver(int read_fd, int write_fd, bool close_read_fd, bool close_write_fd):
+        m_read_fd(read_fd), m_write_fd(write_fd), m_close_read_fd(close_read_fd), m_close_write_fd(close_write_fd) {}
+public:
+    /* Tokens returned by `acquire`. Tokens read from the jobserver are the bytes `0`-`255`. */
+    static constexpr int none      = -1;
+    static constexpr int untracked = -2;
+    static constexpr int implicit  = 256;
+
+    ~jobserver();
+    /* Returns the jobserver advertised in `MAKEFLAGS`, or `nullptr` if there is none or it is not accessible. */
+    static jobserver * from_env();
+    /* Blocks until a token is available and returns it. Returns `untracked` if `stop` becomes true while
+       waiting, or if the jobserver fails; the caller should then proceed without a token. */
+    int acquire(std::function<bool()> const & stop);
+    /* Returns a token obtained from `acquire`. */
+    void release(int token);
+};
+}
@@ -5,18 +5,242 @@ Released under Apache 2.0 license as described in the file LICENSE.
 Author: Markus Himmel
 */
 #include "runtime/libuv.h"
+#include "runtime/io.h"
 
 #ifndef LEAN_EMSCRIPTEN
 #include <uv.h>
+#include <cstring>
+#include "runtime/object.h"
+#include "runtime/thread.h"
 
 extern "C" LEAN_EXPORT lean_obj_res lean_libuv_version(lean_obj_arg o) {
     return lean_unsigned_to_nat(uv_version());
 }
 
+namespace lean {
+#if defined(LEAN_MULTI_THREAD)
+extern "C" obj_res lean_io_promise_new(obj_arg);
+extern "C" obj_res lean_io_promise_resolve(obj_arg value, b_obj_arg promise, obj_arg);
+
+/* Event loop shared by all asynchronous operations below. It runs on a dedicated thread, started on first use
+   (in particular not before `lean --fork-server` forks, see `util/shell.cpp`), which holds `m_mutex` while
+   running the loop. Other threads modify the loop via `with_event_loop`, which wakes up the loop thread with
+   `m_async` and waits for it to release the mutex. Completion callbacks run on the loop thread and resolve
+   the `IO.Promise` of the operation, so waiting operations occupy no thread. */
+struct event_loop {
+    uv_loop_t          m_loop;
+    uv_async_t         m_async;
+    mutex              m_mutex;
+    condition_variable m_cond;
+    atomic<unsigned>   m_num_waiters;
+    event_loop():m_num_waiters(0) {}
+};
+
+static mutex *      g_event_loop_mutex = new mutex();
+static event_loop * g_event_loop = nullptr;
+
+static void run_event_loop(event_loop * ev) {
+    unique_lock<mutex> lock(ev->m_mutex);
+    while (true) {
+        while (ev->m_num_waiters > 0)
+            ev->m_cond.wait(lock);
+        // the async handle keeps the loop alive, so this blocks until there is an event
+        uv_run(&ev->m_loop, UV_RUN_ONCE);
+    }
+}
+
+static event_loop * get_event_loop() {
+    lock_guard<mutex> lock(*g_event_loop_mutex);
+    if (!g_event_loop) {
+        event_loop * ev = new event_loop();
+        lean_always_assert(uv_loop_init(&ev->m_loop) == 0);
+        // just interrupts `uv_run`, see `with_event_loop`
+        lean_always_assert(uv_async_init(&ev->m_loop, &ev->m_async, [](uv_async_t *) {}) == 0);
+        // never joined, the loop runs until the end of the process
+        new lthread([=]() { run_event_loop(ev); });
+        g_event_loop = ev;
+    }
+    return g_event_loop;
+}
+
+template<typename F> static auto with_event_loop(F && f) -> decltype(f(std::declval<uv_loop_t *>())) {
+    event_loop * ev = get_event_loop();
+    ev->m_num_waiters++;
+    uv_async_send(&ev->m_async);
+    unique_lock<mutex> lock(ev->m_mutex);
+    ev->m_num_waiters--;
+    ev->m_cond.notify_one();
+    return f(&ev->m_loop);
+}
+
+/* Return the `IO.Error` for the libuv error code `err`. */
+static obj_res mk_uv_error(int err, b_obj_arg fname) {
+#if defined(LEAN_WINDOWS)
+    (void)fname;
+    return lean_mk_io_user_error(mk_string(uv_strerror(err)));
+#else
+    // on POSIX systems, libuv errors are negated `errno` values
+    return decode_io_error(-err, fname);
+#endif
+}
+
+static object * mk_promise() {
+    object * r = lean_io_promise_new(io_mk_world());
+    object * p = io_result_get_value(r);
+    inc(p);
+    dec(r);
+    return p;
+}
+
+static void resolve_promise(object * promise, object * value) {
+    dec(lean_io_promise_resolve(value, promise, io_mk_world()));
+    dec(promise);
+}
+
+struct timer_req {
+    uv_timer_t m_timer;
+    object *   m_promise;
+};
+
+/* sleep : UInt64 → IO (IO.Promise Unit) */
+extern "C" LEAN_EXPORT obj_res lean_uv_sleep(uint64_t ms, obj_arg /* w */) {
+    timer_req * t = new timer_req();
+    t->m_promise = mk_promise();
+    inc(t->m_promise);
+    object * promise = t->m_promise;
+    with_event_loop([&](uv_loop_t * loop) {
+        uv_timer_init(loop, &t->m_timer);
+        t->m_timer.data = t;
+        return uv_timer_start(&t->m_timer, [](uv_timer_t * h) {
+            timer_req * t = static_cast<timer_req *>(h->data);
+            resolve_promise(t->m_promise, box(0));
+            uv_close(reinterpret_cast<uv_handle_t *>(h), [](uv_handle_t * h) { delete static_cast<timer_req *>(h->data); });
+        }, ms, 0);
+    });
+    return io_result_mk_ok(promise);
+}
+
+/* State of `lean_uv_read_bin_file`, which chains open, fstat, read and close requests, see `read_file_step`. */
+struct read_file_req {
+    uv_fs_t  m_req;
+    object * m_promise;
+    object * m_fname;
+    uv_file  m_file = -1;
+    object * m_data = nullptr;
+    bool     m_done = false;
+    int      m_err  = 0;
+};
+
+static void read_file_step(read_file_req * r);
+
+static void read_file_finish(read_file_req * r) {
+    // `Except IO.Error ByteArray`
+    object * v;
+    if (r->m_err != 0) {
+        if (r->m_data)
+            dec(r->m_data);
+        v = alloc_cnstr(0, 1, 0);
+        cnstr_set(v, 0, mk_uv_error(r->m_err, r->m_fname));
+    } else {
+        v = alloc_cnstr(1, 1, 0);
+        cnstr_set(v, 0, r->m_data);
+    }
+    resolve_promise(r->m_promise, v);
+    dec(r->m_fname);
+    delete r;
+}
+
+static void read_file_cb(uv_fs_t * req) {
+    read_file_req * r = static_cast<read_file_req *>(req->data);
+    ssize_t res = req->result;
+    uv_fs_type type = req->fs_type;
+    if (type == UV_FS_FSTAT && res >= 0)
+        r->m_data = lean_alloc_sarray(1, 0, req->statbuf.st_size);
+    uv_fs_req_cleanup(req);
+    if (res < 0 && r->m_err == 0) {
+        // report the first error
+        r->m_err = res;
+    } else if (type == UV_FS_OPEN && res >= 0) {
+        r->m_file = res;
+    } else if (type == UV_FS_READ && res >= 0) {
+        lean_sarray_set_size(r->m_data, lean_sarray_size(r->m_data) + res);
+        r->m_done = res == 0;
+    }
+    read_file_step(r);
+}
+
+/* Start the next request of `r`, on the loop thread or while holding the loop's mutex. */
+static void read_file_step(read_file_req * r) {
+    uv_loop_t * loop = &g_event_loop->m_loop;
+    r->m_req.data = r;
+    int err;
+    if (r->m_err != 0 || r->m_done) {
+        if (r->m_file < 0) {
+            read_file_finish(r);
+            return;
+        }
+        err = uv_fs_close(loop, &r->m_req, r->m_file, read_file_cb);
+        r->m_file = -1;
+    } else if (r->m_file < 0) {
+        err = uv_fs_open(loop, &r->m_req, string_cstr(r->m_fname), UV_FS_O_RDONLY, 0, read_file_cb);
+    } else if (!r->m_data) {
+        err = uv_fs_fstat(loop, &r->m_req, r->m_file, read_file_cb);
+    } else {
+        size_t sz = lean_sarray_size(r->m_data);
+        if (sz == lean_sarray_capacity(r->m_data)) {
+            // the file is larger than reported by `fstat`, or we have not seen the end of it yet
+            object * data = lean_alloc_sarray(1, sz, sz < 4096 ? 4096 : 2 * sz);
+            memcpy(lean_sarray_cptr(data), lean_sarray_cptr(r->m_data), sz);
+            dec(r->m_data);
+            r->m_data = data;
+        }
+        uv_buf_t buf = uv_buf_init(reinterpret_cast<char *>(lean_sarray_cptr(r->m_data)) + sz,
+                                   lean_sarray_capacity(r->m_data) - sz);
+        err = uv_fs_read(loop, &r->m_req, r->m_file, &buf, 1, -1, read_file_cb);
+    }
+    if (err < 0) {
+        // the request was not started, so continue with the error
+        uv_fs_req_cleanup(&r->m_req);
+        if (r->m_err == 0)
+            r->m_err = err;
+        read_file_step(r);
+    }
+}
+
+/* readBinFile : @& FilePath → IO (IO.Promise (Except IO.Error ByteArray)) */
+extern "C" LEAN_EXPORT obj_res lean_uv_read_bin_file(b_obj_arg fname, obj_arg /* w */) {
+    read_file_req * r = new read_file_req();
+    r->m_promise = mk_promise();
+    inc(r->m_promise);
+    inc(fname);
+    r->m_fname = fname;
+    object * promise = r->m_promise;
+    with_event_loop([&](uv_loop_t *) { read_file_step(r); return 0; });
+    return io_result_mk_ok(promise);
+}
+#else
+extern "C" LEAN_EXPORT obj_res lean_uv_sleep(uint64_t, obj_arg) {
+    return io_result_mk_error("asynchronous I/O requires multi-threading support");
+}
+
+extern "C" LEAN_EXPORT obj_res lean_uv_read_bin_file(b_obj_arg, obj_arg) {
+    return io_result_mk_error("asynchronous I/O requires multi-threading support");
+}
+#endif
+}
+
 #else
 
 extern "C" LEAN_EXPORT lean_obj_res lean_libuv_version(lean_obj_arg o) {
     return lean_box(0);
 }
 
+extern "C" LEAN_EXPORT lean_obj_res lean_uv_sleep(uint64_t, lean_obj_arg) {
+    return lean::io_result_mk_error("asynchronous I/O is not supported on this platform");
+}
+
+extern "C" LEAN_EXPORT lean_obj_res lean_uv_read_bin_file(b_lean_obj_arg, lean_obj_arg) {
+    return lean::io_result_mk_error("asynchronous I/O is not supported on this platform");
+}
+
 #endif
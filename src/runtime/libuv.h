@@ -8,3 +8,5 @@ Author: Markus Himmel
 #include <lean/lean.h>
 
 extern "C" LEAN_EXPORT lean_obj_res lean_libuv_version(lean_obj_arg);
+extern "C" LEAN_EXPORT lean_obj_res lean_uv_sleep(uint64_t ms, lean_obj_arg);
+extern "C" LEAN_EXPORT lean_obj_res lean_uv_read_bin_file(b_lean_obj_arg fname, lean_obj_arg);
@@ -4,6 +4,7 @@ Released under Apache 2.0 license as described in the file LICENSE.
 
 Author: Leonardo de Moura, Mac Malone
 */
+#include <atomic>
 #include "runtime/io.h"
 #include "runtime/object.h"
 #include "runtime/sstream.h"
@@ -17,6 +18,16 @@ Author: Leonardo de Moura, Mac Malone
 #endif
 
 namespace lean {
+static std::atomic<unsigned> g_dynlib_generation(0);
+
+unsigned dynlib_generation() {
+    return g_dynlib_generation.load(std::memory_order_acquire);
+}
+
+void note_dynlib_loaded() {
+    g_dynlib_generation.fetch_add(1, std::memory_order_acq_rel);
+}
+
 void load_dynlib(std::string path) {
 #ifdef LEAN_WINDOWS
     HMODULE h = LoadLibrary(path.c_str());
@@ -29,6 +40,7 @@ void load_dynlib(std::string path) {
         throw exception(sstream() << "error loading library, " << dlerror());
     }
 #endif
+    note_dynlib_loaded();
     // NOTE: we never unload libraries
 }
 
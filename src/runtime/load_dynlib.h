@@ -9,4 +9,9 @@ Author: Mac Malone
 
 namespace lean {
 LEAN_EXPORT void load_dynlib(std::string path);
+/* Number of libraries loaded into the process so far by `load_dynlib` or `note_dynlib_loaded`. Caches of symbol
+   lookups in the current process must be invalidated when it changes. */
+LEAN_EXPORT unsigned dynlib_generation();
+/* Should be called after loading a library without going through `load_dynlib`. */
+LEAN_EXPORT void note_dynlib_loaded();
 }
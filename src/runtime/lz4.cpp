@@ -0,0 +1,133 @@
+/*
+Copyright (c) 2024 Lean FRO, LLC. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+*/
+#include <cstring>
+#include <vector>
+#include "runtime/lz4.h"
+
+#define LEAN_LZ4_MIN_MATCH     4
+#define LEAN_LZ4_HASH_LOG      16
+#define LEAN_LZ4_MAX_OFFSET    65535
+// the last match must start at least 12 bytes before the end of the block
+#define LEAN_LZ4_MF_LIMIT      12
+// ... and the last 5 bytes are always literals
+#define LEAN_LZ4_LAST_LITERALS 5
+
+namespace lean {
+static inline uint32_t read32(uint8_t const * p) {
+    uint32_t r;
+    memcpy(&r, p, sizeof(r));
+    return r;
+}
+
+static inline uint32_t lz4_hash(uint32_t v) {
+    return (v * 2654435761u) >> (32 - LEAN_LZ4_HASH_LOG);
+}
+
+static inline uint8_t * write_length(uint8_t * op, size_t len) {
+    while (len >= 255) {
+        *op++ = 255;
+        len -= 255;
+    }
+    *op++ = static_cast<uint8_t>(len);
+    return op;
+}
+
+static uint8_t * write_sequence(uint8_t * op, uint8_t const * lit, size_t lit_len, size_t offset, size_t match_len) {
+    uint8_t * token = op++;
+    *token = static_cast<uint8_t>((lit_len >= 15 ? 15 : lit_len) << 4);
+    if (lit_len >= 15)
+        op = write_length(op, lit_len - 15);
+    memcpy(op, lit, lit_len);
+    op += lit_len;
+    if (match_len == 0)
+        return op; // last sequence
+    *op++ = static_cast<uint8_t>(offset);
+    *op++ = static_cast<uint8_t>(offset >> 8);
+    match_len -= LEAN_LZ4_MIN_MATCH;
+    *token |= static_cast<uint8_t>(match_len >= 15 ? 15 : match_len);
+    if (match_len >= 15)
+        op = write_length(op, match_len - 15);
+    return op;
+}
+
+size_t lz4_compress(uint8_t const * src, size_t n, uint8_t * dst) {
+    uint8_t * op  = dst;
+    size_t anchor = 0;
+    if (n > LEAN_LZ4_MF_LIMIT) {
+        // positions of the last occurrence of each hashed 4-byte sequence
+        std::vector<uint32_t> table(static_cast<size_t>(1) << LEAN_LZ4_HASH_LOG, 0);
+        size_t limit       = n - LEAN_LZ4_MF_LIMIT;
+        size_t match_limit = n - LEAN_LZ4_LAST_LITERALS;
+        size_t ip          = 1;
+        while (ip < limit) {
+            uint32_t seq = read32(src + ip);
+            uint32_t h   = lz4_hash(seq);
+            size_t ref   = table[h];
+            table[h]     = static_cast<uint32_t>(ip);
+            if (ref < ip && ip - ref <= LEAN_LZ4_MAX_OFFSET && read32(src + ref) == seq) {
+                size_t len = LEAN_LZ4_MIN_MATCH;
+                while (ip + len < match_limit && src[ref + len] == src[ip + len])
+                    len++;
+                op     = write_sequence(op, src + anchor, ip - anchor, ip - ref, len);
+                ip    += len;
+                anchor = ip;
+            } else {
+                ip++;
+            }
+        }
+    }
+    op = write_sequence(op, src + anchor, n - anchor, 0, 0);
+    return op - dst;
+}
+
+static inline bool read_length(uint8_t const * & ip, uint8_t const * end, size_t & len) {
+    uint8_t b;
+    do {
+        if (ip == end)
+            return false;
+        b    = *ip++;
+        len += b;
+    } while (b == 255);
+    return true;
+}
+
+bool lz4_decompress(uint8_t const * src, size_t n, uint8_t * dst, size_t raw_size) {
+    uint8_t const * ip  = src;
+    uint8_t const * end = src + n;
+    size_t op = 0;
+    while (ip < end) {
+        uint8_t token  = *ip++;
+        size_t lit_len = token >> 4;
+        if (lit_len == 15 && !read_length(ip, end, lit_len))
+            return false;
+        if (lit_len > static_cast<size_t>(end - ip) || lit_len > raw_size - op)
+            return false;
+        memcpy(dst + op, ip, lit_len);
+        ip += lit_len;
+        op += lit_len;
+        if (ip == end)
+            break; // last sequence has no match
+        if (end - ip < 2)
+            return false;
+        size_t offset = ip[0] | (static_cast<size_t>(ip[1]) << 8);
+        ip += 2;
+        if (offset == 0 || offset > op)
+            return false;
+        size_t match_len = token & 15;
+        if (match_len == 15 && !read_length(ip, end, match_len))
+            return false;
+        match_len += LEAN_LZ4_MIN_MATCH;
+        if (match_len > raw_size - op)
+            return false;
+        // the match may overlap the output, so we copy byte by byte
+        uint8_t * d       = dst + op;
+        uint8_t const * s = d - offset;
+        for (size_t i = 0; i < match_len; i++)
+            d[i] = s[i];
+        op += match_len;
+    }
+    return op == raw_size;
+}
+}
@@ -0,0 +1,21 @@
+/*
+Copyright (c) 2024 Lean FRO, LLC. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+*/
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <lean/lean.h>
+
+namespace lean {
+/* A small, dependency-free codec for the LZ4 block format, used for compressed `.olean` files. */
+
+/* Maximum size of the compressed form of `n` bytes. */
+inline size_t lz4_compress_bound(size_t n) { return n + n / 255 + 16; }
+/* Compress `n` bytes at `src` into `dst`, which must have room for `lz4_compress_bound(n)` bytes.
+   Return the size of the compressed block. */
+LEAN_EXPORT size_t lz4_compress(uint8_t const * src, size_t n, uint8_t * dst);
+/* Decompress the block of `n` bytes at `src` into exactly `raw_size` bytes at `dst`.
+   Return `false` if the block is malformed. */
+LEAN_EXPORT bool lz4_decompress(uint8_t const * src, size_t n, uint8_t * dst, size_t raw_size);
+}
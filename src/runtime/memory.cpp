@@ -10,6 +10,7 @@ Author: Leonardo de Moura
 #include "runtime/exception.h"
 #include "runtime/memory.h"
 #include "runtime/thread.h"
+#include "runtime/alloc.h"
 
 #ifndef LEAN_CHECK_MEM_THRESHOLD
 #define LEAN_CHECK_MEM_THRESHOLD 200
@@ -35,7 +36,10 @@ size_t get_peak_rss() {
 }
 
 size_t get_current_rss() {
-    return get_peak_rss();
+    // empty segments of the small object allocator are still allocated from jemalloc's point of view
+    size_t allocated   = get_peak_rss();
+    size_t decommitted = get_decommitted_memory();
+    return allocated > decommitted ? allocated - decommitted : 0;
 }
 
 }
@@ -130,10 +134,11 @@ void throw_memory_exception(char const * component_name) {
 }
 
 void check_memory(char const * component_name) {
-    if (g_max_memory == 0) return;
     g_counter++;
     if (g_counter >= LEAN_CHECK_MEM_THRESHOLD) {
         g_counter = 0;
+        check_task_memory();
+        if (g_max_memory == 0) return;
         // We try first get_peak_rss because it is much faster
         // than get_current_rss on Linux.
         size_t r = get_peak_rss();
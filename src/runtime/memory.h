@@ -14,5 +14,11 @@ LEAN_EXPORT void set_max_memory(size_t max);
 /** \brief Set maximum amount of memory in megabytes */
 LEAN_EXPORT void set_max_memory_megabyte(unsigned max);
 LEAN_EXPORT void check_memory(char const * component_name);
+/** \brief Set a soft limit in bytes on the allocations of each task together with the tasks it spawned, `0` for no limit.
+    Tasks exceeding it are canceled by `check_task_memory`. */
+LEAN_EXPORT void set_task_memory_limit(uint64_t max);
+/** \brief Charge the recent allocations of the current thread to the current task, and cancel it if it exceeds
+    the limit set by `set_task_memory_limit`. Also invoked by `check_memory`. */
+LEAN_EXPORT void check_task_memory();
 LEAN_EXPORT size_t get_allocated_memory();
 }
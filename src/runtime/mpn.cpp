@@ -86,11 +86,10 @@ void mpn_sub(mpn_digit const * a, size_t const lnga,
     }
 }
 
-void mpn_mul(mpn_digit const * a, size_t const lnga,
-             mpn_digit const * b, size_t const lngb,
-             mpn_digit * c) {
+static void mpn_mul_basecase(mpn_digit const * a, size_t const lnga,
+                             mpn_digit const * b, size_t const lngb,
+                             mpn_digit * c) {
     // Essentially Knuth's Algorithm M.
-    // Perhaps implement a more efficient version, see e.g., Knuth, Section 4.3.3.
     size_t i;
     mpn_digit k;
 
@@ -148,6 +147,105 @@ public:
     }
 };
 
+// c[0..lngc) += x[0..lngx), the sum must fit in lngc digits.
+static void mpn_add_to(mpn_digit * c, size_t const lngc, mpn_digit const * x, size_t const lngx) {
+    lean_assert(lngx <= lngc);
+    mpn_double_digit k = 0;
+    size_t i = 0;
+    for (; i < lngx; i++) {
+        k += (mpn_double_digit)c[i] + (mpn_double_digit)x[i];
+        c[i] = (mpn_digit)k;
+        k >>= DIGIT_BITS;
+    }
+    for (; k != 0 && i < lngc; i++) {
+        k += (mpn_double_digit)c[i];
+        c[i] = (mpn_digit)k;
+        k >>= DIGIT_BITS;
+    }
+    lean_assert(k == 0);
+}
+
+// c[0..lngc) -= x[0..lngx), the difference must not be negative.
+static void mpn_sub_from(mpn_digit * c, size_t const lngc, mpn_digit const * x, size_t const lngx) {
+    lean_assert(lngx <= lngc);
+    mpn_digit borrow = 0;
+    size_t i = 0;
+    for (; i < lngx; i++) {
+        mpn_double_digit t = (mpn_double_digit)c[i] - (mpn_double_digit)x[i] - borrow;
+        c[i]   = (mpn_digit)t;
+        borrow = (t >> DIGIT_BITS) != 0;
+    }
+    for (; borrow && i < lngc; i++) {
+        borrow = c[i] == 0;
+        c[i]--;
+    }
+    lean_assert(!borrow);
+}
+
+static size_t mpn_trim(mpn_digit const * a, size_t lng) {
+    while (lng > 0 && a[lng-1] == 0) lng--;
+    return lng;
+}
+
+// Below this number of digits in the shorter operand, Karatsuba multiplication is slower than the basecase.
+#define KARATSUBA_THRESHOLD 32
+
+// Karatsuba multiplication (Knuth, Section 4.3.3), with `lnga >= lngb`. Writes all `lnga + lngb` digits of `c`.
+static void mpn_mul_karatsuba(mpn_digit const * a, size_t const lnga,
+                              mpn_digit const * b, size_t const lngb,
+                              mpn_digit * c) {
+    lean_assert(lnga >= lngb);
+    if (lngb < KARATSUBA_THRESHOLD) {
+        mpn_mul_basecase(a, lnga, b, lngb, c);
+        return;
+    }
+    if (2 * lngb <= lnga) {
+        // Unbalanced operands: multiply `b` by `lngb`-sized chunks of `a`.
+        for (size_t i = 0; i < lnga + lngb; i++)
+            c[i] = 0;
+        mpn_buffer t(2 * lngb);
+        for (size_t i = 0; i < lnga; i += lngb) {
+            size_t l = lnga - i < lngb ? lnga - i : lngb;
+            if (l >= lngb)
+                mpn_mul_karatsuba(a + i, l, b, lngb, t.data());
+            else
+                mpn_mul_karatsuba(b, lngb, a + i, l, t.data());
+            mpn_add_to(c + i, lnga + lngb - i, t.data(), mpn_trim(t.data(), l + lngb));
+        }
+        return;
+    }
+    // a = a1*B^h + a0, b = b1*B^h + b0, and a*b = z2*B^2h + z1*B^h + z0 where
+    // z0 = a0*b0, z2 = a1*b1 and z1 = (a0+a1)*(b0+b1) - z0 - z2.
+    size_t h    = lnga / 2;
+    size_t lng1 = lnga - h;
+    size_t lngb1 = lngb - h;
+    mpn_mul_karatsuba(a, h, b, h, c);
+    mpn_mul_karatsuba(a + h, lng1, b + h, lngb1, c + 2*h);
+    size_t lsa = lng1 + 1;
+    size_t lsb = (lngb1 > h ? lngb1 : h) + 1;
+    mpn_buffer sa(lsa), sb(lsb), z1(lsa + lsb);
+    for (size_t i = 0; i < lng1; i++) sa[i] = a[h + i];
+    mpn_add_to(sa.data(), lsa, a, h);
+    for (size_t i = 0; i < h; i++) sb[i] = b[i];
+    mpn_add_to(sb.data(), lsb, b + h, lngb1);
+    mpn_mul_karatsuba(sa.data(), lsa, sb.data(), lsb, z1.data());
+    mpn_sub_from(z1.data(), lsa + lsb, c, 2*h);
+    mpn_sub_from(z1.data(), lsa + lsb, c + 2*h, lng1 + lngb1);
+    mpn_add_to(c + h, lnga + lngb - h, z1.data(), mpn_trim(z1.data(), lsa + lsb));
+}
+
+void mpn_mul(mpn_digit const * a, size_t const lnga,
+             mpn_digit const * b, size_t const lngb,
+             mpn_digit * c) {
+    if (lnga < KARATSUBA_THRESHOLD || lngb < KARATSUBA_THRESHOLD)
+        mpn_mul_basecase(a, lnga, b, lngb, c);
+    else if (lnga >= lngb)
+        mpn_mul_karatsuba(a, lnga, b, lngb, c);
+    else
+        mpn_mul_karatsuba(b, lngb, a, lnga, c);
+}
+
+
 static size_t div_normalize(mpn_digit const * numer, size_t const lnum,
                             mpn_digit const * denom, size_t const lden,
                             mpn_buffer & n_numer,
@@ -7,6 +7,7 @@ Author: Leonardo de Moura
 #include <memory>
 #include <string>
 #include <cstring>
+#include <vector>
 #include "runtime/sstream.h"
 #include "runtime/buffer.h"
 #include "runtime/alloc.h"
@@ -323,20 +324,21 @@ void mpz::init() {
     m_digits[0] = 0;
 }
 
+static mpz decimal_to_mpz(char const * s, size_t len);
+
 void mpz::init_str(char const * v) {
-    init();
     char const * str = v;
     bool sign = false;
     while (str[0] == ' ') ++str;
     if (str[0] == '-')
         sign = true;
-    while (str[0]) {
-        if ('0' <= str[0] && str[0] <= '9') {
-            operator*=(10);
-            operator+=(static_cast<unsigned>(str[0] - '0'));
-        }
-        ++str;
+    std::string digits;
+    for (; str[0]; ++str) {
+        if ('0' <= str[0] && str[0] <= '9')
+            digits += str[0];
     }
+    mpz r = decimal_to_mpz(digits.data(), digits.size());
+    init_mpz(r);
     if (sign)
         neg();
 }
@@ -993,9 +995,173 @@ void gcd(mpz & g, mpz const & a, mpz const & b) {
     }
 }
 
+/*
+Conversion between decimal strings and numbers of more than `LEAN_MPZ_DC_BITS` bits splits the
+number at a power `10^(9*2^i)`, so that the work is dominated by a few multiplications of large
+numbers, which use Karatsuba multiplication. Division by the power is done by multiplying with a
+reciprocal computed by Newton iteration. Smaller numbers are converted 9 digits at a time.
+*/
+#define LEAN_MPZ_DC_BITS 2048
+#define LEAN_MPZ_DC_DIGITS 600
+#define LEAN_MPZ_NEWTON_BITS 512
+
+static unsigned const g_chunk_digits = 9;
+static unsigned const g_chunk        = 1000000000u;
+
+/* The powers `10^(9*2^i)` used to split numbers, and lazily computed reciprocals. */
+struct decimal_power {
+    mpz    m_value;
+    size_t m_num_digits;
+    size_t m_bits = 0;
+    mpz    m_recip;
+    decimal_power(mpz value, size_t num_digits):m_value(std::move(value)), m_num_digits(num_digits) {}
+};
+
+/* Return `floor(2^(2k) / d)`, where `d` has `k` bits. */
+static mpz reciprocal(mpz const & d, size_t k) {
+    mpz p;
+    mul2k(p, mpz(1), 2*k);
+    if (k <= LEAN_MPZ_NEWTON_BITS) {
+        p /= d;
+        return p;
+    }
+    /* approximate from the reciprocal of the `h` high bits of `d`, then take one Newton step */
+    size_t h = k/2 + 8;
+    mpz d_hi;
+    div2k(d_hi, d, k - h);
+    mpz x;
+    mul2k(x, reciprocal(d_hi, h), k - h);
+    mpz e = p - d * x;
+    mpz t;
+    if (e.is_neg()) {
+        div2k(t, x * abs(e), 2*k);
+        x -= t;
+    } else {
+        div2k(t, x * e, 2*k);
+        x += t;
+    }
+    /* fix up the remaining error of a few units */
+    mpz r = p - d * x;
+    while (r.is_neg()) { x -= 1u; r += d; }
+    while (r >= d) { x += 1u; r -= d; }
+    return x;
+}
+
+static decimal_power const & get_recip(decimal_power & p) {
+    if (p.m_bits == 0) {
+        p.m_bits  = p.m_value.log2() + 1;
+        p.m_recip = reciprocal(p.m_value, p.m_bits);
+    }
+    return p;
+}
+
+/* `q, r := n / p, n % p` for `n < p^2`. */
+static void divmod(mpz const & n, decimal_power & p, mpz & q, mpz & r) {
+    get_recip(p);
+    div2k(q, n * p.m_recip, 2*p.m_bits);
+    r = n - q * p.m_value;
+    while (r.is_neg()) { q -= 1u; r += p.m_value; }
+    while (r >= p.m_value) { q += 1u; r -= p.m_value; }
+}
+
+static void small_to_decimal(mpz n, size_t width, std::string & out) {
+    buffer<unsigned> chunks;
+    while (!n.is_zero()) {
+        mpz q = n;
+        q /= g_chunk;
+        chunks.push_back((n - q * g_chunk).get_unsigned_int());
+        n = std::move(q);
+    }
+    std::string s;
+    char buf[16];
+    for (size_t i = chunks.size(); i-- > 0;) {
+        snprintf(buf, sizeof(buf), i + 1 == chunks.size() ? "%u" : "%09u", chunks[i]);
+        s += buf;
+    }
+    if (s.size() < width)
+        out.append(width - s.size(), '0');
+    out += s;
+}
+
+/* Append the decimal digits of `n < powers[i]^2` to `out`, padded with zeros to `width` if it is not zero. */
+static void to_decimal(mpz const & n, int i, size_t width, std::vector<decimal_power> & powers, std::string & out) {
+    if (width == 0) {
+        while (i >= 0 && n < powers[i].m_value) i--;
+    }
+    if (i < 0 || n.log2() < LEAN_MPZ_DC_BITS) {
+        small_to_decimal(n, width, out);
+        return;
+    }
+    decimal_power & p = powers[i];
+    mpz q, r;
+    divmod(n, p, q, r);
+    to_decimal(q, i - 1, width == 0 ? 0 : width - p.m_num_digits, powers, out);
+    to_decimal(r, i - 1, p.m_num_digits, powers, out);
+}
+
+static std::string mpz_to_decimal(mpz const & n) {
+    lean_assert(n.is_pos());
+    std::vector<decimal_power> powers;
+    powers.push_back(decimal_power{mpz(g_chunk), g_chunk_digits});
+    while (true) {
+        decimal_power const & p = powers.back();
+        mpz sq = p.m_value * p.m_value;
+        if (sq > n) break;
+        powers.push_back(decimal_power{std::move(sq), 2 * p.m_num_digits});
+    }
+    std::string out;
+    to_decimal(n, powers.size() - 1, 0, powers, out);
+    return out;
+}
+
+static mpz small_decimal_to_mpz(char const * s, size_t len) {
+    mpz r;
+    size_t i = 0;
+    while (i < len) {
+        size_t l = std::min<size_t>(g_chunk_digits, len - i);
+        unsigned chunk = 0, scale = 1;
+        for (size_t j = 0; j < l; j++) {
+            chunk = chunk * 10 + (s[i + j] - '0');
+            scale *= 10;
+        }
+        r *= scale;
+        r += chunk;
+        i += l;
+    }
+    return r;
+}
+
+static mpz decimal_to_mpz(char const * s, size_t len, std::vector<decimal_power> const & powers) {
+    if (len <= LEAN_MPZ_DC_DIGITS)
+        return small_decimal_to_mpz(s, len);
+    size_t i = 0;
+    while (i + 1 < powers.size() && powers[i + 1].m_num_digits < len) i++;
+    size_t w = powers[i].m_num_digits;
+    mpz r = decimal_to_mpz(s, len - w, powers);
+    r *= powers[i].m_value;
+    r += decimal_to_mpz(s + len - w, w, powers);
+    return r;
+}
+
+static mpz decimal_to_mpz(char const * s, size_t len) {
+    if (len <= LEAN_MPZ_DC_DIGITS)
+        return small_decimal_to_mpz(s, len);
+    std::vector<decimal_power> powers;
+    powers.push_back(decimal_power{mpz(g_chunk), g_chunk_digits});
+    while (2 * powers.back().m_num_digits < len) {
+        decimal_power const & p = powers.back();
+        powers.push_back(decimal_power{p.m_value * p.m_value, 2 * p.m_num_digits});
+    }
+    return decimal_to_mpz(s, len, powers);
+}
+
 std::ostream & operator<<(std::ostream & out, mpz const & v) {
     if (v.m_sign)
         out << "-";
+    if (v.log2() >= LEAN_MPZ_DC_BITS) {
+        out << mpz_to_decimal(abs(v));
+        return out;
+    }
     buffer<char, 1024> tmp;
     tmp.resize(11*v.m_size, 0);
     out << mpn_to_string(v.m_digits, v.m_size, tmp.begin(), tmp.size());
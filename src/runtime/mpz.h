@@ -207,43 +207,43 @@ public:
     mpz & operator/=(int u) { return operator/=(mpz(u)); } // TODO(Leo): improve
 
     mpz & operator%=(mpz const & o);
-    friend mpz rem(mpz const & a, mpz const & b) { mpz r(a); return r %= b; }
+    friend mpz rem(mpz const & a, mpz const & b) { mpz r(a); r %= b; return r; }
 
     mpz pow(unsigned int exp) const;
 
-    friend mpz operator+(mpz a, mpz const & b) { return a += b; }
-    friend mpz operator+(mpz a, unsigned b)  { return a += b; }
-    friend mpz operator+(mpz a, uint64 b)  { return a += b; }
-    friend mpz operator+(mpz a, int b)  { return a += b; }
-    friend mpz operator+(unsigned a, mpz b) { return b += a; }
-    friend mpz operator+(uint64 a, mpz b) { return b += a; }
-    friend mpz operator+(int a, mpz b) { return b += a; }
-
-    friend mpz operator-(mpz a, mpz const & b) { return a -= b; }
-    friend mpz operator-(mpz a, unsigned b) { return a -= b; }
-    friend mpz operator-(mpz a, uint64 b) { return a -= b; }
-    friend mpz operator-(mpz a, int b) { return a -= b; }
-    friend mpz operator-(unsigned a, mpz b) { b.neg(); return b += a; }
-    friend mpz operator-(uint64 a, mpz b) { b.neg(); return b += a; }
-    friend mpz operator-(int a, mpz b) { b.neg(); return b += a; }
-
-    friend mpz operator*(mpz a, mpz const & b) { return a *= b; }
-    friend mpz operator*(mpz a, unsigned b) { return a *= b; }
-    friend mpz operator*(mpz a, uint64 b) { return a *= b; }
-    friend mpz operator*(mpz a, int b) { return a *= b; }
-    friend mpz operator*(unsigned a, mpz b) { return b *= a; }
-    friend mpz operator*(uint64 a, mpz b) { return b *= a; }
-    friend mpz operator*(int a, mpz b) { return b *= a; }
-
-    friend mpz operator/(mpz a, mpz const & b) { return a /= b; }
-    friend mpz operator/(mpz a, unsigned b) { return a /= b; }
-    friend mpz operator/(mpz a, uint64 b) { return a /= b; }
-    friend mpz operator/(mpz a, int b) { return a /= b; }
-    friend mpz operator/(unsigned a, mpz const & b) { mpz r(a); return r /= b; }
-    friend mpz operator/(uint64 a, mpz const & b) { mpz r(a); return r /= b; }
-    friend mpz operator/(int a, mpz const & b) { mpz r(a); return r /= b; }
-
-    friend mpz operator%(mpz a, mpz const & b) { return a %= b; }
+    friend mpz operator+(mpz a, mpz const & b) { a += b; return a; }
+    friend mpz operator+(mpz a, unsigned b)  { a += b; return a; }
+    friend mpz operator+(mpz a, uint64 b)  { a += b; return a; }
+    friend mpz operator+(mpz a, int b)  { a += b; return a; }
+    friend mpz operator+(unsigned a, mpz b) { b += a; return b; }
+    friend mpz operator+(uint64 a, mpz b) { b += a; return b; }
+    friend mpz operator+(int a, mpz b) { b += a; return b; }
+
+    friend mpz operator-(mpz a, mpz const & b) { a -= b; return a; }
+    friend mpz operator-(mpz a, unsigned b) { a -= b; return a; }
+    friend mpz operator-(mpz a, uint64 b) { a -= b; return a; }
+    friend mpz operator-(mpz a, int b) { a -= b; return a; }
+    friend mpz operator-(unsigned a, mpz b) { b.neg(); b += a; return b; }
+    friend mpz operator-(uint64 a, mpz b) { b.neg(); b += a; return b; }
+    friend mpz operator-(int a, mpz b) { b.neg(); b += a; return b; }
+
+    friend mpz operator*(mpz a, mpz const & b) { a *= b; return a; }
+    friend mpz operator*(mpz a, unsigned b) { a *= b; return a; }
+    friend mpz operator*(mpz a, uint64 b) { a *= b; return a; }
+    friend mpz operator*(mpz a, int b) { a *= b; return a; }
+    friend mpz operator*(unsigned a, mpz b) { b *= a; return b; }
+    friend mpz operator*(uint64 a, mpz b) { b *= a; return b; }
+    friend mpz operator*(int a, mpz b) { b *= a; return b; }
+
+    friend mpz operator/(mpz a, mpz const & b) { a /= b; return a; }
+    friend mpz operator/(mpz a, unsigned b) { a /= b; return a; }
+    friend mpz operator/(mpz a, uint64 b) { a /= b; return a; }
+    friend mpz operator/(mpz a, int b) { a /= b; return a; }
+    friend mpz operator/(unsigned a, mpz const & b) { mpz r(a); r /= b; return r; }
+    friend mpz operator/(uint64 a, mpz const & b) { mpz r(a); r /= b; return r; }
+    friend mpz operator/(int a, mpz const & b) { mpz r(a); r /= b; return r; }
+
+    friend mpz operator%(mpz a, mpz const & b) { a %= b; return a; }
 
     static mpz ediv(mpz const & n, mpz const & d);
     static mpz ediv(int n, mpz const & d) { return ediv(mpz(n), d); }
@@ -257,9 +257,9 @@ public:
     mpz & operator|=(mpz const & o);
     mpz & operator^=(mpz const & o);
 
-    friend mpz operator&(mpz a, mpz const & b) { return a &= b; }
-    friend mpz operator|(mpz a, mpz const & b) { return a |= b; }
-    friend mpz operator^(mpz a, mpz const & b) { return a ^= b; }
+    friend mpz operator&(mpz a, mpz const & b) { a &= b; return a; }
+    friend mpz operator|(mpz a, mpz const & b) { a |= b; return a; }
+    friend mpz operator^(mpz a, mpz const & b) { a ^= b; return a; }
 
     // a <- b * 2^k
     friend void mul2k(mpz & a, mpz const & b, unsigned k);
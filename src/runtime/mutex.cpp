@@ -4,7 +4,18 @@ Released under Apache 2.0 license as described in the file LICENSE.
 
 Authors: Gabriel Ebner
 */
+#include <atomic>
+#include <chrono>
 #include <lean/lean.h>
+#if defined(LEAN_WINDOWS)
+#include <windows.h>
+#elif defined(__linux__)
+#include <climits>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <ctime>
+#endif
 #include "runtime/mutex.h"
 #include "runtime/io.h"
 #include "runtime/object.h"
@@ -36,6 +47,10 @@ extern "C" LEAN_EXPORT obj_res lean_io_basemutex_unlock(b_obj_arg mtx, obj_arg)
     return io_result_mk_ok(box(0));
 }
 
+extern "C" LEAN_EXPORT obj_res lean_io_basemutex_try_lock(b_obj_arg mtx, obj_arg) {
+    return io_result_mk_ok(box(basemutex_get(mtx)->try_lock()));
+}
+
 static lean_external_class * g_condvar_external_class = nullptr;
 static void condvar_finalizer(void * h) {
     delete static_cast<condition_variable *>(h);
@@ -67,9 +82,201 @@ extern "C" LEAN_EXPORT obj_res lean_io_condvar_notify_all(b_obj_arg condvar, obj
     return io_result_mk_ok(box(0));
 }
 
+/*
+Waiting on the value of a 32-bit word, as with Linux futexes: `futex_wait(a, v, ms)` blocks while `a`
+is `v` until `futex_wake(a)` is called, `ms` milliseconds have passed if `ms >= 0`, or it returns
+spuriously. Other platforms use a table of condition variables indexed by the address of the word.
+*/
+#if defined(LEAN_WINDOWS)
+static void futex_wait(std::atomic<uint32_t> & a, uint32_t v, int64_t ms) {
+    WaitOnAddress(&a, &v, sizeof(v), ms < 0 ? INFINITE : static_cast<DWORD>(ms));
+}
+static void futex_wake(std::atomic<uint32_t> & a) {
+    WakeByAddressAll(&a);
+}
+#elif defined(__linux__)
+static void futex_wait(std::atomic<uint32_t> & a, uint32_t v, int64_t ms) {
+    struct timespec ts;
+    ts.tv_sec  = ms / 1000;
+    ts.tv_nsec = (ms % 1000) * 1000000;
+    syscall(SYS_futex, &a, FUTEX_WAIT_PRIVATE, v, ms < 0 ? nullptr : &ts, nullptr, 0);
+}
+static void futex_wake(std::atomic<uint32_t> & a) {
+    syscall(SYS_futex, &a, FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+}
+#else
+struct alignas(64) parking_slot {
+    mutex              m_mutex;
+    condition_variable m_cv;
+};
+static parking_slot g_parking_slots[64];
+static parking_slot & get_parking_slot(std::atomic<uint32_t> & a) {
+    return g_parking_slots[(reinterpret_cast<uintptr_t>(&a) >> 6) % 64];
+}
+static void futex_wait(std::atomic<uint32_t> & a, uint32_t v, int64_t ms) {
+    parking_slot & s = get_parking_slot(a);
+    unique_lock<mutex> lock(s.m_mutex);
+    if (a.load() != v)
+        return;
+    if (ms < 0)
+        s.m_cv.wait(lock);
+    else
+        s.m_cv.wait_for(lock, chrono::milliseconds(ms));
+}
+static void futex_wake(std::atomic<uint32_t> & a) {
+    parking_slot & s = get_parking_slot(a);
+    /* taking the lock ensures that a waiter that has seen the old value is already waiting */
+    { lock_guard<mutex> lock(s.m_mutex); }
+    s.m_cv.notify_all();
+}
+#endif
+
+/*
+Reader-writer lock on a single word that spins for a short while on contention before parking the
+thread with `futex_wait`. The low bits count the readers holding the lock. Waiting writers block
+new readers, so that a stream of readers cannot starve them.
+*/
+class shared_mutex {
+    static constexpr uint32_t WRITER         = 1u << 31;
+    static constexpr uint32_t WRITER_WAITING = 1u << 30;
+    static constexpr uint32_t PARKED         = 1u << 29;
+    static constexpr uint32_t READERS        = PARKED - 1;
+    static constexpr unsigned SPIN_LIMIT     = 100;
+    std::atomic<uint32_t> m_state{0};
+
+    typedef chrono::steady_clock clock;
+
+    /* Wait for `m_state` to change from `s`, setting `bits` first. Return `false` on timeout. */
+    bool park(uint32_t s, uint32_t bits, int64_t ms, clock::time_point deadline) {
+        if ((s & bits) != bits && !m_state.compare_exchange_weak(s, s | bits))
+            return true;
+        if (ms < 0) {
+            futex_wait(m_state, s | bits, -1);
+            return true;
+        }
+        auto now = clock::now();
+        if (now >= deadline)
+            return false;
+        futex_wait(m_state, s | bits, chrono::duration_cast<chrono::milliseconds>(deadline - now).count() + 1);
+        return true;
+    }
+
+    void wake(uint32_t s) {
+        if (s & PARKED)
+            futex_wake(m_state);
+    }
+
+public:
+    bool try_lock() {
+        uint32_t s = m_state.load(std::memory_order_relaxed);
+        return (s & (WRITER | READERS)) == 0 &&
+            m_state.compare_exchange_strong(s, (s | WRITER) & ~WRITER_WAITING, std::memory_order_acquire);
+    }
+
+    bool try_lock_shared() {
+        uint32_t s = m_state.load(std::memory_order_relaxed);
+        return (s & (WRITER | WRITER_WAITING)) == 0 && (s & READERS) != READERS &&
+            m_state.compare_exchange_strong(s, s + 1, std::memory_order_acquire);
+    }
+
+    /* Lock exclusively, waiting at most `ms` milliseconds unless `ms < 0`. */
+    bool lock(int64_t ms = -1) {
+        auto deadline = clock::now() + chrono::milliseconds(ms < 0 ? 0 : ms);
+        for (unsigned spins = 0;; spins++) {
+            if (try_lock())
+                return true;
+            if (spins < SPIN_LIMIT) {
+                this_thread::yield();
+                continue;
+            }
+            uint32_t s = m_state.load(std::memory_order_relaxed);
+            if ((s & (WRITER | READERS)) != 0 && !park(s, WRITER_WAITING | PARKED, ms, deadline))
+                return false;
+        }
+    }
+
+    /* Lock shared, waiting at most `ms` milliseconds unless `ms < 0`. */
+    bool lock_shared(int64_t ms = -1) {
+        auto deadline = clock::now() + chrono::milliseconds(ms < 0 ? 0 : ms);
+        for (unsigned spins = 0;; spins++) {
+            if (try_lock_shared())
+                return true;
+            if (spins < SPIN_LIMIT) {
+                this_thread::yield();
+                continue;
+            }
+            uint32_t s = m_state.load(std::memory_order_relaxed);
+            if ((s & (WRITER | WRITER_WAITING)) != 0 && !park(s, PARKED, ms, deadline))
+                return false;
+        }
+    }
+
+    void unlock() {
+        /* waiting writers set `WRITER_WAITING` again when they are woken up */
+        wake(m_state.exchange(0, std::memory_order_release));
+    }
+
+    void unlock_shared() {
+        uint32_t s = m_state.fetch_sub(1, std::memory_order_release) - 1;
+        if ((s & READERS) == 0 && (s & PARKED) != 0 && m_state.compare_exchange_strong(s, s & ~(PARKED | WRITER_WAITING)))
+            wake(s);
+    }
+};
+
+static lean_external_class * g_shared_mutex_external_class = nullptr;
+static void shared_mutex_finalizer(void * h) {
+    delete static_cast<shared_mutex *>(h);
+}
+static void shared_mutex_foreach(void *, b_obj_arg) {}
+
+static shared_mutex * shared_mutex_get(lean_object * mtx) {
+    return static_cast<shared_mutex *>(lean_get_external_data(mtx));
+}
+
+extern "C" LEAN_EXPORT obj_res lean_io_shared_mutex_new(obj_arg) {
+    return io_result_mk_ok(lean_alloc_external(g_shared_mutex_external_class, new shared_mutex));
+}
+
+extern "C" LEAN_EXPORT obj_res lean_io_shared_mutex_lock(b_obj_arg mtx, obj_arg) {
+    shared_mutex_get(mtx)->lock();
+    return io_result_mk_ok(box(0));
+}
+
+extern "C" LEAN_EXPORT obj_res lean_io_shared_mutex_try_lock(b_obj_arg mtx, obj_arg) {
+    return io_result_mk_ok(box(shared_mutex_get(mtx)->try_lock()));
+}
+
+extern "C" LEAN_EXPORT obj_res lean_io_shared_mutex_try_lock_for(b_obj_arg mtx, uint32 ms, obj_arg) {
+    return io_result_mk_ok(box(shared_mutex_get(mtx)->lock(ms)));
+}
+
+extern "C" LEAN_EXPORT obj_res lean_io_shared_mutex_unlock(b_obj_arg mtx, obj_arg) {
+    shared_mutex_get(mtx)->unlock();
+    return io_result_mk_ok(box(0));
+}
+
+extern "C" LEAN_EXPORT obj_res lean_io_shared_mutex_lock_shared(b_obj_arg mtx, obj_arg) {
+    shared_mutex_get(mtx)->lock_shared();
+    return io_result_mk_ok(box(0));
+}
+
+extern "C" LEAN_EXPORT obj_res lean_io_shared_mutex_try_lock_shared(b_obj_arg mtx, obj_arg) {
+    return io_result_mk_ok(box(shared_mutex_get(mtx)->try_lock_shared()));
+}
+
+extern "C" LEAN_EXPORT obj_res lean_io_shared_mutex_try_lock_shared_for(b_obj_arg mtx, uint32 ms, obj_arg) {
+    return io_result_mk_ok(box(shared_mutex_get(mtx)->lock_shared(ms)));
+}
+
+extern "C" LEAN_EXPORT obj_res lean_io_shared_mutex_unlock_shared(b_obj_arg mtx, obj_arg) {
+    shared_mutex_get(mtx)->unlock_shared();
+    return io_result_mk_ok(box(0));
+}
+
 void initialize_mutex() {
     g_basemutex_external_class = lean_register_external_class(basemutex_finalizer, basemutex_foreach);
     g_condvar_external_class = lean_register_external_class(condvar_finalizer, condvar_foreach);
+    g_shared_mutex_external_class = lean_register_external_class(shared_mutex_finalizer, shared_mutex_foreach);
 }
 
 void finalize_mutex() {
@@ -8,7 +8,12 @@ Author: Leonardo de Moura
 #include <algorithm>
 #include <vector>
 #include <deque>
+#include <unordered_map>
+#include <unordered_set>
 #include <cmath>
+#include <cstring>
+#include <limits>
+#include <chrono>
 #include <lean/lean.h>
 #include "runtime/object.h"
 #include "runtime/thread.h"
@@ -17,7 +22,10 @@ Author: Leonardo de Moura
 #include "runtime/debug.h"
 #include "runtime/hash.h"
 #include "runtime/flet.h"
+#include "runtime/jobserver.h"
+#include "runtime/compact.h"
 #include "runtime/interrupt.h"
+#include "runtime/memory.h"
 #include "runtime/buffer.h"
 #include "runtime/io.h"
 #include "runtime/hash.h"
@@ -27,6 +35,10 @@ Author: Leonardo de Moura
 #include <unistd.h>
 #endif
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 // HACK: for unknown reasons, std::isnan(x) fails on msys64 because math.h
 // is imported and isnan(x) looks like a macro. On the other hand, isnan(x)
 // fails on linux because <cmath> doesn't define it (as expected).
@@ -43,6 +55,27 @@ Author: Leonardo de Moura
 
 // see `Task.Priority.max`
 #define LEAN_MAX_PRIO 8
+// see `Task.Priority.interactive`
+#define LEAN_INTERACTIVE_PRIO (LEAN_MAX_PRIO + 2)
+// number of buckets of the histograms of `task_manager`'s telemetry
+#define LEAN_TASK_STATS_BUCKETS 32
+// bounds the stack usage of `task_manager::help_while_waiting`
+#define LEAN_MAX_HELP_DEPTH 16
+// bounds the search for the awaited task in a work-stealing deque
+#define LEAN_MAX_HELP_SCAN 32
+// number of objects a reclaimer thread frees between checks for idle reclaimers
+#define LEAN_DEFERRED_FREE_SPLIT 4096
+// number of times a thread forcing a thunk evaluated by another thread yields before parking
+#define LEAN_THUNK_SPIN_ITERATIONS 64
+// number of wait queues shared by all thunks
+#define LEAN_THUNK_PARKING_SLOTS 64
+
+#ifdef LEAN_RUNTIME_STATS
+#include <iostream>
+#define LEAN_RUNTIME_STAT_CODE(c) c
+#else
+#define LEAN_RUNTIME_STAT_CODE(c)
+#endif
 
 namespace lean {
 
@@ -142,11 +175,24 @@ extern "C" LEAN_EXPORT object * lean_sorry(uint8) {
     lean_unreachable();
 }
 
+#if defined(LEAN_MULTI_THREAD)
+static bool g_deferred_rc = false;
+static bool cancel_deferred_dec(lean_object * o, unsigned n);
+#endif
+
 extern "C" LEAN_EXPORT void lean_inc_ref_cold(lean_object * o) {
+#if defined(LEAN_MULTI_THREAD)
+    if (g_deferred_rc && cancel_deferred_dec(o, 1))
+        return;
+#endif
     std::atomic_fetch_sub_explicit(lean_get_rc_mt_addr(o), 1, std::memory_order_relaxed);
 }
 
 extern "C" LEAN_EXPORT void lean_inc_ref_n_cold(lean_object * o, unsigned n) {
+#if defined(LEAN_MULTI_THREAD)
+    if (g_deferred_rc && cancel_deferred_dec(o, n))
+        return;
+#endif
     std::atomic_fetch_sub_explicit(lean_get_rc_mt_addr(o), (int)n, std::memory_order_relaxed);
 }
 
@@ -254,7 +300,7 @@ extern "C" LEAN_EXPORT lean_object * lean_alloc_object(size_t sz) {
      }
 #endif
 #ifdef LEAN_SMALL_ALLOCATOR
-    return (lean_object*)alloc(sz);
+    return (lean_object*)alloc_object(sz);
 #else
     void * r = malloc(sz);
     if (r == nullptr) lean_internal_panic_out_of_memory();
@@ -319,19 +365,219 @@ static void lean_del_core(object * o, object * & todo) {
     }
 }
 
-extern "C" LEAN_EXPORT void lean_dec_ref_cold(lean_object * o) {
-    if (o->m_rc == 1 || std::atomic_fetch_add_explicit(lean_get_rc_mt_addr(o), 1, std::memory_order_acq_rel) == -1) {
-#ifdef LEAN_LAZY_RC
-        push_back(g_to_free, o);
-#else
+#if defined(LEAN_MULTI_THREAD)
+/* Deferred freeing of large dead object graphs (`LEAN_DEFERRED_FREE=<n>`).
+
+   When the last reference to a multi-threaded object is dropped, the dropping thread frees at most `n`
+   objects of the dead graph itself and hands the remaining todo list to background reclaimer threads.
+   Only multi-threaded graphs are deferred: all objects reachable from a multi-threaded object are
+   multi-threaded or persistent, so the reclaimers can safely decrement their (atomic) reference counters.
+   The children of a dead single-threaded object may still be shared with the mutator using
+   non-atomic reference counting, so these graphs are always freed by the thread that drops them.
+
+   Reclaimers share their todo list with idle reclaimers (`LEAN_DEFERRED_FREE_THREADS`, default 1)
+   by donating all but the first entry, so wide graphs are freed in parallel. The reclaimers are started
+   and stopped together with the task manager; stopping them frees all pending graphs first. */
+class deferred_free_manager {
+    mutex                   m_mutex;
+    condition_variable      m_work_cv;
+    std::vector<object *>   m_pending; // heads of todo lists
+    std::vector<lthread *>  m_reclaimers;
+    atomic<unsigned>        m_num_idle{0};
+    unsigned                m_budget;
+    bool                    m_shutting_down{false};
+
+    void push_core(object * todo) {
+        unique_lock<mutex> lock(m_mutex);
+        m_pending.push_back(todo);
+        m_work_cv.notify_one();
+    }
+
+    void reclaim(object * todo) {
+        unsigned n = 0;
+        while (todo != nullptr) {
+            object * o = pop_back(todo);
+            lean_del_core(o, todo);
+            if (++n % LEAN_DEFERRED_FREE_SPLIT == 0 && todo != nullptr && m_num_idle.load(memory_order_relaxed) > 0) {
+                if (object * rest = get_next(todo)) {
+                    set_next(todo, nullptr);
+                    push_core(rest);
+                }
+            }
+        }
+    }
+
+    void reclaimer_main() {
+        unique_lock<mutex> lock(m_mutex);
+        while (true) {
+            if (m_pending.empty()) {
+                if (m_shutting_down)
+                    break;
+                m_num_idle++;
+                m_work_cv.wait(lock);
+                m_num_idle--;
+                continue;
+            }
+            object * todo = m_pending.back();
+            m_pending.pop_back();
+            lock.unlock();
+            reclaim(todo);
+            lock.lock();
+        }
+    }
+
+public:
+    deferred_free_manager(unsigned budget, unsigned num_reclaimers):m_budget(budget) {
+        for (unsigned i = 0; i < num_reclaimers; i++)
+            m_reclaimers.push_back(new lthread([this]() { reclaimer_main(); }));
+    }
+
+    ~deferred_free_manager() {
+        {
+            unique_lock<mutex> lock(m_mutex);
+            m_shutting_down = true;
+            m_work_cv.notify_all();
+        }
+        for (lthread * t : m_reclaimers) {
+            t->join();
+            delete t;
+        }
+    }
+
+    /* Free the dead multi-threaded object `o`, deferring the bulk of its graph to the reclaimers. */
+    void del(object * o) {
         object * todo = nullptr;
+        unsigned n = m_budget;
         while (true) {
             lean_del_core(o, todo);
             if (todo == nullptr)
                 return;
+            if (--n == 0)
+                return push_core(todo);
             o = pop_back(todo);
         }
+    }
+};
+
+static deferred_free_manager * g_deferred_free = nullptr;
+#endif
+
+/* Free `o` after its reference counter has dropped to zero. */
+static void lean_del(object * o) {
+#ifdef LEAN_LAZY_RC
+    push_back(g_to_free, o);
+#else
+#if defined(LEAN_MULTI_THREAD)
+    // the counter of a dead multi-threaded object is now 0
+    if (g_deferred_free && o->m_rc == 0)
+        return g_deferred_free->del(o);
+#endif
+    object * todo = nullptr;
+    while (true) {
+        lean_del_core(o, todo);
+        if (todo == nullptr)
+            return;
+        o = pop_back(todo);
+    }
+#endif
+}
+
+#if defined(LEAN_MULTI_THREAD)
+/* Deferred reference counting of multi-threaded objects (`LEAN_DEFERRED_RC=1`, experimental).
+
+   Every thread buffers its decrements of multi-threaded objects in a small direct-mapped cache instead of
+   applying them with an atomic RMW. An increment of an object with a pending decrement cancels it without
+   touching the object, so threads repeatedly taking and dropping references to shared data (e.g., the
+   environment) stop bouncing its cache line between cores. Only decrements are deferred, which keeps the
+   scheme safe: a buffered decrement just delays the moment the object is freed. Multi-threaded objects are
+   never exclusive, so the delay does not affect destructive updates either.
+
+   Decrements are applied when their entry is evicted, after each task, and at thread exit. */
+#define LEAN_DEFERRED_RC_CACHE_SIZE 256
+
+struct deferred_rc_cache {
+    lean_object * m_objs[LEAN_DEFERRED_RC_CACHE_SIZE];
+    unsigned      m_decs[LEAN_DEFERRED_RC_CACHE_SIZE];
+    unsigned      m_num_used{0};
+
+    deferred_rc_cache() {
+        std::fill(m_objs, m_objs + LEAN_DEFERRED_RC_CACHE_SIZE, nullptr);
+    }
+
+    ~deferred_rc_cache() { flush(); }
+
+    static unsigned slot_of(lean_object * o) {
+        size_t v = reinterpret_cast<size_t>(o) >> 3;
+        return (v ^ (v >> 8)) % LEAN_DEFERRED_RC_CACHE_SIZE;
+    }
+
+    void apply(unsigned i) {
+        lean_object * o = m_objs[i];
+        int n           = m_decs[i];
+        m_objs[i]       = nullptr;
+        m_num_used--;
+        /* `o` may have become persistent in the meantime */
+        if (o->m_rc != 0 && std::atomic_fetch_add_explicit(lean_get_rc_mt_addr(o), n, std::memory_order_acq_rel) == -n)
+            lean_del(o);
+    }
+
+    void dec(lean_object * o) {
+        unsigned i = slot_of(o);
+        if (m_objs[i] == o) {
+            m_decs[i]++;
+            return;
+        }
+        if (m_objs[i] != nullptr)
+            apply(i);
+        m_objs[i] = o;
+        m_decs[i] = 1;
+        m_num_used++;
+    }
+
+    bool cancel_dec(lean_object * o, unsigned n) {
+        unsigned i = slot_of(o);
+        if (m_objs[i] != o || m_decs[i] < n)
+            return false;
+        m_decs[i] -= n;
+        if (m_decs[i] == 0) {
+            m_objs[i] = nullptr;
+            m_num_used--;
+        }
+        return true;
+    }
+
+    void flush() {
+        /* `apply` may free objects, which may in turn add new entries */
+        while (m_num_used > 0) {
+            for (unsigned i = 0; i < LEAN_DEFERRED_RC_CACHE_SIZE; i++) {
+                if (m_objs[i] != nullptr)
+                    apply(i);
+            }
+        }
+    }
+};
+
+MK_THREAD_LOCAL_GET_DEF(deferred_rc_cache, get_deferred_rc_cache);
+
+static bool cancel_deferred_dec(lean_object * o, unsigned n) {
+    return get_deferred_rc_cache().cancel_dec(o, n);
+}
+
+static void flush_deferred_rc() {
+    if (g_deferred_rc)
+        get_deferred_rc_cache().flush();
+}
+#endif
+
+extern "C" LEAN_EXPORT void lean_dec_ref_cold(lean_object * o) {
+#if defined(LEAN_MULTI_THREAD)
+    if (g_deferred_rc && o->m_rc < 0) {
+        get_deferred_rc_cache().dec(o);
+        return;
+    }
 #endif
+    if (o->m_rc == 1 || std::atomic_fetch_add_explicit(lean_get_rc_mt_addr(o), 1, std::memory_order_acq_rel) == -1) {
+        lean_del(o);
     }
 }
 
@@ -386,6 +632,32 @@ extern "C" LEAN_EXPORT lean_obj_res lean_array_set_panic(lean_obj_arg a, lean_ob
 // =======================================
 // Thunks
 
+#ifdef LEAN_RUNTIME_STATS
+static atomic<uint64> g_num_contended_thunk_forces(0);
+struct thunk_stats {
+    ~thunk_stats() {
+        std::cerr << "num. contended thunk forces: " << g_num_contended_thunk_forces << "\n";
+    }
+};
+static thunk_stats g_thunk_stats;
+#endif
+
+/* Threads forcing a thunk that is being evaluated by another thread park on the slot selected by the address of
+   the thunk. The thread evaluating the thunk only takes the lock when `m_num_waiters` is nonzero. */
+struct thunk_parking_slot {
+    mutex              m_mutex;
+    condition_variable m_cv;
+    atomic<unsigned>   m_num_waiters{0};
+};
+
+static thunk_parking_slot g_thunk_parking_slots[LEAN_THUNK_PARKING_SLOTS];
+
+static thunk_parking_slot & get_thunk_parking_slot(b_obj_arg t) {
+    return g_thunk_parking_slots[(reinterpret_cast<size_t>(t) >> 4) % LEAN_THUNK_PARKING_SLOTS];
+}
+
+static void help_while_forcing(lean_thunk_object * t);
+
 extern "C" LEAN_EXPORT b_obj_res lean_thunk_get_core(b_obj_arg t) {
     object * c = lean_to_thunk(t)->m_closure.exchange(nullptr);
     if (c != nullptr) {
@@ -395,29 +667,274 @@ extern "C" LEAN_EXPORT b_obj_res lean_thunk_get_core(b_obj_arg t) {
            The behavior is compatible with `cnstr_obj` with also returns a reference
            to be object stored in the constructor object.
 
-           Recall that `apply_1` also consumes `c`'s RC. */
-        object * r = lean_apply_1(c, lean_box(0));
+           Recall that `apply_1` also consumes `c`'s RC.
+
+           The thunk may outlive the current region, so we do not allocate its value there. */
+        object * r;
+        {
+            suspend_regions suspend;
+            r = lean_apply_1(c, lean_box(0));
+        }
         lean_assert(r != nullptr); /* Closure must return a valid lean object */
         lean_assert(lean_to_thunk(t)->m_value == nullptr);
         mark_mt(r);
         lean_to_thunk(t)->m_value = r;
+        thunk_parking_slot & slot = get_thunk_parking_slot(t);
+        if (slot.m_num_waiters > 0) {
+            lock_guard<mutex> lock(slot.m_mutex);
+            slot.m_cv.notify_all();
+        }
         return r;
     } else {
         lean_assert(c == nullptr);
-        /* There is another thread executing the closure. We keep waiting for the m_value to be
-           set by another thread. */
-        while (!lean_to_thunk(t)->m_value) {
+        /* There is another thread executing the closure. We wait for `m_value` to be set by this thread, first
+           spinning in case it is about to finish, then running other tasks or parking. */
+        for (unsigned i = 0; i < LEAN_THUNK_SPIN_ITERATIONS; i++) {
+            if (object * r = lean_to_thunk(t)->m_value)
+                return r;
             this_thread::yield();
         }
+        LEAN_RUNTIME_STAT_CODE(g_num_contended_thunk_forces++);
+        help_while_forcing(lean_to_thunk(t));
+        thunk_parking_slot & slot = get_thunk_parking_slot(t);
+        unique_lock<mutex> lock(slot.m_mutex);
+        slot.m_num_waiters++;
+        while (!lean_to_thunk(t)->m_value)
+            slot.m_cv.wait(lock);
+        slot.m_num_waiters--;
         return lean_to_thunk(t)->m_value;
     }
 }
 
 // =======================================
-// Mark Persistent
+// Regions
+
+/* Return true if the heap object `o` is in the small object allocator. */
+static bool is_small_heap_object(object * o) {
+    switch (lean_ptr_tag(o)) {
+    case LeanArray: case LeanScalarArray: case LeanString:
+        return lean_object_byte_size(o) <= LEAN_MAX_SMALL_OBJECT_SIZE;
+    default:
+        return true;
+    }
+}
+
+/* Objects of a region must not become reachable from other threads or persistent objects,
+   since they are released when the region ends. */
+static void check_not_region_object(object * o) {
+    if (lean_is_st(o) && is_small_heap_object(o) && is_region_object(o))
+        lean_internal_panic("object allocated in `Runtime.withRegion` escapes to other threads or persistent data");
+}
+
+/* Copy the objects of the ended region `rg` that are reachable from `o` to the heap, and return the copy of `o`.
+   Single-threaded objects outside of the region are visited as well, since they may have been updated
+   destructively to point to objects of the region. */
+static object * evacuate(object * o, region * rg) {
+    std::unordered_map<object *, object *> copies;
+    std::unordered_set<object *> visited;
+    buffer<object *> todo;
+    auto move = [&](object * c) -> object * {
+        if (lean_is_scalar(c) || !lean_is_st(c))
+            return c;
+        if (is_small_heap_object(c) && in_region(c, rg)) {
+            auto it = copies.find(c);
+            if (it != copies.end())
+                return it->second;
+            size_t sz   = lean_object_byte_size(c);
+            object * n  = lean_alloc_object(sz);
+            memcpy(n, c, sz);
+            copies[c]   = n;
+            todo.push_back(n);
+            return n;
+        }
+        if (visited.insert(c).second)
+            todo.push_back(c);
+        return c;
+    };
+    object * r = move(o);
+    while (!todo.empty()) {
+        object * o = todo.back();
+        todo.pop_back();
+        uint8_t tag = lean_ptr_tag(o);
+        if (tag <= LeanMaxCtorTag) {
+            object ** it  = lean_ctor_obj_cptr(o);
+            object ** end = it + lean_ctor_num_objs(o);
+            for (; it != end; ++it) *it = move(*it);
+        } else {
+            switch (tag) {
+            case LeanScalarArray:
+            case LeanString:
+            case LeanMPZ:
+            case LeanExternal:
+                break;
+            case LeanTask:
+                lean_assert(lean_to_task(o)->m_imp == nullptr);
+                lean_to_task(o)->m_value = move(lean_to_task(o)->m_value);
+                break;
+            case LeanClosure: {
+                object ** it  = lean_closure_arg_cptr(o);
+                object ** end = it + lean_closure_num_fixed(o);
+                for (; it != end; ++it) *it = move(*it);
+                break;
+            }
+            case LeanArray: {
+                object ** it  = lean_array_cptr(o);
+                object ** end = it + lean_array_size(o);
+                for (; it != end; ++it) *it = move(*it);
+                break;
+            }
+            case LeanThunk:
+                if (object * c = lean_to_thunk(o)->m_closure) lean_to_thunk(o)->m_closure = move(c);
+                if (object * v = lean_to_thunk(o)->m_value) lean_to_thunk(o)->m_value = move(v);
+                break;
+            case LeanRef:
+                if (object * v = lean_to_ref(o)->m_value) lean_to_ref(o)->m_value = move(v);
+                break;
+            default:
+                lean_unreachable();
+                break;
+            }
+        }
+    }
+    return r;
+}
+
+extern "C" LEAN_EXPORT obj_res lean_runtime_with_region(obj_arg f) {
+    region * rg = begin_region();
+    if (rg == nullptr)
+        return lean_apply_1(f, lean_box(0));
+    object * r;
+    try {
+        r = lean_apply_1(f, lean_box(0));
+    } catch (...) {
+        /* the exception may refer to objects of the region */
+        end_region(rg);
+        abandon_region(rg);
+        throw;
+    }
+    end_region(rg);
+    r = evacuate(r, rg);
+    free_region(rg);
+    return r;
+}
+
+// =======================================
+// Mark Persistent / Mark MT
+
+/* Time spent in `lean_mark_mt` and `lean_mark_persistent` once `enable_mark_profiling` has been called. */
+static std::atomic<bool>     g_mark_profiling(false);
+static std::atomic<uint64_t> g_mark_time_ns(0);
+/* True while the current thread runs a timed traversal, so that nested traversals of external objects are not counted twice. */
+LEAN_THREAD_VALUE(bool, g_marking, false);
+
+void enable_mark_profiling() {
+    g_mark_profiling = true;
+}
+
+double take_mark_time() {
+    return static_cast<double>(g_mark_time_ns.exchange(0)) / 1e9;
+}
+
+class mark_timer {
+    bool                                  m_active;
+    std::chrono::steady_clock::time_point m_start;
+public:
+    mark_timer():m_active(g_mark_profiling.load(std::memory_order_relaxed) && !g_marking) {
+        if (m_active) {
+            g_marking = true;
+            m_start   = std::chrono::steady_clock::now();
+        }
+    }
+    ~mark_timer() {
+        if (m_active) {
+            g_marking = false;
+            g_mark_time_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_start).count();
+        }
+    }
+};
+
+/* Apply `mark` to `o` and the objects reachable from it, skipping the subgraphs rooted at objects that do not satisfy `should_mark`.
+   Objects are marked when they are pushed, so each one is checked once per reference and pushed at most once, and a subgraph
+   that has already been marked, or that lives in a compacted region (whose objects are persistent), costs a single check of
+   its root. `foreach_fn` is used to visit the children of external objects. */
+template<typename Pred, typename Mark>
+static void mark_reachable(object * o, Pred should_mark, Mark mark, obj_res (*foreach_fn)(obj_arg)) {
+    buffer<object*> todo;
+    object * fn = nullptr;
+    auto push = [&](object * c) {
+        if (c != nullptr && !lean_is_scalar(c) && should_mark(c)) {
+            mark(c);
+            todo.push_back(c);
+        }
+    };
+    push(o);
+    while (!todo.empty()) {
+        object * o = todo.back();
+        todo.pop_back();
+        uint8_t tag = lean_ptr_tag(o);
+        if (tag <= LeanMaxCtorTag) {
+            object ** it  = lean_ctor_obj_cptr(o);
+            object ** end = it + lean_ctor_num_objs(o);
+            for (; it != end; ++it) push(*it);
+        } else {
+            switch (tag) {
+            case LeanScalarArray:
+            case LeanString:
+            case LeanMPZ:
+                break;
+            case LeanExternal:
+                if (fn == nullptr)
+                    fn = lean_alloc_closure((void*)foreach_fn, 1, 0);
+                lean_to_external(o)->m_class->m_foreach(lean_to_external(o)->m_data, fn);
+                break;
+            case LeanTask:
+                push(lean_task_get(o));
+                break;
+            case LeanClosure: {
+                object ** it  = lean_closure_arg_cptr(o);
+                object ** end = it + lean_closure_num_fixed(o);
+                for (; it != end; ++it) push(*it);
+                break;
+            }
+            case LeanArray: {
+                object ** it  = lean_array_cptr(o);
+                object ** end = it + lean_array_size(o);
+                for (; it != end; ++it) push(*it);
+                break;
+            }
+            case LeanThunk:
+                push(lean_to_thunk(o)->m_closure);
+                push(lean_to_thunk(o)->m_value);
+                break;
+            case LeanRef:
+                push(lean_to_ref(o)->m_value);
+                break;
+            default:
+                lean_unreachable();
+                break;
+            }
+        }
+    }
+    if (fn != nullptr)
+        lean_dec(fn);
+}
 
 extern "C" void lean_mark_persistent(object * o);
 
+extern "C" LEAN_EXPORT object * lean_init_closed_term(object ** p, object * (*init)(void)) {
+    std::atomic<object *> * r = reinterpret_cast<std::atomic<object *> *>(p);
+    object * v = r->load(std::memory_order_acquire);
+    if (v != nullptr)
+        return v;
+    v = init();
+    lean_mark_persistent(v);
+    object * expected = nullptr;
+    if (r->compare_exchange_strong(expected, v, std::memory_order_acq_rel, std::memory_order_acquire))
+        return v;
+    // Another thread initialized the term first. `v` is persistent and cannot be freed.
+    return expected;
+}
+
 static obj_res mark_persistent_fn(obj_arg o) {
     lean_mark_persistent(o);
     return lean_box(0);
@@ -430,69 +947,22 @@ static obj_res mark_persistent_fn(obj_arg o) {
 #endif
 
 extern "C" LEAN_EXPORT void lean_mark_persistent(object * o) {
-    buffer<object*> todo;
-    todo.push_back(o);
-    while (!todo.empty()) {
-        object * o = todo.back();
-        todo.pop_back();
-        if (!lean_is_scalar(o) && lean_has_rc(o)) {
-            o->m_rc = 0;
+    if (lean_is_scalar(o) || !lean_has_rc(o)) return;
+    mark_timer timer;
+    mark_reachable(o, [](object * o) { return lean_has_rc(o); }, [](object * o) {
+        check_not_region_object(o);
+        o->m_rc = 0;
 #if defined(__has_feature)
 #if __has_feature(address_sanitizer)
-            // do not report as leak
-            // NOTE: Most persistent objects are actually reachable from global
-            // variables up to the end of the process. However, this is *not*
-            // true for closures inside of persistent thunks, which are
-            // "orphaned" after being evaluated.
-            __lsan_ignore_object(o);
+        // do not report as leak
+        // NOTE: Most persistent objects are actually reachable from global
+        // variables up to the end of the process. However, this is *not*
+        // true for closures inside of persistent thunks, which are
+        // "orphaned" after being evaluated.
+        __lsan_ignore_object(o);
 #endif
 #endif
-            uint8_t tag = lean_ptr_tag(o);
-            if (tag <= LeanMaxCtorTag) {
-                object ** it  = lean_ctor_obj_cptr(o);
-                object ** end = it + lean_ctor_num_objs(o);
-                for (; it != end; ++it) todo.push_back(*it);
-            } else {
-                switch (tag) {
-                case LeanScalarArray:
-                case LeanString:
-                case LeanMPZ:
-                    break;
-                case LeanExternal: {
-                    object * fn = lean_alloc_closure((void*)mark_persistent_fn, 1, 0);
-                    lean_to_external(o)->m_class->m_foreach(lean_to_external(o)->m_data, fn);
-                    lean_dec(fn);
-                    break;
-                }
-                case LeanTask:
-                    todo.push_back(lean_task_get(o));
-                    break;
-                case LeanClosure: {
-                    object ** it  = lean_closure_arg_cptr(o);
-                    object ** end = it + lean_closure_num_fixed(o);
-                    for (; it != end; ++it) todo.push_back(*it);
-                    break;
-                }
-                case LeanArray: {
-                    object ** it  = lean_array_cptr(o);
-                    object ** end = it + lean_array_size(o);
-                    for (; it != end; ++it) todo.push_back(*it);
-                    break;
-                }
-                case LeanThunk:
-                    if (object * c = lean_to_thunk(o)->m_closure) todo.push_back(c);
-                    if (object * v = lean_to_thunk(o)->m_value) todo.push_back(v);
-                    break;
-                case LeanRef:
-                    if (object * v = lean_to_ref(o)->m_value) todo.push_back(v);
-                    break;
-                default:
-                    lean_unreachable();
-                    break;
-                }
-            }
-        }
-    }
+    }, mark_persistent_fn);
 }
 
 // =======================================
@@ -511,68 +981,137 @@ extern "C" LEAN_EXPORT void lean_mark_mt(object * o) {
     return;
 #endif
     if (lean_is_scalar(o) || !lean_is_st(o)) return;
+    mark_timer timer;
+    mark_reachable(o, [](object * o) { return lean_is_st(o); }, [](object * o) {
+        check_not_region_object(o);
+        o->m_rc = -o->m_rc;
+    }, mark_mt_fn);
+}
 
-    buffer<object*> todo;
-    todo.push_back(o);
-    while (!todo.empty()) {
-        object * o = todo.back();
-        todo.pop_back();
-        if (!lean_is_scalar(o) && lean_is_st(o)) {
-            o->m_rc = -o->m_rc;
-            uint8_t tag = lean_ptr_tag(o);
-            if (tag <= LeanMaxCtorTag) {
-                object ** it  = lean_ctor_obj_cptr(o);
-                object ** end = it + lean_ctor_num_objs(o);
-                for (; it != end; ++it) todo.push_back(*it);
-            } else {
-                switch (tag) {
-                case LeanScalarArray:
-                case LeanString:
-                case LeanMPZ:
-                    break;
-                case LeanExternal: {
-                    object * fn = lean_alloc_closure((void*)mark_mt_fn, 1, 0);
-                    lean_to_external(o)->m_class->m_foreach(lean_to_external(o)->m_data, fn);
-                    lean_dec(fn);
-                    break;
-                }
-                case LeanTask:
-                    todo.push_back(lean_task_get(o));
-                    break;
-                case LeanClosure: {
-                    object ** it  = lean_closure_arg_cptr(o);
-                    object ** end = it + lean_closure_num_fixed(o);
-                    for (; it != end; ++it) todo.push_back(*it);
-                    break;
-                }
-                case LeanArray: {
-                    object ** it  = lean_array_cptr(o);
-                    object ** end = it + lean_array_size(o);
-                    for (; it != end; ++it) todo.push_back(*it);
-                    break;
-                }
-                case LeanThunk:
-                    if (object * c = lean_to_thunk(o)->m_closure) todo.push_back(c);
-                    if (object * v = lean_to_thunk(o)->m_value) todo.push_back(v);
-                    break;
-                case LeanRef:
-                    if (object * v = lean_to_ref(o)->m_value) todo.push_back(v);
-                    break;
-                default:
-                    lean_unreachable();
-                    break;
-                }
-            }
-        }
-    }
+// =======================================
+// Reachable bytes
+
+/* State of `lean_reachable_bytes`, the children of external objects are visited through `reachable_bytes_fn`. */
+struct reachable_bytes_state {
+    std::vector<compacted_region const *> m_regions;
+    std::unordered_set<object *>          m_visited;
+    size_t                                m_heap_bytes   = 0;
+    size_t                                m_region_bytes = 0;
+};
+LEAN_THREAD_PTR(reachable_bytes_state, g_reachable_bytes_state);
+
+static void reachable_bytes(object * o) {
+    reachable_bytes_state & s = *g_reachable_bytes_state;
+    mark_reachable(o, [&](object * o) { return s.m_visited.count(o) == 0; }, [&](object * o) {
+        s.m_visited.insert(o);
+        size_t sz = lean_object_byte_size(o);
+        if (std::any_of(s.m_regions.begin(), s.m_regions.end(), [&](compacted_region const * r) { return r->contains(o); }))
+            s.m_region_bytes += sz;
+        else
+            s.m_heap_bytes += sz;
+    }, [](obj_arg o) {
+        reachable_bytes(o);
+        lean_dec(o);
+        return lean_box(0);
+    });
+}
+
+/* Count the bytes of the objects reachable from `o`, each object once, separating the objects stored in one of the
+   given compacted regions from the other ones. Unfinished tasks are waited for. */
+extern "C" LEAN_EXPORT obj_res lean_reachable_bytes(b_obj_arg o, b_obj_arg regions, obj_arg) {
+    reachable_bytes_state s;
+    for (size_t i = 0; i < lean_array_size(regions); i++)
+        s.m_regions.push_back(reinterpret_cast<compacted_region const *>(lean_unbox_usize(lean_array_get_core(regions, i))));
+    flet<reachable_bytes_state *> set(g_reachable_bytes_state, &s);
+    if (!lean_is_scalar(o))
+        reachable_bytes(o);
+    object * r = lean_alloc_ctor(0, 2, 0);
+    lean_ctor_set(r, 0, lean_usize_to_nat(s.m_heap_bytes));
+    lean_ctor_set(r, 1, lean_usize_to_nat(s.m_region_bytes));
+    return lean_io_result_mk_ok(r);
 }
 
 // =======================================
 // Tasks
 
 LEAN_THREAD_PTR(lean_task_object, g_current_task_object);
+/* Number of nested tasks run by the current thread while waiting, see `task_manager::help_while_waiting`. */
+LEAN_THREAD_VALUE(unsigned, g_help_depth, 0);
+/* Jobserver token held by the current worker thread, see `task_manager::acquire_job_token`. */
+LEAN_THREAD_VALUE(int, g_job_token, jobserver::none);
+
+/* Value of `get_allocated_bytes` at the last call of `flush_task_allocations` on this thread. */
+LEAN_THREAD_VALUE(uint64_t, g_task_alloc_mark, 0);
+static std::atomic<uint64_t> g_task_memory_limit(0);
+
+/* Bytes allocated by a thread are charged to the account of its current task in batches of this size,
+   to avoid contention on accounts shared by many tasks. */
+#define LEAN_TASK_ALLOC_FLUSH_BYTES (64 * 1024)
+
+static lean_task_memory_account * current_task_memory_account() {
+    lean_task_object * t = g_current_task_object;
+    return t && t->m_imp ? t->m_imp->m_mem_account : nullptr;
+}
+
+/* Tasks spawned by a task share its account, other tasks get a new one. */
+static lean_task_memory_account * inherit_task_memory_account() {
+    lean_task_memory_account * a = current_task_memory_account();
+    if (a) {
+        a->m_rc++;
+    } else {
+        a = (lean_task_memory_account*)lean_alloc_small_object(sizeof(lean_task_memory_account));
+        a->m_rc    = 1;
+        a->m_bytes = 0;
+    }
+    return a;
+}
+
+static void dec_task_memory_account(lean_task_memory_account * a) {
+    if (--a->m_rc == 0)
+        lean_free_small_object((lean_object*)a);
+}
+
+/* Cancellation scope of the code running on this thread: the scope entered by `IO.CancelScope.run`, or else
+   the scope of the current task. Tasks spawned by this thread inherit it. */
+LEAN_THREAD_PTR(lean_cancel_scope, g_current_cancel_scope);
+
+static bool cancel_scope_is_canceled(lean_cancel_scope * s) {
+    for (; s; s = s->m_parent) {
+        if (s->m_canceled)
+            return true;
+    }
+    return false;
+}
+
+static lean_cancel_scope * inherit_cancel_scope() {
+    lean_cancel_scope * s = g_current_cancel_scope;
+    if (s)
+        s->m_rc++;
+    return s;
+}
+
+static void dec_cancel_scope(lean_cancel_scope * s) {
+    while (s && --s->m_rc == 0) {
+        lean_cancel_scope * p = s->m_parent;
+        lean_free_small_object((lean_object*)s);
+        s = p;
+    }
+}
+
+/* Charge the bytes allocated by this thread since the last flush to the account of the current task.
+   Bytes allocated outside of tasks are dropped. */
+static void flush_task_allocations(bool force) {
+    uint64_t bytes = get_allocated_bytes();
+    uint64_t delta = bytes - g_task_alloc_mark;
+    if (!force && delta < LEAN_TASK_ALLOC_FLUSH_BYTES)
+        return;
+    g_task_alloc_mark = bytes;
+    if (lean_task_memory_account * a = current_task_memory_account())
+        a->m_bytes += delta;
+}
 
 static lean_task_imp * alloc_task_imp(obj_arg c, unsigned prio, bool keep_alive) {
+    suspend_regions suspend;
     lean_task_imp * imp = (lean_task_imp*)lean_alloc_small_object(sizeof(lean_task_imp));
     imp->m_closure     = c;
     imp->m_head_dep    = nullptr;
@@ -581,10 +1120,16 @@ static lean_task_imp * alloc_task_imp(obj_arg c, unsigned prio, bool keep_alive)
     imp->m_canceled    = false;
     imp->m_keep_alive  = keep_alive;
     imp->m_deleted     = false;
+    imp->m_enqueue_time = 0;
+    imp->m_mem_account  = inherit_task_memory_account();
+    imp->m_cancel_scope = inherit_cancel_scope();
+    imp->m_awaited      = nullptr;
     return imp;
 }
 
 static void free_task_imp(lean_task_imp * imp) {
+    dec_task_memory_account(imp->m_mem_account);
+    dec_cancel_scope(imp->m_cancel_scope);
     lean_free_small_object((lean_object*)imp);
 }
 
@@ -593,10 +1138,154 @@ static void free_task(lean_task_object * t) {
     lean_free_small_object((lean_object*)t);
 }
 
-struct scoped_current_task_object : flet<lean_task_object *> {
-    scoped_current_task_object(lean_task_object * t):flet(g_current_task_object, t) {}
+struct scoped_current_task_object {
+    flet<lean_task_object *>  m_task;
+    flet<lean_cancel_scope *> m_cancel_scope;
+    scope_reset_attention     m_reset;
+    scoped_current_task_object(lean_task_object * t):
+        m_task(g_current_task_object, t), m_cancel_scope(g_current_cancel_scope, t->m_imp->m_cancel_scope) {}
 };
 
+#if defined(LEAN_MULTI_THREAD)
+/* Chase-Lev work-stealing deque, using the memory orderings from
+   "Correct and Efficient Work-Stealing for Weak Memory Models" (Lê et al., PPoPP 2013).
+   Only the owning worker may `push` and `pop` (LIFO end), any thread may `steal` (FIFO end).
+   Buffers replaced by `grow` are retired and only freed together with the deque since
+   a concurrent `steal` may still be reading from them. */
+class task_deque {
+    struct buffer {
+        int64_t                                          m_mask;
+        std::unique_ptr<std::atomic<lean_task_object *>[]> m_data;
+        explicit buffer(int64_t capacity):m_mask(capacity - 1), m_data(new std::atomic<lean_task_object *>[capacity]) {}
+        int64_t capacity() const { return m_mask + 1; }
+        lean_task_object * get(int64_t i) const { return m_data[i & m_mask].load(std::memory_order_relaxed); }
+        void put(int64_t i, lean_task_object * t) { m_data[i & m_mask].store(t, std::memory_order_relaxed); }
+    };
+    std::atomic<int64_t>                 m_top{0};
+    std::atomic<int64_t>                 m_bottom{0};
+    std::atomic<buffer *>                m_buffer;
+    std::vector<std::unique_ptr<buffer>> m_buffers;
+
+    buffer * grow(buffer * b, int64_t top, int64_t bottom) {
+        buffer * r = new buffer(2 * b->capacity());
+        for (int64_t i = top; i < bottom; i++)
+            r->put(i, b->get(i));
+        m_buffers.emplace_back(r);
+        m_buffer.store(r, std::memory_order_release);
+        return r;
+    }
+public:
+    task_deque() {
+        buffer * b = new buffer(32);
+        m_buffers.emplace_back(b);
+        m_buffer.store(b, std::memory_order_relaxed);
+    }
+
+    void push(lean_task_object * t) {
+        int64_t b   = m_bottom.load(std::memory_order_relaxed);
+        int64_t top = m_top.load(std::memory_order_acquire);
+        buffer * a  = m_buffer.load(std::memory_order_relaxed);
+        if (b - top > a->capacity() - 1)
+            a = grow(a, top, b);
+        a->put(b, t);
+        std::atomic_thread_fence(std::memory_order_release);
+        m_bottom.store(b + 1, std::memory_order_relaxed);
+    }
+
+    lean_task_object * pop() {
+        int64_t b  = m_bottom.load(std::memory_order_relaxed) - 1;
+        buffer * a = m_buffer.load(std::memory_order_relaxed);
+        m_bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t top = m_top.load(std::memory_order_relaxed);
+        if (top > b) {
+            m_bottom.store(b + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        lean_task_object * t = a->get(b);
+        if (top == b) {
+            // last element, race against concurrent `steal`
+            if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                t = nullptr;
+            m_bottom.store(b + 1, std::memory_order_relaxed);
+        }
+        return t;
+    }
+
+    /* Returns `nullptr` if the deque is empty or if we lost a race against another thief or the owner. */
+    lean_task_object * steal() {
+        int64_t top = m_top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b   = m_bottom.load(std::memory_order_acquire);
+        if (top >= b)
+            return nullptr;
+        buffer * a = m_buffer.load(std::memory_order_acquire);
+        lean_task_object * t = a->get(top);
+        if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            return nullptr;
+        return t;
+    }
+};
+
+class task_manager;
+
+/* Per-worker queues used by the work-stealing scheduler, one deque per priority level. */
+struct task_worker_queues {
+    task_manager * m_manager;
+    task_deque     m_deques[LEAN_MAX_PRIO+1];
+    unsigned       m_steal_seed;
+    task_worker_queues(task_manager * m, unsigned seed):m_manager(m), m_steal_seed(seed) {}
+};
+
+LEAN_THREAD_PTR(task_worker_queues, g_worker_queues);
+#endif
+
+/* A thread blocked in `task_manager::wait_for` or `wait_any`. Waiters are registered per awaited task so that
+   finishing a task only wakes up the threads waiting for that particular task. */
+struct task_waiter {
+    condition_variable m_cv;
+};
+
+struct task_wait_node {
+    task_waiter *    m_waiter;
+    task_wait_node * m_next;
+};
+
+/* Histogram of the task manager's telemetry. Bucket `i > 0` counts the values of bit width `i`, i.e. in
+   `[2^(i-1), 2^i)`, bucket `0` counts zeros, and the last bucket also counts all larger values. */
+struct task_histogram {
+    std::atomic<uint64> m_count{0};
+    std::atomic<uint64> m_total{0};
+    std::atomic<uint64> m_buckets[LEAN_TASK_STATS_BUCKETS];
+
+    task_histogram() {
+        for (auto & b : m_buckets)
+            b.store(0, std::memory_order_relaxed);
+    }
+
+    void add(uint64 v) {
+        unsigned i = 0;
+        while (i + 1 < LEAN_TASK_STATS_BUCKETS && (v >> i) != 0)
+            i++;
+        m_count.fetch_add(1, std::memory_order_relaxed);
+        m_total.fetch_add(v, std::memory_order_relaxed);
+        m_buckets[i].fetch_add(1, std::memory_order_relaxed);
+    }
+};
+
+/* An execution of a task recorded while task tracing is enabled (`IO.startTaskTracing`). */
+struct task_event {
+    thread::id      m_thread;
+    unsigned        m_prio;
+    uint64          m_enqueued;
+    uint64          m_start;
+    uint64          m_stop;
+};
+
+static uint64 task_clock_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
 class task_manager {
     mutex                                         m_mutex;
     std::vector<std::unique_ptr<lthread>>         m_std_workers;
@@ -607,8 +1296,161 @@ class task_manager {
     unsigned                                      m_queues_size{0};
     unsigned                                      m_max_prio{0};
     condition_variable                            m_queue_cv;
-    condition_variable                            m_task_finished_cv;
-    bool                                          m_shutting_down{false};
+    /* Threads waiting for a task to finish, protected by `m_mutex`. */
+    std::unordered_map<lean_task_object *, task_wait_node *> m_waiters;
+    /* Set under `m_mutex`, but also read without it, e.g. by the jobserver while acquiring a token. */
+    atomic<bool>                                  m_shutting_down{false};
+    /* Work-stealing scheduler (see `LEAN_WORK_STEALING`). Queued tasks of priority <= `LEAN_MAX_PRIO` then live
+       in the per-worker deques of `m_ws_workers` (tasks enqueued by a worker) or in the global injection queues
+       `m_inject` (tasks enqueued by any other thread) instead of `m_queues`, and are dequeued without
+       taking `m_mutex`. Task state transitions are still protected by `m_mutex`. */
+    bool                                          m_work_stealing{false};
+    /* Controlled by `LEAN_HELP_WHILE_WAITING`. At level 1, a task blocked in `wait_for` runs the awaited task
+       inline if it is still queued instead of blocking its worker thread right away. At level 2, it then also runs
+       other queued tasks until the awaited task has finished. Note that level 2 can introduce deadlocks: a helped
+       task that (transitively) waits for a promise the blocked task would resolve afterwards can never finish. */
+    unsigned                                      m_help_while_waiting{0};
+    /* Telemetry, see `IO.getTaskManagerStats`. Queue latencies (per priority, dedicated tasks last) and run times
+       are measured in microseconds. `m_num_waiting` is protected by `m_mutex`. */
+    task_histogram                                m_queue_latency[LEAN_MAX_PRIO+2];
+    task_histogram                                m_run_time;
+    /* Number of dependent tasks (`add_dep`) released by each finished task. */
+    task_histogram                                m_dependents;
+    unsigned                                      m_num_waiting{0};
+    std::atomic<bool>                             m_tracing{false};
+    mutex                                         m_trace_mutex;
+    std::vector<task_event>                       m_trace;
+    /* Jobserver of a parent `make` process, if any. Standard workers hold one of its tokens while running
+       tasks, and return it when they become idle or block waiting for another task. */
+    std::unique_ptr<jobserver>                    m_jobserver;
+#if defined(LEAN_MULTI_THREAD)
+    std::vector<std::unique_ptr<task_worker_queues>> m_ws_workers;
+    std::atomic<unsigned>                         m_ws_num_workers{0};
+    /* Protects `m_std_workers` in work-stealing mode; may be taken while holding `m_mutex`. */
+    mutex                                         m_ws_spawn_mutex;
+    mutex                                         m_inject_mutex;
+    std::deque<lean_task_object *>                m_inject[LEAN_MAX_PRIO+1];
+    std::atomic<unsigned>                         m_inject_size[LEAN_MAX_PRIO+1];
+    /* Number of tasks per priority level stored in any of the queues. Incremented before the task is pushed,
+       so a worker may transiently observe a positive count without finding the task yet. */
+    std::atomic<unsigned>                         m_ws_queued[LEAN_MAX_PRIO+1];
+    std::atomic<unsigned>                         m_ws_queued_total{0};
+    mutex                                         m_ws_idle_mutex;
+    condition_variable                            m_ws_idle_cv;
+    std::atomic<unsigned>                         m_ws_idle{0};
+
+    void ws_push(lean_task_object * t, unsigned prio) {
+        lean_assert(prio <= LEAN_MAX_PRIO);
+        m_ws_queued[prio].fetch_add(1);
+        m_ws_queued_total.fetch_add(1);
+        task_worker_queues * w = g_worker_queues;
+        if (w && w->m_manager == this) {
+            w->m_deques[prio].push(t);
+        } else {
+            lock_guard<mutex> lock(m_inject_mutex);
+            m_inject[prio].push_back(t);
+            m_inject_size[prio].fetch_add(1);
+        }
+        if (m_ws_idle.load() > 0) {
+            lock_guard<mutex> lock(m_ws_idle_mutex);
+            m_ws_idle_cv.notify_one();
+        } else if (m_ws_num_workers.load(std::memory_order_relaxed) < m_max_std_workers) {
+            ws_spawn_worker();
+        }
+    }
+
+    lean_task_object * ws_inject_pop(unsigned prio) {
+        if (m_inject_size[prio].load(std::memory_order_relaxed) == 0)
+            return nullptr;
+        lock_guard<mutex> lock(m_inject_mutex);
+        std::deque<lean_task_object *> & q = m_inject[prio];
+        if (q.empty())
+            return nullptr;
+        lean_task_object * t = q.front();
+        q.pop_front();
+        m_inject_size[prio].fetch_sub(1);
+        return t;
+    }
+
+    lean_task_object * ws_steal(task_worker_queues * self, unsigned prio) {
+        unsigned n = m_ws_num_workers.load(std::memory_order_acquire);
+        if (n == 0)
+            return nullptr;
+        // start at a pseudo-random victim to spread out thieves
+        self->m_steal_seed = self->m_steal_seed * 1103515245u + 12345u;
+        unsigned start = (self->m_steal_seed >> 16) % n;
+        for (unsigned i = 0; i < n; i++) {
+            task_worker_queues * victim = m_ws_workers[(start + i) % n].get();
+            if (victim == self)
+                continue;
+            if (lean_task_object * t = victim->m_deques[prio].steal())
+                return t;
+        }
+        return nullptr;
+    }
+
+    /* Returns a queued task of the highest priority level we can find. Preference within a level:
+       own deque (most recently spawned task first), global injection queue, other workers' deques. */
+    lean_task_object * ws_dequeue(task_worker_queues * self) {
+        for (int prio = LEAN_MAX_PRIO; prio >= 0; prio--) {
+            if (m_ws_queued[prio].load(std::memory_order_relaxed) == 0)
+                continue;
+            lean_task_object * t = self->m_deques[prio].pop();
+            if (!t) t = ws_inject_pop(prio);
+            if (!t) t = ws_steal(self, prio);
+            if (t) {
+                m_ws_queued[prio].fetch_sub(1);
+                m_ws_queued_total.fetch_sub(1);
+                return t;
+            }
+        }
+        return nullptr;
+    }
+
+    /* Blocks until there may be queued tasks. Returns `false` if the worker should exit. */
+    bool ws_wait_for_work() {
+        unique_lock<mutex> lock(m_ws_idle_mutex);
+        if (m_ws_queued_total.load() > 0) {
+            // a task is about to be pushed, or we lost a race against a thief
+            lock.unlock();
+            this_thread::yield();
+            return true;
+        }
+        m_ws_idle.fetch_add(1);
+        while (m_ws_queued_total.load() == 0 && !m_shutting_down)
+            m_ws_idle_cv.wait(lock);
+        m_ws_idle.fetch_sub(1);
+        return m_ws_queued_total.load() > 0 || !m_shutting_down;
+    }
+
+    void ws_spawn_worker() {
+        lock_guard<mutex> lock(m_ws_spawn_mutex);
+        unsigned idx = m_ws_num_workers.load(std::memory_order_relaxed);
+        if (m_shutting_down || idx >= m_max_std_workers)
+            return;
+        task_worker_queues * self = m_ws_workers[idx].get();
+        m_ws_num_workers.store(idx + 1, std::memory_order_release);
+        m_std_workers.emplace_back(new lthread([this, self]() {
+            save_stack_info(false);
+            g_worker_queues = self;
+            while (true) {
+                lean_task_object * t = ws_dequeue(self);
+                if (!t) {
+                    release_job_token();
+                    if (ws_wait_for_work())
+                        continue;
+                    break;
+                }
+                acquire_job_token();
+                unique_lock<mutex> lock(m_mutex);
+                run_task(lock, t);
+                lock.unlock();
+                reset_heartbeat();
+            }
+            g_worker_queues = nullptr;
+        }));
+    }
+#endif
 
     lean_task_object * dequeue() {
         lean_assert(m_queues_size != 0);
@@ -627,13 +1469,50 @@ class task_manager {
         return result;
     }
 
+    /* Queues the interactive task `t` in front of all other tasks if a worker is idle and will pick it up right
+       away. Otherwise returns `false`, and `t` should get a dedicated worker instead of waiting for a running task
+       to finish. Must be called with `m_mutex` held. */
+    bool enqueue_interactive(lean_task_object * t) {
+#if defined(LEAN_MULTI_THREAD)
+        if (m_work_stealing) {
+            if (m_ws_idle.load() == 0)
+                return false;
+            m_ws_queued[LEAN_MAX_PRIO].fetch_add(1);
+            m_ws_queued_total.fetch_add(1);
+            {
+                lock_guard<mutex> lock(m_inject_mutex);
+                m_inject[LEAN_MAX_PRIO].push_front(t);
+                m_inject_size[LEAN_MAX_PRIO].fetch_add(1);
+            }
+            lock_guard<mutex> lock(m_ws_idle_mutex);
+            m_ws_idle_cv.notify_one();
+            return true;
+        }
+#endif
+        if (m_idle_std_workers == 0)
+            return false;
+        m_max_prio = LEAN_MAX_PRIO;
+        m_queues[LEAN_MAX_PRIO].push_front(t);
+        m_queues_size++;
+        m_queue_cv.notify_one();
+        return true;
+    }
+
     void enqueue_core(lean_task_object * t) {
         lean_assert(t->m_imp);
+        t->m_imp->m_enqueue_time = task_clock_ns();
         unsigned prio = t->m_imp->m_prio;
         if (prio > LEAN_MAX_PRIO) {
-            spawn_dedicated_worker(t);
+            if (prio != LEAN_INTERACTIVE_PRIO || !enqueue_interactive(t))
+                spawn_dedicated_worker(t);
             return;
         }
+#if defined(LEAN_MULTI_THREAD)
+        if (m_work_stealing) {
+            ws_push(t, prio);
+            return;
+        }
+#endif
         if (prio > m_max_prio)
             m_max_prio = prio;
         m_queues[prio].push_back(t);
@@ -672,6 +1551,7 @@ class task_manager {
             m_idle_std_workers++;
             while (true) {
                 if (m_queues_size == 0) {
+                    release_job_token();
                     if (m_shutting_down) {
                         break;
                     }
@@ -681,6 +1561,11 @@ class task_manager {
 
                 lean_task_object * t = dequeue();
                 m_idle_std_workers--;
+                if (m_jobserver && g_job_token == jobserver::none) {
+                    lock.unlock();
+                    acquire_job_token();
+                    lock.lock();
+                }
                 run_task(lock, t);
                 m_idle_std_workers++;
                 reset_heartbeat();
@@ -700,6 +1585,39 @@ class task_manager {
         // `lthread` will be implicitly freed, which frees up its control resources but does not terminate the thread
     }
 
+    /* Blocks until the current worker holds a jobserver token, if there is a jobserver. Must not be called
+       with `m_mutex` held. */
+    void acquire_job_token() {
+        if (m_jobserver && g_job_token == jobserver::none)
+            g_job_token = m_jobserver->acquire([this]() { return m_shutting_down.load(); });
+    }
+
+    /* Returns the jobserver token of the current worker, if any, so that another process or worker can use it
+       while this worker is idle. */
+    void release_job_token() {
+        if (g_job_token != jobserver::none) {
+            m_jobserver->release(g_job_token);
+            g_job_token = jobserver::none;
+        }
+    }
+
+    /* Like `release_job_token` before the current thread blocks in `wait_for` or `wait_any`. Returns whether
+       the token has to be reacquired by `resume_job_token` afterwards. */
+    bool suspend_job_token() {
+        if (g_job_token == jobserver::none)
+            return false;
+        release_job_token();
+        return true;
+    }
+
+    void resume_job_token(unique_lock<mutex> & lock, bool suspended) {
+        if (suspended) {
+            lock.unlock();
+            acquire_job_token();
+            lock.lock();
+        }
+    }
+
     void run_task(unique_lock<mutex> & lock, lean_task_object * t) {
         lean_assert(t->m_imp);
         if (t->m_imp->m_deleted) {
@@ -708,16 +1626,32 @@ class task_manager {
         }
         reset_heartbeat();
         object * v = nullptr;
+        // charge the allocations so far to the task that was running on this thread, if any
+        flush_task_allocations(true);
         {
             scoped_current_task_object scope_cur_task(t);
             object * c = t->m_imp->m_closure;
             t->m_imp->m_closure = nullptr;
+            unsigned prio   = std::min(t->m_imp->m_prio, static_cast<unsigned>(LEAN_MAX_PRIO + 1));
+            uint64 enqueued = t->m_imp->m_enqueue_time;
             lock.unlock();
+            uint64 start = task_clock_ns();
+            m_queue_latency[prio].add((start - enqueued) / 1000);
             v = lean_apply_1(c, box(0));
+            flush_task_allocations(true);
+            uint64 stop = task_clock_ns();
+            m_run_time.add((stop - start) / 1000);
+            if (m_tracing.load(std::memory_order_relaxed)) {
+                lock_guard<mutex> trace_lock(m_trace_mutex);
+                m_trace.push_back(task_event{this_thread::get_id(), prio, enqueued, start, stop});
+            }
             // If deactivation was delayed by `m_keep_alive`, deactivate after the final execution (`v != nulltpr`)
             if (v != nullptr && t->m_imp->m_keep_alive) {
                 lean_dec_ref((lean_object*)t);
             }
+#if defined(LEAN_MULTI_THREAD)
+            flush_deferred_rc();
+#endif
             lock.lock();
         }
         lean_assert(t->m_imp);
@@ -749,15 +1683,53 @@ class task_manager {
            dependencies, we can release `m_imp` and keep just the value */
         free_task_imp(t->m_imp);
         t->m_imp   = nullptr;
-        m_task_finished_cv.notify_all();
+        notify_waiters(t);
+    }
+
+    void notify_waiters(lean_task_object * t) {
+        if (m_waiters.empty())
+            return;
+        auto it = m_waiters.find(t);
+        if (it == m_waiters.end())
+            return;
+        for (task_wait_node * n = it->second; n; n = n->m_next)
+            n->m_waiter->m_cv.notify_one();
+        m_waiters.erase(it);
+    }
+
+    void add_waiter(lean_task_object * t, task_wait_node * n) {
+        task_wait_node * & head = m_waiters[t];
+        n->m_next = head;
+        head = n;
+    }
+
+    void remove_waiter(lean_task_object * t, task_wait_node * n) {
+        auto it = m_waiters.find(t);
+        if (it == m_waiters.end())
+            return; // `t` has finished and `notify_waiters` already removed its waiters
+        task_wait_node ** ptr = &it->second;
+        while (*ptr) {
+            if (*ptr == n) {
+                *ptr = n->m_next;
+                break;
+            }
+            ptr = &(*ptr)->m_next;
+        }
+        if (!it->second)
+            m_waiters.erase(it);
     }
 
     void handle_finished(lean_task_object * t) {
         lean_task_object * it = t->m_imp->m_head_dep;
         t->m_imp->m_head_dep = nullptr;
+        uint64 num_deps = 0;
+        for (lean_task_object * d = it; d; d = d->m_imp->m_next_dep)
+            num_deps++;
+        m_dependents.add(num_deps);
         while (it) {
             if (t->m_imp->m_canceled)
                 it->m_imp->m_canceled = true;
+            it->m_imp->m_awaited = nullptr;
             lean_task_object * next_it = it->m_imp->m_next_dep;
             it->m_imp->m_next_dep = nullptr;
             if (it->m_imp->m_deleted) {
@@ -781,26 +1753,54 @@ class task_manager {
     }
 
 public:
-    task_manager(unsigned max_std_workers):
-        m_max_std_workers(max_std_workers) {
+    task_manager(unsigned max_std_workers, bool work_stealing = false, unsigned help_while_waiting = 0,
+                 jobserver * js = nullptr):
+        m_max_std_workers(max_std_workers), m_work_stealing(work_stealing), m_help_while_waiting(help_while_waiting),
+        m_jobserver(js) {
+#if defined(LEAN_MULTI_THREAD)
+        if (m_work_stealing) {
+            for (unsigned i = 0; i <= LEAN_MAX_PRIO; i++) {
+                m_inject_size[i].store(0);
+                m_ws_queued[i].store(0);
+            }
+            for (unsigned i = 0; i < m_max_std_workers; i++)
+                m_ws_workers.emplace_back(new task_worker_queues(this, i + 1));
+        }
+#else
+        m_work_stealing = false;
+#endif
     }
 
     ~task_manager() {
         {
             unique_lock<mutex> lock(m_mutex);
+#if defined(LEAN_MULTI_THREAD)
+            lock_guard<mutex> spawn_lock(m_ws_spawn_mutex);
+#endif
             m_shutting_down = true;
             // we can assume that `m_std_workers` will not be changed after this line
         }
         m_queue_cv.notify_all();
-#ifndef LEAN_EMSCRIPTEN
-        // wait for all workers to finish
+#if defined(LEAN_MULTI_THREAD)
+        if (m_work_stealing) {
+            lock_guard<mutex> lock(m_ws_idle_mutex);
+            m_ws_idle_cv.notify_all();
+        }
+#endif
+        // wait for all workers to finish; under Emscripten, this relies on `main` running in a pthread
+        // (`PROXY_TO_PTHREAD`) as the browser main thread cannot block
         for (auto & t : m_std_workers)
             t->join();
-        // never seems to terminate under Emscripten
-#endif
     }
 
     void enqueue(lean_task_object * t) {
+#if defined(LEAN_MULTI_THREAD)
+        if (m_work_stealing && t->m_imp->m_prio <= LEAN_MAX_PRIO) {
+            t->m_imp->m_enqueue_time = task_clock_ns();
+            ws_push(t, t->m_imp->m_prio);
+            return;
+        }
+#endif
         unique_lock<mutex> lock(m_mutex);
         enqueue_core(t);
     }
@@ -829,6 +1829,135 @@ public:
         }
         t2->m_imp->m_next_dep = t1->m_imp->m_head_dep;
         t1->m_imp->m_head_dep = t2;
+        t2->m_imp->m_awaited  = t1;
+        boost_core(t1, t2->m_imp->m_prio);
+    }
+
+    /* Priority inheritance: raises the priority of `t` and of the tasks it is transitively waiting for to at least
+       `prio`, capped at `LEAN_MAX_PRIO`. Queued tasks are moved to their new level if we can find them.
+       Must be called with `m_mutex` held. */
+    void boost_core(lean_task_object * t, unsigned prio) {
+        prio = std::min(prio, static_cast<unsigned>(LEAN_MAX_PRIO));
+        while (t && t->m_imp && !t->m_value && !t->m_imp->m_deleted && t->m_imp->m_prio < prio) {
+            lean_task_object * next = t->m_imp->m_awaited;
+            if (try_unqueue(t)) {
+                uint64 enqueued = t->m_imp->m_enqueue_time;
+                t->m_imp->m_prio = prio;
+                enqueue_core(t);
+                t->m_imp->m_enqueue_time = enqueued;
+            } else {
+                t->m_imp->m_prio = prio;
+            }
+            t = next;
+        }
+    }
+
+    /* Removes `t` from the queues if it is currently Queued. Must be called with `m_mutex` held. */
+    bool try_unqueue(lean_task_object * t) {
+        if (!t->m_imp || !t->m_imp->m_closure || t->m_imp->m_deleted)
+            return false;
+        unsigned prio = t->m_imp->m_prio;
+        if (prio > LEAN_MAX_PRIO)
+            return false;
+#if defined(LEAN_MULTI_THREAD)
+        if (m_work_stealing) {
+            bool found = false;
+            task_worker_queues * w = g_worker_queues;
+            if (w && w->m_manager == this) {
+                // Only the owner end of our own deque can be searched. Pop a bounded number of more recently
+                // spawned tasks until we find `t` and push them back in their original order.
+                lean_task_object * popped[LEAN_MAX_HELP_SCAN];
+                unsigned num_popped = 0;
+                while (num_popped < LEAN_MAX_HELP_SCAN) {
+                    lean_task_object * o = w->m_deques[prio].pop();
+                    if (!o)
+                        break;
+                    if (o == t) {
+                        found = true;
+                        break;
+                    }
+                    popped[num_popped++] = o;
+                }
+                while (num_popped > 0)
+                    w->m_deques[prio].push(popped[--num_popped]);
+            }
+            if (!found && m_inject_size[prio].load(std::memory_order_relaxed) > 0) {
+                lock_guard<mutex> inject_lock(m_inject_mutex);
+                std::deque<lean_task_object *> & q = m_inject[prio];
+                auto it = std::find(q.begin(), q.end(), t);
+                if (it != q.end()) {
+                    q.erase(it);
+                    m_inject_size[prio].fetch_sub(1);
+                    found = true;
+                }
+            }
+            if (found) {
+                m_ws_queued[prio].fetch_sub(1);
+                m_ws_queued_total.fetch_sub(1);
+            }
+            return found;
+        }
+#endif
+        std::deque<lean_task_object *> & q = m_queues[prio];
+        // `t` has most likely been spawned recently, so search from the back
+        auto it = std::find(q.rbegin(), q.rend(), t);
+        if (it == q.rend())
+            return false;
+        q.erase(std::next(it).base());
+        m_queues_size--;
+        while (m_max_prio > 0 && m_queues[m_max_prio].empty())
+            --m_max_prio;
+        return true;
+    }
+
+    /* Dequeues an arbitrary task for helping. Must be called with `m_mutex` held. */
+    lean_task_object * try_dequeue_for_helping() {
+#if defined(LEAN_MULTI_THREAD)
+        if (m_work_stealing) {
+            task_worker_queues * w = g_worker_queues;
+            return w && w->m_manager == this ? ws_dequeue(w) : nullptr;
+        }
+#endif
+        return m_queues_size > 0 ? dequeue() : nullptr;
+    }
+
+    /* Runs `t` on the current thread, which is blocked waiting for some other task. */
+    void run_task_while_waiting(unique_lock<mutex> & lock, lean_task_object * t) {
+        // do not let the nested task disturb the heartbeats of the waiting task
+        scope_heartbeat heartbeat(0);
+        flet<unsigned> depth(g_help_depth, g_help_depth + 1);
+        run_task(lock, t);
+    }
+
+    void help_while_waiting(unique_lock<mutex> & lock, lean_task_object * t) {
+        if (g_help_depth >= LEAN_MAX_HELP_DEPTH)
+            return;
+        if (try_unqueue(t)) {
+            run_task_while_waiting(lock, t);
+            // `t` may still be unfinished if it is a `bind` task waiting for its nested task
+        }
+        if (m_help_while_waiting < 2)
+            return;
+        while (!t->m_value) {
+            lean_task_object * o = try_dequeue_for_helping();
+            if (!o)
+                break;
+            run_task_while_waiting(lock, o);
+        }
+    }
+
+    /* Runs queued tasks on the current thread while thunk `t` is being evaluated by another thread. Like helping
+       with unrelated tasks in `help_while_waiting`, this is only enabled at level 2. */
+    void help_while_forcing(lean_thunk_object * t) {
+        if (m_help_while_waiting < 2 || !g_current_task_object || g_help_depth >= LEAN_MAX_HELP_DEPTH)
+            return;
+        unique_lock<mutex> lock(m_mutex);
+        while (!t->m_value) {
+            lean_task_object * o = try_dequeue_for_helping();
+            if (!o)
+                break;
+            run_task_while_waiting(lock, o);
+        }
     }
 
     void wait_for(lean_task_object * t) {
@@ -837,18 +1966,48 @@ public:
         unique_lock<mutex> lock(m_mutex);
         if (t->m_value)
             return;
-        m_task_finished_cv.wait(lock, [&]() { return t->m_value != nullptr; });
+        if (g_current_task_object)
+            boost_core(t, g_current_task_object->m_imp->m_prio);
+        if (m_help_while_waiting && g_current_task_object) {
+            help_while_waiting(lock, t);
+            if (t->m_value)
+                return;
+        }
+        task_waiter waiter;
+        task_wait_node node{&waiter, nullptr};
+        add_waiter(t, &node);
+        m_num_waiting++;
+        bool suspended = suspend_job_token();
+        while (!t->m_value)
+            waiter.m_cv.wait(lock);
+        m_num_waiting--;
+        resume_job_token(lock, suspended);
     }
 
     object * wait_any(object * task_list) {
         if (object * t = wait_any_check(task_list))
             return t;
         unique_lock<mutex> lock(m_mutex);
-        while (true) {
-            if (object * t = wait_any_check(task_list))
-                return t;
-            m_task_finished_cv.wait(lock);
-        }
+        if (object * t = wait_any_check(task_list))
+            return t;
+        task_waiter waiter;
+        std::vector<task_wait_node> nodes;
+        for (object * it = task_list; !is_scalar(it); it = cnstr_get(it, 1))
+            nodes.push_back(task_wait_node{&waiter, nullptr});
+        size_t i = 0;
+        for (object * it = task_list; !is_scalar(it); it = cnstr_get(it, 1))
+            add_waiter(lean_to_task(lean_ctor_get(it, 0)), &nodes[i++]);
+        object * r;
+        m_num_waiting++;
+        bool suspended = suspend_job_token();
+        while (!(r = wait_any_check(task_list)))
+            waiter.m_cv.wait(lock);
+        m_num_waiting--;
+        resume_job_token(lock, suspended);
+        i = 0;
+        for (object * it = task_list; !is_scalar(it); it = cnstr_get(it, 1))
+            remove_waiter(lean_to_task(lean_ctor_get(it, 0)), &nodes[i++]);
+        return r;
     }
 
     void deactivate_task(lean_task_object * t) {
@@ -874,15 +2033,141 @@ public:
     bool shutting_down() const {
         return m_shutting_down;
     }
-};
 
-static task_manager * g_task_manager = nullptr;
+    /* Structure `IO.TaskManagerStats`. */
+    obj_res get_stats() {
+        unsigned workers, idle, queued, dedicated, waiting;
+        {
+            unique_lock<mutex> lock(m_mutex);
+#if defined(LEAN_MULTI_THREAD)
+            if (m_work_stealing) {
+                workers = m_ws_num_workers.load();
+                idle    = m_ws_idle.load();
+                queued  = m_ws_queued_total.load();
+            } else
+#endif
+            {
+                workers = m_std_workers.size();
+                idle    = m_idle_std_workers;
+                queued  = m_queues_size;
+            }
+            dedicated = m_num_dedicated_workers;
+            waiting   = m_num_waiting;
+        }
+        return mk_stats(workers, idle, dedicated, queued, waiting, m_queue_latency, m_run_time, m_dependents);
+    }
+
+    static obj_res mk_stats(unsigned workers, unsigned idle, unsigned dedicated, unsigned queued, unsigned waiting,
+                            task_histogram const * queue_latency, task_histogram const & run_time,
+                            task_histogram const & dependents) {
+        object * latency = array_mk_empty();
+        for (unsigned i = 0; i < LEAN_MAX_PRIO + 2; i++)
+            latency = array_push(latency, mk_histogram(queue_latency[i]));
+        object * r = alloc_cnstr(0, 8, 0);
+        cnstr_set(r, 0, usize_to_nat(workers));
+        cnstr_set(r, 1, usize_to_nat(idle));
+        cnstr_set(r, 2, usize_to_nat(dedicated));
+        cnstr_set(r, 3, usize_to_nat(queued));
+        cnstr_set(r, 4, usize_to_nat(waiting));
+        cnstr_set(r, 5, latency);
+        cnstr_set(r, 6, mk_histogram(run_time));
+        cnstr_set(r, 7, mk_histogram(dependents));
+        return r;
+    }
+
+    /* Structure `IO.TaskManagerStats.Histogram`. */
+    static obj_res mk_histogram(task_histogram const & h) {
+        object * buckets = array_mk_empty();
+        for (auto const & b : h.m_buckets)
+            buckets = array_push(buckets, uint64_to_nat(b.load(std::memory_order_relaxed)));
+        object * r = alloc_cnstr(0, 3, 0);
+        cnstr_set(r, 0, uint64_to_nat(h.m_count.load(std::memory_order_relaxed)));
+        cnstr_set(r, 1, uint64_to_nat(h.m_total.load(std::memory_order_relaxed)));
+        cnstr_set(r, 2, buckets);
+        return r;
+    }
+
+    void start_tracing() {
+        lock_guard<mutex> lock(m_trace_mutex);
+        m_trace.clear();
+        m_tracing = true;
+    }
+
+    /* `Array IO.TaskEvent` of the tasks run since `start_tracing`. */
+    obj_res stop_tracing() {
+        std::vector<task_event> trace;
+        {
+            lock_guard<mutex> lock(m_trace_mutex);
+            m_tracing = false;
+            trace.swap(m_trace);
+        }
+        std::unordered_map<thread::id, unsigned> threads;
+        object * r = array_mk_empty();
+        for (task_event const & e : trace) {
+            unsigned thread = threads.emplace(e.m_thread, threads.size()).first->second;
+            object * o = alloc_cnstr(0, 2, 3 * sizeof(uint64));
+            cnstr_set(o, 0, usize_to_nat(thread));
+            cnstr_set(o, 1, usize_to_nat(e.m_prio));
+            cnstr_set_uint64(o, 2 * sizeof(object *), e.m_enqueued);
+            cnstr_set_uint64(o, 2 * sizeof(object *) + sizeof(uint64), e.m_start);
+            cnstr_set_uint64(o, 2 * sizeof(object *) + 2 * sizeof(uint64), e.m_stop);
+            r = array_push(r, o);
+        }
+        return r;
+    }
+};
+
+static task_manager * g_task_manager = nullptr;
+
+static void help_while_forcing(lean_thunk_object * t) {
+    if (g_task_manager)
+        g_task_manager->help_while_forcing(t);
+}
+
+static unsigned get_lean_env_unsigned(char const * name) {
+#ifndef LEAN_EMSCRIPTEN
+    if (char const * v = std::getenv(name)) {
+        return atoi(v);
+    }
+#endif
+    return 0;
+}
+
+/* `LEAN_WORK_STEALING=1` selects the work-stealing scheduler of `task_manager`,
+   `LEAN_HELP_WHILE_WAITING=1/2` lets tasks blocked in `Task.get` run the awaited task/other queued tasks,
+   `LEAN_NO_JOBSERVER=1` ignores the jobserver of a parent `make` process advertised in `MAKEFLAGS`,
+   `LEAN_DEFERRED_FREE=<n>` frees large dead object graphs in the background (see `deferred_free_manager`). */
+static task_manager * mk_task_manager(unsigned num_workers) {
+#if defined(LEAN_MULTI_THREAD)
+    if (unsigned budget = get_lean_env_unsigned("LEAN_DEFERRED_FREE")) {
+        unsigned num_reclaimers = std::max(get_lean_env_unsigned("LEAN_DEFERRED_FREE_THREADS"), 1u);
+        g_deferred_free = new deferred_free_manager(budget, num_reclaimers);
+    }
+#endif
+    jobserver * js = get_lean_env_unsigned("LEAN_NO_JOBSERVER") ? nullptr : jobserver::from_env();
+    return new task_manager(num_workers, get_lean_env_unsigned("LEAN_WORK_STEALING") != 0,
+                            get_lean_env_unsigned("LEAN_HELP_WHILE_WAITING"), js);
+}
+
+static void del_task_manager() {
+#if defined(LEAN_MULTI_THREAD)
+    // deferred graphs may contain tasks, so we free them first
+    if (g_deferred_free) {
+        delete g_deferred_free;
+        g_deferred_free = nullptr;
+    }
+#endif
+    if (g_task_manager) {
+        delete g_task_manager;
+        g_task_manager = nullptr;
+    }
+}
 
 extern "C" LEAN_EXPORT void lean_init_task_manager_using(unsigned num_workers) {
     lean_assert(g_task_manager == nullptr);
 #if defined(LEAN_MULTI_THREAD)
     if (num_workers > 0) {
-        g_task_manager = new task_manager(num_workers);
+        g_task_manager = mk_task_manager(num_workers);
     }
 #endif
 }
@@ -901,26 +2186,20 @@ extern "C" LEAN_EXPORT void lean_init_task_manager() {
 }
 
 extern "C" LEAN_EXPORT void lean_finalize_task_manager() {
-    if (g_task_manager) {
-        delete g_task_manager;
-        g_task_manager = nullptr;
-    }
+    del_task_manager();
 }
 
 scoped_task_manager::scoped_task_manager(unsigned num_workers) {
     lean_assert(g_task_manager == nullptr);
 #if defined(LEAN_MULTI_THREAD)
     if (num_workers > 0) {
-        g_task_manager = new task_manager(num_workers);
+        g_task_manager = mk_task_manager(num_workers);
     }
 #endif
 }
 
 scoped_task_manager::~scoped_task_manager() {
-    if (g_task_manager) {
-        delete g_task_manager;
-        g_task_manager = nullptr;
-    }
+    del_task_manager();
 }
 
 void deactivate_task(lean_task_object * t) {
@@ -942,6 +2221,7 @@ static inline void lean_set_task_header(lean_object * o) {
 
 static lean_task_object * alloc_task(obj_arg c, unsigned prio, bool keep_alive) {
     lean_mark_mt(c);
+    suspend_regions suspend;
     lean_task_object * o = (lean_task_object*)lean_alloc_small_object(sizeof(lean_task_object));
     lean_set_task_header((lean_object*)o);
     o->m_value = nullptr;
@@ -1036,7 +2316,35 @@ extern "C" LEAN_EXPORT obj_res lean_task_bind_core(obj_arg x, obj_arg f, unsigne
     }
 }
 
+void set_task_memory_limit(uint64_t max) {
+    g_task_memory_limit = max;
+}
+
+void check_task_memory() {
+    flush_task_allocations(false);
+    uint64_t limit = g_task_memory_limit.load(std::memory_order_relaxed);
+    if (limit == 0)
+        return;
+    lean_task_object * t = g_current_task_object;
+    if (t && t->m_imp && !t->m_imp->m_canceled && t->m_imp->m_mem_account->m_bytes > limit)
+        lean_io_cancel_core((b_obj_arg)t);
+}
+
+extern "C" LEAN_EXPORT uint64_t lean_io_get_task_allocated_bytes_core() {
+    flush_task_allocations(true);
+    if (lean_task_memory_account * a = current_task_memory_account())
+        return a->m_bytes;
+    return 0;
+}
+
+extern "C" LEAN_EXPORT bool lean_io_cancel_scope_check_core() {
+    return cancel_scope_is_canceled(g_current_cancel_scope);
+}
+
 extern "C" LEAN_EXPORT bool lean_io_check_canceled_core() {
+    check_task_memory();
+    if (cancel_scope_is_canceled(g_current_cancel_scope))
+        return true;
     if (lean_task_object * t = g_current_task_object) {
         lean_assert(t->m_imp); // task is being executed
         return t->m_imp->m_canceled || g_task_manager->shutting_down();
@@ -1050,6 +2358,51 @@ extern "C" LEAN_EXPORT void lean_io_cancel_core(b_obj_arg t) {
     g_task_manager->cancel(lean_to_task(t));
 }
 
+static lean_external_class * g_cancel_scope_external_class = nullptr;
+
+static void cancel_scope_finalizer(void * s) {
+    dec_cancel_scope(static_cast<lean_cancel_scope *>(s));
+}
+
+static void cancel_scope_foreach(void *, b_obj_arg) {}
+
+static lean_cancel_scope * to_cancel_scope(b_obj_arg s) {
+    return static_cast<lean_cancel_scope *>(lean_get_external_data(s));
+}
+
+/* CancelScope.new : BaseIO CancelScope */
+extern "C" LEAN_EXPORT obj_res lean_io_cancel_scope_new(obj_arg) {
+    lean_cancel_scope * s = (lean_cancel_scope*)lean_alloc_small_object(sizeof(lean_cancel_scope));
+    s->m_rc       = 1;
+    s->m_canceled = false;
+    s->m_parent   = inherit_cancel_scope();
+    return io_result_mk_ok(lean_alloc_external(g_cancel_scope_external_class, s));
+}
+
+/* CancelScope.cancel : @& CancelScope → BaseIO Unit */
+extern "C" LEAN_EXPORT obj_res lean_io_cancel_scope_cancel(b_obj_arg s, obj_arg) {
+    to_cancel_scope(s)->m_canceled = true;
+    request_attention();
+    return io_result_mk_ok(box(0));
+}
+
+/* CancelScope.isCanceled : @& CancelScope → BaseIO Bool */
+extern "C" LEAN_EXPORT obj_res lean_io_cancel_scope_is_canceled(b_obj_arg s, obj_arg) {
+    return io_result_mk_ok(box(cancel_scope_is_canceled(to_cancel_scope(s))));
+}
+
+/* CancelScope.run : @& CancelScope → BaseIO α → BaseIO α */
+extern "C" LEAN_EXPORT obj_res lean_io_cancel_scope_run(b_obj_arg s, obj_arg act, obj_arg w) {
+    flet<lean_cancel_scope *> scope(g_current_cancel_scope, to_cancel_scope(s));
+    scope_reset_attention reset;
+    return apply_1(act, w);
+}
+
+/* checkCancelScope : BaseIO Bool */
+extern "C" LEAN_EXPORT obj_res lean_io_check_cancel_scope(obj_arg) {
+    return io_result_mk_ok(box(lean_io_cancel_scope_check_core()));
+}
+
 extern "C" LEAN_EXPORT uint8_t lean_io_get_task_state_core(b_obj_arg t) {
     lean_task_object * o = lean_to_task(t);
     if (o->m_imp) {
@@ -1067,6 +2420,25 @@ extern "C" LEAN_EXPORT b_obj_res lean_io_wait_any_core(b_obj_arg task_list) {
     return g_task_manager->wait_any(task_list);
 }
 
+extern "C" LEAN_EXPORT obj_res lean_io_get_task_manager_stats_core() {
+    if (g_task_manager)
+        return g_task_manager->get_stats();
+    // no task manager: tasks are run synchronously when they are created
+    task_histogram empty[LEAN_MAX_PRIO+2];
+    return task_manager::mk_stats(0, 0, 0, 0, 0, empty, empty[0], empty[0]);
+}
+
+extern "C" LEAN_EXPORT void lean_io_start_task_tracing_core() {
+    if (g_task_manager)
+        g_task_manager->start_tracing();
+}
+
+extern "C" LEAN_EXPORT obj_res lean_io_stop_task_tracing_core() {
+    if (g_task_manager)
+        return g_task_manager->stop_tracing();
+    return array_mk_empty();
+}
+
 // Internally, a `Promise` is just a `Task` that is in the "Promised" or "Finished" state
 
 extern "C" LEAN_EXPORT obj_res lean_io_promise_new(obj_arg) {
@@ -1074,6 +2446,7 @@ extern "C" LEAN_EXPORT obj_res lean_io_promise_new(obj_arg) {
     bool keep_alive = false;
     unsigned prio = 0;
     object * closure = nullptr;
+    suspend_regions suspend;
     lean_task_object * o = (lean_task_object*)lean_alloc_small_object(sizeof(lean_task_object));
     lean_set_task_header((lean_object*)o);
     o->m_value = nullptr;
@@ -1101,6 +2474,14 @@ object * alloc_mpz(mpz const & m) {
     return (lean_object*)o;
 }
 
+/* Move the limbs of a temporary result into the new object instead of copying them. */
+object * alloc_mpz(mpz && m) {
+    void * mem = lean_alloc_small_object(sizeof(mpz_object));
+    mpz_object * o = new (mem) mpz_object(std::move(m));
+    lean_set_st_header((lean_object*)o, LeanMPZ, 0);
+    return (lean_object*)o;
+}
+
 #ifdef LEAN_USE_GMP
 extern "C" LEAN_EXPORT lean_object * lean_alloc_mpz(mpz_t v) {
     return alloc_mpz(mpz(v));
@@ -1116,6 +2497,11 @@ object * mpz_to_nat_core(mpz const & m) {
     return alloc_mpz(m);
 }
 
+object * mpz_to_nat_core(mpz && m) {
+    lean_assert(!m.is_size_t() || m.get_size_t() > LEAN_MAX_SMALL_NAT);
+    return alloc_mpz(std::move(m));
+}
+
 static inline obj_res mpz_to_nat(mpz const & m) {
     if (m.is_size_t() && m.get_size_t() <= LEAN_MAX_SMALL_NAT)
         return lean_box(m.get_size_t());
@@ -1123,6 +2509,13 @@ static inline obj_res mpz_to_nat(mpz const & m) {
         return mpz_to_nat_core(m);
 }
 
+static inline obj_res mpz_to_nat(mpz && m) {
+    if (m.is_size_t() && m.get_size_t() <= LEAN_MAX_SMALL_NAT)
+        return lean_box(m.get_size_t());
+    else
+        return mpz_to_nat_core(std::move(m));
+}
+
 extern "C" LEAN_EXPORT object * lean_cstr_to_nat(char const * n) {
     return mpz_to_nat(mpz(n));
 }
@@ -1335,6 +2728,67 @@ extern "C" LEAN_EXPORT lean_obj_res lean_nat_pow(b_lean_obj_arg a1, b_lean_obj_a
         return mpz_to_nat(mpz_value(a1).pow(lean_unbox(a2)));
 }
 
+static inline mpz nat_to_mpz(b_obj_arg a) {
+    return lean_is_scalar(a) ? mpz::of_size_t(lean_unbox(a)) : mpz_value(a);
+}
+
+extern "C" LEAN_EXPORT lean_obj_res lean_nat_mul_add(b_lean_obj_arg a1, b_lean_obj_arg a2, b_lean_obj_arg a3) {
+    if (lean_is_scalar(a1) && lean_is_scalar(a2) && lean_is_scalar(a3)) {
+        size_t m, r;
+        if (!__builtin_mul_overflow(lean_unbox(a1), lean_unbox(a2), &m) &&
+            !__builtin_add_overflow(m, lean_unbox(a3), &r) && r <= LEAN_MAX_SMALL_NAT)
+            return lean_box(r);
+    }
+    /* accumulate into a single temporary, which is then moved into the result object */
+    mpz r = nat_to_mpz(a1);
+    if (lean_is_scalar(a2))
+        r *= static_cast<uint64>(lean_unbox(a2));
+    else
+        r *= mpz_value(a2);
+    if (lean_is_scalar(a3))
+        r += static_cast<uint64>(lean_unbox(a3));
+    else
+        r += mpz_value(a3);
+    return mpz_to_nat(std::move(r));
+}
+
+extern "C" LEAN_EXPORT lean_obj_res lean_nat_pow_mod(b_lean_obj_arg a1, b_lean_obj_arg a2, b_lean_obj_arg a3) {
+    if (lean_is_scalar(a3)) {
+        size_t m = lean_unbox(a3);
+        if (m == 0)
+            return lean_nat_pow(a1, a2);
+        if (m == 1)
+            return lean_box(0);
+        if (m <= UINT32_MAX && lean_is_scalar(a2)) {
+            /* all intermediate products fit in 64 bits */
+            uint64 b = lean_is_scalar(a1) ? lean_unbox(a1) % m : (mpz_value(a1) % mpz::of_size_t(m)).get_size_t();
+            uint64 r = 1;
+            for (size_t e = lean_unbox(a2); e != 0; e >>= 1) {
+                if (e & 1) r = r * b % m;
+                b = b * b % m;
+            }
+            return lean_box(r);
+        }
+    }
+    mpz m = nat_to_mpz(a3);
+    mpz b = nat_to_mpz(a1);
+    b %= m;
+    mpz e = nat_to_mpz(a2);
+    mpz r(1);
+    mpz t;
+    while (!e.is_zero()) {
+        if (e.mod8() & 1) {
+            r *= b;
+            r %= m;
+        }
+        b *= b;
+        b %= m;
+        div2k(t, e, 1);
+        swap(t, e);
+    }
+    return mpz_to_nat(std::move(r));
+}
+
 extern "C" LEAN_EXPORT lean_obj_res lean_nat_gcd(b_lean_obj_arg a1, b_lean_obj_arg a2) {
     if (lean_is_scalar(a1)) {
       if (lean_is_scalar(a2))
@@ -1371,6 +2825,11 @@ inline object * mpz_to_int_core(mpz const & m) {
     return alloc_mpz(m);
 }
 
+inline object * mpz_to_int_core(mpz && m) {
+    lean_assert(m < LEAN_MIN_SMALL_INT || m > LEAN_MAX_SMALL_INT);
+    return alloc_mpz(std::move(m));
+}
+
 static object * mpz_to_int(mpz const & m) {
     if (m < LEAN_MIN_SMALL_INT || m > LEAN_MAX_SMALL_INT)
         return mpz_to_int_core(m);
@@ -1378,11 +2837,24 @@ static object * mpz_to_int(mpz const & m) {
         return lean_box(static_cast<unsigned>(m.get_int()));
 }
 
+static object * mpz_to_int(mpz && m) {
+    if (m < LEAN_MIN_SMALL_INT || m > LEAN_MAX_SMALL_INT)
+        return mpz_to_int_core(std::move(m));
+    else
+        return lean_box(static_cast<unsigned>(m.get_int()));
+}
+
 extern "C" LEAN_EXPORT lean_obj_res lean_big_int_to_nat(lean_obj_arg a) {
     lean_assert(!lean_is_scalar(a));
+    if (lean_is_exclusive(a)) {
+        /* steal the limbs, `a` is freed with an empty value */
+        mpz m(std::move(to_mpz(a)->m_value));
+        lean_dec(a);
+        return mpz_to_nat(std::move(m));
+    }
     mpz m = mpz_value(a);
     lean_dec(a);
-    return mpz_to_nat(m);
+    return mpz_to_nat(std::move(m));
 }
 
 extern "C" LEAN_EXPORT object * lean_cstr_to_int(char const * n) {
@@ -1577,15 +3049,6 @@ extern "C" LEAN_EXPORT usize lean_usize_big_modn(usize a1, b_lean_obj_arg) {
 // =======================================
 // Float
 
-extern "C" LEAN_EXPORT lean_obj_res lean_float_to_string(double a) {
-    if (isnan(a))
-        // override NaN because we don't want NaNs to be distinguishable
-        // because the sign bit / payload bits can be architecture-dependent
-        return mk_ascii_string_unchecked("NaN");
-    else
-        return mk_ascii_string_unchecked(std::to_string(a));
-}
-
 extern "C" LEAN_EXPORT double lean_float_scaleb(double a, b_lean_obj_arg b) {
    if (lean_is_scalar(b)) {
      return scalbn(a, lean_scalar_to_int(b));
@@ -1673,8 +3136,31 @@ extern "C" LEAN_EXPORT object * lean_mk_ascii_string_unchecked(char const * s) {
     return lean_mk_string_unchecked(s, len, len);
 }
 
-extern "C" LEAN_EXPORT obj_res lean_string_from_utf8_unchecked(b_obj_arg a) {
-    return lean_mk_string_from_bytes_unchecked(reinterpret_cast<char *>(lean_sarray_cptr(a)), lean_sarray_size(a));
+/* A string stores its UTF-8 length between the capacity and the data, so its data starts this many
+   bytes after the data of a scalar array. */
+static constexpr size_t g_string_sarray_offset = sizeof(lean_string_object) - sizeof(lean_sarray_object);
+
+extern "C" LEAN_EXPORT obj_res lean_string_from_utf8_unchecked(obj_arg a) {
+    size_t sz  = lean_sarray_size(a);
+    size_t cap = lean_sarray_capacity(a);
+    char * bytes = reinterpret_cast<char *>(lean_sarray_cptr(a));
+    if (lean_is_exclusive(a) && cap >= sz + 1 + g_string_sarray_offset) {
+        /* Reuse the buffer: both objects have the same byte size when the string capacity is
+           reduced by the offset of its data. */
+        size_t len = utf8_strlen(bytes, sz);
+        lean_string_object * o = reinterpret_cast<lean_string_object *>(a);
+        memmove(o->m_data, bytes, sz);
+        o->m_data[sz]       = 0;
+        o->m_header.m_tag   = LeanString;
+        o->m_header.m_other = 0;
+        o->m_size           = sz + 1;
+        o->m_capacity       = cap - g_string_sarray_offset;
+        o->m_length         = len;
+        return a;
+    }
+    object * r = lean_mk_string_from_bytes_unchecked(bytes, sz);
+    lean_dec_ref(a);
+    return r;
 }
 
 extern "C" LEAN_EXPORT uint8 lean_string_validate_utf8(b_obj_arg a) {
@@ -1682,10 +3168,22 @@ extern "C" LEAN_EXPORT uint8 lean_string_validate_utf8(b_obj_arg a) {
     return validate_utf8(lean_sarray_cptr(a), lean_sarray_size(a), pos, i);
 }
 
-extern "C" LEAN_EXPORT obj_res lean_string_to_utf8(b_obj_arg s) {
+extern "C" LEAN_EXPORT obj_res lean_string_to_utf8(obj_arg s) {
     size_t sz = lean_string_size(s) - 1;
+    if (lean_is_exclusive(s)) {
+        /* Reuse the buffer, see `lean_string_from_utf8_unchecked`. */
+        size_t cap = lean_string_capacity(s);
+        lean_sarray_object * o = reinterpret_cast<lean_sarray_object *>(s);
+        memmove(o->m_data, lean_string_cstr(s), sz);
+        o->m_header.m_tag   = LeanScalarArray;
+        o->m_header.m_other = 1;
+        o->m_size           = sz;
+        o->m_capacity       = cap + g_string_sarray_offset;
+        return s;
+    }
     obj_res r = lean_alloc_sarray(1, sz, sz);
     memcpy(lean_sarray_cptr(r), lean_string_cstr(s), sz);
+    lean_dec_ref(s);
     return r;
 }
 
@@ -1727,6 +3225,14 @@ extern "C" LEAN_EXPORT object * lean_string_push(object * s, unsigned c) {
 extern "C" LEAN_EXPORT object * lean_string_append(object * s1, object * s2) {
     size_t sz1      = lean_string_size(s1);
     size_t sz2      = lean_string_size(s2);
+    if (sz2 == 1) {
+        return s1;
+    } else if (sz1 == 1 && !lean_is_exclusive(s1)) {
+        /* share `s2` instead of copying it into a new string */
+        lean_inc_ref(s2);
+        lean_dec_ref(s1);
+        return s2;
+    }
     size_t len1     = lean_string_len(s1);
     size_t len2     = lean_string_len(s2);
     size_t new_len  = len1 + len2;
@@ -1747,6 +3253,58 @@ extern "C" LEAN_EXPORT object * lean_string_append(object * s1, object * s2) {
     return r;
 }
 
+extern "C" LEAN_EXPORT obj_res lean_string_reserve(obj_arg s, b_obj_arg n) {
+    if (!lean_is_scalar(n)) lean_internal_panic_out_of_memory();
+    size_t extra = lean_unbox(n);
+    if (lean_is_exclusive(s))
+        return string_ensure_capacity(s, extra);
+    size_t sz = lean_string_size(s);
+    object * r = lean_alloc_string(sz, sz + extra, lean_string_len(s));
+    memcpy(w_string_cstr(r), lean_string_cstr(s), sz);
+    lean_dec_ref(s);
+    return r;
+}
+
+/* Concatenate the strings of the list `l`, separated by `sep` if it is not `nullptr`.
+   The result is allocated once, after computing its size. */
+static obj_res string_join_core(b_obj_arg sep, b_obj_arg l) {
+    size_t sep_sz  = sep ? lean_string_size(sep) - 1 : 0;
+    size_t sep_len = sep ? lean_string_len(sep) : 0;
+    size_t sz  = 0;
+    size_t len = 0;
+    for (b_obj_arg it = l; !lean_is_scalar(it); it = lean_ctor_get(it, 1)) {
+        b_obj_arg str = lean_ctor_get(it, 0);
+        if (it != l) {
+            sz  += sep_sz;
+            len += sep_len;
+        }
+        sz  += lean_string_size(str) - 1;
+        len += lean_string_len(str);
+    }
+    object * r = lean_alloc_string(sz + 1, sz + 1, len);
+    char * out = w_string_cstr(r);
+    for (b_obj_arg it = l; !lean_is_scalar(it); it = lean_ctor_get(it, 1)) {
+        b_obj_arg str = lean_ctor_get(it, 0);
+        if (it != l) {
+            memcpy(out, lean_string_cstr(sep), sep_sz);
+            out += sep_sz;
+        }
+        size_t str_sz = lean_string_size(str) - 1;
+        memcpy(out, lean_string_cstr(str), str_sz);
+        out += str_sz;
+    }
+    *out = 0;
+    return r;
+}
+
+extern "C" LEAN_EXPORT obj_res lean_string_join(b_obj_arg l) {
+    return string_join_core(nullptr, l);
+}
+
+extern "C" LEAN_EXPORT obj_res lean_string_intercalate(b_obj_arg sep, b_obj_arg l) {
+    return string_join_core(sep, l);
+}
+
 extern "C" LEAN_EXPORT bool lean_string_eq_cold(b_lean_obj_arg s1, b_lean_obj_arg s2) {
     return std::memcmp(lean_string_cstr(s1), lean_string_cstr(s2), lean_string_size(s1)) == 0;
 }
@@ -1996,6 +3554,17 @@ extern "C" LEAN_EXPORT uint8 lean_string_is_valid_pos(b_obj_arg s, b_obj_arg i0)
     return is_utf8_first_byte(str[i]);
 }
 
+extern "C" LEAN_EXPORT obj_res lean_json_scan_string(b_obj_arg s, b_obj_arg i0) {
+    if (!lean_is_scalar(i0)) {
+        lean_inc(i0);
+        return i0;
+    }
+    usize i    = lean_unbox(i0);
+    usize size = lean_string_size(s) - 1;
+    if (i >= size) return i0;
+    return lean_box(i + json_plain_prefix_length(lean_string_cstr(s) + i, size - i));
+}
+
 extern "C" LEAN_EXPORT obj_res lean_string_utf8_extract(b_obj_arg s, b_obj_arg b0, b_obj_arg e0) {
     if (!lean_is_scalar(b0) || !lean_is_scalar(e0)) {
         /* See comment at string_utf8_get */
@@ -2015,6 +3584,11 @@ extern "C" LEAN_EXPORT obj_res lean_string_utf8_extract(b_obj_arg s, b_obj_arg b
     /* In the reference implementation if `e` is not pointing to a valid UTF8
        character start position, it is assumed to be at the end. */
     if (e < sz && !is_utf8_first_byte(str[e])) e = sz;
+    if (b == 0 && e == sz) {
+        /* the whole string, share it */
+        lean_inc_ref(s);
+        return s;
+    }
     usize new_sz = e - b;
     lean_assert(new_sz > 0);
     return lean_mk_string_from_bytes_unchecked(lean_string_cstr(s) + b, new_sz);
@@ -2037,6 +3611,97 @@ extern "C" LEAN_EXPORT obj_res lean_string_utf8_prev(b_obj_arg s, b_obj_arg i0)
     return lean_box(i);
 }
 
+/* Return the size in UTF-16 code units of the character at position `i < size` like `(String.get s i).utf16Size`,
+   and move `i` to the next position like `String.next`. */
+static unsigned string_utf16_step(char const * str, usize size, usize & i) {
+    uint32 c;
+    if (!lean_string_utf8_get_core(str, size, i, c))
+        c = lean_char_default_value();
+    unsigned b = static_cast<unsigned char>(str[i]);
+    if ((b & 0x80) == 0)         i += 1;
+    else if ((b & 0xe0) == 0xc0) i += 2;
+    else if ((b & 0xf0) == 0xe0) i += 3;
+    else if ((b & 0xf8) == 0xf0) i += 4;
+    else                         i += 1;
+    return c <= 0xFFFF ? 1 : 2;
+}
+
+/* Return `a + (n - k)` where `k <= n`. */
+static obj_res nat_add_diff(usize a, b_obj_arg n, usize k) {
+    if (lean_is_scalar(n))
+        return lean_usize_to_nat(a + (lean_unbox(n) - k));
+    obj_res k0 = lean_usize_to_nat(k);
+    obj_res d  = lean_nat_sub(n, k0);
+    obj_res a0 = lean_usize_to_nat(a);
+    obj_res r  = lean_nat_add(a0, d);
+    lean_dec(k0); lean_dec(d); lean_dec(a0);
+    return r;
+}
+
+/* The following functions implement the UTF-16 position conversions of `Lean.Data.Lsp.Utf16`.
+   Past the end of the string, `String.get` returns the default character, which has UTF-8 and UTF-16 size 1,
+   so the remaining steps are computed arithmetically. Arguments that are not scalars are larger than any
+   string, see `lean_string_utf8_get`. Runs of ASCII characters are skipped in blocks. */
+
+/* String.codepointPosToUtf16PosFrom : @& String → @& Nat → @& Pos → Nat */
+extern "C" LEAN_EXPORT obj_res lean_string_codepoint_pos_to_utf16_pos_from(b_obj_arg s, b_obj_arg n0, b_obj_arg off0) {
+    char const * str = lean_string_cstr(s);
+    usize size = lean_string_size(s) - 1;
+    usize i    = lean_is_scalar(off0) ? lean_unbox(off0) : size;
+    usize n    = lean_is_scalar(n0) ? lean_unbox(n0) : SIZE_MAX;
+    usize k    = 0; // number of codepoints consumed
+    usize r    = 0;
+    while (k < n && i < size) {
+        usize a = utf8_ascii_prefix_length(str + i, std::min(size - i, n - k));
+        i += a; k += a; r += a;
+        if (k < n && i < size) {
+            r += string_utf16_step(str, size, i);
+            k++;
+        }
+    }
+    return nat_add_diff(r, n0, k);
+}
+
+/* String.utf16PosToCodepointPosFrom : @& String → @& Nat → @& Pos → Nat */
+extern "C" LEAN_EXPORT obj_res lean_string_utf16_pos_to_codepoint_pos_from(b_obj_arg s, b_obj_arg u0, b_obj_arg off0) {
+    char const * str = lean_string_cstr(s);
+    usize size = lean_string_size(s) - 1;
+    usize i    = lean_is_scalar(off0) ? lean_unbox(off0) : size;
+    usize u    = lean_is_scalar(u0) ? lean_unbox(u0) : SIZE_MAX;
+    usize k    = 0; // number of UTF-16 code units consumed
+    usize r    = 0;
+    while (k < u && i < size) {
+        usize a = utf8_ascii_prefix_length(str + i, std::min(size - i, u - k));
+        i += a; k += a; r += a;
+        if (k < u && i < size) {
+            /* a surrogate pair may end after `u` */
+            k = std::min<usize>(u, k + string_utf16_step(str, size, i));
+            r++;
+        }
+    }
+    return nat_add_diff(r, u0, k);
+}
+
+/* String.codepointPosToUtf8PosFrom : @& String → @& Pos → @& Nat → Pos */
+extern "C" LEAN_EXPORT obj_res lean_string_codepoint_pos_to_utf8_pos_from(b_obj_arg s, b_obj_arg off0, b_obj_arg n0) {
+    if (!lean_is_scalar(off0))
+        return lean_nat_add(off0, n0);
+    char const * str = lean_string_cstr(s);
+    usize size = lean_string_size(s) - 1;
+    usize i    = lean_unbox(off0);
+    usize n    = lean_is_scalar(n0) ? lean_unbox(n0) : SIZE_MAX;
+    usize k    = 0; // number of codepoints consumed
+    while (k < n && i < size) {
+        usize a = utf8_ascii_prefix_length(str + i, std::min(size - i, n - k));
+        i += a; k += a;
+        if (k < n && i < size) {
+            string_utf16_step(str, size, i);
+            k++;
+        }
+    }
+    return nat_add_diff(i, n0, k);
+}
+
 static unsigned get_utf8_char_size_at(std::string const & s, usize i) {
     if (auto sz = get_utf8_first_byte_opt(s[i])) {
         return *sz;
@@ -2082,6 +3747,12 @@ extern "C" LEAN_EXPORT obj_res lean_string_of_usize(size_t n) {
     return mk_ascii_string_unchecked(std::to_string(n));
 }
 
+extern "C" LEAN_EXPORT obj_res lean_nat_big_repr(b_obj_arg n) {
+    if (lean_is_scalar(n))
+        return lean_string_of_usize(lean_unbox(n));
+    return mk_ascii_string_unchecked(mpz_value(n).to_string());
+}
+
 // =======================================
 // ByteArray & FloatArray
 
@@ -2230,6 +3901,249 @@ extern "C" LEAN_EXPORT obj_res lean_float_array_push(obj_arg a, double d) {
     return r;
 }
 
+/*
+Bulk operations on scalar arrays. The loops below are kept simple, with no loop-carried dependencies
+other than the independent accumulators of the reductions, so that the C compiler vectorizes them
+for the target architecture.
+*/
+
+/* Return an exclusive scalar array for the result of an elementwise operation on `a` of size `sz`, reusing `a` if possible. */
+static obj_res sarray_ensure_exclusive_of_size(obj_arg a, size_t sz) {
+    if (lean_is_exclusive(a) && sz <= lean_sarray_capacity(a)) {
+        lean_to_sarray(a)->m_size = sz;
+        return a;
+    }
+    obj_res r = lean_alloc_sarray(lean_sarray_elem_size(a), sz, sz);
+    memcpy(lean_sarray_cptr(r), lean_sarray_cptr(a), sz * lean_sarray_elem_size(a));
+    lean_dec(a);
+    return r;
+}
+
+template<typename F> static obj_res float_array_zip_with(obj_arg a, b_obj_arg b, F && f) {
+    size_t sz       = std::min(lean_sarray_size(a), lean_sarray_size(b));
+    obj_res r       = sarray_ensure_exclusive_of_size(a, sz);
+    double * it     = lean_float_array_cptr(r);
+    double const * b_it = lean_float_array_cptr(b);
+    for (size_t i = 0; i < sz; i++)
+        it[i] = f(it[i], b_it[i]);
+    return r;
+}
+
+extern "C" LEAN_EXPORT obj_res lean_float_array_add(obj_arg a, b_obj_arg b) {
+    return float_array_zip_with(a, b, [](double x, double y) { return x + y; });
+}
+
+extern "C" LEAN_EXPORT obj_res lean_float_array_sub(obj_arg a, b_obj_arg b) {
+    return float_array_zip_with(a, b, [](double x, double y) { return x - y; });
+}
+
+extern "C" LEAN_EXPORT obj_res lean_float_array_mul(obj_arg a, b_obj_arg b) {
+    return float_array_zip_with(a, b, [](double x, double y) { return x * y; });
+}
+
+extern "C" LEAN_EXPORT obj_res lean_float_array_div(obj_arg a, b_obj_arg b) {
+    return float_array_zip_with(a, b, [](double x, double y) { return x / y; });
+}
+
+extern "C" LEAN_EXPORT obj_res lean_float_array_scale(obj_arg a, double c) {
+    obj_res r   = sarray_ensure_exclusive_of_size(a, lean_sarray_size(a));
+    size_t sz   = lean_sarray_size(r);
+    double * it = lean_float_array_cptr(r);
+    for (size_t i = 0; i < sz; i++)
+        it[i] *= c;
+    return r;
+}
+
+extern "C" LEAN_EXPORT obj_res lean_float_array_shift(obj_arg a, double c) {
+    obj_res r   = sarray_ensure_exclusive_of_size(a, lean_sarray_size(a));
+    size_t sz   = lean_sarray_size(r);
+    double * it = lean_float_array_cptr(r);
+    for (size_t i = 0; i < sz; i++)
+        it[i] += c;
+    return r;
+}
+
+/*
+Floating-point addition is not associative, so the compiler does not vectorize a plain sum.
+We use four independent accumulators instead, which also changes the order of the additions.
+*/
+extern "C" LEAN_EXPORT double lean_float_array_sum(b_obj_arg a) {
+    size_t sz         = lean_sarray_size(a);
+    double const * it = lean_float_array_cptr(a);
+    double acc[4]     = {0.0, 0.0, 0.0, 0.0};
+    size_t i = 0;
+    for (; i + 4 <= sz; i += 4) {
+        for (unsigned j = 0; j < 4; j++)
+            acc[j] += it[i + j];
+    }
+    for (; i < sz; i++)
+        acc[0] += it[i];
+    return (acc[0] + acc[1]) + (acc[2] + acc[3]);
+}
+
+extern "C" LEAN_EXPORT double lean_float_array_dot(b_obj_arg a, b_obj_arg b) {
+    size_t sz           = std::min(lean_sarray_size(a), lean_sarray_size(b));
+    double const * a_it = lean_float_array_cptr(a);
+    double const * b_it = lean_float_array_cptr(b);
+    double acc[4]       = {0.0, 0.0, 0.0, 0.0};
+    size_t i = 0;
+    for (; i + 4 <= sz; i += 4) {
+        for (unsigned j = 0; j < 4; j++)
+            acc[j] += a_it[i + j] * b_it[i + j];
+    }
+    for (; i < sz; i++)
+        acc[0] += a_it[i] * b_it[i];
+    return (acc[0] + acc[1]) + (acc[2] + acc[3]);
+}
+
+extern "C" LEAN_EXPORT double lean_float_array_minimum(b_obj_arg a) {
+    size_t sz         = lean_sarray_size(a);
+    double const * it = lean_float_array_cptr(a);
+    double r          = std::numeric_limits<double>::infinity();
+    for (size_t i = 0; i < sz; i++)
+        r = it[i] < r ? it[i] : r;
+    return r;
+}
+
+extern "C" LEAN_EXPORT double lean_float_array_maximum(b_obj_arg a) {
+    size_t sz         = lean_sarray_size(a);
+    double const * it = lean_float_array_cptr(a);
+    double r          = -std::numeric_limits<double>::infinity();
+    for (size_t i = 0; i < sz; i++)
+        r = it[i] > r ? it[i] : r;
+    return r;
+}
+
+extern "C" LEAN_EXPORT obj_res lean_byte_array_find(b_obj_arg a, uint8 b, b_obj_arg o_start) {
+    size_t sz = lean_sarray_size(a);
+    if (!lean_is_scalar(o_start) || lean_unbox(o_start) >= sz)
+        return lean_box(0);
+    size_t start     = lean_unbox(o_start);
+    uint8 const * it = lean_sarray_cptr(a);
+    void const * p   = memchr(it + start, b, sz - start);
+    if (p == nullptr)
+        return lean_box(0);
+    object * r = lean_alloc_ctor(1, 1, 0);
+    lean_ctor_set(r, 0, lean_box(static_cast<uint8 const *>(p) - it));
+    return r;
+}
+
+extern "C" LEAN_EXPORT uint16 lean_byte_array_match16(b_obj_arg a, size_t i, uint8 b) {
+    size_t sz        = lean_sarray_size(a);
+    uint8 const * it = lean_sarray_cptr(a);
+    if (i >= sz)
+        return 0;
+#if defined(__SSE2__)
+    if (sz - i >= 16) {
+        __m128i group = _mm_loadu_si128(reinterpret_cast<__m128i const *>(it + i));
+        return static_cast<uint16>(_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(static_cast<char>(b)))));
+    }
+#endif
+    size_t n = std::min(sz - i, static_cast<size_t>(16));
+    uint16 r = 0;
+    for (size_t j = 0; j < n; j++)
+        r |= static_cast<uint16>(it[i + j] == b) << j;
+    return r;
+}
+
+extern "C" LEAN_EXPORT bool lean_byte_array_beq(b_obj_arg a, b_obj_arg b) {
+    size_t sz = lean_sarray_size(a);
+    return sz == lean_sarray_size(b) && memcmp(lean_sarray_cptr(a), lean_sarray_cptr(b), sz) == 0;
+}
+
+/* Lexicographic comparison, returns an `Ordering`. */
+extern "C" LEAN_EXPORT uint8 lean_byte_array_compare(b_obj_arg a, b_obj_arg b) {
+    size_t a_sz = lean_sarray_size(a);
+    size_t b_sz = lean_sarray_size(b);
+    int c = memcmp(lean_sarray_cptr(a), lean_sarray_cptr(b), std::min(a_sz, b_sz));
+    if (c == 0)
+        c = a_sz < b_sz ? -1 : (a_sz > b_sz ? 1 : 0);
+    return c < 0 ? 0 : (c == 0 ? 1 : 2);
+}
+
+extern "C" LEAN_EXPORT obj_res lean_byte_array_xor(obj_arg a, b_obj_arg b) {
+    size_t sz          = std::min(lean_sarray_size(a), lean_sarray_size(b));
+    obj_res r          = sarray_ensure_exclusive_of_size(a, sz);
+    uint8 * it         = lean_sarray_cptr(r);
+    uint8 const * b_it = lean_sarray_cptr(b);
+    for (size_t i = 0; i < sz; i++)
+        it[i] ^= b_it[i];
+    return r;
+}
+
+extern "C" LEAN_EXPORT obj_res lean_byte_array_fill(obj_arg a, uint8 b) {
+    obj_res r = sarray_ensure_exclusive_of_size(a, lean_sarray_size(a));
+    memset(lean_sarray_cptr(r), b, lean_sarray_size(r));
+    return r;
+}
+
+template<typename T, typename Unbox> static obj_res scalar_array_mk(obj_arg a, Unbox && unbox) {
+    usize sz      = lean_array_size(a);
+    obj_res r     = lean_alloc_sarray(sizeof(T), sz, sz);
+    object ** it  = lean_array_cptr(a);
+    object ** end = it + sz;
+    T * dest      = reinterpret_cast<T*>(lean_sarray_cptr(r));
+    for (; it != end; ++it, ++dest) {
+        *dest = unbox(*it);
+    }
+    lean_dec(a);
+    return r;
+}
+
+template<typename T, typename Box> static obj_res scalar_array_data(obj_arg a, Box && box) {
+    usize sz       = lean_sarray_size(a);
+    obj_res r      = lean_alloc_array(sz, sz);
+    T * it         = reinterpret_cast<T*>(lean_sarray_cptr(a));
+    T * end        = it+sz;
+    object ** dest = lean_array_cptr(r);
+    for (; it != end; ++it, ++dest) {
+        *dest = box(*it);
+    }
+    lean_dec(a);
+    return r;
+}
+
+template<typename T> static obj_res scalar_array_push(obj_arg a, T v) {
+    object * r = lean_sarray_ensure_exclusive(lean_sarray_ensure_capacity(a, lean_sarray_size(a) + 1, /* exact */ false));
+    size_t & sz  = lean_to_sarray(r)->m_size;
+    T * it       = reinterpret_cast<T*>(lean_sarray_cptr(r)) + sz;
+    *it = v;
+    sz++;
+    return r;
+}
+
+extern "C" LEAN_EXPORT obj_res lean_copy_uint32_array(obj_arg a) {
+    return lean_copy_sarray(a, lean_sarray_capacity(a));
+}
+
+extern "C" LEAN_EXPORT obj_res lean_uint32_array_mk(obj_arg a) {
+    return scalar_array_mk<uint32>(a, [](b_obj_arg v) { return lean_unbox_uint32(v); });
+}
+
+extern "C" LEAN_EXPORT obj_res lean_uint32_array_data(obj_arg a) {
+    return scalar_array_data<uint32>(a, [](uint32 v) { return lean_box_uint32(v); });
+}
+
+extern "C" LEAN_EXPORT obj_res lean_uint32_array_push(obj_arg a, uint32 v) {
+    return scalar_array_push(a, v);
+}
+
+extern "C" LEAN_EXPORT obj_res lean_copy_uint64_array(obj_arg a) {
+    return lean_copy_sarray(a, lean_sarray_capacity(a));
+}
+
+extern "C" LEAN_EXPORT obj_res lean_uint64_array_mk(obj_arg a) {
+    return scalar_array_mk<uint64>(a, [](b_obj_arg v) { return lean_unbox_uint64(v); });
+}
+
+extern "C" LEAN_EXPORT obj_res lean_uint64_array_data(obj_arg a) {
+    return scalar_array_data<uint64>(a, [](uint64 v) { return lean_box_uint64(v); });
+}
+
+extern "C" LEAN_EXPORT obj_res lean_uint64_array_push(obj_arg a, uint64 v) {
+    return scalar_array_push(a, v);
+}
+
 // =======================================
 // Array functions for generated code
 
@@ -2396,6 +4310,10 @@ void initialize_object() {
     g_ext_classes_mutex = new mutex();
     g_array_empty       = lean_alloc_array(0, 0);
     mark_persistent(g_array_empty);
+    g_cancel_scope_external_class = lean_register_external_class(cancel_scope_finalizer, cancel_scope_foreach);
+#if defined(LEAN_MULTI_THREAD)
+    g_deferred_rc       = get_lean_env_unsigned("LEAN_DEFERRED_RC") != 0;
+#endif
 }
 
 void finalize_object() {
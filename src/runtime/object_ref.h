@@ -18,19 +18,21 @@ protected:
 public:
     object_ref():m_obj(box(0)) {}
     explicit object_ref(obj_arg o):m_obj(o) {}
-    object_ref(b_obj_arg o, bool):m_obj(o) { inc(o); }
-    object_ref(object_ref const & s):m_obj(s.m_obj) { inc(m_obj); }
+    /* The kernel and elaborator mostly copy references to imported data, so we skip RC on the region window
+       (see `lean_is_scalar_or_region_obj`). */
+    object_ref(b_obj_arg o, bool):m_obj(o) { lean_inc_skip_region(o); }
+    object_ref(object_ref const & s):m_obj(s.m_obj) { lean_inc_skip_region(m_obj); }
     object_ref(object_ref && s):m_obj(s.m_obj) { s.m_obj = box(0); }
-    ~object_ref() { dec(m_obj); }
+    ~object_ref() { lean_dec_skip_region(m_obj); }
     object_ref & operator=(object_ref const & s) {
-        inc(s.m_obj);
+        lean_inc_skip_region(s.m_obj);
         object * new_obj = s.m_obj;
-        dec(m_obj);
+        lean_dec_skip_region(m_obj);
         m_obj = new_obj;
         return *this;
     }
     object_ref & operator=(object_ref && s) {
-        dec(m_obj);
+        lean_dec_skip_region(m_obj);
         m_obj   = s.m_obj;
         s.m_obj = box(0);
         return *this;
@@ -41,7 +43,7 @@ public:
     }
     object * raw() const { return m_obj; }
     object * steal() { object * r = m_obj; m_obj = box(0); return r; }
-    object * to_obj_arg() const { inc(m_obj); return m_obj; }
+    object * to_obj_arg() const { lean_inc_skip_region(m_obj); return m_obj; }
     static void swap(object_ref & a, object_ref & b) { std::swap(a.m_obj, b.m_obj); }
 };
 
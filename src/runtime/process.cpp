@@ -24,7 +24,11 @@ Author: Jared Roesch
 #include <fcntl.h>
 #include <sys/wait.h>
 #include <signal.h>
+#include <poll.h>
+#include <spawn.h>
 #include <limits.h> // NOLINT
+#include <cstring>
+#include <vector>
 #endif
 
 #include "runtime/object.h"
@@ -34,6 +38,8 @@ Author: Jared Roesch
 #include "runtime/option_ref.h"
 #include "runtime/pair_ref.h"
 #include "runtime/buffer.h"
+#include "runtime/thread.h"
+#include "runtime/utf8.h"
 
 namespace lean {
 
@@ -158,11 +164,15 @@ static void setup_stdio(SECURITY_ATTRIBUTES * saAttr, HANDLE * theirs, object **
 
 // This code is adapted from: https://msdn.microsoft.com/en-us/library/windows/desktop/ms682499(v=vs.85).aspx
 static obj_res spawn(string_ref const & proc_name, array_ref<string_ref> const & args, stdio stdin_mode, stdio stdout_mode,
-                     stdio stderr_mode, option_ref<string_ref> const & cwd, array_ref<pair_ref<string_ref, option_ref<string_ref>>> const & env,
-                     bool _do_setsid) {
+                     stdio stderr_mode, FILE * const redirect[3], option_ref<string_ref> const & cwd,
+                     array_ref<pair_ref<string_ref, option_ref<string_ref>>> const & env, bool _do_setsid) {
     HANDLE child_stdin  = GetStdHandle(STD_INPUT_HANDLE);
     HANDLE child_stdout = GetStdHandle(STD_OUTPUT_HANDLE);
     HANDLE child_stderr = GetStdHandle(STD_ERROR_HANDLE);
+    // redirections replace the inherited handles, see `setup_stdio`
+    if (redirect[0]) child_stdin  = reinterpret_cast<HANDLE>(_get_osfhandle(_fileno(redirect[0])));
+    if (redirect[1]) child_stdout = reinterpret_cast<HANDLE>(_get_osfhandle(_fileno(redirect[1])));
+    if (redirect[2]) child_stderr = reinterpret_cast<HANDLE>(_get_osfhandle(_fileno(redirect[2])));
 
     SECURITY_ATTRIBUTES saAttr;
 
@@ -390,17 +400,131 @@ static optional<pipe> setup_stdio(stdio cfg) {
     lean_unreachable();
 }
 
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 29))
+#define LEAN_SPAWN_ADDCHDIR
+#endif
+
+/* Return true if the process can be started with `posix_spawnp`, which avoids copying the page tables of the
+   (possibly large) parent process like `fork` does. */
+static bool can_posix_spawn(option_ref<string_ref> const & cwd,
+                            array_ref<pair_ref<string_ref, option_ref<string_ref>>> const & env, bool do_setsid) {
+#if !defined(LEAN_SPAWN_ADDCHDIR)
+    if (cwd) return false;
+#endif
+#if !defined(POSIX_SPAWN_SETSID)
+    if (do_setsid) return false;
+#endif
+    for (auto & entry : env) {
+        // `posix_spawnp` searches the `PATH` of the parent, `execvp` after `setenv` the one of the child
+        if (strcmp(entry.fst().data(), "PATH") == 0) return false;
+    }
+    return true;
+}
+
+static void spawn_stdio(posix_spawn_file_actions_t * actions, int fd, optional<pipe> const & p, stdio cfg,
+                        FILE * redirect) {
+    if (p) {
+        // the pipe itself is closed on `exec` as it has been created with `O_CLOEXEC`
+        posix_spawn_file_actions_adddup2(actions, fd == STDIN_FILENO ? p->m_read_fd : p->m_write_fd, fd);
+    } else if (cfg == stdio::NUL) {
+        posix_spawn_file_actions_addopen(actions, fd, "/dev/null", fd == STDIN_FILENO ? O_RDONLY : O_WRONLY, 0);
+    } else if (redirect) {
+        posix_spawn_file_actions_adddup2(actions, fileno(redirect), fd);
+    }
+}
+
+extern "C" char ** environ;
+
+/* Start the process using `posix_spawnp`, return its pid or the error code. */
+static int posix_spawn_child(string_ref const & proc_name, array_ref<string_ref> const & args,
+                             optional<pipe> const (& pipes)[3], stdio const (& modes)[3], FILE * const redirect[3],
+                             option_ref<string_ref> const & cwd,
+                             array_ref<pair_ref<string_ref, option_ref<string_ref>>> const & env, bool do_setsid,
+                             pid_t & pid) {
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    for (int fd = 0; fd < 3; fd++)
+        spawn_stdio(&actions, fd, pipes[fd], modes[fd], redirect[fd]);
+#if defined(LEAN_SPAWN_ADDCHDIR)
+    if (cwd)
+        posix_spawn_file_actions_addchdir_np(&actions, cwd.get()->data());
+#endif
+    posix_spawnattr_t attr;
+    posix_spawnattr_init(&attr);
+#if defined(POSIX_SPAWN_SETSID)
+    if (do_setsid)
+        posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSID);
+#endif
+
+    std::vector<char *> pargs;
+    pargs.push_back(const_cast<char *>(proc_name.data()));
+    for (auto & arg : args)
+        pargs.push_back(const_cast<char *>(arg.data()));
+    pargs.push_back(nullptr);
+
+    char ** envp = environ;
+    std::vector<std::string> new_vars;
+    std::vector<char *> new_envp;
+    if (env.size() > 0) {
+        auto is_updated = [&](char const * var, size_t len, size_t from) {
+            for (size_t j = from; j < env.size(); j++) {
+                char const * name = env[j].fst().data();
+                if (strlen(name) == len && strncmp(name, var, len) == 0) return true;
+            }
+            return false;
+        };
+        for (char ** e = environ; *e; e++) {
+            char const * eq = strchr(*e, '=');
+            if (!is_updated(*e, eq ? eq - *e : strlen(*e), 0))
+                new_envp.push_back(*e);
+        }
+        for (size_t i = 0; i < env.size(); i++) {
+            auto const & entry = env[i];
+            // like `setenv`/`unsetenv` in order, the last update of a variable wins
+            if (entry.snd() && !is_updated(entry.fst().data(), strlen(entry.fst().data()), i + 1))
+                new_vars.push_back(entry.fst().to_std_string() + "=" + entry.snd().get()->to_std_string());
+        }
+        for (auto & var : new_vars)
+            new_envp.push_back(const_cast<char *>(var.c_str()));
+        new_envp.push_back(nullptr);
+        envp = new_envp.data();
+    }
+
+    int err = posix_spawnp(&pid, pargs[0], &actions, &attr, pargs.data(), envp);
+    posix_spawnattr_destroy(&attr);
+    posix_spawn_file_actions_destroy(&actions);
+    return err;
+}
+
 static obj_res spawn(string_ref const & proc_name, array_ref<string_ref> const & args, stdio stdin_mode, stdio stdout_mode,
-  stdio stderr_mode, option_ref<string_ref> const & cwd, array_ref<pair_ref<string_ref, option_ref<string_ref>>> const & env,
-  bool do_setsid) {
+  stdio stderr_mode, FILE * const redirect[3], option_ref<string_ref> const & cwd,
+  array_ref<pair_ref<string_ref, option_ref<string_ref>>> const & env, bool do_setsid) {
     /* Setup stdio based on process configuration. */
     auto stdin_pipe  = setup_stdio(stdin_mode);
     auto stdout_pipe = setup_stdio(stdout_mode);
     auto stderr_pipe = setup_stdio(stderr_mode);
+    for (int fd = 0; fd < 3; fd++) {
+        // the child must see everything written to the handle before
+        if (redirect[fd])
+            fflush(redirect[fd]);
+    }
 
-    int pid = fork();
-
-    if (pid == 0) {
+    pid_t pid;
+    if (can_posix_spawn(cwd, env, do_setsid)) {
+        optional<pipe> const pipes[3] = { stdin_pipe, stdout_pipe, stderr_pipe };
+        stdio const modes[3] = { stdin_mode, stdout_mode, stderr_mode };
+        if (int err = posix_spawn_child(proc_name, args, pipes, modes, redirect, cwd, env, do_setsid, pid)) {
+            for (auto const & p : pipes) {
+                if (p) {
+                    close(p->m_read_fd);
+                    close(p->m_write_fd);
+                }
+            }
+            // unlike with `fork`, failing to change the directory or to execute the program is reported here
+            bool bad_cwd = cwd && access(cwd.get()->data(), F_OK) != 0;
+            return io_result_mk_error(decode_io_error(err, bad_cwd ? cwd.get()->raw() : proc_name.raw()));
+        }
+    } else if ((pid = fork()) == 0) {
         for (auto & entry : env) {
             if (entry.snd()) {
                 setenv(entry.fst().data(), entry.snd().get()->data(), true);
@@ -415,6 +539,8 @@ static obj_res spawn(string_ref const & proc_name, array_ref<string_ref> const &
         } else if (stdin_mode == stdio::NUL) {
             int fd = open("/dev/null", O_RDONLY);
             dup2(fd, STDIN_FILENO);
+        } else if (redirect[0]) {
+            dup2(fileno(redirect[0]), STDIN_FILENO);
         }
 
         if (stdout_pipe) {
@@ -423,6 +549,8 @@ static obj_res spawn(string_ref const & proc_name, array_ref<string_ref> const &
         } else if (stdout_mode == stdio::NUL) {
             int fd = open("/dev/null", O_WRONLY);
             dup2(fd, STDOUT_FILENO);
+        } else if (redirect[1]) {
+            dup2(fileno(redirect[1]), STDOUT_FILENO);
         }
 
         if (stderr_pipe) {
@@ -431,6 +559,8 @@ static obj_res spawn(string_ref const & proc_name, array_ref<string_ref> const &
         } else if (stderr_mode == stdio::NUL) {
             int fd = open("/dev/null", O_WRONLY);
             dup2(fd, STDERR_FILENO);
+        } else if (redirect[2]) {
+            dup2(fileno(redirect[2]), STDERR_FILENO);
         }
 
         if (cwd) {
@@ -507,6 +637,14 @@ extern "C" LEAN_EXPORT obj_res lean_io_process_spawn(obj_arg args_, obj_arg) {
     if (stdin_mode == stdio::INHERIT) {
         std::cout.flush();
     }
+    // `SpawnArgs.stdinFrom?`, `stdoutTo?` and `stderrTo?`, used instead of inherited stdio only
+    FILE * redirect[3] = { nullptr, nullptr, nullptr };
+    stdio modes[3] = { stdin_mode, stdout_mode, stderr_mode };
+    for (int i = 0; i < 3; i++) {
+        object * h = cnstr_get(args.raw(), 5 + i);
+        if (!is_scalar(h) && modes[i] == stdio::INHERIT)
+            redirect[i] = io_get_handle(cnstr_get(h, 0));
+    }
     try {
         return spawn(
                 cnstr_get_ref_t<string_ref>(args, 1),
@@ -514,9 +652,10 @@ extern "C" LEAN_EXPORT obj_res lean_io_process_spawn(obj_arg args_, obj_arg) {
                 stdin_mode,
                 stdout_mode,
                 stderr_mode,
+                redirect,
                 cnstr_get_ref_t<option_ref<string_ref>>(args, 3),
                 cnstr_get_ref_t<array_ref<pair_ref<string_ref, option_ref<string_ref>>>>(args, 4),
-                cnstr_get_uint8(args.raw(), 5 * sizeof(object *)));
+                cnstr_get_uint8(args.raw(), 8 * sizeof(object *)));
     } catch (int err) {
         return lean_io_result_mk_error(decode_io_error(err, nullptr));
     } catch (std::system_error const & err) {
@@ -525,4 +664,117 @@ extern "C" LEAN_EXPORT obj_res lean_io_process_spawn(obj_arg args_, obj_arg) {
     }
 }
 
+/* Output of a child process read by `lean_io_process_collect_output`. The data is read directly into a string
+   object so that no copy is needed at the end. */
+class output_buffer {
+    object * m_str;
+    size_t   m_size = 0;
+    size_t   m_max;
+public:
+    explicit output_buffer(size_t max):m_str(alloc_string(1, 4096, 0)), m_max(max) {}
+    output_buffer(output_buffer const &) = delete;
+    ~output_buffer() { if (m_str) dec_ref(m_str); }
+
+    /* Read once from `fd`, keeping at most `m_max` bytes in total. Return the result of `read`. */
+    ptrdiff_t read_from(int fd) {
+        size_t cap = string_capacity(m_str) - 1; // space for the terminating null character
+        if (m_size == cap && m_size < m_max) {
+            object * new_str = alloc_string(1, std::min(2 * cap, m_max) + 1, 0);
+            memcpy(lean_to_string(new_str)->m_data, string_cstr(m_str), m_size);
+            dec_ref(m_str);
+            m_str = new_str;
+            cap = string_capacity(m_str) - 1;
+        }
+        size_t limit = std::min(cap, m_max);
+        if (m_size >= limit) {
+            // over the limit, drain and discard the data so that the child process is not blocked
+            char discard[4096];
+            return ::read(fd, discard, sizeof(discard));
+        }
+        ptrdiff_t n = ::read(fd, lean_to_string(m_str)->m_data + m_size, limit - m_size);
+        if (n > 0)
+            m_size += n;
+        return n;
+    }
+
+    /* Return the output as a string, or `nullptr` if it is not valid UTF-8. */
+    object * finish() {
+        uint8_t const * data = reinterpret_cast<uint8_t const *>(string_cstr(m_str));
+        if (m_size == m_max && m_size > 0) {
+            // drop a character cut off by the limit
+            size_t last = m_size - 1;
+            while (last > 0 && m_size - last < 4 && is_utf8_next(data[last]))
+                last--;
+            if (last + get_utf8_size(data[last]) > m_size)
+                m_size = last;
+        }
+        size_t pos = 0, len = 0;
+        if (!validate_utf8(data, m_size, pos, len))
+            return nullptr;
+        lean_to_string(m_str)->m_data[m_size] = 0;
+        lean_to_string(m_str)->m_size   = m_size + 1;
+        lean_to_string(m_str)->m_length = len;
+        object * r = m_str;
+        m_str = nullptr;
+        return r;
+    }
+};
+
+#if defined(LEAN_WINDOWS)
+static int drain_fd(int fd, output_buffer & buf) {
+    ptrdiff_t n;
+    while ((n = buf.read_from(fd)) > 0) {}
+    return n < 0 ? errno : 0;
+}
+#endif
+
+/* collectOutput (stdout stderr : @& FS.Handle) (maxBytes? : @& Option Nat) : IO (String × String) */
+extern "C" LEAN_EXPORT obj_res lean_io_process_collect_output(b_obj_arg out_h, b_obj_arg err_h, b_obj_arg max_bytes, obj_arg) {
+    size_t max = SIZE_MAX - 1;
+    if (!is_scalar(max_bytes) && is_scalar(cnstr_get(max_bytes, 0)))
+        max = std::min<size_t>(max, unbox(cnstr_get(max_bytes, 0)));
+    output_buffer out_buf(max), err_buf(max);
+    output_buffer * bufs[2] = { &out_buf, &err_buf };
+    int fds[2] = { fileno(io_get_handle(out_h)), fileno(io_get_handle(err_h)) };
+#if defined(LEAN_WINDOWS)
+    // there is no `poll` for pipes, so read stderr on a separate thread
+    int err_errno = 0;
+    int out_errno;
+    {
+        lthread err_thread([&]() { err_errno = drain_fd(fds[1], err_buf); });
+        out_errno = drain_fd(fds[0], out_buf);
+    }
+    if (out_errno != 0 || err_errno != 0)
+        return io_result_mk_error(decode_io_error(out_errno != 0 ? out_errno : err_errno, nullptr));
+#else
+    struct pollfd pfds[2] = { { fds[0], POLLIN, 0 }, { fds[1], POLLIN, 0 } };
+    int num_open = 2;
+    while (num_open > 0) {
+        if (poll(pfds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            return io_result_mk_error(decode_io_error(errno, nullptr));
+        }
+        for (int i = 0; i < 2; i++) {
+            if (pfds[i].fd < 0 || !(pfds[i].revents & (POLLIN | POLLHUP | POLLERR)))
+                continue;
+            ptrdiff_t n = bufs[i]->read_from(pfds[i].fd);
+            if (n < 0 && errno != EINTR && errno != EAGAIN)
+                return io_result_mk_error(decode_io_error(errno, nullptr));
+            if (n == 0) {
+                // `poll` ignores negative file descriptors
+                pfds[i].fd = -1;
+                num_open--;
+            }
+        }
+    }
+#endif
+    object * out = out_buf.finish();
+    object * err = out ? err_buf.finish() : nullptr;
+    if (!err) {
+        if (out) dec_ref(out);
+        return io_result_mk_error("Tried to read from handle containing non UTF-8 data.");
+    }
+    return io_result_mk_ok(mk_cnstr(0, out, err).steal());
+}
+
 }
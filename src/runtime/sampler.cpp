@@ -0,0 +1,263 @@
+/*
+Copyright (c) 2024 Lean FRO, LLC. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+*/
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "runtime/sampler.h"
+#include "runtime/thread.h"
+#include "runtime/io.h"
+#include "runtime/exception.h"
+
+#if defined(__GLIBC__) && !defined(LEAN_EMSCRIPTEN)
+#define LEAN_SAMPLER
+#include <csignal>
+#include <sys/time.h>
+#include <execinfo.h>
+#include <dlfcn.h>
+#include <cxxabi.h>
+#endif
+
+#define LEAN_SAMPLER_MAX_NATIVE_DEPTH 128
+#define LEAN_SAMPLER_MAX_FRAMES 256
+/* Size of the sample buffer in words. It is allocated when sampling starts, but only the pages that are written to
+   are actually backed by memory. */
+#define LEAN_SAMPLER_BUFFER_SIZE (16 * 1024 * 1024)
+
+namespace lean {
+struct sampler_stack {
+    object * m_frames[LEAN_SAMPLER_MAX_FRAMES];
+    unsigned m_depth;
+};
+
+/* Zero-initialized, so that accessing it from the signal handler does not run a constructor. */
+static LEAN_THREAD_LOCAL sampler_stack g_sampler_stack;
+
+unsigned sampler_frame_depth() {
+    return g_sampler_stack.m_depth;
+}
+
+void sampler_enter_frame(unsigned depth, object * fn) {
+    sampler_stack & s = g_sampler_stack;
+    if (depth < LEAN_SAMPLER_MAX_FRAMES)
+        s.m_frames[depth] = fn;
+    // the frame must be visible to the signal handler before the new depth
+    std::atomic_signal_fence(std::memory_order_release);
+    s.m_depth = depth + 1;
+}
+
+void sampler_leave_frame(unsigned depth) {
+    g_sampler_stack.m_depth = depth;
+}
+
+static std::atomic<bool> g_sampling(false);
+
+bool is_sampling() {
+    return g_sampling.load(std::memory_order_relaxed);
+}
+
+#ifdef LEAN_SAMPLER
+/* Layout of a sample in the buffer: time in nanoseconds, thread key, number of native frames `n`, number of
+   interpreter frames `m`, `n` return addresses (innermost first), `m` name objects (outermost first). */
+static constexpr size_t sample_header_size = 4;
+
+static uintptr_t *          g_buffer = nullptr;
+static std::atomic<size_t>  g_buffer_pos(0);
+/* End of the last sample that fit into the buffer. */
+static std::atomic<size_t>  g_buffer_end(0);
+static std::atomic<unsigned> g_handlers_running(0);
+static uintptr_t            g_main_thread = 0;
+static bool                 g_handler_installed = false;
+
+/* Identifies the current thread. The runtime is compiled with `-ftls-model=initial-exec`, so the address of a
+   thread-local variable can be taken in a signal handler. */
+static uintptr_t current_thread_key() {
+    return reinterpret_cast<uintptr_t>(&g_sampler_stack);
+}
+
+static void sampler_handler(int) {
+    int saved_errno = errno;
+    g_handlers_running++;
+    if (g_sampling) {
+        // skip `sampler_handler` and the signal trampoline
+        constexpr int skip = 2;
+        void * pcs[LEAN_SAMPLER_MAX_NATIVE_DEPTH + skip];
+        int n = backtrace(pcs, LEAN_SAMPLER_MAX_NATIVE_DEPTH + skip);
+        size_t num_native = n > skip ? n - skip : 0;
+        sampler_stack const & s = g_sampler_stack;
+        size_t num_frames = s.m_depth < LEAN_SAMPLER_MAX_FRAMES ? s.m_depth : LEAN_SAMPLER_MAX_FRAMES;
+        std::atomic_signal_fence(std::memory_order_acquire);
+        size_t len = sample_header_size + num_native + num_frames;
+        size_t pos = g_buffer_pos.fetch_add(len);
+        // once the buffer is full, further samples are dropped
+        if (pos + len <= LEAN_SAMPLER_BUFFER_SIZE) {
+            uintptr_t * p = g_buffer + pos;
+            auto now = std::chrono::steady_clock::now().time_since_epoch();
+            p[0] = std::chrono::duration_cast<std::chrono::nanoseconds>(now).count();
+            p[1] = current_thread_key();
+            p[2] = num_native;
+            p[3] = num_frames;
+            p += sample_header_size;
+            for (size_t i = 0; i < num_native; i++)
+                p[i] = reinterpret_cast<uintptr_t>(pcs[skip + i]);
+            p += num_native;
+            for (size_t i = 0; i < num_frames; i++)
+                p[i] = reinterpret_cast<uintptr_t>(s.m_frames[i]);
+            size_t end = g_buffer_end;
+            while (end < pos + len && !g_buffer_end.compare_exchange_weak(end, pos + len)) {}
+        }
+    }
+    g_handlers_running--;
+    errno = saved_errno;
+}
+
+static void set_sampling_timer(unsigned interval_us) {
+    itimerval t;
+    t.it_interval.tv_sec  = interval_us / 1000000;
+    t.it_interval.tv_usec = interval_us % 1000000;
+    t.it_value            = t.it_interval;
+    setitimer(ITIMER_PROF, &t, nullptr);
+}
+
+static void start_sampling(unsigned interval_us) {
+    if (interval_us == 0)
+        throw exception("sampling interval must be positive");
+    if (g_sampling)
+        throw exception("sampling profiler is already running");
+    // `backtrace` loads the unwinder on its first call, which must not happen in the signal handler
+    void * dummy[1];
+    backtrace(dummy, 1);
+    g_buffer       = new uintptr_t[LEAN_SAMPLER_BUFFER_SIZE];
+    g_buffer_pos   = 0;
+    g_buffer_end   = 0;
+    g_main_thread  = current_thread_key();
+    if (!g_handler_installed) {
+        // The handler stays installed after sampling stops: it ignores signals that are still pending, while the
+        // default action of `SIGPROF` would terminate the process.
+        struct sigaction sa;
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_handler = sampler_handler;
+        sa.sa_flags   = SA_RESTART;
+        sigemptyset(&sa.sa_mask);
+        if (sigaction(SIGPROF, &sa, nullptr) != 0) {
+            delete[] g_buffer;
+            g_buffer = nullptr;
+            throw exception("failed to install signal handler for the sampling profiler");
+        }
+        g_handler_installed = true;
+    }
+    g_sampling = true;
+    set_sampling_timer(interval_us);
+}
+
+static std::string symbolize(void * pc) {
+    Dl_info info;
+    if (dladdr(pc, &info) && info.dli_sname) {
+        int status = 0;
+        if (char * d = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status)) {
+            std::string r(d);
+            free(d);
+            return r;
+        }
+        return info.dli_sname;
+    }
+    std::ostringstream out;
+    out << pc;
+    return out.str();
+}
+
+/* Structure `IO.ProfileSample`. */
+static obj_res mk_profile_sample(obj_arg native, obj_arg interpreted, uint64 time, unsigned thread) {
+    object * r = alloc_cnstr(0, 2, sizeof(uint64) + sizeof(uint32));
+    cnstr_set(r, 0, native);
+    cnstr_set(r, 1, interpreted);
+    cnstr_set_uint64(r, 2 * sizeof(object *), time);
+    cnstr_set_uint32(r, 2 * sizeof(object *) + sizeof(uint64), thread);
+    return r;
+}
+
+static obj_res stop_sampling() {
+    if (!g_sampling)
+        throw exception("sampling profiler is not running");
+    set_sampling_timer(0);
+    g_sampling = false;
+    while (g_handlers_running > 0)
+        this_thread::yield();
+    std::unordered_map<uintptr_t, unsigned> threads;
+    threads[g_main_thread] = 0;
+    // symbols of return addresses, i.e. of the instruction preceding the address
+    std::unordered_map<uintptr_t, object *> symbols;
+    object * r = array_mk_empty();
+    size_t end = g_buffer_end;
+    for (size_t pos = 0; pos < end;) {
+        uintptr_t const * p = g_buffer + pos;
+        uint64 time        = p[0];
+        unsigned thread    = threads.emplace(p[1], threads.size()).first->second;
+        size_t num_native  = p[2];
+        size_t num_frames  = p[3];
+        p += sample_header_size;
+        object * native = array_mk_empty();
+        for (size_t i = num_native; i > 0; i--) {
+            // the innermost address is the interrupted instruction, the other ones are return addresses
+            uintptr_t pc = i == 1 ? p[0] : p[i - 1] - 1;
+            auto it = symbols.find(pc);
+            if (it == symbols.end())
+                it = symbols.emplace(pc, mk_string(symbolize(reinterpret_cast<void *>(pc)))).first;
+            inc(it->second);
+            native = array_push(native, it->second);
+        }
+        p += num_native;
+        object * interpreted = array_mk_empty();
+        for (size_t i = 0; i < num_frames; i++) {
+            object * fn = reinterpret_cast<object *>(p[i]);
+            if (fn) {
+                inc(fn);
+                interpreted = array_push(interpreted, fn);
+            }
+        }
+        r   = array_push(r, mk_profile_sample(native, interpreted, time, thread));
+        pos += sample_header_size + num_native + num_frames;
+    }
+    for (auto const & s : symbols)
+        dec(s.second);
+    delete[] g_buffer;
+    g_buffer = nullptr;
+    return r;
+}
+#else
+static void start_sampling(unsigned) {
+    throw exception("sampling profiler is not supported on this platform");
+}
+
+static obj_res stop_sampling() {
+    throw exception("sampling profiler is not supported on this platform");
+}
+#endif
+
+/* IO.startSampling (intervalUs : UInt32) : IO Unit */
+extern "C" LEAN_EXPORT obj_res lean_io_start_sampling(uint32 interval_us, obj_arg /* w */) {
+    try {
+        start_sampling(interval_us);
+        return io_result_mk_ok(box(0));
+    } catch (exception & ex) {
+        return io_result_mk_error(ex.what());
+    }
+}
+
+/* IO.stopSampling : IO (Array IO.ProfileSample) */
+extern "C" LEAN_EXPORT obj_res lean_io_stop_sampling(obj_arg /* w */) {
+    try {
+        return io_result_mk_ok(stop_sampling());
+    } catch (exception & ex) {
+        return io_result_mk_error(ex.what());
+    }
+}
+}
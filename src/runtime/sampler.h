@@ -0,0 +1,26 @@
+/*
+Copyright (c) 2024 Lean FRO, LLC. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+*/
+#pragma once
+#include "runtime/object.h"
+
+namespace lean {
+/* Sampling CPU profiler.
+
+   While sampling is active, `SIGPROF` is delivered every `interval_us` microseconds of CPU time (`ITIMER_PROF`) to
+   the running thread, whose signal handler records the native call stack (`backtrace`) together with the frames of
+   the IR interpreter that are active on that thread. Samples are written into a preallocated buffer, and
+   symbolized only when sampling stops: C++ symbols are demangled, and compiled Lean functions keep their mangled
+   C names (`l_...`), which are demangled by `Lean.Firefox`. Sampling is only supported on platforms with glibc. */
+LEAN_EXPORT bool is_sampling();
+
+/* Shadow stack of interpreter frames, read by the signal handler of the sampling profiler.
+   `sampler_enter_frame(d, fn)` records `fn` as the frame at depth `d` and makes `d + 1` the current depth,
+   `sampler_leave_frame(d)` resets the depth to `d`. Frames are addressed by depth instead of being pushed and
+   popped so that an interpreter can restore its part of the stack after an exception.
+   `fn` must be a name object that is never deleted (see `intern_name`), or `nullptr` for an unknown frame. */
+LEAN_EXPORT unsigned sampler_frame_depth();
+LEAN_EXPORT void sampler_enter_frame(unsigned depth, object * fn);
+LEAN_EXPORT void sampler_leave_frame(unsigned depth);
+}
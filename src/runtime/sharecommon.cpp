@@ -5,8 +5,13 @@ Released under Apache 2.0 license as described in the file LICENSE.
 Author: Leonardo de Moura
 */
 #include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <memory>
 #include "runtime/sharecommon.h"
 #include "runtime/hash.h"
+#include "runtime/thread.h"
+#include "runtime/io.h"
 
 namespace lean {
 
@@ -32,7 +37,7 @@ extern "C" LEAN_EXPORT uint64_t lean_sharecommon_hash(b_obj_arg o) {
     // hash relevant parts of the header
     unsigned init = hash(lean_ptr_tag(o), lean_ptr_other(o));
     // hash body
-    return hash_str(sz - header_sz, reinterpret_cast<unsigned char const *>(o) + header_sz, init);
+    return hash_bytes(sz - header_sz, reinterpret_cast<unsigned char const *>(o) + header_sz, init);
 }
 
 static obj_res mk_pair(obj_arg a, obj_arg b) {
@@ -432,4 +437,510 @@ lean_object * sharecommon_persistent_fn::operator()(lean_object * e) {
     m_saved.push_back(object_ref(r, true));
     return r;
 }
+
+struct sharecommon_object_hash {
+    std::size_t operator()(lean_object * o) const { return lean_sharecommon_hash(o); }
+};
+struct sharecommon_object_eq {
+    bool operator()(lean_object * o1, lean_object * o2) const { return lean_sharecommon_eq(o1, o2); }
+};
+typedef std::unordered_set<lean_object *, sharecommon_object_hash, sharecommon_object_eq> sharecommon_object_set;
+
+/*
+Process-wide hash-consing table used by `sharecommon_global_fn`.
+
+The table owns a reference to each of its objects. All of them are multi-threaded or persistent
+(or single-threaded if `LEAN_MULTI_THREAD` is not defined). An object only referenced by the table
+cannot become reachable again without a lookup, and lookups take the lock of the object's shard,
+so `prune` can safely remove it while holding this lock.
+*/
+class sharecommon_global_table {
+    struct shard {
+        mutex                  m_mutex;
+        sharecommon_object_set m_set;
+        /* We prune the shard when its size doubles after the last pruning. */
+        size_t     m_prune_threshold = 1024;
+    };
+    static constexpr unsigned num_shards = 64;
+    shard m_shards[num_shards];
+
+    shard & get_shard(lean_object * o) { return m_shards[lean_sharecommon_hash(o) % num_shards]; }
+
+    static bool only_referenced_by_table(lean_object * o) {
+        if (lean_is_st(o))
+            return o->m_rc == 1;
+        else if (lean_is_mt(o))
+            return lean_get_rc_mt_addr(o)->load(std::memory_order_acquire) == -1;
+        else
+            return false; // persistent objects are never deleted
+    }
+
+    /* Remove the objects only referenced by the table. The lock of `s` must be held. */
+    static size_t prune_core(shard & s) {
+        size_t num_removed = 0;
+        auto it = s.m_set.begin();
+        while (it != s.m_set.end()) {
+            lean_object * o = *it;
+            if (only_referenced_by_table(o)) {
+                it = s.m_set.erase(it);
+                lean_dec_ref(o);
+                num_removed++;
+            } else {
+                ++it;
+            }
+        }
+        s.m_prune_threshold = std::max(static_cast<size_t>(1024), 2 * s.m_set.size());
+        return num_removed;
+    }
+
+public:
+    ~sharecommon_global_table() {
+        for (shard & s : m_shards) {
+            for (lean_object * o : s.m_set)
+                lean_dec_ref(o);
+        }
+    }
+
+    /* Return the object in the table equal to `o` (with its reference counter incremented),
+       or `nullptr` if there is none. */
+    lean_object * find(lean_object * o) {
+        shard & s = get_shard(o);
+        lock_guard<mutex> lock(s.m_mutex);
+        auto it = s.m_set.find(o);
+        if (it == s.m_set.end())
+            return nullptr;
+        lean_inc_ref(*it);
+        return *it;
+    }
+
+    /* Return the object in the table equal to `o`, inserting `o` if there is none.
+       The sub-objects of `o` must be in the table already, and `o` must have been marked
+       as multi-threaded. This function takes ownership of `o`. */
+    lean_object * insert(lean_object * o) {
+        shard & s = get_shard(o);
+        lean_object * r;
+        {
+            lock_guard<mutex> lock(s.m_mutex);
+            auto p = s.m_set.insert(o);
+            r = *p.first;
+            // One reference for the table if `o` is new, and one for the caller otherwise.
+            lean_inc_ref(r);
+            if (p.second && s.m_set.size() >= s.m_prune_threshold)
+                prune_core(s);
+        }
+        if (r != o)
+            lean_dec_ref(o);
+        return r;
+    }
+
+    size_t prune() {
+        size_t num_removed = 0;
+        /* Removing an object may leave its sub-objects only referenced by the table. */
+        while (true) {
+            size_t n = 0;
+            for (shard & s : m_shards) {
+                lock_guard<mutex> lock(s.m_mutex);
+                n += prune_core(s);
+            }
+            if (n == 0)
+                return num_removed;
+            num_removed += n;
+        }
+    }
+
+    size_t size() {
+        size_t r = 0;
+        for (shard & s : m_shards) {
+            lock_guard<mutex> lock(s.m_mutex);
+            r += s.m_set.size();
+        }
+        return r;
+    }
+};
+
+static sharecommon_global_table * g_sharecommon_global_table = nullptr;
+
+/* Return `o` after marking it as multi-threaded, and inserting it into the global table. */
+static lean_object * sharecommon_global_insert(lean_object * o) {
+    lean_mark_mt(o);
+    return g_sharecommon_global_table->insert(o);
+}
+
+lean_object * sharecommon_global_fn::visit_array(lean_object * a) {
+    size_t sz = array_size(a);
+    lean_object * new_a = nullptr;
+    for (size_t i = 0; i < sz; i++) {
+        lean_object * v     = lean_array_get_core(a, i);
+        lean_object * new_v = visit(v);
+        if (new_a == nullptr && new_v != v) {
+            new_a = lean_alloc_array(sz, sz);
+            for (size_t j = 0; j < i; j++) {
+                lean_object * w = lean_array_get_core(a, j);
+                lean_inc(w);
+                lean_array_set_core(new_a, j, w);
+            }
+        }
+        if (new_a != nullptr)
+            lean_array_set_core(new_a, i, new_v);
+        else
+            lean_dec(new_v); // `new_v == v`, and `a` keeps it alive
+    }
+    if (new_a == nullptr) {
+        if (lean_array_capacity(a) == sz) {
+            lean_inc_ref(a);
+            return sharecommon_global_insert(a);
+        }
+        // We do not store unused capacity in the table since `lean_sharecommon_eq` compares it.
+        new_a = lean_alloc_array(sz, sz);
+        for (size_t i = 0; i < sz; i++) {
+            lean_object * v = lean_array_get_core(a, i);
+            lean_inc(v);
+            lean_array_set_core(new_a, i, v);
+        }
+    }
+    return sharecommon_global_insert(new_a);
+}
+
+lean_object * sharecommon_global_fn::visit_ctor(lean_object * a) {
+    unsigned num_objs   = lean_ctor_num_objs(a);
+    lean_object * new_a = nullptr;
+    for (unsigned i = 0; i < num_objs; i++) {
+        lean_object * v     = lean_ctor_get(a, i);
+        lean_object * new_v = visit(v);
+        if (new_a == nullptr && new_v != v) {
+            unsigned sz            = lean_object_byte_size(a);
+            unsigned scalar_offset = sizeof(lean_object) + num_objs*sizeof(void*);
+            unsigned scalar_sz     = sz - scalar_offset;
+            new_a = lean_alloc_ctor(lean_ptr_tag(a), num_objs, scalar_sz);
+            for (unsigned j = 0; j < i; j++) {
+                lean_object * w = lean_ctor_get(a, j);
+                lean_inc(w);
+                lean_ctor_set(new_a, j, w);
+            }
+            if (scalar_sz > 0) {
+                memcpy(reinterpret_cast<char*>(new_a) + scalar_offset, reinterpret_cast<char*>(a) + scalar_offset, scalar_sz);
+            }
+        }
+        if (new_a != nullptr)
+            lean_ctor_set(new_a, i, new_v);
+        else
+            lean_dec(new_v); // `new_v == v`, and `a` keeps it alive
+    }
+    if (new_a == nullptr) {
+        // The sub-objects of `a` are already in the table, we do not need a copy.
+        lean_inc_ref(a);
+        new_a = a;
+    }
+    return sharecommon_global_insert(new_a);
+}
+
+lean_object * sharecommon_global_fn::visit(lean_object * a) {
+    if (lean_is_scalar(a)) {
+        return a;
+    }
+    switch (lean_ptr_tag(a)) {
+    case LeanMPZ:             lean_inc_ref(a); return a;
+    case LeanClosure:         lean_inc_ref(a); return a;
+    case LeanThunk:           lean_inc_ref(a); return a;
+    case LeanTask:            lean_inc_ref(a); return a;
+    case LeanRef:             lean_inc_ref(a); return a;
+    case LeanExternal:        lean_inc_ref(a); return a;
+    case LeanReserved:        lean_inc_ref(a); return a;
+    case LeanScalarArray:
+        if (lean_sarray_capacity(a) != lean_sarray_size(a)) {
+            unsigned elem_sz    = lean_sarray_elem_size(a);
+            size_t sz           = lean_sarray_size(a);
+            lean_object * new_a = lean_alloc_sarray(elem_sz, sz, sz);
+            memcpy(lean_sarray_cptr(new_a), lean_sarray_cptr(a), elem_sz * sz);
+            return sharecommon_global_insert(new_a);
+        }
+        lean_inc_ref(a);
+        return sharecommon_global_insert(a);
+    case LeanString:
+        if (lean_string_capacity(a) != lean_string_size(a))
+            return sharecommon_global_insert(lean_mk_string_unchecked(lean_string_cstr(a), lean_string_size(a) - 1, lean_string_len(a)));
+        lean_inc_ref(a);
+        return sharecommon_global_insert(a);
+    default:
+        break;
+    }
+    bool shared = !lean_is_exclusive(a);
+    if (shared) {
+        auto it = m_cache.find(a);
+        if (it != m_cache.end()) {
+            lean_inc_ref(it->second);
+            return it->second;
+        }
+        if (!lean_is_st(a)) {
+            /* Multi-threaded and persistent objects are often the result of previous calls. If `a` is
+               equal to an object `r` in the table, then `a` and `r` have the same sub-objects,
+               and we do not need to visit them. */
+            if (lean_object * r = g_sharecommon_global_table->find(a)) {
+                m_cache.insert(std::make_pair(a, r));
+                return r;
+            }
+        }
+    }
+    lean_object * r = lean_ptr_tag(a) == LeanArray ? visit_array(a) : visit_ctor(a);
+    if (shared)
+        m_cache.insert(std::make_pair(a, r));
+    return r;
+}
+
+/*
+Concurrent hash-consing table used by `sharecommon_parallel_fn`. As `m_set` at `sharecommon_quick_fn`,
+it does not own references to its objects since they are subobjects of the input or of the result.
+*/
+class sharecommon_concurrent_set {
+    struct shard {
+        mutex                  m_mutex;
+        sharecommon_object_set m_set;
+    };
+    static constexpr unsigned num_shards = 64;
+    shard m_shards[num_shards];
+public:
+    /* Return the object in the set equal to `o`, inserting `o` if there is none. */
+    lean_object * insert(lean_object * o) {
+        shard & s = m_shards[lean_sharecommon_hash(o) % num_shards];
+        lock_guard<mutex> lock(s.m_mutex);
+        return *s.m_set.insert(o).first;
+    }
+};
+
+/*
+Similar to `sharecommon_quick_fn`, but the hash-consing table is shared with other threads.
+All input objects must be multi-threaded, and all new objects are marked as multi-threaded before
+being inserted into the table.
+
+The range of `m_cache` contains objects that are kept alive by the results of the calling
+`sharecommon_parallel_fn`, and we do not increment their reference counters when caching them.
+*/
+class sharecommon_parallel_worker {
+    sharecommon_concurrent_set &                     m_set;
+    std::unordered_map<lean_object *, lean_object *> m_cache;
+
+    lean_object * check_cache(lean_object * a) {
+        auto it = m_cache.find(a);
+        if (it == m_cache.end())
+            return nullptr;
+        lean_inc_ref(it->second);
+        return it->second;
+    }
+
+    lean_object * save(lean_object * a, lean_object * new_a) {
+        lean_mark_mt(new_a);
+        lean_object * r = m_set.insert(new_a);
+        if (r != new_a) {
+            // `r` is a subobject of a result, and it cannot be deleted concurrently.
+            lean_inc_ref(r);
+            lean_dec_ref(new_a);
+        }
+        m_cache.insert(std::make_pair(a, r));
+        return r;
+    }
+
+    lean_object * visit_terminal(lean_object * a) {
+        lean_object * r = m_set.insert(a);
+        lean_inc_ref(r);
+        return r;
+    }
+
+    lean_object * visit_array(lean_object * a) {
+        if (lean_object * r = check_cache(a)) return r;
+        size_t sz = array_size(a);
+        lean_object * new_a = lean_alloc_array(sz, sz);
+        for (size_t i = 0; i < sz; i++) {
+            lean_array_set_core(new_a, i, visit(lean_array_get_core(a, i)));
+        }
+        return save(a, new_a);
+    }
+
+    lean_object * visit_ctor(lean_object * a) {
+        if (lean_object * r = check_cache(a)) return r;
+        unsigned num_objs      = lean_ctor_num_objs(a);
+        unsigned sz            = lean_object_byte_size(a);
+        unsigned scalar_offset = sizeof(lean_object) + num_objs*sizeof(void*);
+        unsigned scalar_sz     = sz - scalar_offset;
+        lean_object * new_a    = lean_alloc_ctor(lean_ptr_tag(a), num_objs, scalar_sz);
+        for (unsigned i = 0; i < num_objs; i++) {
+            lean_ctor_set(new_a, i, visit(lean_ctor_get(a, i)));
+        }
+        if (scalar_sz > 0) {
+            memcpy(reinterpret_cast<char*>(new_a) + scalar_offset, reinterpret_cast<char*>(a) + scalar_offset, scalar_sz);
+        }
+        return save(a, new_a);
+    }
+
+public:
+    sharecommon_parallel_worker(sharecommon_concurrent_set & s):m_set(s) {}
+
+    /* Use `r` as the result for `a`. `r` must be kept alive by the caller. */
+    void set_result(lean_object * a, lean_object * r) {
+        m_cache.insert(std::make_pair(a, r));
+    }
+
+    lean_object * visit(lean_object * a) {
+        if (lean_is_scalar(a)) {
+            return a;
+        }
+        switch (lean_ptr_tag(a)) {
+        case LeanMPZ:             lean_inc_ref(a); return a;
+        case LeanClosure:         lean_inc_ref(a); return a;
+        case LeanThunk:           lean_inc_ref(a); return a;
+        case LeanTask:            lean_inc_ref(a); return a;
+        case LeanRef:             lean_inc_ref(a); return a;
+        case LeanExternal:        lean_inc_ref(a); return a;
+        case LeanReserved:        lean_inc_ref(a); return a;
+        case LeanScalarArray:     return visit_terminal(a);
+        case LeanString:          return visit_terminal(a);
+        case LeanArray:           return visit_array(a);
+        default:                  return visit_ctor(a);
+        }
+    }
+};
+
+/* Split a DAG into subobjects that are maximally shared in parallel by `sharecommon_parallel_fn`. */
+class sharecommon_partition {
+    /* Number of subobjects of `o` that were not reachable from the objects visited before `o`.
+       The sum over all objects is the size of the DAG. */
+    std::unordered_map<lean_object *, size_t> m_size;
+    std::unordered_set<lean_object *>         m_visited;
+    std::vector<lean_object *>                m_roots;
+    size_t                                    m_grain = 0;
+
+    static bool has_subobjects(lean_object * a) {
+        return lean_is_ctor(a) || lean_is_array(a);
+    }
+
+    size_t visit_size(lean_object * a) {
+        if (lean_is_scalar(a) || m_size.find(a) != m_size.end())
+            return 0;
+        size_t r = 1;
+        if (lean_is_ctor(a)) {
+            unsigned num_objs = lean_ctor_num_objs(a);
+            for (unsigned i = 0; i < num_objs; i++)
+                r += visit_size(lean_ctor_get(a, i));
+        } else if (lean_is_array(a)) {
+            size_t sz = array_size(a);
+            for (size_t i = 0; i < sz; i++)
+                r += visit_size(lean_array_get_core(a, i));
+        }
+        m_size.insert(std::make_pair(a, r));
+        return r;
+    }
+
+    void collect_roots(lean_object * a) {
+        if (lean_is_scalar(a) || !has_subobjects(a) || !m_visited.insert(a).second)
+            return;
+        if (m_size[a] <= m_grain) {
+            m_roots.push_back(a);
+        } else if (lean_is_ctor(a)) {
+            unsigned num_objs = lean_ctor_num_objs(a);
+            for (unsigned i = 0; i < num_objs; i++)
+                collect_roots(lean_ctor_get(a, i));
+        } else {
+            size_t sz = array_size(a);
+            for (size_t i = 0; i < sz; i++)
+                collect_roots(lean_array_get_core(a, i));
+        }
+    }
+
+public:
+    /* Return the size of the DAG `a`. */
+    size_t compute_size(lean_object * a) {
+        return visit_size(a);
+    }
+
+    /* Split the DAG `a` into at most `num_workers` sets of disjoint subobjects of similar size. */
+    std::vector<std::vector<lean_object *>> split(lean_object * a, unsigned num_workers) {
+        m_grain = std::max(m_size[a] / (4 * num_workers), static_cast<size_t>(1));
+        collect_roots(a);
+        // Assign the largest roots first to the least loaded worker.
+        std::sort(m_roots.begin(), m_roots.end(), [&](lean_object * o1, lean_object * o2) {
+            return m_size[o1] > m_size[o2];
+        });
+        std::vector<std::vector<lean_object *>> r(num_workers);
+        std::vector<size_t> loads(num_workers, 0);
+        for (lean_object * o : m_roots) {
+            unsigned w = std::min_element(loads.begin(), loads.end()) - loads.begin();
+            r[w].push_back(o);
+            loads[w] += m_size[o];
+        }
+        return r;
+    }
+};
+
+lean_object * sharecommon_parallel_fn::operator()(lean_object * a) {
+    if (lean_is_scalar(a))
+        return a;
+    sharecommon_partition partition;
+    if (m_num_threads <= 1 || partition.compute_size(a) < m_min_size)
+        return sharecommon_quick_fn()(a);
+    // The input objects are read by the worker threads.
+    lean_mark_mt(a);
+    std::vector<std::vector<lean_object *>> roots = partition.split(a, m_num_threads);
+    std::vector<std::vector<lean_object *>> results(m_num_threads);
+    sharecommon_concurrent_set set;
+    auto run = [&](unsigned i) {
+        sharecommon_parallel_worker worker(set);
+        for (lean_object * o : roots[i])
+            results[i].push_back(worker.visit(o));
+    };
+    {
+        std::vector<std::unique_ptr<lthread>> threads;
+        for (unsigned i = 1; i < m_num_threads; i++)
+            threads.emplace_back(new lthread([&, i]() { run(i); }));
+        run(0);
+        for (auto & t : threads)
+            t->join();
+    }
+    // Process the upper part of the DAG.
+    sharecommon_parallel_worker worker(set);
+    for (unsigned i = 0; i < m_num_threads; i++) {
+        for (size_t j = 0; j < roots[i].size(); j++)
+            worker.set_result(roots[i][j], results[i][j]);
+    }
+    lean_object * r = worker.visit(a);
+    for (auto const & rs : results) {
+        for (lean_object * o : rs)
+            lean_dec_ref(o);
+    }
+    return r;
+}
+
+size_t sharecommon_global_prune() {
+    return g_sharecommon_global_table->prune();
+}
+
+size_t sharecommon_global_size() {
+    return g_sharecommon_global_table->size();
+}
+
+// def ShareCommon.shareCommonGlobal (a : @& α) : α := a
+extern "C" LEAN_EXPORT obj_res lean_sharecommon_global(b_obj_arg a) {
+    return sharecommon_global_fn()(a);
+}
+
+// def ShareCommon.shareCommonParallel (a : @& α) : α := a
+extern "C" LEAN_EXPORT obj_res lean_sharecommon_parallel(b_obj_arg a) {
+    return sharecommon_parallel_fn(hardware_concurrency())(a);
+}
+
+// def Lean.ShareCommon.pruneGlobal : BaseIO Nat
+extern "C" LEAN_EXPORT obj_res lean_sharecommon_global_prune(obj_arg /* w */) {
+    return io_result_mk_ok(lean_usize_to_nat(sharecommon_global_prune()));
+}
+
+// def Lean.ShareCommon.numGlobalObjs : BaseIO Nat
+extern "C" LEAN_EXPORT obj_res lean_sharecommon_global_size(obj_arg /* w */) {
+    return io_result_mk_ok(lean_usize_to_nat(sharecommon_global_size()));
+}
+
+void initialize_sharecommon() {
+    g_sharecommon_global_table = new sharecommon_global_table();
+}
+
+void finalize_sharecommon() {
+    delete g_sharecommon_global_table;
+}
 };
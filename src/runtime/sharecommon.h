@@ -68,4 +68,57 @@ public:
     lean_object * operator()(lean_object * e);
 };
 
+/*
+Similar to `sharecommon_quick_fn`, but uses a process-wide hash-consing table shared by all threads
+instead of a local one. Thus, structurally equal objects shared by different calls (e.g., in different
+elaboration tasks) become pointer equal. The objects in the table are marked as multi-threaded.
+
+The table is split into shards protected by their own mutex. It owns a reference to each of its
+objects, and objects only referenced by the table are periodically removed from it (see
+`sharecommon_global_prune`). That is, the table behaves as a weak hash set.
+*/
+class LEAN_EXPORT sharecommon_global_fn {
+    /*
+    We use `m_cache` to ensure we do **not** traverse a DAG as a tree.
+    The range of `m_cache` contains objects stored in the global table that are sub-objects of the
+    result, and thus remain alive while the result is being built.
+    */
+    std::unordered_map<lean_object *, lean_object *> m_cache;
+
+    lean_object * visit_array(lean_object * a);
+    lean_object * visit_ctor(lean_object * a);
+    lean_object * visit(lean_object * a);
+public:
+    lean_object * operator()(lean_object * a) {
+        return visit(a);
+    }
+};
+
+/*
+Parallel version of `sharecommon_quick_fn` for very large objects. It produces an object with the
+same sharing as `sharecommon_quick_fn`.
+
+We split the input DAG into subobjects of similar size, and maximally share them in worker threads
+using a concurrent hash-consing table. Then, the remaining upper part of the DAG is processed by
+the calling thread. The input and the result are marked as multi-threaded.
+
+Objects with less than `min_size` subobjects are processed sequentially.
+*/
+class LEAN_EXPORT sharecommon_parallel_fn {
+    unsigned m_num_threads;
+    size_t   m_min_size;
+public:
+    sharecommon_parallel_fn(unsigned num_threads, size_t min_size = 1 << 16):
+        m_num_threads(num_threads), m_min_size(min_size) {}
+    lean_object * operator()(lean_object * a);
+};
+
+/* Remove from the global hash-consing table the objects that are only referenced by it.
+   Return the number of objects removed. */
+LEAN_EXPORT size_t sharecommon_global_prune();
+/* Return the number of objects in the global hash-consing table. */
+LEAN_EXPORT size_t sharecommon_global_size();
+
+void initialize_sharecommon();
+void finalize_sharecommon();
 };
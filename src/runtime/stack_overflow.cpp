@@ -20,6 +20,7 @@ Port of the corresponding Rust code (see links below).
 #include <lean/lean.h>
 #include <initializer_list>
 #include "runtime/stack_overflow.h"
+#include "runtime/stackinfo.h"
 
 namespace lean {
 // stack guard of the main thread
@@ -69,7 +70,7 @@ bool is_within_stack_guard(void * addr) {
 }
 
 extern "C" LEAN_EXPORT void segv_handler(int signum, siginfo_t * info, void *) {
-    if (is_within_stack_guard(info->si_addr)) {
+    if (is_within_stack_guard(info->si_addr) || is_within_stack_segment_guard(info->si_addr)) {
         char const msg[] = "\nStack overflow detected. Aborting.\n";
         write(STDERR_FILENO, msg, sizeof(msg) - 1);
         abort();
@@ -4,8 +4,13 @@ Released under Apache 2.0 license as described in the file LICENSE.
 
 Author: Leonardo de Moura
 */
+#if defined(__APPLE__)
+// the `ucontext` API used for stack segments is deprecated but functional on macOS
+#define _XOPEN_SOURCE 600
+#endif
 #include <memory.h>
 #include <iostream>
+#include <exception>
 #include "runtime/thread.h"
 #include "runtime/exception.h"
 #include "runtime/stackinfo.h"
@@ -19,6 +24,12 @@ Author: Leonardo de Moura
     #include <sys/time.h> // NOLINT
     #include <sys/resource.h> // NOLINT
 #endif
+#if !defined(LEAN_WINDOWS) && !defined(LEAN_EMSCRIPTEN)
+    #define LEAN_STACK_SEGMENTS
+    #include <ucontext.h> // NOLINT
+    #include <sys/mman.h> // NOLINT
+    #include <unistd.h> // NOLINT
+#endif
 
 #if defined(LEAN_EMSCRIPTEN)
 #include <emscripten/stack.h>
@@ -77,18 +88,28 @@ LEAN_THREAD_VALUE(bool, g_stack_info_init, false);
 LEAN_THREAD_VALUE(size_t, g_stack_size, 0);
 LEAN_THREAD_VALUE(size_t, g_stack_base, 0);
 LEAN_THREAD_VALUE(size_t, g_stack_threshold, 0);
+/* stack address below which Lean code continues on a new stack segment, see `lean_stack_is_low` */
+LEAN_THREAD_VALUE(size_t, g_segment_threshold, 0);
+LEAN_THREAD_VALUE(unsigned, g_num_segments, 0);
+
+static size_t get_stack_threshold(size_t buffer_space) {
+    size_t threshold = g_stack_base + buffer_space - g_stack_size;
+    // negative overflow
+    return threshold > g_stack_base + buffer_space ? 0 : threshold;
+}
+
+static void set_stack_limits(size_t base, size_t size) {
+    g_stack_base = base;
+    g_stack_size = size;
+    /* g_stack_threshold is a redundant value used to optimize check_stack */
+    g_stack_threshold = get_stack_threshold(LEAN_STACK_BUFFER_SPACE);
+    g_segment_threshold = g_num_segments < LEAN_MAX_STACK_SEGMENTS ? get_stack_threshold(LEAN_STACK_SEGMENT_MARGIN) : 0;
+}
 
 void save_stack_info(bool main) {
     g_stack_info_init = true;
-    g_stack_size = get_stack_size(main);
     char x;
-    g_stack_base = reinterpret_cast<size_t>(&x);
-    /* g_stack_threshold is a redundant value used to optimize check_stack */
-    g_stack_threshold = g_stack_base + LEAN_STACK_BUFFER_SPACE - g_stack_size;
-    if (g_stack_threshold > g_stack_base + LEAN_STACK_BUFFER_SPACE) {
-        // negative overflow
-        g_stack_threshold = 0;
-    }
+    set_stack_limits(reinterpret_cast<size_t>(&x), get_stack_size(main));
 }
 
 size_t get_used_stack_size() {
@@ -119,4 +140,128 @@ void check_stack(char const * component_name) {
         throw_stack_space_exception(component_name);
 }
 }
+
+extern "C" LEAN_EXPORT bool lean_stack_is_low() {
+    using namespace lean; // NOLINT
+    if (!g_stack_info_init)
+        save_stack_info(false);
+    char y;
+    return reinterpret_cast<size_t>(&y) < g_segment_threshold;
+}
+
+#if defined(LEAN_STACK_SEGMENTS)
+namespace lean {
+struct stack_segment_call {
+    void (*m_fn)(void *);
+    void *             m_arg;
+    std::exception_ptr m_ex;
+};
+
+LEAN_THREAD_PTR(stack_segment_call, g_segment_call);
+/* unused segment kept for the next call, so that recursion around the segment boundary does not map and unmap
+   a segment on every call */
+LEAN_THREAD_VALUE(char *, g_spare_segment, nullptr);
+LEAN_THREAD_VALUE(bool, g_spare_finalizer_registered, false);
+/* guard page of the innermost segment, see `is_within_stack_segment_guard` */
+LEAN_THREAD_VALUE(char *, g_segment_guard, nullptr);
+
+static size_t get_page_size() {
+    return static_cast<size_t>(sysconf(_SC_PAGESIZE));
+}
+
+static void free_spare_segment(void *) {
+    if (g_spare_segment) {
+        munmap(g_spare_segment, LEAN_STACK_SEGMENT_SIZE);
+        g_spare_segment = nullptr;
+    }
+}
+
+static char * alloc_segment() {
+    if (char * mem = g_spare_segment) {
+        g_spare_segment = nullptr;
+        return mem;
+    }
+    void * mem = mmap(nullptr, LEAN_STACK_SEGMENT_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED)
+        return nullptr;
+    // guard page at the bottom, so that overflowing the segment faults instead of corrupting memory
+    mprotect(mem, get_page_size(), PROT_NONE);
+    return static_cast<char *>(mem);
+}
+
+static void release_segment(char * mem) {
+    if (g_spare_segment) {
+        munmap(mem, LEAN_STACK_SEGMENT_SIZE);
+    } else {
+        if (!g_spare_finalizer_registered) {
+            register_thread_finalizer(free_spare_segment, nullptr);
+            g_spare_finalizer_registered = true;
+        }
+        g_spare_segment = mem;
+    }
+}
+
+static void run_stack_segment_call() {
+    stack_segment_call * c = g_segment_call;
+    try {
+        c->m_fn(c->m_arg);
+    } catch (...) {
+        // exceptions cannot unwind across the segment boundary, so they are rethrown on the caller's stack
+        c->m_ex = std::current_exception();
+    }
+    // returning resumes `uc_link`, i.e. the caller
+}
+
+bool is_within_stack_segment_guard(void * addr) {
+    char * guard = g_segment_guard;
+    return guard && guard <= addr && addr < guard + get_page_size();
+}
+}
+
+extern "C" LEAN_EXPORT void lean_run_on_stack_segment(void (*fn)(void *), void * arg) {
+    using namespace lean; // NOLINT
+    char * mem = alloc_segment();
+    if (!mem) {
+        fn(arg);
+        return;
+    }
+    stack_segment_call c{fn, arg, nullptr};
+    ucontext_t caller, callee;
+    getcontext(&callee);
+    callee.uc_stack.ss_sp   = mem;
+    callee.uc_stack.ss_size = LEAN_STACK_SEGMENT_SIZE;
+    callee.uc_link          = &caller;
+    makecontext(&callee, run_stack_segment_call, 0);
+    size_t stack_base = g_stack_base, stack_size = g_stack_size;
+    char * guard = g_segment_guard;
+    g_num_segments++;
+    set_stack_limits(reinterpret_cast<size_t>(mem + LEAN_STACK_SEGMENT_SIZE), LEAN_STACK_SEGMENT_SIZE - get_page_size());
+    g_segment_guard = mem;
+    g_segment_call  = &c;
+    swapcontext(&caller, &callee);
+    g_num_segments--;
+    set_stack_limits(stack_base, stack_size);
+    g_segment_guard = guard;
+    release_segment(mem);
+    if (c.m_ex)
+        std::rethrow_exception(c.m_ex);
+}
+#else
+namespace lean {
+bool is_within_stack_segment_guard(void *) { return false; }
+}
+
+extern "C" LEAN_EXPORT void lean_run_on_stack_segment(void (*fn)(void *), void * arg) {
+    // not supported on this platform, continue on the current stack
+    fn(arg);
+}
+#endif
+#else
+namespace lean {
+bool is_within_stack_segment_guard(void *) { return false; }
+}
+
+// split stacks grow on their own
+extern "C" LEAN_EXPORT bool lean_stack_is_low() { return false; }
+extern "C" LEAN_EXPORT void lean_run_on_stack_segment(void (*fn)(void *), void * arg) { fn(arg); }
 #endif
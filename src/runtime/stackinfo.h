@@ -29,5 +29,7 @@ LEAN_EXPORT size_t get_available_stack_size();
 */
 LEAN_EXPORT void check_stack(char const * component_name);
 #endif
+/** \brief Return true if \c addr is within the guard page of the current stack segment, see `lean_run_on_stack_segment`. */
+LEAN_EXPORT bool is_within_stack_segment_guard(void * addr);
 
 }
@@ -14,6 +14,21 @@ Author: Leonardo de Moura
 #define LEAN_STACK_BUFFER_SPACE 128*1024  // 128 Kb
 #endif
 
+// Lean code switches to a new stack segment (see `lean_run_on_stack_segment`) when less than this space is left,
+// which must be larger than `LEAN_STACK_BUFFER_SPACE` so that C++ code does not run out of stack first
+#ifndef LEAN_STACK_SEGMENT_MARGIN
+#define LEAN_STACK_SEGMENT_MARGIN 256*1024  // 256 Kb
+#endif
+
+#ifndef LEAN_STACK_SEGMENT_SIZE
+#define LEAN_STACK_SEGMENT_SIZE 8*1024*1024  // 8 Mb
+#endif
+
+// maximum number of nested stack segments per thread, after which deep recursion overflows the stack as usual
+#ifndef LEAN_MAX_STACK_SEGMENTS
+#define LEAN_MAX_STACK_SEGMENTS 32
+#endif
+
 namespace lean {
 namespace chrono = std::chrono;
 };
@@ -112,6 +127,14 @@ public:
             return false;
         }
     }
+    /* Variants taking (ignored) memory orders, for code shared with the multi-threaded build. */
+    void store(T const & v, int) { m_value = v; }
+    T load(int) const { return m_value; }
+    T exchange(T desired, int) { return exchange(desired); }
+    bool compare_exchange_strong(T & expected, T desired, int, int) { return compare_exchange_strong(expected, desired); }
+    bool compare_exchange_weak(T & expected, T desired, int, int) { return compare_exchange_strong(expected, desired); }
+    T fetch_add(T const & v, int = 0) { T r(m_value); m_value += v; return r; }
+    T fetch_sub(T const & v, int = 0) { T r(m_value); m_value -= v; return r; }
 };
 typedef atomic<unsigned short> atomic_ushort;
 typedef atomic<unsigned char>  atomic_uchar;
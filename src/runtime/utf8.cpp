@@ -5,7 +5,13 @@ Released under Apache 2.0 license as described in the file LICENSE.
 Author: Leonardo de Moura
 */
 #include <cstdlib>
+#include <cstring>
 #include <string>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 #include "runtime/debug.h"
 #include "runtime/optional.h"
 #include "runtime/utf8.h"
@@ -32,14 +38,102 @@ unsigned get_utf8_size(unsigned char c) {
         return 1; /* invalid */
 }
 
-extern "C" LEAN_EXPORT size_t lean_utf8_strlen(char const * str) {
-    size_t r = 0;
-    while (*str != 0) {
-        unsigned sz = get_utf8_size(*str);
-        r++;
-        str += sz;
+/* The loops below process strings in blocks of `UTF8_BLOCK_SIZE` bytes using SSE2 on x86-64 and NEON on AArch64,
+   which are part of the baseline instruction set there, and 64-bit words elsewhere. */
+#define UTF8_BLOCK_SIZE 16
+
+/* Return true if the block at `s` contains only ASCII characters. */
+static inline bool utf8_block_is_ascii(uint8_t const * s) {
+#if defined(__SSE2__)
+    return _mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<__m128i const *>(s))) == 0;
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+    return vmaxvq_u8(vld1q_u8(s)) < 0x80;
+#else
+    uint64_t w[2];
+    memcpy(w, s, sizeof(w));
+    return ((w[0] | w[1]) & 0x8080808080808080ull) == 0;
+#endif
+}
+
+/* Return the number of bytes in the block at `s` that are not continuation bytes (`10xxxxxx`),
+   i.e., the number of unicode scalar values starting in the block if the string is valid UTF-8. */
+static inline unsigned utf8_block_count(uint8_t const * s) {
+#if defined(__SSE2__)
+    __m128i v = _mm_loadu_si128(reinterpret_cast<__m128i const *>(s));
+    /* continuation bytes are exactly the bytes in [-128, -65] when interpreted as signed */
+    __m128i first = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8(-65)), _mm_set1_epi8(1));
+    __m128i sums  = _mm_sad_epu8(first, _mm_setzero_si128());
+    return _mm_cvtsi128_si32(sums) + _mm_extract_epi16(sums, 4);
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+    uint8x16_t first = vcgtq_s8(vreinterpretq_s8_u8(vld1q_u8(s)), vdupq_n_s8(-65));
+    return vaddvq_u8(vshrq_n_u8(first, 7));
+#else
+    uint64_t w[2];
+    memcpy(w, s, sizeof(w));
+    unsigned r = 0;
+    for (uint64_t x : w) {
+        /* lowest bit of each byte is `!b7 || b6` */
+        uint64_t t = ((~x >> 7) | (x >> 6)) & 0x0101010101010101ull;
+        r += (t * 0x0101010101010101ull) >> 56;
     }
     return r;
+#endif
+}
+
+size_t utf8_ascii_prefix_length(char const * str, size_t sz) {
+    uint8_t const * s = reinterpret_cast<uint8_t const *>(str);
+    size_t i = 0;
+    while (i + UTF8_BLOCK_SIZE <= sz && utf8_block_is_ascii(s + i))
+        i += UTF8_BLOCK_SIZE;
+    while (i < sz && s[i] < 0x80)
+        i++;
+    return i;
+}
+
+static inline bool json_is_special(uint8_t c) { return c == '"' || c == '\\' || c < 0x20; }
+
+/* Return true if the block at `s` contains a `"`, `\` or control character. */
+static inline bool json_block_has_special(uint8_t const * s) {
+#if defined(__SSE2__)
+    __m128i v = _mm_loadu_si128(reinterpret_cast<__m128i const *>(s));
+    __m128i quote = _mm_cmpeq_epi8(v, _mm_set1_epi8('"'));
+    __m128i bslash = _mm_cmpeq_epi8(v, _mm_set1_epi8('\\'));
+    /* unsigned `v <= 0x1f` */
+    __m128i ctrl = _mm_cmpeq_epi8(_mm_min_epu8(v, _mm_set1_epi8(0x1f)), v);
+    return _mm_movemask_epi8(_mm_or_si128(_mm_or_si128(quote, bslash), ctrl)) != 0;
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+    uint8x16_t v = vld1q_u8(s);
+    uint8x16_t m = vorrq_u8(vorrq_u8(vceqq_u8(v, vdupq_n_u8('"')), vceqq_u8(v, vdupq_n_u8('\\'))),
+                            vcltq_u8(v, vdupq_n_u8(0x20)));
+    return vmaxvq_u8(m) != 0;
+#else
+    uint64_t w[2];
+    memcpy(w, s, sizeof(w));
+    for (uint64_t x : w) {
+        /* a byte of `q` (`b`) is zero iff the corresponding byte of `x` is `"` (`\`) */
+        uint64_t q = x ^ 0x2222222222222222ull;
+        uint64_t b = x ^ 0x5c5c5c5c5c5c5c5cull;
+        uint64_t zero = ((q - 0x0101010101010101ull) & ~q) | ((b - 0x0101010101010101ull) & ~b);
+        uint64_t ctrl = (x - 0x2020202020202020ull) & ~x;
+        if ((zero | ctrl) & 0x8080808080808080ull)
+            return true;
+    }
+    return false;
+#endif
+}
+
+size_t json_plain_prefix_length(char const * str, size_t sz) {
+    uint8_t const * s = reinterpret_cast<uint8_t const *>(str);
+    size_t i = 0;
+    while (i + UTF8_BLOCK_SIZE <= sz && !json_block_has_special(s + i))
+        i += UTF8_BLOCK_SIZE;
+    while (i < sz && !json_is_special(s[i]))
+        i++;
+    return i;
+}
+
+extern "C" LEAN_EXPORT size_t lean_utf8_strlen(char const * str) {
+    return lean_utf8_n_strlen(str, strlen(str));
 }
 
 size_t utf8_strlen(char const * str) {
@@ -47,13 +141,13 @@ size_t utf8_strlen(char const * str) {
 }
 
 extern "C" LEAN_EXPORT size_t lean_utf8_n_strlen(char const * str, size_t sz) {
+    uint8_t const * s = reinterpret_cast<uint8_t const *>(str);
     size_t r = 0;
     size_t i = 0;
-    while (i < sz) {
-        unsigned d = get_utf8_size(str[i]);
-        r++;
-        i += d;
-    }
+    for (; i + UTF8_BLOCK_SIZE <= sz; i += UTF8_BLOCK_SIZE)
+        r += utf8_block_count(s + i);
+    for (; i < sz; i++)
+        r += !is_utf8_next(s[i]);
     return r;
 }
 
@@ -65,19 +159,31 @@ size_t utf8_strlen(std::string const & str) {
     return utf8_strlen(str.data(), str.size());
 }
 
-optional<size_t> utf8_char_pos(char const * str, size_t char_idx) {
+optional<size_t> utf8_char_pos(char const * str, size_t sz, size_t char_idx) {
+    uint8_t const * s = reinterpret_cast<uint8_t const *>(str);
     size_t r = 0;
-    while (*str != 0) {
+    /* skip whole blocks as long as the character does not start in them */
+    while (r + UTF8_BLOCK_SIZE <= sz) {
+        unsigned n = utf8_block_count(s + r);
+        if (n > char_idx)
+            break;
+        char_idx -= n;
+        r += UTF8_BLOCK_SIZE;
+    }
+    for (; r < sz; r++) {
+        if (is_utf8_next(s[r]))
+            continue;
         if (char_idx == 0)
             return some<size_t>(r);
         char_idx--;
-        unsigned sz = get_utf8_size(*str);
-        r += sz;
-        str += sz;
     }
     return optional<size_t>();
 }
 
+optional<size_t> utf8_char_pos(char const * str, size_t char_idx) {
+    return utf8_char_pos(str, strlen(str), char_idx);
+}
+
 char const * get_utf8_last_char(char const * str) {
     char const * r;
     lean_assert(*str != 0);
@@ -269,8 +375,18 @@ bool validate_utf8_one(uint8_t const * str, size_t size, size_t & pos) {
 
 bool validate_utf8(uint8_t const * str, size_t size, size_t & pos, size_t & i) {
     while (pos < size) {
-        if (!validate_utf8_one(str, size, pos)) return false;
-        i++;
+        if (size - pos >= UTF8_BLOCK_SIZE && utf8_block_is_ascii(str + pos)) {
+            pos += UTF8_BLOCK_SIZE;
+            i   += UTF8_BLOCK_SIZE;
+            continue;
+        }
+        /* validate the characters starting in the current block one by one; the end of the block is
+           also a good place to check for ASCII again on mostly non-ASCII input */
+        size_t end = pos + UTF8_BLOCK_SIZE;
+        while (pos < size && pos < end) {
+            if (!validate_utf8_one(str, size, pos)) return false;
+            i++;
+        }
     }
     return true;
 }
@@ -15,7 +15,8 @@ using uchar = unsigned char;
 
 LEAN_EXPORT bool is_utf8_next(unsigned char c);
 LEAN_EXPORT unsigned get_utf8_size(unsigned char c);
-/* Return the length of the null terminated string encoded using UTF8 */
+/* Return the length of the null terminated string encoded using UTF8.
+   The string must be valid UTF8, the result is the number of non-continuation bytes otherwise. */
 LEAN_EXPORT size_t utf8_strlen(char const * str);
 /* Return the length of the string `str` encoded using UTF8.
    `str` may contain null characters. */
@@ -23,7 +24,14 @@ LEAN_EXPORT size_t utf8_strlen(std::string const & str);
 /* Return the length of the string `str` encoded using UTF8.
    `str` may contain null characters. */
 LEAN_EXPORT size_t utf8_strlen(char const * str, size_t sz);
+/* Return the number of ASCII characters at the beginning of `str`, which has size `sz`. */
+LEAN_EXPORT size_t utf8_ascii_prefix_length(char const * str, size_t sz);
+/* Return the number of bytes at the beginning of `str`, which has size `sz`, that are neither `"`, `\` nor
+   control characters, i.e., that can be copied verbatim from a JSON string literal. */
+LEAN_EXPORT size_t json_plain_prefix_length(char const * str, size_t sz);
+/* Return the byte offset of the unicode scalar value with index `char_idx` in `str`, if any. */
 LEAN_EXPORT optional<size_t> utf8_char_pos(char const * str, size_t char_idx);
+LEAN_EXPORT optional<size_t> utf8_char_pos(char const * str, size_t sz, size_t char_idx);
 LEAN_EXPORT char const * get_utf8_last_char(char const * str);
 LEAN_EXPORT std::string utf8_trim(std::string const & s);
 LEAN_EXPORT unsigned utf8_to_unicode(uchar const * begin, uchar const * end);
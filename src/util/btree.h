@@ -0,0 +1,658 @@
+/*
+Copyright (c) 2024 Lean FRO, LLC. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+*/
+#pragma once
+#include <utility>
+#include <algorithm>
+#include <new>
+#include "runtime/optional.h"
+#include "runtime/debug.h"
+#include "runtime/buffer.h"
+#include "util/rc.h"
+
+namespace lean {
+/**
+   \brief Persistent B-trees
+
+   Drop-in replacement for `rb_tree` with the same interface. Each node stores up to
+   `2*min_degree - 1` values in a contiguous array, so that searches touch fewer cache lines
+   than in a binary tree. As in `rb_tree`, copying is O(1), different trees can share nodes,
+   and the sharing is thread-safe. Nodes are copied on write when they are shared.
+
+   \c CMP is a functional object for comparing values of type T (see `rb_tree`).
+*/
+template<typename T, typename CMP>
+class btree : private CMP {
+    static constexpr unsigned min_degree = 8;
+    static constexpr unsigned max_values = 2 * min_degree - 1;
+
+    struct node_cell;
+    struct node {
+        node_cell * m_ptr;
+        node():m_ptr(nullptr) {}
+        node(node_cell * ptr):m_ptr(ptr) { if (m_ptr) ptr->inc_ref(); }
+        node(node const & s):m_ptr(s.m_ptr) { if (m_ptr) m_ptr->inc_ref(); }
+        node(node && s):m_ptr(s.m_ptr) { s.m_ptr = nullptr; }
+        ~node() { if (m_ptr) m_ptr->dec_ref(); }
+        node & operator=(node const & n) { LEAN_COPY_REF(n); }
+        node & operator=(node&& n) { LEAN_MOVE_REF(n); }
+        operator bool() const { return m_ptr != nullptr; }
+        bool is_shared() const { return m_ptr && m_ptr->get_rc() > 1; }
+        node_cell * operator->() const { lean_assert(m_ptr); return m_ptr; }
+        friend bool is_eqp(node const & n1, node const & n2) { return n1.m_ptr == n2.m_ptr; }
+        friend void swap(node & n1, node & n2) { std::swap(n1.m_ptr, n2.m_ptr); }
+        node steal() { node r; swap(r, *this); return r; }
+    };
+
+    /* A node with `m_size` values. Internal nodes have `m_size + 1` children, and leaves have none
+       (`m_children == nullptr`). */
+    struct node_cell {
+        unsigned m_size;
+        alignas(T) unsigned char m_values[max_values * sizeof(T)];
+        node *   m_children;
+        MK_LEAN_RC();
+        void dealloc() { delete this; }
+        explicit node_cell(bool leaf):m_size(0), m_children(leaf ? nullptr : new node[max_values + 1]), m_rc(0) {}
+        node_cell(node_cell const & s):m_size(s.m_size), m_children(s.m_children ? new node[max_values + 1] : nullptr), m_rc(0) {
+            for (unsigned i = 0; i < m_size; i++)
+                new (&value(i)) T(s.value(i));
+            if (m_children) {
+                for (unsigned i = 0; i <= m_size; i++)
+                    m_children[i] = s.m_children[i];
+            }
+        }
+        ~node_cell() {
+            for (unsigned i = 0; i < m_size; i++)
+                value(i).~T();
+            delete[] m_children;
+        }
+        bool is_leaf() const { return m_children == nullptr; }
+        T & value(unsigned i) { return reinterpret_cast<T *>(m_values)[i]; }
+        T const & value(unsigned i) const { return reinterpret_cast<T const *>(m_values)[i]; }
+        node & child(unsigned i) { lean_assert(!is_leaf()); return m_children[i]; }
+        node_cell const * child_ptr(unsigned i) const { lean_assert(!is_leaf()); return m_children[i].m_ptr; }
+        /* Insert `v` (and the child `c` at its right) at position `i`. */
+        void insert_at(unsigned i, T const & v, node && c = node()) {
+            lean_assert(m_size < max_values);
+            if (i < m_size) {
+                new (&value(m_size)) T(std::move(value(m_size - 1)));
+                for (unsigned j = m_size - 1; j > i; j--)
+                    value(j) = std::move(value(j - 1));
+                value(i) = v;
+            } else {
+                new (&value(i)) T(v);
+            }
+            if (m_children) {
+                for (unsigned j = m_size + 1; j > i + 1; j--)
+                    m_children[j] = m_children[j - 1].steal();
+                m_children[i + 1] = std::move(c);
+            }
+            m_size++;
+        }
+        /* Remove the value at position `i`, and the child at its right. */
+        void erase_at(unsigned i) {
+            lean_assert(i < m_size);
+            for (unsigned j = i; j + 1 < m_size; j++)
+                value(j) = std::move(value(j + 1));
+            value(m_size - 1).~T();
+            if (m_children) {
+                for (unsigned j = i + 1; j < m_size; j++)
+                    m_children[j] = m_children[j + 1].steal();
+                m_children[m_size] = node();
+            }
+            m_size--;
+        }
+    };
+
+    int cmp(T const & v1, T const & v2) const {
+        return CMP::operator()(v1, v2);
+    }
+
+    /* Return the position of the first value in `n` that is not smaller than `v`, and set `found`
+       to true if this value is equal to `v`. */
+    unsigned lower_bound(node_cell const * n, T const & v, bool & found) const {
+        unsigned lo = 0, hi = n->m_size;
+        while (lo < hi) {
+            unsigned mid = (lo + hi) / 2;
+            int c = cmp(v, n->value(mid));
+            if (c == 0) {
+                found = true;
+                return mid;
+            } else if (c < 0) {
+                hi = mid;
+            } else {
+                lo = mid + 1;
+            }
+        }
+        found = false;
+        return lo;
+    }
+
+    static node ensure_unshared(node && n) {
+        if (n.is_shared()) {
+            return node(new node_cell(*n.m_ptr));
+        } else {
+            return n;
+        }
+    }
+
+    static node_cell * unshared_child(node_cell * n, unsigned i) {
+        n->child(i) = ensure_unshared(n->child(i).steal());
+        return n->child(i).m_ptr;
+    }
+
+    /* Split the full child `i` of `x`. `x` must not be full. */
+    static void split_child(node_cell * x, unsigned i) {
+        node_cell * y = unshared_child(x, i);
+        lean_assert(y->m_size == max_values);
+        node z(new node_cell(y->is_leaf()));
+        for (unsigned j = 0; j < min_degree - 1; j++)
+            new (&z->value(j)) T(std::move(y->value(min_degree + j)));
+        if (!y->is_leaf()) {
+            for (unsigned j = 0; j < min_degree; j++)
+                z->m_children[j] = y->m_children[min_degree + j].steal();
+        }
+        z->m_size = min_degree - 1;
+        T median(std::move(y->value(min_degree - 1)));
+        for (unsigned j = min_degree - 1; j < max_values; j++)
+            y->value(j).~T();
+        y->m_size = min_degree - 1;
+        x->insert_at(i, median, std::move(z));
+    }
+
+    void insert_non_full(node_cell * x, T const & v) {
+        while (true) {
+            bool found;
+            unsigned i = lower_bound(x, v, found);
+            if (found) {
+                x->value(i) = v;
+                return;
+            }
+            if (x->is_leaf()) {
+                x->insert_at(i, v);
+                return;
+            }
+            if (x->child_ptr(i)->m_size == max_values) {
+                split_child(x, i);
+                int c = cmp(v, x->value(i));
+                if (c == 0) {
+                    x->value(i) = v;
+                    return;
+                } else if (c > 0) {
+                    i++;
+                }
+            }
+            x = unshared_child(x, i);
+        }
+    }
+
+    /* Merge the child `i + 1` of `x` and the value `i` into the child `i`. */
+    static void merge_children(node_cell * x, unsigned i) {
+        node_cell * y = unshared_child(x, i);
+        node_cell const * z = x->child_ptr(i + 1);
+        lean_assert(y->m_size == min_degree - 1 && z->m_size == min_degree - 1);
+        new (&y->value(y->m_size)) T(x->value(i));
+        for (unsigned j = 0; j < z->m_size; j++)
+            new (&y->value(y->m_size + 1 + j)) T(z->value(j));
+        if (!y->is_leaf()) {
+            for (unsigned j = 0; j <= z->m_size; j++)
+                y->m_children[y->m_size + 1 + j] = z->m_children[j];
+        }
+        y->m_size += 1 + z->m_size;
+        x->erase_at(i);
+    }
+
+    /* Make sure the child `i` of `x` has at least `min_degree` values, and return its position
+       (which changes if it is merged with its left sibling). */
+    static unsigned fill_child(node_cell * x, unsigned i) {
+        if (x->child_ptr(i)->m_size >= min_degree)
+            return i;
+        if (i > 0 && x->child_ptr(i - 1)->m_size >= min_degree) {
+            // borrow from the left sibling
+            node_cell * c = unshared_child(x, i);
+            node_cell * l = unshared_child(x, i - 1);
+            node lc = l->is_leaf() ? node() : l->m_children[l->m_size].steal();
+            c->insert_at(0, x->value(i - 1));
+            if (!c->is_leaf()) {
+                // `insert_at` placed the empty child at position 1
+                c->m_children[1] = c->m_children[0].steal();
+                c->m_children[0] = std::move(lc);
+            }
+            x->value(i - 1) = l->value(l->m_size - 1);
+            l->value(l->m_size - 1).~T();
+            l->m_size--;
+            return i;
+        } else if (i < x->m_size && x->child_ptr(i + 1)->m_size >= min_degree) {
+            // borrow from the right sibling
+            node_cell * c = unshared_child(x, i);
+            node_cell * r = unshared_child(x, i + 1);
+            node rc = r->is_leaf() ? node() : r->m_children[0].steal();
+            c->insert_at(c->m_size, x->value(i), std::move(rc));
+            x->value(i) = r->value(0);
+            if (!r->is_leaf())
+                r->m_children[0] = r->m_children[1].steal();
+            r->erase_at(0);
+            return i;
+        } else if (i < x->m_size) {
+            merge_children(x, i);
+            return i;
+        } else {
+            merge_children(x, i - 1);
+            return i - 1;
+        }
+    }
+
+    /* Remove `v` from the subtree `x`. `x` must be the root or have at least `min_degree` values. */
+    void erase_core(node_cell * x, T const & v) {
+        while (true) {
+            bool found;
+            unsigned i = lower_bound(x, v, found);
+            if (x->is_leaf()) {
+                if (found)
+                    x->erase_at(i);
+                return;
+            }
+            if (found) {
+                if (x->child_ptr(i)->m_size >= min_degree) {
+                    T pred = *max(x->child_ptr(i));
+                    x->value(i) = pred;
+                    x = unshared_child(x, i);
+                    erase_core(x, pred);
+                    return;
+                } else if (x->child_ptr(i + 1)->m_size >= min_degree) {
+                    T succ = *min(x->child_ptr(i + 1));
+                    x->value(i) = succ;
+                    x = unshared_child(x, i + 1);
+                    erase_core(x, succ);
+                    return;
+                } else {
+                    merge_children(x, i);
+                    x = unshared_child(x, i);
+                }
+            } else {
+                i = fill_child(x, i);
+                x = unshared_child(x, i);
+            }
+        }
+    }
+
+    static T const * min(node_cell const * n) {
+        if (!n)
+            return nullptr;
+        while (!n->is_leaf())
+            n = n->child_ptr(0);
+        return &n->value(0);
+    }
+
+    static T const * max(node_cell const * n) {
+        if (!n)
+            return nullptr;
+        while (!n->is_leaf())
+            n = n->child_ptr(n->m_size);
+        return &n->value(n->m_size - 1);
+    }
+
+    template<typename F>
+    static void for_each(F && f, node_cell const * n) {
+        if (n) {
+            for (unsigned i = 0; i < n->m_size; i++) {
+                if (!n->is_leaf())
+                    for_each(f, n->child_ptr(i));
+                f(n->value(i));
+            }
+            if (!n->is_leaf())
+                for_each(f, n->child_ptr(n->m_size));
+        }
+    }
+
+    template<typename F>
+    static optional<T> find_if(F && f, node_cell const * n) {
+        if (n) {
+            for (unsigned i = 0; i < n->m_size; i++) {
+                if (!n->is_leaf()) {
+                    if (auto r = find_if(f, n->child_ptr(i)))
+                        return r;
+                }
+                if (f(n->value(i)))
+                    return optional<T>(n->value(i));
+            }
+            if (!n->is_leaf())
+                return find_if(f, n->child_ptr(n->m_size));
+        }
+        return optional<T>();
+    }
+
+    template<typename F>
+    static optional<T> back_find_if(F && f, node_cell const * n) {
+        if (n) {
+            unsigned i = n->m_size;
+            if (!n->is_leaf()) {
+                if (auto r = back_find_if(f, n->child_ptr(i)))
+                    return r;
+            }
+            while (i > 0) {
+                --i;
+                if (f(n->value(i)))
+                    return optional<T>(n->value(i));
+                if (!n->is_leaf()) {
+                    if (auto r = back_find_if(f, n->child_ptr(i)))
+                        return r;
+                }
+            }
+        }
+        return optional<T>();
+    }
+
+    template<typename F>
+    void for_each_greater(T const & v, F && f, node_cell const * n) const {
+        if (n) {
+            bool found;
+            unsigned i = lower_bound(n, v, found);
+            if (!n->is_leaf()) {
+                if (found)
+                    for_each(f, n->child_ptr(i + 1));
+                else
+                    for_each_greater(v, f, n->child_ptr(i));
+            }
+            for (unsigned j = found ? i + 1 : i; j < n->m_size; j++) {
+                f(n->value(j));
+                if (!n->is_leaf())
+                    for_each(f, n->child_ptr(j + 1));
+            }
+        }
+    }
+
+    T const * find_next_greater_or_equal(T const & v, node_cell const * n) const {
+        T const * r = nullptr;
+        while (n) {
+            bool found;
+            unsigned i = lower_bound(n, v, found);
+            if (found)
+                return &n->value(i);
+            if (i < n->m_size)
+                r = &n->value(i);
+            n = n->is_leaf() ? nullptr : n->child_ptr(i);
+        }
+        return r;
+    }
+
+    static void display(std::ostream & out, node_cell const * n) {
+        if (n) {
+            out << "(";
+            for (unsigned i = 0; i < n->m_size; i++) {
+                if (!n->is_leaf()) {
+                    display(out, n->child_ptr(i));
+                    out << " ";
+                }
+                out << n->value(i) << " ";
+            }
+            if (!n->is_leaf())
+                display(out, n->child_ptr(n->m_size));
+            out << ")";
+        } else {
+            out << "nil";
+        }
+    }
+
+    static unsigned get_depth(node_cell const * n) {
+        unsigned r = 0;
+        for (; n; n = n->is_leaf() ? nullptr : n->child_ptr(0))
+            r++;
+        return r;
+    }
+
+    static void to_buffer(node_cell const * n, buffer<T> & r) {
+        for_each([&](T const & v) { r.push_back(v); }, n);
+    }
+
+    bool check_invariant(node_cell const * n, bool is_root, unsigned depth, optional<unsigned> & leaf_depth) const {
+        // We check:
+        //  1) the values are ordered
+        //  2) all nodes but the root have at least `min_degree - 1` values
+        //  3) all leaves have the same depth
+        lean_assert(is_root || n->m_size >= min_degree - 1);
+        lean_assert(n->m_size <= max_values);
+        for (unsigned i = 0; i + 1 < n->m_size; i++)
+            lean_assert(cmp(n->value(i), n->value(i + 1)) < 0);
+        if (n->is_leaf()) {
+            if (leaf_depth) {
+                lean_assert(*leaf_depth == depth);
+            } else {
+                leaf_depth = depth;
+            }
+        } else {
+            for (unsigned i = 0; i <= n->m_size; i++) {
+                node_cell const * c = n->child_ptr(i);
+                lean_assert(c);
+                if (i > 0) {
+                    lean_assert(cmp(n->value(i - 1), *min(c)) < 0);
+                }
+                if (i < n->m_size) {
+                    lean_assert(cmp(*max(c), n->value(i)) < 0);
+                }
+                check_invariant(c, false, depth + 1, leaf_depth);
+            }
+        }
+        return true;
+    }
+
+    node m_root;
+
+public:
+    btree(CMP const & cmp = CMP()):CMP(cmp) {}
+    btree(btree const & s):CMP(s), m_root(s.m_root) {}
+    btree(btree && s):CMP(s), m_root(s.m_root) {}
+    explicit btree(buffer<T> const & s) {
+        for (auto const & v : s)
+            insert(v);
+    }
+    explicit btree(T const & v) {
+        insert(v);
+    }
+
+    btree & operator=(btree const & s) { m_root = s.m_root; return *this; }
+    btree & operator=(btree && s) { m_root = s.m_root; return *this; }
+
+    CMP const & get_cmp() const { return *this; }
+
+    unsigned get_rc() const { return m_root ? m_root->get_rc() : 0; }
+
+    void insert(T const & v) {
+        lean_cond_assert("btree", check_invariant());
+        if (!m_root) {
+            m_root = node(new node_cell(true));
+            m_root->insert_at(0, v);
+            return;
+        }
+        m_root = ensure_unshared(m_root.steal());
+        if (m_root->m_size == max_values) {
+            node r(new node_cell(false));
+            r->m_children[0] = m_root.steal();
+            split_child(r.m_ptr, 0);
+            m_root = std::move(r);
+        }
+        insert_non_full(m_root.m_ptr, v);
+        lean_cond_assert("btree", check_invariant());
+    }
+
+    void erase_min() {
+        lean_assert(!empty());
+        T v = *min();
+        erase_core(v);
+    }
+
+    void erase_core(T const & v) {
+        lean_cond_assert("btree", check_invariant());
+        lean_assert(contains(v));
+        m_root = ensure_unshared(m_root.steal());
+        erase_core(m_root.m_ptr, v);
+        if (m_root->m_size == 0)
+            m_root = m_root->is_leaf() ? node() : m_root->m_children[0];
+        lean_cond_assert("btree", check_invariant());
+    }
+
+    void erase(T const & v) {
+        if (contains(v))
+            erase_core(v);
+    }
+
+    T const * find(T const & v) const {
+        node_cell const * n = m_root.m_ptr;
+        while (n) {
+            bool found;
+            unsigned i = lower_bound(n, v, found);
+            if (found)
+                return &n->value(i);
+            n = n->is_leaf() ? nullptr : n->child_ptr(i);
+        }
+        return nullptr;
+    }
+
+    T const * min() const { return min(m_root.m_ptr); }
+    T const * max() const { return max(m_root.m_ptr); }
+    bool contains(T const & v) const { return find(v) != nullptr; }
+
+    template<typename F>
+    void for_each(F && f) const {
+        node r = m_root;
+        for_each(f, r.m_ptr);
+    }
+
+    template<typename F>
+    optional<T> find_if(F && f) const {
+        node r = m_root;
+        return find_if(f, r.m_ptr);
+    }
+
+    /* Similar to find_if, but searches keys backwards from greatest to least */
+    template<typename F>
+    optional<T> back_find_if(F && f) const {
+        node r = m_root;
+        return back_find_if(f, r.m_ptr);
+    }
+
+    template<typename F>
+    void for_each_greater(T const & v, F && f) const {
+        node r = m_root;
+        for_each_greater(v, f, r.m_ptr);
+    }
+
+    T const * find_next_greater_or_equal(T const & v) const {
+        return find_next_greater_or_equal(v, m_root.m_ptr);
+    }
+
+    // For debugging purposes
+    void display(std::ostream & out) const { display(out, m_root.m_ptr); }
+
+    unsigned get_depth() const { return get_depth(m_root.m_ptr); }
+
+    unsigned size() const {
+        unsigned r = 0;
+        for_each([&](T const & ){ r = r + 1; });
+        return r;
+    }
+
+    bool empty() const { return m_root.m_ptr == nullptr; }
+
+    void clear() { m_root = node(); }
+
+    friend std::ostream & operator<<(std::ostream & out, btree const & t) {
+        t.display(out);
+        return out;
+    }
+
+    bool check_invariant() const {
+        optional<unsigned> leaf_depth;
+        return !m_root || check_invariant(m_root.m_ptr, true, 0, leaf_depth);
+    }
+
+    /**
+        \brief Copy the contents of this tree to the given buffer.
+        The elements will be stored in increasing order.
+    */
+    void to_buffer(buffer<T> & r) const {
+        to_buffer(m_root.m_ptr, r);
+    }
+
+    void merge(btree const & s) {
+        if (empty())
+            *this = s;
+        else if (!is_eqp(*this, s))
+            s.for_each([&](T const & v) { insert(v); });
+    }
+
+    bool is_superset(btree const & s) const {
+        return !s.find_if([&](T const & v) { return !contains(v); });
+    }
+
+    bool is_strict_superset(btree const & s) const {
+        if (!is_superset(s))
+            return false;
+        return !s.is_superset(*this);
+    }
+
+    void remove(btree const & s) {
+        s.for_each([&](T const & v) { erase(v); });
+    }
+
+    friend bool is_eqp(btree const & s1, btree const & s2) { return is_eqp(s1.m_root, s2.m_root); }
+
+    class iterator {
+        /* Path from the root to the next value: each entry is a node and the position of the next
+           value to visit in it. */
+        buffer<std::pair<node_cell const *, unsigned>> m_path;
+
+        void push_left(node_cell const * it) {
+            while (it) {
+                m_path.push_back(std::make_pair(it, 0u));
+                it = it->is_leaf() ? nullptr : it->child_ptr(0);
+            }
+        }
+
+    public:
+        iterator(btree const & t) {
+            push_left(t.m_root.m_ptr);
+        }
+
+        bool has_next() const { return !m_path.empty(); }
+
+        T const & next() {
+            lean_assert(has_next());
+            node_cell const * n = m_path.back().first;
+            unsigned i          = m_path.back().second;
+            T const & r         = n->value(i);
+            m_path.back().second++;
+            if (!n->is_leaf()) {
+                push_left(n->child_ptr(i + 1));
+            } else {
+                while (!m_path.empty() && m_path.back().second == m_path.back().first->m_size)
+                    m_path.pop_back();
+            }
+            return r;
+        }
+    };
+
+    /* Return true iff this and other have the same set of elements with respect to CMP.
+       This method assumes the cmp for this and other are the same. */
+    bool equal_elems(btree const & other) const {
+        iterator it1(*this);
+        iterator it2(other);
+        while (it1.has_next() && it2.has_next()) {
+            if (cmp(it1.next(), it2.next()) != 0)
+                return false;
+        }
+        return !it1.has_next() && !it2.has_next();
+    }
+};
+
+template<typename T, typename CMP>
+bool operator==(btree<T, CMP> const & s1, btree<T, CMP> const & s2) {
+    return s1.is_superset(s2) && s2.is_superset(s1);
+}
+
+template<typename T, typename CMP>
+btree<T, CMP> insert(btree<T, CMP> const & t, T const & v) { btree<T, CMP> r(t); r.insert(v); return r; }
+template<typename T, typename CMP>
+btree<T, CMP> erase(btree<T, CMP> const & t, T const & v) { btree<T, CMP> r(t); r.erase(v); return r; }
+}
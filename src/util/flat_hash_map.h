@@ -0,0 +1,205 @@
+/*
+Copyright (c) 2024 Lean FRO, LLC. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+*/
+#pragma once
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <new>
+#include <utility>
+
+namespace lean {
+/** \brief Hash map with open addressing and linear probing.
+
+    Unlike `std::unordered_map`, it does not allocate a node per entry: the entries live in a single array
+    of slots, each storing the (32-bit) hash code of its entry. Probing compares the stored hash codes
+    before calling `Eq`, and growing the table does not recompute hashes.
+
+    It is meant for caches: entries cannot be erased, only the whole table can be cleared.
+    Pointers to entries are invalidated by `insert`. */
+template<typename Key, typename T, typename Hash = std::hash<Key>, typename Eq = std::equal_to<Key>>
+class flat_hash_map {
+public:
+    typedef std::pair<Key, T>  value_type;
+    typedef value_type *       iterator;
+    typedef value_type const * const_iterator;
+private:
+    struct slot {
+        /* `m_hash == 0` iff the slot is empty. */
+        uint32_t m_hash;
+        alignas(value_type) unsigned char m_value[sizeof(value_type)];
+        value_type & value() { return *reinterpret_cast<value_type *>(m_value); }
+        value_type const & value() const { return *reinterpret_cast<value_type const *>(m_value); }
+    };
+    slot *       m_slots    = nullptr;
+    /* Zero or a power of two. */
+    size_t       m_capacity = 0;
+    unsigned     m_shift    = 64;
+    size_t       m_size     = 0;
+    Hash         m_hash;
+    Eq           m_eq;
+
+    uint32_t hash_of(Key const & k) const {
+        uint32_t h = static_cast<uint32_t>(m_hash(k));
+        return h == 0 ? 1 : h;
+    }
+
+    /* Fibonacci hashing: spreads hash codes with poor low bits (e.g., pointers) over the table. */
+    size_t index_of(uint32_t h) const {
+        return static_cast<size_t>((static_cast<uint64_t>(h) * 0x9E3779B97F4A7C15ull) >> m_shift);
+    }
+
+    void destroy_slots() {
+        for (size_t i = 0; i < m_capacity; i++) {
+            if (m_slots[i].m_hash != 0)
+                m_slots[i].value().~value_type();
+        }
+    }
+
+    void release() {
+        if (m_capacity > 0) {
+            destroy_slots();
+            std::free(m_slots);
+        }
+        m_slots    = nullptr;
+        m_capacity = 0;
+        m_shift    = 64;
+        m_size     = 0;
+    }
+
+    void allocate(size_t capacity) {
+        m_slots    = static_cast<slot *>(std::calloc(capacity, sizeof(slot)));
+        if (m_slots == nullptr)
+            throw std::bad_alloc();
+        m_capacity = capacity;
+        m_shift    = 64;
+        while (capacity > 1) {
+            capacity >>= 1;
+            m_shift--;
+        }
+    }
+
+    void grow() {
+        slot * old_slots    = m_slots;
+        size_t old_capacity = m_capacity;
+        allocate(old_capacity == 0 ? 16 : 2 * old_capacity);
+        size_t mask = m_capacity - 1;
+        for (size_t i = 0; i < old_capacity; i++) {
+            uint32_t h = old_slots[i].m_hash;
+            if (h != 0) {
+                size_t j = index_of(h);
+                while (m_slots[j].m_hash != 0)
+                    j = (j + 1) & mask;
+                m_slots[j].m_hash = h;
+                new (m_slots[j].m_value) value_type(std::move(old_slots[i].value()));
+                old_slots[i].value().~value_type();
+            }
+        }
+        if (old_capacity > 0)
+            std::free(old_slots);
+    }
+
+    /* Return the slot containing `k`, or the empty slot where it should be inserted. */
+    size_t find_slot(Key const & k, uint32_t h) const {
+        size_t mask = m_capacity - 1;
+        size_t i    = index_of(h);
+        while (true) {
+            uint32_t h_i = m_slots[i].m_hash;
+            if (h_i == 0 || (h_i == h && m_eq(m_slots[i].value().first, k)))
+                return i;
+            i = (i + 1) & mask;
+        }
+    }
+
+public:
+    flat_hash_map() {}
+    flat_hash_map(flat_hash_map const & src) {
+        for (size_t i = 0; i < src.m_capacity; i++) {
+            if (src.m_slots[i].m_hash != 0)
+                insert(src.m_slots[i].value());
+        }
+    }
+    flat_hash_map(flat_hash_map && src):
+        m_slots(src.m_slots), m_capacity(src.m_capacity), m_shift(src.m_shift),
+        m_size(src.m_size), m_hash(std::move(src.m_hash)), m_eq(std::move(src.m_eq)) {
+        src.m_slots    = nullptr;
+        src.m_capacity = 0;
+        src.m_shift    = 64;
+        src.m_size     = 0;
+    }
+    ~flat_hash_map() { release(); }
+
+    flat_hash_map & operator=(flat_hash_map const & src) {
+        if (this != &src) {
+            flat_hash_map tmp(src);
+            *this = std::move(tmp);
+        }
+        return *this;
+    }
+    flat_hash_map & operator=(flat_hash_map && src) {
+        if (this != &src) {
+            release();
+            std::swap(m_slots, src.m_slots);
+            std::swap(m_capacity, src.m_capacity);
+            std::swap(m_shift, src.m_shift);
+            std::swap(m_size, src.m_size);
+        }
+        return *this;
+    }
+
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+    /* `find` returns `end()` for keys that are not in the map. */
+    iterator end() { return nullptr; }
+    const_iterator end() const { return nullptr; }
+
+    iterator find(Key const & k) {
+        if (m_size == 0) return nullptr;
+        size_t i = find_slot(k, hash_of(k));
+        return m_slots[i].m_hash != 0 ? &m_slots[i].value() : nullptr;
+    }
+    const_iterator find(Key const & k) const {
+        if (m_size == 0) return nullptr;
+        size_t i = find_slot(k, hash_of(k));
+        return m_slots[i].m_hash != 0 ? &m_slots[i].value() : nullptr;
+    }
+    bool contains(Key const & k) const { return find(k) != nullptr; }
+
+    /* Insert `p` unless its key is already in the map. As `std::unordered_map::insert`, it does not
+       overwrite existing entries. */
+    template<typename P> std::pair<iterator, bool> insert(P && p) {
+        /* Keep the load factor below 3/4. */
+        if (4 * (m_size + 1) > 3 * m_capacity)
+            grow();
+        uint32_t h = hash_of(p.first);
+        size_t i   = find_slot(p.first, h);
+        if (m_slots[i].m_hash != 0)
+            return std::make_pair(&m_slots[i].value(), false);
+        new (m_slots[i].m_value) value_type(std::forward<P>(p));
+        m_slots[i].m_hash = h;
+        m_size++;
+        return std::make_pair(&m_slots[i].value(), true);
+    }
+
+    T & operator[](Key const & k) {
+        return insert(value_type(k, T())).first->second;
+    }
+
+    /* Remove all entries, but keep the table. */
+    void clear() {
+        if (m_size == 0) return;
+        destroy_slots();
+        for (size_t i = 0; i < m_capacity; i++)
+            m_slots[i].m_hash = 0;
+        m_size = 0;
+    }
+
+    template<typename F> void for_each(F && f) const {
+        for (size_t i = 0; i < m_capacity; i++) {
+            if (m_slots[i].m_hash != 0)
+                f(m_slots[i].value().first, m_slots[i].value().second);
+        }
+    }
+};
+}
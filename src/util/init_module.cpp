@@ -9,6 +9,7 @@ Author: Leonardo de Moura
 #include "util/ascii.h"
 #include "util/name.h"
 #include "util/name_generator.h"
+#include "util/name_interner.h"
 #include "util/options.h"
 
 namespace lean {
@@ -17,10 +18,12 @@ void initialize_util_module() {
     initialize_ascii();
     initialize_name();
     initialize_name_generator();
+    initialize_name_interner();
     initialize_options();
 }
 void finalize_util_module() {
     finalize_options();
+    finalize_name_interner();
     finalize_name_generator();
     finalize_name();
     finalize_ascii();
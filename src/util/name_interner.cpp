@@ -0,0 +1,64 @@
+/*
+Copyright (c) 2024 Lean FRO, LLC. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+*/
+#include <atomic>
+#include <unordered_map>
+#include "runtime/thread.h"
+#include "util/name_interner.h"
+
+namespace lean {
+class name_interner {
+    struct shard {
+        mutex                                                          m_mutex;
+        /* Owns a reference to the first name object seen for each name. */
+        std::unordered_map<name, unsigned, name_hash_fn, name_eq_fn>   m_ids;
+        /* Addresses of the keys of `m_ids` and of persistent name objects, which are never deleted,
+           so that an address is never reused for a different name. */
+        std::unordered_map<object *, unsigned>                         m_ptr_ids;
+    };
+    static constexpr unsigned num_shards = 32;
+    shard                 m_shards[num_shards];
+    std::atomic<unsigned> m_next_id{0};
+public:
+    /* Return the id of `n` and a name object equal to `n` that is never deleted. */
+    std::pair<unsigned, object *> get(name const & n) {
+        shard & s   = m_shards[n.hash() % num_shards];
+        object * o  = n.raw();
+        lock_guard<mutex> lock(s.m_mutex);
+        auto it = s.m_ptr_ids.find(o);
+        if (it != s.m_ptr_ids.end())
+            return mk_pair(it->second, o);
+        auto it2 = s.m_ids.find(n);
+        if (it2 == s.m_ids.end()) {
+            unsigned id = m_next_id++;
+            // `o` is now reachable from other threads.
+            mark_mt(o);
+            s.m_ids.insert(mk_pair(n, id));
+            s.m_ptr_ids.insert(mk_pair(o, id));
+            return mk_pair(id, o);
+        }
+        if (is_scalar(o) || lean_is_persistent(o))
+            s.m_ptr_ids.insert(mk_pair(o, it2->second));
+        return mk_pair(it2->second, it2->first.raw());
+    }
+};
+
+static name_interner * g_name_interner = nullptr;
+
+unsigned get_name_id(name const & n) {
+    return g_name_interner->get(n).first;
+}
+
+object * intern_name(name const & n) {
+    return g_name_interner->get(n).second;
+}
+
+void initialize_name_interner() {
+    g_name_interner = new name_interner();
+}
+
+void finalize_name_interner() {
+    delete g_name_interner;
+}
+}
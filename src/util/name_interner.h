@@ -0,0 +1,30 @@
+/*
+Copyright (c) 2024 Lean FRO, LLC. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+*/
+#pragma once
+#include "util/name.h"
+#include "util/flat_hash_map.h"
+
+namespace lean {
+/** \brief Return the id of \c n. Structurally equal names have the same id, and the id of a name
+    does not change during the execution.
+
+    Ids are assigned by a process-wide table shared by all threads. The table keeps the first name
+    object it sees for each name, and looking this object up again only hashes its address.
+    Persistent name objects (e.g., the ones stored in `.olean` files) are never deleted, and they
+    are looked up by address as well. Other name objects are compared structurally. */
+LEAN_EXPORT unsigned get_name_id(name const & n);
+
+/** \brief Return a name object structurally equal to \c n that is never deleted. */
+LEAN_EXPORT object * intern_name(name const & n);
+
+struct name_id_hash { size_t operator()(unsigned id) const { return id; } };
+
+/** \brief Hash map keyed by name ids (see `get_name_id`). Unlike `name_map` and `name_hash_map`,
+    lookups for names obtained from `.olean` files do not compare names structurally. */
+template<typename T> using name_id_map = flat_hash_map<unsigned, T, name_id_hash>;
+
+void initialize_name_interner();
+void finalize_name_interner();
+}
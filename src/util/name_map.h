@@ -8,5 +8,5 @@ Author: Leonardo de Moura
 #include "util/rb_map.h"
 #include "util/name.h"
 namespace lean {
-template<typename T> using name_map = rb_map<name, T, name_quick_cmp>;
+template<typename T> using name_map = btree_map<name, T, name_quick_cmp>;
 }
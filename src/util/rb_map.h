@@ -8,12 +8,16 @@ Author: Leonardo de Moura
 #include <utility>
 #include "util/pair.h"
 #include "util/rb_tree.h"
+#include "util/btree.h"
 
 namespace lean {
 /**
    \brief Wrapper for implementing maps using red black trees.
+
+   \c Tree is the persistent set used to store the entries. It must provide the same interface as
+   `rb_tree` (see `btree`).
 */
-template<typename K, typename T, typename CMP>
+template<typename K, typename T, typename CMP, template<typename, typename> class Tree = rb_tree>
 class rb_map {
 public:
     typedef pair<K, T> entry;
@@ -23,7 +27,7 @@ private:
         int operator()(entry const & e1, entry const & e2) const { return CMP::operator()(e1.first, e2.first); }
         CMP const & get_cmp() const { return *this; }
     };
-    rb_tree<entry, entry_cmp> m_map;
+    Tree<entry, entry_cmp> m_map;
 public:
     rb_map(CMP const & cmp = CMP()):m_map(entry_cmp(cmp)) {}
     friend void swap(rb_map & a, rb_map & b) { swap(a.m_map, b.m_map); }
@@ -121,27 +125,30 @@ public:
     // For debugging purposes
     void display(std::ostream & out) const { m_map.display(out); }
 
-    class iterator : public rb_tree<entry, entry_cmp>::iterator {
+    class iterator : public Tree<entry, entry_cmp>::iterator {
     public:
-        iterator(rb_map const & map):rb_tree<entry, entry_cmp>::iterator(map.m_map) {}
+        iterator(rb_map const & map):Tree<entry, entry_cmp>::iterator(map.m_map) {}
     };
 };
-template<typename K, typename T, typename CMP>
-rb_map<K, T, CMP> insert(rb_map<K, T, CMP> const & m, K const & k, T const & v) {
+template<typename K, typename T, typename CMP, template<typename, typename> class Tree>
+rb_map<K, T, CMP, Tree> insert(rb_map<K, T, CMP, Tree> const & m, K const & k, T const & v) {
     auto r = m;
     r.insert(k, v);
     return r;
 }
-template<typename K, typename T, typename CMP>
-rb_map<K, T, CMP> erase(rb_map<K, T, CMP> const & m, K const & k) {
+template<typename K, typename T, typename CMP, template<typename, typename> class Tree>
+rb_map<K, T, CMP, Tree> erase(rb_map<K, T, CMP, Tree> const & m, K const & k) {
     auto r = m;
     r.erase(k);
     return r;
 }
-template<typename K, typename T, typename CMP, typename F>
-void for_each(rb_map<K, T, CMP> const & m, F && f) {
+template<typename K, typename T, typename CMP, template<typename, typename> class Tree, typename F>
+void for_each(rb_map<K, T, CMP, Tree> const & m, F && f) {
     return m.for_each(f);
 }
 
+/** \brief Map stored in a B-tree (see `btree`). */
+template<typename K, typename T, typename CMP> using btree_map = rb_map<K, T, CMP, btree>;
+
 template<typename T> using unsigned_map = rb_map<unsigned, T, unsigned_cmp>;
 }
@@ -6,6 +6,9 @@ Author: Leonardo de Moura
 */
 #include <iostream>
 #include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <cstring>
 #include <signal.h>
 #include <cctype>
 #include <cstdlib>
@@ -23,6 +26,7 @@ Author: Leonardo de Moura
 #include "runtime/array_ref.h"
 #include "runtime/object_ref.h"
 #include "runtime/utf8.h"
+#include "runtime/cache_stats.h"
 #include "util/timer.h"
 #include "util/macros.h"
 #include "util/io.h"
@@ -56,6 +60,8 @@ Author: Leonardo de Moura
 #include <windows.h>
 #else
 #include <dlfcn.h>
+#include <dirent.h>
+#include <sys/wait.h>
 #endif
 
 #ifdef _MSC_VER
@@ -216,6 +222,11 @@ static void display_help(std::ostream & out) {
     std::cout << "  -s, --tstack=num       thread stack size in Kb\n";
     std::cout << "      --server           start lean in server mode\n";
     std::cout << "      --worker           start lean in server-worker mode\n";
+#endif
+#if !defined(LEAN_WINDOWS) && !defined(LEAN_EMSCRIPTEN)
+    std::cout << "      --fork-server      process files given as command lines on stdin, one per line and ending\n"
+              << "                         with the file name, in processes forked from one with the imports of\n"
+              << "                         the first file loaded; prints 'exit <code>' after each file\n";
 #endif
     std::cout << "      --plugin=file      load and initialize Lean shared library for registering linters etc.\n";
     std::cout << "      --load-dynlib=file load shared library to make its symbols available to the interpreter\n";
@@ -223,8 +234,11 @@ static void display_help(std::ostream & out) {
     std::cout << "      --deps             just print dependencies of a Lean input\n";
     std::cout << "      --print-prefix     print the installation prefix for Lean and exit\n";
     std::cout << "      --print-libdir     print the installation directory for Lean's built-in libraries and exit\n";
+    std::cout << "      --verify-olean     check that the given .olean files are intact and compatible without loading them\n";
     std::cout << "      --profile          display elaboration/type checking time for each definition/theorem\n";
-    std::cout << "      --stats            display environment statistics\n";
+    std::cout << "      --profile-json=file write the time, allocations and heartbeats of each profiled component\n"
+              << "                         per declaration to the given file, as one JSON object per line\n";
+    std::cout << "      --stats            display environment statistics and hit rates of elaborator caches\n";
     DEBUG_CODE(
     std::cout << "      --debug=tag        enable assertions with the given tag\n";
         )
@@ -233,6 +247,7 @@ static void display_help(std::ostream & out) {
 
 static int print_prefix = 0;
 static int print_libdir = 0;
+static int verify_olean = 0;
 static int json_output = 0;
 
 static struct option g_long_options[] = {
@@ -247,6 +262,7 @@ static struct option g_long_options[] = {
     {"memory",       required_argument, 0, 'M'},
     {"trust",        required_argument, 0, 't'},
     {"profile",      no_argument,       0, 'P'},
+    {"profile-json", required_argument, 0, 'F'},
     {"stats",        no_argument,       0, 'a'},
     {"quiet",        no_argument,       0, 'q'},
     {"deps",         no_argument,       0, 'd'},
@@ -267,6 +283,7 @@ static struct option g_long_options[] = {
     {"json",         no_argument,       &json_output, 1},
     {"print-prefix", no_argument,       &print_prefix, 1},
     {"print-libdir", no_argument,       &print_libdir, 1},
+    {"verify-olean", no_argument,       &verify_olean, 1},
 #ifdef LEAN_DEBUG
     {"debug",        required_argument, 0, 'B'},
 #endif
@@ -336,6 +353,7 @@ void load_plugin(std::string path) {
     }
     init = dlsym(handle, sym.c_str());
 #endif
+    note_dynlib_loaded();
     if (!init) {
         throw exception(sstream() << "error, plugin " << path << " does not seem to contain a module '" << pkg << "'");
     }
@@ -354,6 +372,7 @@ extern "C" object * lean_run_frontend(
     uint32_t trust_level,
     object * ilean_filename,
     uint8_t  json_output,
+    object * imported_env,
     object * w
 );
 pair_ref<environment, object_ref> run_new_frontend(
@@ -362,12 +381,17 @@ pair_ref<environment, object_ref> run_new_frontend(
     name const & main_module_name,
     uint32_t trust_level,
     optional<std::string> const & ilean_file_name,
-    uint8_t json_output
+    uint8_t json_output,
+    optional<environment> const & imported_env
 ) {
     object * oilean_file_name = mk_option_none();
     if (ilean_file_name) {
         oilean_file_name = mk_option_some(mk_string(*ilean_file_name));
     }
+    object * oimported_env = mk_option_none();
+    if (imported_env) {
+        oimported_env = mk_option_some(imported_env->to_obj_arg());
+    }
     return get_io_result<pair_ref<environment, object_ref>>(lean_run_frontend(
         mk_string(input),
         opts.to_obj_arg(),
@@ -376,6 +400,7 @@ pair_ref<environment, object_ref> run_new_frontend(
         trust_level,
         oilean_file_name,
         json_output,
+        oimported_env,
         io_mk_world()
     ));
 }
@@ -390,9 +415,162 @@ uint32_t run_server_worker(options const & opts) {
 extern "C" object* lean_server_watchdog_main(object* args, object* w);
 uint32_t run_server_watchdog(buffer<string_ref> const & args) {
     list_ref<string_ref> arglist = to_list_ref(args);
+#if defined(__linux__)
+    // let workers share decompressed images of compressed .olean files, see `LEAN_OLEAN_SHARED_CACHE` in
+    // library/module.cpp
+    std::string cache_dir;
+    if (!std::getenv("LEAN_OLEAN_SHARED_CACHE") && access("/dev/shm", W_OK) == 0) {
+        cache_dir = "/dev/shm/lean-olean-" + std::to_string(getpid());
+        setenv("LEAN_OLEAN_SHARED_CACHE", cache_dir.c_str(), 1);
+    }
+    uint32_t r = get_io_scalar_result<uint32_t>(lean_server_watchdog_main(arglist.to_obj_arg(), io_mk_world()));
+    if (!cache_dir.empty()) {
+        // the images are on a RAM-backed file system, so do not leave them behind; mapped images stay valid
+        if (DIR * dir = opendir(cache_dir.c_str())) {
+            while (struct dirent * e = readdir(dir)) {
+                if (e->d_name[0] != '.')
+                    unlink((cache_dir + "/" + e->d_name).c_str());
+            }
+            closedir(dir);
+        }
+        rmdir(cache_dir.c_str());
+    }
+    return r;
+#else
     return get_io_scalar_result<uint32_t>(lean_server_watchdog_main(arglist.to_obj_arg(), io_mk_world()));
+#endif
+}
+
+#if !defined(LEAN_WINDOWS) && !defined(LEAN_EMSCRIPTEN)
+/* def importHeader (input : String) (fileName : String) (opts : Options) (trustLevel : UInt32) : IO Environment */
+extern "C" object * lean_import_header(object * input, object * file_name, object * opts, uint32_t trust_level, object * w);
+
+/* Implementation of `--fork-server`: read command lines from stdin and process each in a child process forked
+   from this one, which has the imports of the first file already loaded. Children processing files with other
+   imports import them as usual; the loaded imports are never replaced, as their regions cannot be unmapped
+   safely. Must be called before the task manager is started, since its threads do not survive `fork`.
+   Returns `true` in a child, with `args` set to its command line (the arguments of the server other than
+   `--fork-server` followed by the request), and `false` in the server at the end of the input. */
+/* Whether the option `arg` of a command line takes the following argument as its value. */
+static bool takes_separate_argument(std::string const & arg) {
+    if (arg.compare(0, 2, "--") == 0) {
+        if (arg.find('=') != std::string::npos)
+            return false;
+        for (struct option const * o = g_long_options; o->name; o++) {
+            if (arg.compare(2, std::string::npos, o->name) == 0)
+                return o->has_arg == required_argument;
+        }
+        return false;
+    }
+    if (arg.size() != 2)
+        return false;
+    char const * c = strchr(g_opt_str, arg[1]);
+    return c && c[1] == ':';
 }
 
+/* The file to process of a command line, i.e. its first argument that is neither an option nor the value of one. */
+static optional<std::string> get_file_argument(std::vector<std::string> const & args) {
+    for (size_t i = 0; i < args.size(); i++) {
+        if (args[i].size() > 1 && args[i][0] == '-') {
+            if (takes_separate_argument(args[i]))
+                i++;
+        } else {
+            return optional<std::string>(args[i]);
+        }
+    }
+    return optional<std::string>();
+}
+
+/* The `-D` and `-t` arguments of a command line, normalized to `-D<value>` and `-t<value>`. They determine how the
+   imports of the file are loaded. */
+static std::vector<std::string> get_import_arguments(std::vector<std::string> const & args) {
+    std::vector<std::string> r;
+    for (size_t i = 0; i < args.size(); i++) {
+        std::string const & arg = args[i];
+        if (arg.compare(0, 2, "-D") == 0 || arg.compare(0, 2, "-t") == 0) {
+            if (arg.size() > 2)
+                r.push_back(arg);
+            else if (i + 1 < args.size())
+                r.push_back(arg + args[++i]);
+        } else if (arg.compare(0, 8, "--trust=") == 0) {
+            r.push_back("-t" + arg.substr(8));
+        } else if (arg == "--trust") {
+            if (i + 1 < args.size())
+                r.push_back("-t" + args[++i]);
+        } else if (takes_separate_argument(arg)) {
+            i++;
+        }
+    }
+    return r;
+}
+
+static bool run_fork_server(int argc, char ** argv, optional<environment> & imported_env, std::vector<std::string> & args) {
+    std::vector<std::string> server_args;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--fork-server") != 0)
+            server_args.push_back(argv[i]);
+    }
+    lean::io_mark_end_initialization();
+    bool preloaded = false;
+    // the imports are only preloaded once, for the options and trust level of the first request
+    std::vector<std::string> preloaded_import_args;
+    std::string line;
+    while (std::getline(std::cin, line)) {
+        std::istringstream in(line);
+        std::vector<std::string> request;
+        std::string arg;
+        while (in >> arg)
+            request.push_back(arg);
+        if (request.empty())
+            continue;
+        std::vector<std::string> cmd_args(server_args);
+        cmd_args.insert(cmd_args.end(), request.begin(), request.end());
+        std::vector<std::string> import_args = get_import_arguments(cmd_args);
+        if (!preloaded) {
+            preloaded = true;
+            preloaded_import_args = import_args;
+            // the file is not necessarily the last argument, e.g. Lake passes `--json` after it
+            if (optional<std::string> fn = get_file_argument(request)) {
+                try {
+                    options opts       = get_default_options();
+                    unsigned trust_lvl = LEAN_BELIEVER_TRUST_LEVEL + 1;
+                    for (std::string const & import_arg : import_args) {
+                        if (import_arg[1] == 'D')
+                            opts = set_config_option(opts, import_arg.c_str() + 2);
+                        else
+                            trust_lvl = atoi(import_arg.c_str() + 2);
+                    }
+                    imported_env = get_io_result<environment>(lean_import_header(
+                        mk_string(read_file(*fn)), mk_string(*fn), opts.to_obj_arg(), trust_lvl, io_mk_world()));
+                } catch (lean::throwable &) {
+                    // reported by the child
+                }
+            }
+        }
+        std::cout.flush();
+        std::cerr.flush();
+        pid_t pid = fork();
+        if (pid == 0) {
+            // imports loaded with different options or trust level must not be used
+            if (import_args != preloaded_import_args)
+                imported_env = optional<environment>();
+            args.push_back(argv[0]);
+            args.insert(args.end(), cmd_args.begin(), cmd_args.end());
+            return true;
+        }
+        int status = 0;
+        if (pid == -1) {
+            std::cerr << "error: fork failed: " << strerror(errno) << std::endl;
+        } else {
+            while (waitpid(pid, &status, 0) == -1 && errno == EINTR) {}
+        }
+        int code = pid != -1 && WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+        std::cout << "exit " << code << std::endl;
+    }
+    return false;
+}
+#endif
+
 extern "C" object* lean_init_search_path(object* w);
 void init_search_path() {
     get_io_scalar_result<unsigned>(lean_init_search_path(io_mk_world()));
@@ -471,6 +649,7 @@ extern "C" LEAN_EXPORT int lean_main(int argc, char ** argv) {
     bool run = false;
     optional<std::string> olean_fn;
     optional<std::string> ilean_fn;
+    optional<std::string> profile_json_fn;
     bool use_stdin = false;
     unsigned trust_lvl = LEAN_BELIEVER_TRUST_LEVEL + 1;
     bool only_deps = false;
@@ -492,6 +671,22 @@ extern "C" LEAN_EXPORT int lean_main(int argc, char ** argv) {
     }
     consume_io_result(lean_enable_initializer_execution(io_mk_world()));
 
+    optional<environment> imported_env;
+#if !defined(LEAN_WINDOWS) && !defined(LEAN_EMSCRIPTEN)
+    std::vector<std::string> request_args;
+    std::vector<char *> request_argv;
+    if (std::any_of(argv + 1, argv + argc, [](char * arg) { return strcmp(arg, "--fork-server") == 0; })) {
+        if (!run_fork_server(argc, argv, imported_env, request_args))
+            return 0;
+        // in a child, continue with the request's command line
+        for (std::string & arg : request_args)
+            request_argv.push_back(&arg[0]);
+        request_argv.push_back(nullptr);
+        argc = request_args.size();
+        argv = request_argv.data();
+    }
+#endif
+
     options opts = get_default_options();
     optional<std::string> server_in;
     std::string native_output;
@@ -602,6 +797,11 @@ extern "C" LEAN_EXPORT int lean_main(int argc, char ** argv) {
             case 'P':
                 opts = opts.update("profiler", true);
                 break;
+            case 'F':
+                check_optarg("profile-json");
+                profile_json_fn = optarg;
+                enable_profile_json();
+                break;
 #if defined(LEAN_DEBUG)
             case 'B':
                 check_optarg("B");
@@ -638,6 +838,19 @@ extern "C" LEAN_EXPORT int lean_main(int argc, char ** argv) {
         return 0;
     }
 
+    if (verify_olean) {
+        int ret = 0;
+        for (int i = optind; i < argc; i++) {
+            try {
+                verify_module_data(argv[i]);
+            } catch (lean::throwable & ex) {
+                std::cerr << "error: " << ex.what() << std::endl;
+                ret = 1;
+            }
+        }
+        return ret;
+    }
+
     if (auto max_memory = opts.get_unsigned(get_max_memory_opt_name(),
                                             opts.get_bool("server") ? LEAN_SERVER_DEFAULT_MAX_MEMORY
                                                                     : LEAN_DEFAULT_MAX_MEMORY)) {
@@ -726,12 +939,13 @@ extern "C" LEAN_EXPORT int lean_main(int argc, char ** argv) {
 
         if (!main_module_name)
             main_module_name = name("_stdin");
-        pair_ref<environment, object_ref> r = run_new_frontend(contents, opts, mod_fn, *main_module_name, trust_lvl, ilean_fn, json_output);
+        pair_ref<environment, object_ref> r = run_new_frontend(contents, opts, mod_fn, *main_module_name, trust_lvl, ilean_fn, json_output, imported_env);
         env = r.fst();
         bool ok = unbox(r.snd().raw());
 
         if (stats) {
             env.display_stats();
+            display_cache_stats(std::cout);
         }
 
         if (run && ok) {
@@ -767,6 +981,15 @@ extern "C" LEAN_EXPORT int lean_main(int argc, char ** argv) {
 
         display_cumulative_profiling_times(std::cerr);
 
+        if (profile_json_fn) {
+            std::ofstream out(*profile_json_fn);
+            if (out.fail()) {
+                std::cerr << "failed to create '" << *profile_json_fn << "'\n";
+                return 1;
+            }
+            write_profile_json(out, *main_module_name);
+        }
+
 #ifdef LEAN_SMALL_ALLOCATOR
         // If the small allocator is not enabled, then we assume we are not using the sanitizer.
         // Thus, we interrupt execution without garbage collecting.
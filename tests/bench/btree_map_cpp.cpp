@@ -0,0 +1,56 @@
+/*
+Microbenchmark comparing the red-black tree and B-tree backends of `lean::rb_map` on the access
+pattern of the elaborator's persistent maps: insertions into shared copies, and many lookups.
+
+    c++ -O3 -std=c++17 -I../../src btree_map_cpp.cpp -o btree_map_cpp.out
+    ./btree_map_cpp.out 1000000
+*/
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <vector>
+#include "util/rb_map.h"
+
+template<typename Map> size_t run(std::vector<unsigned> const & keys) {
+    size_t r = 0;
+    Map m;
+    std::vector<Map> snapshots;
+    for (size_t i = 0; i < keys.size(); i++) {
+        /* keep old versions alive, so that insertions copy the shared nodes */
+        if (i % 1024 == 0)
+            snapshots.push_back(m);
+        m.insert(keys[i], i);
+    }
+    for (unsigned k = 0; k < 4; k++) {
+        for (unsigned key : keys) {
+            if (auto v = m.find(key))
+                r += *v;
+        }
+    }
+    m.for_each([&](unsigned, size_t v) { r ^= v; });
+    return r;
+}
+
+template<typename Map> void bench(char const * name, std::vector<unsigned> const & keys) {
+    auto start = std::chrono::steady_clock::now();
+    size_t r   = run<Map>(keys);
+    std::chrono::duration<double, std::milli> d = std::chrono::steady_clock::now() - start;
+    std::cout << name << ": " << d.count() << "ms (" << r << ")\n";
+}
+
+int main(int argc, char ** argv) {
+    if (argc != 2) {
+        std::cout << "invalid number of arguments\n";
+        return 1;
+    }
+    unsigned n = atoi(argv[1]);
+    std::vector<unsigned> keys(n);
+    std::iota(keys.begin(), keys.end(), 0);
+    std::shuffle(keys.begin(), keys.end(), std::mt19937(42));
+    bench<lean::rb_map<unsigned, size_t, lean::unsigned_cmp>>("lean::rb_map (rb_tree)", keys);
+    bench<lean::btree_map<unsigned, size_t, lean::unsigned_cmp>>("lean::btree_map", keys);
+    return 0;
+}
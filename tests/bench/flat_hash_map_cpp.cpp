@@ -0,0 +1,64 @@
+/*
+Microbenchmark comparing `std::unordered_map` with `lean::flat_hash_map` on the access pattern of
+the kernel caches: pointer keys, many lookups per insertion, and periodic `clear`.
+
+    c++ -O3 -std=c++17 -I../../src flat_hash_map_cpp.cpp -o flat_hash_map_cpp.out
+    ./flat_hash_map_cpp.out 1000000
+*/
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <unordered_map>
+#include <vector>
+#include "util/flat_hash_map.h"
+
+struct node { size_t m_data[4]; };
+
+template<typename Map> size_t run(std::vector<node *> const & keys, unsigned rounds) {
+    size_t r = 0;
+    Map m;
+    for (unsigned k = 0; k < rounds; k++) {
+        m.clear();
+        for (size_t i = 0; i < keys.size(); i++) {
+            /* lookup of a recent key, of an older one, and of the key about to be inserted */
+            auto it1 = m.find(keys[i / 2]);
+            if (it1 != m.end()) r += it1->second;
+            auto it2 = m.find(keys[i - i / 4]);
+            if (it2 != m.end()) r += it2->second;
+            if (m.find(keys[i]) == m.end())
+                m.insert(std::make_pair(keys[i], i));
+        }
+    }
+    return r;
+}
+
+template<typename Map> void bench(char const * name, std::vector<node *> const & keys, unsigned rounds) {
+    auto start = std::chrono::steady_clock::now();
+    size_t r   = run<Map>(keys, rounds);
+    std::chrono::duration<double, std::milli> d = std::chrono::steady_clock::now() - start;
+    std::cout << name << ": " << d.count() << "ms (" << r << ")\n";
+}
+
+int main(int argc, char ** argv) {
+    if (argc != 2) {
+        std::cout << "invalid number of arguments\n";
+        return 1;
+    }
+    size_t n = atoi(argv[1]);
+    std::vector<std::unique_ptr<node>> nodes;
+    std::vector<node *> keys;
+    for (size_t i = 0; i < n; i++) {
+        nodes.emplace_back(new node());
+        keys.push_back(nodes.back().get());
+    }
+    /* Allocation order makes consecutive keys adjacent in memory, which favors tables that do not
+       mix the hash code. Kernel expressions are looked up by structural hash, so shuffle. */
+    std::shuffle(keys.begin(), keys.end(), std::mt19937(42));
+    unsigned rounds = 10;
+    bench<std::unordered_map<node *, size_t>>("std::unordered_map", keys, rounds);
+    bench<lean::flat_hash_map<node *, size_t>>("lean::flat_hash_map", keys, rounds);
+    return 0;
+}
@@ -0,0 +1,34 @@
+import Std.Data.HashMap
+import Std.Data.SwissMap
+
+/-! Inserts, looks up and erases `n` keys in `Std.HashMap` and `Std.SwissMap`. -/
+
+def key (i : Nat) : Nat := (i * 2654435761) % 4294967296
+
+@[noinline] def benchHashMap (n : Nat) : Nat := Id.run do
+  let mut m : Std.HashMap Nat Nat := {}
+  for i in [0:n] do
+    m := m.insert (key i) i
+  let mut sum := 0
+  for i in [0:2*n] do
+    sum := sum + m.getD (key i) 0
+  for i in [0:n:2] do
+    m := m.erase (key i)
+  return sum + m.size
+
+@[noinline] def benchSwissMap (n : Nat) : Nat := Id.run do
+  let mut m : Std.SwissMap Nat Nat := {}
+  for i in [0:n] do
+    m := m.insert (key i) i
+  let mut sum := 0
+  for i in [0:2*n] do
+    sum := sum + m.getD (key i) 0
+  for i in [0:n:2] do
+    m := m.erase (key i)
+  return sum + m.size
+
+def main (args : List String) : IO Unit := do
+  let n := args[0]!.toNat!
+  let which := args.getD 1 "swiss"
+  let r := if which == "swiss" then benchSwissMap n else benchHashMap n
+  IO.println r
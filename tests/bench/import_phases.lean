@@ -0,0 +1,37 @@
+import Lean
+
+/-!
+Time and memory of the phases of `importModules` for the given modules (default: `Lean`).
+Regions of .olean files that cannot be memory-mapped at their base address have to be relocated
+while reading, so the number of mapped modules is reported alongside the reading time.
+-/
+
+open Lean
+
+/-- Resident set size in MB, from `/proc/self/statm` (Linux only, assuming 4KB pages). -/
+def rss : IO Float := do
+  let statm ← IO.FS.readFile "/proc/self/statm"
+  let pages := (statm.splitOn " ")[1]!.toNat!
+  return (pages * 4096).toFloat / 1048576.0
+
+def phase (name : String) (act : IO α) : IO α := do
+  let startTime ← IO.monoNanosNow
+  let a ← act
+  let endTime ← IO.monoNanosNow
+  IO.println s!"{name}: {(endTime - startTime).toFloat / 1000000000.0}"
+  IO.println s!"{name} rss: {← rss}"
+  return a
+
+unsafe def main (args : List String) : IO Unit := do
+  let mods := if args.isEmpty then [`Lean] else args.map String.toName
+  let imports := mods.toArray.map ({ module := · })
+  initSearchPath (← findSysroot)
+  enableInitializersExecution
+  withImporting do
+    let (_, s) ← phase "read" (importModulesCore imports |>.run)
+    IO.println s!"modules: {s.moduleNames.size}"
+    IO.println s!"memory-mapped modules: {s.regions.filter (·.isMemoryMapped) |>.size}"
+    let (const2ModIdx, constantMap) ← phase "constant maps" (mkImportedConstMaps s)
+    let env ← phase "extension states" (mkImportedEnvironment s imports const2ModIdx constantMap)
+    let env ← phase "extensions" (finalizePersistentExtensions env s.moduleData {})
+    IO.println s!"constants: {env.constants.map₁.size}"
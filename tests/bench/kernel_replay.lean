@@ -0,0 +1,35 @@
+import Lean
+
+/-!
+Re-checks all declarations of the given modules (default: `Init`) with the kernel, starting from an
+empty environment with trust level 0. Reports the overall throughput, the checking time per kind of
+declaration, and the slowest declarations.
+-/
+
+open Lean
+
+def kind : Declaration → String
+  | .axiomDecl ..      => "axiom"
+  | .defnDecl ..       => "definition"
+  | .thmDecl ..        => "theorem"
+  | .opaqueDecl ..     => "opaque"
+  | .quotDecl          => "quot"
+  | .mutualDefnDecl .. => "definition"
+  | .inductDecl ..     => "inductive"
+
+def main (args : List String) : IO Unit := do
+  let mods := if args.isEmpty then [`Init] else args.map String.toName
+  initSearchPath (← findSysroot)
+  let env ← importModules (mods.toArray.map ({ module := · })) {}
+  let startTime ← IO.monoNanosNow
+  let s ← Environment.replayCore env.constants.map₁ (← mkEmptyEnvironment) (timed := true)
+  let endTime ← IO.monoNanosNow
+  let total := (endTime - startTime).toFloat / 1000000000.0
+  IO.println s!"replay: {total}"
+  IO.println s!"declarations/s: {s.times.size.toFloat / total}"
+  for k in ["definition", "theorem", "inductive"] do
+    let nanos := s.times.foldl (init := 0) fun n t => if kind t.decl == k then n + t.nanos else n
+    IO.println s!"{k}: {nanos.toFloat / 1000000000.0}"
+  let slowest := s.times.qsort (·.nanos > ·.nanos)
+  for t in slowest[:10] do
+    IO.eprintln s!"{t.nanos.toFloat / 1000000.0}ms {kind t.decl} {t.decl.getNames.headD .anonymous}"
@@ -0,0 +1,39 @@
+/-!
+Fourier-Motzkin elimination in `omega` on problems with many variables and facts.
+-/
+
+example (x0 x1 x2 x3 x4 x5 x6 x7 x8 x9 x10 x11 : Int)
+    (h0 : x0 < x1) (h1 : x1 < x2) (h2 : x2 < x3) (h3 : x3 < x4)
+    (h4 : x4 < x5) (h5 : x5 < x6) (h6 : x6 < x7) (h7 : x7 < x8)
+    (h8 : x8 < x9) (h9 : x9 < x10) (h10 : x10 < x11) (h11 : x11 < x0)
+    (g0 : x0 - x3 ≤ 100) (g1 : x1 - x4 ≤ 101) (g2 : x2 - x5 ≤ 102) (g3 : x3 - x6 ≤ 103)
+    (g4 : x4 - x7 ≤ 104) (g5 : x5 - x8 ≤ 105) (g6 : x6 - x9 ≤ 106) (g7 : x7 - x10 ≤ 107)
+    (g8 : x8 - x11 ≤ 108) (g9 : x9 - x0 ≤ 109) (g10 : x10 - x1 ≤ 110) (g11 : x11 - x2 ≤ 111)
+    : False := by
+  omega
+
+example (x0 x1 x2 x3 x4 x5 x6 x7 x8 x9 x10 x11 x12 x13 x14 x15 : Int)
+    (h0 : x0 < x1) (h1 : x1 < x2) (h2 : x2 < x3) (h3 : x3 < x4)
+    (h4 : x4 < x5) (h5 : x5 < x6) (h6 : x6 < x7) (h7 : x7 < x8)
+    (h8 : x8 < x9) (h9 : x9 < x10) (h10 : x10 < x11) (h11 : x11 < x12)
+    (h12 : x12 < x13) (h13 : x13 < x14) (h14 : x14 < x15) (h15 : x15 < x0)
+    (g0 : x0 - x4 ≤ 100) (g1 : x1 - x5 ≤ 101) (g2 : x2 - x6 ≤ 102) (g3 : x3 - x7 ≤ 103)
+    (g4 : x4 - x8 ≤ 104) (g5 : x5 - x9 ≤ 105) (g6 : x6 - x10 ≤ 106) (g7 : x7 - x11 ≤ 107)
+    (g8 : x8 - x12 ≤ 108) (g9 : x9 - x13 ≤ 109) (g10 : x10 - x14 ≤ 110) (g11 : x11 - x15 ≤ 111)
+    (g12 : x12 - x0 ≤ 112) (g13 : x13 - x1 ≤ 113) (g14 : x14 - x2 ≤ 114) (g15 : x15 - x3 ≤ 115)
+    : False := by
+  omega
+
+example (x0 x1 x2 x3 x4 x5 x6 x7 x8 x9 x10 x11 x12 x13 x14 x15 x16 x17 x18 x19 : Int)
+    (h0 : x0 < x1) (h1 : x1 < x2) (h2 : x2 < x3) (h3 : x3 < x4)
+    (h4 : x4 < x5) (h5 : x5 < x6) (h6 : x6 < x7) (h7 : x7 < x8)
+    (h8 : x8 < x9) (h9 : x9 < x10) (h10 : x10 < x11) (h11 : x11 < x12)
+    (h12 : x12 < x13) (h13 : x13 < x14) (h14 : x14 < x15) (h15 : x15 < x16)
+    (h16 : x16 < x17) (h17 : x17 < x18) (h18 : x18 < x19) (h19 : x19 < x0)
+    (g0 : x0 - x5 ≤ 100) (g1 : x1 - x6 ≤ 101) (g2 : x2 - x7 ≤ 102) (g3 : x3 - x8 ≤ 103)
+    (g4 : x4 - x9 ≤ 104) (g5 : x5 - x10 ≤ 105) (g6 : x6 - x11 ≤ 106) (g7 : x7 - x12 ≤ 107)
+    (g8 : x8 - x13 ≤ 108) (g9 : x9 - x14 ≤ 109) (g10 : x10 - x15 ≤ 110) (g11 : x11 - x16 ≤ 111)
+    (g12 : x12 - x17 ≤ 112) (g13 : x13 - x18 ≤ 113) (g14 : x14 - x19 ≤ 114) (g15 : x15 - x0 ≤ 115)
+    (g16 : x16 - x1 ≤ 116) (g17 : x17 - x2 ≤ 117) (g18 : x18 - x3 ≤ 118) (g19 : x19 - x4 ≤ 119)
+    : False := by
+  omega
@@ -0,0 +1,24 @@
+/-! Sequential and parallel `map`, `foldl` and sorting of an array of `n` pseudo-random numbers. -/
+
+def mkData (n : Nat) : Array Nat := Id.run do
+  let mut xs := Array.mkEmpty n
+  let mut x := 42
+  for _ in [0:n] do
+    x := (x * 1103515245 + 12345) % 2147483648
+    xs := xs.push x
+  return xs
+
+def work (x : Nat) : Nat := Id.run do
+  let mut h := x
+  for _ in [0:20] do
+    h := (h * 31 + 7) % 1000000007
+  return h
+
+def main (args : List String) : IO Unit := do
+  let n := args[0]!.toNat!
+  let par := args.getD 1 "par" == "par"
+  let xs := mkData n
+  let ys := if par then xs.parMap work else xs.map work
+  let sum := if par then ys.parFoldl (· + ·) (· + ·) 0 else ys.foldl (· + ·) 0
+  let sorted := if par then ys.parQsort (· < ·) else ys.qsort (· < ·)
+  IO.println (sum, sorted[n / 2]!)
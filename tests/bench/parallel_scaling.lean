@@ -0,0 +1,158 @@
+import Lean.Data.RBMap
+
+/-!
+Scaling of multi-threaded workloads over the number of task manager threads, as a counterpart to
+`binarytrees5_multicore.ml`. Unless `--run` is passed, the program runs itself with `LEAN_NUM_THREADS`
+set to 1, 2, 4, ... up to the given maximum and reports the wall-clock time and speedup of each run.
+The work is split into a fixed number of tasks, so every run does the same work.
+
+* `binarytrees`: allocating and checking trees in parallel, with some trees freed by the main thread
+* `rbmap`: building red-black maps from disjoint keys in parallel and merging them pairwise
+* `dag`: layers of tasks where each task depends on two tasks of the previous layer
+* `pipeline`: a chain of stages connected by channels, each stage transforming small lists
+-/
+
+open Lean
+
+def numChunks := 64
+
+def work (x : Nat) (n : Nat) : Nat := Id.run do
+  let mut h := x
+  for _ in [0:n] do
+    h := (h * 31 + 7) % 1000000007
+  return h
+
+namespace BinaryTrees
+
+inductive Tree
+  | nil
+  | node (l r : Tree)
+instance : Inhabited Tree := ⟨.nil⟩
+
+-- This function has an extra argument to suppress the
+-- common sub-expression elimination optimization
+partial def make' (n d : UInt32) : Tree :=
+  if d = 0 then .node .nil .nil
+  else .node (make' n (d - 1)) (make' (n + 1) (d - 1))
+
+def check : Tree → UInt32
+  | .nil => 0
+  | .node l r => 1 + check l + check r
+
+/-- Checks 16 trees of depth `d` and returns the sum together with another tree for the caller to free. -/
+def chunk (d : UInt32) (j : Nat) : UInt32 × Tree := Id.run do
+  let mut sum : UInt32 := 0
+  for i in [0:16] do
+    sum := sum + check (make' (j * 16 + i).toUInt32 d)
+  return (sum, make' j.toUInt32 d)
+
+def run (d : Nat) : IO Unit := do
+  let tasks := (List.range numChunks).map fun j => Task.spawn fun _ => chunk d.toUInt32 j
+  let mut sum : UInt32 := 0
+  for t in tasks do
+    let (s, tree) := t.get
+    sum := sum + s + check tree
+  IO.println s!"check: {sum}"
+
+end BinaryTrees
+
+namespace RBMapMerge
+
+abbrev Map := RBMap Nat Nat compare
+
+def chunk (n j : Nat) : Map := Id.run do
+  let mut m := {}
+  for i in [0:n / numChunks] do
+    let k := i * numChunks + j
+    m := m.insert k (work k 10)
+  return m
+
+def merge (a b : Map) : Map :=
+  b.fold (fun m k v => m.insert k v) a
+
+partial def mergeAll : List (Task Map) → Task Map
+  | []  => .pure {}
+  | [t] => t
+  | ts  => mergeAll (pairs ts)
+where
+  pairs : List (Task Map) → List (Task Map)
+    | a :: b :: ts => (a.bind fun a => b.map fun b => merge a b) :: pairs ts
+    | ts           => ts
+
+def run (n : Nat) : IO Unit := do
+  let tasks := (List.range numChunks).map fun j => Task.spawn fun _ => chunk n j
+  let m := (mergeAll tasks).get
+  IO.println s!"size: {m.size}, sum: {m.fold (fun s _ v => s + v) 0}"
+
+end RBMapMerge
+
+namespace Dag
+
+def run (layers : Nat) : IO Unit := do
+  let mut layer : Array (Task Nat) := (Array.range numChunks).map fun i => Task.spawn fun _ => work i 2000
+  for _ in [0:layers] do
+    layer := (Array.range numChunks).map fun i =>
+      (layer.getD i (.pure 0)).bind fun a =>
+        (layer.getD ((i + 1) % numChunks) (.pure 0)).map fun b => work (a + b) 2000
+  IO.println s!"sum: {layer.foldl (fun s t => s + t.get) 0}"
+
+end Dag
+
+namespace Pipeline
+
+def numStages := 8
+
+def stage (inp out : IO.Channel (List Nat)) : BaseIO (Task Unit) := do
+  let t ← inp.forAsync fun xs => out.send (xs.map (work · 20))
+  BaseIO.mapTask (fun _ => out.close) t
+
+def run (n : Nat) : IO Unit := do
+  let first : IO.Channel (List Nat) ← IO.Channel.new
+  let mut inp := first
+  for _ in [0:numStages] do
+    let out ← IO.Channel.new
+    discard <| stage inp out
+    inp := out
+  let sum ← IO.mkRef 0
+  let done ← inp.forAsync fun xs => sum.modify (· + xs.foldl (· + ·) 0)
+  for i in [0:n] do
+    first.send ((List.range 16).map (· + i))
+  first.close
+  IO.wait done
+  IO.println s!"sum: {← sum.get}"
+
+end Pipeline
+
+def runBench : String → Nat → IO Unit
+  | "binarytrees", n => BinaryTrees.run n
+  | "rbmap",       n => RBMapMerge.run n
+  | "dag",         n => Dag.run n
+  | "pipeline",    n => Pipeline.run n
+  | b,             _ => throw <| IO.userError s!"unknown benchmark '{b}'"
+
+def main (args : List String) : IO Unit := do
+  let bench := args[0]!
+  let n := args[1]!.toNat!
+  if args.getD 2 "" == "--run" then
+    runBench bench n
+    return
+  let maxThreads := (args.getD 2 "8").toNat!
+  let mut threads := 1
+  let mut base := 0.0
+  repeat
+    let startTime ← IO.monoNanosNow
+    let out ← IO.Process.output {
+      cmd := (← IO.appPath).toString
+      args := #[bench, toString n, "--run"]
+      env := #[("LEAN_NUM_THREADS", some (toString threads))] }
+    let endTime ← IO.monoNanosNow
+    if out.exitCode != 0 then
+      throw <| IO.userError s!"{bench} with {threads} threads failed: {out.stderr}"
+    let time := (endTime - startTime).toFloat / 1000000000.0
+    if threads == 1 then
+      base := time
+    IO.println s!"{bench} threads {threads}: {time}"
+    IO.println s!"{bench} speedup {threads}: {base / time}"
+    if threads ≥ maxThreads then
+      break
+    threads := min maxThreads (2 * threads)
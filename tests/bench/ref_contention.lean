@@ -0,0 +1,27 @@
+/-!
+Many tasks reading a shared `IO.Ref`, with one write every `writeEvery` reads using `modifyAtomic`.
+Readers of a multi-threaded ref do not wait for each other.
+-/
+
+def writeEvery := 100
+
+def worker (r : IO.Ref (Array Nat)) (n : Nat) : IO Nat := do
+  let mut sum := 0
+  for i in [0:n] do
+    if i % writeEvery == 0 then
+      r.modifyAtomic fun a => a.modify 0 (· + 1)
+    else
+      sum := sum + (← r.get).size
+  return sum
+
+def main : List String → IO UInt32
+  | [t, n] => do
+    let t := t.toNat!
+    let n := n.toNat!
+    let r ← IO.mkRef (Array.mkArray 16 0)
+    let tasks ← (List.range t).mapM fun _ => IO.asTask (worker r n) .dedicated
+    for task in tasks do
+      discard <| IO.ofExcept task.get
+    IO.println s!"writes: {(← r.get)[0]!}"
+    return 0
+  | _ => return 1
@@ -0,0 +1,277 @@
+/*
+Microbenchmarks of runtime primitives, to catch regressions in the C++ runtime independently of the
+compiler. Each benchmark is selected by name and repeats its operation `n` times.
+
+    leanc -O3 -DNDEBUG -std=c++17 -I../../src runtime_cpp.cpp -o runtime_cpp.out
+    ./runtime_cpp.out alloc 100000000
+*/
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <lean/lean.h>
+#include "runtime/compact.h"
+
+extern "C" void lean_initialize_runtime_module();
+extern "C" void lean_initialize_thread();
+extern "C" void lean_finalize_thread();
+
+/* `lean_alloc_small`/`lean_free_small` with a window of live objects of mixed sizes */
+static size_t bench_alloc(size_t n) {
+    constexpr size_t window = 256;
+    lean_object * live[window] = {};
+    for (size_t i = 0; i < n; i++) {
+        size_t j = i % window;
+        if (live[j])
+            lean_free_small_object(live[j]);
+        live[j] = lean_alloc_small_object(16 + 8 * (i % 8));
+    }
+    for (lean_object * o : live)
+        if (o) lean_free_small_object(o);
+    return n;
+}
+
+static lean_object * mk_pair(lean_object * a, lean_object * b) {
+    lean_object * r = lean_alloc_ctor(0, 2, 0);
+    lean_ctor_set(r, 0, a);
+    lean_ctor_set(r, 1, b);
+    return r;
+}
+
+/* Objects allocated by one thread and freed by another one */
+static size_t bench_xfree(size_t n) {
+    constexpr size_t batch = 1024;
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<std::vector<lean_object *>> queue;
+    bool done = false;
+    size_t freed = 0;
+    std::thread consumer([&]() {
+        lean_initialize_thread();
+        while (true) {
+            std::vector<lean_object *> objs;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cv.wait(lock, [&]() { return done || !queue.empty(); });
+                if (queue.empty())
+                    break;
+                objs = std::move(queue.front());
+                queue.pop_front();
+            }
+            cv.notify_all();
+            for (lean_object * o : objs)
+                lean_dec(o);
+            freed += objs.size();
+        }
+        lean_finalize_thread();
+    });
+    for (size_t i = 0; i < n; i += batch) {
+        std::vector<lean_object *> objs;
+        for (size_t j = 0; j < batch; j++)
+            objs.push_back(mk_pair(lean_box(i), lean_box(j)));
+        std::unique_lock<std::mutex> lock(mutex);
+        // bound the number of objects in flight
+        cv.wait(lock, [&]() { return queue.size() < 64; });
+        queue.push_back(std::move(objs));
+        cv.notify_all();
+    }
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        done = true;
+    }
+    cv.notify_all();
+    consumer.join();
+    return freed;
+}
+
+static lean_object * mk_tree(unsigned depth) {
+    if (depth == 0)
+        return lean_box(0);
+    return mk_pair(mk_tree(depth - 1), mk_tree(depth - 1));
+}
+
+/* `lean_mark_mt` on trees of 64K objects, including their construction and deletion */
+static size_t bench_mark_mt(size_t n) {
+    constexpr unsigned depth = 16;
+    size_t r = 0;
+    for (size_t i = 0; i < n; i += (size_t(1) << depth)) {
+        lean_object * t = mk_tree(depth);
+        lean_mark_mt(t);
+        r += lean_is_mt(t);
+        lean_dec(t);
+    }
+    return r;
+}
+
+static lean_object * task_fn(lean_object * i, lean_object *) {
+    return lean_box(lean_unbox(i) + 1);
+}
+
+/* `lean_task_spawn_core`/`lean_task_get` of trivial tasks, in batches */
+static size_t bench_task(size_t n) {
+    constexpr size_t batch = 1024;
+    lean_init_task_manager();
+    size_t r = 0;
+    std::vector<lean_object *> tasks;
+    for (size_t i = 0; i < n; i += batch) {
+        for (size_t j = 0; j < batch; j++) {
+            lean_object * c = lean_alloc_closure((void *)task_fn, 2, 1);
+            lean_closure_set(c, 0, lean_box(j));
+            tasks.push_back(lean_task_spawn_core(c, 0, false));
+        }
+        for (lean_object * t : tasks) {
+            r += lean_unbox(lean_task_get(t));
+            lean_dec(t);
+        }
+        tasks.clear();
+    }
+    return r;
+}
+
+/* `lean_st_ref_get` on a shared reference from several threads */
+static size_t bench_ref(size_t n) {
+    constexpr unsigned num_threads = 8;
+    lean_object * res = lean_st_mk_ref(lean_mk_string("shared"), lean_io_mk_world());
+    lean_object * ref = lean_io_result_get_value(res);
+    lean_inc(ref);
+    lean_dec(res);
+    lean_mark_mt(ref);
+    std::vector<std::thread> threads;
+    std::vector<size_t> sums(num_threads);
+    for (unsigned k = 0; k < num_threads; k++) {
+        threads.emplace_back([&, k]() {
+            lean_initialize_thread();
+            size_t sum = 0;
+            for (size_t i = 0; i < n / num_threads; i++) {
+                lean_object * r = lean_st_ref_get(ref, lean_io_mk_world());
+                sum += lean_string_size(lean_io_result_get_value(r));
+                lean_dec(r);
+            }
+            sums[k] = sum;
+            lean_finalize_thread();
+        });
+    }
+    for (std::thread & t : threads)
+        t.join();
+    lean_dec(ref);
+    size_t r = 0;
+    for (size_t s : sums)
+        r += s;
+    return r;
+}
+
+/* `compacted_region::read` of a region that has to be relocated, as when an .olean file cannot be
+   mapped at its base address */
+static size_t bench_compact(size_t n) {
+    constexpr size_t size = 100000;
+    lean_object * a = lean_mk_empty_array();
+    for (size_t i = 0; i < size; i++) {
+        lean_object * s = lean_mk_string("compacted string");
+        a = lean_array_push(a, i % 2 ? mk_pair(s, lean_box(i)) : s);
+    }
+    // objects are compacted for base address `nullptr`, so they are relocated by `read`
+    lean::object_compactor compactor;
+    compactor(a);
+    lean_dec(a);
+    size_t r = 0;
+    for (size_t i = 0; i < n; i += size) {
+        void * data = malloc(compactor.size());
+        memcpy(data, compactor.data(), compactor.size());
+        lean::compacted_region region(compactor.size(), data, nullptr, false, [=]() { free(data); });
+        r += lean_array_size(region.read());
+    }
+    return r;
+}
+
+/* UTF-8 iteration, `String.push`, `String.extract` and `String.append` */
+static size_t bench_string(size_t n) {
+    constexpr size_t size = 100000;
+    lean_object * s = lean_mk_string("");
+    for (size_t i = 0; i < size; i++)
+        s = lean_string_push(s, i % 3 ? 'a' + i % 26 : 0x3bb /* λ */);
+    size_t r = 0;
+    for (size_t i = 0; i < n; i += size) {
+        lean_object * pos   = lean_box(0);
+        lean_object * start = lean_box(0);
+        lean_object * acc   = lean_mk_string("");
+        for (size_t j = 0; j < size; j++) {
+            r += lean_string_utf8_get(s, pos);
+            lean_object * next = lean_string_utf8_next(s, pos);
+            lean_dec(pos);
+            pos = next;
+            if (j % 1000 == 999) {
+                lean_object * piece = lean_string_utf8_extract(s, start, pos);
+                acc = lean_string_append(acc, piece);
+                lean_dec(piece);
+                lean_dec(start);
+                lean_inc(pos);
+                start = pos;
+            }
+        }
+        r += lean_string_size(acc);
+        lean_dec(pos);
+        lean_dec(start);
+        lean_dec(acc);
+    }
+    lean_dec(s);
+    return r;
+}
+
+/* multiplication, remainder and addition of big numbers with a few limbs */
+static size_t bench_mpz(size_t n) {
+    lean_object * a = lean_cstr_to_nat("1234567890123456789012345678901234567890");
+    lean_object * b = lean_cstr_to_nat("9876543210987654321098765432109876543210987654321");
+    lean_object * m = lean_cstr_to_nat("340282366920938463463374607431768211297");
+    size_t r = 0;
+    for (size_t i = 0; i < n; i++) {
+        lean_object * p = lean_nat_mul(a, b);
+        lean_object * q = lean_nat_mod(p, m);
+        lean_object * s = lean_nat_add(q, a);
+        r += lean_nat_dec_lt(s, b);
+        lean_dec(p);
+        lean_dec(q);
+        lean_dec(s);
+    }
+    lean_dec(a);
+    lean_dec(b);
+    lean_dec(m);
+    return r;
+}
+
+struct bench {
+    char const * m_name;
+    size_t (*m_fn)(size_t);
+};
+
+static bench const g_benches[] = {
+    {"alloc",   bench_alloc},
+    {"xfree",   bench_xfree},
+    {"mark_mt", bench_mark_mt},
+    {"task",    bench_task},
+    {"ref",     bench_ref},
+    {"compact", bench_compact},
+    {"string",  bench_string},
+    {"mpz",     bench_mpz},
+};
+
+int main(int argc, char ** argv) {
+    if (argc != 3) {
+        std::cout << "usage: runtime_cpp.out <benchmark> <n>\n";
+        return 1;
+    }
+    lean_initialize_runtime_module();
+    lean_io_mark_end_initialization();
+    size_t n = strtoull(argv[2], nullptr, 10);
+    for (bench const & b : g_benches) {
+        if (strcmp(b.m_name, argv[1]) == 0) {
+            std::cout << b.m_name << ": " << b.m_fn(n) << "\n";
+            return 0;
+        }
+    }
+    std::cout << "unknown benchmark '" << argv[1] << "'\n";
+    return 1;
+}
@@ -0,0 +1,39 @@
+/-!
+Bulk operations on `FloatArray` and `ByteArray` (`dot`, `add`, `scale`, `xor`, `find?`, `==`),
+repeated `iters` times on arrays of `n` elements.
+-/
+
+def mkFloats (n : Nat) (seed : Nat) : FloatArray := Id.run do
+  let mut a := FloatArray.mkEmpty n
+  for i in [0:n] do
+    a := a.push ((i * seed % 1000).toFloat / 1000)
+  return a
+
+def mkBytes (n : Nat) (seed : Nat) : ByteArray := Id.run do
+  let mut a := ByteArray.mkEmpty n
+  for i in [0:n] do
+    a := a.push (i * seed % 255).toUInt8
+  return a
+
+def main : List String → IO UInt32
+  | [n, iters] => do
+    let n := n.toNat!
+    let iters := iters.toNat!
+    let mut x := mkFloats n 7
+    let y := mkFloats n 13
+    let mut acc := 0.0
+    for _ in [0:iters] do
+      acc := acc + x.dot y
+      x := (x.add y).scale 0.5
+    let mut a := mkBytes n 3
+    let b := mkBytes n 5
+    let mut found := 0
+    for _ in [0:iters] do
+      a := a.xor b
+      if let some i := a.find? 255 then
+        found := found + i
+      if a == b then
+        found := found + 1
+    IO.println s!"{acc} {x.sum} {x.maximum} {found}"
+    return 0
+  | _ => return 1
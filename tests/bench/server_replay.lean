@@ -0,0 +1,100 @@
+import Lean.Data.Lsp
+open IO Lean Lsp JsonRpc
+
+/-!
+Replays a recorded LSP session against `lean --server` and reports latency percentiles per request
+method as well as the resident set size of the file workers over time.
+
+The session is a file of client messages in wire format, such as the `wdIn.txt` log written by the
+server when `LEAN_SERVER_LOG_DIR` is set. Notifications (in particular bursts of `didChange`) are sent
+without waiting, while each request is timed until its response arrives before the replay continues.
+The replay stops at the `shutdown` request. `textDocument/waitForDiagnostics` requests are reported
+as `diagnostics`.
+-/
+
+/-- Resident set size of process `pid` in MB, from `/proc/<pid>/statm` (Linux only, assuming 4KB pages). -/
+def rss (pid : String) : IO Float := do
+  let statm ← FS.readFile s!"/proc/{pid}/statm"
+  let pages := (statm.splitOn " ")[1]!.toNat!
+  return (pages * 4096).toFloat / 1048576.0
+
+/-- Pids of the children of `pid`, by scanning `/proc/<pid>/stat` for the parent pid (Linux only). -/
+def childPids (pid : String) : IO (Array String) := do
+  let mut pids := #[]
+  for entry in ← System.FilePath.readDir "/proc" do
+    if entry.fileName.all Char.isDigit then
+      try
+        let stat ← FS.readFile (entry.path / "stat")
+        -- the command name in parentheses may contain spaces, the parent pid is the second field after it
+        let fields := (stat.splitOn ") ").getLast!.splitOn " "
+        if fields[1]! == pid then
+          pids := pids.push entry.fileName
+      catch _ => pure ()
+  return pids
+
+/-- Total resident set size of the file workers, i.e. the children of the server process, in MB. -/
+def workersRss : IO Float := do
+  try
+    let mut total := 0.0
+    for server in ← childPids (toString (← IO.Process.getPID)) do
+      for worker in ← childPids server do
+        total := total + (← rss worker)
+    return total
+  catch _ => return 0.0
+
+def label (method : String) : String :=
+  if method == "textDocument/waitForDiagnostics" then "diagnostics"
+  else method.replace "textDocument/" "" |>.replace "/" "_"
+
+/-- Nearest-rank percentile `p` of the sorted array `xs`. -/
+def percentile (xs : Array Float) (p : Nat) : Float :=
+  let rank := (p * xs.size + 99) / 100
+  xs[rank - 1]!
+
+/-- Waits for the response to request `id`, ignoring notifications and server-to-client requests. -/
+partial def waitForResponse (id : RequestID) : Ipc.IpcM Unit := do
+  match ← Ipc.readMessage with
+  | .response id' _ | .responseError id' .. => if id' != id then waitForResponse id
+  | _ => waitForResponse id
+
+def main (args : List String) : IO Unit := do
+  let log ← FS.Handle.mk (args.headD "server_replay.log") .read
+  let log := FS.Stream.ofHandle log
+  Ipc.runWith (← IO.appPath) #["--server"] do
+    let hIn ← Ipc.stdin
+    let startTime ← IO.monoNanosNow
+    let mut latencies : RBMap String (Array Float) compare := {}
+    let mut rssSamples : Array (Float × Float) := #[]
+    repeat
+      let msg ← log.readLspMessage
+      match msg with
+      | .request id "shutdown" _ =>
+        hIn.writeLspMessage msg
+        hIn.flush
+        waitForResponse id
+        Ipc.writeNotification ⟨"exit", Json.null⟩
+        discard Ipc.waitForExit
+        break
+      | .request id method _ =>
+        let t0 ← IO.monoNanosNow
+        hIn.writeLspMessage msg
+        hIn.flush
+        waitForResponse id
+        let t1 ← IO.monoNanosNow
+        let ms := (t1 - t0).toFloat / 1000000.0
+        latencies := latencies.insert (label method) ((latencies.findD (label method) #[]).push ms)
+        rssSamples := rssSamples.push ((t1 - startTime).toFloat / 1000000000.0, ← workersRss)
+      | _ =>
+        hIn.writeLspMessage msg
+        hIn.flush
+    for (method, ms) in latencies do
+      let ms := ms.qsort (· < ·)
+      IO.println s!"{method} count: {ms.size}"
+      for p in [50, 90, 99] do
+        IO.println s!"{method} p{p}: {percentile ms p}"
+    let rssMax := rssSamples.foldl (fun m (_, r) => max m r) 0.0
+    IO.println s!"worker rss max: {rssMax}"
+    IO.println s!"worker rss final: {rssSamples.back?.map (·.2) |>.getD 0.0}"
+    -- the full time series is not a metric but useful for inspecting memory growth over the session
+    FS.writeFile "server_replay.rss.csv" <| "\n".intercalate <|
+      rssSamples.toList.map fun (t, r) => s!"{t},{r}"
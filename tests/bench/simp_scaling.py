@@ -0,0 +1,53 @@
+#!/usr/bin/env python3
+"""Elaborates the `tests/simpperf` files of all sizes with `lean --stats` and reports how the simp cache,
+rewrite attempts, discrimination tree lookups, `isDefEq` and `instantiateMVars` counters scale with the
+problem size. Besides the values per file, the exponent of a power law fitted to each counter is reported,
+so that a newly quadratic behavior shows up as a change of exponent rather than only as a slower total."""
+
+import math
+import re
+import subprocess
+import sys
+import time
+
+SIZES = [500, 1000, 1500, 2000, 2500, 3000]
+STATS = ["simp", "simpRewrite", "DiscrTree", "isDefEq", "instantiateMVars"]
+
+def run(file):
+    start = time.monotonic()
+    out = subprocess.run(["lean", "--stats", "-DmaxRecDepth=100000", file],
+                         check=True, capture_output=True, text=True).stdout
+    total = time.monotonic() - start
+    stats = {}
+    for line in out.splitlines():
+        # name, lookups, hits, misses, hit rate, time
+        if m := re.match(r"\s+(\w+)\s+(\d+)\s+(\d+)\s+(\d+)\s+[\d.]+%\s+([\d.]+)s", line):
+            stats[m[1]] = {"lookups": int(m[2]), "hits": int(m[3]), "time": float(m[5])}
+    return total, stats
+
+def exponent(values):
+    """Least-squares slope of `log value` over `log size`."""
+    points = [(math.log(n), math.log(v)) for n, v in zip(SIZES, values) if v > 0]
+    if len(points) < 2:
+        return 0.0
+    mx = sum(x for x, _ in points) / len(points)
+    my = sum(y for _, y in points) / len(points)
+    return sum((x - mx) * (y - my) for x, y in points) / sum((x - mx) ** 2 for x, _ in points)
+
+def main(dir):
+    for kind in ["pre", "simp"]:
+        series = {}
+        for n in SIZES:
+            total, stats = run(f"{dir}/{kind}{n}.lean")
+            print(f"{kind}{n} time: {total:f}")
+            series.setdefault("time", []).append(total)
+            for stat in STATS:
+                s = stats.get(stat, {"lookups": 0, "hits": 0, "time": 0.0})
+                for metric in ["lookups", "hits", "time"]:
+                    print(f"{kind}{n} {stat} {metric}: {s[metric]}")
+                    series.setdefault(f"{stat} {metric}", []).append(s[metric])
+        for name, values in series.items():
+            print(f"{kind} {name} exponent: {exponent(values):f}")
+
+if __name__ == "__main__":
+    main(sys.argv[1] if len(sys.argv) > 1 else "../simpperf")
@@ -0,0 +1,21 @@
+/-! Array accesses whose bounds checks are removed because of an enclosing comparison with the size. -/
+
+def sumGuarded (a : Array Nat) : Nat := Id.run do
+  let mut s := 0
+  for i in [0:a.size + 2] do
+    if i < a.size then
+      s := s + a[i]!
+  return s
+
+def doubleGuarded (a : Array Nat) (i : Nat) : Array Nat :=
+  if a.size ≤ i then a
+  else
+    let a := a.set! i (2 * a[i]!)
+    a.set! i (a[i]! + 1)
+
+def main : IO Unit := do
+  let a := #[1, 2, 3, 4]
+  IO.println (sumGuarded a)
+  IO.println (doubleGuarded a 2)
+  IO.println (doubleGuarded a 4)
+  IO.println (a[7]?, a.getD 9 0)
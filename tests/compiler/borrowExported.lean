@@ -0,0 +1,18 @@
+set_option compiler.borrow_exported true
+
+/-! `@[export]` functions are split into an owned wrapper and a body with inferred borrowed parameters. -/
+
+@[export lean_test_count_spaces]
+def countSpaces (s : String) (acc : Nat) : Nat :=
+  s.foldl (fun n c => if c == ' ' then n + 1 else n) acc
+
+@[export lean_test_sum_lengths]
+def sumLengths (xs : List String) : Nat :=
+  match xs with
+  | []      => 0
+  | x :: xs => countSpaces x x.length + sumLengths xs
+
+def main : IO Unit := do
+  let xs := ["a b", "c d e", ""]
+  IO.println (sumLengths xs)
+  IO.println (xs.map (countSpaces · 0))
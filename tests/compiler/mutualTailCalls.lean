@@ -0,0 +1,29 @@
+/-! Mutually tail-recursive functions must run in constant stack space. -/
+
+mutual
+partial def isEven (n : Nat) : Bool :=
+  if n == 0 then true else isOdd (n - 1)
+
+partial def isOdd (n : Nat) : Bool :=
+  if n == 0 then false else isEven (n - 1)
+end
+
+-- a small state machine counting the `a`s directly followed by `b`
+mutual
+partial def scanStart (s : String) (i : String.Pos) (acc : Nat) : Nat :=
+  if s.atEnd i then acc
+  else if s.get i == 'a' then scanA s (s.next i) acc
+  else scanStart s (s.next i) acc
+
+partial def scanA (s : String) (i : String.Pos) (acc : Nat) : Nat :=
+  if s.atEnd i then acc
+  else match s.get i with
+    | 'b' => scanStart s (s.next i) (acc + 1)
+    | 'a' => scanA s (s.next i) acc
+    | _   => scanStart s (s.next i) acc
+end
+
+def main : IO Unit := do
+  IO.println (isEven 10000000, isOdd 10000001, isEven 7)
+  let s := String.join (List.replicate 1000000 "abacab")
+  IO.println (scanStart s 0 0)
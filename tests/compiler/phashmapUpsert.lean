@@ -0,0 +1,25 @@
+import Lean.Data.PersistentHashMap
+open Lean
+
+abbrev Map := PersistentHashMap Nat (Array Nat)
+
+def addRef (m : Map) (k v : Nat) : Map :=
+  m.insert k ((m.find? k |>.getD #[]).push v)
+
+def add (m : Map) (k v : Nat) : Map :=
+  m.upsert k fun
+    | none    => #[v]
+    | some vs => vs.push v
+
+def main : IO Unit := do
+  let mut m₁ : Map := {}
+  let mut m₂ : Map := {}
+  -- keys that are multiples of `32^5` share their first five levels and end up in collision nodes
+  for i in [0:5000] do
+    let k := if i % 7 == 0 then (i % 5) * 32^5 else i % 1000
+    m₁ := addRef m₁ k i
+    m₂ := add m₂ k i
+  let keys := (List.range 1000) ++ (List.range 5).map (· * 32^5)
+  IO.println (keys.all fun k => m₁.find? k == m₂.find? k)
+  IO.println (m₂.find? 3)
+  IO.println (m₂.find? (2 * 32^5) |>.map (·.size))
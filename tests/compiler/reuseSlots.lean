@@ -0,0 +1,29 @@
+set_option compiler.reuse_slots true
+
+/-!
+`Tree.flag` (one object field and a `Bool`) and `Tree.node` (two object fields) are allocated in the
+same small object slot, so `unflag` reuses the cells of the input tree.
+-/
+
+inductive Tree where
+  | leaf
+  | flag (t : Tree) (b : Bool)
+  | node (l r : Tree)
+
+def Tree.unflag : Tree → Tree
+  | .leaf     => .leaf
+  | .flag t b => .node (if b then .leaf else t.unflag) t.unflag
+  | .node l r => .node l.unflag r.unflag
+
+def Tree.toString : Tree → String
+  | .leaf     => "."
+  | .flag t b => s!"({t.toString} {b})"
+  | .node l r => s!"({l.toString} {r.toString})"
+
+def mkTree : Nat → Tree
+  | 0     => .leaf
+  | n + 1 => if n % 2 == 0 then .flag (mkTree n) (n % 3 == 0) else .node (mkTree n) .leaf
+
+def main : IO Unit := do
+  IO.println (mkTree 5).toString
+  IO.println (mkTree 5).unflag.toString
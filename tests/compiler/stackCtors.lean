@@ -0,0 +1,19 @@
+/-! Constructor objects that do not escape may be allocated on the stack; their fields must still be released. -/
+
+def pairs (n : Nat) : Nat := Id.run do
+  let mut acc := 0
+  for i in [0:n] do
+    let p := (toString i, [i, i + 1])
+    match p with
+    | (s, l) => acc := acc + s.length + l.length
+  return acc
+
+def firstSome (xs : Array (Option String)) : String := Id.run do
+  for x in xs do
+    if let some s := x then
+      return s
+  return ""
+
+def main : IO Unit := do
+  IO.println (pairs 1000)
+  IO.println (firstSome #[none, some "a", some "b"])
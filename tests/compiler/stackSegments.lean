@@ -0,0 +1,8 @@
+def sumList : List Nat → Nat
+  | []      => 0
+  | x :: xs => x + sumList xs
+
+-- deeper than the 8MB stack of the main thread and of task threads
+def main : IO Unit := do
+  IO.println (sumList (List.replicate 1000000 1))
+  IO.println (Task.spawn fun _ => sumList (List.replicate 1000001 1)).get
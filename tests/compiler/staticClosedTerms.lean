@@ -0,0 +1,21 @@
+/-! Closed terms emitted as static data must behave like the ones built at initialization. -/
+
+def names : List Lean.Name := [`foo, `Lean.Meta.whnf, .num `x 3, .anonymous]
+
+def strs : List String := ["", "hello", "λ∀ \"quoted\"\n"]
+
+def pairs : List (Option String × Bool) := [(some "a", true), (none, false)]
+
+/-- Builds a copy of `n` at runtime. -/
+def rebuild : Lean.Name → String → Lean.Name
+  | .anonymous, _ => .anonymous
+  | .str p s, e   => .str (rebuild p e) (s ++ e)
+  | .num p k, e   => .num (rebuild p e) (k + e.length)
+
+def main (args : List String) : IO Unit := do
+  let e := args.headD ""
+  IO.println names
+  IO.println (names.map fun n => rebuild n e == n && (rebuild n e).hash == n.hash)
+  IO.println (strs.map (·.length))
+  IO.println (strs.map (· ++ "!"))
+  IO.println pairs
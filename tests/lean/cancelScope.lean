@@ -0,0 +1,48 @@
+-- not in the run/ directory because then it would be run with -j0
+
+/-- Spins until the current task is canceled, returning the number of spins. -/
+partial def spin (n : Nat := 0) : BaseIO Nat := do
+  if (← IO.checkCanceled) then return n
+  IO.sleep 1
+  spin (n + 1)
+
+/-- Spawns a task that spawns `spin` and waits for it, so `spin` is a grandchild of the scope. -/
+def spinNested : BaseIO (Task (Except IO.Error Nat)) :=
+  IO.asTask (prio := .dedicated) do
+    let t ← IO.asTask (prio := .dedicated) (spin 0)
+    IO.ofExcept (← IO.wait t)
+
+-- canceling a scope reaches the tasks spawned by its tasks
+/-- info: (false, true, true) -/
+#guard_msgs in
+#eval show IO _ from do
+  let s ← IO.CancelScope.new
+  let t ← s.run spinNested
+  let before ← s.isCanceled
+  s.cancel
+  discard <| IO.wait t
+  return (before, ← s.isCanceled, (← IO.hasFinished t))
+
+-- nested scopes are canceled with their parent, but not the other way around
+/-- info: (true, true, false) -/
+#guard_msgs in
+#eval show IO _ from do
+  let outer ← IO.CancelScope.new
+  let inner ← outer.run IO.CancelScope.new
+  let other ← IO.CancelScope.new
+  let t ← inner.run spinNested
+  outer.cancel
+  discard <| IO.wait t
+  return (← outer.isCanceled, ← inner.isCanceled, ← other.isCanceled)
+
+-- `withCancelScope` cancels tasks that outlive it, and tasks outside of the scope keep running
+/-- info: (true, false) -/
+#guard_msgs in
+#eval show IO _ from do
+  let outside ← IO.asTask (prio := .dedicated) (spin 0)
+  let t ← IO.withCancelScope fun _ => spinNested
+  discard <| IO.wait t
+  let outsideRunning := !(← IO.hasFinished outside)
+  IO.cancel outside
+  discard <| IO.wait outside
+  return (outsideRunning, ← IO.checkCancelScope)
@@ -0,0 +1,54 @@
+-- not in the run/ directory because then it would be run with -j0
+
+/-!
+Several producers and consumers share a channel. More values are sent than fit into the ring buffer
+of the runtime channel, so some of them go through its overflow queue.
+-/
+
+def producer (ch : IO.Channel (Nat × Nat)) (p n : Nat) : BaseIO Unit := do
+  for i in [0:n] do
+    ch.send (p, i)
+
+/-- Receives until the channel is closed, checking that the values of each producer arrive in order. -/
+partial def consumer (ch : IO.Channel (Nat × Nat)) (numProducers : Nat) : BaseIO (Nat × Bool) :=
+  go (mkArray numProducers 0) 0 true
+where
+  go (next : Array Nat) (count : Nat) (ok : Bool) : BaseIO (Nat × Bool) := do
+    match ← ch.sync.recv? with
+    | none => return (count, ok)
+    | some (p, i) => go (next.set! p (i + 1)) (count + 1) (ok && next[p]! ≤ i)
+
+def test (numProducers numConsumers n : Nat) : IO (Nat × Bool) := do
+  let ch ← IO.Channel.new
+  let consumers ← (List.range numConsumers).mapM fun _ =>
+    IO.asTask (prio := .dedicated) (consumer ch numProducers)
+  let producers ← (List.range numProducers).mapM fun p =>
+    IO.asTask (prio := .dedicated) (producer ch p n)
+  for t in producers do
+    discard <| IO.wait t
+  ch.close
+  let mut count := 0
+  let mut ok := true
+  for t in consumers do
+    let (c, o) ← IO.ofExcept (← IO.wait t)
+    count := count + c
+    ok := ok && o
+  return (count, ok)
+
+/-- info: (40000, true) -/
+#guard_msgs in
+#eval test 4 1 10000
+
+/-- info: 40000 -/
+#guard_msgs in
+#eval return (← test 4 3 10000).1
+
+/-- info: (#[1, 2, 3], none) -/
+#guard_msgs in
+#eval show IO _ from do
+  let ch ← IO.Channel.new
+  ch.send 1; ch.send 2; ch.send 3
+  let all ← ch.recvAllCurrent
+  ch.close
+  ch.send 4
+  return (all, ← IO.wait (← ch.recv?))
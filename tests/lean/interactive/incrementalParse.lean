@@ -0,0 +1,26 @@
+/-!
+Commands following an edit are not parsed again if the parser context is unchanged; their reused
+syntax must be moved to the new input.
+-/
+-- RESET
+def a := 1
+       --^ sync
+       --^ insert: "\n  "
+       --^ collectDiagnostics
+#check (b : Nat)
+
+/-! Edit inside a command, the following command is reused -/
+-- RESET
+#check (c : Nat)
+       --^ sync
+       --^ insert: "c"
+       --^ collectDiagnostics
+#check (d : Nat)
+
+/-! Edit after a command -/
+-- RESET
+#check (e : Nat)
+#check (f : Nat)
+       --^ sync
+       --^ change: "f" "g"
+       --^ collectDiagnostics
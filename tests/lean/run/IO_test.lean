@@ -136,3 +136,42 @@ check_eq "2" [] ys.toList
 
 #guard_msgs in
 #eval test4
+
+def test5 : IO Unit := do
+let fn5 := "foo5.txt"
+withFile fn5 Mode.write fun h => h.write ⟨#[1,2,3,4,5,6,7]⟩
+withFile fn5 Mode.read fun h => do
+  let buf ← h.readInto .empty 3
+  check_eq "1" [1,2,3] buf.toList
+  let buf ← h.readInto buf 3
+  check_eq "2" [4,5,6] buf.toList
+  let buf ← h.readInto buf 3
+  check_eq "3" [7] buf.toList
+  let buf ← h.readInto buf 3
+  check_eq "4" [] buf.toList
+withFile fn5 Mode.read fun h => do
+  let s ← Stream.ofHandleReusing h
+  let xs ← s.read 4
+  let ys ← s.read 4
+  check_eq "5" [1,2,3,4] xs.toList
+  check_eq "6" [5,6,7] ys.toList
+
+#guard_msgs in
+#eval test5
+
+def test6 : IO Unit := do
+let fn6 := "foo6.txt"
+withFile fn6 Mode.write fun h => h.write ⟨#[1,2,3,4,5,6,7]⟩
+let m ← MappedFile.mk fn6
+check_eq "1" 7 m.size
+check_eq "2" 4 (m.get 3)
+check_eq "3" 0 (m.get 7)
+check_eq "4" [3,4,5] (m.extract 2 5).toList
+check_eq "5" [6,7] (m.extract 5 100).toList
+check_eq "6" [] (m.extract 5 2).toList
+check_eq "7" [1,2,3,4,5,6,7] m.toByteArray.toList
+withFile fn6 Mode.write fun _ => pure ()
+check_eq "8" 0 (← MappedFile.mk fn6).size
+
+#guard_msgs in
+#eval test6
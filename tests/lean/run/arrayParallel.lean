@@ -0,0 +1,27 @@
+def xs : Array Nat := (Array.range 10000).map fun i => (i * 7919) % 10007
+
+#guard xs.parMap (· * 2) (grain := 100) == xs.map (· * 2)
+#guard (#[] : Array Nat).parMap (· + 1) == #[]
+#guard xs.parFoldl (· + ·) (· + ·) 0 (grain := 333) == xs.foldl (· + ·) 0
+#guard xs.parQsort (· < ·) (grain := 64) == xs.qsort (· < ·)
+#guard (xs.parQsort (· < ·) (grain := 10000)) == xs.qsort (· < ·)
+#guard Array.mergeSorted #[1, 3, 5] #[2, 3, 4, 6] (· < ·) == #[1, 2, 3, 3, 4, 5, 6]
+
+#guard (((Array.range 1000).map (fun i => (i % 3, i))).parQsort (·.1 < ·.1) (grain := 10)).map (·.1) ==
+  ((Array.range 1000).map (· % 3)).qsort (· < ·)
+
+#guard (Array.range 1000).parQsort (· > ·) (grain := 7) == (Array.range 1000).reverse
+
+def numEven : Nat := xs.foldl (fun n x => if x % 2 == 0 then n + 1 else n) 0
+
+/-- info: true -/
+#guard_msgs in
+#eval show IO Bool from do
+  let r ← IO.mkRef 0
+  xs.parForM (grain := 100) fun x => if x % 2 == 0 then r.modify (· + 1) else pure ()
+  return (← r.get) == numEven
+
+/-- error: 3 -/
+#guard_msgs in
+#eval (#[1, 2, 3, 4, 5] : Array Nat).parForM (grain := 1) fun x =>
+  if x ≥ 3 then throw (IO.userError (toString x)) else pure ()
@@ -0,0 +1,5 @@
+#guard (toString (7 ^ 50000)).length == 42255
+#guard (toString (7 ^ 50000)).toNat! == 7 ^ 50000
+#guard toString (10 ^ 3000) == "1" ++ "".pushn '0' 3000
+#guard toString (10 ^ 3000 - 1) == "".pushn '9' 3000
+#guard toString (-(2 ^ 10001 : Int)) == "-" ++ toString (2 ^ 10001)
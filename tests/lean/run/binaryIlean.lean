@@ -0,0 +1,52 @@
+import Lean.Server.References
+open Lean Lean.Server Lean.Lsp
+
+def r (l c₁ c₂ : Nat) : Lsp.Range := ⟨⟨l, c₁⟩, ⟨l, c₂⟩⟩
+
+def parent : RefInfo.ParentDecl := { name := "Foo.bar", range := r 3 0 20, selectionRange := r 3 4 11 }
+
+def refs : ModuleRefs := Std.HashMap.empty
+  |>.insert (.const "Foo" "Foo.bar")
+    { definition? := some ⟨r 3 4 11, none⟩, usages := #[⟨r 7 2 9, some parent⟩, ⟨r 8 2 9, none⟩] }
+  |>.insert (.const "Init" "Nat")
+    { definition? := none, usages := #[⟨r 3 14 17, some parent⟩] }
+  |>.insert (.const "Foo" "Foo.baz")
+    { definition? := some ⟨r 5 4 11, none⟩, usages := #[] }
+  |>.insert (.fvar "Foo" "_uniq.12")
+    { definition? := some ⟨r 3 12 13, some parent⟩, usages := #[⟨r 3 18 19, some parent⟩] }
+
+def infoJson (info? : Option RefInfo) : String :=
+  (info?.map (toJson · |>.compress)).getD "none"
+
+/-- info: [] -/
+#guard_msgs in
+#eval show IO (List String) from do
+  let mut failed := []
+  let binPath : System.FilePath := "binaryIlean.bin.ilean.tmp"
+  IO.FS.writeBinFile binPath (BinaryIlean.encode `Foo refs)
+  let some ilean ← BinaryIlean.load? binPath
+    | return ["load?"]
+  unless ilean.module == `Foo && ilean.numIdents == 4 do
+    failed := failed ++ ["header"]
+  for (ident, info) in refs.toList do
+    unless infoJson (ilean.get? ident) == infoJson (some info) do
+      failed := failed ++ [s!"get? {(toJson ident).compress}"]
+  unless (ilean.get? (.const "Foo" "Foo.qux")).isNone do
+    failed := failed ++ ["get? missing"]
+  unless ilean.toModuleRefs.size == 4 do
+    failed := failed ++ ["toModuleRefs"]
+  let defs := ilean.foldDefinitions (init := #[]) fun acc name range => acc.push (name, range)
+  unless defs == #[("Foo.bar", r 3 4 11), ("Foo.baz", r 5 4 11)] do
+    failed := failed ++ ["foldDefinitions"]
+  -- JSON `.ilean` files are not mistaken for binary ones
+  let jsonPath : System.FilePath := "binaryIlean.json.ilean.tmp"
+  IO.FS.writeFile jsonPath (toJson { module := `Foo, references := refs : Ilean }).compress
+  if (← BinaryIlean.load? jsonPath).isSome then
+    failed := failed ++ ["load? JSON"]
+  for path in [binPath, jsonPath] do
+    let ilean ← Ilean.load path
+    for (ident, info) in ilean.references.toList do
+      unless infoJson (refs.get? ident) == infoJson (some info) do
+        failed := failed ++ [s!"Ilean.load {path}"]
+  IO.FS.removeFile jsonPath
+  return failed
@@ -0,0 +1,20 @@
+import Lean.Elab.Tactic.BVDecide.Frontend.CNF
+import Std.Tactic.BVDecide.Bitblast
+
+open Std.Sat Std.Tactic.BVDecide Lean.Elab.Tactic.BVDecide.Frontend
+
+/-!
+`toCNFParallel` must produce exactly the CNF of `AIG.toCNF`, independently of the chunk size.
+-/
+
+def mulComm (w : Nat) : BVLogicalExpr :=
+  .literal (.bin (w := w) (.bin (.var 0) .mul (.var 1)) .eq (.bin (.var 1) .mul (.var 0)))
+
+def addUlt (w : Nat) : BVLogicalExpr :=
+  .literal (.bin (w := w) (.bin (.var 0) .add (.const 1#w)) .ult (.var 0))
+
+/-- info: true -/
+#guard_msgs in
+#eval [mulComm 8, addUlt 16, .gate .and (mulComm 4) (.not (addUlt 4)), .const true].all fun e =>
+  let entry := e.bitblast.relabelNat
+  [1, 7, 100, 65536].all fun chunkSize => toCNFParallel entry chunkSize == AIG.toCNF entry
@@ -0,0 +1,29 @@
+import Std.Data.ConcurrentHashMap
+open Std
+
+/-- Returns whether every lookup returned the expected value. -/
+def fill (m : ConcurrentHashMap Nat String) (calls : IO.Ref Nat) (n : Nat) : IO Bool := do
+  let mut ok := true
+  for i in [0:n] do
+    let s ← m.computeIfAbsent i fun _ => do
+      calls.modifyAtomic (· + 1)
+      return toString i
+    ok := ok && s == toString i
+  return ok
+
+def test : IO (Bool × Bool × Bool × Bool × Bool × Nat × Bool × Bool) := do
+  let m : ConcurrentHashMap Nat String ← ConcurrentHashMap.new
+  let r₁ := (← m.find? 1).isNone
+  let r₂ := (← m.insertIfAbsent 1 "one").isNone
+  let r₃ := (← m.insertIfAbsent 1 "uno") == some "one"
+  let r₄ := (← m.find? 1) == some "one"
+  let calls ← IO.mkRef 0
+  let tasks ← (List.range 8).mapM fun _ => IO.asTask (fill m calls 1000) .dedicated
+  let mut filled := true
+  for t in tasks do
+    filled := filled && (← IO.ofExcept t.get)
+  return (r₁, r₂, r₃, r₄, filled, ← m.size, (← m.find? 1) == some "one", (← calls.get) ≥ 999)
+
+/-- info: (true, true, true, true, true, 1000, true, true) -/
+#guard_msgs in
+#eval test
@@ -0,0 +1,12 @@
+import Lean
+open Lean Meta
+
+/-- info: true -/
+#guard_msgs in
+#eval show MetaM Bool from do
+  let s ← getSimpTheorems
+  let d : SimpTheoremTree := s.post.fold (init := {}) fun d keys v => d.insertCore keys v
+  let e ← mkAppM ``HAdd.hAdd #[mkNatLit 0, mkNatLit 1]
+  let names (d : SimpTheoremTree) : MetaM (Array Name) := do
+    return (← d.getMatch e {}).map (·.origin.key)
+  return d.compact.size == d.size && (← names d.compact) == (← names d)
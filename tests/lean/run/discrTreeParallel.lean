@@ -0,0 +1,19 @@
+import Lean
+open Lean Meta
+
+/-!
+Building a discrimination tree in parallel with `DiscrTree.insertParallel` gives the same tree as
+inserting the entries in order.
+-/
+
+/-- info: true -/
+#guard_msgs in
+#eval show MetaM Bool from do
+  let s ← getSimpTheorems
+  let entries := s.post.toArray
+  let seq : SimpTheoremTree := entries.foldl (init := {}) fun d (keys, v) => d.insertCore keys v
+  let groups := (List.range (entries.size / 37 + 1)).toArray.map fun i =>
+    entries.extract (i * 37) ((i + 1) * 37)
+  let par := DiscrTree.empty.insertParallel groups (entriesPerTask := 100)
+  let key (d : SimpTheoremTree) := d.toArray.map fun (keys, v) => (keys, v.origin.key)
+  return key par == key seq && par.size == entries.size
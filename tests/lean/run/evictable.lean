@@ -0,0 +1,20 @@
+import Lean.Language.Basic
+open Lean Language
+
+/--
+info: 1
+some 1
+none
+2
+some 2
+-/
+#guard_msgs in
+#eval show IO Unit from do
+  let counter ← IO.mkRef 1
+  let e ← Evictable.new (1 : Nat) (counter.modifyGet fun n => (n + 1, n + 1))
+  IO.println e.get
+  IO.println (repr (← e.peek?))
+  e.evict
+  IO.println (repr (← e.peek?))
+  IO.println (← e.getIO)
+  IO.println (repr (← e.peek?))
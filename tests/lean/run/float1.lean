@@ -8,10 +8,10 @@ IO.println ((2 : Float) ^ (200 : Float));
 pure ()
 
 /--
-info: 0.909297
--0.416147
-1.414214
-1606938044258990275541962092341162602522202993782792835301376.000000
+info: 0.9092974268256817
+-0.4161468365471424
+1.4142135623730951
+1.6069380442589903e60
 -/
 #guard_msgs in
 #eval main
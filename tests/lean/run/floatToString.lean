@@ -0,0 +1,24 @@
+/--
+info: 0.30000000000000004
+9007199254740992.0
+1e21
+0.000001
+1e-7
+5e-324
+2.2250738585072014e-308
+1.7976931348623157e308
+1.2345678901234568e24
+-0.0
+-/
+#guard_msgs in
+#eval show IO Unit from do
+  for x in [0.1 + 0.2, 9007199254740993, 1e21, 1e-6, 1e-7, 5e-324, 2.2250738585072014e-308,
+      1.7976931348623157e308, 123456789012345678901234567890e-5, -0.0] do
+    IO.println x
+
+/-- info: true -/
+#guard_msgs in
+#eval [0.1, 1/3, 2.5e-320, 6.02214076e23, 1e300 * 10].all fun x =>
+  match Lean.Syntax.decodeScientificLitVal? (toString x) with
+  | some (m, s, e) => OfScientific.ofScientific m s e == x
+  | none => false
@@ -14,10 +14,10 @@ IO.println bs.size;
 pure ()
 
 /--
-info: [1.000000, 2.000000, 3.000000]
-[1.000000, 6.666667, 3.000000, 4.000000]
-[1.000000, 6.666667, 30.000000, 4.000000]
-[1.000000, 6.666667, 3.000000, 4.000000]
+info: [1.0, 2.0, 3.0]
+[1.0, 6.666666666666667, 3.0, 4.0]
+[1.0, 6.666666666666667, 30.0, 4.0]
+[1.0, 6.666666666666667, 3.0, 4.0]
 4
 -/
 #guard_msgs in
@@ -0,0 +1,27 @@
+open Std Format
+
+def list (n : Nat) : Format :=
+  sbracket (joinSep ((List.range n).map fun i => format i) ("," ++ line))
+
+def nested : Nat → Format
+  | 0     => "x"
+  | n + 1 => paren (nested n ++ line ++ "+" ++ line ++ text s!"{n}\ny{n}")
+
+def render (f : Format) (width : Nat) : IO String := do
+  let buf ← IO.mkRef {}
+  (IO.FS.Stream.ofBuffer buf).putFormat f width
+  return String.fromUTF8! (← buf.get).data
+
+/-- info: [0, 1, 2] -/
+#guard_msgs in
+#eval IO.println ((list 3).prettyTruncated 9)
+
+/-- info: [0, 1, 2⋯ -/
+#guard_msgs in
+#eval IO.println ((list 4).prettyTruncated 8)
+
+/-- info: true -/
+#guard_msgs in
+#eval show IO Bool from do
+  let fs := [list 10000, nested 50, bracketFill "[" (list 10000) "]", group (nest 2 ("a\nb\nc" ++ line ++ "d"))]
+  fs.allM fun f => return (← render f 40) == f.pretty 40
@@ -0,0 +1,23 @@
+import Lean.Data.FuzzyMatching
+
+open Lean.FuzzyMatching
+
+/-- The mask prefilter never rejects a word that the fuzzy matcher accepts. -/
+def maskIsSound (pattern word : String) : Bool :=
+  (fuzzyMatchScore? pattern word).isNone || maskMayMatch (charMask pattern) (charMask word)
+
+#guard maskIsSound "ext" "Array.extract"
+#guard maskIsSound "AE" "Array.extract"
+#guard maskIsSound "" "foo"
+#guard maskIsSound "x_1" "X_1"
+#guard ["map", "foldl", "filterMap", "toList", "List.map₂", "Nat.add_comm"].all fun word =>
+  ["m", "fM", "ap", "l", "₂", "add_c", "xyz"].all fun pattern => maskIsSound pattern word
+
+-- case is ignored
+#guard charMask "Abc" == charMask "aBC"
+#guard charMask "" == 0
+
+-- words missing a character of the pattern are rejected without fuzzy matching
+#guard !maskMayMatch (charMask "xyz") (charMask "Array.extract")
+#guard !maskMayMatch (charMask "map2") (charMask "map")
+#guard maskMayMatch (charMask "aext") (charMask "Array.extract")
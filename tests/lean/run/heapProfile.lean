@@ -0,0 +1,27 @@
+/-- Returns the number of objects in the row of `kind` of the "by object kind" table of `summary`. -/
+def kindCount? (summary : String) (kind : String) : Option Nat := do
+  let line ← summary.splitOn "\n" |>.find? (·.endsWith s!"objects  {kind}")
+  let ws := line.splitOn " " |>.filter (· ≠ "")
+  ws[2]?.bind String.toNat?
+
+def check : IO (List String × Bool × Bool × Bool × Bool) := do
+  IO.setHeapProfileRate 1
+  let xs := (List.range 200000).map toString
+  -- force `xs` before taking the summary
+  unless xs.length == 200000 do
+    throw <| .userError "unexpected length"
+  let s ← IO.heapProfileSummary
+  IO.setHeapProfileRate 0
+  let lines := s.splitOn "\n"
+  -- `xs` is still live, so each of its strings and cells must be accounted for
+  return (xs, lines[0]!.startsWith "heap profile (sampling rate 1/1, ",
+    lines[1]!.startsWith "estimated live: ",
+    lines.contains "by object kind:" && lines.contains "by size class:",
+    (kindCount? s "string").any (· ≥ 200000) &&
+      (kindCount? s "constructor (tag 1, 2 fields)").any (· ≥ 200000))
+
+/-- info: (200000, true, true, true, true) -/
+#guard_msgs in
+#eval do
+  let (xs, r) ← check
+  return (xs.length, r)
@@ -0,0 +1,27 @@
+/-!
+The kernel analyzes the recursive fields of each constructor once, and reuses the result to build
+both the minor premises and the computation rules of the recursors.
+-/
+
+mutual
+inductive A : Nat → Type
+  | base : A 0
+  | step (n : Nat) (f : Nat → A n) (b : B n) : A (n+1)
+inductive B : Nat → Type
+  | leaf (n : Nat) : B n
+  | node (n : Nat) (a : A n) (x : Nat) (bs : B n) : B n
+end
+
+noncomputable def A.size (a : A n) : Nat :=
+  @A.rec (fun _ _ => Nat) (fun _ _ => Nat) 1 (fun _ _ _ ihf ihb => ihf 0 + ihb + 1)
+    (fun _ => 1) (fun _ _ _ _ iha ihbs => iha + ihbs + 1) n a
+
+example : A.size (A.step 0 (fun _ => A.base) (B.node 0 A.base 7 (B.leaf 0))) = 5 := rfl
+
+inductive Tree where
+  | node : Nat → List Tree → Tree
+
+noncomputable def Tree.sum : Tree → Nat :=
+  @Tree.rec (fun _ => Nat) (fun _ => Nat) (fun n _ ih => n + ih) 0 (fun _ _ ih ihs => ih + ihs)
+
+example : Tree.sum (.node 1 [.node 2 [], .node 3 [.node 4 []]]) = 10 := rfl
@@ -0,0 +1,25 @@
+/-!
+`compiler.inline_growth_factor` bounds the code inlined into a declaration. Matchers are still
+inlined when the budget is exhausted, so the declarations below must compile.
+-/
+
+@[inline] def step (x : Nat) : Nat :=
+  match x with
+  | 0 => 1
+  | 1 => x + 2
+  | n+2 => n * 3 + x
+
+set_option compiler.inline_growth_factor 1 in
+def big (x : Nat) : Nat :=
+  step (step (step (step (step (step x)))))
+
+#eval big 7
+
+set_option trace.compiler.simp_stats true in
+set_option compiler.inline_growth_factor 2 in
+def big2 (x : Nat) : Nat :=
+  match x with
+  | 0 => step (step x)
+  | _ => step (step (step x))
+
+#eval big2 3
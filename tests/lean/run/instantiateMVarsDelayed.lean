@@ -0,0 +1,24 @@
+import Lean
+open Lean Meta
+
+/-!
+`instantiateMVars` abstracts the value of a delayed-assigned metavariable once, and instantiates it
+for each of its applications.
+-/
+
+def test : MetaM Unit := do
+  let nat := mkConst ``Nat
+  withLocalDeclD `x nat fun x => do
+  withLocalDeclD `y nat fun y => do
+    let p ← mkFreshExprMVar nat
+    let m ← mkFreshExprMVar (← mkArrow nat (← mkArrow nat nat))
+    assignDelayedMVar m.mvarId! #[x, y] p.mvarId!
+    let e := mkNatAdd (mkApp2 m (mkNatLit 1) (mkNatLit 2)) (mkApp2 m (mkNatLit 3) x)
+    -- `p` is not assigned yet
+    unless (← instantiateMVars e) == e do throwError "unexpected result"
+    p.mvarId!.assign (mkNatAdd x (mkNatAdd y x))
+    let expected := mkNatAdd (mkNatAdd (mkNatLit 1) (mkNatAdd (mkNatLit 2) (mkNatLit 1)))
+                             (mkNatAdd (mkNatLit 3) (mkNatAdd x (mkNatLit 3)))
+    unless (← instantiateMVars e) == expected do throwError "unexpected result"
+
+#eval test
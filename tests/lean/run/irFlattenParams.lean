@@ -0,0 +1,40 @@
+/-!
+Scalar fields of structure parameters are passed in registers when the structure does not escape.
+-/
+
+structure Vec2 where
+  x : Float
+  y : Float
+
+def loop (acc : Vec2) : Nat → Float
+  | 0     => acc.x + acc.y
+  | i + 1 => loop { x := acc.x + 1.0, y := acc.y * 2.0 } i
+
+#eval loop { x := 0.0, y := 1.0 } 10
+
+structure Acc where
+  sum   : UInt64
+  count : UInt64
+
+def mean (acc : Acc) : List UInt64 → UInt64
+  | []      => if acc.count == 0 then 0 else acc.sum / acc.count
+  | x :: xs => mean { sum := acc.sum + x, count := acc.count + 1 } xs
+
+example : mean ⟨0, 0⟩ [2, 4, 6] = 4 := by native_decide
+
+/-- `v.y` is only read on one path, so `v` must not be flattened. -/
+def pick (b : Bool) (v : Vec2) : Float :=
+  if b then v.x + v.y else v.x
+
+#eval pick false ⟨1.0, 2.0⟩
+
+/-! The pass creates a worker taking the fields of `loop`'s accumulator, but not for `pick`. -/
+
+open Lean IR in
+/-- info: (true, true, false) -/
+#guard_msgs in
+#eval show CoreM _ from do
+  let env ← getEnv
+  let loopFlat? := findEnvDecl env `loop._flat
+  return (loopFlat?.isSome, loopFlat?.any (·.params.any (·.ty == .float)),
+    (findEnvDecl env `pick._flat).isSome)
@@ -0,0 +1,50 @@
+import Lean.Data.Json
+open Lean
+
+/-!
+Differential tests of the native `Json.Parser.scanPlain` against a character-by-character
+reference, and of string parsing, which uses it, against `Json.compress`.
+-/
+
+def scanPlainRef (s : String) (pos : String.Pos) : String.Pos := Id.run do
+  let mut pos := pos
+  while pos < s.endPos do
+    let c := s.get pos
+    if c == '"' || c == '\\' || c.val < 0x20 then
+      break
+    pos := s.next pos
+  return pos
+
+def genString (seed : Nat) : String := Id.run do
+  let chars := #['a', 'Z', ' ', '"', '\\', '\n', '\x01', 'λ', '∀', '𝔸', '/', 'u']
+  let mut gen := mkStdGen seed
+  let mut s := ""
+  let (n, gen') := randNat gen 0 80
+  gen := gen'
+  for _ in [0:n] do
+    let (i, gen') := randNat gen 0 (chars.size - 1)
+    gen := gen'
+    s := s.push chars[i]!
+  return s
+
+/-- info: true -/
+#guard_msgs in
+#eval Id.run do
+  for seed in [0:2000] do
+    let s := genString seed
+    let mut pos := 0
+    while pos < s.endPos do
+      if Json.Parser.scanPlain s pos != scanPlainRef s pos then
+        return false
+      pos := s.next pos
+    if (Json.parse (Json.str s).compress).toOption != some (.str s) then
+      return false
+  return true
+
+/-- info: true -/
+#guard_msgs in
+#eval (Json.parse "\"a\\\"b\\\\c\\nd \\u03bb\"").toOption == some (.str "a\"b\\c\nd λ")
+
+/-- info: false -/
+#guard_msgs in
+#eval (Json.parse "\"a\x01\"").toBool
@@ -0,0 +1,28 @@
+/-!
+The kernel checks the arguments of an application, and infers the type of projections,
+without instantiating the remaining telescope once per argument.
+-/
+
+structure Big (α : Type) (n : Nat) where
+  (f0 f1 f2 f3 f4 f5 f6 f7 f8 f9 : α)
+  (h : n = n)
+  (g0 g1 g2 g3 g4 g5 g6 g7 g8 g9 : Fin (n+1))
+  (v : Fin (n+1) → α)
+  (w : v g9 = v g9)
+
+def mk (a : α) (n : Nat) : Big α n :=
+  ⟨a, a, a, a, a, a, a, a, a, a, rfl, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, fun _ => a, rfl⟩
+
+example : (mk 3 5).f9 = 3 := rfl
+example : (mk 3 5).v (mk 3 5).g9 = 3 := rfl
+example (b : Big Nat 2) : b.v b.g9 = b.v b.g9 := b.w
+
+def dep (n : Nat) (x : Fin (n+1)) (m : Nat) (h : x.val ≤ n) (y : Fin (m+1)) (p : y.val ≤ m) : Nat :=
+  n + x + m + y
+
+example : dep 2 1 3 (by decide) 2 (by decide) = 8 := rfl
+
+structure PS (p : Prop) : Prop where
+  (a : p) (b : p ∧ p) (c : b.1 = a)
+
+example (p : Prop) (s : PS p) : p := s.b.2
@@ -0,0 +1,57 @@
+import Lean
+
+open Lean
+
+def checkDefEq (a b : Name) : CoreM Unit := do
+  let env ← getEnv
+  let r ← ofExceptKernelException (Kernel.isDefEq env {} (mkConst a) (mkConst b))
+  IO.println (toString a ++ " =?= " ++ toString b ++ " := " ++ toString r)
+
+def x : BitVec 64 := 0xFFFFFFFFFFFFFFFF#64
+def y : BitVec 64 := 3#64
+def u : UInt64 := 0xFFFFFFFFFFFFFFFF
+
+def radd := x + y
+def rsub := y - x
+def rmul := x * y
+def rand := x &&& y
+def rxor := x ^^^ y
+def rlt := x.ult y
+def rle := y.ule x
+def ruadd := u + 5
+
+def two := 2#64
+def four := 4#64
+def ffc := 0xFFFFFFFFFFFFFFFC#64
+def three := 3#64
+def ffd := 0xFFFFFFFFFFFFFFFD#64
+def u4 : UInt64 := 4
+
+#eval Kernel.setBitVecReduction true
+
+/--
+info: radd =?= two := true
+rsub =?= four := true
+rmul =?= ffd := true
+rand =?= three := true
+rxor =?= ffc := true
+rlt =?= Bool.false := true
+rle =?= Bool.true := true
+ruadd =?= u4 := true
+radd =?= four := false
+-/
+#guard_msgs in
+#eval do
+  checkDefEq `radd `two
+  checkDefEq `rsub `four
+  checkDefEq `rmul `ffd
+  checkDefEq `rand `three
+  checkDefEq `rxor `ffc
+  checkDefEq `rlt ``Bool.false
+  checkDefEq `rle ``Bool.true
+  checkDefEq `ruadd `u4
+  checkDefEq `radd `four
+
+theorem big : (0xFFFFFFFFFFFFFFFF#64 * 0xFFFFFFFFFFFFFFFF#64) + 0#64 = 1#64 := by decide
+
+#eval Kernel.setBitVecReduction false
@@ -0,0 +1,43 @@
+import Lean
+open Lean
+
+/-!
+The kernel remembers the declarations it accepted, and only skips checking them again if the
+constants they were checked against did not change.
+-/
+
+#eval Kernel.setCheckedDeclCacheCapacity 100
+
+def mkC (v : Nat) : Declaration :=
+  .defnDecl { name := `c, levelParams := [], type := mkConst ``Nat, value := mkNatLit v,
+              hints := .abbrev, safety := .safe }
+
+/-- `theorem t : c = 1 := Eq.refl c` -/
+def thmT : Declaration :=
+  .thmDecl { name := `t, levelParams := [],
+             type := mkApp3 (mkConst ``Eq [levelOne]) (mkConst ``Nat) (mkConst `c) (mkNatLit 1),
+             value := mkApp2 (mkConst ``Eq.refl [levelOne]) (mkConst ``Nat) (mkConst `c) }
+
+def addDecls (env : Environment) (ds : List Declaration) : Except KernelException Environment :=
+  ds.foldlM (fun env d => env.addDeclCore 0 d none) env
+
+def test : CoreM Unit := do
+  let env ← getEnv
+  let ok (r : Except KernelException Environment) : String := if r matches .ok _ then "ok" else "error"
+  IO.println (ok (addDecls env [mkC 1, thmT]))
+  -- same declarations, `t` is not checked again
+  IO.println (ok (addDecls env [mkC 1, thmT]))
+  -- `c` changed, `t` must be checked again
+  IO.println (ok (addDecls env [mkC 2, thmT]))
+  IO.println (ok (addDecls env [mkC 1, thmT]))
+
+/--
+info: ok
+ok
+error
+ok
+-/
+#guard_msgs in
+#eval test
+
+#eval Kernel.setCheckedDeclCacheCapacity 0
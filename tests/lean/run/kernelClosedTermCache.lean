@@ -0,0 +1,14 @@
+import Lean
+
+#eval Lean.Kernel.setClosedTermCacheCapacity 10000
+
+theorem mul₁ : 100 * 100 = 10000 := by decide
+theorem mul₂ : 100 * 100 = 10000 := by decide
+theorem len₁ : (List.range 50).length = 50 := rfl
+theorem len₂ : (List.range 50).length = 50 := rfl
+
+def localFive := 5
+
+theorem local₁ : localFive + 1 = 6 := rfl
+
+#eval Lean.Kernel.setClosedTermCacheCapacity 0
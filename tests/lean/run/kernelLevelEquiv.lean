@@ -0,0 +1,14 @@
+/-!
+The kernel decides universe level equivalence with a cached normalization, and shortcuts for
+levels that are already normalized and for `max u v` and `max v u`.
+-/
+
+universe u v w
+
+def maxComm (α : Sort (max u v)) : Sort (max v u) := α
+def maxAssoc (α : Sort (max u (max v w))) : Sort (max (max w u) v) := α
+def maxSucc (α : Sort (max (u+1) (v+1))) : Sort (max v u + 1) := α
+def maxSame (α : Sort (max u u)) : Sort u := α
+
+-- repeated checks of the same levels
+example (α : Sort (max u v)) : List (Sort (max v u)) := [maxComm α, maxComm α, maxComm α]
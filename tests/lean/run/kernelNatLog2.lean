@@ -0,0 +1,7 @@
+example : Nat.log2 0 = 0 := by decide
+example : Nat.log2 1 = 0 := by decide
+example : Nat.log2 1023 = 9 := by decide
+example : Nat.log2 (2^200) = 200 := by decide
+example : Nat.log2 (2^200 - 1) = 199 := rfl
+example : (2^300 + 7) % 2^150 = 7 := by decide
+example : Nat.gcd (2^256 * 3) (2^255 * 9) = 2^255 * 3 := by decide
@@ -0,0 +1,35 @@
+import Lean
+
+open Lean
+
+/-- Returns a description of each check that failed. -/
+unsafe def tst : IO (Array String) := do
+  let imports := #[{module := `Init.Data.Array}]
+  let eager ← importModules imports {}
+  let lazy ← importModules imports {} (lazyConstants := true)
+  let mut failures := #[]
+  unless lazy.constants.map₁.size == 0 do
+    failures := failures.push "constants were loaded eagerly"
+  for n in [`Array.foldl, `Nat.add, `Array.push, `List.map, `Eq.refl] do
+    unless lazy.contains n do
+      failures := failures.push s!"{n} not found"
+    unless (lazy.find? n).map (·.name) == (eager.find? n).map (·.name) do
+      failures := failures.push s!"{n} differs"
+    unless lazy.getModuleIdxFor? n == eager.getModuleIdxFor? n do
+      failures := failures.push s!"module of {n} differs"
+  if lazy.contains `Array.doesNotExist || (lazy.find? `Array.doesNotExist).isSome then
+    failures := failures.push "Array.doesNotExist found"
+  -- every constant of every module is found through the module's perfect hash table
+  for mod in lazy.header.moduleData do
+    if mod.constSeeds.isEmpty && !mod.constNames.isEmpty then
+      failures := failures.push "missing hash table"
+    for n in mod.constNames do
+      unless (mod.findConst? n).map (·.name) == some n do
+        failures := failures.push s!"{n} not found through hash table"
+  lazy.freeRegions
+  eager.freeRegions
+  return failures
+
+/-- info: #[] -/
+#guard_msgs in
+#eval tst
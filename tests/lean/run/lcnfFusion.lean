@@ -0,0 +1,49 @@
+import Lean
+open Lean Compiler LCNF
+
+def sumSquaresOfEven (xs : List Nat) : Nat :=
+  xs.filter (· % 2 == 0) |>.map (· * ·) |>.foldl (· + ·) 0
+
+def sumLengths (xs : List String) : Nat :=
+  let lengths := xs.map String.length
+  lengths.foldl (· + ·) 0
+
+-- `lengths` is used twice, so it is not fused
+def sumAndCount (xs : List String) : Nat × Nat :=
+  let lengths := xs.map String.length
+  (lengths.foldl (· + ·) 0, lengths.length)
+
+def usesConst (declName constName : Name) : CoreM Bool := do
+  let decl ← CompilerM.run (toDecl declName)
+  return decl.value.containsConst constName
+
+/-- info: (false, false) -/
+#guard_msgs in
+#eval show CoreM _ from
+  return (← usesConst ``sumSquaresOfEven ``List.map, ← usesConst ``sumLengths ``List.map)
+
+/-- info: true -/
+#guard_msgs in
+#eval show CoreM _ from usesConst ``sumAndCount ``List.map
+
+/-- info: true -/
+#guard_msgs in
+set_option compiler.fusion false in
+#eval show CoreM _ from usesConst ``sumSquaresOfEven ``List.map
+
+attribute [fusion] List.length_map
+
+def countSuccs (xs : List Nat) : Nat :=
+  (xs.map (· + 1)).length
+
+/-- info: false -/
+#guard_msgs in
+#eval show CoreM _ from usesConst ``countSuccs ``List.map
+
+/-- error: invalid 'fusion' theorem, the left-hand side must be an application of a constant to an application of a constant (e.g., `(l.map f).foldl g init = ...`) -/
+#guard_msgs in
+attribute [fusion] Nat.add_comm
+
+/-- info: (20, 11) -/
+#guard_msgs in
+#eval (sumSquaresOfEven [1, 2, 3, 4], sumLengths ["ab", "cde", "fghijk"])
@@ -0,0 +1,15 @@
+set_option linter.parallel true
+
+inductive A where
+  | x
+
+/--
+warning: Local variable 'x' resembles constructor 'A.x' - write '.x' (with a dot) or 'A.x' to use the constructor.
+note: this linter can be disabled with `set_option linter.constructorNameAsVariable false`
+---
+warning: unused variable `n`
+note: this linter can be disabled with `set_option linter.unusedVariables false`
+-/
+#guard_msgs in
+def f (n : Nat) : A → Unit
+  | x => ()
@@ -0,0 +1,26 @@
+import Std.Tactic.BVDecide.LRAT.Checker
+
+open Std.Sat Std.Tactic.BVDecide.LRAT
+
+-- x ∧ ¬x
+def cnf : CNF Nat := [[(0, true)], [(0, false)]]
+
+def proof : Array IntAction := #[.addEmpty 3 #[1, 2]]
+
+/-- info: (true, true, true) -/
+#guard_msgs in
+#eval (check proof cnf, checkStream (lratProofToString proof).toUTF8 cnf,
+  checkStream (lratProofToBinary proof) cnf)
+
+/-- info: true -/
+#guard_msgs in
+#eval checkStream "c comment\n3 0 1 2 0\n".toUTF8 cnf
+
+/-- info: (false, false, false) -/
+#guard_msgs in
+#eval (checkStream "3 0 1 0\n".toUTF8 cnf, checkStream "".toUTF8 cnf, checkStream "3 0 1 x\n".toUTF8 cnf)
+
+-- the empty clause is derived before the syntax error
+/-- info: true -/
+#guard_msgs in
+#eval checkStream "3 0 1 2 0\nx\n".toUTF8 cnf
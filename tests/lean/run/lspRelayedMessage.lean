@@ -0,0 +1,31 @@
+import Lean.Data.Lsp.Communication
+open Lean Lsp JsonRpc
+
+/-- Writes `msg` with relay information and reads it back. -/
+def relay (msg : Message) : IO String := do
+  let buf ← IO.mkRef {}
+  let h := IO.FS.Stream.ofBuffer buf
+  h.writeLspMessage msg (relay := true)
+  buf.modify ({ · with pos := 0 })
+  match ← h.readLspRelayedMessage with
+  | .notification method _ => return s!"notification {method}"
+  | .response id _ => return s!"response {(toJson id).compress}"
+  | .message _ => return "message"
+
+/-- info: "notification $/lean/fileProgress" -/
+#guard_msgs in
+#eval relay (.notification "$/lean/fileProgress" none)
+
+/-- info: "response 1" -/
+#guard_msgs in
+#eval relay (.response (.num 1) Json.null)
+
+/-! String request IDs may contain spaces. -/
+
+/-- info: "response \"a b c\"" -/
+#guard_msgs in
+#eval relay (.response (.str "a b c") Json.null)
+
+/-- info: "message" -/
+#guard_msgs in
+#eval relay (.request (.str "a b") "textDocument/hover" none)
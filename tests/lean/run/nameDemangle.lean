@@ -0,0 +1,15 @@
+import Lean.Compiler.NameMangling
+open Lean
+
+def roundtrip (n : Name) : Bool :=
+  Name.demangle? n.mangle == some n
+
+#guard roundtrip `Lean.Meta.whnf
+#guard roundtrip `Lean.Elab.Term.elabTerm._lambda_1
+#guard roundtrip `Nat.add._boxed
+#guard roundtrip ((Name.mkSimple "_private" ++ `Lean.Foo).num 0 ++ `Lean.bar)
+#guard roundtrip `Foo.«a.b».«α»
+#guard roundtrip `Foo.x41
+
+#guard Name.demangle? "lean_apply_1" == none
+#guard Name.demangle? "l_Foo_bar___lambda__1" == some `Foo.bar._lambda_1
@@ -0,0 +1,32 @@
+import Lean
+open Lean
+
+/-- Collects the names produced by `g` and its descendants up to depth `d`. -/
+partial def collect (g : NameGenerator) : Nat → List Name
+  | 0 => [g.curr, g.next.curr, g.next.next.curr]
+  | d + 1 => Id.run do
+    let mut g := g
+    let mut r := []
+    for _ in [0:3] do
+      r := g.curr :: r
+      g := g.next
+      let (c, g') := g.mkChild
+      g := g'
+      r := collect c d ++ r
+    return r
+
+/-- Returns the largest numeric component of `n`. -/
+def maxIdx : Name → Nat
+  | .num p i => max i (maxIdx p)
+  | .str p _ => maxIdx p
+  | .anonymous => 0
+
+/-- info: (120, true, true, true) -/
+#guard_msgs in
+#eval
+  let ns := collect {} 3
+  (ns.length, ns.eraseDups.length == ns.length, ns.all (`_uniq).isPrefixOf,
+    ns.all (maxIdx · < 2 ^ 62))
+
+-- the names of children of a generator with a small index stay flat
+#guard (collect {} 1).all (·.getNumParts == 2)
@@ -0,0 +1,20 @@
+#guard Nat.mulAdd 3 4 5 == 17
+#guard Nat.powMod 3 200 1000000007 == 3 ^ 200 % 1000000007
+#guard Nat.powMod 2 10 0 == 1024
+#guard Nat.powMod 7 0 1 == 0
+
+-- compiled code uses the runtime implementations
+def test : IO (List Bool) := do
+  let big := 2 ^ 100 + 7
+  return [
+    Nat.mulAdd big big 1 == big * big + 1,
+    Nat.mulAdd (2 ^ 62) 4 3 == 2 ^ 64 + 3,
+    Nat.powMod 3 200 1000000007 == 3 ^ 200 % 1000000007,
+    Nat.powMod big 1000 (2 ^ 80 + 13) == big ^ 1000 % (2 ^ 80 + 13),
+    Nat.powMod 5 (2 ^ 70) 97 == 5 ^ (2 ^ 70 % 96) % 97,
+    Nat.powMod big 3 0 == big ^ 3,
+    Int.toNat (-5 + 2 ^ 100 : Int) == 2 ^ 100 - 5]
+
+/-- info: [true, true, true, true, true, true, true] -/
+#guard_msgs in
+#eval test
@@ -0,0 +1,19 @@
+import Lean
+open Lean
+
+/-- Returns the identifiers of `stx` named `x`. -/
+partial def xs (stx : Syntax) : Array Name :=
+  match stx with
+  | .ident _ _ n _ => if n == `x then #[n] else #[]
+  | .node _ _ args => args.flatMap xs
+  | _ => #[]
+
+unsafe def sameObjects (ns : Array Name) : Bool :=
+  ns.all fun n => ptrAddrUnsafe n == ptrAddrUnsafe ns[0]!
+
+/-- info: (3, true) -/
+#guard_msgs in
+#eval show MetaM _ from do
+  let .ok stx := Parser.runParserCategory (← getEnv) `term "fun x => x + x" | throwError "parse error"
+  let ns := xs stx
+  return (ns.size, unsafe sameObjects ns)
@@ -0,0 +1,16 @@
+import Lean.Widget.InteractiveCode
+open Lean Meta Widget
+
+unsafe def sameObj (a b : CodeWithInfos) : Bool := ptrEq a b
+
+def mkTerm : Expr := mkApp2 (mkConst ``Nat.add) (mkNatLit 1) (mkNatLit 2)
+
+/-- info: (true, false, "Nat.add 1 2", "Nat.add 1 2") -/
+#guard_msgs in
+#eval show MetaM _ from do
+  let a ← ppExprTagged mkTerm
+  -- structurally equal expressions share the result
+  let b ← ppExprTagged (mkApp2 (mkConst ``Nat.add) (mkNatLit 1) (mkNatLit 2))
+  -- different options do not
+  let c ← withOptions (·.setBool `pp.explicit true) <| ppExprTagged mkTerm
+  return (unsafe sameObj a b, unsafe sameObj a c, toString a.pretty, toString b.pretty)
@@ -0,0 +1,16 @@
+def incr (r : IO.Ref Nat) (n : Nat) : IO Unit := do
+  for _ in [0:n] do
+    r.modifyAtomic (· + 1)
+
+def test : IO (Nat × Nat × Nat) := do
+  let r ← IO.mkRef 0
+  let tasks ← (List.range 8).mapM fun _ => IO.asTask (incr r 1000) .dedicated
+  for t in tasks do
+    IO.ofExcept t.get
+  let v ← r.get
+  let old ← r.modifyGetAtomic fun n => (n, n + 1)
+  return (v, old, ← r.get)
+
+/-- info: (8000, 8000, 8001) -/
+#guard_msgs in
+#eval test
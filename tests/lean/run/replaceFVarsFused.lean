@@ -0,0 +1,38 @@
+import Lean
+open Lean
+open Lean.Meta
+
+/-! `Expr.replaceFVars` performs the `abstract` and the `instantiateRev` in a single traversal. -/
+
+def unfused (e : Expr) (xs vs : Array Expr) : Expr :=
+  (e.abstract xs).instantiateRev vs
+
+def check (e : Expr) (xs vs : Array Expr) : MetaM Unit := do
+  unless e.replaceFVars xs vs == unfused e xs vs do
+    throwError "replaceFVars mismatch at{indentExpr e}"
+
+def test : MetaM Unit := do
+  let nat := mkConst ``Nat
+  let add := mkConst ``Nat.add
+  withLocalDeclD `x nat fun x => withLocalDeclD `y nat fun y => do
+    let m ← mkFreshExprMVar nat
+    let a := mkNatLit 1
+    let b := mkApp2 add (mkBVar 0) a
+    let e := mkApp3 add x (mkLambda `z .default nat (mkApp2 add y (mkBVar 0))) m
+    check e #[x, y] #[a, b]
+    check e #[x, y] #[a]
+    check e #[x] #[a, b]
+    check e #[x, m] #[b, a]
+    check e #[] #[a]
+    -- loose bound variables in `e` are instantiated as well
+    let e' := mkApp2 add (mkBVar 0) (mkLambda `z .default nat (mkApp3 add x (mkBVar 1) (mkBVar 2)))
+    check e' #[x] #[a]
+    check e' #[x] #[a, b]
+    check e' #[x, y] #[a]
+    -- shared subterms
+    let s := mkApp2 add x y
+    check (mkApp2 add s (mkLambda `z .default nat s)) #[x, y] #[b, a]
+    let deep := (List.range 10000).foldl (fun e _ => mkApp2 add e x) y
+    check deep #[x, y] #[a, b]
+
+#eval test
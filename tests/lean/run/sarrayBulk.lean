@@ -0,0 +1,41 @@
+def fa (xs : List Float) : FloatArray := xs.toFloatArray
+def ba (xs : List UInt8) : ByteArray := xs.toByteArray
+
+#guard (fa [1, 2, 3]).add (fa [10, 20]) |>.toList == [11, 22]
+#guard (fa [1, 2, 3]).sub (fa [1, 1, 1]) |>.toList == [0, 1, 2]
+#guard (fa [1, 2, 3]).mul (fa [2, 2, 2]) |>.toList == [2, 4, 6]
+#guard (fa [2, 4]).div (fa [2, 2]) |>.toList == [1, 2]
+#guard (fa [1, 2]).scale 3 |>.toList == [3, 6]
+#guard (fa [1, 2]).shift 1 |>.toList == [2, 3]
+#guard (fa [1, 2, 3, 4, 5]).sum == 15
+#guard (fa [1, 2, 3, 4, 5]).dot (fa [1, 1, 1, 1, 2]) == 20
+#guard (fa [3, -1, 7]).minimum == -1
+#guard (fa [3, -1, 7]).maximum == 7
+#guard FloatArray.empty.minimum.isInf
+
+#guard (ba [1, 2, 3, 2]).find? 2 == some 1
+#guard (ba [1, 2, 3, 2]).find? 2 (start := 2) == some 3
+#guard (ba [1, 2, 3, 2]).find? 4 == none
+#guard (ba [1, 2, 3]) == ba [1, 2, 3]
+#guard (ba [1, 2, 3]) != ba [1, 2]
+#guard compare (ba [1, 2]) (ba [1, 2, 3]) == .lt
+#guard compare (ba [1, 3]) (ba [1, 2, 3]) == .gt
+#guard compare (ba [1, 2]) (ba [1, 2]) == .eq
+#guard ((ba [0xff, 0x0f, 1]).xor (ba [0x0f, 0x0f])).toList == [0xf0, 0]
+#guard ((ba [1, 2, 3]).fill 7).toList == [7, 7, 7]
+
+-- compiled code uses the native implementations
+def test : IO (List Bool) := do
+  let x := (List.range 100).map (·.toFloat) |>.toFloatArray
+  let b := (List.range 100).map (·.toUInt8) |>.toByteArray
+  return [
+    x.sum == 4950,
+    x.dot x == 328350,
+    (x.add x).toList == x.toList.map (· * 2),
+    b.find? 42 == some 42,
+    (b.xor b).toList.all (· == 0),
+    compare b (b.fill 0) == .gt]
+
+/-- info: [true, true, true, true, true, true] -/
+#guard_msgs in
+#eval test
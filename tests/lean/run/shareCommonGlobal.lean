@@ -0,0 +1,28 @@
+import Lean
+open Lean
+
+/-!
+`ShareCommon.shareCommonGlobal` makes structurally equal values pointer equal,
+even if they are shared by different tasks.
+-/
+
+def mkTerm (n : Nat) : Expr :=
+  (List.range n).foldl (fun e i => mkApp2 (mkConst ``Nat.add) e (mkNatLit i)) (mkConst ``Nat.zero)
+
+def test : IO (List Bool) := do
+  let ts := (List.range 4).map fun _ => Task.spawn fun _ => ShareCommon.shareCommonGlobal (mkTerm 100)
+  let es := ts.map Task.get
+  let e := es.head!
+  let e' := ShareCommon.shareCommonGlobal (mkApp (mkConst ``Nat.succ) (mkTerm 100))
+  -- strings and arrays
+  let s := ShareCommon.shareCommonGlobal ("ab" ++ "c")
+  let as := ShareCommon.shareCommonGlobal (#[1, 2] ++ #[3])
+  let r := [es.all (ptrEq · e), e == mkTerm 100, ptrEq e'.appArg! e,
+    ptrEq s (ShareCommon.shareCommonGlobal "abc"), ptrEq as (ShareCommon.shareCommonGlobal #[1, 2, 3])]
+  -- values still in use survive pruning
+  let _ ← ShareCommon.pruneGlobal
+  return r ++ [ptrEq e (ShareCommon.shareCommonGlobal (mkTerm 100)), (← ShareCommon.numGlobalObjs) > 0]
+
+/-- info: [true, true, true, true, true, true, true] -/
+#guard_msgs in
+#eval test
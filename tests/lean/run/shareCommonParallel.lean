@@ -0,0 +1,21 @@
+import Lean
+open Lean
+
+/-! `ShareCommon.shareCommonParallel` produces the same sharing as `ShareCommon.shareCommon'`. -/
+
+def mkTerm (n : Nat) : Expr :=
+  (List.range n).foldl (init := mkConst ``Nat.zero) fun e i =>
+    mkApp2 (mkConst ``Nat.add) (mkApp (mkConst ``Nat.succ) (mkNatLit (i % 100))) e
+
+def test : IO (List Bool) := do
+  let es := (List.range 20).toArray.map fun i => mkTerm (5000 + i)
+  let r₁ := ShareCommon.shareCommon' es
+  let r₂ := ShareCommon.shareCommonParallel es
+  let n₁ ← (mkAppN (mkConst `f) r₁).numObjs
+  let n₂ ← (mkAppN (mkConst `f) r₂).numObjs
+  let p := ShareCommon.shareCommonParallel (mkTerm 1000, mkTerm 1000)
+  return [r₁ == r₂, r₂ == es, n₁ == n₂, ptrEq p.1 p.2]
+
+/-- info: [true, true, true, true] -/
+#guard_msgs in
+#eval test
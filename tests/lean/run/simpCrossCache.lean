@@ -0,0 +1,31 @@
+set_option simp.crossCache true
+set_option trace.Meta.Tactic.simp.crossCache true
+
+/--
+info: [Meta.Tactic.simp.crossCache] miss, 0 hits and 1 misses so far
+[Meta.Tactic.simp.crossCache] hit, 1 hits and 1 misses so far
+-/
+#guard_msgs in
+example : (0 + 1 = 1) ∧ (0 + 1 = 1) := by
+  constructor <;> simp
+
+-- terms with free variables are not cached
+#guard_msgs in
+example (x : Nat) : (x + 0 = x) ∧ (x + 0 = x) := by
+  constructor <;> simp
+
+-- a hit reports the theorems used by the cached call
+/--
+info: [Meta.Tactic.simp.crossCache] miss, 0 hits and 1 misses so far
+---
+info: Try this: simp only [Nat.add_zero]
+---
+info: [Meta.Tactic.simp.crossCache] hit, 1 hits and 1 misses so far
+---
+info: Try this: simp only [Nat.add_zero]
+-/
+#guard_msgs in
+example : (2 + 0 = 2) ∧ (2 + 0 = 2) := by
+  constructor
+  · simp? only [Nat.add_zero]
+  · simp? only [Nat.add_zero]
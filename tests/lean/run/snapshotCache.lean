@@ -0,0 +1,29 @@
+import Lean.Server.FileWorker.SnapshotCache
+open Lean Lean.Server.FileWorker Lean.Lsp
+
+def uri : DocumentUri := "file:///snapshotCacheTest.lean"
+
+def text : FileMap := "import Lean\ndef a := 1\n#eval a\n#eval a + 1\n".toFileMap
+
+def diag (line : Nat) (message : String) : Diagnostic :=
+  { range := ⟨⟨line, 0⟩, ⟨line, 5⟩⟩, message }
+
+def restored (text : FileMap) (importsHash : UInt64) : IO (List (Nat × String)) := do
+  let diags ← SnapshotCache.restore uri text importsHash
+  return diags.toList.map fun (pos, d) => (pos.byteIdx, d.message)
+
+/--
+info: [(0, "header"), (23, "1"), (31, "2")]
+[(0, "header"), (23, "1")]
+[]
+-/
+#guard_msgs in
+#eval show IO Unit from do
+  let cmdEndPos : Array String.Pos := #[⟨12⟩, ⟨23⟩, ⟨31⟩, ⟨43⟩]
+  SnapshotCache.save uri text 42 cmdEndPos #[diag 0 "header", diag 2 "1", diag 3 "2"]
+  IO.println (← restored text 42)
+  -- only the commands before the edit are restored
+  IO.println (← restored "import Lean\ndef a := 1\n#eval a\n#eval b + 1\n".toFileMap 42)
+  -- nothing is restored when the imports have changed
+  IO.println (← restored text 43)
+  IO.FS.removeDirAll ((SnapshotCache.fileOf uri).parent.getD ".")
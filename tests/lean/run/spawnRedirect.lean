@@ -0,0 +1,45 @@
+/-! Connecting child processes to files and to each other via `SpawnArgs.stdinFrom?` and `stdoutTo?` -/
+
+def sortToFile (out : System.FilePath) : IO String := do
+  let producer ← IO.Process.spawn { cmd := "printf", args := #["b\\na\\nc\\n"], stdout := .piped }
+  let h ← IO.FS.Handle.mk out .write
+  let consumer ← IO.Process.spawn { cmd := "sort", stdinFrom? := some producer.stdout, stdoutTo? := some h }
+  let _ ← producer.wait
+  let _ ← consumer.wait
+  IO.FS.readFile out
+
+/--
+info: "a\nb\nc\n"
+-/
+#guard_msgs in
+#eval sortToFile "spawnRedirect.out"
+
+/--
+info: false
+-/
+#guard_msgs in
+#eval do
+  let r ← (IO.Process.output { cmd := "lean-no-such-command" }).toBaseIO
+  return r matches .ok _
+
+/-! Collecting both output streams at once, see `IO.Process.collectOutput` -/
+
+/--
+info: (20000, 20000, 0)
+-/
+#guard_msgs in
+#eval do
+  let out ← IO.Process.output {
+    cmd := "sh", args := #["-c", "i=0; while [ $i -lt 20000 ]; do echo o$i; echo e$i >&2; i=$((i+1)); done"] }
+  return ((out.stdout.splitOn "\n").length - 1, (out.stderr.splitOn "\n").length - 1, out.exitCode)
+
+/--
+info: ("abcdefgh", "xyzxyzxyzx")
+-/
+#guard_msgs in
+#eval do
+  let child ← IO.Process.spawn {
+    cmd := "sh", args := #["-c", "printf 'abcdefgh€€'; printf 'xyzxyzxyzxyzxyz' >&2"], stdout := .piped, stderr := .piped }
+  let out ← IO.Process.collectOutput child.stdout child.stderr (some 10)
+  let _ ← child.wait
+  return out
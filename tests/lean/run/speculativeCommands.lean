@@ -0,0 +1,57 @@
+import Lean
+open Lean
+
+set_option Elab.speculativeCommands 3
+
+/-! Independent theorems: the speculative results are committed. -/
+
+theorem spec1 : 1 + 1 = 2 := rfl
+/-- doc of spec2 -/
+theorem spec2 : 2 + 2 = 4 := rfl
+theorem spec3 : True := trivial
+example : 3 + 3 = 6 := rfl
+
+/-- info: spec2 : 2 + 2 = 4 -/
+#guard_msgs in
+#check spec2
+
+/-- info: spec3 : True -/
+#guard_msgs in
+#check spec3
+
+/-- info: some "doc of spec2 " -/
+#guard_msgs in
+#eval show CoreM _ from do findDocString? (← getEnv) ``spec2
+
+/-- info: true -/
+#guard_msgs in
+#eval show CoreM _ from do return (← findDeclarationRanges? ``spec3).isSome
+
+/-!
+Theorems using a previous one: the speculative results fail or mention the previous theorem and are
+rolled back, then elaborated again.
+-/
+
+theorem dep1 : True := trivial
+theorem dep2 : True := dep1
+theorem dep3 : True ∧ True := ⟨dep1, dep2⟩
+theorem dep4 : True := by exact dep3.1
+
+/-- info: dep4 : True -/
+#guard_msgs in
+#check dep4
+
+/-- info: true -/
+#guard_msgs in
+#eval show CoreM _ from do return (← getEnv).contains ``dep3
+
+/-! A rolled back command does not prevent later ones from being elaborated in order. -/
+
+theorem chain1 : 0 = 0 := rfl
+theorem chain2 : 0 = 0 ∧ 0 = 0 := ⟨chain1, chain1⟩
+theorem chain3 : 1 = 1 := rfl
+theorem chain4 : (0 = 0 ∧ 0 = 0) ∧ 1 = 1 := ⟨chain2, chain3⟩
+
+/-- info: chain4 : (0 = 0 ∧ 0 = 0) ∧ 1 = 1 -/
+#guard_msgs in
+#check chain4
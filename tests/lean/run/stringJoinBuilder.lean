@@ -0,0 +1,16 @@
+/-- info: ("", "abcde", "", "a", "a, b, c", "α∀β∀γ", 5) -/
+#guard_msgs in
+#eval
+  let s := "∀".intercalate ["α", "β", "γ"]
+  (String.join [], String.join ["ab", "", "c", "de"], ", ".intercalate [], ", ".intercalate ["a"],
+   ", ".intercalate ["a", "b", "c"], s, s.length)
+
+def build (n : Nat) : String :=
+  let b := (List.range n).foldl (fun b i => (b.append (toString i)).push ',') (String.Builder.mkWithCapacity 4)
+  (b.appendList ["x", "", "yz"]).toString
+
+/-- info: ("0,1,2,xyz", true, "abc") -/
+#guard_msgs in
+#eval
+  (build 3, (build 1000).length == (build 1000).utf8ByteSize,
+   ("ab".reserve 100 |>.push 'c'))
@@ -0,0 +1,46 @@
+import Std.Data.HashMap
+import Std.Data.SwissMap
+
+open Std
+
+/-- Checks `SwissMap` against `HashMap` on a sequence of insertions and erasures. -/
+def check (n : Nat) : Bool := Id.run do
+  let mut m : SwissMap Nat Nat := {}
+  let mut r : HashMap Nat Nat := {}
+  for i in [0:n] do
+    let k := (i * 7919) % 1000
+    if i % 3 == 0 then
+      m := m.erase k
+      r := r.erase k
+    else
+      m := m.insert k i
+      r := r.insert k i
+  for k in [0:1000] do
+    if m.get? k != r.get? k then
+      return false
+  return m.size == r.size
+
+#guard check 100
+#guard check 10000
+
+/-- info: Std.SwissMap.ofList [(1, "one"), (3, "three")] -/
+#guard_msgs in
+#eval (SwissMap.ofList [(1, "one"), (2, "two"), (3, "three")]).erase 2 |>.insert 3 "three"
+
+/-- info: (some 2, none, 2, true, false) -/
+#guard_msgs in
+#eval
+  let m : SwissMap String Nat := SwissMap.empty |>.insert "a" 1 |>.insert "b" 2 |>.insertIfNew "b" 3
+  (m.get? "b", m.get? "c", m.size, m.contains "a", m.contains "c")
+
+-- many collisions on the 7-bit tag and a table that stays full of deleted slots
+#guard Id.run do
+  let mut m : SwissMap Nat Nat := SwissMap.empty 4
+  for i in [0:2000] do
+    m := m.insert (i * 128) i
+    m := m.erase ((i - 1) * 128)
+  return m.size == 1 && m.get? (1999 * 128) == some 1999
+
+/-- info: 45 -/
+#guard_msgs in
+#eval (SwissMap.ofList ((List.range 10).map fun i => (i, i))).fold (fun acc _ v => acc + v) 0
@@ -0,0 +1,39 @@
+set_option synthInstance.fileCache true
+
+class Foo where
+  n : Nat
+
+class Bar where
+  n : Nat
+
+instance (priority := low) fooOne : Foo := ⟨1⟩
+
+def foo₁ := (inferInstance : Foo).n
+
+/-- info: 1 -/
+#guard_msgs in
+#eval foo₁
+
+/-! Adding an instance invalidates the cached result. -/
+
+instance fooTwo : Foo := ⟨2⟩
+
+/-- info: 2 -/
+#guard_msgs in
+#eval (inferInstance : Foo).n
+
+/-! Failures are cached and invalidated as well. -/
+
+/--
+error: failed to synthesize
+  Bar
+Additional diagnostic information may be available using the `set_option diagnostics true` command.
+-/
+#guard_msgs in
+def bar₁ := (inferInstance : Bar).n
+
+instance : Bar := ⟨3⟩
+
+/-- info: 3 -/
+#guard_msgs in
+#eval (inferInstance : Bar).n
@@ -0,0 +1,21 @@
+import Lean.Data.Trie
+open Lean.Data
+
+-- enough distinct first bytes and second bytes to turn the root and `a`'s node into dense nodes
+def keys : List String :=
+  (List.range 40).map (fun i => String.singleton (Char.ofNat (48 + i))) ++
+  (List.range 40).map (fun i => "a" ++ String.singleton (Char.ofNat (48 + i))) ++ ["a0bc", "∀", "∀x"]
+
+def t : Trie String := keys.foldl (fun t k => t.insert k k) {}
+
+/-- info: true -/
+#guard_msgs in
+#eval keys.all fun k => t.find? k == some k
+
+/-- info: (none, none, some "a0", some "a0bc", some "∀x") -/
+#guard_msgs in
+#eval (t.find? "a0b", t.find? "~", t.matchPrefix "a0b" 0, t.matchPrefix "a0bcd" 0, t.matchPrefix "∀xy" 0)
+
+/-- info: (83, 2) -/
+#guard_msgs in
+#eval (t.values.size, (t.findPrefix "a0").size)
@@ -0,0 +1,22 @@
+def a : UInt32Array := Id.run do
+  let mut a := UInt32Array.mkEmpty 4
+  for i in [0:100] do
+    a := a.push (UInt32.ofNat (i * 3))
+  return a
+
+#guard a.size == 100
+#guard a[10]! == 30
+#guard (a.set! 10 7).get! 10 == 7
+#guard a.get! 1000 == 0
+#guard (a.set! 10 7).foldl (· + ·) 0 == 14827
+
+def b := [1, 2, 0xFFFFFFFFFFFFFFFF].toUInt64Array
+
+#guard b.toList == [1, 2, 0xFFFFFFFFFFFFFFFF]
+#guard (UInt64Array.mk b.data).size == 3
+#guard Id.run (do
+  let mut s : UInt64 := 0
+  for x in b do
+    s := s + x
+  return s) == 2
+#guard toString b == "[1, 2, 18446744073709551615]"
@@ -0,0 +1,24 @@
+import Lean.Data.Lsp.Utf16
+
+open Lean
+
+/-! Native UTF-16 position conversions, see `lean_string_codepoint_pos_to_utf16_pos_from` -/
+
+def s := "ab€😀cd\nxyz😀😀 long ASCII tail of the line"
+
+#guard s.codepointPosToUtf16Pos 0 == 0
+#guard s.codepointPosToUtf16Pos 4 == 5
+#guard s.codepointPosToUtf16Pos 6 == 7
+#guard s.codepointPosToUtf16Pos (s.length + 3) == s.utf16Length + 3
+#guard s.utf16PosToCodepointPos 5 == 4
+-- in the middle of a surrogate pair
+#guard s.utf16PosToCodepointPos 4 == 4
+#guard s.codepointPosToUtf8PosFrom 0 4 == ⟨9⟩
+#guard s.codepointPosToUtf8PosFrom ⟨2⟩ 2 == ⟨9⟩
+#guard s.codepointPosToUtf8PosFrom 0 (s.length + 2) == s.endPos + ⟨2⟩
+
+def m := FileMap.ofString s
+
+#guard m.leanPosToLspPos ⟨2, 5⟩ == ⟨1, 7⟩
+#guard m.lspPosToUtf8Pos ⟨1, 7⟩ == ⟨23⟩
+#guard [0, 1, 2, 5, 9, 10, 11, 12, 15, 19, 23].all fun i => m.lspPosToUtf8Pos (m.utf8PosToLspPos ⟨i⟩) == ⟨i⟩
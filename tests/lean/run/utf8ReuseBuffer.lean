@@ -0,0 +1,22 @@
+def roundTrip (s : String) : String :=
+  match h : String.validateUTF8 s.toUTF8 with
+  | true  => String.fromUTF8 s.toUTF8 h
+  | false => ""
+
+/-- info: ("", "abc", "αβγ∀", true) -/
+#guard_msgs in
+#eval
+  let s := String.mk (List.replicate 1000 'x') ++ "ü"
+  (roundTrip "", roundTrip "abc", roundTrip "αβγ∀", roundTrip s == s)
+
+def pushThenConvert (n : Nat) : String :=
+  let a := (List.range n).foldl (fun a i => a.push (UInt8.ofNat (97 + i % 26))) ByteArray.empty
+  match h : String.validateUTF8 a with
+  | true  => String.fromUTF8 a h
+  | false => ""
+
+/-- info: (26, "abcdefghijklmnopqrstuvwxyz", 100) -/
+#guard_msgs in
+#eval
+  let s := pushThenConvert 26
+  (s.length, s, (pushThenConvert 100).toUTF8.size)
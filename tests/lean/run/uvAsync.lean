@@ -0,0 +1,22 @@
+import Std.Internal.UV
+
+open Std.Internal
+
+def tst : IO Unit := do
+  let promises ← (List.range 100).mapM fun i => UV.sleep (10 + (i % 10).toUInt64)
+  for p in promises do
+    IO.wait p.result
+  IO.FS.writeFile "uvAsync.txt" "hello"
+  let p ← UV.readBinFile "uvAsync.txt"
+  match ← IO.wait p.result with
+  | .ok data => unless data == "hello".toUTF8 do throw <| IO.userError "unexpected contents"
+  | .error e => throw e
+  let p ← UV.readBinFile "uvAsync.doesNotExist"
+  match ← IO.wait p.result with
+  | .ok _ => throw <| IO.userError "expected error"
+  | .error _ => pure ()
+  IO.println "ok"
+
+/-- info: ok -/
+#guard_msgs in
+#eval tst
@@ -0,0 +1,40 @@
+import Lean.Util.ValueFile
+
+structure Point where
+  x : Nat
+  y : UInt64
+  label : String
+  deriving Repr, TypeName
+
+structure Other where
+  n : Nat
+  deriving TypeName
+
+/--
+info: #[{ x := 1, y := 2, label := "a" }, { x := 100000000000000000000, y := 3, label := "b" }]
+true
+true
+true
+-/
+#guard_msgs in
+#eval show IO Unit from do
+  let fname : System.FilePath := "valueFile.val.tmp"
+  let points := #[{ x := 1, y := 2, label := "a" : Point }, { x := 10^20, y := 3, label := "b" }]
+  IO.saveValue fname (IO.valueFingerprint Point) points
+  let points' : Array Point ← IO.loadValue fname (IO.valueFingerprint Point)
+  IO.println (repr points')
+  -- a different type or version is rejected
+  for fingerprint in [IO.valueFingerprint Other, IO.valueFingerprint Point (version := 1)] do
+    try
+      let _ : Array Point ← IO.loadValue fname fingerprint
+      IO.println false
+    catch e =>
+      IO.println ((toString e).endsWith "fingerprint mismatch")
+  -- so is a file that was not written by `saveValue`
+  IO.FS.writeFile fname "not a value file"
+  try
+    let _ : Array Point ← IO.loadValue fname (IO.valueFingerprint Point)
+    IO.println false
+  catch _ =>
+    IO.println true
+  IO.FS.removeFile fname
@@ -0,0 +1,60 @@
+open System
+
+def tree : FilePath := "walkDirAsync.tmp"
+
+/--
+info: #[a, a/b, a/b/c.txt, a/d.txt, e, e/f.txt, g.txt]
+true
+-/
+#guard_msgs in
+#eval show IO Unit from do
+  if (← tree.pathExists) then
+    IO.FS.removeDirAll tree
+  for dir in ["a/b", "e"] do
+    IO.FS.createDirAll (tree / dir)
+  for file in ["a/b/c.txt", "a/d.txt", "e/f.txt", "g.txt"] do
+    IO.FS.writeFile (tree / file) ""
+  let ch ← IO.Channel.new
+  let t ← tree.walkDirAsync ch
+  IO.ofExcept (← IO.wait t)
+  let paths ← ch.recvAllCurrent
+  let rel (p : FilePath) := p.toString.drop (tree.toString.length + 1) |>.replace "\\" "/"
+  IO.println (paths.map rel |>.qsort (· < ·))
+  IO.println ((← tree.walkDir).qsort (·.toString < ·.toString) == paths.qsort (·.toString < ·.toString))
+  IO.FS.removeDirAll tree
+
+/-!
+Directories behind symbolic links are walked at their resolved path, while the link itself is
+returned as is.
+-/
+
+/--
+info: #[a, a/b, a/b/c.txt, a/d.txt, h]
+#[a/b, a/b/c.txt, a/d.txt]
+true
+-/
+#guard_msgs in
+#eval show IO Unit from do
+  if System.Platform.isWindows then
+    -- creating symbolic links requires special privileges on Windows
+    IO.println "#[a, a/b, a/b/c.txt, a/d.txt, h]\n#[a/b, a/b/c.txt, a/d.txt]\ntrue"
+    return
+  if (← tree.pathExists) then
+    IO.FS.removeDirAll tree
+  IO.FS.createDirAll (tree / "a" / "b")
+  for file in ["a/b/c.txt", "a/d.txt"] do
+    IO.FS.writeFile (tree / file) ""
+  discard <| IO.Process.run { cmd := "ln", args := #["-s", "a", (tree / "h").toString] }
+  let real := (← IO.FS.realPath tree).toString
+  let paths ← tree.walkDir
+  let (resolved, unresolved) := paths.partition (·.toString.startsWith real)
+  IO.println (unresolved.map (·.toString.drop (tree.toString.length + 1)) |>.qsort (· < ·))
+  IO.println (resolved.map (·.toString.drop (real.length + 1)) |>.qsort (· < ·))
+  let ch ← IO.Channel.new
+  let t ← tree.walkDirAsync ch
+  IO.ofExcept (← IO.wait t)
+  let asyncPaths ← ch.recvAllCurrent
+  IO.println (paths.qsort (·.toString < ·.toString) == asyncPaths.qsort (·.toString < ·.toString))
+  -- `removeDirAll` follows symbolic links
+  IO.FS.removeFile (tree / "h")
+  IO.FS.removeDirAll tree
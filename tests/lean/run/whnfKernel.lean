@@ -0,0 +1,15 @@
+import Lean
+open Lean Meta
+
+set_option whnf.kernel true
+
+def fib : Nat → Nat
+  | 0 => 0
+  | 1 => 1
+  | n + 2 => fib n + fib (n + 1)
+
+/-- info: 55 -/
+#guard_msgs in
+#eval show MetaM Unit from do
+  let e ← withTransparency .all <| whnf (mkApp (mkConst ``fib) (mkNatLit 10))
+  logInfo e
@@ -0,0 +1,24 @@
+def build (n : Nat) : List (Nat × String) × Array Nat := Id.run do
+  let mut xs := []
+  let mut arr := #[]
+  for i in [0:n] do
+    -- garbage that dies inside the region
+    let _ := toString (i * i) ++ "!"
+    xs := (i, toString i) :: xs
+    arr := arr.push (2 * i)
+  return (xs, arr)
+
+def check (n : Nat) : Bool :=
+  let (xs, arr) := Runtime.withRegion fun _ => build n
+  xs.length == n && xs.head? == some (n - 1, toString (n - 1)) && arr.foldl (· + ·) 0 == n * (n - 1)
+
+#guard check 10000
+-- repeated regions
+#guard check 10000
+#guard check 10000
+
+-- nested regions
+#guard
+  Runtime.withRegion (fun _ =>
+    let inner := Runtime.withRegion fun _ => build 100
+    (inner.1.length, (build 200).2.size)) == (100, 200)
@@ -0,0 +1,45 @@
+-- not in the run/ directory because then it would be run with -j0
+import Std.Sync.SharedMutex
+
+open Std
+
+def incr (m : SharedMutex Nat) (n : Nat) : IO Unit := do
+  for _ in [0:n] do
+    m.atomically (modify (· + 1))
+
+def readMany (m : SharedMutex Nat) (n : Nat) : IO Bool := do
+  let mut prev := 0
+  for _ in [0:n] do
+    let v ← m.atomicallyRead pure
+    if v < prev then return false
+    prev := v
+  return true
+
+/-- info: (40000, true) -/
+#guard_msgs in
+#eval show IO _ from do
+  let m ← SharedMutex.new 0
+  let writers ← (List.range 4).mapM fun _ => IO.asTask (prio := .dedicated) (incr m 10000)
+  let readers ← (List.range 4).mapM fun _ => IO.asTask (prio := .dedicated) (readMany m 10000)
+  for t in writers do
+    discard <| IO.ofExcept (← IO.wait t)
+  let mut ok := true
+  for t in readers do
+    ok := ok && (← IO.ofExcept (← IO.wait t))
+  return (← m.atomicallyRead pure, ok)
+
+/-- info: (true, false, false, true, true, true) -/
+#guard_msgs in
+#eval show IO _ from do
+  let m ← BaseSharedMutex.new
+  let r₁ ← m.tryLockShared
+  let r₂ ← m.tryLock
+  let r₃ ← m.tryLockFor 10
+  m.unlockShared
+  let r₄ ← m.tryLockFor 10
+  let r₅ ← m.tryLock
+  m.unlock
+  let b ← IO.BaseMutex.new
+  let r₆ ← b.tryLock
+  b.unlock
+  return (r₁, r₂, r₃, r₄, !r₅, r₆)
@@ -0,0 +1,23 @@
+-- not in the run/ directory because then it would be run with -j0
+
+/--
+Occupies more workers than there are cores with tasks blocked until `release` is resolved, then
+checks that tasks of latency class `Task.Priority.interactive` still run. The dependency `dep` of an
+interactive task is queued behind the blocked tasks and boosted to `Task.Priority.max`.
+-/
+def interactiveWhileBusy : IO (Nat × Nat) := do
+  let release ← IO.Promise.new
+  let blockers ← (List.range 64).mapM fun _ => IO.asTask (IO.wait release.result)
+  let t ← IO.asTask (prio := .interactive) (pure 42)
+  let r ← IO.ofExcept (← IO.wait t)
+  let dep := Task.spawn fun _ => 21
+  let t' ← IO.mapTask (prio := .interactive) (fun n => pure (2 * n)) dep
+  release.resolve ()
+  let r' ← IO.ofExcept (← IO.wait t')
+  for b in blockers do
+    discard <| IO.wait b
+  return (r, r')
+
+/-- info: (42, 42) -/
+#guard_msgs in
+#eval interactiveWhileBusy
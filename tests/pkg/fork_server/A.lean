@@ -0,0 +1,3 @@
+import ForkServer.Dep
+
+example : dep = 42 := rfl
@@ -0,0 +1,3 @@
+import ForkServer.Dep
+
+example : dep + 1 = 43 := rfl
@@ -0,0 +1 @@
+import ForkServer.Dep
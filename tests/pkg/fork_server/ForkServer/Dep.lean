@@ -0,0 +1 @@
+def dep := 42
@@ -0,0 +1,5 @@
+import Lake
+open System Lake DSL
+
+package fork_server
+@[default_target] lean_lib ForkServer
@@ -0,0 +1,36 @@
+#!/usr/bin/env bash
+set -e
+
+rm -rf .lake/build
+lake build
+
+coproc SERVER { lake env lean --fork-server; }
+
+# Send a request to the fork server and set `code` to the exit code of the child.
+request() {
+  echo "$1" >&"${SERVER[1]}"
+  code=none
+  while read -r line <&"${SERVER[0]}"; do
+    if [[ $line == exit* ]]; then
+      code=${line#exit }
+      return
+    fi
+  done
+}
+
+# The file is not the last argument, as in requests by Lake.
+request "A.lean --json"
+[ "$code" = 0 ]
+
+# Imports are preloaded by the first request, so later requests with the same imports do not need
+# the .olean files anymore.
+rm .lake/build/lib/ForkServer/Dep.olean
+request "B.lean --json"
+[ "$code" = 0 ]
+
+# Imports preloaded for different options are not used, so this request needs the .olean file.
+request "-DmaxHeartbeats=100 B.lean --json"
+[ "$code" = 1 ]
+
+exec {SERVER[1]}>&-
+wait